@@ -42,6 +42,7 @@
 #include "resource.h"
 
 #include "ForwardPlusUtil.h"
+#include "ForwardPlusCpuBenchmark.h"
 
 #pragma warning( disable : 4100 ) // disable unreference formal parameter warnings for /W4 builds
 
@@ -67,16 +68,47 @@ CDXUTSDKMesh                g_AlphaMesh;
 ID3D11VertexShader*         g_pScenePositionOnlyVS = NULL;
 ID3D11VertexShader*         g_pScenePositionAndTexVS = NULL;
 ID3D11VertexShader*         g_pSceneVS = NULL;
-ID3D11PixelShader*          g_pScenePS = NULL;
-ID3D11PixelShader*          g_pScenePSAlphaTest = NULL;
+ID3D11PixelShader*          g_pScenePS[NUM_TILE_RES];   // one per tile size (see GetTileRes)
+ID3D11PixelShader*          g_pScenePSAlphaTest[NUM_TILE_RES];
 ID3D11PixelShader*          g_pScenePSNoCull = NULL;
 ID3D11PixelShader*          g_pScenePSNoCullAlphaTest = NULL;
 ID3D11PixelShader*          g_pScenePSAlphaTestOnly = NULL;
-ID3D11PixelShader*          g_pDebugDrawNumLightsPerTileRadarColorsPS = NULL;
-ID3D11PixelShader*          g_pDebugDrawNumLightsPerTileGrayscalePS = NULL;
-ID3D11ComputeShader*        g_pLightCullCS = NULL;
-ID3D11ComputeShader*        g_pLightCullCSMSAA = NULL;
-ID3D11ComputeShader*        g_pLightCullCSNoDepth = NULL;
+ID3D11PixelShader*          g_pScenePSClustered[NUM_TILE_RES];
+ID3D11PixelShader*          g_pScenePSClusteredAlphaTest[NUM_TILE_RES];
+ID3D11PixelShader*          g_pScenePSCompact[NUM_TILE_RES];
+ID3D11PixelShader*          g_pScenePSCompactAlphaTest[NUM_TILE_RES];
+ID3D11PixelShader*          g_pScenePSPacked[NUM_TILE_RES];
+ID3D11PixelShader*          g_pScenePSPackedAlphaTest[NUM_TILE_RES];
+ID3D11PixelShader*          g_pScenePSNoCullPacked = NULL;
+ID3D11PixelShader*          g_pScenePSNoCullPackedAlphaTest = NULL;
+ID3D11PixelShader*          g_pDebugDrawNumLightsPerTileRadarColorsPS[NUM_TILE_RES];
+ID3D11PixelShader*          g_pDebugDrawNumLightsPerTileGrayscalePS[NUM_TILE_RES];
+ID3D11PixelShader*          g_pDebugDrawNumLightsPerClusterRadarColorsPS[NUM_TILE_RES];
+ID3D11PixelShader*          g_pDebugDrawNumLightsPerClusterGrayscalePS[NUM_TILE_RES];
+ID3D11PixelShader*          g_pDebugDrawNumLightsPerTileCompactRadarColorsPS[NUM_TILE_RES];
+ID3D11PixelShader*          g_pDebugDrawNumLightsPerTileCompactGrayscalePS[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCS[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCSMSAA[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCSNoDepth[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCSDepthMask[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCSMSAADepthMask[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCSCompact[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCSMSAACompact[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCSNoDepthCompact[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCSDepthMaskCompact[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCSMSAADepthMaskCompact[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullClusteredCS[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullClusteredCSMSAA[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullClusteredCSNoDepth[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCSHiZ[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCSHiZCompact[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullClusteredCSHiZ[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCSCoarse[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCSMSAACoarse[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCSNoDepthCoarse[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCSHiZCoarse[NUM_TILE_RES];
+ID3D11ComputeShader*        g_pLightCullCoarseCS[NUM_TILE_RES];         // the coarse pass, depth bounds from Hi-Z
+ID3D11ComputeShader*        g_pLightCullCoarseCSNoDepth[NUM_TILE_RES];
 ID3D11InputLayout*          g_pLayoutPositionOnly11 = NULL;
 ID3D11InputLayout*          g_pLayoutPositionAndTex11 = NULL;
 ID3D11InputLayout*          g_pLayout11 = NULL;
@@ -98,12 +130,43 @@ ID3D11BlendState*           g_pDepthOnlyAlphaToCoverageState = NULL;
 ID3D11RasterizerState*      g_pDisableCullingRS = NULL;
 
 // Number of currently active lights
+static unsigned             g_uMaxNumLights = DEFAULT_MAX_NUM_LIGHTS;   // light capacity, see -maxlights
 static int                  g_iNumActivePointLights = 2048;
 static int                  g_iNumActiveSpotLights = 0;
 
+// The light LOD threshold, in half steps of an 8-bit target (see ForwardPlusLightLod.h), 0 for off
+static int                  g_iLightLodThreshold = 0;
+
 // The max distance the camera can travel
 static float                g_fMaxDistance = 500.0f;
 
+// Everything the light lists depend on. With IDC_CHECKBOX_ENABLE_LIGHT_LIST_REUSE, light 
+// culling is skipped when these are the same as the last time it ran, and the lists from 
+// then are used again. The scene does not move, so the depth buffer only changes with the 
+// camera and the window. Always memset, so that memcmp can compare them.
+struct LightCullInputs
+{
+    XMFLOAT4X4      mWorldView;
+    XMFLOAT4X4      mProjection;
+    unsigned        uWindowWidth;
+    unsigned        uWindowHeight;
+    unsigned        uSampleCount;
+    unsigned        uNumPointLights;
+    unsigned        uNumSpotLights;
+    unsigned        uLightGeneration;
+    unsigned        uLightIndexBufferGeneration;
+    unsigned        uMaxNumLightsPerTile;
+    ClusterConfig   Config;
+    unsigned        uCullSpotCones;
+    float           fMinLightContribution;
+    ID3D11ComputeShader* pLightCullCS;
+    ID3D11ComputeShader* pLightCullCoarseCS;
+};
+static LightCullInputs      g_PrevLightCullInputs;
+static bool                 g_bPrevLightCullInputsValid = false;
+static unsigned             g_uNumCulledTiles = 0;
+static unsigned             g_uNumReusedTiles = 0;
+
 //--------------------------------------------------------------------------------------
 // Constant buffers
 //--------------------------------------------------------------------------------------
@@ -122,10 +185,20 @@ struct CB_PER_FRAME
     XMMATRIX  m_mProjection;
     XMMATRIX  m_mProjectionInv;
     XMVECTOR  m_vCameraPosAndAlphaTest;
-    unsigned  m_uNumLights;
+    unsigned  m_uNumPointLights;
     unsigned  m_uWindowWidth;
     unsigned  m_uWindowHeight;
     unsigned  m_uMaxNumLightsPerTile;
+    unsigned  m_uNumClusterSlices;
+    unsigned  m_uMaxNumLightsPerCluster;
+    float     m_fClusterNearZ;
+    float     m_fClusterFarZ;
+    unsigned  m_uClusterSliceDistribution;
+    unsigned  m_uNumSpotLights;
+    unsigned  m_uCullSpotCones;
+    float     m_fMinLightContribution;
+    XMVECTOR  m_vPackedLightOrigin;
+    XMVECTOR  m_vPackedLightScale;
 };
 #pragma pack(pop)
 
@@ -157,12 +230,32 @@ enum
     IDC_SLIDER_NUM_POINT_LIGHTS,
     IDC_STATIC_NUM_SPOT_LIGHTS,
     IDC_SLIDER_NUM_SPOT_LIGHTS,
+    IDC_CHECKBOX_ENABLE_LIGHT_SORTING,
+    IDC_CHECKBOX_ENABLE_LIGHT_ANIMATION,
+    IDC_CHECKBOX_ENABLE_FRUSTUM_PRE_CULL,
+    IDC_CHECKBOX_ENABLE_PACKED_LIGHTS,
     IDC_CHECKBOX_ENABLE_LIGHT_CULLING,
     IDC_CHECKBOX_ENABLE_DEPTH_BOUNDS,
+    IDC_CHECKBOX_ENABLE_DEPTH_MASK,
+    IDC_CHECKBOX_ENABLE_HIZ,
+    IDC_CHECKBOX_ENABLE_COMPACT_LIGHT_LISTS,
+    IDC_CHECKBOX_ENABLE_COARSE_TILES,
+    IDC_CHECKBOX_ENABLE_SPOT_CONE_CULLING,
+    IDC_STATIC_LIGHT_LOD_THRESHOLD,
+    IDC_SLIDER_LIGHT_LOD_THRESHOLD,
+    IDC_CHECKBOX_ENABLE_LIGHT_LIST_REUSE,
+    IDC_STATIC_TILE_RES,
+    IDC_SLIDER_TILE_RES,
     IDC_CHECKBOX_ENABLE_DEBUG_DRAWING,
     IDC_RADIOBUTTON_DEBUG_DRAWING_ONE,
     IDC_RADIOBUTTON_DEBUG_DRAWING_TWO,
     IDC_TILE_DRAWING_GROUP,
+    IDC_CHECKBOX_ENABLE_CLUSTERED_CULLING,
+    IDC_STATIC_NUM_CLUSTER_SLICES,
+    IDC_SLIDER_NUM_CLUSTER_SLICES,
+    IDC_CHECKBOX_EXPONENTIAL_CLUSTER_SLICES,
+    IDC_STATIC_MAX_NUM_LIGHTS_PER_CLUSTER,
+    IDC_SLIDER_MAX_NUM_LIGHTS_PER_CLUSTER,
     IDC_NUM_CONTROL_IDS
 };
 
@@ -204,6 +297,67 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
     _CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 #endif
 
+    // Headless CPU benchmarks, no window or D3D device needed
+    if( lpCmdLine != NULL && wcsstr( lpCmdLine, L"-cpubenchmark" ) != NULL )
+    {
+        FILE* pFile = NULL;
+        if( _wfopen_s( &pFile, L"CpuBenchmark.txt", L"wt" ) != 0 || pFile == NULL )
+        {
+            return 1;
+        }
+        ForwardPlus11::RunCpuBenchmarks( pFile );
+        fclose( pFile );
+        return 0;
+    }
+
+    // Headless culling quality analysis, also without a window or D3D device
+    if( lpCmdLine != NULL && wcsstr( lpCmdLine, L"-cullingquality" ) != NULL )
+    {
+        FILE* pFile = NULL;
+        if( _wfopen_s( &pFile, L"CullingQuality.txt", L"wt" ) != 0 || pFile == NULL )
+        {
+            return 1;
+        }
+        ForwardPlus11::RunCullingQualityAnalysis( pFile, true );
+        fclose( pFile );
+        return 0;
+    }
+
+    // Headless CPU shading against a golden frame, also without a window or D3D device
+    if( lpCmdLine != NULL && wcsstr( lpCmdLine, L"-cpushading" ) != NULL )
+    {
+        FILE* pFile = NULL;
+        if( _wfopen_s( &pFile, L"CpuShading.txt", L"wt" ) != 0 || pFile == NULL )
+        {
+            return 1;
+        }
+        bool bPassed = ForwardPlus11::RunCpuShadingRegression( pFile );
+        fclose( pFile );
+        return bPassed ? 0 : 1;
+    }
+
+    // Light capacity (of the point lights and of the spot lights, each), e.g. -maxlights:65536
+    const WCHAR* pMaxLightsArg = ( lpCmdLine != NULL ) ? wcsstr( lpCmdLine, L"-maxlights:" ) : NULL;
+    if( pMaxLightsArg != NULL )
+    {
+        int nMaxNumLights = _wtoi( pMaxLightsArg + wcslen( L"-maxlights:" ) );
+        nMaxNumLights = ( nMaxNumLights < 1 ) ? 1 : nMaxNumLights;
+        nMaxNumLights = ( nMaxNumLights > (int)MAX_NUM_LIGHTS_LIMIT ) ? (int)MAX_NUM_LIGHTS_LIMIT : nMaxNumLights;
+        g_uMaxNumLights = (unsigned)nMaxNumLights;
+        g_iNumActivePointLights = ( g_iNumActivePointLights > nMaxNumLights ) ? nMaxNumLights : g_iNumActivePointLights;
+    }
+
+    // Light culling tile size, e.g. -tileres:32 (one of the GetTileRes sizes)
+    const WCHAR* pTileResArg = ( lpCmdLine != NULL ) ? wcsstr( lpCmdLine, L"-tileres:" ) : NULL;
+    if( pTileResArg != NULL )
+    {
+        unsigned uTileRes = (unsigned)_wtoi( pTileResArg + wcslen( L"-tileres:" ) );
+        if( GetTileResIndex( uTileRes ) < NUM_TILE_RES )
+        {
+            g_Util.SetTileRes( NULL, uTileRes );
+        }
+    }
+
     // Set DXUT callbacks
     DXUTSetCallbackMsgProc( MsgProc );
     DXUTSetCallbackKeyboard( OnKeyboard );
@@ -259,16 +413,32 @@ void InitApp()
     g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_LIGHT_DRAWING, L"Show Lights", AMD::HUD::iElementOffset, iY, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, true );
     swprintf_s( szTemp, L"Active Point Lights : %d", g_iNumActivePointLights );
     g_HUD.m_GUI.AddStatic( IDC_STATIC_NUM_POINT_LIGHTS, szTemp, AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight );
-    g_HUD.m_GUI.AddSlider( IDC_SLIDER_NUM_POINT_LIGHTS, AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, 0, MAX_NUM_LIGHTS, g_iNumActivePointLights, true );
+    g_HUD.m_GUI.AddSlider( IDC_SLIDER_NUM_POINT_LIGHTS, AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, 0, (int)g_uMaxNumLights, g_iNumActivePointLights, true );
 
     swprintf_s( szTemp, L"Active Spot Lights : %d", g_iNumActiveSpotLights );
     g_HUD.m_GUI.AddStatic( IDC_STATIC_NUM_SPOT_LIGHTS, szTemp, AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight );
-    g_HUD.m_GUI.AddSlider( IDC_SLIDER_NUM_SPOT_LIGHTS, AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, 0, MAX_NUM_LIGHTS, g_iNumActiveSpotLights );
+    g_HUD.m_GUI.AddSlider( IDC_SLIDER_NUM_SPOT_LIGHTS, AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, 0, (int)g_uMaxNumLights, g_iNumActiveSpotLights );
+    g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_LIGHT_SORTING, L"Sort Lights (Morton)", AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, true );
+    g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_LIGHT_ANIMATION, L"Animate Lights", AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, false );
+    g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_FRUSTUM_PRE_CULL, L"Frustum Pre-Cull Lights", AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, false );
+    g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_PACKED_LIGHTS, L"Packed Light Buffers", AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, false );
 
     iY += AMD::HUD::iGroupDelta;
 
     g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_LIGHT_CULLING, L"Enable Light Culling", AMD::HUD::iElementOffset, iY, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, true );
     g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_DEPTH_BOUNDS, L"Enable Depth Bounds", AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, true );
+    g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_DEPTH_MASK, L"Enable Depth Mask", 2 * AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth - AMD::HUD::iElementOffset, AMD::HUD::iElementHeight, false );
+    g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_HIZ, L"Use Hi-Z Depth Bounds", 2 * AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth - AMD::HUD::iElementOffset, AMD::HUD::iElementHeight, false );
+    g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_COMPACT_LIGHT_LISTS, L"Compact Light Lists", AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, false );
+    g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_COARSE_TILES, L"Two-Level Culling", AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, false );
+    g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_SPOT_CONE_CULLING, L"Spot Cone Culling", AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, false );
+    swprintf_s( szTemp, L"Light LOD Threshold : %.1f/255", 0.5f*g_iLightLodThreshold );
+    g_HUD.m_GUI.AddStatic( IDC_STATIC_LIGHT_LOD_THRESHOLD, szTemp, AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight );
+    g_HUD.m_GUI.AddSlider( IDC_SLIDER_LIGHT_LOD_THRESHOLD, AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, 0, 16, g_iLightLodThreshold );
+    g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_LIGHT_LIST_REUSE, L"Reuse Light Lists", AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, false );
+    swprintf_s( szTemp, L"Tile Size : %dx%d", g_Util.GetTileRes(), g_Util.GetTileRes() );
+    g_HUD.m_GUI.AddStatic( IDC_STATIC_TILE_RES, szTemp, AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight );
+    g_HUD.m_GUI.AddSlider( IDC_SLIDER_TILE_RES, AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, 0, NUM_TILE_RES - 1, GetTileResIndex( g_Util.GetTileRes() ) );
     g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_DEBUG_DRAWING, L"Show Lights Per Tile", AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, false );
     g_HUD.m_GUI.AddRadioButton( IDC_RADIOBUTTON_DEBUG_DRAWING_ONE, IDC_TILE_DRAWING_GROUP, L"Radar Colors", 2 * AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth - AMD::HUD::iElementOffset, AMD::HUD::iElementHeight, true );
     g_HUD.m_GUI.AddRadioButton( IDC_RADIOBUTTON_DEBUG_DRAWING_TWO, IDC_TILE_DRAWING_GROUP, L"Grayscale", 2 * AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth - AMD::HUD::iElementOffset, AMD::HUD::iElementHeight, false );
@@ -277,6 +447,18 @@ void InitApp()
 
     iY += AMD::HUD::iGroupDelta;
 
+    const ClusterConfig& Config = g_Util.GetClusterConfig();
+    g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_ENABLE_CLUSTERED_CULLING, L"Clustered Light Culling", AMD::HUD::iElementOffset, iY, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, false );
+    swprintf_s( szTemp, L"Depth Slices : %d", Config.uNumSlices );
+    g_HUD.m_GUI.AddStatic( IDC_STATIC_NUM_CLUSTER_SLICES, szTemp, AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight );
+    g_HUD.m_GUI.AddSlider( IDC_SLIDER_NUM_CLUSTER_SLICES, AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, 1, MAX_NUM_CLUSTER_SLICES, Config.uNumSlices );
+    g_HUD.m_GUI.AddCheckBox( IDC_CHECKBOX_EXPONENTIAL_CLUSTER_SLICES, L"Exponential Slices", AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, Config.eSliceDistribution == CLUSTER_SLICE_DISTRIBUTION_EXPONENTIAL );
+    swprintf_s( szTemp, L"Max Lights Per Cluster : %d", Config.uMaxNumLightsPerCluster );
+    g_HUD.m_GUI.AddStatic( IDC_STATIC_MAX_NUM_LIGHTS_PER_CLUSTER, szTemp, AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight );
+    g_HUD.m_GUI.AddSlider( IDC_SLIDER_MAX_NUM_LIGHTS_PER_CLUSTER, AMD::HUD::iElementOffset, iY += AMD::HUD::iElementDelta, AMD::HUD::iElementWidth, AMD::HUD::iElementHeight, 8, MAX_NUM_LIGHTS_PER_CLUSTER, Config.uMaxNumLightsPerCluster );
+
+    iY += AMD::HUD::iGroupDelta;
+
     // Add the magnify tool UI to our HUD
     g_MagnifyTool.InitApp( &g_HUD.m_GUI, iY, true );
 }
@@ -339,6 +521,35 @@ void RenderText()
     swprintf_s( szBuf, 256, szFormat, fGpuTimeLightDebugDrawing );
     g_pTxtHelper->DrawTextLine( szBuf );
 
+    // light list lengths, from a few frames ago (see ForwardPlusUtil::ReadBackLightCullStats)
+    const LightCullStats& Stats = g_Util.GetLightCullStats();
+    swprintf_s( szBuf, 256, L"Lights/list: mean %.1f, p99 %u, max %u, overflowed %u of %u", 
+        Stats.fMeanNumLights, Stats.uP99NumLights, Stats.uMaxNumLights, Stats.uNumOverflowedLists, Stats.uNumLists );
+    g_pTxtHelper->DrawTextLine( szBuf );
+
+    // the spot lights the sphere test let into a tile that their cone does not touch
+    swprintf_s( szBuf, 256, L"Spot cone rejections: %u", Stats.uNumSpotConeRejections );
+    g_pTxtHelper->DrawTextLine( szBuf );
+
+    // the tiles by their depth (see ClassifyTile): empty ones skip culling, 
+    // and only complex ones get the depth mask
+    swprintf_s( szBuf, 256, L"Tiles empty: %u, uniform: %u, complex: %u", Stats.uNumEmptyTiles, Stats.uNumUniformTiles, Stats.uNumComplexTiles );
+    g_pTxtHelper->DrawTextLine( szBuf );
+
+    // what every tile loops over, see IDC_CHECKBOX_ENABLE_FRUSTUM_PRE_CULL
+    swprintf_s( szBuf, 256, L"Visible lights: %u of %u", g_Util.GetNumVisiblePointLights() + g_Util.GetNumVisibleSpotLights(),
+        (unsigned)( g_iNumActivePointLights + g_iNumActiveSpotLights ) );
+    g_pTxtHelper->DrawTextLine( szBuf );
+
+    // this frame's tiles, see IDC_CHECKBOX_ENABLE_LIGHT_LIST_REUSE
+    swprintf_s( szBuf, 256, L"Tiles culled: %u, reused: %u", g_uNumCulledTiles, g_uNumReusedTiles );
+    g_pTxtHelper->DrawTextLine( szBuf );
+
+    const float fLightIndexBufferSizeInMB = 4.0f * g_Util.GetMaxNumLightsPerTile() * g_Util.GetNumTilesX() * g_Util.GetNumTilesY() / ( 1024.0f * 1024.0f );
+    swprintf_s( szBuf, 256, L"Lights/tile slot: %u (%.1f MB, resized %u times)", 
+        g_Util.GetMaxNumLightsPerTile(), fLightIndexBufferSizeInMB, g_Util.GetLightListCapacitySizer().GetNumResizes() );
+    g_pTxtHelper->DrawTextLine( szBuf );
+
     g_pTxtHelper->SetInsertionPos( 5, DXUTGetDXGIBackBufferSurfaceDesc()->Height - AMD::HUD::iElementDelta );
     g_pTxtHelper->DrawTextLine( L"Toggle GUI    : F1" );
 
@@ -351,7 +562,9 @@ void RenderText()
         // method 1 is radar colors, method 2 is grayscale
         bool bDebugDrawMethodOne = g_HUD.m_GUI.GetRadioButton( IDC_RADIOBUTTON_DEBUG_DRAWING_ONE )->GetEnabled() &&
             g_HUD.m_GUI.GetRadioButton( IDC_RADIOBUTTON_DEBUG_DRAWING_ONE )->GetChecked();
-        g_Util.RenderLegend( g_pTxtHelper, TEXT_LINE_HEIGHT, XMFLOAT4( 1.0f, 1.0f, 1.0f, 0.75f ), !bDebugDrawMethodOne );
+        bool bClusteredCullingEnabled = g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_CLUSTERED_CULLING )->GetEnabled() &&
+            g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_CLUSTERED_CULLING )->GetChecked();
+        g_Util.RenderLegend( g_pTxtHelper, TEXT_LINE_HEIGHT, XMFLOAT4( 1.0f, 1.0f, 1.0f, 0.75f ), !bDebugDrawMethodOne, bClusteredCullingEnabled );
     }
 }
 
@@ -490,7 +703,15 @@ HRESULT CALLBACK OnD3D11CreateDevice( ID3D11Device* pd3dDevice, const DXGI_SURFA
         g_Camera.SetClipToBoundary( true, &vBoundaryMin, &vBoundaryMax );
 
         // Init light buffer data
-        ForwardPlusUtil::InitLights( SceneMin, SceneMax );
+        ForwardPlusUtil::InitLights( SceneMin, SceneMax, g_uMaxNumLights );
+
+        // Cluster depth slices go out to the far plane, 
+        // keeping the slice count and capacity from the HUD
+        ClusterConfig Config = GetDefaultClusterConfig( g_fMaxDistance );
+        Config.uNumSlices = g_Util.GetClusterConfig().uNumSlices;
+        Config.uMaxNumLightsPerCluster = g_Util.GetClusterConfig().uMaxNumLightsPerCluster;
+        Config.eSliceDistribution = g_Util.GetClusterConfig().eSliceDistribution;
+        g_Util.SetClusterConfig( NULL, Config );
     }
 
     // Create helper resources here
@@ -575,19 +796,49 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
 
     const DXGI_SURFACE_DESC * BackBufferDesc = DXUTGetDXGIBackBufferSurfaceDesc();
 
+    // The tile size picks the shader permutations
+    unsigned uTileResIdx = GetTileResIndex( g_Util.GetTileRes() );
+
     // Default pixel shader
-    ID3D11PixelShader* pScenePS = g_pScenePS;
-    ID3D11PixelShader* pScenePSAlphaTest = g_pScenePSAlphaTest;
+    ID3D11PixelShader* pScenePS = g_pScenePS[uTileResIdx];
+    ID3D11PixelShader* pScenePSAlphaTest = g_pScenePSAlphaTest[uTileResIdx];
 
     // See if we need to use one of the debug drawing shaders instead
     bool bDebugDrawingEnabled = g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEBUG_DRAWING )->GetEnabled() &&
             g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEBUG_DRAWING )->GetChecked();
     bool bDebugDrawMethodOne = g_HUD.m_GUI.GetRadioButton( IDC_RADIOBUTTON_DEBUG_DRAWING_ONE )->GetEnabled() &&
             g_HUD.m_GUI.GetRadioButton( IDC_RADIOBUTTON_DEBUG_DRAWING_ONE )->GetChecked();
+    bool bClusteredCullingEnabled = g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_CLUSTERED_CULLING )->GetEnabled() &&
+            g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_CLUSTERED_CULLING )->GetChecked();
+    // compact lists only apply to tiled culling
+    bool bCompactLightListsEnabled = !bClusteredCullingEnabled &&
+            g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_COMPACT_LIGHT_LISTS )->GetEnabled() &&
+            g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_COMPACT_LIGHT_LISTS )->GetChecked();
+    if( bClusteredCullingEnabled )
+    {
+        pScenePS = g_pScenePSClustered[uTileResIdx];
+        pScenePSAlphaTest = g_pScenePSClusteredAlphaTest[uTileResIdx];
+    }
+    if( bCompactLightListsEnabled )
+    {
+        pScenePS = g_pScenePSCompact[uTileResIdx];
+        pScenePSAlphaTest = g_pScenePSCompactAlphaTest[uTileResIdx];
+    }
     if( bDebugDrawingEnabled )
     {
-        pScenePS = bDebugDrawMethodOne ? g_pDebugDrawNumLightsPerTileRadarColorsPS : g_pDebugDrawNumLightsPerTileGrayscalePS;
-        pScenePSAlphaTest = bDebugDrawMethodOne ? g_pDebugDrawNumLightsPerTileRadarColorsPS : g_pDebugDrawNumLightsPerTileGrayscalePS;
+        if( bClusteredCullingEnabled )
+        {
+            pScenePS = bDebugDrawMethodOne ? g_pDebugDrawNumLightsPerClusterRadarColorsPS[uTileResIdx] : g_pDebugDrawNumLightsPerClusterGrayscalePS[uTileResIdx];
+        }
+        else if( bCompactLightListsEnabled )
+        {
+            pScenePS = bDebugDrawMethodOne ? g_pDebugDrawNumLightsPerTileCompactRadarColorsPS[uTileResIdx] : g_pDebugDrawNumLightsPerTileCompactGrayscalePS[uTileResIdx];
+        }
+        else
+        {
+            pScenePS = bDebugDrawMethodOne ? g_pDebugDrawNumLightsPerTileRadarColorsPS[uTileResIdx] : g_pDebugDrawNumLightsPerTileGrayscalePS[uTileResIdx];
+        }
+        pScenePSAlphaTest = pScenePS;
     }
 
     // And see if we need to use the no-cull pixel shader instead
@@ -596,17 +847,110 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
     pScenePS = bLightCullingEnabled ? pScenePS : g_pScenePSNoCull;
     pScenePSAlphaTest = bLightCullingEnabled ? pScenePSAlphaTest : g_pScenePSNoCullAlphaTest;
 
+    // And for the packed light buffers, which only the per-tile lists and no culling have permutations for
+    bool bPackedLightsEnabled = g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_PACKED_LIGHTS )->GetChecked() &&
+            ( !bLightCullingEnabled || ( !bDebugDrawingEnabled && !bClusteredCullingEnabled && !bCompactLightListsEnabled ) );
+    if( bPackedLightsEnabled )
+    {
+        pScenePS = bLightCullingEnabled ? g_pScenePSPacked[uTileResIdx] : g_pScenePSNoCullPacked;
+        pScenePSAlphaTest = bLightCullingEnabled ? g_pScenePSPackedAlphaTest[uTileResIdx] : g_pScenePSNoCullPackedAlphaTest;
+    }
+
     // Default compute shader
     bool bMSAAEnabled = ( BackBufferDesc->SampleDesc.Count > 1 );
-    ID3D11ComputeShader* pLightCullCS = bMSAAEnabled ? g_pLightCullCSMSAA : g_pLightCullCS;
+    ID3D11ComputeShader* pLightCullCS = bMSAAEnabled ? g_pLightCullCSMSAA[uTileResIdx] : g_pLightCullCS[uTileResIdx];
     ID3D11ShaderResourceView* pDepthSRV = g_pDepthStencilSRV;
 
     // Determine which compute shader we should use
     bool bDepthBoundsEnabled = g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEPTH_BOUNDS )->GetEnabled() &&
             g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEPTH_BOUNDS )->GetChecked();
-    pLightCullCS = bDepthBoundsEnabled ? pLightCullCS : g_pLightCullCSNoDepth;
+    pLightCullCS = bDepthBoundsEnabled ? pLightCullCS : g_pLightCullCSNoDepth[uTileResIdx];
+    bool bDepthMaskEnabled = g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEPTH_MASK )->GetEnabled() &&
+            g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEPTH_MASK )->GetChecked();
+    if( bDepthBoundsEnabled && bDepthMaskEnabled )
+    {
+        pLightCullCS = bMSAAEnabled ? g_pLightCullCSMSAADepthMask[uTileResIdx] : g_pLightCullCSDepthMask[uTileResIdx];
+    }
+    // the Hi-Z pyramid only holds the depth bounds, the depth mask still reads the depth buffer
+    bool bHiZEnabled = bDepthBoundsEnabled && !bDepthMaskEnabled &&
+            g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_HIZ )->GetEnabled() &&
+            g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_HIZ )->GetChecked();
+    if( bHiZEnabled )
+    {
+        pLightCullCS = g_pLightCullCSHiZ[uTileResIdx];
+        pDepthSRV = *g_Util.GetHiZSRVParam( g_Util.GetTileRes() );
+    }
     pDepthSRV = bDepthBoundsEnabled ? pDepthSRV : NULL;
 
+    // Two-level culling only has permutations for per-tile lists without the depth mask,
+    // and does nothing for tiles as big as the coarse tiles
+    bool bCoarseTilesEnabled = g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_COARSE_TILES )->GetEnabled() &&
+            g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_COARSE_TILES )->GetChecked() &&
+            g_Util.GetTileRes() < COARSE_TILE_RES && !bCompactLightListsEnabled && !bClusteredCullingEnabled &&
+            !( bDepthBoundsEnabled && bDepthMaskEnabled );
+    ID3D11ComputeShader* pLightCullCoarseCS = bDepthBoundsEnabled ? g_pLightCullCoarseCS[uTileResIdx] : g_pLightCullCoarseCSNoDepth[uTileResIdx];
+    if( bCoarseTilesEnabled )
+    {
+        if( !bDepthBoundsEnabled )
+        {
+            pLightCullCS = g_pLightCullCSNoDepthCoarse[uTileResIdx];
+        }
+        else if( bHiZEnabled )
+        {
+            pLightCullCS = g_pLightCullCSHiZCoarse[uTileResIdx];
+        }
+        else
+        {
+            pLightCullCS = bMSAAEnabled ? g_pLightCullCSMSAACoarse[uTileResIdx] : g_pLightCullCSCoarse[uTileResIdx];
+        }
+    }
+
+    // Spot lights can be culled by their cones (see ForwardPlusSpotCones.h) in 
+    // all the per-tile permutations, switched with g_uCullSpotCones
+    bool bSpotConeCullingEnabled = g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_SPOT_CONE_CULLING )->GetEnabled() &&
+            g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_SPOT_CONE_CULLING )->GetChecked() &&
+            !bClusteredCullingEnabled;
+
+    // The light LOD drops the lights that can not add much to any pixel of a tile (see 
+    // ForwardPlusLightLod.h), in all the per-tile permutations, spot lights only with 
+    // their cones
+    float fMinLightContribution = bClusteredCullingEnabled ? 0.0f : g_iLightLodThreshold*LIGHT_LOD_DEFAULT_THRESHOLD;
+
+    // Compact lists and clustered culling use their own compute shaders and light index buffers
+    ID3D11UnorderedAccessView* const * ppLightIndexBufferUAV = g_Util.GetLightIndexBufferUAVParam();
+    ID3D11ShaderResourceView* const * ppLightIndexBufferSRV = g_Util.GetLightIndexBufferSRVParam();
+    unsigned uNumThreadGroupsZ = 1;
+    if( bCompactLightListsEnabled )
+    {
+        if( !bDepthBoundsEnabled )
+        {
+            pLightCullCS = g_pLightCullCSNoDepthCompact[uTileResIdx];
+        }
+        else if( bDepthMaskEnabled )
+        {
+            pLightCullCS = bMSAAEnabled ? g_pLightCullCSMSAADepthMaskCompact[uTileResIdx] : g_pLightCullCSDepthMaskCompact[uTileResIdx];
+        }
+        else if( bHiZEnabled )
+        {
+            pLightCullCS = g_pLightCullCSHiZCompact[uTileResIdx];
+        }
+        else
+        {
+            pLightCullCS = bMSAAEnabled ? g_pLightCullCSMSAACompact[uTileResIdx] : g_pLightCullCSCompact[uTileResIdx];
+        }
+        ppLightIndexBufferUAV = g_Util.GetCompactLightIndexBufferUAVParam();
+        ppLightIndexBufferSRV = g_Util.GetCompactLightIndexBufferSRVParam();
+    }
+    if( bClusteredCullingEnabled )
+    {
+        pLightCullCS = bMSAAEnabled ? g_pLightCullClusteredCSMSAA[uTileResIdx] : g_pLightCullClusteredCS[uTileResIdx];
+        pLightCullCS = bDepthBoundsEnabled ? pLightCullCS : g_pLightCullClusteredCSNoDepth[uTileResIdx];
+        pLightCullCS = bHiZEnabled ? g_pLightCullClusteredCSHiZ[uTileResIdx] : pLightCullCS;
+        ppLightIndexBufferUAV = g_Util.GetClusterLightIndexBufferUAVParam();
+        ppLightIndexBufferSRV = g_Util.GetClusterLightIndexBufferSRVParam();
+        uNumThreadGroupsZ = g_Util.GetClusterConfig().uNumSlices;
+    }
+
     // Clear the backbuffer and depth stencil
     float ClearColor[4] = { 0.0013f, 0.0015f, 0.0050f, 0.0f };
     ID3D11RenderTargetView* pRTV = DXUTGetD3D11RenderTargetView();
@@ -639,6 +983,50 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
     // different alpha test for MSAA enabled vs. disabled
     CameraPosAndAlphaTest.w = bMSAAEnabled ? 0.003f : 0.5f;
 
+    // keep the active lights in Morton order in the light buffers
+    bool bLightSortingEnabled = g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_LIGHT_SORTING )->GetChecked();
+    g_Util.UpdateLightOrder( pd3dImmediateContext, (unsigned)g_iNumActivePointLights, (unsigned)g_iNumActiveSpotLights, bLightSortingEnabled );
+
+    // animate the active lights, and upload the ones that moved
+    bool bLightAnimationEnabled = g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_LIGHT_ANIMATION )->GetChecked();
+    g_Util.UpdateLights( pd3dImmediateContext, (float)fTime, (unsigned)g_iNumActivePointLights, (unsigned)g_iNumActiveSpotLights, bLightAnimationEnabled );
+
+    // cull the lights against the camera frustum, so that the tiles only loop over the visible ones
+    bool bFrustumPreCullEnabled = g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_FRUSTUM_PRE_CULL )->GetChecked();
+    g_Util.UpdateVisibleLights( pd3dImmediateContext, mWorldViewProjection, (unsigned)g_iNumActivePointLights, (unsigned)g_iNumActiveSpotLights, bFrustumPreCullEnabled );
+
+    // pack the lights the forward pass shades with, if it uses the packed light buffers
+    g_Util.UpdatePackedLights( pd3dImmediateContext, bPackedLightsEnabled );
+
+    // resize the light index buffer, if the light list statistics asked for it
+    g_Util.UpdateMaxNumLightsPerTile( pd3dDevice );
+
+    // the lists from the last time light culling ran are still right if none of its inputs changed
+    bool bLightListReuseEnabled = g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_LIGHT_LIST_REUSE )->GetEnabled() &&
+            g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_LIGHT_LIST_REUSE )->GetChecked();
+    LightCullInputs CurrLightCullInputs;
+    memset( &CurrLightCullInputs, 0, sizeof(CurrLightCullInputs) );
+    XMStoreFloat4x4( &CurrLightCullInputs.mWorldView, mWorldView );
+    CurrLightCullInputs.mProjection = f4x4Proj;
+    CurrLightCullInputs.uWindowWidth = BackBufferDesc->Width;
+    CurrLightCullInputs.uWindowHeight = BackBufferDesc->Height;
+    CurrLightCullInputs.uSampleCount = BackBufferDesc->SampleDesc.Count;
+    CurrLightCullInputs.uNumPointLights = g_Util.GetNumVisiblePointLights();
+    CurrLightCullInputs.uNumSpotLights = g_Util.GetNumVisibleSpotLights();
+    CurrLightCullInputs.uLightGeneration = g_Util.GetLightGeneration();
+    CurrLightCullInputs.uLightIndexBufferGeneration = g_Util.GetLightIndexBufferGeneration();
+    CurrLightCullInputs.uMaxNumLightsPerTile = g_Util.GetMaxNumLightsPerTile();
+    CurrLightCullInputs.Config = g_Util.GetClusterConfig();
+    CurrLightCullInputs.uCullSpotCones = bSpotConeCullingEnabled ? 1 : 0;
+    CurrLightCullInputs.fMinLightContribution = fMinLightContribution;
+    CurrLightCullInputs.pLightCullCS = pLightCullCS;
+    CurrLightCullInputs.pLightCullCoarseCS = bCoarseTilesEnabled ? pLightCullCoarseCS : NULL;
+    bool bReuseLightLists = bLightListReuseEnabled && g_bPrevLightCullInputsValid &&
+        memcmp( &CurrLightCullInputs, &g_PrevLightCullInputs, sizeof(CurrLightCullInputs) ) == 0;
+    unsigned uNumTiles = bLightCullingEnabled ? g_Util.GetNumTilesX()*g_Util.GetNumTilesY() : 0;
+    g_uNumCulledTiles = bReuseLightLists ? 0 : uNumTiles;
+    g_uNumReusedTiles = bReuseLightLists ? uNumTiles : 0;
+
     // Set the constant buffers
     HRESULT hr;
     D3D11_MAPPED_SUBRESOURCE MappedResource;
@@ -647,10 +1035,21 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
     pPerFrame->m_mProjection = XMMatrixTranspose( mProj );
     pPerFrame->m_mProjectionInv = XMMatrixTranspose( mInvProj );
     pPerFrame->m_vCameraPosAndAlphaTest = XMLoadFloat4( &CameraPosAndAlphaTest );
-    pPerFrame->m_uNumLights = (((unsigned)g_iNumActiveSpotLights & 0xFFFFu) << 16) | ((unsigned)g_iNumActivePointLights & 0xFFFFu);
+    pPerFrame->m_uNumPointLights = g_Util.GetNumVisiblePointLights();
+    pPerFrame->m_uNumSpotLights = g_Util.GetNumVisibleSpotLights();
+    pPerFrame->m_uCullSpotCones = bSpotConeCullingEnabled ? 1 : 0;
+    pPerFrame->m_fMinLightContribution = fMinLightContribution;
     pPerFrame->m_uWindowWidth = BackBufferDesc->Width;
     pPerFrame->m_uWindowHeight = BackBufferDesc->Height;
     pPerFrame->m_uMaxNumLightsPerTile = g_Util.GetMaxNumLightsPerTile();
+    pPerFrame->m_uNumClusterSlices = g_Util.GetClusterConfig().uNumSlices;
+    pPerFrame->m_uMaxNumLightsPerCluster = g_Util.GetClusterConfig().uMaxNumLightsPerCluster;
+    pPerFrame->m_fClusterNearZ = g_Util.GetClusterConfig().fNearZ;
+    pPerFrame->m_fClusterFarZ = g_Util.GetClusterConfig().fFarZ;
+    pPerFrame->m_uClusterSliceDistribution = (unsigned)g_Util.GetClusterConfig().eSliceDistribution;
+    const PackedLightBounds& Bounds = ForwardPlusUtil::GetPackedLightBounds();
+    pPerFrame->m_vPackedLightOrigin = XMVectorSet( Bounds.vOrigin.x, Bounds.vOrigin.y, Bounds.vOrigin.z, 0.0f );
+    pPerFrame->m_vPackedLightScale = XMVectorSet( Bounds.vScale.x, Bounds.vScale.y, Bounds.vScale.z, 0.0f );
     pd3dImmediateContext->Unmap( g_pcbPerFrame11, 0 );
     pd3dImmediateContext->VSSetConstantBuffers( 1, 1, &g_pcbPerFrame11 );
     pd3dImmediateContext->PSSetConstantBuffers( 1, 1, &g_pcbPerFrame11 );
@@ -719,27 +1118,69 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
         TIMER_Begin( 0, L"Light culling" );
         {
             // Cull lights on the GPU, using a Compute Shader
-            if( g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_LIGHT_CULLING )->GetEnabled() &&
-                g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_LIGHT_CULLING )->GetChecked() )
+            if( bLightCullingEnabled && !bReuseLightLists )
             {
                 pd3dImmediateContext->OMSetRenderTargets( 1, &pNULLRTV, pNULLDSV );  // null color buffer and depth-stencil
+                // the coarse tiles get their depth bounds from the pyramid too
+                if( bHiZEnabled || ( bCoarseTilesEnabled && bDepthBoundsEnabled ) )
+                {
+                    TIMER_Begin( 0, L"Hi-Z build" );
+                    g_Util.BuildHiZ( pd3dImmediateContext, g_pDepthStencilSRV, bMSAAEnabled );
+                    TIMER_End(); // Hi-Z build
+                }
                 pd3dImmediateContext->VSSetShader( NULL, NULL, 0 );  // null vertex shader
                 pd3dImmediateContext->PSSetShader( NULL, NULL, 0 );  // null pixel shader
                 pd3dImmediateContext->PSSetShaderResources( 0, 1, &pNULLSRV );
                 pd3dImmediateContext->PSSetShaderResources( 1, 1, &pNULLSRV );
                 pd3dImmediateContext->PSSetSamplers( 0, 1, &pNULLSampler );
-                pd3dImmediateContext->CSSetShader( pLightCullCS, NULL, 0 );
                 pd3dImmediateContext->CSSetShaderResources( 0, 1, g_Util.GetPointLightBufferCenterAndRadiusSRVParam() );
                 pd3dImmediateContext->CSSetShaderResources( 1, 1, g_Util.GetSpotLightBufferCenterAndRadiusSRVParam() );
+                if( bCoarseTilesEnabled )
+                {
+                    TIMER_Begin( 0, L"Coarse tiles" );
+                    ID3D11ShaderResourceView* pCoarseDepthSRV = bDepthBoundsEnabled ? *g_Util.GetHiZSRVParam( COARSE_TILE_RES ) : NULL;
+                    pd3dImmediateContext->CSSetShader( pLightCullCoarseCS, NULL, 0 );
+                    pd3dImmediateContext->CSSetShaderResources( 2, 1, &pCoarseDepthSRV );
+                    pd3dImmediateContext->CSSetUnorderedAccessViews( 2, 1, g_Util.GetCoarseLightIndexBufferUAVParam(), NULL );
+                    pd3dImmediateContext->Dispatch( g_Util.GetNumCoarseTilesX(), g_Util.GetNumCoarseTilesY(), 1 );
+                    pd3dImmediateContext->CSSetUnorderedAccessViews( 2, 1, &pNULLUAV, NULL );
+                    pd3dImmediateContext->CSSetShaderResources( 3, 1, g_Util.GetCoarseLightIndexBufferSRVParam() );
+                    TIMER_End(); // Coarse tiles
+                }
+                pd3dImmediateContext->CSSetShader( pLightCullCS, NULL, 0 );
                 pd3dImmediateContext->CSSetShaderResources( 2, 1, &pDepthSRV );
-                pd3dImmediateContext->CSSetUnorderedAccessViews( 0, 1,  g_Util.GetLightIndexBufferUAVParam(), NULL );
-                pd3dImmediateContext->Dispatch(g_Util.GetNumTilesX(),g_Util.GetNumTilesY(),1);
+                pd3dImmediateContext->CSSetShaderResources( 4, 1, g_Util.GetSpotLightBufferSpotParamsSRVParam() );
+                pd3dImmediateContext->CSSetShaderResources( 5, 1, g_Util.GetPointLightBufferColorSRVParam() );
+                pd3dImmediateContext->CSSetShaderResources( 6, 1, g_Util.GetSpotLightBufferColorSRVParam() );
+                if( bCompactLightListsEnabled )
+                {
+                    // the lists are allocated from the start of the dense array again every frame
+                    const UINT ClearValues[4] = { 0, 0, 0, 0 };
+                    pd3dImmediateContext->ClearUnorderedAccessViewUint( g_Util.GetCompactLightIndexCounterUAV(), ClearValues );
+                }
+                {
+                    // the list length histogram is gathered from scratch every frame
+                    const UINT ClearValues[4] = { 0, 0, 0, 0 };
+                    pd3dImmediateContext->ClearUnorderedAccessViewUint( *g_Util.GetLightCullStatsUAVParam(), ClearValues );
+                }
+                pd3dImmediateContext->CSSetUnorderedAccessViews( 0, 1,  ppLightIndexBufferUAV, NULL );
+                pd3dImmediateContext->CSSetUnorderedAccessViews( 1, 1,  g_Util.GetLightCullStatsUAVParam(), NULL );
+                pd3dImmediateContext->Dispatch(g_Util.GetNumTilesX(),g_Util.GetNumTilesY(),uNumThreadGroupsZ);
                 pd3dImmediateContext->CSSetShader( NULL, NULL, 0 );
                 pd3dImmediateContext->CSSetShaderResources( 0, 1, &pNULLSRV );
                 pd3dImmediateContext->CSSetShaderResources( 1, 1, &pNULLSRV );
                 pd3dImmediateContext->CSSetShaderResources( 2, 1, &pNULLSRV );
+                pd3dImmediateContext->CSSetShaderResources( 3, 1, &pNULLSRV );
+                pd3dImmediateContext->CSSetShaderResources( 4, 1, &pNULLSRV );
+                pd3dImmediateContext->CSSetShaderResources( 5, 1, &pNULLSRV );
+                pd3dImmediateContext->CSSetShaderResources( 6, 1, &pNULLSRV );
                 pd3dImmediateContext->CSSetUnorderedAccessViews( 0, 1, &pNULLUAV, NULL );
+                pd3dImmediateContext->CSSetUnorderedAccessViews( 1, 1, &pNULLUAV, NULL );
+                g_Util.ReadBackLightCullStats( pd3dImmediateContext, !bClusteredCullingEnabled );
             }
+
+            g_PrevLightCullInputs = CurrLightCullInputs;
+            g_bPrevLightCullInputsValid = bLightCullingEnabled;
         }
         TIMER_End(); // Light culling
 
@@ -752,12 +1193,20 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
             pd3dImmediateContext->VSSetShader( g_pSceneVS, NULL, 0 );
             pd3dImmediateContext->PSSetShader( pScenePS, NULL, 0 );
             pd3dImmediateContext->PSSetSamplers( 0, 1, &g_pSamLinear );
-            pd3dImmediateContext->PSSetShaderResources( 2, 1, g_Util.GetPointLightBufferCenterAndRadiusSRVParam() );
-            pd3dImmediateContext->PSSetShaderResources( 3, 1, g_Util.GetPointLightBufferColorSRVParam() );
-            pd3dImmediateContext->PSSetShaderResources( 4, 1, g_Util.GetSpotLightBufferCenterAndRadiusSRVParam() );
-            pd3dImmediateContext->PSSetShaderResources( 5, 1, g_Util.GetSpotLightBufferColorSRVParam() );
+            if( bPackedLightsEnabled )
+            {
+                pd3dImmediateContext->PSSetShaderResources( 2, 1, g_Util.GetPackedPointLightBufferSRVParam() );
+                pd3dImmediateContext->PSSetShaderResources( 4, 1, g_Util.GetPackedSpotLightBufferSRVParam() );
+            }
+            else
+            {
+                pd3dImmediateContext->PSSetShaderResources( 2, 1, g_Util.GetPointLightBufferCenterAndRadiusSRVParam() );
+                pd3dImmediateContext->PSSetShaderResources( 3, 1, g_Util.GetPointLightBufferColorSRVParam() );
+                pd3dImmediateContext->PSSetShaderResources( 4, 1, g_Util.GetSpotLightBufferCenterAndRadiusSRVParam() );
+                pd3dImmediateContext->PSSetShaderResources( 5, 1, g_Util.GetSpotLightBufferColorSRVParam() );
+            }
             pd3dImmediateContext->PSSetShaderResources( 6, 1, g_Util.GetSpotLightBufferSpotParamsSRVParam() );
-            pd3dImmediateContext->PSSetShaderResources( 7, 1, g_Util.GetLightIndexBufferSRVParam() );
+            pd3dImmediateContext->PSSetShaderResources( 7, 1, ppLightIndexBufferSRV );
             g_SceneMesh.Render( pd3dImmediateContext, 0, 1 );
 
             // More forward rendering, for alpha test geometry
@@ -856,20 +1305,54 @@ void CALLBACK OnD3D11DestroyDevice( void* pUserContext )
     SAFE_RELEASE( g_pScenePositionOnlyVS );
     SAFE_RELEASE( g_pScenePositionAndTexVS );
     SAFE_RELEASE( g_pSceneVS );
-    SAFE_RELEASE( g_pScenePS );
-    SAFE_RELEASE( g_pScenePSAlphaTest );
     SAFE_RELEASE( g_pScenePSNoCull );
     SAFE_RELEASE( g_pScenePSNoCullAlphaTest );
+    SAFE_RELEASE( g_pScenePSNoCullPacked );
+    SAFE_RELEASE( g_pScenePSNoCullPackedAlphaTest );
     SAFE_RELEASE( g_pScenePSAlphaTestOnly );
-    SAFE_RELEASE( g_pDebugDrawNumLightsPerTileRadarColorsPS );
-    SAFE_RELEASE( g_pDebugDrawNumLightsPerTileGrayscalePS );
-    SAFE_RELEASE( g_pLightCullCS );
-    SAFE_RELEASE( g_pLightCullCSMSAA );
-    SAFE_RELEASE( g_pLightCullCSNoDepth );
     SAFE_RELEASE( g_pLayoutPositionOnly11 );
     SAFE_RELEASE( g_pLayoutPositionAndTex11 );
     SAFE_RELEASE( g_pLayout11 );
     SAFE_RELEASE( g_pSamLinear );
+    for( unsigned uTileResIdx = 0; uTileResIdx < NUM_TILE_RES; uTileResIdx++ )
+    {
+        SAFE_RELEASE( g_pScenePS[uTileResIdx] );
+        SAFE_RELEASE( g_pScenePSAlphaTest[uTileResIdx] );
+        SAFE_RELEASE( g_pScenePSClustered[uTileResIdx] );
+        SAFE_RELEASE( g_pScenePSClusteredAlphaTest[uTileResIdx] );
+        SAFE_RELEASE( g_pScenePSCompact[uTileResIdx] );
+        SAFE_RELEASE( g_pScenePSCompactAlphaTest[uTileResIdx] );
+        SAFE_RELEASE( g_pScenePSPacked[uTileResIdx] );
+        SAFE_RELEASE( g_pScenePSPackedAlphaTest[uTileResIdx] );
+        SAFE_RELEASE( g_pDebugDrawNumLightsPerTileRadarColorsPS[uTileResIdx] );
+        SAFE_RELEASE( g_pDebugDrawNumLightsPerTileGrayscalePS[uTileResIdx] );
+        SAFE_RELEASE( g_pDebugDrawNumLightsPerClusterRadarColorsPS[uTileResIdx] );
+        SAFE_RELEASE( g_pDebugDrawNumLightsPerClusterGrayscalePS[uTileResIdx] );
+        SAFE_RELEASE( g_pDebugDrawNumLightsPerTileCompactRadarColorsPS[uTileResIdx] );
+        SAFE_RELEASE( g_pDebugDrawNumLightsPerTileCompactGrayscalePS[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCS[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSMSAA[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSNoDepth[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSDepthMask[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSMSAADepthMask[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSCompact[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSMSAACompact[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSNoDepthCompact[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSDepthMaskCompact[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSMSAADepthMaskCompact[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullClusteredCS[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullClusteredCSMSAA[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullClusteredCSNoDepth[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSHiZ[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSHiZCompact[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullClusteredCSHiZ[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSCoarse[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSMSAACoarse[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSNoDepthCoarse[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSHiZCoarse[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCoarseCS[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCoarseCSNoDepth[uTileResIdx] );
+    }
 
     SAFE_RELEASE( g_pOpaqueState );
     SAFE_RELEASE( g_pDepthOnlyAlphaTestState );
@@ -1042,6 +1525,17 @@ void CALLBACK OnGUIEvent( UINT nEvent, int nControlID, CDXUTControl* pControl, v
                     g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_LIGHT_CULLING )->GetChecked();
                 g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEBUG_DRAWING )->SetEnabled(bLightCullingEnabled);
                 g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEPTH_BOUNDS )->SetEnabled(bLightCullingEnabled);
+                g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_CLUSTERED_CULLING )->SetEnabled(bLightCullingEnabled);
+                g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_COMPACT_LIGHT_LISTS )->SetEnabled(bLightCullingEnabled);
+                g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_COARSE_TILES )->SetEnabled(bLightCullingEnabled);
+                g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_SPOT_CONE_CULLING )->SetEnabled(bLightCullingEnabled);
+                g_HUD.m_GUI.GetSlider( IDC_SLIDER_LIGHT_LOD_THRESHOLD )->SetEnabled(bLightCullingEnabled);
+                g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_LIGHT_LIST_REUSE )->SetEnabled(bLightCullingEnabled);
+                g_HUD.m_GUI.GetSlider( IDC_SLIDER_TILE_RES )->SetEnabled(bLightCullingEnabled);
+                g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEPTH_MASK )->SetEnabled(bLightCullingEnabled &&
+                    g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEPTH_BOUNDS )->GetChecked());
+                g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_HIZ )->SetEnabled(bLightCullingEnabled &&
+                    g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEPTH_BOUNDS )->GetChecked());
                 if( bLightCullingEnabled == false )
                 {
                     g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEBUG_DRAWING )->SetChecked(false);
@@ -1056,6 +1550,59 @@ void CALLBACK OnGUIEvent( UINT nEvent, int nControlID, CDXUTControl* pControl, v
                 g_HUD.m_GUI.GetRadioButton( IDC_RADIOBUTTON_DEBUG_DRAWING_TWO )->SetEnabled(bTileDrawingEnabled);
             }
             break;
+        case IDC_CHECKBOX_ENABLE_DEPTH_BOUNDS:
+            {
+                // the depth mask refines the depth bounds, so it needs them
+                bool bDepthBoundsEnabled = g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEPTH_BOUNDS )->GetEnabled() &&
+                    g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEPTH_BOUNDS )->GetChecked();
+                g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_DEPTH_MASK )->SetEnabled(bDepthBoundsEnabled);
+                g_HUD.m_GUI.GetCheckBox( IDC_CHECKBOX_ENABLE_HIZ )->SetEnabled(bDepthBoundsEnabled);
+            }
+            break;
+        case IDC_SLIDER_LIGHT_LOD_THRESHOLD:
+            {
+                // update
+                g_iLightLodThreshold = ((CDXUTSlider*)pControl)->GetValue();
+                swprintf_s( szTemp, L"Light LOD Threshold : %.1f/255", 0.5f*g_iLightLodThreshold );
+                g_HUD.m_GUI.GetStatic( IDC_STATIC_LIGHT_LOD_THRESHOLD )->SetText( szTemp );
+            }
+            break;
+        case IDC_SLIDER_TILE_RES:
+            {
+                // update
+                unsigned uTileRes = GetTileRes( (unsigned)((CDXUTSlider*)pControl)->GetValue() );
+                g_Util.SetTileRes( DXUTGetD3D11Device(), uTileRes );
+                swprintf_s( szTemp, L"Tile Size : %dx%d", uTileRes, uTileRes );
+                g_HUD.m_GUI.GetStatic( IDC_STATIC_TILE_RES )->SetText( szTemp );
+            }
+            break;
+        case IDC_SLIDER_NUM_CLUSTER_SLICES:
+            {
+                // update
+                ClusterConfig Config = g_Util.GetClusterConfig();
+                Config.uNumSlices = (unsigned)((CDXUTSlider*)pControl)->GetValue();
+                g_Util.SetClusterConfig( DXUTGetD3D11Device(), Config );
+                swprintf_s( szTemp, L"Depth Slices : %d", Config.uNumSlices );
+                g_HUD.m_GUI.GetStatic( IDC_STATIC_NUM_CLUSTER_SLICES )->SetText( szTemp );
+            }
+            break;
+        case IDC_CHECKBOX_EXPONENTIAL_CLUSTER_SLICES:
+            {
+                ClusterConfig Config = g_Util.GetClusterConfig();
+                Config.eSliceDistribution = ((CDXUTCheckBox*)pControl)->GetChecked() ? CLUSTER_SLICE_DISTRIBUTION_EXPONENTIAL : CLUSTER_SLICE_DISTRIBUTION_LINEAR;
+                g_Util.SetClusterConfig( DXUTGetD3D11Device(), Config );
+            }
+            break;
+        case IDC_SLIDER_MAX_NUM_LIGHTS_PER_CLUSTER:
+            {
+                // update
+                ClusterConfig Config = g_Util.GetClusterConfig();
+                Config.uMaxNumLightsPerCluster = (unsigned)((CDXUTSlider*)pControl)->GetValue();
+                g_Util.SetClusterConfig( DXUTGetD3D11Device(), Config );
+                swprintf_s( szTemp, L"Max Lights Per Cluster : %d", Config.uMaxNumLightsPerCluster );
+                g_HUD.m_GUI.GetStatic( IDC_STATIC_MAX_NUM_LIGHTS_PER_CLUSTER )->SetText( szTemp );
+            }
+            break;
     }
 
     // Call the MagnifyTool gui event handler
@@ -1074,26 +1621,100 @@ HRESULT AddShadersToCache()
     SAFE_RELEASE( g_pScenePositionOnlyVS );
     SAFE_RELEASE( g_pScenePositionAndTexVS );
     SAFE_RELEASE( g_pSceneVS );
-    SAFE_RELEASE( g_pScenePS );
-    SAFE_RELEASE( g_pScenePSAlphaTest );
     SAFE_RELEASE( g_pScenePSNoCull );
     SAFE_RELEASE( g_pScenePSNoCullAlphaTest );
+    SAFE_RELEASE( g_pScenePSNoCullPacked );
+    SAFE_RELEASE( g_pScenePSNoCullPackedAlphaTest );
     SAFE_RELEASE( g_pScenePSAlphaTestOnly );
-    SAFE_RELEASE( g_pDebugDrawNumLightsPerTileRadarColorsPS );
-    SAFE_RELEASE( g_pDebugDrawNumLightsPerTileGrayscalePS );
-    SAFE_RELEASE( g_pLightCullCS );
-    SAFE_RELEASE( g_pLightCullCSMSAA );
-    SAFE_RELEASE( g_pLightCullCSNoDepth );
     SAFE_RELEASE( g_pLayoutPositionOnly11 );
     SAFE_RELEASE( g_pLayoutPositionAndTex11 );
     SAFE_RELEASE( g_pLayout11 );
+    for( unsigned uTileResIdx = 0; uTileResIdx < NUM_TILE_RES; uTileResIdx++ )
+    {
+        SAFE_RELEASE( g_pScenePS[uTileResIdx] );
+        SAFE_RELEASE( g_pScenePSAlphaTest[uTileResIdx] );
+        SAFE_RELEASE( g_pScenePSClustered[uTileResIdx] );
+        SAFE_RELEASE( g_pScenePSClusteredAlphaTest[uTileResIdx] );
+        SAFE_RELEASE( g_pScenePSCompact[uTileResIdx] );
+        SAFE_RELEASE( g_pScenePSCompactAlphaTest[uTileResIdx] );
+        SAFE_RELEASE( g_pScenePSPacked[uTileResIdx] );
+        SAFE_RELEASE( g_pScenePSPackedAlphaTest[uTileResIdx] );
+        SAFE_RELEASE( g_pDebugDrawNumLightsPerTileRadarColorsPS[uTileResIdx] );
+        SAFE_RELEASE( g_pDebugDrawNumLightsPerTileGrayscalePS[uTileResIdx] );
+        SAFE_RELEASE( g_pDebugDrawNumLightsPerClusterRadarColorsPS[uTileResIdx] );
+        SAFE_RELEASE( g_pDebugDrawNumLightsPerClusterGrayscalePS[uTileResIdx] );
+        SAFE_RELEASE( g_pDebugDrawNumLightsPerTileCompactRadarColorsPS[uTileResIdx] );
+        SAFE_RELEASE( g_pDebugDrawNumLightsPerTileCompactGrayscalePS[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCS[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSMSAA[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSNoDepth[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSDepthMask[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSMSAADepthMask[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSCompact[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSMSAACompact[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSNoDepthCompact[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSDepthMaskCompact[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSMSAADepthMaskCompact[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullClusteredCS[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullClusteredCSMSAA[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullClusteredCSNoDepth[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSHiZ[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSHiZCompact[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullClusteredCSHiZ[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSCoarse[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSMSAACoarse[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSNoDepthCoarse[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCSHiZCoarse[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCoarseCS[uTileResIdx] );
+        SAFE_RELEASE( g_pLightCullCoarseCSNoDepth[uTileResIdx] );
+    }
     
-    AMD::ShaderCache::Macro ShaderMacros[2];
+    // The macros of the tile-size-dependent shaders end with TILE_RES
+    AMD::ShaderCache::Macro ShaderMacros[3];
     wcscpy_s( ShaderMacros[0].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_ALPHA_TEST" );
     wcscpy_s( ShaderMacros[1].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_LIGHT_CULLING" );
-
-    AMD::ShaderCache::Macro ShaderMacroUseDepthBounds;
-    wcscpy_s( ShaderMacroUseDepthBounds.m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_DEPTH_BOUNDS" );
+    wcscpy_s( ShaderMacros[2].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"TILE_RES" );
+
+    AMD::ShaderCache::Macro ShaderMacroTileRes;
+    wcscpy_s( ShaderMacroTileRes.m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"TILE_RES" );
+
+    AMD::ShaderCache::Macro ShaderMacrosUseDepthBounds[2];
+    wcscpy_s( ShaderMacrosUseDepthBounds[0].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_DEPTH_BOUNDS" );
+    wcscpy_s( ShaderMacrosUseDepthBounds[1].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"TILE_RES" );
+
+    AMD::ShaderCache::Macro ShaderMacrosDepthMask[3];
+    wcscpy_s( ShaderMacrosDepthMask[0].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_DEPTH_BOUNDS" );
+    wcscpy_s( ShaderMacrosDepthMask[1].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_DEPTH_MASK" );
+    wcscpy_s( ShaderMacrosDepthMask[2].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"TILE_RES" );
+
+    AMD::ShaderCache::Macro ShaderMacrosCompact[4];
+    wcscpy_s( ShaderMacrosCompact[0].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_ALPHA_TEST" );
+    wcscpy_s( ShaderMacrosCompact[1].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_LIGHT_CULLING" );
+    wcscpy_s( ShaderMacrosCompact[2].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_COMPACT_LIGHT_LISTS" );
+    wcscpy_s( ShaderMacrosCompact[3].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"TILE_RES" );
+
+    AMD::ShaderCache::Macro ShaderMacrosPacked[4];
+    wcscpy_s( ShaderMacrosPacked[0].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_ALPHA_TEST" );
+    wcscpy_s( ShaderMacrosPacked[1].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_LIGHT_CULLING" );
+    wcscpy_s( ShaderMacrosPacked[2].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_PACKED_LIGHTS" );
+    wcscpy_s( ShaderMacrosPacked[3].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"TILE_RES" );
+
+    AMD::ShaderCache::Macro ShaderMacrosCompactCS[4];
+    wcscpy_s( ShaderMacrosCompactCS[0].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_DEPTH_BOUNDS" );
+    wcscpy_s( ShaderMacrosCompactCS[1].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_DEPTH_MASK" );
+    wcscpy_s( ShaderMacrosCompactCS[2].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_COMPACT_LIGHT_LISTS" );
+    wcscpy_s( ShaderMacrosCompactCS[3].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"TILE_RES" );
+
+    AMD::ShaderCache::Macro ShaderMacrosCoarseTiles[3];
+    wcscpy_s( ShaderMacrosCoarseTiles[0].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_DEPTH_BOUNDS" );
+    wcscpy_s( ShaderMacrosCoarseTiles[1].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_COARSE_TILES" );
+    wcscpy_s( ShaderMacrosCoarseTiles[2].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"TILE_RES" );
+
+    AMD::ShaderCache::Macro ShaderMacrosClustered[4];
+    wcscpy_s( ShaderMacrosClustered[0].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_ALPHA_TEST" );
+    wcscpy_s( ShaderMacrosClustered[1].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_LIGHT_CULLING" );
+    wcscpy_s( ShaderMacrosClustered[2].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_CLUSTERED_LIGHTING" );
+    wcscpy_s( ShaderMacrosClustered[3].m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"TILE_RES" );
 
     const D3D11_INPUT_ELEMENT_DESC Layout[] =
     {
@@ -1112,16 +1733,7 @@ HRESULT AddShadersToCache()
     g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pSceneVS, AMD::ShaderCache::SHADER_TYPE_VERTEX, L"vs_5_0", L"RenderSceneVS",
         L"ForwardPlus11.hlsl", 0, NULL, &g_pLayout11, (D3D11_INPUT_ELEMENT_DESC*)Layout, ARRAYSIZE( Layout ) );
 
-    ShaderMacros[0].m_iValue = 0;
-    ShaderMacros[1].m_iValue = 1;
-    g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePS, AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderScenePS",
-        L"ForwardPlus11.hlsl", 2, ShaderMacros, NULL, NULL, 0 );
-
-    ShaderMacros[0].m_iValue = 1;
-    ShaderMacros[1].m_iValue = 1;
-    g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePSAlphaTest, AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderScenePS",
-        L"ForwardPlus11.hlsl", 2, ShaderMacros, NULL, NULL, 0 );
-
+    // the no-cull shaders do not use the light lists, so one permutation covers every tile size
     ShaderMacros[0].m_iValue = 0;
     ShaderMacros[1].m_iValue = 0;
     g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePSNoCull, AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderScenePS",
@@ -1132,26 +1744,206 @@ HRESULT AddShadersToCache()
     g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePSNoCullAlphaTest, AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderScenePS",
         L"ForwardPlus11.hlsl", 2, ShaderMacros, NULL, NULL, 0 );
 
-    g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePSAlphaTestOnly, AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderSceneAlphaTestOnlyPS",
-        L"ForwardPlus11.hlsl", 0, NULL, NULL, NULL, 0 );
-
-    g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pDebugDrawNumLightsPerTileRadarColorsPS, AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"DebugDrawNumLightsPerTileRadarColorsPS",
-        L"ForwardPlus11DebugDraw.hlsl", 0, NULL, NULL, NULL, 0 );
-
-    g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pDebugDrawNumLightsPerTileGrayscalePS, AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"DebugDrawNumLightsPerTileGrayscalePS",
-        L"ForwardPlus11DebugDraw.hlsl", 0, NULL, NULL, NULL, 0 );
+    ShaderMacrosPacked[0].m_iValue = 0;
+    ShaderMacrosPacked[1].m_iValue = 0;
+    ShaderMacrosPacked[2].m_iValue = 1;
+    g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePSNoCullPacked, AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderScenePS",
+        L"ForwardPlus11.hlsl", 3, ShaderMacrosPacked, NULL, NULL, 0 );
 
-    ShaderMacroUseDepthBounds.m_iValue = 1;
-    g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCS, AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
-        L"ForwardPlus11Tiling.hlsl", 1, &ShaderMacroUseDepthBounds, NULL, NULL, 0 );
+    ShaderMacrosPacked[0].m_iValue = 1;
+    ShaderMacrosPacked[1].m_iValue = 0;
+    ShaderMacrosPacked[2].m_iValue = 1;
+    g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePSNoCullPackedAlphaTest, AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderScenePS",
+        L"ForwardPlus11.hlsl", 3, ShaderMacrosPacked, NULL, NULL, 0 );
 
-    ShaderMacroUseDepthBounds.m_iValue = 2;
-    g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSMSAA, AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
-        L"ForwardPlus11Tiling.hlsl", 1, &ShaderMacroUseDepthBounds, NULL, NULL, 0 );
+    g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePSAlphaTestOnly, AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderSceneAlphaTestOnlyPS",
+        L"ForwardPlus11.hlsl", 0, NULL, NULL, NULL, 0 );
 
-    ShaderMacroUseDepthBounds.m_iValue = 0;
-    g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSNoDepth, AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
-        L"ForwardPlus11Tiling.hlsl", 1, &ShaderMacroUseDepthBounds, NULL, NULL, 0 );
+    // and one permutation of everything else per tile size
+    for( unsigned uTileResIdx = 0; uTileResIdx < NUM_TILE_RES; uTileResIdx++ )
+    {
+        const int iTileRes = (int)GetTileRes( uTileResIdx );
+        ShaderMacros[2].m_iValue = iTileRes;
+        ShaderMacroTileRes.m_iValue = iTileRes;
+        ShaderMacrosUseDepthBounds[1].m_iValue = iTileRes;
+        ShaderMacrosDepthMask[2].m_iValue = iTileRes;
+        ShaderMacrosCompact[3].m_iValue = iTileRes;
+        ShaderMacrosCompactCS[3].m_iValue = iTileRes;
+        ShaderMacrosPacked[3].m_iValue = iTileRes;
+        ShaderMacrosCoarseTiles[2].m_iValue = iTileRes;
+        ShaderMacrosClustered[3].m_iValue = iTileRes;
+
+        ShaderMacros[0].m_iValue = 0;
+        ShaderMacros[1].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePS[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderScenePS",
+            L"ForwardPlus11.hlsl", 3, ShaderMacros, NULL, NULL, 0 );
+
+        ShaderMacros[0].m_iValue = 1;
+        ShaderMacros[1].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePSAlphaTest[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderScenePS",
+            L"ForwardPlus11.hlsl", 3, ShaderMacros, NULL, NULL, 0 );
+
+        ShaderMacrosClustered[0].m_iValue = 0;
+        ShaderMacrosClustered[1].m_iValue = 1;
+        ShaderMacrosClustered[2].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePSClustered[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderScenePS",
+            L"ForwardPlus11.hlsl", 4, ShaderMacrosClustered, NULL, NULL, 0 );
+
+        ShaderMacrosClustered[0].m_iValue = 1;
+        ShaderMacrosClustered[1].m_iValue = 1;
+        ShaderMacrosClustered[2].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePSClusteredAlphaTest[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderScenePS",
+            L"ForwardPlus11.hlsl", 4, ShaderMacrosClustered, NULL, NULL, 0 );
+
+        ShaderMacrosCompact[0].m_iValue = 0;
+        ShaderMacrosCompact[1].m_iValue = 1;
+        ShaderMacrosCompact[2].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePSCompact[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderScenePS",
+            L"ForwardPlus11.hlsl", 4, ShaderMacrosCompact, NULL, NULL, 0 );
+
+        ShaderMacrosCompact[0].m_iValue = 1;
+        ShaderMacrosCompact[1].m_iValue = 1;
+        ShaderMacrosCompact[2].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePSCompactAlphaTest[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderScenePS",
+            L"ForwardPlus11.hlsl", 4, ShaderMacrosCompact, NULL, NULL, 0 );
+
+        ShaderMacrosPacked[0].m_iValue = 0;
+        ShaderMacrosPacked[1].m_iValue = 1;
+        ShaderMacrosPacked[2].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePSPacked[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderScenePS",
+            L"ForwardPlus11.hlsl", 4, ShaderMacrosPacked, NULL, NULL, 0 );
+
+        ShaderMacrosPacked[0].m_iValue = 1;
+        ShaderMacrosPacked[1].m_iValue = 1;
+        ShaderMacrosPacked[2].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pScenePSPackedAlphaTest[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"RenderScenePS",
+            L"ForwardPlus11.hlsl", 4, ShaderMacrosPacked, NULL, NULL, 0 );
+
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pDebugDrawNumLightsPerTileRadarColorsPS[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"DebugDrawNumLightsPerTileRadarColorsPS",
+            L"ForwardPlus11DebugDraw.hlsl", 1, &ShaderMacroTileRes, NULL, NULL, 0 );
+
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pDebugDrawNumLightsPerTileGrayscalePS[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"DebugDrawNumLightsPerTileGrayscalePS",
+            L"ForwardPlus11DebugDraw.hlsl", 1, &ShaderMacroTileRes, NULL, NULL, 0 );
+
+        ShaderMacrosClustered[2].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pDebugDrawNumLightsPerClusterRadarColorsPS[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"DebugDrawNumLightsPerTileRadarColorsPS",
+            L"ForwardPlus11DebugDraw.hlsl", 2, &ShaderMacrosClustered[2], NULL, NULL, 0 );
+
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pDebugDrawNumLightsPerClusterGrayscalePS[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"DebugDrawNumLightsPerTileGrayscalePS",
+            L"ForwardPlus11DebugDraw.hlsl", 2, &ShaderMacrosClustered[2], NULL, NULL, 0 );
+
+        ShaderMacrosCompact[2].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pDebugDrawNumLightsPerTileCompactRadarColorsPS[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"DebugDrawNumLightsPerTileRadarColorsPS",
+            L"ForwardPlus11DebugDraw.hlsl", 2, &ShaderMacrosCompact[2], NULL, NULL, 0 );
+
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pDebugDrawNumLightsPerTileCompactGrayscalePS[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"DebugDrawNumLightsPerTileGrayscalePS",
+            L"ForwardPlus11DebugDraw.hlsl", 2, &ShaderMacrosCompact[2], NULL, NULL, 0 );
+
+        ShaderMacrosUseDepthBounds[0].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCS[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 2, ShaderMacrosUseDepthBounds, NULL, NULL, 0 );
+
+        ShaderMacrosUseDepthBounds[0].m_iValue = 2;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSMSAA[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 2, ShaderMacrosUseDepthBounds, NULL, NULL, 0 );
+
+        ShaderMacrosUseDepthBounds[0].m_iValue = 0;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSNoDepth[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 2, ShaderMacrosUseDepthBounds, NULL, NULL, 0 );
+
+        ShaderMacrosDepthMask[0].m_iValue = 1;
+        ShaderMacrosDepthMask[1].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSDepthMask[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 3, ShaderMacrosDepthMask, NULL, NULL, 0 );
+
+        ShaderMacrosDepthMask[0].m_iValue = 2;
+        ShaderMacrosDepthMask[1].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSMSAADepthMask[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 3, ShaderMacrosDepthMask, NULL, NULL, 0 );
+
+        ShaderMacrosCompactCS[0].m_iValue = 1;
+        ShaderMacrosCompactCS[1].m_iValue = 0;
+        ShaderMacrosCompactCS[2].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSCompact[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 4, ShaderMacrosCompactCS, NULL, NULL, 0 );
+
+        ShaderMacrosCompactCS[0].m_iValue = 2;
+        ShaderMacrosCompactCS[1].m_iValue = 0;
+        ShaderMacrosCompactCS[2].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSMSAACompact[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 4, ShaderMacrosCompactCS, NULL, NULL, 0 );
+
+        ShaderMacrosCompactCS[0].m_iValue = 0;
+        ShaderMacrosCompactCS[1].m_iValue = 0;
+        ShaderMacrosCompactCS[2].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSNoDepthCompact[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 4, ShaderMacrosCompactCS, NULL, NULL, 0 );
+
+        ShaderMacrosCompactCS[0].m_iValue = 1;
+        ShaderMacrosCompactCS[1].m_iValue = 1;
+        ShaderMacrosCompactCS[2].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSDepthMaskCompact[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 4, ShaderMacrosCompactCS, NULL, NULL, 0 );
+
+        ShaderMacrosCompactCS[0].m_iValue = 2;
+        ShaderMacrosCompactCS[1].m_iValue = 1;
+        ShaderMacrosCompactCS[2].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSMSAADepthMaskCompact[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 4, ShaderMacrosCompactCS, NULL, NULL, 0 );
+
+        ShaderMacrosUseDepthBounds[0].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullClusteredCS[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsClusteredCS",
+            L"ForwardPlus11Tiling.hlsl", 2, ShaderMacrosUseDepthBounds, NULL, NULL, 0 );
+
+        ShaderMacrosUseDepthBounds[0].m_iValue = 2;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullClusteredCSMSAA[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsClusteredCS",
+            L"ForwardPlus11Tiling.hlsl", 2, ShaderMacrosUseDepthBounds, NULL, NULL, 0 );
+
+        ShaderMacrosUseDepthBounds[0].m_iValue = 0;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullClusteredCSNoDepth[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsClusteredCS",
+            L"ForwardPlus11Tiling.hlsl", 2, ShaderMacrosUseDepthBounds, NULL, NULL, 0 );
+
+        // the Hi-Z permutations read the depth bounds from the pyramid, so MSAA needs no variant of its own
+        ShaderMacrosUseDepthBounds[0].m_iValue = 3;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSHiZ[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 2, ShaderMacrosUseDepthBounds, NULL, NULL, 0 );
+
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullClusteredCSHiZ[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsClusteredCS",
+            L"ForwardPlus11Tiling.hlsl", 2, ShaderMacrosUseDepthBounds, NULL, NULL, 0 );
+
+        ShaderMacrosCompactCS[0].m_iValue = 3;
+        ShaderMacrosCompactCS[1].m_iValue = 0;
+        ShaderMacrosCompactCS[2].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSHiZCompact[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 4, ShaderMacrosCompactCS, NULL, NULL, 0 );
+
+        // two-level culling: the second pass for each kind of depth bounds...
+        ShaderMacrosCoarseTiles[0].m_iValue = 1;
+        ShaderMacrosCoarseTiles[1].m_iValue = 1;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSCoarse[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 3, ShaderMacrosCoarseTiles, NULL, NULL, 0 );
+
+        ShaderMacrosCoarseTiles[0].m_iValue = 2;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSMSAACoarse[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 3, ShaderMacrosCoarseTiles, NULL, NULL, 0 );
+
+        ShaderMacrosCoarseTiles[0].m_iValue = 0;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSNoDepthCoarse[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 3, ShaderMacrosCoarseTiles, NULL, NULL, 0 );
+
+        ShaderMacrosCoarseTiles[0].m_iValue = 3;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCSHiZCoarse[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCS",
+            L"ForwardPlus11Tiling.hlsl", 3, ShaderMacrosCoarseTiles, NULL, NULL, 0 );
+
+        // ...and the first pass, which only reads depth bounds from the Hi-Z pyramid
+        ShaderMacrosUseDepthBounds[0].m_iValue = 3;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCoarseCS[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCoarseCS",
+            L"ForwardPlus11Tiling.hlsl", 2, ShaderMacrosUseDepthBounds, NULL, NULL, 0 );
+
+        ShaderMacrosUseDepthBounds[0].m_iValue = 0;
+        g_ShaderCache.AddShader( (ID3D11DeviceChild**)&g_pLightCullCoarseCSNoDepth[uTileResIdx], AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"CullLightsCoarseCS",
+            L"ForwardPlus11Tiling.hlsl", 2, ShaderMacrosUseDepthBounds, NULL, NULL, 0 );
+    }
 
     g_Util.AddShadersToCache(&g_ShaderCache);
 
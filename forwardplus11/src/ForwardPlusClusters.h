@@ -0,0 +1,139 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusClusters.h
+//
+// Cluster (froxel) layout for clustered light culling. Each screen tile is cut
+// into depth slices, and every tile/slice pair (a cluster) gets its own light list.
+//
+// The slice math here must match GetClusterSlice and GetClusterSliceBounds in
+// ForwardPlus11Common.hlsl.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <float.h>
+#include <math.h>
+
+namespace ForwardPlus11
+{
+    // Cluster limits.
+    // These must match their counterparts in ForwardPlus11Common.hlsl
+    static const unsigned MAX_NUM_CLUSTER_SLICES = 64;
+    static const unsigned MAX_NUM_LIGHTS_PER_CLUSTER = 256;
+
+    enum ClusterSliceDistribution
+    {
+        // slice 0 is [0,fNearZ], then uNumSlices-1 slices with a constant far/near
+        // ratio up to fFarZ, so that clusters stay roughly cube shaped
+        CLUSTER_SLICE_DISTRIBUTION_EXPONENTIAL = 0,
+
+        // uNumSlices slices of equal thickness from 0 to fFarZ
+        CLUSTER_SLICE_DISTRIBUTION_LINEAR = 1
+    };
+
+    //--------------------------------------------------------------------------------------
+    // Everything needed to map a view-space depth to a slice. The last slice always
+    // extends to infinity, so that nothing beyond fFarZ falls outside the clusters.
+    //--------------------------------------------------------------------------------------
+    struct ClusterConfig
+    {
+        unsigned                    uNumSlices;                 // [1,MAX_NUM_CLUSTER_SLICES]
+        unsigned                    uMaxNumLightsPerCluster;    // [2,MAX_NUM_LIGHTS_PER_CLUSTER], including the two sentinels
+        float                       fNearZ;                     // end of slice 0 (exponential only)
+        float                       fFarZ;
+        ClusterSliceDistribution    eSliceDistribution;
+    };
+
+    //--------------------------------------------------------------------------------------
+    // A reasonable default for a camera whose far plane is at fFarZ
+    //--------------------------------------------------------------------------------------
+    inline ClusterConfig GetDefaultClusterConfig( float fFarZ )
+    {
+        ClusterConfig Config;
+        Config.uNumSlices = 16;
+        Config.uMaxNumLightsPerCluster = 64;
+        Config.fNearZ = 0.02f*fFarZ;
+        Config.fFarZ = fFarZ;
+        Config.eSliceDistribution = CLUSTER_SLICE_DISTRIBUTION_EXPONENTIAL;
+        return Config;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Which slice a view-space depth falls into
+    //--------------------------------------------------------------------------------------
+    inline unsigned GetClusterSlice( const ClusterConfig& Config, float fViewZ )
+    {
+        if( Config.uNumSlices <= 1 )
+        {
+            return 0;
+        }
+
+        float fSlice;
+        if( Config.eSliceDistribution == CLUSTER_SLICE_DISTRIBUTION_EXPONENTIAL )
+        {
+            if( fViewZ < Config.fNearZ )
+            {
+                return 0;
+            }
+            fSlice = 1.f + floorf( logf( fViewZ / Config.fNearZ ) * (float)( Config.uNumSlices - 1 ) / logf( Config.fFarZ / Config.fNearZ ) );
+        }
+        else
+        {
+            fSlice = floorf( fViewZ * (float)Config.uNumSlices / Config.fFarZ );
+        }
+
+        fSlice = ( fSlice < 0.f ) ? 0.f : fSlice;
+        return ( fSlice < (float)( Config.uNumSlices - 1 ) ) ? (unsigned)fSlice : Config.uNumSlices - 1;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The view-space depth range a slice covers
+    //--------------------------------------------------------------------------------------
+    inline void GetClusterSliceBounds( const ClusterConfig& Config, unsigned uSlice, float* pNearZ, float* pFarZ )
+    {
+        if( Config.eSliceDistribution == CLUSTER_SLICE_DISTRIBUTION_EXPONENTIAL )
+        {
+            float fRatio = Config.fFarZ / Config.fNearZ;
+            float fNumExpSlices = (float)( Config.uNumSlices - 1 );
+            *pNearZ = ( uSlice == 0 ) ? 0.f : Config.fNearZ * powf( fRatio, (float)( uSlice - 1 ) / fNumExpSlices );
+            *pFarZ = Config.fNearZ * powf( fRatio, (float)uSlice / fNumExpSlices );
+        }
+        else
+        {
+            float fSliceThickness = Config.fFarZ / (float)Config.uNumSlices;
+            *pNearZ = (float)uSlice * fSliceThickness;
+            *pFarZ = (float)( uSlice + 1 ) * fSliceThickness;
+        }
+
+        if( uSlice + 1 >= Config.uNumSlices )
+        {
+            *pFarZ = FLT_MAX;
+        }
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,92 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusCompactLists.h
+//
+// Layout of the compact light index buffer (USE_COMPACT_LIGHT_LISTS). Instead of a
+// fixed slot of GetMaxNumLightsPerTile() entries per tile, every tile gets a small
+// header, and the lists themselves are packed back to back into one dense array.
+//
+// Everything lives in a single R32_UINT buffer, so that it binds to the same slots
+// as the fixed-slot light index buffer:
+//
+//   [COMPACT_LIST_COUNTER_OFFSET]      allocation counter (cleared to 0 every frame)
+//   [COMPACT_LIST_EMPTY_LIST_OFFSET]   two sentinels, an empty list
+//   [COMPACT_LIST_HEADER_OFFSET]       two entries per tile:
+//                                        offset of the list in the buffer
+//                                        number of point lights | number of spot lights << 16
+//   [GetCompactListDataOffset()]       the lists, each holding the point light indices,
+//                                      a sentinel, the spot light indices, and another
+//                                      sentinel (same as in a fixed slot)
+//
+// Tiles whose list does not fit into what is left of the buffer point at the empty list.
+// Several tiles can point at the same list (see CpuLightCuller::BuildSharedLightIndexBuffer).
+//
+// This must match the compact list code in ForwardPlus11Common.hlsl.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+namespace ForwardPlus11
+{
+    static const unsigned COMPACT_LIST_COUNTER_OFFSET = 0;
+    static const unsigned COMPACT_LIST_EMPTY_LIST_OFFSET = 1;
+    static const unsigned COMPACT_LIST_HEADER_OFFSET = 4;
+    static const unsigned COMPACT_LIST_HEADER_SIZE = 2;
+
+    // How much room the list data gets, on average per tile (including the two sentinels).
+    // A quarter of MAX_NUM_LIGHTS_PER_TILE, so the buffer is about a quarter the size 
+    // of the fixed-slot one, while still leaving plenty of room for busy tiles.
+    static const unsigned COMPACT_LIST_AVERAGE_NUM_ENTRIES_PER_TILE = 136;
+
+    //--------------------------------------------------------------------------------------
+    // Where the list data starts, after the headers of all uNumTiles tiles
+    //--------------------------------------------------------------------------------------
+    inline unsigned GetCompactListDataOffset( unsigned uNumTiles )
+    {
+        return COMPACT_LIST_HEADER_OFFSET + COMPACT_LIST_HEADER_SIZE*uNumTiles;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Size of the whole buffer (in entries), with uAverageNumEntriesPerTile entries of 
+    // list data per tile
+    //--------------------------------------------------------------------------------------
+    inline unsigned GetCompactLightIndexBufferNumElements( unsigned uNumTiles, unsigned uAverageNumEntriesPerTile )
+    {
+        return GetCompactListDataOffset( uNumTiles ) + uAverageNumEntriesPerTile*uNumTiles;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The second header entry
+    //--------------------------------------------------------------------------------------
+    inline unsigned PackCompactListCounts( unsigned uNumPointLights, unsigned uNumSpotLights )
+    {
+        return ( uNumSpotLights << 16 ) | ( uNumPointLights & 0xFFFF );
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,3459 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusCpuBenchmark.cpp
+//
+// Headless benchmarks for the CPU side of the ForwardPlus11 sample.
+//--------------------------------------------------------------------------------------
+
+#include "ForwardPlusCpuBenchmark.h"
+#include "ForwardPlusCpuCuller.h"
+#include "ForwardPlusCpuShading.h"
+#include "ForwardPlusCullingQuality.h"
+#include "ForwardPlusHalf.h"
+#include "ForwardPlusHiZ.h"
+#include "ForwardPlusLightAnimation.h"
+#include "ForwardPlusLightFrustumCull.h"
+#include "ForwardPlusLightPacking.h"
+#include "ForwardPlusLightSort.h"
+#include "ForwardPlusParallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+using namespace DirectX;
+using namespace ForwardPlus11;
+
+//-----------------------------------------------------------------------------------------
+// Helpers shared by the benchmarks
+//-----------------------------------------------------------------------------------------
+
+// same values as the sample's camera
+static const float BENCHMARK_FOV_Y = 3.14159265f / 4.f;
+static const float BENCHMARK_NEAR = 0.1f;
+static const float BENCHMARK_FAR = 500.f;
+
+// deterministic random numbers, independent of rand() and the platform
+class BenchmarkRandom
+{
+public:
+    explicit BenchmarkRandom( unsigned uSeed ) : m_uState( uSeed ) {}
+
+    // uniform in [fMin,fMax)
+    float Next( float fMin, float fMax )
+    {
+        m_uState = m_uState*1664525u + 1013904223u;
+        return fMin + ( fMax - fMin )*( (float)( m_uState >> 8 ) / 16777216.f );
+    }
+
+private:
+    unsigned m_uState;
+};
+
+static double GetTimeInMs()
+{
+    return std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now().time_since_epoch() ).count();
+}
+
+// the projection the sample uses (inverted depth, since the camera's near and far
+// planes are swapped), and its inverse, built the same way ForwardPlus11.cpp does
+static void BuildBenchmarkProjection( unsigned uWidth, unsigned uHeight, XMFLOAT4X4* pProjection, XMFLOAT4X4* pProjectionInv )
+{
+    float fZNear = BENCHMARK_FAR;
+    float fZFar = BENCHMARK_NEAR;
+    float fYScale = 1.f / tanf( 0.5f*BENCHMARK_FOV_Y );
+    float fXScale = fYScale / ( (float)uWidth / (float)uHeight );
+    float fRange = fZFar / ( fZFar - fZNear );
+
+    memset( pProjection, 0, sizeof(XMFLOAT4X4) );
+    pProjection->_11 = fXScale;
+    pProjection->_22 = fYScale;
+    pProjection->_33 = fRange;
+    pProjection->_34 = 1.f;
+    pProjection->_43 = -fRange*fZNear;
+
+    memset( pProjectionInv, 0, sizeof(XMFLOAT4X4) );
+    pProjectionInv->_11 = 1.f / pProjection->_11;
+    pProjectionInv->_22 = 1.f / pProjection->_22;
+    pProjectionInv->_34 = 1.f / pProjection->_43;
+    pProjectionInv->_43 = 1.f;
+    pProjectionInv->_44 = -pProjection->_33 / pProjection->_43;
+}
+
+static void SetIdentity( XMFLOAT4X4* pMatrix )
+{
+    memset( pMatrix, 0, sizeof(XMFLOAT4X4) );
+    pMatrix->_11 = pMatrix->_22 = pMatrix->_33 = pMatrix->_44 = 1.f;
+}
+
+// view-space bounding spheres spread over the view frustum (with some outside it),
+// shrinking as their number grows, so that no tile overflows its list
+static void BuildBenchmarkLights( unsigned uNumLights, unsigned uSeed, std::vector<XMFLOAT4>& Lights )
+{
+    BenchmarkRandom Random( uSeed );
+    float fRadius = 12.f*sqrtf( 2048.f / (float)uNumLights );
+
+    Lights.resize( uNumLights );
+    for( unsigned i = 0; i < uNumLights; i++ )
+    {
+        float z = Random.Next( 0.f, 400.f );
+        float fHalfHeight = 0.5f*( z + 10.f );
+        Lights[i] = XMFLOAT4( Random.Next( -2.f*fHalfHeight, 2.f*fHalfHeight ), Random.Next( -1.2f*fHalfHeight, 1.2f*fHalfHeight ), z, fRadius );
+    }
+}
+
+// a depth buffer for a simple scene: a floor that recedes into the distance,
+// a wall at the back, and sky (cleared depth) above the wall
+static void BuildBenchmarkDepthBuffer( unsigned uWidth, unsigned uHeight, const XMFLOAT4X4& Projection, std::vector<float>& DepthBuffer )
+{
+    DepthBuffer.resize( uWidth*uHeight );
+    for( unsigned y = 0; y < uHeight; y++ )
+    {
+        float fNdcY = 1.f - 2.f*( (float)y + 0.5f ) / (float)uHeight;
+        for( unsigned x = 0; x < uWidth; x++ )
+        {
+            // view-space depth of the floor (y = -20) along this pixel's ray
+            float fViewZ = ( fNdcY < 0.f ) ? -20.f*Projection._22 / fNdcY : BENCHMARK_FAR;
+            if( fViewZ > 300.f )
+            {
+                fViewZ = ( fNdcY < 0.5f ) ? 300.f : 0.f;
+            }
+
+            // project it, or leave it cleared for the sky
+            DepthBuffer[y*uWidth + x] = ( fViewZ == 0.f ) ? 0.f : ( fViewZ*Projection._33 + Projection._43 ) / fViewZ;
+        }
+    }
+}
+
+// whether a view-space position is lit by a spot light, like RenderScenePS, but staying 
+// clear of the boundary of the lit volume, where rounding can go either way
+static bool IsInsideSpotLight( const XMFLOAT4& CenterAndRadius, const SpotParams& Params, float x, float y, float z )
+{
+    SpotLightCone Cone;
+    UnpackSpotParams( Params, &Cone );
+
+    float fToPixelX = x - ( CenterAndRadius.x - CenterAndRadius.w*Cone.vLightDir.x );
+    float fToPixelY = y - ( CenterAndRadius.y - CenterAndRadius.w*Cone.vLightDir.y );
+    float fToPixelZ = z - ( CenterAndRadius.z - CenterAndRadius.w*Cone.vLightDir.z );
+    float fDistance = sqrtf( fToPixelX*fToPixelX + fToPixelY*fToPixelY + fToPixelZ*fToPixelZ );
+    float fCosine = ( fToPixelX*Cone.vLightDir.x + fToPixelY*Cone.vLightDir.y + fToPixelZ*Cone.vLightDir.z ) / fDistance;
+    return fDistance < 0.99f*Cone.fFalloffRadius && fCosine > Cone.fCosineOfConeAngle + 0.01f*( 1.f - Cone.fCosineOfConeAngle );
+}
+
+// the cones InitLights fits into the bounding spheres of the spot lights: 4/3 of the 
+// sphere radius high, with a cosine of the cone angle of sqrt(2/3), pointing in 
+// random directions (half of them down, half of them up)
+static void BuildBenchmarkSpotParams( const std::vector<XMFLOAT4>& SpotLights, unsigned uSeed, std::vector<SpotParams>& SpotLightSpotParams )
+{
+    BenchmarkRandom Random( uSeed );
+    SpotLightSpotParams.resize( SpotLights.size() );
+    for( unsigned i = 0; i < (unsigned)SpotLights.size(); i++ )
+    {
+        XMFLOAT3 vLightDir( Random.Next( -1.f, 1.f ), Random.Next( 0.1f, 1.f ), Random.Next( -1.f, 1.f ) );
+        vLightDir.y = ( i % 2 == 0 ) ? -vLightDir.y : vLightDir.y;
+        float fLength = sqrtf( vLightDir.x*vLightDir.x + vLightDir.y*vLightDir.y + vLightDir.z*vLightDir.z );
+        vLightDir = XMFLOAT3( vLightDir.x / fLength, vLightDir.y / fLength, vLightDir.z / fLength );
+        SpotLightSpotParams[i] = PackSpotParams( vLightDir, 0.816496580927726f, 1.333333333333f*SpotLights[i].w );
+    }
+}
+
+// Walks over the pixels of a depth buffer and looks up the list each one would use 
+// (by tile, or by tile and depth slice when clustered), returning the average list 
+// length over the non-sky pixels in *pNumLightsPerPixel. Every uPixelStep'th pixel 
+// in x and y is also checked against brute force: every light whose sphere contains 
+// the pixel's view-space position must be in its list (unless the list is full). 
+// When the spot lights were culled by their cones, a spot light only has to be in 
+// the list if it lights the pixel.
+static bool CheckLightListsAgainstPixels( const CpuLightCuller& Culler, const CpuLightCullDesc& Desc, const float* pDepthBuffer,
+                                          const std::vector<XMFLOAT4>& PointLights, const std::vector<XMFLOAT4>& SpotLights,
+                                          unsigned uPixelStep, double* pNumLightsPerPixel )
+{
+    const XMFLOAT4X4& ProjectionInv = Desc.mProjectionInv;
+    unsigned uNumTilesX = Culler.GetNumTilesX();
+    unsigned uNumTilesY = Culler.GetNumTilesY();
+
+    bool bMatches = true;
+    double fTotalNumLights = 0.0;
+    unsigned uNumPixels = 0;
+    for( unsigned y = 0; y < Desc.uWindowHeight; y++ )
+    {
+        for( unsigned x = 0; x < Desc.uWindowWidth; x++ )
+        {
+            float fDepth = pDepthBuffer[y*Desc.uWindowWidth + x];
+            if( fDepth == 0.f )
+            {
+                // sky, not shaded
+                continue;
+            }
+
+            float fViewZ = 1.f / ( fDepth*ProjectionInv._34 + ProjectionInv._44 );
+            unsigned uTileIdx = ( x / Culler.GetTileRes() ) + ( y / Culler.GetTileRes() )*uNumTilesX;
+            unsigned uListIdx = Desc.pClusterConfig ? Culler.GetClusterIndex( uTileIdx, GetClusterSlice( *Desc.pClusterConfig, fViewZ ) ) : uTileIdx;
+
+            unsigned uNumPointLightsInList = Culler.GetNumPointLightsInTile( uListIdx );
+            unsigned uNumSpotLightsInList = Culler.GetNumSpotLightsInTile( uListIdx );
+            fTotalNumLights += uNumPointLightsInList + uNumSpotLightsInList;
+            uNumPixels++;
+
+            // lists that overflowed are missing lights by design
+            if( ( x % uPixelStep ) != 0 || ( y % uPixelStep ) != 0 ||
+                uNumPointLightsInList + uNumSpotLightsInList + 2 >= Culler.GetMaxNumLightsPerList() )
+            {
+                continue;
+            }
+
+            // the tile frustums map the window, rounded up to whole tiles, onto [-1,1]
+            // (see CalculateTileFrustum), so place the pixel the same way
+            float fViewX = ( 2.f*( (float)x + 0.5f ) / (float)( Culler.GetTileRes()*uNumTilesX ) - 1.f )*ProjectionInv._11*fViewZ;
+            float fViewY = ( 1.f - 2.f*( (float)y + 0.5f ) / (float)( Culler.GetTileRes()*uNumTilesY ) )*ProjectionInv._22*fViewZ;
+
+            for( int nType = 0; nType < 2; nType++ )
+            {
+                const std::vector<XMFLOAT4>& Lights = nType ? SpotLights : PointLights;
+                const unsigned* pList = nType ? Culler.GetSpotLightsInTile( uListIdx ) : Culler.GetPointLightsInTile( uListIdx );
+                unsigned uNumLightsInList = nType ? uNumSpotLightsInList : uNumPointLightsInList;
+
+                bool bSpotCones = ( nType != 0 ) && ( Desc.pSpotLightSpotParams != NULL ) && ( Desc.pClusterConfig == NULL );
+                for( unsigned i = 0; i < (unsigned)Lights.size(); i++ )
+                {
+                    float dx = Lights[i].x - fViewX;
+                    float dy = Lights[i].y - fViewY;
+                    float dz = Lights[i].z - fViewZ;
+                    // stay clear of the boundary, where rounding can go either way
+                    if( dx*dx + dy*dy + dz*dz < 0.99f*Lights[i].w*Lights[i].w &&
+                        ( !bSpotCones || IsInsideSpotLight( Lights[i], Desc.pSpotLightSpotParams[i], fViewX, fViewY, fViewZ ) ) )
+                    {
+                        bMatches = bMatches && std::binary_search( pList, pList + uNumLightsInList, i );
+                    }
+                }
+            }
+        }
+    }
+
+    *pNumLightsPerPixel = ( uNumPixels > 0 ) ? fTotalNumLights / uNumPixels : 0.0;
+    return bMatches;
+}
+
+// the floor and wall scene, with a row of pillars in front of it, so that many tiles 
+// contain both a near and a far surface (like the colonnades in Sponza)
+static void BuildBenchmarkColonnadeDepthBuffer( unsigned uWidth, unsigned uHeight, const XMFLOAT4X4& Projection, std::vector<float>& DepthBuffer )
+{
+    const unsigned uNumPillars = 8;
+
+    BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+    for( unsigned uPillar = 0; uPillar < uNumPillars; uPillar++ )
+    {
+        float fViewZ = 30.f + 10.f*(float)uPillar;
+        float fDepth = ( fViewZ*Projection._33 + Projection._43 ) / fViewZ;
+        unsigned uCenterX = ( 2*uPillar + 1 )*uWidth / ( 2*uNumPillars );
+        // not a multiple of the tile size, so that the edges fall inside tiles
+        unsigned uHalfWidth = uWidth / 64;
+
+        for( unsigned y = 0; y < uHeight; y++ )
+        {
+            for( unsigned x = uCenterX - uHalfWidth; x < uCenterX + uHalfWidth; x++ )
+            {
+                // inverted depth, so nearer is bigger
+                float& fPixelDepth = DepthBuffer[y*uWidth + x];
+                fPixelDepth = ( fDepth > fPixelDepth ) ? fDepth : fPixelDepth;
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------------------
+// Sphere vs. tile kernel benchmark: every kernel the CPU supports against the scalar one,
+// single-threaded, for a 1080p frame with and without depth bounds
+//-----------------------------------------------------------------------------------------
+static void RunCullKernelBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 1920;
+    const unsigned uHeight = 1080;
+    const unsigned uNumIterations = 3;
+    const unsigned NumLights[] = { 256, 2048, 16384 };
+
+    XMFLOAT4X4 Projection, ProjectionInv;
+    BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+    std::vector<float> DepthBuffer;
+    BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+    fprintf( pFile, "Sphere vs. tile kernels (%ux%u, 1 thread, best of %u, half point/half spot lights)\n", uWidth, uHeight, uNumIterations );
+    fprintf( pFile, "  Auto selects: %s\n", GetCpuCullKernelName( ResolveCpuCullKernel( CPU_CULL_KERNEL_AUTO ) ) );
+    fprintf( pFile, "  %8s %-12s %-8s %10s %9s %12s %s\n", "Lights", "DepthBounds", "Kernel", "ms", "Speedup", "Lights/tile", "Matches scalar" );
+
+    for( unsigned uLightCount = 0; uLightCount < sizeof(NumLights)/sizeof(NumLights[0]); uLightCount++ )
+    {
+        std::vector<XMFLOAT4> PointLights, SpotLights;
+        BuildBenchmarkLights( NumLights[uLightCount] / 2, 1, PointLights );
+        BuildBenchmarkLights( NumLights[uLightCount] / 2, 2, SpotLights );
+
+        CpuLightCullDesc Desc;
+        memset( &Desc, 0, sizeof(Desc) );
+        Desc.pPointLightCenterAndRadius = &PointLights[0];
+        Desc.uNumPointLights = (unsigned)PointLights.size();
+        Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+        Desc.uNumSpotLights = (unsigned)SpotLights.size();
+        SetIdentity( &Desc.mWorldView );
+        Desc.mProjectionInv = ProjectionInv;
+        Desc.uWindowWidth = uWidth;
+        Desc.uWindowHeight = uHeight;
+        Desc.uMaxNumLightsPerTile = MAX_NUM_LIGHTS_PER_TILE;
+
+        for( int nDepthBounds = 0; nDepthBounds < 2; nDepthBounds++ )
+        {
+            Desc.pDepthBuffer = ( nDepthBounds != 0 ) ? &DepthBuffer[0] : NULL;
+
+            CpuLightCuller ScalarCuller;
+            std::vector<unsigned> ScalarLightIndexBuffer;
+            double fScalarTime = 0.0;
+
+            for( int nKernel = CPU_CULL_KERNEL_SCALAR; nKernel < CPU_CULL_KERNEL_COUNT; nKernel++ )
+            {
+                CpuCullKernel eKernel = (CpuCullKernel)nKernel;
+                if( ResolveCpuCullKernel( eKernel ) != eKernel )
+                {
+                    fprintf( pFile, "  %8u %-12s %-8s %10s\n", NumLights[uLightCount], nDepthBounds ? "yes" : "no", GetCpuCullKernelName( eKernel ), "n/a" );
+                    continue;
+                }
+
+                CpuLightCuller Culler;
+                Culler.SetNumThreads( 1 );
+                Culler.SetKernel( eKernel );
+
+                double fBestTime = 0.0;
+                for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+                {
+                    double fStartTime = GetTimeInMs();
+                    Culler.Cull( Desc );
+                    double fTime = GetTimeInMs() - fStartTime;
+                    fBestTime = ( uIteration == 0 || fTime < fBestTime ) ? fTime : fBestTime;
+                }
+
+                // average list length, and whether the lists are identical to the scalar ones
+                unsigned uNumTiles = Culler.GetNumTilesX()*Culler.GetNumTilesY();
+                double fTotalNumLights = 0.0;
+                bool bMatches = true;
+                for( unsigned uTileIdx = 0; uTileIdx < uNumTiles; uTileIdx++ )
+                {
+                    unsigned uNumLightsInTile = Culler.GetNumPointLightsInTile( uTileIdx ) + Culler.GetNumSpotLightsInTile( uTileIdx );
+                    fTotalNumLights += uNumLightsInTile;
+
+                    if( eKernel != CPU_CULL_KERNEL_SCALAR )
+                    {
+                        const unsigned* pList = Culler.GetPointLightsInTile( uTileIdx );
+                        const unsigned* pScalarList = &ScalarLightIndexBuffer[uTileIdx*Culler.GetMaxNumLightsPerTile()];
+                        bMatches = bMatches && ( memcmp( pList, pScalarList, ( uNumLightsInTile + 2 )*sizeof(unsigned) ) == 0 );
+                    }
+                }
+
+                if( eKernel == CPU_CULL_KERNEL_SCALAR )
+                {
+                    fScalarTime = fBestTime;
+                    ScalarLightIndexBuffer.assign( Culler.GetLightIndexBuffer(), Culler.GetLightIndexBuffer() + Culler.GetLightIndexBufferSize() );
+                }
+
+                fprintf( pFile, "  %8u %-12s %-8s %10.3f %8.2fx %12.2f %s\n", NumLights[uLightCount], nDepthBounds ? "yes" : "no", GetCpuCullKernelName( eKernel ),
+                    fBestTime, fScalarTime / fBestTime, fTotalNumLights / uNumTiles, ( eKernel == CPU_CULL_KERNEL_SCALAR ) ? "-" : ( bMatches ? "yes" : "NO" ) );
+            }
+        }
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Clustered vs. tiled culling, with and without depth bounds, for a 1080p frame. Reports how many
+// lights each pixel loops over (the length of its tile's or its cluster's list), and 
+// checks the clustered lists against a brute-force reference (see 
+// CheckLightListsAgainstPixels), and that every cluster list is a subset of its 
+// tile's list.
+//-----------------------------------------------------------------------------------------
+static void RunClusteredCullingBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 1920;
+    const unsigned uHeight = 1080;
+    const unsigned uNumIterations = 3;
+    const unsigned uPixelStep = 7;  // brute-force check every 7th pixel in x and y
+    const unsigned NumLights[] = { 2048, 16384 };
+
+    XMFLOAT4X4 Projection, ProjectionInv;
+    BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+    std::vector<float> DepthBuffer;
+    BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+    ClusterConfig Configs[3];
+    Configs[0] = GetDefaultClusterConfig( BENCHMARK_FAR );
+    Configs[1] = Configs[0];
+    Configs[1].eSliceDistribution = CLUSTER_SLICE_DISTRIBUTION_LINEAR;
+    Configs[2] = Configs[0];
+    Configs[2].uNumSlices = 32;
+    Configs[2].uMaxNumLightsPerCluster = MAX_NUM_LIGHTS_PER_CLUSTER;
+
+    fprintf( pFile, "Clustered vs. tiled culling (%ux%u, %u threads, best of %u, half point/half spot lights)\n", uWidth, uHeight, GetDefaultNumThreads(), uNumIterations );
+    fprintf( pFile, "  %8s %-12s %-24s %10s %14s %10s %s\n", "Lights", "DepthBounds", "Mode", "ms", "Lights/pixel", "Overflows", "Matches reference" );
+
+    for( unsigned uLightCount = 0; uLightCount < sizeof(NumLights)/sizeof(NumLights[0]); uLightCount++ )
+    {
+        std::vector<XMFLOAT4> PointLights, SpotLights;
+        BuildBenchmarkLights( NumLights[uLightCount] / 2, 1, PointLights );
+        BuildBenchmarkLights( NumLights[uLightCount] / 2, 2, SpotLights );
+
+        CpuLightCullDesc Desc;
+        memset( &Desc, 0, sizeof(Desc) );
+        Desc.pPointLightCenterAndRadius = &PointLights[0];
+        Desc.uNumPointLights = (unsigned)PointLights.size();
+        Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+        Desc.uNumSpotLights = (unsigned)SpotLights.size();
+        SetIdentity( &Desc.mWorldView );
+        Desc.mProjectionInv = ProjectionInv;
+        Desc.uWindowWidth = uWidth;
+        Desc.uWindowHeight = uHeight;
+        Desc.uMaxNumLightsPerTile = MAX_NUM_LIGHTS_PER_TILE;
+
+        // without and with depth bounds, tiled (-1) and each of the cluster configs
+        for( int nRun = 0; nRun < 8; nRun++ )
+        {
+            int nDepthBounds = nRun / 4;
+            int nMode = ( nRun % 4 ) - 1;
+
+            Desc.pDepthBuffer = ( nDepthBounds != 0 ) ? &DepthBuffer[0] : NULL;
+
+            // the tiled lists, for the subset check
+            Desc.pClusterConfig = NULL;
+            CpuLightCuller TiledCuller;
+            TiledCuller.Cull( Desc );
+
+            const ClusterConfig* pConfig = ( nMode >= 0 ) ? &Configs[nMode] : NULL;
+            Desc.pClusterConfig = pConfig;
+
+            CpuLightCuller Culler;
+            double fBestTime = 0.0;
+            for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+            {
+                double fStartTime = GetTimeInMs();
+                Culler.Cull( Desc );
+                double fTime = GetTimeInMs() - fStartTime;
+                fBestTime = ( uIteration == 0 || fTime < fBestTime ) ? fTime : fBestTime;
+            }
+
+            unsigned uNumSlices = Culler.GetNumClusterSlices();
+            unsigned uNumTilesX = Culler.GetNumTilesX();
+
+            // a full list may have dropped lights (these are skipped by the brute-force check)
+            unsigned uNumOverflows = 0;
+            for( unsigned uListIdx = 0; uListIdx < Culler.GetNumLists(); uListIdx++ )
+            {
+                unsigned uNumLightsInList = Culler.GetNumPointLightsInTile( uListIdx ) + Culler.GetNumSpotLightsInTile( uListIdx );
+                uNumOverflows += ( uNumLightsInList + 2 >= Culler.GetMaxNumLightsPerList() ) ? 1 : 0;
+            }
+
+            // every cluster list is a subset of its tile's list (both are sorted)
+            bool bMatches = true;
+            if( pConfig )
+            {
+                for( unsigned uTileIdx = 0; uTileIdx < uNumTilesX*Culler.GetNumTilesY(); uTileIdx++ )
+                {
+                    for( unsigned uSlice = 0; uSlice < uNumSlices; uSlice++ )
+                    {
+                        unsigned uClusterIdx = Culler.GetClusterIndex( uTileIdx, uSlice );
+                        for( int nType = 0; nType < 2; nType++ )
+                        {
+                            const unsigned* pTileList = nType ? TiledCuller.GetSpotLightsInTile( uTileIdx ) : TiledCuller.GetPointLightsInTile( uTileIdx );
+                            const unsigned* pClusterList = nType ? Culler.GetSpotLightsInTile( uClusterIdx ) : Culler.GetPointLightsInTile( uClusterIdx );
+                            for( ; *pClusterList != LIGHT_INDEX_BUFFER_SENTINEL; pClusterList++ )
+                            {
+                                while( *pTileList < *pClusterList ) pTileList++;
+                                bMatches = bMatches && ( *pTileList == *pClusterList );
+                            }
+                        }
+                    }
+                }
+            }
+
+            // per-pixel list lengths, and the brute-force check
+            double fNumLightsPerPixel = 0.0;
+            bMatches = CheckLightListsAgainstPixels( Culler, Desc, &DepthBuffer[0], PointLights, SpotLights, uPixelStep, &fNumLightsPerPixel ) && bMatches;
+
+            char szMode[64];
+            if( pConfig )
+            {
+                sprintf_s( szMode, sizeof(szMode), "clustered %ux%u %s", uNumSlices, pConfig->uMaxNumLightsPerCluster,
+                    ( pConfig->eSliceDistribution == CLUSTER_SLICE_DISTRIBUTION_EXPONENTIAL ) ? "exp" : "linear" );
+            }
+            else
+            {
+                sprintf_s( szMode, sizeof(szMode), "tiled %u", Culler.GetMaxNumLightsPerList() );
+            }
+
+            fprintf( pFile, "  %8u %-12s %-24s %10.3f %14.2f %10u %s\n", NumLights[uLightCount], nDepthBounds ? "yes" : "no", szMode, fBestTime, fNumLightsPerPixel, uNumOverflows,
+                bMatches ? "yes" : "NO" );
+        }
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Depth mask (2.5D culling) vs. plain depth bounds, for a 1080p frame of the floor and 
+// wall scene and of the colonnade scene. Reports the per-tile light list lengths with 
+// and without the mask, and checks the masked lists against the brute-force reference.
+//-----------------------------------------------------------------------------------------
+static void RunDepthMaskBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 1920;
+    const unsigned uHeight = 1080;
+    const unsigned uNumIterations = 3;
+    const unsigned uPixelStep = 7;
+    const unsigned NumLights[] = { 2048, 16384 };
+    const char* SceneNames[] = { "floor", "colonnade" };
+
+    XMFLOAT4X4 Projection, ProjectionInv;
+    BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+    fprintf( pFile, "Depth mask vs. depth bounds (%ux%u, %u threads, best of %u, half point/half spot lights)\n", uWidth, uHeight, GetDefaultNumThreads(), uNumIterations );
+    fprintf( pFile, "  %-10s %8s %10s %10s %12s %12s %10s %14s %12s %s\n", "Scene", "Lights", "Bounds ms", "Mask ms", "Bounds/tile", "Mask/tile",
+        "Reduction", "Tiles reduced", "Max per tile", "Matches reference" );
+
+    for( int nScene = 0; nScene < 2; nScene++ )
+    {
+        std::vector<float> DepthBuffer;
+        if( nScene == 0 )
+        {
+            BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+        }
+        else
+        {
+            BuildBenchmarkColonnadeDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+        }
+
+        for( unsigned uLightCount = 0; uLightCount < sizeof(NumLights)/sizeof(NumLights[0]); uLightCount++ )
+        {
+            std::vector<XMFLOAT4> PointLights, SpotLights;
+            BuildBenchmarkLights( NumLights[uLightCount] / 2, 1, PointLights );
+            BuildBenchmarkLights( NumLights[uLightCount] / 2, 2, SpotLights );
+
+            CpuLightCullDesc Desc;
+            memset( &Desc, 0, sizeof(Desc) );
+            Desc.pPointLightCenterAndRadius = &PointLights[0];
+            Desc.uNumPointLights = (unsigned)PointLights.size();
+            Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+            Desc.uNumSpotLights = (unsigned)SpotLights.size();
+            SetIdentity( &Desc.mWorldView );
+            Desc.mProjectionInv = ProjectionInv;
+            Desc.uWindowWidth = uWidth;
+            Desc.uWindowHeight = uHeight;
+            Desc.uMaxNumLightsPerTile = MAX_NUM_LIGHTS_PER_TILE;
+            Desc.pDepthBuffer = &DepthBuffer[0];
+
+            // without (0) and with (1) the depth mask
+            CpuLightCuller Cullers[2];
+            double fBestTimes[2] = { 0.0, 0.0 };
+            for( int nMask = 0; nMask < 2; nMask++ )
+            {
+                Desc.bUseDepthMask = ( nMask != 0 );
+                for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+                {
+                    double fStartTime = GetTimeInMs();
+                    Cullers[nMask].Cull( Desc );
+                    double fTime = GetTimeInMs() - fStartTime;
+                    fBestTimes[nMask] = ( uIteration == 0 || fTime < fBestTimes[nMask] ) ? fTime : fBestTimes[nMask];
+                }
+            }
+
+            unsigned uNumTiles = Cullers[0].GetNumTilesX()*Cullers[0].GetNumTilesY();
+            double fTotalNumLights[2] = { 0.0, 0.0 };
+            unsigned uNumTilesReduced = 0;
+            unsigned uMaxReduction = 0;
+            for( unsigned uTileIdx = 0; uTileIdx < uNumTiles; uTileIdx++ )
+            {
+                unsigned uNumLightsInTile[2];
+                for( int nMask = 0; nMask < 2; nMask++ )
+                {
+                    uNumLightsInTile[nMask] = Cullers[nMask].GetNumPointLightsInTile( uTileIdx ) + Cullers[nMask].GetNumSpotLightsInTile( uTileIdx );
+                    fTotalNumLights[nMask] += uNumLightsInTile[nMask];
+                }
+
+                unsigned uReduction = uNumLightsInTile[0] - uNumLightsInTile[1];
+                uNumTilesReduced += ( uReduction > 0 ) ? 1 : 0;
+                uMaxReduction = ( uReduction > uMaxReduction ) ? uReduction : uMaxReduction;
+            }
+
+            double fNumLightsPerPixel = 0.0;
+            bool bMatches = CheckLightListsAgainstPixels( Cullers[1], Desc, &DepthBuffer[0], PointLights, SpotLights, uPixelStep, &fNumLightsPerPixel );
+
+            double fReduction = ( fTotalNumLights[0] > 0.0 ) ? 100.0*( 1.0 - fTotalNumLights[1] / fTotalNumLights[0] ) : 0.0;
+            fprintf( pFile, "  %-10s %8u %10.3f %10.3f %12.2f %12.2f %9.1f%% %8u/%-5u %12u %s\n", SceneNames[nScene], NumLights[uLightCount],
+                fBestTimes[0], fBestTimes[1], fTotalNumLights[0] / uNumTiles, fTotalNumLights[1] / uNumTiles, fReduction,
+                uNumTilesReduced, uNumTiles, uMaxReduction, bMatches ? "yes" : "NO" );
+        }
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Compact light lists vs. fixed slots, at 1080p, 1440p and 4K. Reports the size of the
+// fixed-slot light index buffer, how much of the compact buffer the lists actually use,
+// and how big the compact buffer is with the default budget 
+// (COMPACT_LIST_AVERAGE_NUM_ENTRIES_PER_TILE), and checks that every compact list
+// decodes back to its fixed-slot list.
+//-----------------------------------------------------------------------------------------
+static void RunCompactLightListBenchmark( FILE* pFile )
+{
+    const unsigned Widths[] = { 1920, 2560, 3840 };
+    const unsigned Heights[] = { 1080, 1440, 2160 };
+    const unsigned NumLights[] = { 2048, 16384 };
+    const double fBytesPerMB = 1024.0*1024.0;
+
+    fprintf( pFile, "Compact vs. fixed-slot light lists (%u threads, depth bounds, half point/half spot lights)\n", GetDefaultNumThreads() );
+    fprintf( pFile, "  %-10s %8s %8s %10s %10s %12s %12s %10s %11s %10s %s\n", "Resolution", "Lights", "Tiles", "Fixed MB", "Used MB",
+        "Allocated MB", "Entries/tile", "Max/tile", "Overflowed", "Pack ms", "Matches fixed" );
+
+    for( unsigned uResolution = 0; uResolution < sizeof(Widths)/sizeof(Widths[0]); uResolution++ )
+    {
+        unsigned uWidth = Widths[uResolution];
+        unsigned uHeight = Heights[uResolution];
+
+        XMFLOAT4X4 Projection, ProjectionInv;
+        BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+        std::vector<float> DepthBuffer;
+        BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+        for( unsigned uLightCount = 0; uLightCount < sizeof(NumLights)/sizeof(NumLights[0]); uLightCount++ )
+        {
+            std::vector<XMFLOAT4> PointLights, SpotLights;
+            BuildBenchmarkLights( NumLights[uLightCount] / 2, 1, PointLights );
+            BuildBenchmarkLights( NumLights[uLightCount] / 2, 2, SpotLights );
+
+            CpuLightCullDesc Desc;
+            memset( &Desc, 0, sizeof(Desc) );
+            Desc.pPointLightCenterAndRadius = &PointLights[0];
+            Desc.uNumPointLights = (unsigned)PointLights.size();
+            Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+            Desc.uNumSpotLights = (unsigned)SpotLights.size();
+            SetIdentity( &Desc.mWorldView );
+            Desc.mProjectionInv = ProjectionInv;
+            Desc.uWindowWidth = uWidth;
+            Desc.uWindowHeight = uHeight;
+            Desc.uMaxNumLightsPerTile = MAX_NUM_LIGHTS_PER_TILE;
+            Desc.pDepthBuffer = &DepthBuffer[0];
+
+            CpuLightCuller Culler;
+            Culler.Cull( Desc );
+
+            unsigned uNumTiles = Culler.GetNumTilesX()*Culler.GetNumTilesY();
+            unsigned uNumElements = GetCompactLightIndexBufferNumElements( uNumTiles, COMPACT_LIST_AVERAGE_NUM_ENTRIES_PER_TILE );
+
+            std::vector<unsigned> CompactBuffer;
+            double fStartTime = GetTimeInMs();
+            unsigned uNumOverflowedTiles = Culler.BuildCompactLightIndexBuffer( uNumElements, CompactBuffer );
+            double fPackTime = GetTimeInMs() - fStartTime;
+
+            // decode every tile and compare it with its fixed slot
+            bool bMatches = true;
+            unsigned uMaxNumLightsInTile = 0;
+            for( unsigned uTileIdx = 0; uTileIdx < uNumTiles; uTileIdx++ )
+            {
+                unsigned uNumPointLights = Culler.GetNumPointLightsInTile( uTileIdx );
+                unsigned uNumSpotLights = Culler.GetNumSpotLightsInTile( uTileIdx );
+                uMaxNumLightsInTile = std::max( uMaxNumLightsInTile, uNumPointLights + uNumSpotLights );
+
+                const unsigned* pHeader = &CompactBuffer[COMPACT_LIST_HEADER_OFFSET + COMPACT_LIST_HEADER_SIZE*uTileIdx];
+                if( pHeader[0] == COMPACT_LIST_EMPTY_LIST_OFFSET )
+                {
+                    continue;
+                }
+
+                bMatches = bMatches && ( pHeader[1] == PackCompactListCounts( uNumPointLights, uNumSpotLights ) ) &&
+                    ( memcmp( &CompactBuffer[pHeader[0]], Culler.GetPointLightsInTile( uTileIdx ), ( uNumPointLights + uNumSpotLights + 2 )*sizeof(unsigned) ) == 0 );
+            }
+
+            unsigned uNumEntriesUsed = GetCompactListDataOffset( uNumTiles ) + CompactBuffer[COMPACT_LIST_COUNTER_OFFSET];
+            fprintf( pFile, "  %4ux%-5u %8u %8u %10.2f %10.2f %12.2f %12.2f %10u %5u/%-5u %10.3f %s\n", uWidth, uHeight, NumLights[uLightCount], uNumTiles,
+                4.0*uNumTiles*MAX_NUM_LIGHTS_PER_TILE / fBytesPerMB, 4.0*uNumEntriesUsed / fBytesPerMB, 4.0*uNumElements / fBytesPerMB,
+                (double)CompactBuffer[COMPACT_LIST_COUNTER_OFFSET] / uNumTiles, uMaxNumLightsInTile, uNumOverflowedTiles, uNumTiles,
+                fPackTime, bMatches ? "yes" : "NO" );
+        }
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+// A small set-associative LRU cache of 64-byte lines (16 KB, like the L1 of a GPU compute
+// unit), for counting how many of the lines a stream of reads touches are already in it
+class BenchmarkCacheModel
+{
+public:
+    static const unsigned NUM_SETS = 64;
+    static const unsigned NUM_WAYS = 4;
+
+    BenchmarkCacheModel() : m_uNumHits(0), m_uNumAccesses(0) { memset( m_Lines, 0, sizeof(m_Lines) ); }
+
+    // read the 64-byte line at uLine
+    void Access( unsigned uLine )
+    {
+        // the ways of a set hold line + 1 (0 is empty), the most recently used first
+        unsigned* pWays = m_Lines[uLine % NUM_SETS];
+        unsigned uWay = 0;
+        while( uWay < NUM_WAYS - 1 && pWays[uWay] != uLine + 1 )
+        {
+            uWay++;
+        }
+        m_uNumHits += ( pWays[uWay] == uLine + 1 ) ? 1 : 0;
+        m_uNumAccesses++;
+        memmove( &pWays[1], &pWays[0], uWay*sizeof(unsigned) );
+        pWays[0] = uLine + 1;
+    }
+
+    // read uNumEntries 32-bit entries starting at uOffset, a line at a time
+    void AccessEntries( unsigned uOffset, unsigned uNumEntries )
+    {
+        for( unsigned uLine = uOffset / 16; uLine <= ( uOffset + uNumEntries - 1 ) / 16; uLine++ )
+        {
+            Access( uLine );
+        }
+    }
+
+    double GetHitRate() const { return ( m_uNumAccesses > 0 ) ? (double)m_uNumHits / m_uNumAccesses : 0.0; }
+
+private:
+    unsigned m_Lines[NUM_SETS][NUM_WAYS];
+    unsigned m_uNumHits;
+    unsigned m_uNumAccesses;
+};
+
+// The index buffer reads of the shading loop on a compact buffer: the tiles in order, 
+// each reading its header and its list, once for the whole tile (the other pixels of the 
+// tile then hit the cache anyway). Returns the share of the lines that were already cached.
+static double MeasureCompactListHitRate( const std::vector<unsigned>& Buffer, unsigned uNumTiles )
+{
+    BenchmarkCacheModel Cache;
+    for( unsigned uTileIdx = 0; uTileIdx < uNumTiles; uTileIdx++ )
+    {
+        unsigned uHeaderIdx = COMPACT_LIST_HEADER_OFFSET + COMPACT_LIST_HEADER_SIZE*uTileIdx;
+        Cache.AccessEntries( uHeaderIdx, COMPACT_LIST_HEADER_SIZE );
+
+        unsigned uCounts = Buffer[uHeaderIdx + 1];
+        Cache.AccessEntries( Buffer[uHeaderIdx], ( uCounts & 0xFFFF ) + ( uCounts >> 16 ) + 2 );
+    }
+    return Cache.GetHitRate();
+}
+
+//-----------------------------------------------------------------------------------------
+// Shared vs. compact light lists (see BuildSharedLightIndexBuffer), for a 1080p frame 
+// with depth bounds, at each tile size. Reports how many lists are the same as another 
+// one, how much of the compact buffer sharing saves, and the hit rate of the index buffer 
+// reads of the shading loop in a small cache, and checks that every shared list decodes 
+// back to its fixed-slot list.
+//-----------------------------------------------------------------------------------------
+static void RunSharedLightListBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 1920;
+    const unsigned uHeight = 1080;
+    const unsigned TileResolutions[] = { 8, 16, 32 };
+    const unsigned NumLights[] = { 2048, 16384 };
+    const double fBytesPerMB = 1024.0*1024.0;
+
+    XMFLOAT4X4 Projection, ProjectionInv;
+    BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+    std::vector<float> DepthBuffer;
+    BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+    fprintf( pFile, "Shared vs. compact light lists (%ux%u, %u threads, depth bounds, half point/half spot lights, %u KB cache)\n", uWidth, uHeight,
+        GetDefaultNumThreads(), BenchmarkCacheModel::NUM_SETS*BenchmarkCacheModel::NUM_WAYS*64 / 1024 );
+    fprintf( pFile, "  %4s %8s %8s %8s %12s %11s %8s %12s %11s %10s %s\n", "Tile", "Lights", "Lists", "Shared", "Compact MB", "Shared MB",
+        "Saved", "Compact hits", "Shared hits", "Pack ms", "Matches fixed" );
+
+    for( unsigned uTileResIdx = 0; uTileResIdx < sizeof(TileResolutions)/sizeof(TileResolutions[0]); uTileResIdx++ )
+    {
+        for( unsigned uLightCount = 0; uLightCount < sizeof(NumLights)/sizeof(NumLights[0]); uLightCount++ )
+        {
+            std::vector<XMFLOAT4> PointLights, SpotLights;
+            BuildBenchmarkLights( NumLights[uLightCount] / 2, 1, PointLights );
+            BuildBenchmarkLights( NumLights[uLightCount] / 2, 2, SpotLights );
+
+            CpuLightCullDesc Desc;
+            memset( &Desc, 0, sizeof(Desc) );
+            Desc.pPointLightCenterAndRadius = &PointLights[0];
+            Desc.uNumPointLights = (unsigned)PointLights.size();
+            Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+            Desc.uNumSpotLights = (unsigned)SpotLights.size();
+            SetIdentity( &Desc.mWorldView );
+            Desc.mProjectionInv = ProjectionInv;
+            Desc.uWindowWidth = uWidth;
+            Desc.uWindowHeight = uHeight;
+            Desc.uTileRes = TileResolutions[uTileResIdx];
+            Desc.uMaxNumLightsPerTile = GetMaxNumLightsPerTileForTileRes( Desc.uTileRes );
+            Desc.pDepthBuffer = &DepthBuffer[0];
+
+            CpuLightCuller Culler;
+            Culler.Cull( Desc );
+
+            // big enough for every list, so that nothing overflows
+            unsigned uNumTiles = Culler.GetNumTilesX()*Culler.GetNumTilesY();
+            unsigned uNumElements = GetCompactLightIndexBufferNumElements( uNumTiles, Desc.uMaxNumLightsPerTile );
+
+            std::vector<unsigned> CompactBuffer, SharedBuffer;
+            Culler.BuildCompactLightIndexBuffer( uNumElements, CompactBuffer );
+            unsigned uNumSharedLists = 0;
+            double fStartTime = GetTimeInMs();
+            unsigned uNumOverflowedTiles = Culler.BuildSharedLightIndexBuffer( uNumElements, SharedBuffer, &uNumSharedLists );
+            double fPackTime = GetTimeInMs() - fStartTime;
+
+            // decode every tile and compare it with its fixed slot
+            bool bMatches = ( uNumOverflowedTiles == 0 );
+            for( unsigned uTileIdx = 0; uTileIdx < uNumTiles; uTileIdx++ )
+            {
+                unsigned uNumPointLights = Culler.GetNumPointLightsInTile( uTileIdx );
+                unsigned uNumSpotLights = Culler.GetNumSpotLightsInTile( uTileIdx );
+                const unsigned* pHeader = &SharedBuffer[COMPACT_LIST_HEADER_OFFSET + COMPACT_LIST_HEADER_SIZE*uTileIdx];
+                bMatches = bMatches && ( pHeader[1] == PackCompactListCounts( uNumPointLights, uNumSpotLights ) ) &&
+                    ( memcmp( &SharedBuffer[pHeader[0]], Culler.GetPointLightsInTile( uTileIdx ), ( uNumPointLights + uNumSpotLights + 2 )*sizeof(unsigned) ) == 0 );
+            }
+
+            unsigned uNumCompactEntries = GetCompactListDataOffset( uNumTiles ) + CompactBuffer[COMPACT_LIST_COUNTER_OFFSET];
+            unsigned uNumSharedEntries = GetCompactListDataOffset( uNumTiles ) + SharedBuffer[COMPACT_LIST_COUNTER_OFFSET];
+            fprintf( pFile, "  %4u %8u %8u %7.1f%% %12.3f %11.3f %7.1f%% %11.1f%% %10.1f%% %10.3f %s\n", Desc.uTileRes, NumLights[uLightCount], uNumTiles,
+                100.0*uNumSharedLists / uNumTiles, 4.0*uNumCompactEntries / fBytesPerMB, 4.0*uNumSharedEntries / fBytesPerMB,
+                100.0*( 1.0 - (double)uNumSharedEntries / uNumCompactEntries ),
+                100.0*MeasureCompactListHitRate( CompactBuffer, uNumTiles ), 100.0*MeasureCompactListHitRate( SharedBuffer, uNumTiles ),
+                fPackTime, bMatches ? "yes" : "NO" );
+        }
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Culling cost vs. light count, from 1k up to 100k lights (the light capacity is a runtime
+// parameter, see -maxlights), for a 1080p frame with depth bounds. The lights shrink as 
+// their number grows (see BuildBenchmarkLights), so the lists stay about the same length, 
+// and what is left is the cost of testing every light against every tile.
+//-----------------------------------------------------------------------------------------
+static void RunLightCountBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 1920;
+    const unsigned uHeight = 1080;
+    const unsigned uNumIterations = 3;
+    const unsigned NumLights[] = { 1024, 4096, 16384, 32768, 65536, 100000 };
+
+    XMFLOAT4X4 Projection, ProjectionInv;
+    BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+    std::vector<float> DepthBuffer;
+    BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+    fprintf( pFile, "Culling cost vs. light count (%ux%u, %u threads, best of %u, depth bounds, half point/half spot lights)\n", uWidth, uHeight,
+        GetDefaultNumThreads(), uNumIterations );
+    fprintf( pFile, "  %8s %10s %14s %12s %10s %10s\n", "Lights", "ms", "ns per light", "Lights/tile", "Max/tile", "Full tiles" );
+
+    for( unsigned uLightCount = 0; uLightCount < sizeof(NumLights)/sizeof(NumLights[0]); uLightCount++ )
+    {
+        std::vector<XMFLOAT4> PointLights, SpotLights;
+        BuildBenchmarkLights( NumLights[uLightCount] / 2, 1, PointLights );
+        BuildBenchmarkLights( NumLights[uLightCount] - NumLights[uLightCount] / 2, 2, SpotLights );
+
+        CpuLightCullDesc Desc;
+        memset( &Desc, 0, sizeof(Desc) );
+        Desc.pPointLightCenterAndRadius = &PointLights[0];
+        Desc.uNumPointLights = (unsigned)PointLights.size();
+        Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+        Desc.uNumSpotLights = (unsigned)SpotLights.size();
+        SetIdentity( &Desc.mWorldView );
+        Desc.mProjectionInv = ProjectionInv;
+        Desc.uWindowWidth = uWidth;
+        Desc.uWindowHeight = uHeight;
+        Desc.uMaxNumLightsPerTile = MAX_NUM_LIGHTS_PER_TILE;
+        Desc.pDepthBuffer = &DepthBuffer[0];
+
+        CpuLightCuller Culler;
+        double fBestTime = 0.0;
+        for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+        {
+            double fStartTime = GetTimeInMs();
+            Culler.Cull( Desc );
+            double fTime = GetTimeInMs() - fStartTime;
+            fBestTime = ( uIteration == 0 || fTime < fBestTime ) ? fTime : fBestTime;
+        }
+
+        unsigned uNumTiles = Culler.GetNumTilesX()*Culler.GetNumTilesY();
+        double fTotalNumLights = 0.0;
+        unsigned uMaxNumLightsInTile = 0;
+        unsigned uNumFullTiles = 0;
+        for( unsigned uTileIdx = 0; uTileIdx < uNumTiles; uTileIdx++ )
+        {
+            unsigned uNumLightsInTile = Culler.GetNumPointLightsInTile( uTileIdx ) + Culler.GetNumSpotLightsInTile( uTileIdx );
+            fTotalNumLights += uNumLightsInTile;
+            uMaxNumLightsInTile = std::max( uMaxNumLightsInTile, uNumLightsInTile );
+            uNumFullTiles += ( uNumLightsInTile + 2 >= Culler.GetMaxNumLightsPerList() ) ? 1 : 0;
+        }
+
+        fprintf( pFile, "  %8u %10.3f %14.1f %12.2f %10u %10u\n", NumLights[uLightCount], fBestTime, 1.0e6*fBestTime / NumLights[uLightCount],
+            fTotalNumLights / uNumTiles, uMaxNumLightsInTile, uNumFullTiles );
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Brute force vs. the light BVH, for the same 1080p frames as the light count benchmark.
+// The BVH time includes building both BVHs (point and spot), which is also shown on its
+// own. The lists must come out identical, and the crossover is the smallest light count
+// from which the BVH path is faster.
+//-----------------------------------------------------------------------------------------
+static void RunLightBvhBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 1920;
+    const unsigned uHeight = 1080;
+    const unsigned uNumIterations = 3;
+    const unsigned NumLights[] = { 256, 512, 1024, 2048, 4096, 16384, 65536, 100000 };
+
+    XMFLOAT4X4 Projection, ProjectionInv;
+    BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+    std::vector<float> DepthBuffer;
+    BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+    fprintf( pFile, "Light BVH vs. brute force (%ux%u, %u threads, best of %u, depth bounds, half point/half spot lights, %u lights per leaf)\n",
+        uWidth, uHeight, GetDefaultNumThreads(), uNumIterations, LIGHT_BVH_LEAF_SIZE );
+    fprintf( pFile, "  %8s %10s %10s %10s %9s %8s %10s\n", "Lights", "Brute ms", "BVH ms", "Build ms", "Speedup", "Nodes", "Identical" );
+
+    unsigned uCrossover = 0;
+    bool bAllIdentical = true;
+    for( unsigned uLightCount = 0; uLightCount < sizeof(NumLights)/sizeof(NumLights[0]); uLightCount++ )
+    {
+        std::vector<XMFLOAT4> PointLights, SpotLights;
+        BuildBenchmarkLights( NumLights[uLightCount] / 2, 1, PointLights );
+        BuildBenchmarkLights( NumLights[uLightCount] - NumLights[uLightCount] / 2, 2, SpotLights );
+
+        CpuLightCullDesc Desc;
+        memset( &Desc, 0, sizeof(Desc) );
+        Desc.pPointLightCenterAndRadius = &PointLights[0];
+        Desc.uNumPointLights = (unsigned)PointLights.size();
+        Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+        Desc.uNumSpotLights = (unsigned)SpotLights.size();
+        SetIdentity( &Desc.mWorldView );
+        Desc.mProjectionInv = ProjectionInv;
+        Desc.uWindowWidth = uWidth;
+        Desc.uWindowHeight = uHeight;
+        Desc.uMaxNumLightsPerTile = MAX_NUM_LIGHTS_PER_TILE;
+        Desc.pDepthBuffer = &DepthBuffer[0];
+
+        CpuLightCuller BruteForceCuller, BvhCuller;
+        BvhCuller.SetUseLightBvh( true );
+
+        double fBestBruteForceTime = 0.0, fBestBvhTime = 0.0;
+        for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+        {
+            double fStartTime = GetTimeInMs();
+            BruteForceCuller.Cull( Desc );
+            double fTime = GetTimeInMs() - fStartTime;
+            fBestBruteForceTime = ( uIteration == 0 || fTime < fBestBruteForceTime ) ? fTime : fBestBruteForceTime;
+
+            fStartTime = GetTimeInMs();
+            BvhCuller.Cull( Desc );
+            fTime = GetTimeInMs() - fStartTime;
+            fBestBvhTime = ( uIteration == 0 || fTime < fBestBvhTime ) ? fTime : fBestBvhTime;
+        }
+
+        // the build on its own, over the same view-space spheres the culler builds from
+        CpuCullLightsSoA PointLightsSoA, SpotLightsSoA;
+        PointLightsSoA.Resize( (unsigned)PointLights.size() );
+        for( unsigned i = 0; i < PointLights.size(); i++ )
+        {
+            PointLightsSoA.Set( i, PointLights[i].x, PointLights[i].y, PointLights[i].z, PointLights[i].w );
+        }
+        SpotLightsSoA.Resize( (unsigned)SpotLights.size() );
+        for( unsigned i = 0; i < SpotLights.size(); i++ )
+        {
+            SpotLightsSoA.Set( i, SpotLights[i].x, SpotLights[i].y, SpotLights[i].z, SpotLights[i].w );
+        }
+
+        CpuLightBvh PointLightBvh, SpotLightBvh;
+        double fBestBuildTime = 0.0;
+        for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+        {
+            double fStartTime = GetTimeInMs();
+            PointLightBvh.Build( PointLightsSoA, 0 );
+            SpotLightBvh.Build( SpotLightsSoA, 0 );
+            double fTime = GetTimeInMs() - fStartTime;
+            fBestBuildTime = ( uIteration == 0 || fTime < fBestBuildTime ) ? fTime : fBestBuildTime;
+        }
+
+        bool bIdentical = BruteForceCuller.GetLightIndexBufferSize() == BvhCuller.GetLightIndexBufferSize() &&
+            memcmp( BruteForceCuller.GetLightIndexBuffer(), BvhCuller.GetLightIndexBuffer(), BvhCuller.GetLightIndexBufferSize()*sizeof(unsigned) ) == 0;
+        bAllIdentical = bAllIdentical && bIdentical;
+
+        if( fBestBvhTime < fBestBruteForceTime )
+        {
+            uCrossover = ( uCrossover == 0 ) ? NumLights[uLightCount] : uCrossover;
+        }
+        else
+        {
+            uCrossover = 0;
+        }
+
+        fprintf( pFile, "  %8u %10.3f %10.3f %10.3f %8.2fx %8u %10s\n", NumLights[uLightCount], fBestBruteForceTime, fBestBvhTime, fBestBuildTime,
+            fBestBruteForceTime / fBestBvhTime, PointLightBvh.GetNumNodes() + SpotLightBvh.GetNumNodes(), bIdentical ? "yes" : "NO" );
+    }
+
+    if( uCrossover != 0 )
+    {
+        fprintf( pFile, "  The BVH is faster from %u lights up\n", uCrossover );
+    }
+    else
+    {
+        fprintf( pFile, "  The BVH is not faster at the largest light count\n" );
+    }
+    fprintf( pFile, "  Lists %s\n", bAllIdentical ? "match brute force" : "DO NOT MATCH brute force" );
+
+    fprintf( pFile, "\n" );
+}
+
+// How well the light fetches of a set of lists hit the same cache lines. With one float4
+// per light (like the center and radius buffers), a 64-byte line holds 4 lights, so the
+// number of distinct lines a list touches per light in it goes from 0.25 (neighbours only)
+// to 1 (every light on a line of its own). The CPU lists are in ascending order, so
+// counting distinct lines is counting line changes. Point and spot lights are in
+// separate buffers, so they are counted separately.
+struct LightFetchLocality
+{
+    double fLinesPerLight;
+    double fMeanIndexGap;   // between consecutive lights in a list
+};
+
+static unsigned CountCacheLines( const unsigned* pList, unsigned uNumLights, double* pIndexGapSum )
+{
+    unsigned uNumLines = 0;
+    for( unsigned i = 0; i < uNumLights; i++ )
+    {
+        if( i == 0 || ( pList[i] >> 2 ) != ( pList[i - 1] >> 2 ) )
+        {
+            uNumLines++;
+        }
+        if( i > 0 )
+        {
+            *pIndexGapSum += pList[i] - pList[i - 1];
+        }
+    }
+    return uNumLines;
+}
+
+static LightFetchLocality MeasureLightFetchLocality( const CpuLightCuller& Culler )
+{
+    double fNumLines = 0.0, fNumLights = 0.0, fIndexGapSum = 0.0, fNumGaps = 0.0;
+    for( unsigned uListIdx = 0; uListIdx < Culler.GetNumLists(); uListIdx++ )
+    {
+        unsigned uNumPointLights = Culler.GetNumPointLightsInTile( uListIdx );
+        unsigned uNumSpotLights = Culler.GetNumSpotLightsInTile( uListIdx );
+        fNumLines += CountCacheLines( Culler.GetPointLightsInTile( uListIdx ), uNumPointLights, &fIndexGapSum );
+        fNumLines += CountCacheLines( Culler.GetSpotLightsInTile( uListIdx ), uNumSpotLights, &fIndexGapSum );
+        fNumLights += uNumPointLights + uNumSpotLights;
+        fNumGaps += ( uNumPointLights > 1 ? uNumPointLights - 1 : 0 ) + ( uNumSpotLights > 1 ? uNumSpotLights - 1 : 0 );
+    }
+
+    LightFetchLocality Locality;
+    Locality.fLinesPerLight = ( fNumLights > 0.0 ) ? fNumLines / fNumLights : 0.0;
+    Locality.fMeanIndexGap = ( fNumGaps > 0.0 ) ? fIndexGapSum / fNumGaps : 0.0;
+    return Locality;
+}
+
+// A stand-in for the fetches of the shading loop: for every list, read the center
+// and radius and the color of each light in it, like the first pixel of a tile does
+// (the other pixels of the tile then mostly hit the cache). Returns a checksum, so
+// that the compiler cannot drop the loads.
+static float FetchLightsForAllLists( const CpuLightCuller& Culler, const std::vector<XMFLOAT4>& PointLights, const std::vector<unsigned>& PointLightColors,
+                                     const std::vector<XMFLOAT4>& SpotLights, const std::vector<unsigned>& SpotLightColors )
+{
+    float fSum = 0.f;
+    unsigned uColorSum = 0;
+    for( unsigned uListIdx = 0; uListIdx < Culler.GetNumLists(); uListIdx++ )
+    {
+        const unsigned* pPointLights = Culler.GetPointLightsInTile( uListIdx );
+        for( unsigned i = 0; pPointLights[i] != LIGHT_INDEX_BUFFER_SENTINEL; i++ )
+        {
+            const XMFLOAT4& Light = PointLights[pPointLights[i]];
+            fSum += Light.x + Light.y + Light.z + Light.w;
+            uColorSum += PointLightColors[pPointLights[i]];
+        }
+
+        const unsigned* pSpotLights = Culler.GetSpotLightsInTile( uListIdx );
+        for( unsigned i = 0; pSpotLights[i] != LIGHT_INDEX_BUFFER_SENTINEL; i++ )
+        {
+            const XMFLOAT4& Light = SpotLights[pSpotLights[i]];
+            fSum += Light.x + Light.y + Light.z + Light.w;
+            uColorSum += SpotLightColors[pSpotLights[i]];
+        }
+    }
+    return fSum + (float)( uColorSum & 0xff );
+}
+
+//-----------------------------------------------------------------------------------------
+// Light-buffer fetch locality before and after sorting the lights by Morton code (see
+// ForwardPlusLightSort.h), for a 1080p frame with depth bounds. The lights are created
+// in random order, like InitLights does. Sorting must not change which lights end up in
+// which list, only their indices, so the sorted lists are mapped back and compared.
+//-----------------------------------------------------------------------------------------
+static void RunLightSortBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 1920;
+    const unsigned uHeight = 1080;
+    const unsigned uNumIterations = 5;
+    const unsigned NumLights[] = { 2048, 16384, 100000 };
+
+    XMFLOAT4X4 Projection, ProjectionInv;
+    BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+    std::vector<float> DepthBuffer;
+    BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+    fprintf( pFile, "Light fetch locality, random vs. Morton order (%ux%u, best of %u, depth bounds, half point/half spot lights)\n",
+        uWidth, uHeight, uNumIterations );
+    fprintf( pFile, "  %8s %8s %12s %12s %10s %10s %10s %10s\n", "Lights", "Order", "Lines/light", "Index gap", "Sort ms", "Cull ms", "Fetch ms", "Same lists" );
+
+    for( unsigned uLightCount = 0; uLightCount < sizeof(NumLights)/sizeof(NumLights[0]); uLightCount++ )
+    {
+        std::vector<XMFLOAT4> PointLights, SpotLights;
+        BuildBenchmarkLights( NumLights[uLightCount] / 2, 1, PointLights );
+        BuildBenchmarkLights( NumLights[uLightCount] - NumLights[uLightCount] / 2, 2, SpotLights );
+
+        std::vector<unsigned> PointLightColors( PointLights.size() ), SpotLightColors( SpotLights.size() );
+        for( unsigned i = 0; i < PointLightColors.size(); i++ )
+        {
+            PointLightColors[i] = i*2654435761u;
+        }
+        for( unsigned i = 0; i < SpotLightColors.size(); i++ )
+        {
+            SpotLightColors[i] = i*2246822519u;
+        }
+
+        // the sorted copies, with every array reordered the same way
+        std::vector<unsigned> PointSortedToLight, SpotSortedToLight;
+        double fBestSortTime = 0.0;
+        for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+        {
+            double fStartTime = GetTimeInMs();
+            SortLightsByMortonCode( &PointLights[0], (unsigned)PointLights.size(), PointSortedToLight );
+            SortLightsByMortonCode( &SpotLights[0], (unsigned)SpotLights.size(), SpotSortedToLight );
+            double fTime = GetTimeInMs() - fStartTime;
+            fBestSortTime = ( uIteration == 0 || fTime < fBestSortTime ) ? fTime : fBestSortTime;
+        }
+
+        std::vector<XMFLOAT4> SortedPointLights( PointLights.size() ), SortedSpotLights( SpotLights.size() );
+        std::vector<unsigned> SortedPointLightColors( PointLights.size() ), SortedSpotLightColors( SpotLights.size() );
+        ReorderLightArray( &PointSortedToLight[0], (unsigned)PointLights.size(), &PointLights[0], &SortedPointLights[0] );
+        ReorderLightArray( &PointSortedToLight[0], (unsigned)PointLights.size(), &PointLightColors[0], &SortedPointLightColors[0] );
+        ReorderLightArray( &SpotSortedToLight[0], (unsigned)SpotLights.size(), &SpotLights[0], &SortedSpotLights[0] );
+        ReorderLightArray( &SpotSortedToLight[0], (unsigned)SpotLights.size(), &SpotLightColors[0], &SortedSpotLightColors[0] );
+
+        CpuLightCuller Cullers[2];
+        for( unsigned uOrder = 0; uOrder < 2; uOrder++ )
+        {
+            bool bSorted = ( uOrder == 1 );
+            const std::vector<XMFLOAT4>& CurrentPointLights = bSorted ? SortedPointLights : PointLights;
+            const std::vector<XMFLOAT4>& CurrentSpotLights = bSorted ? SortedSpotLights : SpotLights;
+
+            CpuLightCullDesc Desc;
+            memset( &Desc, 0, sizeof(Desc) );
+            Desc.pPointLightCenterAndRadius = &CurrentPointLights[0];
+            Desc.uNumPointLights = (unsigned)CurrentPointLights.size();
+            Desc.pSpotLightCenterAndRadius = &CurrentSpotLights[0];
+            Desc.uNumSpotLights = (unsigned)CurrentSpotLights.size();
+            SetIdentity( &Desc.mWorldView );
+            Desc.mProjectionInv = ProjectionInv;
+            Desc.uWindowWidth = uWidth;
+            Desc.uWindowHeight = uHeight;
+            Desc.uMaxNumLightsPerTile = MAX_NUM_LIGHTS_PER_TILE;
+            Desc.pDepthBuffer = &DepthBuffer[0];
+
+            CpuLightCuller& Culler = Cullers[uOrder];
+            double fBestCullTime = 0.0, fBestFetchTime = 0.0;
+            float fChecksum = 0.f;
+            for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+            {
+                double fStartTime = GetTimeInMs();
+                Culler.Cull( Desc );
+                double fTime = GetTimeInMs() - fStartTime;
+                fBestCullTime = ( uIteration == 0 || fTime < fBestCullTime ) ? fTime : fBestCullTime;
+
+                fStartTime = GetTimeInMs();
+                fChecksum += bSorted ? FetchLightsForAllLists( Culler, SortedPointLights, SortedPointLightColors, SortedSpotLights, SortedSpotLightColors ) :
+                                       FetchLightsForAllLists( Culler, PointLights, PointLightColors, SpotLights, SpotLightColors );
+                fTime = GetTimeInMs() - fStartTime;
+                fBestFetchTime = ( uIteration == 0 || fTime < fBestFetchTime ) ? fTime : fBestFetchTime;
+            }
+
+            // map the sorted lists back to the original light indices
+            bool bSameLists = true;
+            if( bSorted )
+            {
+                std::vector<unsigned> List;
+                for( unsigned uListIdx = 0; uListIdx < Culler.GetNumLists() && bSameLists; uListIdx++ )
+                {
+                    List.assign( Culler.GetPointLightsInTile( uListIdx ), Culler.GetPointLightsInTile( uListIdx ) + Culler.GetNumPointLightsInTile( uListIdx ) );
+                    for( size_t i = 0; i < List.size(); i++ )
+                    {
+                        List[i] = PointSortedToLight[List[i]];
+                    }
+                    std::sort( List.begin(), List.end() );
+                    bSameLists = List.size() == Cullers[0].GetNumPointLightsInTile( uListIdx ) &&
+                        ( List.empty() || memcmp( &List[0], Cullers[0].GetPointLightsInTile( uListIdx ), List.size()*sizeof(unsigned) ) == 0 );
+
+                    List.assign( Culler.GetSpotLightsInTile( uListIdx ), Culler.GetSpotLightsInTile( uListIdx ) + Culler.GetNumSpotLightsInTile( uListIdx ) );
+                    for( size_t i = 0; i < List.size(); i++ )
+                    {
+                        List[i] = SpotSortedToLight[List[i]];
+                    }
+                    std::sort( List.begin(), List.end() );
+                    bSameLists = bSameLists && List.size() == Cullers[0].GetNumSpotLightsInTile( uListIdx ) &&
+                        ( List.empty() || memcmp( &List[0], Cullers[0].GetSpotLightsInTile( uListIdx ), List.size()*sizeof(unsigned) ) == 0 );
+                }
+            }
+
+            LightFetchLocality Locality = MeasureLightFetchLocality( Culler );
+            char szSortTime[32] = "-";
+            if( bSorted )
+            {
+                sprintf_s( szSortTime, sizeof(szSortTime), "%.3f", fBestSortTime );
+            }
+
+            fprintf( pFile, "  %8u %8s %12.3f %12.1f %10s %10.3f %10.3f %10s\n", NumLights[uLightCount], bSorted ? "Morton" : "random",
+                Locality.fLinesPerLight, Locality.fMeanIndexGap, szSortTime, fBestCullTime, fBestFetchTime,
+                bSorted ? ( bSameLists ? "yes" : "NO" ) : "-" );
+
+            // keep the fetches alive
+            volatile float fSink = fChecksum;
+            (void)fSink;
+        }
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Light animation throughput: a second of frames at 60 Hz, with one thread and with all
+// of them. The upload is what UpdateLights would write to the staging buffer per frame
+// (a float4 center and radius and a color per dirty light).
+//-----------------------------------------------------------------------------------------
+static void RunLightAnimationBenchmark( FILE* pFile )
+{
+    const unsigned uNumFrames = 60;
+    const unsigned NumLights[] = { 10000, 100000, 1000000 };
+    const unsigned NumThreads[] = { 1, GetDefaultNumThreads() };
+
+    fprintf( pFile, "Light animation (%u frames at 60 Hz, mean per frame)\n", uNumFrames );
+    fprintf( pFile, "  %8s %8s %10s %12s %8s %8s %12s\n", "Lights", "Threads", "ms", "Lights/ms", "Dirty", "Ranges", "Upload MB" );
+
+    for( unsigned uLightCount = 0; uLightCount < sizeof(NumLights)/sizeof(NumLights[0]); uLightCount++ )
+    {
+        unsigned uNumLights = NumLights[uLightCount];
+        std::vector<XMFLOAT4> Lights;
+        BuildBenchmarkLights( uNumLights, 1, Lights );
+
+        for( unsigned uThreadCount = 0; uThreadCount < sizeof(NumThreads)/sizeof(NumThreads[0]); uThreadCount++ )
+        {
+            if( uThreadCount > 0 && NumThreads[uThreadCount] == NumThreads[0] )
+            {
+                continue;
+            }
+
+            LightAnimator Animator;
+            Animator.Resize( uNumLights );
+            for( unsigned i = 0; i < uNumLights; i++ )
+            {
+                Animator.SetLight( i, Lights[i], 0xffc08040, i, 0.5f*Lights[i].w );
+            }
+
+            double fTotalTime = 0.0;
+            double fTotalNumDirtyLights = 0.0;
+            double fTotalNumRanges = 0.0;
+            for( unsigned uFrame = 0; uFrame < uNumFrames; uFrame++ )
+            {
+                double fStartTime = GetTimeInMs();
+                Animator.Update( (float)( uFrame + 1 ) / 60.f, uNumLights, NumThreads[uThreadCount] );
+                fTotalTime += GetTimeInMs() - fStartTime;
+
+                fTotalNumDirtyLights += Animator.GetNumDirtyLights();
+                fTotalNumRanges += (double)Animator.GetDirtyRanges().size();
+            }
+
+            double fTime = fTotalTime / uNumFrames;
+            double fNumDirtyLights = fTotalNumDirtyLights / uNumFrames;
+            double fUploadSize = fNumDirtyLights*( sizeof(XMFLOAT4) + sizeof(unsigned) ) / ( 1024.0*1024.0 );
+            fprintf( pFile, "  %8u %8u %10.3f %12.0f %7.1f%% %8.1f %12.2f\n", uNumLights, NumThreads[uThreadCount], fTime, uNumLights / fTime,
+                100.0*fNumDirtyLights / uNumLights, fTotalNumRanges / uNumFrames, fUploadSize );
+        }
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Tile size sweep: culling time vs. list length for every supported tile size, at a few
+// resolutions, with depth bounds. Lights/pixel is what the forward pass pays (the length
+// of the list each pixel walks), ms is what the culling pays, and the list memory is the
+// size of the fixed-slot light index buffer.
+//-----------------------------------------------------------------------------------------
+static void RunTileSizeBenchmark( FILE* pFile )
+{
+    const unsigned uNumIterations = 3;
+    const unsigned uPixelStep = 7;  // brute-force check every 7th pixel in x and y
+    const unsigned uNumLights = 4096;
+    const unsigned Widths[] = { 1280, 1920, 2560, 3840 };
+    const unsigned Heights[] = { 720, 1080, 1440, 2160 };
+
+    std::vector<XMFLOAT4> PointLights, SpotLights;
+    BuildBenchmarkLights( uNumLights / 2, 1, PointLights );
+    BuildBenchmarkLights( uNumLights / 2, 2, SpotLights );
+
+    fprintf( pFile, "Culling time vs. list length per tile size (%u lights, %u threads, best of %u, depth bounds, half point/half spot lights)\n",
+        uNumLights, GetDefaultNumThreads(), uNumIterations );
+    fprintf( pFile, "  %10s %6s %8s %10s %12s %14s %10s %10s %10s %s\n", "Resolution", "Tile", "Tiles", "ms", "Lights/tile", "Lights/pixel", "Max/tile",
+        "Full tiles", "List MB", "Matches reference" );
+
+    for( unsigned uResolution = 0; uResolution < sizeof(Widths)/sizeof(Widths[0]); uResolution++ )
+    {
+        unsigned uWidth = Widths[uResolution];
+        unsigned uHeight = Heights[uResolution];
+
+        XMFLOAT4X4 Projection, ProjectionInv;
+        BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+        std::vector<float> DepthBuffer;
+        BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+        for( unsigned uTileResIdx = 0; uTileResIdx < NUM_TILE_RES; uTileResIdx++ )
+        {
+            unsigned uTileRes = GetTileRes( uTileResIdx );
+
+            CpuLightCullDesc Desc;
+            memset( &Desc, 0, sizeof(Desc) );
+            Desc.pPointLightCenterAndRadius = &PointLights[0];
+            Desc.uNumPointLights = (unsigned)PointLights.size();
+            Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+            Desc.uNumSpotLights = (unsigned)SpotLights.size();
+            SetIdentity( &Desc.mWorldView );
+            Desc.mProjectionInv = ProjectionInv;
+            Desc.uWindowWidth = uWidth;
+            Desc.uWindowHeight = uHeight;
+            Desc.uTileRes = uTileRes;
+            Desc.uMaxNumLightsPerTile = GetMaxNumLightsPerTileForTileRes( uTileRes );
+            Desc.pDepthBuffer = &DepthBuffer[0];
+
+            CpuLightCuller Culler;
+            double fBestTime = 0.0;
+            for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+            {
+                double fStartTime = GetTimeInMs();
+                Culler.Cull( Desc );
+                double fTime = GetTimeInMs() - fStartTime;
+                fBestTime = ( uIteration == 0 || fTime < fBestTime ) ? fTime : fBestTime;
+            }
+
+            unsigned uNumTiles = Culler.GetNumTilesX()*Culler.GetNumTilesY();
+            double fTotalNumLights = 0.0;
+            unsigned uMaxNumLightsInTile = 0;
+            unsigned uNumFullTiles = 0;
+            for( unsigned uTileIdx = 0; uTileIdx < uNumTiles; uTileIdx++ )
+            {
+                unsigned uNumLightsInTile = Culler.GetNumPointLightsInTile( uTileIdx ) + Culler.GetNumSpotLightsInTile( uTileIdx );
+                fTotalNumLights += uNumLightsInTile;
+                uMaxNumLightsInTile = std::max( uMaxNumLightsInTile, uNumLightsInTile );
+                uNumFullTiles += ( uNumLightsInTile + 2 >= Culler.GetMaxNumLightsPerList() ) ? 1 : 0;
+            }
+
+            double fNumLightsPerPixel = 0.0;
+            bool bMatches = CheckLightListsAgainstPixels( Culler, Desc, &DepthBuffer[0], PointLights, SpotLights, uPixelStep, &fNumLightsPerPixel );
+
+            char szResolution[32];
+            sprintf_s( szResolution, sizeof(szResolution), "%ux%u", uWidth, uHeight );
+            fprintf( pFile, "  %10s %6u %8u %10.3f %12.2f %14.2f %10u %10u %10.2f %s\n", szResolution, uTileRes, uNumTiles, fBestTime,
+                fTotalNumLights / uNumTiles, fNumLightsPerPixel, uMaxNumLightsInTile, uNumFullTiles,
+                4.0*Culler.GetLightIndexBufferSize() / ( 1024.0*1024.0 ), bMatches ? "yes" : "NO" );
+        }
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Light list statistics: the list lengths the culling shaders report, at a few resolutions,
+// with the default list capacity and with a small one (to exercise the overflow detection:
+// every overflowed list must have been clamped to the capacity, and every other one kept
+// whole). ms is the time GetLightCullStats takes.
+//-----------------------------------------------------------------------------------------
+static void RunLightCullStatsBenchmark( FILE* pFile )
+{
+    const unsigned uNumLights = 4096;
+    const unsigned Widths[] = { 1280, 1920, 2560, 3840 };
+    const unsigned Heights[] = { 720, 1080, 1440, 2160 };
+    const unsigned uSmallMaxNumLightsPerTile = 16;
+
+    std::vector<XMFLOAT4> PointLights, SpotLights;
+    BuildBenchmarkLights( uNumLights / 2, 1, PointLights );
+    BuildBenchmarkLights( uNumLights / 2, 2, SpotLights );
+
+    fprintf( pFile, "Light list statistics (%u lights, %ux%u tiles, depth bounds, half point/half spot lights)\n",
+        uNumLights, DEFAULT_TILE_RES, DEFAULT_TILE_RES );
+    fprintf( pFile, "  %10s %10s %8s %8s %8s %8s %12s %10s %s\n", "Resolution", "Capacity", "Lists", "Mean", "p99", "Max",
+        "Overflowed", "ms", "Clamped correctly" );
+
+    for( unsigned uResolution = 0; uResolution < sizeof(Widths)/sizeof(Widths[0]); uResolution++ )
+    {
+        unsigned uWidth = Widths[uResolution];
+        unsigned uHeight = Heights[uResolution];
+
+        XMFLOAT4X4 Projection, ProjectionInv;
+        BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+        std::vector<float> DepthBuffer;
+        BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+        for( int nSmall = 0; nSmall < 2; nSmall++ )
+        {
+            CpuLightCullDesc Desc;
+            memset( &Desc, 0, sizeof(Desc) );
+            Desc.pPointLightCenterAndRadius = &PointLights[0];
+            Desc.uNumPointLights = (unsigned)PointLights.size();
+            Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+            Desc.uNumSpotLights = (unsigned)SpotLights.size();
+            SetIdentity( &Desc.mWorldView );
+            Desc.mProjectionInv = ProjectionInv;
+            Desc.uWindowWidth = uWidth;
+            Desc.uWindowHeight = uHeight;
+            Desc.uTileRes = DEFAULT_TILE_RES;
+            Desc.uMaxNumLightsPerTile = nSmall ? uSmallMaxNumLightsPerTile : MAX_NUM_LIGHTS_PER_TILE;
+            Desc.pDepthBuffer = &DepthBuffer[0];
+
+            CpuLightCuller Culler;
+            Culler.Cull( Desc );
+
+            LightCullStats Stats;
+            double fStartTime = GetTimeInMs();
+            Culler.GetLightCullStats( &Stats );
+            double fTime = GetTimeInMs() - fStartTime;
+
+            // lists that overflowed are full, and the others are exactly as long as reported
+            unsigned uNumTiles = Culler.GetNumTilesX()*Culler.GetNumTilesY();
+            unsigned uNumFullTiles = 0;
+            unsigned uMaxNumLightsInTile = 0;
+            double fTotalNumLights = 0.0;
+            for( unsigned uTileIdx = 0; uTileIdx < uNumTiles; uTileIdx++ )
+            {
+                unsigned uNumLightsInTile = Culler.GetNumPointLightsInTile( uTileIdx ) + Culler.GetNumSpotLightsInTile( uTileIdx );
+                uNumFullTiles += ( uNumLightsInTile + 2 == Culler.GetMaxNumLightsPerList() ) ? 1 : 0;
+                uMaxNumLightsInTile = std::max( uMaxNumLightsInTile, uNumLightsInTile );
+                fTotalNumLights += uNumLightsInTile;
+            }
+            bool bClamped = ( Stats.uNumLists == uNumTiles ) && ( Stats.uNumOverflowedLists <= uNumFullTiles );
+            if( Stats.uNumOverflowedLists == 0 )
+            {
+                bClamped = bClamped && ( uMaxNumLightsInTile == Stats.uMaxNumLights ) && ( fabs( fTotalNumLights / uNumTiles - Stats.fMeanNumLights ) < 0.01 );
+            }
+            else
+            {
+                bClamped = bClamped && ( uMaxNumLightsInTile + 2 == Culler.GetMaxNumLightsPerList() ) && ( Stats.uMaxNumLights > uMaxNumLightsInTile );
+            }
+
+            char szResolution[32];
+            sprintf_s( szResolution, sizeof(szResolution), "%ux%u", uWidth, uHeight );
+            fprintf( pFile, "  %10s %10u %8u %8.2f %8u %8u %12u %10.3f %s\n", szResolution, Culler.GetMaxNumLightsPerList(), Stats.uNumLists,
+                Stats.fMeanNumLights, Stats.uP99NumLights, Stats.uMaxNumLights, Stats.uNumOverflowedLists, fTime, bClamped ? "yes" : "NO" );
+        }
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Light index buffer sizing: LightListCapacitySizer fed with the statistics of the CPU
+// culler, from 720p to 8K, over frames in which the lights swell to 1.5 times their radius
+// and back (so the lists get more than twice as long). The statistics reach the sizer
+// LIGHT_CULL_STATS_READBACK_RING_SIZE frames late, like the ones read back from the GPU.
+// The buffer size is compared against the old fixed sizing (the screen height formula,
+// capped at 1080p, which is now only the guess until the first statistics arrive) and
+// against the worst case (every slot as long as the LDS list). Min, max and peak are
+// after the guess.
+//-----------------------------------------------------------------------------------------
+static void RunLightListSizingBenchmark( FILE* pFile )
+{
+    const unsigned uNumLights = 4096;
+    const unsigned uNumFrames = 120;
+    const unsigned uReadbackLatency = 3;
+    const unsigned Widths[] = { 1280, 1920, 3840, 7680 };
+    const unsigned Heights[] = { 720, 1080, 2160, 4320 };
+
+    std::vector<XMFLOAT4> BasePointLights, BaseSpotLights;
+    BuildBenchmarkLights( uNumLights / 2, 1, BasePointLights );
+    BuildBenchmarkLights( uNumLights / 2, 2, BaseSpotLights );
+
+    fprintf( pFile, "Light index buffer sizing (%u lights, %ux%u tiles, depth bounds, %u frames, statistics %u frames late)\n",
+        uNumLights, DEFAULT_TILE_RES, DEFAULT_TILE_RES, uNumFrames, uReadbackLatency );
+    fprintf( pFile, "  %10s %8s %8s %8s %8s %8s %10s %10s %10s %10s %12s\n", "Resolution", "Guess", "Min", "Max", "Final", "Resizes",
+        "Fixed MB", "Worst MB", "Peak MB", "Final MB", "Overflowed" );
+
+    for( unsigned uResolution = 0; uResolution < sizeof(Widths)/sizeof(Widths[0]); uResolution++ )
+    {
+        unsigned uWidth = Widths[uResolution];
+        unsigned uHeight = Heights[uResolution];
+
+        XMFLOAT4X4 Projection, ProjectionInv;
+        BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+        std::vector<float> DepthBuffer;
+        BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+        // what GetMaxNumLightsPerTile used to return, before it was measured
+        unsigned uTunedHeight = ( uHeight > 1080 ) ? 1080 : uHeight;
+        unsigned uFixedCapacity = MAX_NUM_LIGHTS_PER_TILE - 32*( uTunedHeight/120 );
+
+        LightListCapacitySizer Sizer;
+        Sizer.Reset( GetInitialMaxNumLightsPerTile( DEFAULT_TILE_RES, uHeight ), GetMaxNumLightsPerTileForTileRes( DEFAULT_TILE_RES ) );
+        unsigned uInitialCapacity = Sizer.GetCapacity();
+        unsigned uMinCapacity = 0;
+        unsigned uMaxCapacity = 0;
+        unsigned uNumOverflowedLists = 0;
+        std::vector<LightCullStats> PendingStats;
+
+        CpuLightCuller Culler;
+        std::vector<XMFLOAT4> PointLights( BasePointLights ), SpotLights( BaseSpotLights );
+        for( unsigned uFrame = 0; uFrame < uNumFrames; uFrame++ )
+        {
+            float fScale = 1.f + 0.5f*sinf( 3.14159265f*(float)uFrame / (float)uNumFrames );
+            for( unsigned i = 0; i < (unsigned)PointLights.size(); i++ )
+            {
+                PointLights[i].w = fScale*BasePointLights[i].w;
+            }
+            for( unsigned i = 0; i < (unsigned)SpotLights.size(); i++ )
+            {
+                SpotLights[i].w = fScale*BaseSpotLights[i].w;
+            }
+
+            CpuLightCullDesc Desc;
+            memset( &Desc, 0, sizeof(Desc) );
+            Desc.pPointLightCenterAndRadius = &PointLights[0];
+            Desc.uNumPointLights = (unsigned)PointLights.size();
+            Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+            Desc.uNumSpotLights = (unsigned)SpotLights.size();
+            SetIdentity( &Desc.mWorldView );
+            Desc.mProjectionInv = ProjectionInv;
+            Desc.uWindowWidth = uWidth;
+            Desc.uWindowHeight = uHeight;
+            Desc.uTileRes = DEFAULT_TILE_RES;
+            Desc.uMaxNumLightsPerTile = Sizer.GetCapacity();
+            Desc.pDepthBuffer = &DepthBuffer[0];
+            Culler.Cull( Desc );
+
+            LightCullStats Stats;
+            Culler.GetLightCullStats( &Stats );
+            uNumOverflowedLists += Stats.uNumOverflowedLists;
+
+            // the sizer sees the frame uReadbackLatency frames later
+            PendingStats.push_back( Stats );
+            if( PendingStats.size() > uReadbackLatency )
+            {
+                Sizer.Update( PendingStats.front() );
+                PendingStats.erase( PendingStats.begin() );
+
+                // once the guess has been replaced
+                uMinCapacity = ( uMinCapacity == 0 ) ? Sizer.GetCapacity() : std::min( uMinCapacity, Sizer.GetCapacity() );
+                uMaxCapacity = std::max( uMaxCapacity, Sizer.GetCapacity() );
+            }
+        }
+
+        double fBytesPerSlotEntryToMB = 4.0*Culler.GetNumTilesX()*Culler.GetNumTilesY() / ( 1024.0*1024.0 );
+        char szResolution[32];
+        sprintf_s( szResolution, sizeof(szResolution), "%ux%u", uWidth, uHeight );
+        fprintf( pFile, "  %10s %8u %8u %8u %8u %8u %10.2f %10.2f %10.2f %10.2f %12u\n", szResolution, uInitialCapacity, uMinCapacity, uMaxCapacity,
+            Sizer.GetCapacity(), Sizer.GetNumResizes(), uFixedCapacity*fBytesPerSlotEntryToMB,
+            GetMaxNumLightsPerTileForTileRes( DEFAULT_TILE_RES )*fBytesPerSlotEntryToMB, uMaxCapacity*fBytesPerSlotEntryToMB,
+            Sizer.GetCapacity()*fBytesPerSlotEntryToMB, uNumOverflowedLists );
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Hi-Z depth pyramid: the cost of building it (per reduction kernel, at 4K, with and
+// without MSAA), against reducing the pixels of every tile of each tile size like the
+// culling does without it (timed by culling without any lights, which leaves only the
+// depth bounds), and a check that the lists are the same either way
+//-----------------------------------------------------------------------------------------
+
+// An MSAA depth buffer with the samples of a pixel next to each other. Sample s of a
+// pixel takes the depth of a pixel up to one to the right and below, so pixels along
+// the edges of the pillars and the wall get samples from both sides.
+static void BuildBenchmarkMSAADepthBuffer( unsigned uWidth, unsigned uHeight, unsigned uNumSamples, const std::vector<float>& DepthBuffer,
+                                           std::vector<float>& MSAADepthBuffer )
+{
+    MSAADepthBuffer.resize( (size_t)uWidth*uHeight*uNumSamples );
+    for( unsigned y = 0; y < uHeight; y++ )
+    {
+        for( unsigned x = 0; x < uWidth; x++ )
+        {
+            for( unsigned uSample = 0; uSample < uNumSamples; uSample++ )
+            {
+                unsigned uSampleX = std::min( x + ( uSample & 1 ), uWidth - 1 );
+                unsigned uSampleY = std::min( y + ( ( uSample >> 1 ) & 1 ), uHeight - 1 );
+                MSAADepthBuffer[( (size_t)y*uWidth + x )*uNumSamples + uSample] = DepthBuffer[uSampleY*uWidth + uSampleX];
+            }
+        }
+    }
+}
+
+static bool CompareDepthPyramids( const CpuDepthPyramid& Pyramid0, const CpuDepthPyramid& Pyramid1 )
+{
+    for( unsigned uLevel = HIZ_FIRST_LEVEL; uLevel <= HIZ_LAST_LEVEL; uLevel++ )
+    {
+        for( unsigned y = 0; y < Pyramid0.GetLevelHeight( uLevel ); y++ )
+        {
+            for( unsigned x = 0; x < Pyramid0.GetLevelWidth( uLevel ); x++ )
+            {
+                float fMinDepth0, fMaxDepth0, fMinDepth1, fMaxDepth1;
+                Pyramid0.GetMinMaxDepth( uLevel, x, y, &fMinDepth0, &fMaxDepth0 );
+                Pyramid1.GetMinMaxDepth( uLevel, x, y, &fMinDepth1, &fMaxDepth1 );
+                if( fMinDepth0 != fMinDepth1 || fMaxDepth0 != fMaxDepth1 )
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static void RunDepthPyramidBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 3840;
+    const unsigned uHeight = 2160;
+    const unsigned uNumIterations = 5;
+    const unsigned uNumLights = 4096;
+    const unsigned NumSamples[] = { 1, 4, 8 };
+
+    XMFLOAT4X4 Projection, ProjectionInv;
+    BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+    std::vector<float> ResolvedDepthBuffer;
+    BuildBenchmarkColonnadeDepthBuffer( uWidth, uHeight, Projection, ResolvedDepthBuffer );
+
+    std::vector<XMFLOAT4> PointLights, SpotLights;
+    BuildBenchmarkLights( uNumLights / 2, 1, PointLights );
+    BuildBenchmarkLights( uNumLights / 2, 2, SpotLights );
+
+    fprintf( pFile, "Hi-Z depth pyramid build (%ux%u, levels %u to %u, best of %u)\n", uWidth, uHeight, HIZ_FIRST_LEVEL, HIZ_LAST_LEVEL, uNumIterations );
+    fprintf( pFile, "  %8s %-8s %14s %14s %10s %s\n", "Samples", "Kernel", "1 thread ms", "Threads ms", "GB/s", "Matches scalar" );
+
+    for( unsigned uSampleCount = 0; uSampleCount < sizeof(NumSamples)/sizeof(NumSamples[0]); uSampleCount++ )
+    {
+        unsigned uNumSamples = NumSamples[uSampleCount];
+        std::vector<float> DepthBuffer;
+        BuildBenchmarkMSAADepthBuffer( uWidth, uHeight, uNumSamples, ResolvedDepthBuffer, DepthBuffer );
+
+        // (AVX2 uses the SSE2 reduction)
+        CpuDepthPyramid ScalarPyramid;
+        for( int nKernel = CPU_CULL_KERNEL_SCALAR; nKernel <= CPU_CULL_KERNEL_SSE2; nKernel++ )
+        {
+            CpuCullKernel eKernel = (CpuCullKernel)nKernel;
+            if( ResolveCpuCullKernel( eKernel ) != eKernel )
+            {
+                fprintf( pFile, "  %8u %-8s %14s\n", uNumSamples, GetCpuCullKernelName( eKernel ), "n/a" );
+                continue;
+            }
+
+            CpuDepthPyramid Pyramid;
+            Pyramid.SetKernel( eKernel );
+            double fBestTime[2] = { 0.0, 0.0 };
+            for( int nMultiThreaded = 0; nMultiThreaded < 2; nMultiThreaded++ )
+            {
+                Pyramid.SetNumThreads( nMultiThreaded ? 0 : 1 );
+                for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+                {
+                    double fStartTime = GetTimeInMs();
+                    Pyramid.Build( &DepthBuffer[0], uWidth, uHeight, 0, uNumSamples );
+                    double fTime = GetTimeInMs() - fStartTime;
+                    fBestTime[nMultiThreaded] = ( uIteration == 0 || fTime < fBestTime[nMultiThreaded] ) ? fTime : fBestTime[nMultiThreaded];
+                }
+            }
+
+            if( eKernel == CPU_CULL_KERNEL_SCALAR )
+            {
+                ScalarPyramid.Build( &DepthBuffer[0], uWidth, uHeight, 0, uNumSamples );
+            }
+
+            double fGBPerSecond = 4.0*DepthBuffer.size() / ( fBestTime[1]*1e6 );
+            fprintf( pFile, "  %8u %-8s %14.3f %14.3f %10.2f %s\n", uNumSamples, GetCpuCullKernelName( eKernel ), fBestTime[0], fBestTime[1],
+                fGBPerSecond, CompareDepthPyramids( Pyramid, ScalarPyramid ) ? "yes" : "NO" );
+        }
+    }
+
+    fprintf( pFile, "\n" );
+    fprintf( pFile, "Tile depth bounds from the pixels vs. from the pyramid (%ux%u, %u threads, best of %u, ms without lights, lists with %u lights)\n",
+        uWidth, uHeight, GetDefaultNumThreads(), uNumIterations, uNumLights );
+    fprintf( pFile, "  %8s %6s %12s %12s %s\n", "Samples", "Tile", "Pixels ms", "Pyramid ms", "Same lists" );
+
+    for( unsigned uSampleCount = 0; uSampleCount < sizeof(NumSamples)/sizeof(NumSamples[0]); uSampleCount++ )
+    {
+        unsigned uNumSamples = NumSamples[uSampleCount];
+        std::vector<float> DepthBuffer;
+        BuildBenchmarkMSAADepthBuffer( uWidth, uHeight, uNumSamples, ResolvedDepthBuffer, DepthBuffer );
+
+        // one pyramid serves all the tile sizes
+        CpuDepthPyramid Pyramid;
+        double fBuildTime = 0.0;
+        for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+        {
+            double fStartTime = GetTimeInMs();
+            Pyramid.Build( &DepthBuffer[0], uWidth, uHeight, 0, uNumSamples );
+            double fTime = GetTimeInMs() - fStartTime;
+            fBuildTime = ( uIteration == 0 || fTime < fBuildTime ) ? fTime : fBuildTime;
+        }
+        fprintf( pFile, "  %8u %6s %12s %12.3f\n", uNumSamples, "build", "", fBuildTime );
+
+        double fTotalTime[2] = { 0.0, fBuildTime };
+        for( unsigned uTileResIdx = 0; uTileResIdx < NUM_TILE_RES; uTileResIdx++ )
+        {
+            unsigned uTileRes = GetTileRes( uTileResIdx );
+
+            CpuLightCullDesc Desc;
+            memset( &Desc, 0, sizeof(Desc) );
+            SetIdentity( &Desc.mWorldView );
+            Desc.mProjectionInv = ProjectionInv;
+            Desc.uWindowWidth = uWidth;
+            Desc.uWindowHeight = uHeight;
+            Desc.uTileRes = uTileRes;
+            Desc.uMaxNumLightsPerTile = GetMaxNumLightsPerTileForTileRes( uTileRes );
+            Desc.pDepthBuffer = &DepthBuffer[0];
+            Desc.uDepthBufferNumSamples = uNumSamples;
+
+            CpuLightCuller Cullers[2];
+            double fBestTime[2] = { 0.0, 0.0 };
+            for( int nPyramid = 0; nPyramid < 2; nPyramid++ )
+            {
+                Desc.pDepthPyramid = nPyramid ? &Pyramid : NULL;
+                Desc.uNumPointLights = 0;
+                Desc.uNumSpotLights = 0;
+                for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+                {
+                    double fStartTime = GetTimeInMs();
+                    Cullers[nPyramid].Cull( Desc );
+                    double fTime = GetTimeInMs() - fStartTime;
+                    fBestTime[nPyramid] = ( uIteration == 0 || fTime < fBestTime[nPyramid] ) ? fTime : fBestTime[nPyramid];
+                }
+                fTotalTime[nPyramid] += fBestTime[nPyramid];
+
+                Desc.pPointLightCenterAndRadius = &PointLights[0];
+                Desc.uNumPointLights = (unsigned)PointLights.size();
+                Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+                Desc.uNumSpotLights = (unsigned)SpotLights.size();
+                Cullers[nPyramid].Cull( Desc );
+            }
+
+            bool bSameLists = Cullers[0].GetLightIndexBufferSize() == Cullers[1].GetLightIndexBufferSize() &&
+                memcmp( Cullers[0].GetLightIndexBuffer(), Cullers[1].GetLightIndexBuffer(), Cullers[0].GetLightIndexBufferSize()*sizeof(unsigned) ) == 0;
+            fprintf( pFile, "  %8u %6u %12.3f %12.3f %s\n", uNumSamples, uTileRes, fBestTime[0], fBestTime[1], bSameLists ? "yes" : "NO" );
+        }
+        fprintf( pFile, "  %8u %6s %12.3f %12.3f\n", uNumSamples, "all", fTotalTime[0], fTotalTime[1] );
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Two-level culling: one pass over all lights per tile vs. a pass over all lights per
+// coarse tile, and then one over the coarse tile's lights per tile, with the lights
+// culled by brute force and by the BVH. Tests counts the sphere vs. tile tests of each
+// (in millions). The two-level lists may only be missing lights that cannot touch the 
+// tile (see SetUseCoarseTiles), so they are checked against the pixels, and Dropped 
+// counts the entries they have less than the one-level lists.
+//-----------------------------------------------------------------------------------------
+static void RunCoarseTileBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 1920;
+    const unsigned uHeight = 1080;
+    const unsigned uTileRes = 16;
+    const unsigned uNumIterations = 3;
+    const unsigned uPixelStep = 7;  // brute-force check every 7th pixel in x and y
+    const unsigned NumLights[] = { 2048, 8192, 32768 };
+
+    XMFLOAT4X4 Projection, ProjectionInv;
+    BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+    std::vector<float> DepthBuffer;
+    BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+    fprintf( pFile, "Two-level culling, %ux%u coarse tiles then %ux%u tiles (%ux%u, %u threads, best of %u, depth bounds, half point/half spot lights)\n",
+        COARSE_TILE_RES, COARSE_TILE_RES, uTileRes, uTileRes, uWidth, uHeight, GetDefaultNumThreads(), uNumIterations );
+    fprintf( pFile, "  %8s %6s %10s %10s %9s %14s %10s %10s %8s %s\n", "Lights", "Mode", "1-level ms", "2-level ms", "Speedup",
+        "Lights/coarse", "1-level MT", "2-level MT", "Dropped", "Matches reference" );
+
+    bool bAllMatch = true;
+    for( unsigned uLightCount = 0; uLightCount < sizeof(NumLights)/sizeof(NumLights[0]); uLightCount++ )
+    {
+        std::vector<XMFLOAT4> PointLights, SpotLights;
+        BuildBenchmarkLights( NumLights[uLightCount] / 2, 1, PointLights );
+        BuildBenchmarkLights( NumLights[uLightCount] - NumLights[uLightCount] / 2, 2, SpotLights );
+
+        CpuLightCullDesc Desc;
+        memset( &Desc, 0, sizeof(Desc) );
+        Desc.pPointLightCenterAndRadius = &PointLights[0];
+        Desc.uNumPointLights = (unsigned)PointLights.size();
+        Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+        Desc.uNumSpotLights = (unsigned)SpotLights.size();
+        SetIdentity( &Desc.mWorldView );
+        Desc.mProjectionInv = ProjectionInv;
+        Desc.uWindowWidth = uWidth;
+        Desc.uWindowHeight = uHeight;
+        Desc.uTileRes = uTileRes;
+        Desc.uMaxNumLightsPerTile = GetMaxNumLightsPerTileForTileRes( uTileRes );
+        Desc.pDepthBuffer = &DepthBuffer[0];
+
+        for( unsigned uUseLightBvh = 0; uUseLightBvh < 2; uUseLightBvh++ )
+        {
+            CpuLightCuller OneLevelCuller, TwoLevelCuller;
+            OneLevelCuller.SetUseLightBvh( uUseLightBvh != 0 );
+            TwoLevelCuller.SetUseLightBvh( uUseLightBvh != 0 );
+            TwoLevelCuller.SetUseCoarseTiles( true );
+
+            double fBestOneLevelTime = 0.0, fBestTwoLevelTime = 0.0;
+            for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+            {
+                double fStartTime = GetTimeInMs();
+                OneLevelCuller.Cull( Desc );
+                double fTime = GetTimeInMs() - fStartTime;
+                fBestOneLevelTime = ( uIteration == 0 || fTime < fBestOneLevelTime ) ? fTime : fBestOneLevelTime;
+
+                fStartTime = GetTimeInMs();
+                TwoLevelCuller.Cull( Desc );
+                fTime = GetTimeInMs() - fStartTime;
+                fBestTwoLevelTime = ( uIteration == 0 || fTime < fBestTwoLevelTime ) ? fTime : fBestTwoLevelTime;
+            }
+
+            // every tile tests the lights of its coarse tile, every coarse tile tests all of them
+            unsigned uNumTiles = OneLevelCuller.GetNumTilesX()*OneLevelCuller.GetNumTilesY();
+            unsigned uNumCoarseTiles = TwoLevelCuller.GetNumCoarseTilesX()*TwoLevelCuller.GetNumCoarseTilesY();
+            unsigned uTilesPerCoarseTile = COARSE_TILE_RES / uTileRes;
+            double fNumCoarseTileLights = 0.0;
+            double fNumTwoLevelTests = (double)uNumCoarseTiles*NumLights[uLightCount];
+            for( unsigned uTileIdx = 0; uTileIdx < uNumTiles; uTileIdx++ )
+            {
+                unsigned uCoarseTileX = ( uTileIdx % TwoLevelCuller.GetNumTilesX() ) / uTilesPerCoarseTile;
+                unsigned uCoarseTileY = ( uTileIdx / TwoLevelCuller.GetNumTilesX() ) / uTilesPerCoarseTile;
+                fNumTwoLevelTests += TwoLevelCuller.GetNumLightsInCoarseTile( uCoarseTileY*TwoLevelCuller.GetNumCoarseTilesX() + uCoarseTileX );
+            }
+            for( unsigned uCoarseTileIdx = 0; uCoarseTileIdx < uNumCoarseTiles; uCoarseTileIdx++ )
+            {
+                fNumCoarseTileLights += TwoLevelCuller.GetNumLightsInCoarseTile( uCoarseTileIdx );
+            }
+            double fNumOneLevelTests = (double)uNumTiles*NumLights[uLightCount];
+
+            unsigned uNumDropped = 0;
+            for( unsigned uTileIdx = 0; uTileIdx < uNumTiles; uTileIdx++ )
+            {
+                uNumDropped += OneLevelCuller.GetNumPointLightsInTile( uTileIdx ) + OneLevelCuller.GetNumSpotLightsInTile( uTileIdx ) -
+                    TwoLevelCuller.GetNumPointLightsInTile( uTileIdx ) - TwoLevelCuller.GetNumSpotLightsInTile( uTileIdx );
+            }
+
+            double fNumLightsPerPixel = 0.0;
+            bool bMatches = CheckLightListsAgainstPixels( TwoLevelCuller, Desc, &DepthBuffer[0], PointLights, SpotLights, uPixelStep, &fNumLightsPerPixel );
+            bAllMatch = bAllMatch && bMatches;
+
+            fprintf( pFile, "  %8u %6s %10.3f %10.3f %8.2fx %14.1f %10.2f %10.2f %8u %s\n", NumLights[uLightCount], ( uUseLightBvh != 0 ) ? "BVH" : "all",
+                fBestOneLevelTime, fBestTwoLevelTime, fBestOneLevelTime / fBestTwoLevelTime, fNumCoarseTileLights / uNumCoarseTiles,
+                fNumOneLevelTests / 1e6, fNumTwoLevelTests / 1e6, uNumDropped, bMatches ? "yes" : "NO" );
+        }
+    }
+
+    fprintf( pFile, "  Two-level lists %s\n", bAllMatch ? "match the reference" : "DO NOT MATCH the reference" );
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Spot cone culling: the spot lights culled by their bounding spheres vs. by their cones
+// (the sample's 35 degree cones, fitted into the spheres, pointing in random directions).
+// Rejected counts the false positives of the sphere test (tile and spot light pairs that 
+// only the cone test drops), and Saved/pixel how many fewer spot lights the pixels loop 
+// over. The cone lists are checked against the pixels the spot lights actually light.
+//-----------------------------------------------------------------------------------------
+static void RunSpotConeBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 1920;
+    const unsigned uHeight = 1080;
+    const unsigned uNumIterations = 3;
+    const unsigned uPixelStep = 7;  // brute-force check every 7th pixel in x and y
+    const unsigned NumLights[] = { 2048, 8192 };
+
+    XMFLOAT4X4 Projection, ProjectionInv;
+    BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+    std::vector<float> DepthBuffer;
+    BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+    fprintf( pFile, "Spot cone culling (%ux%u, %ux%u tiles, %u threads, best of %u, half point/half spot lights)\n",
+        uWidth, uHeight, DEFAULT_TILE_RES, DEFAULT_TILE_RES, GetDefaultNumThreads(), uNumIterations );
+    fprintf( pFile, "  %8s %6s %12s %12s %10s %8s %12s %12s %10s %10s %s\n", "Lights", "Depth", "Sphere pairs", "Cone pairs",
+        "Rejected", "Rejected%", "Lights/pixel", "Saved/pixel", "Sphere ms", "Cone ms", "Matches reference" );
+
+    bool bAllMatch = true;
+    for( unsigned uLightCount = 0; uLightCount < sizeof(NumLights)/sizeof(NumLights[0]); uLightCount++ )
+    {
+        std::vector<XMFLOAT4> PointLights, SpotLights;
+        BuildBenchmarkLights( NumLights[uLightCount] / 2, 1, PointLights );
+        BuildBenchmarkLights( NumLights[uLightCount] - NumLights[uLightCount] / 2, 2, SpotLights );
+
+        std::vector<SpotParams> SpotLightSpotParams;
+        BuildBenchmarkSpotParams( SpotLights, 3, SpotLightSpotParams );
+
+        for( unsigned uUseDepthBounds = 0; uUseDepthBounds < 2; uUseDepthBounds++ )
+        {
+            CpuLightCullDesc Desc;
+            memset( &Desc, 0, sizeof(Desc) );
+            Desc.pPointLightCenterAndRadius = &PointLights[0];
+            Desc.uNumPointLights = (unsigned)PointLights.size();
+            Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+            Desc.uNumSpotLights = (unsigned)SpotLights.size();
+            SetIdentity( &Desc.mWorldView );
+            Desc.mProjectionInv = ProjectionInv;
+            Desc.uWindowWidth = uWidth;
+            Desc.uWindowHeight = uHeight;
+            Desc.uTileRes = DEFAULT_TILE_RES;
+            Desc.uMaxNumLightsPerTile = MAX_NUM_LIGHTS_PER_TILE;
+            Desc.pDepthBuffer = ( uUseDepthBounds != 0 ) ? &DepthBuffer[0] : NULL;
+
+            CpuLightCullDesc ConeDesc = Desc;
+            ConeDesc.pSpotLightSpotParams = &SpotLightSpotParams[0];
+
+            CpuLightCuller SphereCuller, ConeCuller;
+            double fBestSphereTime = 0.0, fBestConeTime = 0.0;
+            for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+            {
+                double fStartTime = GetTimeInMs();
+                SphereCuller.Cull( Desc );
+                double fTime = GetTimeInMs() - fStartTime;
+                fBestSphereTime = ( uIteration == 0 || fTime < fBestSphereTime ) ? fTime : fBestSphereTime;
+
+                fStartTime = GetTimeInMs();
+                ConeCuller.Cull( ConeDesc );
+                fTime = GetTimeInMs() - fStartTime;
+                fBestConeTime = ( uIteration == 0 || fTime < fBestConeTime ) ? fTime : fBestConeTime;
+            }
+
+            unsigned uNumTiles = SphereCuller.GetNumTilesX()*SphereCuller.GetNumTilesY();
+            unsigned uNumSpherePairs = 0, uNumConePairs = 0;
+            for( unsigned uTileIdx = 0; uTileIdx < uNumTiles; uTileIdx++ )
+            {
+                uNumSpherePairs += SphereCuller.GetNumSpotLightsInTile( uTileIdx );
+                uNumConePairs += ConeCuller.GetNumSpotLightsInTile( uTileIdx );
+            }
+
+            LightCullStats Stats;
+            ConeCuller.GetLightCullStats( &Stats );
+
+            // the pixels without depth bounds are the same, only the lists are longer
+            double fSphereLightsPerPixel = 0.0, fConeLightsPerPixel = 0.0;
+            CheckLightListsAgainstPixels( SphereCuller, Desc, &DepthBuffer[0], PointLights, SpotLights, uPixelStep, &fSphereLightsPerPixel );
+            bool bMatches = CheckLightListsAgainstPixels( ConeCuller, ConeDesc, &DepthBuffer[0], PointLights, SpotLights, uPixelStep, &fConeLightsPerPixel );
+
+            // the counter must account for exactly the entries the cones removed
+            bMatches = bMatches && ( uNumSpherePairs - uNumConePairs == Stats.uNumSpotConeRejections );
+            bAllMatch = bAllMatch && bMatches;
+
+            fprintf( pFile, "  %8u %6s %12u %12u %10u %8.1f%% %12.2f %12.2f %10.3f %10.3f %s\n", NumLights[uLightCount], ( uUseDepthBounds != 0 ) ? "yes" : "no",
+                uNumSpherePairs, uNumConePairs, Stats.uNumSpotConeRejections, 100.0*Stats.uNumSpotConeRejections / ( uNumSpherePairs > 0 ? uNumSpherePairs : 1 ),
+                fConeLightsPerPixel, fSphereLightsPerPixel - fConeLightsPerPixel, fBestSphereTime, fBestConeTime, bMatches ? "yes" : "NO" );
+        }
+    }
+
+    fprintf( pFile, "  Cone lists %s\n", bAllMatch ? "match the reference" : "DO NOT MATCH the reference" );
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Temporal reuse: culling every frame from scratch vs. keeping the lists of the tiles that 
+// nothing changed in, with the camera standing still and some of the point lights animated 
+// (the first ones, see LightAnimator), and with the camera moving. Culled and Reused are 
+// the mean number of tiles per frame. The lists (and their statistics) must be the same.
+//-----------------------------------------------------------------------------------------
+static bool HaveSameLightLists( const CpuLightCuller& Culler0, const CpuLightCuller& Culler1 )
+{
+    if( Culler0.GetNumLists() != Culler1.GetNumLists() )
+    {
+        return false;
+    }
+
+    // only up to the second sentinel, what comes after it is left over from earlier lists
+    for( unsigned uListIdx = 0; uListIdx < Culler0.GetNumLists(); uListIdx++ )
+    {
+        unsigned uNumPointLights = Culler0.GetNumPointLightsInTile( uListIdx );
+        unsigned uNumSpotLights = Culler0.GetNumSpotLightsInTile( uListIdx );
+        if( uNumPointLights != Culler1.GetNumPointLightsInTile( uListIdx ) || uNumSpotLights != Culler1.GetNumSpotLightsInTile( uListIdx ) ||
+            memcmp( Culler0.GetPointLightsInTile( uListIdx ), Culler1.GetPointLightsInTile( uListIdx ), ( uNumPointLights + uNumSpotLights + 2 )*sizeof(unsigned) ) != 0 )
+        {
+            return false;
+        }
+    }
+
+    LightCullStats Stats0, Stats1;
+    Culler0.GetLightCullStats( &Stats0 );
+    Culler1.GetLightCullStats( &Stats1 );
+    return Stats0.Histogram == Stats1.Histogram && Stats0.uNumOverflowedLists == Stats1.uNumOverflowedLists &&
+        Stats0.uNumSpotConeRejections == Stats1.uNumSpotConeRejections;
+}
+
+static void RunTemporalReuseBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 1920;
+    const unsigned uHeight = 1080;
+    const unsigned uNumLights = 4096;
+    const unsigned uNumFrames = 30;
+    const unsigned NumAnimatedLights[] = { 0, 4, 16, 64, 256, 0 };
+    const unsigned uNumScenarios = sizeof(NumAnimatedLights)/sizeof(NumAnimatedLights[0]);
+
+    XMFLOAT4X4 Projection, ProjectionInv;
+    BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+    std::vector<float> DepthBuffer;
+    BuildBenchmarkColonnadeDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+    fprintf( pFile, "Temporal reuse (%ux%u, %ux%u tiles, %u threads, %u lights, spot cones, depth bounds, %u frames at 60 Hz, mean per frame)\n",
+        uWidth, uHeight, DEFAULT_TILE_RES, DEFAULT_TILE_RES, GetDefaultNumThreads(), uNumLights, uNumFrames );
+    fprintf( pFile, "  %-14s %8s %10s %10s %10s %10s %s\n", "Camera", "Animated", "Culled", "Reused", "Full ms", "Reuse ms", "Matches reference" );
+
+    bool bAllMatch = true;
+    for( unsigned uScenario = 0; uScenario < uNumScenarios; uScenario++ )
+    {
+        // the last scenario moves the camera instead
+        bool bMovingCamera = ( uScenario == uNumScenarios - 1 );
+
+        std::vector<XMFLOAT4> PointLights, SpotLights;
+        BuildBenchmarkLights( uNumLights / 2, 1, PointLights );
+        BuildBenchmarkLights( uNumLights - uNumLights / 2, 2, SpotLights );
+
+        std::vector<SpotParams> SpotLightSpotParams;
+        BuildBenchmarkSpotParams( SpotLights, 3, SpotLightSpotParams );
+
+        LightAnimator Animator;
+        Animator.Resize( (unsigned)PointLights.size() );
+        for( unsigned i = 0; i < (unsigned)PointLights.size(); i++ )
+        {
+            Animator.SetLight( i, PointLights[i], 0xffc08040, i, 0.5f*PointLights[i].w );
+        }
+
+        CpuLightCullDesc Desc;
+        memset( &Desc, 0, sizeof(Desc) );
+        Desc.pPointLightCenterAndRadius = Animator.GetCenterAndRadius();
+        Desc.uNumPointLights = (unsigned)PointLights.size();
+        Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+        Desc.uNumSpotLights = (unsigned)SpotLights.size();
+        Desc.pSpotLightSpotParams = &SpotLightSpotParams[0];
+        SetIdentity( &Desc.mWorldView );
+        Desc.mProjectionInv = ProjectionInv;
+        Desc.uWindowWidth = uWidth;
+        Desc.uWindowHeight = uHeight;
+        Desc.uTileRes = DEFAULT_TILE_RES;
+        Desc.uMaxNumLightsPerTile = MAX_NUM_LIGHTS_PER_TILE;
+        Desc.pDepthBuffer = &DepthBuffer[0];
+
+        CpuLightCuller FullCuller, ReuseCuller;
+        ReuseCuller.SetUseTemporalReuse( true );
+
+        // the first frame culls everything either way
+        FullCuller.Cull( Desc );
+        ReuseCuller.Cull( Desc );
+
+        bool bMatches = true;
+        double fTotalFullTime = 0.0, fTotalReuseTime = 0.0;
+        double fTotalNumCulledTiles = 0.0, fTotalNumReusedTiles = 0.0;
+        for( unsigned uFrame = 0; uFrame < uNumFrames; uFrame++ )
+        {
+            Animator.Update( (float)( uFrame + 1 ) / 60.f, NumAnimatedLights[uScenario], 1 );
+            Desc.mWorldView._41 = bMovingCamera ? 0.1f*( uFrame + 1 ) : 0.f;
+
+            double fStartTime = GetTimeInMs();
+            FullCuller.Cull( Desc );
+            fTotalFullTime += GetTimeInMs() - fStartTime;
+
+            fStartTime = GetTimeInMs();
+            ReuseCuller.Cull( Desc );
+            fTotalReuseTime += GetTimeInMs() - fStartTime;
+
+            fTotalNumCulledTiles += ReuseCuller.GetNumCulledTiles();
+            fTotalNumReusedTiles += ReuseCuller.GetNumReusedTiles();
+            bMatches = bMatches && HaveSameLightLists( FullCuller, ReuseCuller );
+        }
+        bAllMatch = bAllMatch && bMatches;
+
+        fprintf( pFile, "  %-14s %8u %10.1f %10.1f %10.3f %10.3f %s\n", bMovingCamera ? "moving" : "still", NumAnimatedLights[uScenario],
+            fTotalNumCulledTiles / uNumFrames, fTotalNumReusedTiles / uNumFrames, fTotalFullTime / uNumFrames, fTotalReuseTime / uNumFrames, bMatches ? "yes" : "NO" );
+    }
+
+    fprintf( pFile, "  Reused lists %s\n", bAllMatch ? "match the reference" : "DO NOT MATCH the reference" );
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Frustum pre-cull: the lights spread over the whole scene around the camera, like the 
+// sample's, and culled against the camera frustum before the tiles are, so that the tiles 
+// only loop over the visible ones. Tests is the number of light vs. tile tests (every tile 
+// loops over every light it is given). With depth bounds, the lists of the visible lights, 
+// remapped, must be the same as the lists of all of them.
+//-----------------------------------------------------------------------------------------
+
+// world-space lights around the camera (at the origin), of which it only sees part
+static void BuildBenchmarkSceneLights( unsigned uNumLights, unsigned uSeed, std::vector<XMFLOAT4>& Lights )
+{
+    BenchmarkRandom Random( uSeed );
+    float fRadius = 12.f*sqrtf( 2048.f / (float)uNumLights );
+
+    Lights.resize( uNumLights );
+    for( unsigned i = 0; i < uNumLights; i++ )
+    {
+        float x = Random.Next( -400.f, 400.f );
+        float y = Random.Next( -30.f, 30.f );
+        float z = Random.Next( -400.f, 400.f );
+        Lights[i] = XMFLOAT4( x, y, z, fRadius );
+    }
+}
+
+static void MultiplyBenchmarkMatrices( const XMFLOAT4X4& A, const XMFLOAT4X4& B, XMFLOAT4X4* pResult )
+{
+    for( int i = 0; i < 4; i++ )
+    {
+        for( int j = 0; j < 4; j++ )
+        {
+            pResult->m[i][j] = A.m[i][0]*B.m[0][j] + A.m[i][1]*B.m[1][j] + A.m[i][2]*B.m[2][j] + A.m[i][3]*B.m[3][j];
+        }
+    }
+}
+
+// the same planes as AMD::ExtractPlanesFromFrustum (which needs DXUT), normalized
+static void ExtractBenchmarkFrustumPlanes( const XMFLOAT4X4& M, XMFLOAT4* pPlanes )
+{
+    pPlanes[0] = XMFLOAT4( M._14 + M._11, M._24 + M._21, M._34 + M._31, M._44 + M._41 );   // left
+    pPlanes[1] = XMFLOAT4( M._14 - M._11, M._24 - M._21, M._34 - M._31, M._44 - M._41 );   // right
+    pPlanes[2] = XMFLOAT4( M._14 - M._12, M._24 - M._22, M._34 - M._32, M._44 - M._42 );   // top
+    pPlanes[3] = XMFLOAT4( M._14 + M._12, M._24 + M._22, M._34 + M._32, M._44 + M._42 );   // bottom
+    pPlanes[4] = XMFLOAT4( M._13, M._23, M._33, M._43 );                                   // near
+    pPlanes[5] = XMFLOAT4( M._14 - M._13, M._24 - M._23, M._34 - M._33, M._44 - M._43 );   // far
+    for( unsigned p = 0; p < NUM_FRUSTUM_PLANES; p++ )
+    {
+        float fLength = sqrtf( pPlanes[p].x*pPlanes[p].x + pPlanes[p].y*pPlanes[p].y + pPlanes[p].z*pPlanes[p].z );
+        pPlanes[p] = XMFLOAT4( pPlanes[p].x / fLength, pPlanes[p].y / fLength, pPlanes[p].z / fLength, pPlanes[p].w / fLength );
+    }
+}
+
+// whether a list of the compacted lights, mapped back through the remap tables, is the list of all of them
+static bool HasSameRemappedList( const CpuLightCuller& Culler, const CpuLightCuller& VisibleCuller, unsigned uListIdx,
+                                 const std::vector<unsigned>& VisiblePointLights, const std::vector<unsigned>& VisibleSpotLights )
+{
+    unsigned uNumPointLights = Culler.GetNumPointLightsInTile( uListIdx );
+    unsigned uNumSpotLights = Culler.GetNumSpotLightsInTile( uListIdx );
+    if( uNumPointLights != VisibleCuller.GetNumPointLightsInTile( uListIdx ) || uNumSpotLights != VisibleCuller.GetNumSpotLightsInTile( uListIdx ) )
+    {
+        return false;
+    }
+
+    const unsigned* pPointLights = Culler.GetPointLightsInTile( uListIdx );
+    const unsigned* pVisiblePointLights = VisibleCuller.GetPointLightsInTile( uListIdx );
+    for( unsigned i = 0; i < uNumPointLights; i++ )
+    {
+        if( VisiblePointLights[pVisiblePointLights[i]] != pPointLights[i] )
+        {
+            return false;
+        }
+    }
+
+    const unsigned* pSpotLights = Culler.GetSpotLightsInTile( uListIdx );
+    const unsigned* pVisibleSpotLights = VisibleCuller.GetSpotLightsInTile( uListIdx );
+    for( unsigned i = 0; i < uNumSpotLights; i++ )
+    {
+        if( VisibleSpotLights[pVisibleSpotLights[i]] != pSpotLights[i] )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void RunFrustumPreCullBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 1920;
+    const unsigned uHeight = 1080;
+    const unsigned uNumLights = 8192;
+    const unsigned uNumIterations = 3;
+    const unsigned uNumYaws = 4;
+
+    XMFLOAT4X4 Projection, ProjectionInv;
+    BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+    std::vector<float> DepthBuffer;
+    BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+    std::vector<XMFLOAT4> PointLights, SpotLights;
+    BuildBenchmarkSceneLights( uNumLights / 2, 1, PointLights );
+    BuildBenchmarkSceneLights( uNumLights - uNumLights / 2, 2, SpotLights );
+
+    std::vector<SpotParams> SpotLightSpotParams;
+    BuildBenchmarkSpotParams( SpotLights, 3, SpotLightSpotParams );
+
+    fprintf( pFile, "Frustum pre-cull (%ux%u, %ux%u tiles, %u threads, best of %u, %u lights around the camera, half spot, spot cones, depth bounds)\n",
+        uWidth, uHeight, DEFAULT_TILE_RES, DEFAULT_TILE_RES, GetDefaultNumThreads(), uNumIterations, uNumLights );
+    fprintf( pFile, "  %5s %8s %8s %10s %10s %12s %12s %10s %10s %s\n", "Yaw", "Visible", "Visible%", "Scalar ms", "SSE2 ms",
+        "Tests (M)", "Visible (M)", "All ms", "Visible ms", "Matches reference" );
+
+    bool bAllMatch = true;
+    for( unsigned uYaw = 0; uYaw < uNumYaws; uYaw++ )
+    {
+        // the camera turns around in place
+        float fYaw = 2.f*3.14159265f*(float)uYaw / (float)uNumYaws;
+        XMFLOAT4X4 WorldView;
+        SetIdentity( &WorldView );
+        WorldView._11 = cosf( fYaw );
+        WorldView._13 = -sinf( fYaw );
+        WorldView._31 = sinf( fYaw );
+        WorldView._33 = cosf( fYaw );
+
+        XMFLOAT4X4 WorldViewProjection;
+        MultiplyBenchmarkMatrices( WorldView, Projection, &WorldViewProjection );
+        XMFLOAT4 Planes[NUM_FRUSTUM_PLANES];
+        ExtractBenchmarkFrustumPlanes( WorldViewProjection, Planes );
+
+        std::vector<unsigned> VisiblePointLights( PointLights.size() ), VisibleSpotLights( SpotLights.size() );
+        std::vector<unsigned> ScalarVisiblePointLights( PointLights.size() ), ScalarVisibleSpotLights( SpotLights.size() );
+        unsigned uNumVisiblePointLights = 0, uNumVisibleSpotLights = 0;
+        unsigned uNumScalarVisiblePointLights = 0, uNumScalarVisibleSpotLights = 0;
+        double fBestScalarTime = 0.0, fBestTime = 0.0;
+        for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+        {
+            double fStartTime = GetTimeInMs();
+            uNumScalarVisiblePointLights = CullLightsToFrustumScalar( Planes, &PointLights[0], (unsigned)PointLights.size(), &ScalarVisiblePointLights[0] );
+            uNumScalarVisibleSpotLights = CullLightsToFrustumScalar( Planes, &SpotLights[0], (unsigned)SpotLights.size(), &ScalarVisibleSpotLights[0] );
+            double fTime = GetTimeInMs() - fStartTime;
+            fBestScalarTime = ( uIteration == 0 || fTime < fBestScalarTime ) ? fTime : fBestScalarTime;
+
+            fStartTime = GetTimeInMs();
+            uNumVisiblePointLights = CullLightsToFrustum( Planes, &PointLights[0], (unsigned)PointLights.size(), &VisiblePointLights[0] );
+            uNumVisibleSpotLights = CullLightsToFrustum( Planes, &SpotLights[0], (unsigned)SpotLights.size(), &VisibleSpotLights[0] );
+            fTime = GetTimeInMs() - fStartTime;
+            fBestTime = ( uIteration == 0 || fTime < fBestTime ) ? fTime : fBestTime;
+        }
+        VisiblePointLights.resize( uNumVisiblePointLights );
+        VisibleSpotLights.resize( uNumVisibleSpotLights );
+        ScalarVisiblePointLights.resize( uNumScalarVisiblePointLights );
+        ScalarVisibleSpotLights.resize( uNumScalarVisibleSpotLights );
+        bool bMatches = ( VisiblePointLights == ScalarVisiblePointLights && VisibleSpotLights == ScalarVisibleSpotLights );
+
+        // the compacted lights, with one more element so that &[0] is valid when none are visible
+        std::vector<XMFLOAT4> CompactPointLights( uNumVisiblePointLights + 1 ), CompactSpotLights( uNumVisibleSpotLights + 1 );
+        std::vector<SpotParams> CompactSpotLightSpotParams( uNumVisibleSpotLights + 1 );
+        ReorderLightArray( &VisiblePointLights[0], uNumVisiblePointLights, &PointLights[0], &CompactPointLights[0] );
+        ReorderLightArray( &VisibleSpotLights[0], uNumVisibleSpotLights, &SpotLights[0], &CompactSpotLights[0] );
+        ReorderLightArray( &VisibleSpotLights[0], uNumVisibleSpotLights, &SpotLightSpotParams[0], &CompactSpotLightSpotParams[0] );
+
+        CpuLightCullDesc Desc;
+        memset( &Desc, 0, sizeof(Desc) );
+        Desc.pPointLightCenterAndRadius = &PointLights[0];
+        Desc.uNumPointLights = (unsigned)PointLights.size();
+        Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+        Desc.uNumSpotLights = (unsigned)SpotLights.size();
+        Desc.pSpotLightSpotParams = &SpotLightSpotParams[0];
+        Desc.mWorldView = WorldView;
+        Desc.mProjectionInv = ProjectionInv;
+        Desc.uWindowWidth = uWidth;
+        Desc.uWindowHeight = uHeight;
+        Desc.uTileRes = DEFAULT_TILE_RES;
+        Desc.uMaxNumLightsPerTile = MAX_NUM_LIGHTS_PER_TILE;
+        Desc.pDepthBuffer = &DepthBuffer[0];
+
+        CpuLightCullDesc VisibleDesc = Desc;
+        VisibleDesc.pPointLightCenterAndRadius = &CompactPointLights[0];
+        VisibleDesc.uNumPointLights = uNumVisiblePointLights;
+        VisibleDesc.pSpotLightCenterAndRadius = &CompactSpotLights[0];
+        VisibleDesc.uNumSpotLights = uNumVisibleSpotLights;
+        VisibleDesc.pSpotLightSpotParams = &CompactSpotLightSpotParams[0];
+
+        CpuLightCuller Culler, VisibleCuller;
+        double fBestAllTime = 0.0, fBestVisibleTime = 0.0;
+        for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+        {
+            double fStartTime = GetTimeInMs();
+            Culler.Cull( Desc );
+            double fTime = GetTimeInMs() - fStartTime;
+            fBestAllTime = ( uIteration == 0 || fTime < fBestAllTime ) ? fTime : fBestAllTime;
+
+            fStartTime = GetTimeInMs();
+            VisibleCuller.Cull( VisibleDesc );
+            fTime = GetTimeInMs() - fStartTime;
+            fBestVisibleTime = ( uIteration == 0 || fTime < fBestVisibleTime ) ? fTime : fBestVisibleTime;
+        }
+
+        for( unsigned uListIdx = 0; uListIdx < Culler.GetNumLists() && bMatches; uListIdx++ )
+        {
+            bMatches = HasSameRemappedList( Culler, VisibleCuller, uListIdx, VisiblePointLights, VisibleSpotLights );
+        }
+        bAllMatch = bAllMatch && bMatches;
+
+        unsigned uNumVisibleLights = uNumVisiblePointLights + uNumVisibleSpotLights;
+        double fNumTiles = (double)Culler.GetNumTilesX()*Culler.GetNumTilesY();
+        fprintf( pFile, "  %5.0f %8u %7.1f%% %10.3f %10.3f %12.2f %12.2f %10.3f %10.3f %s\n", fYaw*180.f/3.14159265f, uNumVisibleLights,
+            100.0*uNumVisibleLights / uNumLights, fBestScalarTime, fBestTime, fNumTiles*uNumLights / 1e6, fNumTiles*uNumVisibleLights / 1e6,
+            fBestAllTime, fBestVisibleTime, bMatches ? "yes" : "NO" );
+    }
+
+    fprintf( pFile, "  Pre-culled lists %s\n", bAllMatch ? "match the reference" : "DO NOT MATCH the reference" );
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Tile classification (see ClassifyTile), for a 1080p frame of the floor and wall scene 
+// and of the colonnade scene, with the depth mask. Reports the number of tiles of each
+// class, the light tests the empty tiles skip, and the depth mask passes the empty and
+// uniform tiles skip, and checks that the empty tiles got empty lists, that the
+// statistics count the same tiles, and the lists against the brute-force reference.
+//-----------------------------------------------------------------------------------------
+static void RunTileClassBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 1920;
+    const unsigned uHeight = 1080;
+    const unsigned uNumIterations = 3;
+    const unsigned uPixelStep = 7;
+    const unsigned NumLights[] = { 2048, 16384 };
+    const char* SceneNames[] = { "floor", "colonnade" };
+
+    XMFLOAT4X4 Projection, ProjectionInv;
+    BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+    fprintf( pFile, "Tile classification (%ux%u, %u threads, best of %u, half point/half spot lights, depth mask)\n", uWidth, uHeight, GetDefaultNumThreads(), uNumIterations );
+    fprintf( pFile, "  %-10s %8s %8s %8s %8s %10s %14s %12s %12s %s\n", "Scene", "Lights", "Empty", "Uniform", "Complex", "Cull ms",
+        "Tests skipped", "Masks skipped", "Empty lists", "Matches reference" );
+
+    for( int nScene = 0; nScene < 2; nScene++ )
+    {
+        std::vector<float> DepthBuffer;
+        if( nScene == 0 )
+        {
+            BuildBenchmarkDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+        }
+        else
+        {
+            BuildBenchmarkColonnadeDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+        }
+
+        for( unsigned uLightCount = 0; uLightCount < sizeof(NumLights)/sizeof(NumLights[0]); uLightCount++ )
+        {
+            std::vector<XMFLOAT4> PointLights, SpotLights;
+            BuildBenchmarkLights( NumLights[uLightCount] / 2, 1, PointLights );
+            BuildBenchmarkLights( NumLights[uLightCount] / 2, 2, SpotLights );
+
+            CpuLightCullDesc Desc;
+            memset( &Desc, 0, sizeof(Desc) );
+            Desc.pPointLightCenterAndRadius = &PointLights[0];
+            Desc.uNumPointLights = (unsigned)PointLights.size();
+            Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+            Desc.uNumSpotLights = (unsigned)SpotLights.size();
+            SetIdentity( &Desc.mWorldView );
+            Desc.mProjectionInv = ProjectionInv;
+            Desc.uWindowWidth = uWidth;
+            Desc.uWindowHeight = uHeight;
+            Desc.uMaxNumLightsPerTile = MAX_NUM_LIGHTS_PER_TILE;
+            Desc.pDepthBuffer = &DepthBuffer[0];
+            Desc.bUseDepthMask = true;
+
+            CpuLightCuller Culler;
+            double fBestTime = 0.0;
+            for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+            {
+                double fStartTime = GetTimeInMs();
+                Culler.Cull( Desc );
+                double fTime = GetTimeInMs() - fStartTime;
+                fBestTime = ( uIteration == 0 || fTime < fBestTime ) ? fTime : fBestTime;
+            }
+
+            unsigned uNumTiles = Culler.GetNumTilesX()*Culler.GetNumTilesY();
+            unsigned NumTilesInClass[TILE_CLASS_COUNT] = { 0, 0, 0 };
+            bool bEmptyListsAreEmpty = true;
+            for( unsigned uTileIdx = 0; uTileIdx < uNumTiles; uTileIdx++ )
+            {
+                TileClass eTileClass = Culler.GetTileClass( uTileIdx );
+                NumTilesInClass[eTileClass]++;
+                if( eTileClass == TILE_CLASS_EMPTY )
+                {
+                    bEmptyListsAreEmpty = bEmptyListsAreEmpty && ( Culler.GetNumPointLightsInTile( uTileIdx ) + Culler.GetNumSpotLightsInTile( uTileIdx ) == 0 );
+                }
+            }
+
+            LightCullStats Stats;
+            Culler.GetLightCullStats( &Stats );
+            bool bStatsMatch = ( Stats.uNumEmptyTiles == NumTilesInClass[TILE_CLASS_EMPTY] && 
+                                 Stats.uNumUniformTiles == NumTilesInClass[TILE_CLASS_UNIFORM] && 
+                                 Stats.uNumComplexTiles == NumTilesInClass[TILE_CLASS_COMPLEX] );
+
+            double fNumLightsPerPixel = 0.0;
+            bool bMatches = CheckLightListsAgainstPixels( Culler, Desc, &DepthBuffer[0], PointLights, SpotLights, uPixelStep, &fNumLightsPerPixel );
+
+            fprintf( pFile, "  %-10s %8u %8u %8u %8u %10.3f %13.2fM %12u %12s %s\n", SceneNames[nScene], NumLights[uLightCount],
+                NumTilesInClass[TILE_CLASS_EMPTY], NumTilesInClass[TILE_CLASS_UNIFORM], NumTilesInClass[TILE_CLASS_COMPLEX], fBestTime,
+                (double)NumTilesInClass[TILE_CLASS_EMPTY]*NumLights[uLightCount] / 1e6, uNumTiles - NumTilesInClass[TILE_CLASS_COMPLEX],
+                ( bEmptyListsAreEmpty && bStatsMatch ) ? "yes" : "NO", bMatches ? "yes" : "NO" );
+        }
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// A G-buffer for the CPU shading: the floor and wall scene with the pillars, with the 
+// camera at the origin of world space (the benchmark world-view matrix is the identity)
+//-----------------------------------------------------------------------------------------
+
+// the sample's per-object ambient colors
+static const XMFLOAT4 BENCHMARK_AMBIENT_COLOR_UP( 0.013f, 0.015f, 0.050f, 1.0f );
+static const XMFLOAT4 BENCHMARK_AMBIENT_COLOR_DOWN( 0.0013f, 0.0015f, 0.0050f, 1.0f );
+
+struct BenchmarkShadingScene
+{
+    std::vector<float>      DepthBuffer;
+    std::vector<XMFLOAT3>   Positions;
+    std::vector<XMFLOAT3>   Normals;
+    std::vector<XMFLOAT3>   Tangents;
+    std::vector<XMFLOAT3>   NormalMapSamples;
+    std::vector<XMFLOAT4>   DiffuseSamples;
+
+    std::vector<XMFLOAT4>   PointLights;
+    std::vector<unsigned>   PointLightColors;
+    std::vector<XMFLOAT4>   SpotLights;
+    std::vector<unsigned>   SpotLightColors;
+    std::vector<SpotParams> SpotLightSpotParams;
+};
+
+static void BuildBenchmarkLightColors( unsigned uNumLights, unsigned uSeed, std::vector<unsigned>& Colors )
+{
+    BenchmarkRandom Random( uSeed );
+    Colors.resize( uNumLights );
+    for( unsigned i = 0; i < uNumLights; i++ )
+    {
+        unsigned uR = (unsigned)Random.Next( 0.f, 256.f );
+        unsigned uG = (unsigned)Random.Next( 0.f, 256.f );
+        unsigned uB = (unsigned)Random.Next( 0.f, 256.f );
+        Colors[i] = uR | ( uG << 8 ) | ( uB << 16 ) | 0xff000000;
+    }
+}
+
+static void BuildBenchmarkShadingScene( unsigned uWidth, unsigned uHeight, unsigned uNumLights, BenchmarkShadingScene* pScene )
+{
+    XMFLOAT4X4 Projection, ProjectionInv;
+    BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+    BuildBenchmarkColonnadeDepthBuffer( uWidth, uHeight, Projection, pScene->DepthBuffer );
+
+    unsigned uNumPixels = uWidth*uHeight;
+    pScene->Positions.resize( uNumPixels );
+    for( unsigned y = 0; y < uHeight; y++ )
+    {
+        for( unsigned x = 0; x < uWidth; x++ )
+        {
+            float fDepth = pScene->DepthBuffer[y*uWidth + x];
+            float fViewZ = ( fDepth == 0.f ) ? BENCHMARK_FAR : 1.f / ( fDepth*ProjectionInv._34 + ProjectionInv._44 );
+            float fViewX = ( 2.f*( (float)x + 0.5f ) / (float)uWidth - 1.f )*ProjectionInv._11*fViewZ;
+            float fViewY = ( 1.f - 2.f*( (float)y + 0.5f ) / (float)uHeight )*ProjectionInv._22*fViewZ;
+            pScene->Positions[y*uWidth + x] = XMFLOAT3( fViewX, fViewY, fViewZ );
+        }
+    }
+
+    // the surfaces are flat, so the normal is the cross product of the position 
+    // differences to the neighbors (on the same side of any depth edge)
+    pScene->Normals.resize( uNumPixels );
+    pScene->Tangents.resize( uNumPixels );
+    pScene->NormalMapSamples.resize( uNumPixels );
+    pScene->DiffuseSamples.resize( uNumPixels );
+    for( unsigned y = 0; y < uHeight; y++ )
+    {
+        for( unsigned x = 0; x < uWidth; x++ )
+        {
+            unsigned uPixelIdx = y*uWidth + x;
+            float fDepth = pScene->DepthBuffer[uPixelIdx];
+            unsigned uLeft = ( x > 0 ) ? uPixelIdx - 1 : uPixelIdx;
+            unsigned uRight = ( x + 1 < uWidth ) ? uPixelIdx + 1 : uPixelIdx;
+            unsigned uUp = ( y > 0 ) ? uPixelIdx - uWidth : uPixelIdx;
+            unsigned uDown = ( y + 1 < uHeight ) ? uPixelIdx + uWidth : uPixelIdx;
+            unsigned uNeighborX = ( fabsf( pScene->DepthBuffer[uRight] - fDepth ) <= fabsf( pScene->DepthBuffer[uLeft] - fDepth ) ) ? uRight : uLeft;
+            unsigned uNeighborY = ( fabsf( pScene->DepthBuffer[uDown] - fDepth ) <= fabsf( pScene->DepthBuffer[uUp] - fDepth ) ) ? uDown : uUp;
+
+            const XMFLOAT3& P = pScene->Positions[uPixelIdx];
+            float fSignX = ( uNeighborX == uRight ) ? 1.f : -1.f;
+            float fSignY = ( uNeighborY == uDown ) ? -1.f : 1.f;
+            XMFLOAT3 dX( fSignX*( pScene->Positions[uNeighborX].x - P.x ), fSignX*( pScene->Positions[uNeighborX].y - P.y ), fSignX*( pScene->Positions[uNeighborX].z - P.z ) );
+            XMFLOAT3 dY( fSignY*( pScene->Positions[uNeighborY].x - P.x ), fSignY*( pScene->Positions[uNeighborY].y - P.y ), fSignY*( pScene->Positions[uNeighborY].z - P.z ) );
+
+            // up x right, facing the camera
+            XMFLOAT3 N( dY.y*dX.z - dY.z*dX.y, dY.z*dX.x - dY.x*dX.z, dY.x*dX.y - dY.y*dX.x );
+            float fLength = sqrtf( N.x*N.x + N.y*N.y + N.z*N.z );
+            N = ( fLength > 0.f ) ? XMFLOAT3( N.x / fLength, N.y / fLength, N.z / fLength ) : XMFLOAT3( 0.f, 0.f, -1.f );
+            pScene->Normals[uPixelIdx] = N;
+
+            // along the screen x axis, made perpendicular to the normal
+            float fDot = N.x;
+            XMFLOAT3 T( 1.f - fDot*N.x, -fDot*N.y, -fDot*N.z );
+            fLength = sqrtf( T.x*T.x + T.y*T.y + T.z*T.z );
+            T = ( fLength > 0.f ) ? XMFLOAT3( T.x / fLength, T.y / fLength, T.z / fLength ) : XMFLOAT3( 0.f, 1.f, 0.f );
+            pScene->Tangents[uPixelIdx] = T;
+
+            // bumps in world space, and a checkerboard of two materials (one of them cut 
+            // out by the alpha test, the other one shiny)
+            pScene->NormalMapSamples[uPixelIdx] = XMFLOAT3( 0.5f + 0.25f*sinf( 0.5f*P.x + 0.3f*P.z ), 0.5f + 0.25f*sinf( 0.5f*P.y + 0.7f*P.z ), 1.f );
+            bool bChecker = ( ( (int)floorf( 0.2f*P.x ) + (int)floorf( 0.2f*P.y ) + (int)floorf( 0.2f*P.z ) ) & 1 ) != 0;
+            pScene->DiffuseSamples[uPixelIdx] = bChecker ? XMFLOAT4( 0.8f, 0.7f, 0.5f, 1.f ) : XMFLOAT4( 0.4f, 0.5f, 0.6f, 0.25f );
+        }
+    }
+
+    BuildBenchmarkLights( uNumLights / 2, 1, pScene->PointLights );
+    BuildBenchmarkLights( uNumLights - uNumLights / 2, 2, pScene->SpotLights );
+    BuildBenchmarkSpotParams( pScene->SpotLights, 3, pScene->SpotLightSpotParams );
+    BuildBenchmarkLightColors( (unsigned)pScene->PointLights.size(), 4, pScene->PointLightColors );
+    BuildBenchmarkLightColors( (unsigned)pScene->SpotLights.size(), 5, pScene->SpotLightColors );
+}
+
+static void SetupBenchmarkShadingDesc( const BenchmarkShadingScene& Scene, unsigned uWidth, unsigned uHeight, const CpuLightCuller* pCuller, CpuShadingDesc* pDesc )
+{
+    memset( pDesc, 0, sizeof(CpuShadingDesc) );
+    pDesc->uWidth = uWidth;
+    pDesc->uHeight = uHeight;
+    pDesc->pDepth = &Scene.DepthBuffer[0];
+    pDesc->pPositionWS = &Scene.Positions[0];
+    pDesc->pNormalWS = &Scene.Normals[0];
+    pDesc->pTangentWS = &Scene.Tangents[0];
+    pDesc->pNormalMapSample = &Scene.NormalMapSamples[0];
+    pDesc->pDiffuseSample = &Scene.DiffuseSamples[0];
+    pDesc->vCameraPos = XMFLOAT3( 0.f, 0.f, 0.f );
+    pDesc->AmbientColorUp = BENCHMARK_AMBIENT_COLOR_UP;
+    pDesc->AmbientColorDown = BENCHMARK_AMBIENT_COLOR_DOWN;
+    pDesc->bAlphaTest = false;
+    pDesc->fAlphaTest = 0.5f;
+    pDesc->pPointLightCenterAndRadius = &Scene.PointLights[0];
+    pDesc->pPointLightColor = &Scene.PointLightColors[0];
+    pDesc->uNumPointLights = (unsigned)Scene.PointLights.size();
+    pDesc->pSpotLightCenterAndRadius = &Scene.SpotLights[0];
+    pDesc->pSpotLightColor = &Scene.SpotLightColors[0];
+    pDesc->pSpotLightSpotParams = &Scene.SpotLightSpotParams[0];
+    pDesc->uNumSpotLights = (unsigned)Scene.SpotLights.size();
+
+    if( pCuller != NULL )
+    {
+        pDesc->pLightIndexBuffer = pCuller->GetLightIndexBuffer();
+        pDesc->uTileRes = pCuller->GetTileRes();
+        pDesc->uMaxNumLightsPerTile = pCuller->GetMaxNumLightsPerList();
+    }
+}
+
+// the lists the sample would shade with: 16x16 tiles, depth bounds and spot cones,
+// and the light LOD if fMinLightContribution is above 0
+static void CullBenchmarkShadingScene( const BenchmarkShadingScene& Scene, unsigned uWidth, unsigned uHeight,
+                                       float fMinLightContribution, bool bMergeDroppedLights, CpuLightCuller* pCuller )
+{
+    XMFLOAT4X4 Projection, ProjectionInv;
+    BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+    CpuLightCullDesc Desc;
+    memset( &Desc, 0, sizeof(Desc) );
+    Desc.pPointLightCenterAndRadius = &Scene.PointLights[0];
+    Desc.uNumPointLights = (unsigned)Scene.PointLights.size();
+    Desc.pSpotLightCenterAndRadius = &Scene.SpotLights[0];
+    Desc.uNumSpotLights = (unsigned)Scene.SpotLights.size();
+    Desc.pSpotLightSpotParams = &Scene.SpotLightSpotParams[0];
+    SetIdentity( &Desc.mWorldView );
+    Desc.mProjectionInv = ProjectionInv;
+    Desc.uWindowWidth = uWidth;
+    Desc.uWindowHeight = uHeight;
+    Desc.uMaxNumLightsPerTile = MAX_NUM_LIGHTS_PER_TILE;
+    Desc.pDepthBuffer = &Scene.DepthBuffer[0];
+    Desc.pPointLightColor = &Scene.PointLightColors[0];
+    Desc.pSpotLightColor = &Scene.SpotLightColors[0];
+    Desc.fMinLightContribution = fMinLightContribution;
+    Desc.bMergeDroppedLights = bMergeDroppedLights;
+    pCuller->Cull( Desc );
+}
+
+static void CullBenchmarkShadingScene( const BenchmarkShadingScene& Scene, unsigned uWidth, unsigned uHeight, CpuLightCuller* pCuller )
+{
+    CullBenchmarkShadingScene( Scene, uWidth, uHeight, 0.f, false, pCuller );
+}
+
+//-----------------------------------------------------------------------------------------
+// CPU shading benchmark: the scalar, SSE2 and AVX2 versions of RenderScenePS, on one 
+// thread and on all of them, with the per-tile lists. The SSE2 frames have to match the 
+// scalar ones exactly, the AVX2 ones (which approximate) within a tolerance, and shading 
+// with the lists has to match looping over all the lights.
+//-----------------------------------------------------------------------------------------
+static void RunCpuShadingBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 1920;
+    const unsigned uHeight = 1080;
+    const unsigned uNumIterations = 3;
+    const unsigned NumLights[] = { 1024, 4096, 16384 };
+    const unsigned uCheckWidth = 640;
+    const unsigned uCheckHeight = 352;
+    const float fTolerance = 1e-4f;
+
+    // the kernels the CPU supports
+    CpuShadingKernel Kernels[] = { CPU_SHADING_KERNEL_SCALAR, CPU_SHADING_KERNEL_SSE2, CPU_SHADING_KERNEL_AVX2 };
+    unsigned uNumKernels = 0;
+    for( unsigned i = 0; i < sizeof(Kernels)/sizeof(Kernels[0]); i++ )
+    {
+        if( ResolveCpuShadingKernel( Kernels[i] ) == Kernels[i] )
+        {
+            Kernels[uNumKernels++] = Kernels[i];
+        }
+    }
+    unsigned ThreadCounts[] = { 1, GetDefaultNumThreads() };
+    unsigned uNumThreadCounts = ( ThreadCounts[1] > 1 ) ? 2 : 1;
+
+    fprintf( pFile, "CPU shading (%ux%u, colonnade scene, %ux%u tile lists, depth bounds, spot cones, best of %u, half point/half spot lights)\n",
+        uWidth, uHeight, DEFAULT_TILE_RES, DEFAULT_TILE_RES, uNumIterations );
+    fprintf( pFile, "  Pixel-lights: shaded pixels times the lights in their lists, Error: largest difference to the scalar frame\n" );
+    fprintf( pFile, "  %8s %8s %8s %10s %10s %14s %16s %12s\n", "Lights", "Kernel", "Threads", "Shade ms", "Mpixels/s", "Lights/pixel", "Mpixel-lights/s", "Error" );
+
+    bool bAllMatch = true;
+    float fMaxApproximateError = 0.f;
+    for( unsigned uLightCount = 0; uLightCount < sizeof(NumLights)/sizeof(NumLights[0]); uLightCount++ )
+    {
+        BenchmarkShadingScene Scene;
+        BuildBenchmarkShadingScene( uWidth, uHeight, NumLights[uLightCount], &Scene );
+
+        CpuLightCuller Culler;
+        CullBenchmarkShadingScene( Scene, uWidth, uHeight, &Culler );
+
+        CpuShadingDesc Desc;
+        SetupBenchmarkShadingDesc( Scene, uWidth, uHeight, &Culler, &Desc );
+
+        // how many lights each shaded pixel loops over
+        unsigned uNumTilesX = Culler.GetNumTilesX();
+        double fNumLightsPerPixel = 0.0;
+        unsigned uNumShadedPixels = 0;
+        for( unsigned uPixelIdx = 0; uPixelIdx < uWidth*uHeight; uPixelIdx++ )
+        {
+            if( Scene.DepthBuffer[uPixelIdx] != 0.f )
+            {
+                unsigned uTileIdx = ( uPixelIdx % uWidth ) / Culler.GetTileRes() + ( ( uPixelIdx / uWidth ) / Culler.GetTileRes() )*uNumTilesX;
+                fNumLightsPerPixel += Culler.GetNumPointLightsInTile( uTileIdx ) + Culler.GetNumSpotLightsInTile( uTileIdx );
+                uNumShadedPixels++;
+            }
+        }
+        fNumLightsPerPixel = ( uNumShadedPixels > 0 ) ? fNumLightsPerPixel / uNumShadedPixels : 0.0;
+
+        std::vector<XMFLOAT4> ScalarFrame( uWidth*uHeight ), Frame( uWidth*uHeight );
+        for( unsigned uKernel = 0; uKernel < uNumKernels; uKernel++ )
+        {
+            for( unsigned uThreadCount = 0; uThreadCount < uNumThreadCounts; uThreadCount++ )
+            {
+                XMFLOAT4* pFrame = ( uKernel == 0 && uThreadCount == 0 ) ? &ScalarFrame[0] : &Frame[0];
+                double fBestTime = 0.0;
+                for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+                {
+                    double fStartTime = GetTimeInMs();
+                    ShadeFrame( Desc, Kernels[uKernel], ThreadCounts[uThreadCount], pFrame );
+                    double fTime = GetTimeInMs() - fStartTime;
+                    fBestTime = ( uIteration == 0 || fTime < fBestTime ) ? fTime : fBestTime;
+                }
+
+                ImageDiff Diff;
+                CompareImages( pFrame, &ScalarFrame[0], uWidth*uHeight, fTolerance, &Diff );
+                if( Kernels[uKernel] == CPU_SHADING_KERNEL_AVX2 )
+                {
+                    bAllMatch = bAllMatch && ( Diff.uNumPixelsOverTolerance == 0 );
+                    fMaxApproximateError = ( Diff.fMaxError > fMaxApproximateError ) ? Diff.fMaxError : fMaxApproximateError;
+                }
+                else
+                {
+                    bAllMatch = bAllMatch && ( memcmp( pFrame, &ScalarFrame[0], uWidth*uHeight*sizeof(XMFLOAT4) ) == 0 );
+                }
+
+                fprintf( pFile, "  %8u %8s %8u %10.2f %10.1f %14.1f %16.1f %12g\n", NumLights[uLightCount], GetCpuShadingKernelName( Kernels[uKernel] ),
+                    ThreadCounts[uThreadCount], fBestTime, (double)uWidth*uHeight / ( 1000.0*fBestTime ), fNumLightsPerPixel,
+                    fNumLightsPerPixel*uNumShadedPixels / ( 1000.0*fBestTime ), Diff.fMaxError );
+            }
+        }
+    }
+    if( bAllMatch )
+    {
+        fprintf( pFile, "  The SSE2 frames match the scalar ones exactly, the AVX2 ones within %g (max error %g)\n", fTolerance, fMaxApproximateError );
+    }
+    else
+    {
+        fprintf( pFile, "  SOME KERNELS DO NOT MATCH THE SCALAR FRAMES\n" );
+    }
+
+    // the lists leave out lights that do not reach any pixel of the tile, which add 
+    // exactly 0, so the frame has to be the same as without culling (at a size that is 
+    // a multiple of the tile size, since the tile frustums stretch the window to whole 
+    // tiles, see CalculateTileFrustum, and so miss lights in the last row and column)
+    {
+        BenchmarkShadingScene Scene;
+        BuildBenchmarkShadingScene( uCheckWidth, uCheckHeight, NumLights[0], &Scene );
+
+        CpuLightCuller Culler;
+        CullBenchmarkShadingScene( Scene, uCheckWidth, uCheckHeight, &Culler );
+
+        std::vector<XMFLOAT4> CulledFrame( uCheckWidth*uCheckHeight ), AllLightsFrame( uCheckWidth*uCheckHeight );
+        CpuShadingDesc Desc;
+        SetupBenchmarkShadingDesc( Scene, uCheckWidth, uCheckHeight, &Culler, &Desc );
+        ShadeFrame( Desc, CPU_SHADING_KERNEL_AUTO, 0, &CulledFrame[0] );
+        SetupBenchmarkShadingDesc( Scene, uCheckWidth, uCheckHeight, NULL, &Desc );
+        ShadeFrame( Desc, CPU_SHADING_KERNEL_AUTO, 0, &AllLightsFrame[0] );
+
+        ImageDiff Diff;
+        CompareImages( &CulledFrame[0], &AllLightsFrame[0], uCheckWidth*uCheckHeight, fTolerance, &Diff );
+        fprintf( pFile, "  Tile lists vs. all lights (%ux%u, %u lights): %u of %u pixels over %g, max error %g, mean error %g\n",
+            uCheckWidth, uCheckHeight, NumLights[0], Diff.uNumPixelsOverTolerance, Diff.uNumPixels, fTolerance, Diff.fMaxError, Diff.fMeanError );
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// Packed light buffers (see ForwardPlusLightPacking.h): how fast the lights pack, how far 
+// off they come back compared to the error bounds, how many bytes the shading loop fetches 
+// per pixel, and how much the frame changes when it is shaded with the packed lights 
+// (with the lists culled from the full-precision ones, like the sample does).
+//-----------------------------------------------------------------------------------------
+static void RunLightPackingBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 1920;
+    const unsigned uHeight = 1080;
+    const unsigned uNumIterations = 5;
+    const unsigned uNumLights = 4096;
+    const unsigned uNumPackedLights = 256*1024;
+    const float fTolerance = 1.f/255.f;
+
+    BenchmarkShadingScene Scene;
+    BuildBenchmarkShadingScene( uWidth, uHeight, uNumLights, &Scene );
+
+    // the bounds of the lights stand in for the scene AABB
+    XMFLOAT3 vMin( FLT_MAX, FLT_MAX, FLT_MAX ), vMax( -FLT_MAX, -FLT_MAX, -FLT_MAX );
+    for( unsigned uType = 0; uType < 2; uType++ )
+    {
+        const std::vector<XMFLOAT4>& Lights = ( uType == 0 ) ? Scene.PointLights : Scene.SpotLights;
+        for( size_t i = 0; i < Lights.size(); i++ )
+        {
+            vMin = XMFLOAT3( std::min( vMin.x, Lights[i].x ), std::min( vMin.y, Lights[i].y ), std::min( vMin.z, Lights[i].z ) );
+            vMax = XMFLOAT3( std::max( vMax.x, Lights[i].x ), std::max( vMax.y, Lights[i].y ), std::max( vMax.z, Lights[i].z ) );
+        }
+    }
+    PackedLightBounds Bounds = GetPackedLightBounds( vMin, vMax );
+    XMFLOAT3 vPositionBound = GetPackedLightPositionErrorBound( Bounds );
+
+    fprintf( pFile, "Packed light buffers (%ux%u, colonnade scene, %u lights, bounds %.0fx%.0fx%.0f)\n",
+        uWidth, uHeight, uNumLights, vMax.x - vMin.x, vMax.y - vMin.y, vMax.z - vMin.z );
+
+    // packing speed
+    {
+        std::vector<XMFLOAT4> Lights;
+        std::vector<unsigned> Colors;
+        BuildBenchmarkLights( uNumPackedLights, 6, Lights );
+        BuildBenchmarkLightColors( uNumPackedLights, 7, Colors );
+        std::vector<PackedLight> PackedLights( uNumPackedLights );
+
+        double fBestTime = 0.0;
+        for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+        {
+            double fStartTime = GetTimeInMs();
+            PackLights( Bounds, &Lights[0], &Colors[0], NULL, uNumPackedLights, &PackedLights[0] );
+            double fTime = GetTimeInMs() - fStartTime;
+            fBestTime = ( uIteration == 0 || fTime < fBestTime ) ? fTime : fBestTime;
+        }
+        fprintf( pFile, "  PackLights: %u lights in %.2f ms (%.1f Mlights/s, best of %u)\n",
+            uNumPackedLights, fBestTime, uNumPackedLights / ( 1000.0*fBestTime ), uNumIterations );
+    }
+
+    // the errors, against the bounds
+    BenchmarkShadingScene PackedScene = Scene;
+    XMFLOAT3 vMaxPositionError( 0.f, 0.f, 0.f );
+    float fMaxRadiusError = 0.f;
+    float fMaxRadiusErrorRatio = 0.f;
+    unsigned uNumOutside = 0;
+    for( unsigned uType = 0; uType < 2; uType++ )
+    {
+        const std::vector<XMFLOAT4>& Lights = ( uType == 0 ) ? Scene.PointLights : Scene.SpotLights;
+        const std::vector<unsigned>& Colors = ( uType == 0 ) ? Scene.PointLightColors : Scene.SpotLightColors;
+        std::vector<XMFLOAT4>& PackedLightCenters = ( uType == 0 ) ? PackedScene.PointLights : PackedScene.SpotLights;
+        std::vector<PackedLight> PackedLights( Lights.size() );
+        PackLights( Bounds, &Lights[0], &Colors[0], NULL, (unsigned)Lights.size(), &PackedLights[0] );
+
+        for( size_t i = 0; i < Lights.size(); i++ )
+        {
+            XMFLOAT4 CenterAndRadius;
+            XMFLOAT3 Color;
+            UnpackLight( Bounds, PackedLights[i], &CenterAndRadius, &Color );
+            PackedLightCenters[i] = CenterAndRadius;
+
+            float fDeltaX = CenterAndRadius.x - Lights[i].x;
+            float fDeltaY = CenterAndRadius.y - Lights[i].y;
+            float fDeltaZ = CenterAndRadius.z - Lights[i].z;
+            vMaxPositionError.x = std::max( vMaxPositionError.x, fabsf( fDeltaX ) );
+            vMaxPositionError.y = std::max( vMaxPositionError.y, fabsf( fDeltaY ) );
+            vMaxPositionError.z = std::max( vMaxPositionError.z, fabsf( fDeltaZ ) );
+            float fRadiusError = Lights[i].w - CenterAndRadius.w;
+            fMaxRadiusError = std::max( fMaxRadiusError, fRadiusError );
+            fMaxRadiusErrorRatio = std::max( fMaxRadiusErrorRatio, fRadiusError / GetPackedLightRadiusErrorBound( Bounds, Lights[i].w ) );
+            if( sqrtf( fDeltaX*fDeltaX + fDeltaY*fDeltaY + fDeltaZ*fDeltaZ ) + CenterAndRadius.w > Lights[i].w )
+            {
+                uNumOutside++;
+            }
+        }
+    }
+    fprintf( pFile, "  Center error: %g %g %g (bound %g %g %g), radius error: %g (%.0f%% of its bound), packed spheres not inside the original: %u\n",
+        vMaxPositionError.x, vMaxPositionError.y, vMaxPositionError.z, vPositionBound.x, vPositionBound.y, vPositionBound.z,
+        fMaxRadiusError, 100.f*fMaxRadiusErrorRatio, uNumOutside );
+
+    // every channel value of an RGBA8 color, next to the largest and smallest others
+    {
+        unsigned uNumColorErrorsOverBound = 0;
+        unsigned uNumColorsNotExact = 0;
+        float fMaxColorError = 0.f;
+        for( unsigned uOther = 0; uOther < 256; uOther += 255 )
+        {
+            for( unsigned uValue = 0; uValue < 256; uValue++ )
+            {
+                for( unsigned uChannel = 0; uChannel < 3; uChannel++ )
+                {
+                    unsigned Channels[3] = { uOther, uOther, uOther };
+                    Channels[uChannel] = uValue;
+                    unsigned uColor = Channels[0] | ( Channels[1] << 8 ) | ( Channels[2] << 16 ) | 0xff000000;
+                    XMFLOAT3 Color = UnpackColorRGBA8( uColor );
+                    XMFLOAT3 Unpacked = UnpackColorRGB9E5( PackColorRGB9E5( Color ) );
+                    float fError = std::max( fabsf( Unpacked.x - Color.x ), std::max( fabsf( Unpacked.y - Color.y ), fabsf( Unpacked.z - Color.z ) ) );
+                    fMaxColorError = std::max( fMaxColorError, fError );
+                    uNumColorErrorsOverBound += ( fError > GetRGB9E5ErrorBound( std::max( Color.x, std::max( Color.y, Color.z ) ) ) ) ? 1 : 0;
+                    unsigned uRoundTrip = (unsigned)( Unpacked.x*255.f + 0.5f ) | ( (unsigned)( Unpacked.y*255.f + 0.5f ) << 8 ) | ( (unsigned)( Unpacked.z*255.f + 0.5f ) << 16 ) | 0xff000000;
+                    uNumColorsNotExact += ( uRoundTrip != uColor ) ? 1 : 0;
+                }
+            }
+        }
+        fprintf( pFile, "  Color error: %g (bound %g at 1), over the bound: %u, not the same RGBA8 color again: %u\n",
+            fMaxColorError, GetRGB9E5ErrorBound( 1.f ), uNumColorErrorsOverBound, uNumColorsNotExact );
+    }
+
+    // what the shading loop fetches: the packed colors come back as the same RGBA8 colors, 
+    // so only the centers and radii change in the frame
+    CpuLightCuller Culler;
+    CullBenchmarkShadingScene( Scene, uWidth, uHeight, &Culler );
+    double fNumPointLightsPerPixel = 0.0, fNumSpotLightsPerPixel = 0.0;
+    unsigned uNumShadedPixels = 0;
+    for( unsigned uPixelIdx = 0; uPixelIdx < uWidth*uHeight; uPixelIdx++ )
+    {
+        if( Scene.DepthBuffer[uPixelIdx] != 0.f )
+        {
+            unsigned uTileIdx = ( uPixelIdx % uWidth ) / Culler.GetTileRes() + ( ( uPixelIdx / uWidth ) / Culler.GetTileRes() )*Culler.GetNumTilesX();
+            fNumPointLightsPerPixel += Culler.GetNumPointLightsInTile( uTileIdx );
+            fNumSpotLightsPerPixel += Culler.GetNumSpotLightsInTile( uTileIdx );
+            uNumShadedPixels++;
+        }
+    }
+    fNumPointLightsPerPixel = ( uNumShadedPixels > 0 ) ? fNumPointLightsPerPixel / uNumShadedPixels : 0.0;
+    fNumSpotLightsPerPixel = ( uNumShadedPixels > 0 ) ? fNumSpotLightsPerPixel / uNumShadedPixels : 0.0;
+
+    const unsigned uPointBytes = sizeof(XMFLOAT4) + sizeof(unsigned);
+    const unsigned uSpotBytes = sizeof(XMFLOAT4) + sizeof(unsigned) + sizeof(SpotParams);
+    const unsigned uPackedPointBytes = sizeof(PackedLight);
+    const unsigned uPackedSpotBytes = sizeof(PackedLight) + sizeof(SpotParams);
+    double fBytesPerPixel = fNumPointLightsPerPixel*uPointBytes + fNumSpotLightsPerPixel*uSpotBytes;
+    double fPackedBytesPerPixel = fNumPointLightsPerPixel*uPackedPointBytes + fNumSpotLightsPerPixel*uPackedSpotBytes;
+    double fFetchesPerPixel = fNumPointLightsPerPixel*2 + fNumSpotLightsPerPixel*3;
+    double fPackedFetchesPerPixel = fNumPointLightsPerPixel*1 + fNumSpotLightsPerPixel*2;
+    fprintf( pFile, "  %12s %12s %12s %16s %16s\n", "Format", "Point B", "Spot B", "Bytes/pixel", "Fetches/pixel" );
+    fprintf( pFile, "  %12s %12u %12u %16.1f %16.1f\n", "Full", uPointBytes, uSpotBytes, fBytesPerPixel, fFetchesPerPixel );
+    fprintf( pFile, "  %12s %12u %12u %16.1f %16.1f\n", "Packed", uPackedPointBytes, uPackedSpotBytes, fPackedBytesPerPixel, fPackedFetchesPerPixel );
+    fprintf( pFile, "  Shading loop fetches %.0f%% fewer bytes in %.0f%% fewer fetches (%.1f point and %.1f spot lights per pixel)\n",
+        100.0*( 1.0 - fPackedBytesPerPixel / fBytesPerPixel ), 100.0*( 1.0 - fPackedFetchesPerPixel / fFetchesPerPixel ),
+        fNumPointLightsPerPixel, fNumSpotLightsPerPixel );
+
+    // and how much the frame changes
+    {
+        std::vector<XMFLOAT4> Frame( uWidth*uHeight ), PackedFrame( uWidth*uHeight );
+        CpuShadingDesc Desc;
+        SetupBenchmarkShadingDesc( Scene, uWidth, uHeight, &Culler, &Desc );
+        ShadeFrame( Desc, CPU_SHADING_KERNEL_SCALAR, 0, &Frame[0] );
+        SetupBenchmarkShadingDesc( PackedScene, uWidth, uHeight, &Culler, &Desc );
+        ShadeFrame( Desc, CPU_SHADING_KERNEL_SCALAR, 0, &PackedFrame[0] );
+
+        ImageDiff Diff;
+        CompareImages( &PackedFrame[0], &Frame[0], uWidth*uHeight, fTolerance, &Diff );
+        fprintf( pFile, "  Packed vs. full-precision frame: %u of %u pixels over %g, max error %g, mean error %g\n",
+            Diff.uNumPixelsOverTolerance, Diff.uNumPixels, fTolerance, Diff.fMaxError, Diff.fMeanError );
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+// The float that many steps away from fValue, away from zero for a positive nSteps 
+// (floats are sign and magnitude, so their bits count steps away from zero)
+static float OffsetFloatBits( float fValue, int nSteps )
+{
+    unsigned uBits;
+    memcpy( &uBits, &fValue, sizeof(uBits) );
+    uBits += (unsigned)nSteps;
+    memcpy( &fValue, &uBits, sizeof(fValue) );
+    return fValue;
+}
+
+//-----------------------------------------------------------------------------------------
+// Batched float/half conversion: every half, and the values halfway between neighboring 
+// halves, against the IEEE rules, for each kernel; then the throughput of each kernel
+//-----------------------------------------------------------------------------------------
+static void RunHalfConversionBenchmark( FILE* pFile )
+{
+    const unsigned uNumValues = 1024*1024;
+    const unsigned uNumIterations = 10;
+    const unsigned uNumLights = 64*1024;
+
+    fprintf( pFile, "Float/half conversion (all 65536 halves, plus the floats halfway between them and their neighbors)\n" );
+
+    // the halves, and three floats per pair of neighboring finite halves: halfway 
+    // between them, and the floats on either side of halfway (all with the sign of 
+    // the pair, so "below" means closer to zero)
+    std::vector<unsigned short> AllHalves( 65536 );
+    std::vector<float> Halfways;
+    std::vector<unsigned short> HalfwaysBelow;
+    for( unsigned i = 0; i < 65536; i++ )
+    {
+        AllHalves[i] = (unsigned short)i;
+        if( ( i & 0x7FFFu ) < 0x7C00u )
+        {
+            float fLow = ConvertF16ToF32( (unsigned short)i );
+            float fHigh = ConvertF16ToF32( (unsigned short)( i + 1 ) );     // 0x7BFF+1 is infinity
+            if( ( i & 0x7FFFu ) == 0x7BFFu )
+            {
+                fHigh = ( i & 0x8000u ) ? -65536.f : 65536.f;   // the next step, were there one
+            }
+            float fHalfway = 0.5f*fLow + 0.5f*fHigh;
+            Halfways.push_back( OffsetFloatBits( fHalfway, -1 ) );
+            Halfways.push_back( fHalfway );
+            Halfways.push_back( OffsetFloatBits( fHalfway, 1 ) );
+            HalfwaysBelow.push_back( (unsigned short)i );
+        }
+    }
+
+    std::vector<float> Floats( 65536 );
+    std::vector<unsigned short> Halves( 65536 );
+    std::vector<unsigned short> RoundedHalfways( Halfways.size() );
+    for( unsigned uKernel = HALF_CONVERSION_KERNEL_SCALAR; uKernel < HALF_CONVERSION_KERNEL_COUNT; uKernel++ )
+    {
+        HalfConversionKernel eKernel = (HalfConversionKernel)uKernel;
+        if( ResolveHalfConversionKernel( eKernel ) != eKernel )
+        {
+            fprintf( pFile, "  %-6s  not supported by this CPU\n", GetHalfConversionKernelName( eKernel ) );
+            continue;
+        }
+
+        // every half goes to a float and back unchanged (but for NaNs, which come back quiet), 
+        // and the float is the one the scalar conversion gives, to the bit
+        ConvertF16ToF32( &AllHalves[0], &Floats[0], 65536, eKernel );
+        unsigned uNumBadFloats = 0;
+        for( unsigned i = 0; i < 65536; i++ )
+        {
+            float fExpected = ConvertF16ToF32( AllHalves[i] );
+            uNumBadFloats += ( memcmp( &Floats[i], &fExpected, sizeof(float) ) != 0 ) ? 1 : 0;
+        }
+
+        unsigned uNumBadRoundTrips = 0;
+        for( unsigned uRounding = 0; uRounding < 2; uRounding++ )
+        {
+            ConvertF32ToF16( &Floats[0], &Halves[0], 65536, (HalfRounding)uRounding, eKernel );
+            for( unsigned i = 0; i < 65536; i++ )
+            {
+                bool bNaN = ( i & 0x7C00u ) == 0x7C00u && ( i & 0x3FFu ) != 0;
+                uNumBadRoundTrips += ( Halves[i] != ( bNaN ? ( i | 0x200u ) : i ) ) ? 1 : 0;
+            }
+        }
+
+        // just below halfway rounds down and just above rounds up, or to even on the dot 
+        // (up to infinity past 65504); rounding toward zero always keeps the smaller one
+        unsigned uNumBadNearestEven = 0;
+        unsigned uNumBadTowardZero = 0;
+        for( unsigned uRounding = 0; uRounding < 2; uRounding++ )
+        {
+            ConvertF32ToF16( &Halfways[0], &RoundedHalfways[0], (unsigned)Halfways.size(), (HalfRounding)uRounding, eKernel );
+            for( size_t i = 0; i < HalfwaysBelow.size(); i++ )
+            {
+                unsigned uBelow = HalfwaysBelow[i];
+                unsigned uEven = ( uBelow & 1 ) ? uBelow + 1 : uBelow;
+                unsigned uExpected[3] = { uBelow, uEven, uBelow + 1 };
+                for( unsigned j = 0; j < 3; j++ )
+                {
+                    unsigned uHalf = RoundedHalfways[3*i + j];
+                    if( uRounding == HALF_ROUND_NEAREST_EVEN )
+                    {
+                        uNumBadNearestEven += ( uHalf != uExpected[j] ) ? 1 : 0;
+                    }
+                    else
+                    {
+                        uNumBadTowardZero += ( uHalf != uBelow ) ? 1 : 0;
+                    }
+                }
+            }
+        }
+
+        fprintf( pFile, "  %-6s  wrong floats: %u, wrong round trips: %u, wrong nearest-even roundings: %u of %u, wrong toward-zero roundings: %u of %u\n",
+            GetHalfConversionKernelName( eKernel ), uNumBadFloats, uNumBadRoundTrips, 
+            uNumBadNearestEven, (unsigned)Halfways.size(), uNumBadTowardZero, (unsigned)Halfways.size() );
+    }
+
+    // throughput, on values spread over the whole half range
+    std::vector<float> Values( uNumValues );
+    std::vector<unsigned short> PackedValues( uNumValues );
+    std::vector<float> UnpackedValues( uNumValues );
+    BenchmarkRandom Random( 24 );
+    for( unsigned i = 0; i < uNumValues; i++ )
+    {
+        Values[i] = ldexpf( Random.Next( -1.f, 1.f ), (int)Random.Next( -20.f, 16.f ) );
+    }
+
+    fprintf( pFile, "  Throughput (%u values, best of %u):\n", uNumValues, uNumIterations );
+    double fScalarTime[2] = { 0.0, 0.0 };
+    for( unsigned uKernel = HALF_CONVERSION_KERNEL_SCALAR; uKernel < HALF_CONVERSION_KERNEL_COUNT; uKernel++ )
+    {
+        HalfConversionKernel eKernel = (HalfConversionKernel)uKernel;
+        if( ResolveHalfConversionKernel( eKernel ) != eKernel )
+        {
+            continue;
+        }
+
+        double fBestTime[2] = { 0.0, 0.0 };
+        for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+        {
+            double fStartTime = GetTimeInMs();
+            ConvertF32ToF16( &Values[0], &PackedValues[0], uNumValues, HALF_ROUND_NEAREST_EVEN, eKernel );
+            double fMidTime = GetTimeInMs();
+            ConvertF16ToF32( &PackedValues[0], &UnpackedValues[0], uNumValues, eKernel );
+            double fEndTime = GetTimeInMs();
+            fBestTime[0] = ( uIteration == 0 || fMidTime - fStartTime < fBestTime[0] ) ? fMidTime - fStartTime : fBestTime[0];
+            fBestTime[1] = ( uIteration == 0 || fEndTime - fMidTime < fBestTime[1] ) ? fEndTime - fMidTime : fBestTime[1];
+        }
+        if( eKernel == HALF_CONVERSION_KERNEL_SCALAR )
+        {
+            fScalarTime[0] = fBestTime[0];
+            fScalarTime[1] = fBestTime[1];
+        }
+
+        fprintf( pFile, "    %-6s  float->half %7.1f Mvalues/s (%4.1fx scalar), half->float %7.1f Mvalues/s (%4.1fx scalar)\n",
+            GetHalfConversionKernelName( eKernel ), uNumValues / ( 1000.0*fBestTime[0] ), fScalarTime[0] / fBestTime[0],
+            uNumValues / ( 1000.0*fBestTime[1] ), fScalarTime[1] / fBestTime[1] );
+    }
+
+    // PackLights converts its radii in batches, which has to match PackLight one at a time
+    std::vector<XMFLOAT4> Lights;
+    std::vector<unsigned> Colors;
+    BuildBenchmarkLights( uNumLights, 6, Lights );
+    BuildBenchmarkLightColors( uNumLights, 7, Colors );
+    XMFLOAT3 vMin( -1000.f, -1000.f, -10.f ), vMax( 1000.f, 1000.f, 410.f );
+    PackedLightBounds Bounds = GetPackedLightBounds( vMin, vMax );
+    std::vector<PackedLight> PackedLights( uNumLights );
+    PackLights( Bounds, &Lights[0], &Colors[0], NULL, uNumLights, &PackedLights[0] );
+    unsigned uNumMismatches = 0;
+    for( unsigned i = 0; i < uNumLights; i++ )
+    {
+        PackedLight Light = PackLight( Bounds, Lights[i], UnpackColorRGBA8( Colors[i] ) );
+        uNumMismatches += ( memcmp( &Light, &PackedLights[i], sizeof(Light) ) != 0 ) ? 1 : 0;
+    }
+    fprintf( pFile, "  PackLights vs PackLight: %u of %u lights differ\n", uNumMismatches, uNumLights );
+    fprintf( pFile, "\n" );
+}
+
+// the lights each shaded pixel loops over, added up over the frame
+static double CountBenchmarkLightEvaluations( const BenchmarkShadingScene& Scene, unsigned uWidth, unsigned uHeight, const CpuLightCuller& Culler )
+{
+    double fNumLightEvaluations = 0.0;
+    for( unsigned uPixelIdx = 0; uPixelIdx < uWidth*uHeight; uPixelIdx++ )
+    {
+        if( Scene.DepthBuffer[uPixelIdx] != 0.f )
+        {
+            unsigned uTileIdx = ( uPixelIdx % uWidth ) / Culler.GetTileRes() + ( ( uPixelIdx / uWidth ) / Culler.GetTileRes() )*Culler.GetNumTilesX();
+            fNumLightEvaluations += Culler.GetNumPointLightsInTile( uTileIdx ) + Culler.GetNumSpotLightsInTile( uTileIdx );
+        }
+    }
+    return fNumLightEvaluations;
+}
+
+// the error of a frame as it would be written to an 8-bit target: the PSNR (in dB) and the 
+// largest difference of the colors saturated to [0,1], and the channels that round differently
+static void CompareBenchmarkFrames8Bit( const XMFLOAT4* pFrame, const XMFLOAT4* pGolden, unsigned uNumPixels,
+                                        double* pPsnr, float* pMaxError, unsigned* pNumChangedChannels )
+{
+    double fSumSquaredError = 0.0;
+    *pMaxError = 0.f;
+    *pNumChangedChannels = 0;
+    for( unsigned i = 0; i < uNumPixels; i++ )
+    {
+        const float* pChannels = &pFrame[i].x;
+        const float* pGoldenChannels = &pGolden[i].x;
+        for( unsigned c = 0; c < 3; c++ )
+        {
+            float fValue = std::min( std::max( pChannels[c], 0.f ), 1.f );
+            float fGoldenValue = std::min( std::max( pGoldenChannels[c], 0.f ), 1.f );
+            float fError = fabsf( fValue - fGoldenValue );
+            fSumSquaredError += (double)fError*fError;
+            *pMaxError = std::max( *pMaxError, fError );
+            *pNumChangedChannels += ( (unsigned)( 255.f*fValue + 0.5f ) != (unsigned)( 255.f*fGoldenValue + 0.5f ) ) ? 1 : 0;
+        }
+    }
+    double fMeanSquaredError = fSumSquaredError / ( 3.0*uNumPixels );
+    *pPsnr = ( fMeanSquaredError > 0.0 ) ? 10.0*log10( 1.0 / fMeanSquaredError ) : DBL_MAX;
+}
+
+static const char* FormatBenchmarkPsnr( double fPsnr, char* pBuffer, size_t uBufferSize )
+{
+    if( fPsnr == DBL_MAX )
+    {
+        sprintf_s( pBuffer, uBufferSize, "exact" );
+    }
+    else
+    {
+        sprintf_s( pBuffer, uBufferSize, "%.2f", fPsnr );
+    }
+    return pBuffer;
+}
+
+//-----------------------------------------------------------------------------------------
+// Light LOD (see ForwardPlusLightLod.h): how many light evaluations the shading saves when 
+// the lists drop the lights that can not add more than a threshold to any pixel of their 
+// tile, and what that does to the frame, with the dropped lights left out and with them 
+// merged into an ambient term per tile, against the frame shaded with the full lists.
+//-----------------------------------------------------------------------------------------
+static void RunLightLodBenchmark( FILE* pFile )
+{
+    const unsigned uWidth = 1920;
+    const unsigned uHeight = 1080;
+    const unsigned uNumIterations = 3;
+    const unsigned NumLights[] = { 1024, 4096 };     // not so many that the lists overflow
+    const float Thresholds[] = { 0.5f, 1.f, 2.f, 4.f, 8.f };   // in steps of an 8-bit target
+
+    fprintf( pFile, "Light LOD (%ux%u, colonnade scene, %ux%u tile lists, depth bounds, spot cones, best of %u, %s shading kernel)\n",
+        uWidth, uHeight, DEFAULT_TILE_RES, DEFAULT_TILE_RES, uNumIterations, GetCpuShadingKernelName( ResolveCpuShadingKernel( CPU_SHADING_KERNEL_AUTO ) ) );
+    fprintf( pFile, "  Threshold: in 1/255, Evals: shaded pixels times the lights in their lists, PSNR and Error: of the saturated frame\n" );
+    fprintf( pFile, "  against the one with the full lists, Changed: 8-bit channels that round differently, with the lights dropped or merged\n" );
+    fprintf( pFile, "  %8s %9s %10s %12s %8s %10s %10s %10s %10s %10s %10s %10s\n", "Lights", "Threshold", "Dropped", "Evals (M)", "Saved",
+        "Shade ms", "PSNR drop", "Error", "Changed", "PSNR merge", "Error", "Changed" );
+
+    for( unsigned uLightCount = 0; uLightCount < sizeof(NumLights)/sizeof(NumLights[0]); uLightCount++ )
+    {
+        BenchmarkShadingScene Scene;
+        BuildBenchmarkShadingScene( uWidth, uHeight, NumLights[uLightCount], &Scene );
+
+        std::vector<XMFLOAT4> ReferenceFrame( uWidth*uHeight ), DropFrame( uWidth*uHeight ), MergeFrame( uWidth*uHeight );
+        double fReferenceEvaluations = 0.0;
+        for( unsigned uThreshold = 0; uThreshold <= sizeof(Thresholds)/sizeof(Thresholds[0]); uThreshold++ )
+        {
+            // the first row is the reference, without the light LOD
+            float fThreshold = ( uThreshold == 0 ) ? 0.f : Thresholds[uThreshold - 1];
+            CpuLightCuller Culler;
+            CullBenchmarkShadingScene( Scene, uWidth, uHeight, fThreshold / 255.f, false, &Culler );
+            double fNumEvaluations = CountBenchmarkLightEvaluations( Scene, uWidth, uHeight, Culler );
+            fReferenceEvaluations = ( uThreshold == 0 ) ? fNumEvaluations : fReferenceEvaluations;
+
+            CpuShadingDesc Desc;
+            SetupBenchmarkShadingDesc( Scene, uWidth, uHeight, &Culler, &Desc );
+            XMFLOAT4* pFrame = ( uThreshold == 0 ) ? &ReferenceFrame[0] : &DropFrame[0];
+            double fBestTime = 0.0;
+            for( unsigned uIteration = 0; uIteration < uNumIterations; uIteration++ )
+            {
+                double fStartTime = GetTimeInMs();
+                ShadeFrame( Desc, CPU_SHADING_KERNEL_AUTO, 0, pFrame );
+                double fTime = GetTimeInMs() - fStartTime;
+                fBestTime = ( uIteration == 0 || fTime < fBestTime ) ? fTime : fBestTime;
+            }
+
+            if( uThreshold == 0 )
+            {
+                fprintf( pFile, "  %8u %9s %10u %12.1f %7.1f%% %10.2f\n", NumLights[uLightCount], "off", 0u, fNumEvaluations / 1e6, 0.0, fBestTime );
+                continue;
+            }
+
+            // the same lists, with what the dropped lights would have added to each tile
+            CpuLightCuller MergeCuller;
+            CullBenchmarkShadingScene( Scene, uWidth, uHeight, fThreshold / 255.f, true, &MergeCuller );
+            SetupBenchmarkShadingDesc( Scene, uWidth, uHeight, &MergeCuller, &Desc );
+            Desc.pTileAmbient = MergeCuller.GetTileAmbient();
+            ShadeFrame( Desc, CPU_SHADING_KERNEL_AUTO, 0, &MergeFrame[0] );
+
+            double fDropPsnr, fMergePsnr;
+            float fDropError, fMergeError;
+            unsigned uNumDropChanged, uNumMergeChanged;
+            CompareBenchmarkFrames8Bit( &DropFrame[0], &ReferenceFrame[0], uWidth*uHeight, &fDropPsnr, &fDropError, &uNumDropChanged );
+            CompareBenchmarkFrames8Bit( &MergeFrame[0], &ReferenceFrame[0], uWidth*uHeight, &fMergePsnr, &fMergeError, &uNumMergeChanged );
+
+            char szDropPsnr[32], szMergePsnr[32];
+            fprintf( pFile, "  %8u %9.1f %10u %12.1f %7.1f%% %10.2f %10s %10.5f %10u %10s %10.5f %10u\n", NumLights[uLightCount], fThreshold,
+                Culler.GetNumLightLodRejections(), fNumEvaluations / 1e6, 100.0*( 1.0 - fNumEvaluations / fReferenceEvaluations ), fBestTime,
+                FormatBenchmarkPsnr( fDropPsnr, szDropPsnr, sizeof(szDropPsnr) ), fDropError, uNumDropChanged,
+                FormatBenchmarkPsnr( fMergePsnr, szMergePsnr, sizeof(szMergePsnr) ), fMergeError, uNumMergeChanged );
+        }
+    }
+
+    fprintf( pFile, "\n" );
+}
+
+//-----------------------------------------------------------------------------------------
+// The culling variants RunCullingQualityAnalysis scores
+//-----------------------------------------------------------------------------------------
+struct CullingQualityVariant
+{
+    const char* pName;
+    unsigned    uTileRes;
+    bool        bDepthBounds;
+    bool        bDepthMask;
+    bool        bSpotCones;
+    bool        bCoarseTiles;
+    bool        bClustered;
+};
+
+static const CullingQualityVariant CULLING_QUALITY_VARIANTS[] =
+{
+    // name                         tile  bounds mask   cones  coarse clustered
+    { "Sphere",                     16,   false, false, false, false, false },
+    { "SphereDepthBounds",          16,   true,  false, false, false, false },
+    { "SphereDepthMask",            16,   true,  true,  false, false, false },
+    { "Cone",                       16,   false, false, true,  false, false },
+    { "ConeDepthBounds",            16,   true,  false, true,  false, false },
+    { "ConeDepthMask",              16,   true,  true,  true,  false, false },
+    { "ConeDepthBoundsCoarse",      16,   true,  false, true,  true,  false },
+    { "ConeDepthBounds8x8",         8,    true,  false, true,  false, false },
+    { "ConeDepthBounds32x32",       32,   true,  false, true,  false, false },
+    { "Clustered",                  16,   true,  false, false, false, true  },
+};
+
+// the heat maps of all the variants share this scale, so that they can be compared
+static const unsigned CULLING_QUALITY_HEAT_MAP_MAX = 64;
+
+namespace ForwardPlus11
+{
+    //--------------------------------------------------------------------------------------
+    // Runs all the CPU benchmarks
+    //--------------------------------------------------------------------------------------
+    void RunCpuBenchmarks( FILE* pFile )
+    {
+        RunCullKernelBenchmark( pFile );
+        RunClusteredCullingBenchmark( pFile );
+        RunDepthMaskBenchmark( pFile );
+        RunCompactLightListBenchmark( pFile );
+        RunSharedLightListBenchmark( pFile );
+        RunLightCountBenchmark( pFile );
+        RunLightBvhBenchmark( pFile );
+        RunLightSortBenchmark( pFile );
+        RunLightAnimationBenchmark( pFile );
+        RunTileSizeBenchmark( pFile );
+        RunLightCullStatsBenchmark( pFile );
+        RunLightListSizingBenchmark( pFile );
+        RunDepthPyramidBenchmark( pFile );
+        RunCoarseTileBenchmark( pFile );
+        RunSpotConeBenchmark( pFile );
+        RunTemporalReuseBenchmark( pFile );
+        RunFrustumPreCullBenchmark( pFile );
+        RunTileClassBenchmark( pFile );
+        RunCpuShadingBenchmark( pFile );
+        RunLightPackingBenchmark( pFile );
+        RunHalfConversionBenchmark( pFile );
+        RunLightLodBenchmark( pFile );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Scores the culling variants against the lights that affect each pixel
+    //--------------------------------------------------------------------------------------
+    void RunCullingQualityAnalysis( FILE* pFile, bool bWriteHeatMaps )
+    {
+        const unsigned uWidth = 1920;
+        const unsigned uHeight = 1080;
+        const unsigned uNumLights = 4096;
+
+        XMFLOAT4X4 Projection, ProjectionInv;
+        BuildBenchmarkProjection( uWidth, uHeight, &Projection, &ProjectionInv );
+
+        // the pillars in front of the wall give the depth bounds and the depth mask some work
+        std::vector<float> DepthBuffer;
+        BuildBenchmarkColonnadeDepthBuffer( uWidth, uHeight, Projection, DepthBuffer );
+
+        std::vector<XMFLOAT4> PointLights, SpotLights;
+        BuildBenchmarkLights( uNumLights / 2, 1, PointLights );
+        BuildBenchmarkLights( uNumLights - uNumLights / 2, 2, SpotLights );
+
+        std::vector<SpotParams> SpotLightSpotParams;
+        BuildBenchmarkSpotParams( SpotLights, 3, SpotLightSpotParams );
+
+        ClusterConfig Clusters = GetDefaultClusterConfig( BENCHMARK_FAR );
+
+        fprintf( pFile, "Culling quality (%ux%u, colonnade scene, %u lights, half point/half spot lights)\n", uWidth, uHeight, uNumLights );
+        fprintf( pFile, "  Exact: lights per pixel that affect it, Listed: lights per pixel in its list, Wasted: listed lights per pixel that do not affect it\n" );
+        fprintf( pFile, "  %-24s %10s %10s %10s %10s %12s %8s\n", "Variant", "Exact", "Listed", "Wasted", "Max wasted", "False pos.%", "Missed" );
+
+        bool bNoneMissed = true;
+        for( unsigned uVariant = 0; uVariant < sizeof(CULLING_QUALITY_VARIANTS)/sizeof(CULLING_QUALITY_VARIANTS[0]); uVariant++ )
+        {
+            const CullingQualityVariant& Variant = CULLING_QUALITY_VARIANTS[uVariant];
+
+            CpuLightCullDesc Desc;
+            memset( &Desc, 0, sizeof(Desc) );
+            Desc.pPointLightCenterAndRadius = &PointLights[0];
+            Desc.uNumPointLights = (unsigned)PointLights.size();
+            Desc.pSpotLightCenterAndRadius = &SpotLights[0];
+            Desc.uNumSpotLights = (unsigned)SpotLights.size();
+            Desc.pSpotLightSpotParams = Variant.bSpotCones ? &SpotLightSpotParams[0] : NULL;
+            SetIdentity( &Desc.mWorldView );
+            Desc.mProjectionInv = ProjectionInv;
+            Desc.uWindowWidth = uWidth;
+            Desc.uWindowHeight = uHeight;
+            Desc.uTileRes = Variant.uTileRes;
+            Desc.uMaxNumLightsPerTile = GetMaxNumLightsPerTileForTileRes( Variant.uTileRes );
+            Desc.pDepthBuffer = Variant.bDepthBounds ? &DepthBuffer[0] : NULL;
+            Desc.bUseDepthMask = Variant.bDepthMask;
+            Desc.pClusterConfig = Variant.bClustered ? &Clusters : NULL;
+
+            CpuLightCuller Culler;
+            Culler.SetUseCoarseTiles( Variant.bCoarseTiles );
+            Culler.Cull( Desc );
+
+            // the pixels are the same with and without depth bounds
+            CpuLightCullDesc PixelDesc = Desc;
+            PixelDesc.pDepthBuffer = &DepthBuffer[0];
+
+            CullingQualityReport Report;
+            AnalyzeCullingQuality( PixelDesc, &SpotLightSpotParams[0], Culler, &Report );
+            bNoneMissed = bNoneMissed && ( Report.uNumMissedLights == 0 );
+
+            fprintf( pFile, "  %-24s %10.2f %10.2f %10.2f %10u %11.1f%% %8u\n", Variant.pName, Report.fExactLightsPerPixel, Report.fListedLightsPerPixel,
+                Report.fWastedEvaluationsPerPixel, Report.uMaxWastedEvaluations, 100.0*Report.fFalsePositiveRate, Report.uNumMissedLights );
+
+            if( bWriteHeatMaps )
+            {
+                char szFileName[256];
+                sprintf_s( szFileName, sizeof(szFileName), "CullingQuality%s.bmp", Variant.pName );
+
+                FILE* pImageFile = NULL;
+                bool bWritten = ( fopen_s( &pImageFile, szFileName, "wb" ) == 0 ) && ( pImageFile != NULL ) &&
+                    WriteHeatMapBmp( pImageFile, uWidth, uHeight, &Report.NumWastedEvaluations[0], CULLING_QUALITY_HEAT_MAP_MAX );
+                if( pImageFile != NULL )
+                {
+                    fclose( pImageFile );
+                }
+                if( !bWritten )
+                {
+                    fprintf( pFile, "  Could not write %s\n", szFileName );
+                }
+            }
+        }
+
+        if( bWriteHeatMaps )
+        {
+            fprintf( pFile, "  Heat maps of the wasted evaluations per pixel in CullingQuality<Variant>.bmp (radar colors, white for %u or more)\n", CULLING_QUALITY_HEAT_MAP_MAX );
+        }
+        fprintf( pFile, "  %s\n", bNoneMissed ? "No variant missed a light" : "SOME VARIANTS MISSED LIGHTS" );
+
+        fprintf( pFile, "\n" );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Shades the benchmark scene on the CPU and checks it against a golden frame
+    //--------------------------------------------------------------------------------------
+    bool RunCpuShadingRegression( FILE* pFile )
+    {
+        const unsigned uWidth = 1920;
+        const unsigned uHeight = 1080;
+        const unsigned uNumLights = 4096;
+        const float fTolerance = 1e-3f;
+
+        BenchmarkShadingScene Scene;
+        BuildBenchmarkShadingScene( uWidth, uHeight, uNumLights, &Scene );
+
+        CpuLightCuller Culler;
+        CullBenchmarkShadingScene( Scene, uWidth, uHeight, &Culler );
+
+        CpuShadingDesc Desc;
+        SetupBenchmarkShadingDesc( Scene, uWidth, uHeight, &Culler, &Desc );
+
+        std::vector<XMFLOAT4> Frame( uWidth*uHeight );
+        double fStartTime = GetTimeInMs();
+        ShadeFrame( Desc, CPU_SHADING_KERNEL_AUTO, 0, &Frame[0] );
+        double fTime = GetTimeInMs() - fStartTime;
+
+        fprintf( pFile, "CPU shading (%ux%u, colonnade scene, %u lights, %s kernel, %u threads): %.2f ms\n", uWidth, uHeight, uNumLights,
+            GetCpuShadingKernelName( ResolveCpuShadingKernel( CPU_SHADING_KERNEL_AUTO ) ), GetDefaultNumThreads(), fTime );
+
+        const char* ImageNames[] = { "CpuShading.pfm", "CpuShading.bmp" };
+        for( unsigned i = 0; i < 2; i++ )
+        {
+            FILE* pImageFile = NULL;
+            bool bWritten = ( fopen_s( &pImageFile, ImageNames[i], "wb" ) == 0 ) && ( pImageFile != NULL ) &&
+                ( ( i == 0 ) ? WriteImagePfm( pImageFile, uWidth, uHeight, &Frame[0] ) : WriteImageBmp( pImageFile, uWidth, uHeight, &Frame[0] ) );
+            if( pImageFile != NULL )
+            {
+                fclose( pImageFile );
+            }
+            fprintf( pFile, "  %s %s\n", bWritten ? "Wrote" : "Could not write", ImageNames[i] );
+        }
+
+        // the golden frame is a CpuShading.pfm from a run that was known to be good
+        FILE* pGoldenFile = NULL;
+        if( fopen_s( &pGoldenFile, "CpuShadingGolden.pfm", "rb" ) != 0 || pGoldenFile == NULL )
+        {
+            fprintf( pFile, "  No CpuShadingGolden.pfm to compare against\n\n" );
+            return true;
+        }
+
+        unsigned uGoldenWidth = 0, uGoldenHeight = 0;
+        std::vector<XMFLOAT4> Golden;
+        bool bRead = ReadImagePfm( pGoldenFile, &uGoldenWidth, &uGoldenHeight, Golden );
+        fclose( pGoldenFile );
+        if( !bRead || uGoldenWidth != uWidth || uGoldenHeight != uHeight )
+        {
+            fprintf( pFile, "  CpuShadingGolden.pfm is not a %ux%u PFM\n\n", uWidth, uHeight );
+            return false;
+        }
+
+        // the PFM has no alpha, and reads back as 1, which is only right for the shaded pixels
+        for( unsigned i = 0; i < uWidth*uHeight; i++ )
+        {
+            Golden[i].w = Frame[i].w;
+        }
+
+        ImageDiff Diff;
+        CompareImages( &Frame[0], &Golden[0], uWidth*uHeight, fTolerance, &Diff );
+        fprintf( pFile, "  Against CpuShadingGolden.pfm: %u of %u pixels over %g, max error %g, mean error %g\n", Diff.uNumPixelsOverTolerance,
+            Diff.uNumPixels, fTolerance, Diff.fMaxError, Diff.fMeanError );
+        fprintf( pFile, "  %s\n\n", ( Diff.uNumPixelsOverTolerance == 0 ) ? "Passed" : "FAILED" );
+        return Diff.uNumPixelsOverTolerance == 0;
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
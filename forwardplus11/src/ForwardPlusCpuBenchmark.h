@@ -0,0 +1,62 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusCpuBenchmark.h
+//
+// Headless benchmarks for the CPU side of the ForwardPlus11 sample.
+// Run them with "ForwardPlus11.exe -cpubenchmark", which writes the results
+// to CpuBenchmark.txt and exits without creating a window or a D3D device.
+//
+// "ForwardPlus11.exe -cullingquality" scores how tight the light lists of each culling
+// variant are instead (see ForwardPlusCullingQuality.h), writing the results to
+// CullingQuality.txt and heat maps of the wasted light evaluations to .bmp files.
+//
+// "ForwardPlus11.exe -cpushading" shades a frame of the benchmark scene with the CPU
+// version of RenderScenePS (see ForwardPlusCpuShading.h), writes it to CpuShading.pfm 
+// and CpuShading.bmp, and compares it against CpuShadingGolden.pfm if there is one, 
+// writing the results to CpuShading.txt. The exit code is 1 if the comparison failed.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <stdio.h>
+
+namespace ForwardPlus11
+{
+    // Runs all the CPU benchmarks and writes a human-readable report to pFile
+    void RunCpuBenchmarks( FILE* pFile );
+
+    // Scores the light lists of each culling variant against the lights that affect 
+    // each pixel, writing a report to pFile, and optionally heat maps to .bmp files
+    void RunCullingQualityAnalysis( FILE* pFile, bool bWriteHeatMaps );
+
+    // Shades the benchmark scene on the CPU, writing the frame to CpuShading.pfm and 
+    // CpuShading.bmp and a report to pFile. Returns false if it does not match 
+    // CpuShadingGolden.pfm (when there is one) within the tolerance.
+    bool RunCpuShadingRegression( FILE* pFile );
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
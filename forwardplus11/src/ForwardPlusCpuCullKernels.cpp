@@ -0,0 +1,394 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusCpuCullKernels.cpp
+//
+// Batched sphere vs. tile frustum kernels for the CPU light culler.
+//--------------------------------------------------------------------------------------
+
+#include "ForwardPlusCpuCullKernels.h"
+
+#include <assert.h>
+#include <float.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CPU_CULL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define CPU_CULL_X86 0
+#endif
+
+// MSVC lets any function use any intrinsic, GCC and clang
+// need to be told which functions may use AVX2
+#if CPU_CULL_X86 && defined(__GNUC__)
+#define CPU_CULL_TARGET_SSE2 __attribute__((target("sse2")))
+#define CPU_CULL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CPU_CULL_TARGET_SSE2
+#define CPU_CULL_TARGET_AVX2
+#endif
+
+namespace ForwardPlus11
+{
+    //--------------------------------------------------------------------------------------
+    // Pad the arrays with spheres of radius -FLT_MAX at the origin. Every test
+    // is of the form "something < r", so they fail all of them.
+    //--------------------------------------------------------------------------------------
+    void CpuCullLightsSoA::Resize( unsigned uNewNumLights )
+    {
+        uNumLights = uNewNumLights;
+        uNumLightsPadded = ( uNewNumLights + CPU_CULL_BATCH_SIZE - 1 ) & ~( CPU_CULL_BATCH_SIZE - 1 );
+
+        // always have at least one element, so that &X[0] is valid
+        size_t uSize = ( uNumLightsPadded == 0 ) ? 1 : uNumLightsPadded;
+        X.resize( uSize );
+        Y.resize( uSize );
+        Z.resize( uSize );
+        R.resize( uSize );
+
+        for( unsigned i = uNumLights; i < uSize; i++ )
+        {
+            Set( i, 0.f, 0.f, 0.f, -FLT_MAX );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Scalar kernel. Same expressions as TestFrustumSides in ForwardPlus11Tiling.hlsl,
+    // with the depth test first since it is the cheapest and rejects the most lights.
+    //--------------------------------------------------------------------------------------
+    static unsigned CullRangeKernelScalar( const CpuCullTileFrustum& Tile, const CpuCullLightsSoA& Lights, unsigned uBegin, unsigned uEnd, unsigned* pOut )
+    {
+        const float* pX = &Lights.X[0];
+        const float* pY = &Lights.Y[0];
+        const float* pZ = &Lights.Z[0];
+        const float* pR = &Lights.R[0];
+
+        unsigned uNumOut = 0;
+        uEnd = ( uEnd < Lights.uNumLights ) ? uEnd : Lights.uNumLights;
+        for( unsigned i = uBegin; i < uEnd; i++ )
+        {
+            float x = pX[i], y = pY[i], z = pZ[i], r = pR[i];
+
+            if( Tile.fMinZ - z < r && z - Tile.fMaxZ < r &&
+                Tile.fPlaneX[0]*x + Tile.fPlaneY[0]*y + Tile.fPlaneZ[0]*z < r &&
+                Tile.fPlaneX[1]*x + Tile.fPlaneY[1]*y + Tile.fPlaneZ[1]*z < r &&
+                Tile.fPlaneX[2]*x + Tile.fPlaneY[2]*y + Tile.fPlaneZ[2]*z < r &&
+                Tile.fPlaneX[3]*x + Tile.fPlaneY[3]*y + Tile.fPlaneZ[3]*z < r )
+            {
+                pOut[uNumOut++] = i;
+            }
+        }
+
+        return uNumOut;
+    }
+
+#if CPU_CULL_X86
+
+    //--------------------------------------------------------------------------------------
+    // Left-packing tables. For each bit mask of passing lanes, the lane indices of the
+    // set bits in ascending order, and how many there are. Since the light index of a
+    // lane is just the batch start plus the lane, packing the survivors of a batch is a
+    // table lookup and an add (no permute needed), followed by an unaligned store of the
+    // whole batch, of which only the first count entries are kept.
+    //--------------------------------------------------------------------------------------
+    static int          g_LeftPackLanes4[16][4];
+    static int          g_LeftPackLanes8[256][8];
+    static unsigned     g_LeftPackCount[256];
+
+    struct LeftPackTableInitializer
+    {
+        LeftPackTableInitializer()
+        {
+            for( unsigned uMask = 0; uMask < 256; uMask++ )
+            {
+                unsigned uCount = 0;
+                for( int nLane = 0; nLane < 8; nLane++ )
+                {
+                    if( uMask & ( 1u << nLane ) )
+                    {
+                        g_LeftPackLanes8[uMask][uCount++] = nLane;
+                    }
+                }
+                for( unsigned i = uCount; i < 8; i++ )
+                {
+                    g_LeftPackLanes8[uMask][i] = 0;
+                }
+                g_LeftPackCount[uMask] = uCount;
+
+                if( uMask < 16 )
+                {
+                    for( int nLane = 0; nLane < 4; nLane++ )
+                    {
+                        g_LeftPackLanes4[uMask][nLane] = g_LeftPackLanes8[uMask][nLane];
+                    }
+                }
+            }
+        }
+    };
+
+    // built before main, so there are no thread-safety concerns with the tables
+    static LeftPackTableInitializer g_LeftPackTableInitializer;
+
+    //--------------------------------------------------------------------------------------
+    // SSE2 kernel, 4 lights at a time
+    //--------------------------------------------------------------------------------------
+    CPU_CULL_TARGET_SSE2
+    static unsigned CullRangeKernelSSE2( const CpuCullTileFrustum& Tile, const CpuCullLightsSoA& Lights, unsigned uBegin, unsigned uEnd, unsigned* pOut )
+    {
+        const float* pX = &Lights.X[0];
+        const float* pY = &Lights.Y[0];
+        const float* pZ = &Lights.Z[0];
+        const float* pR = &Lights.R[0];
+
+        const __m128 vMinZ = _mm_set1_ps( Tile.fMinZ );
+        const __m128 vMaxZ = _mm_set1_ps( Tile.fMaxZ );
+        __m128 vPlaneX[4], vPlaneY[4], vPlaneZ[4];
+        for( int p = 0; p < 4; p++ )
+        {
+            vPlaneX[p] = _mm_set1_ps( Tile.fPlaneX[p] );
+            vPlaneY[p] = _mm_set1_ps( Tile.fPlaneY[p] );
+            vPlaneZ[p] = _mm_set1_ps( Tile.fPlaneZ[p] );
+        }
+
+        unsigned uNumOut = 0;
+        assert( uBegin % CPU_CULL_BATCH_SIZE == 0 && uEnd % CPU_CULL_BATCH_SIZE == 0 && uEnd <= Lights.uNumLightsPadded );
+        for( unsigned i = uBegin; i < uEnd; i += 4 )
+        {
+            __m128 z = _mm_loadu_ps( pZ + i );
+            __m128 r = _mm_loadu_ps( pR + i );
+
+            __m128 vPass = _mm_and_ps( _mm_cmplt_ps( _mm_sub_ps( vMinZ, z ), r ),
+                                       _mm_cmplt_ps( _mm_sub_ps( z, vMaxZ ), r ) );
+            if( _mm_movemask_ps( vPass ) == 0 )
+            {
+                continue;
+            }
+
+            __m128 x = _mm_loadu_ps( pX + i );
+            __m128 y = _mm_loadu_ps( pY + i );
+            for( int p = 0; p < 4; p++ )
+            {
+                __m128 d = _mm_add_ps( _mm_add_ps( _mm_mul_ps( vPlaneX[p], x ), _mm_mul_ps( vPlaneY[p], y ) ), _mm_mul_ps( vPlaneZ[p], z ) );
+                vPass = _mm_and_ps( vPass, _mm_cmplt_ps( d, r ) );
+            }
+
+            int nMask = _mm_movemask_ps( vPass );
+            if( nMask != 0 )
+            {
+                __m128i vLanes = _mm_loadu_si128( (const __m128i*)g_LeftPackLanes4[nMask] );
+                _mm_storeu_si128( (__m128i*)( pOut + uNumOut ), _mm_add_epi32( _mm_set1_epi32( (int)i ), vLanes ) );
+                uNumOut += g_LeftPackCount[nMask];
+            }
+        }
+
+        return uNumOut;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // AVX2 kernel, 8 lights at a time
+    //--------------------------------------------------------------------------------------
+    CPU_CULL_TARGET_AVX2
+    static unsigned CullRangeKernelAVX2( const CpuCullTileFrustum& Tile, const CpuCullLightsSoA& Lights, unsigned uBegin, unsigned uEnd, unsigned* pOut )
+    {
+        const float* pX = &Lights.X[0];
+        const float* pY = &Lights.Y[0];
+        const float* pZ = &Lights.Z[0];
+        const float* pR = &Lights.R[0];
+
+        const __m256 vMinZ = _mm256_set1_ps( Tile.fMinZ );
+        const __m256 vMaxZ = _mm256_set1_ps( Tile.fMaxZ );
+        __m256 vPlaneX[4], vPlaneY[4], vPlaneZ[4];
+        for( int p = 0; p < 4; p++ )
+        {
+            vPlaneX[p] = _mm256_set1_ps( Tile.fPlaneX[p] );
+            vPlaneY[p] = _mm256_set1_ps( Tile.fPlaneY[p] );
+            vPlaneZ[p] = _mm256_set1_ps( Tile.fPlaneZ[p] );
+        }
+
+        unsigned uNumOut = 0;
+        assert( uBegin % CPU_CULL_BATCH_SIZE == 0 && uEnd % CPU_CULL_BATCH_SIZE == 0 && uEnd <= Lights.uNumLightsPadded );
+        for( unsigned i = uBegin; i < uEnd; i += 8 )
+        {
+            __m256 z = _mm256_loadu_ps( pZ + i );
+            __m256 r = _mm256_loadu_ps( pR + i );
+
+            __m256 vPass = _mm256_and_ps( _mm256_cmp_ps( _mm256_sub_ps( vMinZ, z ), r, _CMP_LT_OQ ),
+                                          _mm256_cmp_ps( _mm256_sub_ps( z, vMaxZ ), r, _CMP_LT_OQ ) );
+            if( _mm256_movemask_ps( vPass ) == 0 )
+            {
+                continue;
+            }
+
+            // mul and add rather than FMA, so that the results
+            // are bit-identical to the scalar and SSE2 kernels
+            __m256 x = _mm256_loadu_ps( pX + i );
+            __m256 y = _mm256_loadu_ps( pY + i );
+            for( int p = 0; p < 4; p++ )
+            {
+                __m256 d = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( vPlaneX[p], x ), _mm256_mul_ps( vPlaneY[p], y ) ), _mm256_mul_ps( vPlaneZ[p], z ) );
+                vPass = _mm256_and_ps( vPass, _mm256_cmp_ps( d, r, _CMP_LT_OQ ) );
+            }
+
+            int nMask = _mm256_movemask_ps( vPass );
+            if( nMask != 0 )
+            {
+                __m256i vLanes = _mm256_loadu_si256( (const __m256i*)g_LeftPackLanes8[nMask] );
+                _mm256_storeu_si256( (__m256i*)( pOut + uNumOut ), _mm256_add_epi32( _mm256_set1_epi32( (int)i ), vLanes ) );
+                uNumOut += g_LeftPackCount[nMask];
+            }
+        }
+
+        return uNumOut;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // CPU feature detection
+    //--------------------------------------------------------------------------------------
+    static bool CpuSupportsSSE2()
+    {
+#if defined(_M_X64) || defined(__x86_64__)
+        return true;
+#elif defined(_MSC_VER)
+        int Info[4];
+        __cpuid( Info, 1 );
+        return ( Info[3] & ( 1 << 26 ) ) != 0;
+#else
+        return __builtin_cpu_supports( "sse2" ) != 0;
+#endif
+    }
+
+    static bool CpuSupportsAVX2()
+    {
+#if defined(_MSC_VER)
+        int Info[4];
+        __cpuid( Info, 0 );
+        if( Info[0] < 7 )
+        {
+            return false;
+        }
+
+        // the OS must save the YMM registers on context switches
+        __cpuid( Info, 1 );
+        bool bOSXSAVE = ( Info[2] & ( 1 << 27 ) ) != 0;
+        bool bAVX = ( Info[2] & ( 1 << 28 ) ) != 0;
+        if( !bOSXSAVE || !bAVX || ( _xgetbv( 0 ) & 6 ) != 6 )
+        {
+            return false;
+        }
+
+        __cpuidex( Info, 7, 0 );
+        return ( Info[1] & ( 1 << 5 ) ) != 0;
+#else
+        return __builtin_cpu_supports( "avx2" ) != 0;
+#endif
+    }
+
+    static const bool g_bCpuSupportsSSE2 = CpuSupportsSSE2();
+    static const bool g_bCpuSupportsAVX2 = CpuSupportsAVX2();
+
+#endif // CPU_CULL_X86
+
+    //--------------------------------------------------------------------------------------
+    // Whole-array versions of the kernels
+    //--------------------------------------------------------------------------------------
+    static unsigned CullKernelScalar( const CpuCullTileFrustum& Tile, const CpuCullLightsSoA& Lights, unsigned* pOut )
+    {
+        return CullRangeKernelScalar( Tile, Lights, 0, Lights.uNumLightsPadded, pOut );
+    }
+
+#if CPU_CULL_X86
+    static unsigned CullKernelSSE2( const CpuCullTileFrustum& Tile, const CpuCullLightsSoA& Lights, unsigned* pOut )
+    {
+        return CullRangeKernelSSE2( Tile, Lights, 0, Lights.uNumLightsPadded, pOut );
+    }
+
+    static unsigned CullKernelAVX2( const CpuCullTileFrustum& Tile, const CpuCullLightsSoA& Lights, unsigned* pOut )
+    {
+        return CullRangeKernelAVX2( Tile, Lights, 0, Lights.uNumLightsPadded, pOut );
+    }
+#endif // CPU_CULL_X86
+
+    //--------------------------------------------------------------------------------------
+    // Runtime ISA dispatch
+    //--------------------------------------------------------------------------------------
+    CpuCullKernel ResolveCpuCullKernel( CpuCullKernel eKernel )
+    {
+#if CPU_CULL_X86
+        if( ( eKernel == CPU_CULL_KERNEL_AUTO || eKernel == CPU_CULL_KERNEL_AVX2 ) && g_bCpuSupportsAVX2 )
+        {
+            return CPU_CULL_KERNEL_AVX2;
+        }
+        if( eKernel != CPU_CULL_KERNEL_SCALAR && g_bCpuSupportsSSE2 )
+        {
+            return CPU_CULL_KERNEL_SSE2;
+        }
+#else
+        (void)eKernel;
+#endif
+        return CPU_CULL_KERNEL_SCALAR;
+    }
+
+    PFN_CPU_CULL_KERNEL GetCpuCullKernel( CpuCullKernel eKernel )
+    {
+        switch( ResolveCpuCullKernel( eKernel ) )
+        {
+#if CPU_CULL_X86
+        case CPU_CULL_KERNEL_AVX2:  return CullKernelAVX2;
+        case CPU_CULL_KERNEL_SSE2:  return CullKernelSSE2;
+#endif
+        default:                    return CullKernelScalar;
+        }
+    }
+
+    PFN_CPU_CULL_RANGE_KERNEL GetCpuCullRangeKernel( CpuCullKernel eKernel )
+    {
+        switch( ResolveCpuCullKernel( eKernel ) )
+        {
+#if CPU_CULL_X86
+        case CPU_CULL_KERNEL_AVX2:  return CullRangeKernelAVX2;
+        case CPU_CULL_KERNEL_SSE2:  return CullRangeKernelSSE2;
+#endif
+        default:                    return CullRangeKernelScalar;
+        }
+    }
+
+    const char* GetCpuCullKernelName( CpuCullKernel eKernel )
+    {
+        switch( eKernel )
+        {
+        case CPU_CULL_KERNEL_AUTO:      return "Auto";
+        case CPU_CULL_KERNEL_SCALAR:    return "Scalar";
+        case CPU_CULL_KERNEL_SSE2:      return "SSE2";
+        case CPU_CULL_KERNEL_AVX2:      return "AVX2";
+        default:                        assert( false ); return "Unknown";
+        }
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,118 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusCpuCullKernels.h
+//
+// Batched sphere vs. tile frustum kernels for the CPU light culler.
+// Each kernel tests a structure-of-arrays batch of view-space bounding spheres
+// against the four side planes and the depth slab of one tile, and writes the
+// indices of the survivors out contiguously (left-packed).
+//
+// All kernels evaluate the same expressions in the same order as TestFrustumSides
+// and the depth test in CullLightsCS, so they produce identical lists.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+namespace ForwardPlus11
+{
+    // Lights are processed in batches of this many, so the
+    // SoA light arrays must be padded to a multiple of it
+    static const unsigned CPU_CULL_BATCH_SIZE = 8;
+
+    enum CpuCullKernel
+    {
+        CPU_CULL_KERNEL_AUTO = 0,   // the fastest one the CPU supports
+        CPU_CULL_KERNEL_SCALAR,
+        CPU_CULL_KERNEL_SSE2,       // 4 lights at a time
+        CPU_CULL_KERNEL_AVX2,       // 8 lights at a time
+        CPU_CULL_KERNEL_COUNT
+    };
+
+    //--------------------------------------------------------------------------------------
+    // The view-space volume of one tile. The four side planes pass through the origin
+    // (see CreatePlaneEquation), with the positive half-space outside the frustum.
+    // The depth slab is [fMinZ,fMaxZ]. Without depth bounds, use fMinZ = 0 and
+    // fMaxZ = FLT_MAX, which reduces the slab test to the near plane test (-z < r).
+    //--------------------------------------------------------------------------------------
+    struct CpuCullTileFrustum
+    {
+        float fPlaneX[4];
+        float fPlaneY[4];
+        float fPlaneZ[4];
+        float fMinZ;
+        float fMaxZ;
+    };
+
+    //--------------------------------------------------------------------------------------
+    // Lights in structure-of-arrays form, padded to a multiple of CPU_CULL_BATCH_SIZE
+    // with spheres that never pass (see CpuCullLightsSoA::Resize).
+    //--------------------------------------------------------------------------------------
+    struct CpuCullLightsSoA
+    {
+        std::vector<float>  X;
+        std::vector<float>  Y;
+        std::vector<float>  Z;
+        std::vector<float>  R;
+        unsigned            uNumLights;         // real lights
+        unsigned            uNumLightsPadded;   // allocated (multiple of CPU_CULL_BATCH_SIZE)
+
+        CpuCullLightsSoA() : uNumLights(0), uNumLightsPadded(0) {}
+
+        // (Re)size for uNumLights lights and fill the padding
+        void Resize( unsigned uNewNumLights );
+
+        void Set( unsigned uIdx, float x, float y, float z, float r )
+        {
+            X[uIdx] = x; Y[uIdx] = y; Z[uIdx] = z; R[uIdx] = r;
+        }
+    };
+
+    //--------------------------------------------------------------------------------------
+    // Tests lights [0,Lights.uNumLightsPadded) against the tile and writes the indices of
+    // the ones that pass to pOut, returning how many passed. pOut must have room for
+    // Lights.uNumLightsPadded entries (the packing step stores whole batches).
+    //--------------------------------------------------------------------------------------
+    typedef unsigned (*PFN_CPU_CULL_KERNEL)( const CpuCullTileFrustum& Tile, const CpuCullLightsSoA& Lights, unsigned* pOut );
+
+    //--------------------------------------------------------------------------------------
+    // Same, but only for lights [uBegin,uEnd), where both are multiples of CPU_CULL_BATCH_SIZE
+    // (used by the light BVH to test the lights of a leaf). The indices written to pOut are
+    // indices into Lights, not relative to uBegin.
+    //--------------------------------------------------------------------------------------
+    typedef unsigned (*PFN_CPU_CULL_RANGE_KERNEL)( const CpuCullTileFrustum& Tile, const CpuCullLightsSoA& Lights, unsigned uBegin, unsigned uEnd, unsigned* pOut );
+
+    // Runtime ISA dispatch: returns the kernel to use for a requested kernel
+    // type, falling back to the next best one the CPU supports
+    CpuCullKernel ResolveCpuCullKernel( CpuCullKernel eKernel );
+    PFN_CPU_CULL_KERNEL GetCpuCullKernel( CpuCullKernel eKernel );
+    PFN_CPU_CULL_RANGE_KERNEL GetCpuCullRangeKernel( CpuCullKernel eKernel );
+    const char* GetCpuCullKernelName( CpuCullKernel eKernel );
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
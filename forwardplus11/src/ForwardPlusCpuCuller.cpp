@@ -0,0 +1,1441 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusCpuCuller.cpp
+//
+// CPU implementation of the tiled light culling done by CullLightsCS.
+//--------------------------------------------------------------------------------------
+
+#include "ForwardPlusCpuCuller.h"
+#include "ForwardPlusParallel.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+using namespace DirectX;
+
+//-----------------------------------------------------------------------------------------
+// Helper functions, mirroring their counterparts in ForwardPlus11Tiling.hlsl
+//-----------------------------------------------------------------------------------------
+
+// mul( float4(p.xyz,1), m ).xyz
+static XMFLOAT3 TransformPoint( const XMFLOAT4& p, const XMFLOAT4X4& m )
+{
+    return XMFLOAT3( p.x*m._11 + p.y*m._21 + p.z*m._31 + m._41,
+                     p.x*m._12 + p.y*m._22 + p.z*m._32 + m._42,
+                     p.x*m._13 + p.y*m._23 + p.z*m._33 + m._43 );
+}
+
+// mul( float4(d.xyz,0), m ).xyz
+static XMFLOAT3 TransformDirection( const XMFLOAT3& d, const XMFLOAT4X4& m )
+{
+    return XMFLOAT3( d.x*m._11 + d.y*m._21 + d.z*m._31,
+                     d.x*m._12 + d.y*m._22 + d.z*m._32,
+                     d.x*m._13 + d.y*m._23 + d.z*m._33 );
+}
+
+// convert a point from post-projection space into view space
+static XMFLOAT3 ConvertProjToView( float x, float y, float z, float w, const XMFLOAT4X4& mProjectionInv )
+{
+    const XMFLOAT4X4& m = mProjectionInv;
+    float fX = x*m._11 + y*m._21 + z*m._31 + w*m._41;
+    float fY = x*m._12 + y*m._22 + z*m._32 + w*m._42;
+    float fZ = x*m._13 + y*m._23 + z*m._33 + w*m._43;
+    float fW = x*m._14 + y*m._24 + z*m._34 + w*m._44;
+    return XMFLOAT3( fX/fW, fY/fW, fZ/fW );
+}
+
+// convert a depth value from post-projection space into view space
+static float ConvertProjDepthToView( float z, const XMFLOAT4X4& mProjectionInv )
+{
+    return 1.f / ( z*mProjectionInv._34 + mProjectionInv._44 );
+}
+
+// this creates the standard Hessian-normal-form plane equation from three points,
+// except it is simplified for the case where the first point is the origin
+static XMFLOAT3 CreatePlaneEquation( const XMFLOAT3& b, const XMFLOAT3& c )
+{
+    XMFLOAT3 n( b.y*c.z - b.z*c.y, b.z*c.x - b.x*c.z, b.x*c.y - b.y*c.x );
+    float fLength = sqrtf( n.x*n.x + n.y*n.y + n.z*n.z );
+    return XMFLOAT3( n.x/fLength, n.y/fLength, n.z/fLength );
+}
+
+// which of the depth mask cells a view-space depth falls into, like GetDepthMaskCell
+static unsigned GetDepthMaskCell( float fViewPosZ, float fMinZ, float fInvCellSize )
+{
+    float fCell = ( fViewPosZ - fMinZ )*fInvCellSize;
+    fCell = ( fCell > 0.f ) ? fCell : 0.f;
+    fCell = ( fCell < (float)( ForwardPlus11::DEPTH_MASK_NUM_CELLS - 1 ) ) ? fCell : (float)( ForwardPlus11::DEPTH_MASK_NUM_CELLS - 1 );
+    return (unsigned)fCell;
+}
+
+// test the depth extent of a bounding sphere against a depth mask, like TestDepthMask
+static bool TestDepthMask( unsigned uDepthMask, float z, float r, float fMinZ, float fInvCellSize )
+{
+    unsigned uFirstCell = GetDepthMaskCell( z - r, fMinZ, fInvCellSize );
+    unsigned uLastCell = GetDepthMaskCell( z + r, fMinZ, fInvCellSize );
+    unsigned uLightMask = ( 0xFFFFFFFFu >> ( 31 - uLastCell ) ) & ( 0xFFFFFFFFu << uFirstCell );
+    return ( uLightMask & uDepthMask ) != 0;
+}
+
+// keep only the lights in pLights that pass the depth mask test, returning how many did
+static unsigned ApplyDepthMask( unsigned* pLights, unsigned uNumLights, const ForwardPlus11::CpuCullLightsSoA& Lights,
+                                unsigned uDepthMask, float fMinZ, float fInvCellSize )
+{
+    unsigned uNumLightsKept = 0;
+    for( unsigned i = 0; i < uNumLights; i++ )
+    {
+        unsigned uLightIdx = pLights[i];
+        if( TestDepthMask( uDepthMask, Lights.Z[uLightIdx], Lights.R[uLightIdx], fMinZ, fInvCellSize ) )
+        {
+            pLights[uNumLightsKept++] = uLightIdx;
+        }
+    }
+    return uNumLightsKept;
+}
+
+// keep only the spot lights in pLights whose cone passes the tile, returning how many did
+static unsigned ApplySpotCones( unsigned* pLights, unsigned uNumLights, const std::vector<ForwardPlus11::CpuCullSpotCone>& SpotCones,
+                                const ForwardPlus11::CpuCullTileFrustum& Frustum )
+{
+    unsigned uNumLightsKept = 0;
+    for( unsigned i = 0; i < uNumLights; i++ )
+    {
+        unsigned uLightIdx = pLights[i];
+        if( ForwardPlus11::TestSpotCone( SpotCones[uLightIdx], Frustum ) )
+        {
+            pLights[uNumLightsKept++] = uLightIdx;
+        }
+    }
+    return uNumLightsKept;
+}
+
+// keep only the lights in pLights that can add fMinContribution to some pixel of the tile
+// (see ForwardPlusLightLod.h), returning how many did, and add the estimated ambient of 
+// the ones that can not to pAmbient, if it is not NULL
+static unsigned ApplyLightLod( unsigned* pLights, unsigned uNumLights, const ForwardPlus11::CpuCullLightsSoA& Falloffs, const std::vector<XMFLOAT3>& Colors,
+                               const ForwardPlus11::CpuCullTileFrustum& Frustum, float fMinContribution, XMFLOAT3* pAmbient )
+{
+    unsigned uNumLightsKept = 0;
+    for( unsigned i = 0; i < uNumLights; i++ )
+    {
+        unsigned uLightIdx = pLights[i];
+        const XMFLOAT3& Color = Colors[uLightIdx];
+        float fMaxColor = ( Color.x > Color.y ) ? Color.x : Color.y;
+        fMaxColor = ( Color.z > fMaxColor ) ? Color.z : fMaxColor;
+        float fMaxFalloff = ForwardPlus11::GetMaxFalloffInTile( Frustum, Falloffs.X[uLightIdx], Falloffs.Y[uLightIdx], Falloffs.Z[uLightIdx], Falloffs.R[uLightIdx] );
+        if( ForwardPlus11::GetMaxLightContribution( fMaxFalloff, fMaxColor ) >= fMinContribution )
+        {
+            pLights[uNumLightsKept++] = uLightIdx;
+        }
+        else if( pAmbient != NULL )
+        {
+            float fAmbient = ForwardPlus11::LIGHT_LOD_AMBIENT_SCALE*fMaxFalloff;
+            pAmbient->x += Color.x*fAmbient;
+            pAmbient->y += Color.y*fAmbient;
+            pAmbient->z += Color.z*fAmbient;
+        }
+    }
+    return uNumLightsKept;
+}
+
+// unpack DXGI_FORMAT_R8G8B8A8_UNORM colors, like RenderScenePS reads them
+static void UnpackLightColors( const unsigned* pColors, unsigned uNumLights, std::vector<XMFLOAT3>& Colors )
+{
+    Colors.resize( uNumLights );
+    for( unsigned i = 0; i < uNumLights; i++ )
+    {
+        Colors[i].x = (float)( pColors[i] & 0xff ) / 255.f;
+        Colors[i].y = (float)( ( pColors[i] >> 8 ) & 0xff ) / 255.f;
+        Colors[i].z = (float)( ( pColors[i] >> 16 ) & 0xff ) / 255.f;
+    }
+}
+
+// the light colors that go into the lists, i.e. NULL without the light LOD
+static const unsigned* GetLightLodColors( const ForwardPlus11::CpuLightCullDesc& Desc, const unsigned* pColors )
+{
+    return ( Desc.fMinLightContribution > 0.f && Desc.pClusterConfig == NULL ) ? pColors : NULL;
+}
+
+//-----------------------------------------------------------------------------------------
+// Depth kernels, specialized for each tile size, so that the loops over the rows of a
+// full tile have a length known at compile time, and get unrolled and vectorized
+//-----------------------------------------------------------------------------------------
+
+// the pixels (or samples) of a tile, clipped to the window
+template<unsigned TILE_RES_T>
+static void GetTileDepthRange( const ForwardPlus11::CpuLightCullDesc& Desc, unsigned uTileX, unsigned uTileY,
+                               unsigned* pStartX, unsigned* pStartY, unsigned* pEndX, unsigned* pEndY )
+{
+    *pStartX = TILE_RES_T*uTileX;
+    *pStartY = TILE_RES_T*uTileY;
+    *pEndX = ( *pStartX + TILE_RES_T < Desc.uWindowWidth ) ? *pStartX + TILE_RES_T : Desc.uWindowWidth;
+    *pEndY = ( *pStartY + TILE_RES_T < Desc.uWindowHeight ) ? *pStartY + TILE_RES_T : Desc.uWindowHeight;
+}
+
+// min and max of the depths in a row that are not the cleared depth (zero)
+template<unsigned N>
+static void AccumulateMinMaxDepth( const float* pDepth, float* pMinDepth, float* pMaxDepth )
+{
+    float fMinDepth = *pMinDepth;
+    float fMaxDepth = *pMaxDepth;
+    for( unsigned i = 0; i < N; i++ )
+    {
+        float fDepth = pDepth[i];
+        float fDepthOrMax = ( fDepth != 0.f ) ? fDepth : FLT_MAX;
+        fMinDepth = ( fDepthOrMax < fMinDepth ) ? fDepthOrMax : fMinDepth;
+        fMaxDepth = ( fDepth > fMaxDepth ) ? fDepth : fMaxDepth;
+    }
+    *pMinDepth = fMinDepth;
+    *pMaxDepth = fMaxDepth;
+}
+
+static void AccumulateMinMaxDepth( const float* pDepth, unsigned uCount, float* pMinDepth, float* pMaxDepth )
+{
+    float fMinDepth = *pMinDepth;
+    float fMaxDepth = *pMaxDepth;
+    for( unsigned i = 0; i < uCount; i++ )
+    {
+        float fDepth = pDepth[i];
+        float fDepthOrMax = ( fDepth != 0.f ) ? fDepth : FLT_MAX;
+        fMinDepth = ( fDepthOrMax < fMinDepth ) ? fDepthOrMax : fMinDepth;
+        fMaxDepth = ( fDepth > fMaxDepth ) ? fDepth : fMaxDepth;
+    }
+    *pMinDepth = fMinDepth;
+    *pMaxDepth = fMaxDepth;
+}
+
+// view-space depth range of the stored depth range of a tile (with the 
+// min skipping the cleared depth, so a min of FLT_MAX means an empty tile)
+static void ConvertMinMaxDepthToView( float fMinDepth, float fMaxDepth, const XMFLOAT4X4& mProjectionInv, float* pMinZ, float* pMaxZ )
+{
+    if( fMaxDepth == 0.f )
+    {
+        // nothing but cleared depth
+        *pMinZ = FLT_MAX;
+        *pMaxZ = 0.f;
+        return;
+    }
+
+    float fViewPosZ0 = ConvertProjDepthToView( fMinDepth, mProjectionInv );
+    float fViewPosZ1 = ConvertProjDepthToView( fMaxDepth, mProjectionInv );
+    *pMinZ = ( fViewPosZ0 < fViewPosZ1 ) ? fViewPosZ0 : fViewPosZ1;
+    *pMaxZ = ( fViewPosZ0 > fViewPosZ1 ) ? fViewPosZ0 : fViewPosZ1;
+}
+
+// Min and max view-space depth for a tile, like CalculateMinMaxDepthInLds(MSAA).
+// Pixels (or samples) at the cleared depth (zero, since depth is inverted) are
+// skipped, and so are pixels outside the window in partial tiles at the right and
+// bottom edges (the GPU reads zero for those, so it skips them too).
+// ConvertProjDepthToView is monotonic, so only the extremes of the stored depth need
+// converting, which gives the same result as converting every pixel.
+template<unsigned TILE_RES_T>
+static void CalculateTileMinMaxDepth( const ForwardPlus11::CpuLightCullDesc& Desc, unsigned uTileX, unsigned uTileY, float* pMinZ, float* pMaxZ )
+{
+    unsigned uPitch = ( Desc.uDepthBufferPitch == 0 ) ? Desc.uWindowWidth : Desc.uDepthBufferPitch;
+    unsigned uNumSamples = ( Desc.uDepthBufferNumSamples == 0 ) ? 1 : Desc.uDepthBufferNumSamples;
+
+    unsigned uStartX, uStartY, uEndX, uEndY;
+    GetTileDepthRange<TILE_RES_T>( Desc, uTileX, uTileY, &uStartX, &uStartY, &uEndX, &uEndY );
+    bool bFullRows = ( uEndX - uStartX == TILE_RES_T ) && ( uNumSamples == 1 );
+
+    float fMinDepth = FLT_MAX;
+    float fMaxDepth = 0.f;
+    for( unsigned y = uStartY; y < uEndY; y++ )
+    {
+        const float* pRow = Desc.pDepthBuffer + ( (size_t)y*uPitch + uStartX )*uNumSamples;
+        if( bFullRows )
+        {
+            AccumulateMinMaxDepth<TILE_RES_T>( pRow, &fMinDepth, &fMaxDepth );
+        }
+        else
+        {
+            AccumulateMinMaxDepth( pRow, ( uEndX - uStartX )*uNumSamples, &fMinDepth, &fMaxDepth );
+        }
+    }
+
+    ConvertMinMaxDepthToView( fMinDepth, fMaxDepth, Desc.mProjectionInv, pMinZ, pMaxZ );
+}
+
+// Same, but looked up in the level of the depth pyramid with a texel per tile
+// (the pyramid holds the same extremes, so the result is the same too)
+static void GetTileMinMaxDepthFromPyramid( const ForwardPlus11::CpuLightCullDesc& Desc, unsigned uTileRes, unsigned uTileX, unsigned uTileY, float* pMinZ, float* pMaxZ )
+{
+    float fMinDepth, fMaxDepth;
+    Desc.pDepthPyramid->GetMinMaxDepth( ForwardPlus11::GetHiZLevel( uTileRes ), uTileX, uTileY, &fMinDepth, &fMaxDepth );
+    ConvertMinMaxDepthToView( fMinDepth, fMaxDepth, Desc.mProjectionInv, pMinZ, pMaxZ );
+}
+
+// depth mask cells of the depths in a row that are not the cleared depth (zero)
+template<unsigned N>
+static unsigned AccumulateDepthMask( const float* pDepth, const XMFLOAT4X4& mProjectionInv, float fMinZ, float fInvCellSize )
+{
+    unsigned uDepthMask = 0;
+    for( unsigned i = 0; i < N; i++ )
+    {
+        float fDepth = pDepth[i];
+        unsigned uCellBit = 1u << GetDepthMaskCell( ConvertProjDepthToView( fDepth, mProjectionInv ), fMinZ, fInvCellSize );
+        uDepthMask |= ( fDepth != 0.f ) ? uCellBit : 0;
+    }
+    return uDepthMask;
+}
+
+static unsigned AccumulateDepthMask( const float* pDepth, unsigned uCount, const XMFLOAT4X4& mProjectionInv, float fMinZ, float fInvCellSize )
+{
+    unsigned uDepthMask = 0;
+    for( unsigned i = 0; i < uCount; i++ )
+    {
+        float fDepth = pDepth[i];
+        unsigned uCellBit = 1u << GetDepthMaskCell( ConvertProjDepthToView( fDepth, mProjectionInv ), fMinZ, fInvCellSize );
+        uDepthMask |= ( fDepth != 0.f ) ? uCellBit : 0;
+    }
+    return uDepthMask;
+}
+
+// Depth mask for a tile, like CalculateDepthMaskInLds(MSAA): bit i is set if a pixel
+// (or sample) in the tile falls into cell i of the tile's min/max depth range
+template<unsigned TILE_RES_T>
+static unsigned CalculateTileDepthMask( const ForwardPlus11::CpuLightCullDesc& Desc, unsigned uTileX, unsigned uTileY, float fMinZ, float fInvCellSize )
+{
+    unsigned uPitch = ( Desc.uDepthBufferPitch == 0 ) ? Desc.uWindowWidth : Desc.uDepthBufferPitch;
+    unsigned uNumSamples = ( Desc.uDepthBufferNumSamples == 0 ) ? 1 : Desc.uDepthBufferNumSamples;
+
+    unsigned uStartX, uStartY, uEndX, uEndY;
+    GetTileDepthRange<TILE_RES_T>( Desc, uTileX, uTileY, &uStartX, &uStartY, &uEndX, &uEndY );
+    bool bFullRows = ( uEndX - uStartX == TILE_RES_T ) && ( uNumSamples == 1 );
+
+    unsigned uDepthMask = 0;
+    for( unsigned y = uStartY; y < uEndY; y++ )
+    {
+        const float* pRow = Desc.pDepthBuffer + ( (size_t)y*uPitch + uStartX )*uNumSamples;
+        if( bFullRows )
+        {
+            uDepthMask |= AccumulateDepthMask<TILE_RES_T>( pRow, Desc.mProjectionInv, fMinZ, fInvCellSize );
+        }
+        else
+        {
+            uDepthMask |= AccumulateDepthMask( pRow, ( uEndX - uStartX )*uNumSamples, Desc.mProjectionInv, fMinZ, fInvCellSize );
+        }
+    }
+
+    return uDepthMask;
+}
+
+// The lights that are not the same as in the previous Cull, including the ones that were 
+// only there then, or are only there now (pSpotParams is NULL for point lights, and for 
+// spot lights culled by their spheres, pColors is NULL without the light LOD)
+static void FindChangedLights( const XMFLOAT4* pLights, unsigned uNumLights, const ForwardPlus11::SpotParams* pSpotParams, const unsigned* pColors,
+                               const std::vector<XMFLOAT4>& PrevLights, const std::vector<ForwardPlus11::SpotParams>& PrevSpotParams,
+                               const std::vector<unsigned>& PrevColors, std::vector<unsigned>& ChangedLights )
+{
+    ChangedLights.clear();
+    unsigned uNumPrevLights = (unsigned)PrevLights.size();
+    unsigned uNumLightsToCompare = ( uNumLights < uNumPrevLights ) ? uNumLights : uNumPrevLights;
+    for( unsigned i = 0; i < uNumLightsToCompare; i++ )
+    {
+        if( memcmp( &pLights[i], &PrevLights[i], sizeof(XMFLOAT4) ) != 0 ||
+            ( pSpotParams != NULL && memcmp( &pSpotParams[i], &PrevSpotParams[i], sizeof(ForwardPlus11::SpotParams) ) != 0 ) ||
+            ( pColors != NULL && pColors[i] != PrevColors[i] ) )
+        {
+            ChangedLights.push_back( i );
+        }
+    }
+
+    unsigned uNumAllLights = ( uNumLights > uNumPrevLights ) ? uNumLights : uNumPrevLights;
+    for( unsigned i = uNumLightsToCompare; i < uNumAllLights; i++ )
+    {
+        ChangedLights.push_back( i );
+    }
+}
+
+// The changed lights, where they are now and where they were in the previous Cull 
+// (the same light can be in there twice), in view space
+static void GatherChangedLights( const std::vector<unsigned>& ChangedLights, const ForwardPlus11::CpuCullLightsSoA& LightsView,
+                                 const std::vector<XMFLOAT4>& PrevLights, const XMFLOAT4X4& mWorldView, ForwardPlus11::CpuCullLightsSoA& ChangedLightsView )
+{
+    ChangedLightsView.Resize( 2*(unsigned)ChangedLights.size() );
+    unsigned uNumChangedLights = 0;
+    for( unsigned i = 0; i < (unsigned)ChangedLights.size(); i++ )
+    {
+        unsigned uLightIdx = ChangedLights[i];
+        if( uLightIdx < LightsView.uNumLights )
+        {
+            ChangedLightsView.Set( uNumChangedLights++, LightsView.X[uLightIdx], LightsView.Y[uLightIdx], LightsView.Z[uLightIdx], LightsView.R[uLightIdx] );
+        }
+        if( uLightIdx < (unsigned)PrevLights.size() )
+        {
+            XMFLOAT3 Center = TransformPoint( PrevLights[uLightIdx], mWorldView );
+            ChangedLightsView.Set( uNumChangedLights++, Center.x, Center.y, Center.z, PrevLights[uLightIdx].w );
+        }
+    }
+    ChangedLightsView.Resize( uNumChangedLights );
+}
+
+// FNV-1a over the entries of a list, for finding lists that are the same
+static unsigned HashLightList( const unsigned* pList, unsigned uNumEntries )
+{
+    unsigned uHash = 2166136261u;
+    for( unsigned i = 0; i < uNumEntries; i++ )
+    {
+        unsigned uEntry = pList[i];
+        for( int nByte = 0; nByte < 4; nByte++ )
+        {
+            uHash = ( uHash ^ ( uEntry & 0xff ) )*16777619u;
+            uEntry >>= 8;
+        }
+    }
+    return uHash;
+}
+
+namespace ForwardPlus11
+{
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CpuLightCuller::CpuLightCuller()
+        :m_uNumThreads(0)
+        ,m_eKernel(ResolveCpuCullKernel(CPU_CULL_KERNEL_AUTO))
+        ,m_pfnKernel(NULL)
+        ,m_pfnRangeKernel(NULL)
+        ,m_bUseLightBvh(false)
+        ,m_bUseCoarseTiles(false)
+        ,m_uTileRes(DEFAULT_TILE_RES)
+        ,m_pfnTileMinMaxDepth(NULL)
+        ,m_pfnTileDepthMask(NULL)
+        ,m_uNumTilesX(0)
+        ,m_uNumTilesY(0)
+        ,m_uNumClusterSlices(1)
+        ,m_uMaxNumLightsPerList(0)
+        ,m_uTileFrustumsTileRes(0)
+        ,m_uTileFrustumsWindowWidth(0)
+        ,m_uTileFrustumsWindowHeight(0)
+        ,m_bMergeDroppedLights(false)
+        ,m_uNumCoarseTilesX(0)
+        ,m_uNumCoarseTilesY(0)
+        ,m_bUseTemporalReuse(false)
+        ,m_bPrevCullValid(false)
+        ,m_bPrevCullUseCoarseTiles(false)
+        ,m_uNumCulledTiles(0)
+        ,m_uNumReusedTiles(0)
+    {
+        memset( &m_mTileFrustumsProjectionInv, 0, sizeof(m_mTileFrustumsProjectionInv) );
+        memset( &m_PrevCullDesc, 0, sizeof(m_PrevCullDesc) );
+        memset( &m_PrevClusterConfig, 0, sizeof(m_PrevClusterConfig) );
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CpuLightCuller::~CpuLightCuller()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Cull all lights against all tiles
+    //--------------------------------------------------------------------------------------
+    void CpuLightCuller::Cull( const CpuLightCullDesc& Desc )
+    {
+        assert( Desc.uNumPointLights == 0 || Desc.pPointLightCenterAndRadius != NULL );
+        assert( Desc.uNumSpotLights == 0 || Desc.pSpotLightCenterAndRadius != NULL );
+
+        m_uTileRes = ( Desc.uTileRes == 0 ) ? DEFAULT_TILE_RES : Desc.uTileRes;
+        switch( m_uTileRes )
+        {
+        case 8:
+            m_pfnTileMinMaxDepth = CalculateTileMinMaxDepth<8>;
+            m_pfnTileDepthMask = CalculateTileDepthMask<8>;
+            break;
+        case 16:
+            m_pfnTileMinMaxDepth = CalculateTileMinMaxDepth<16>;
+            m_pfnTileDepthMask = CalculateTileDepthMask<16>;
+            break;
+        case 32:
+            m_pfnTileMinMaxDepth = CalculateTileMinMaxDepth<32>;
+            m_pfnTileDepthMask = CalculateTileDepthMask<32>;
+            break;
+        case 64:
+            m_pfnTileMinMaxDepth = CalculateTileMinMaxDepth<64>;
+            m_pfnTileDepthMask = CalculateTileDepthMask<64>;
+            break;
+        default:
+            assert( false );    // not one of the supported tile sizes
+            return;
+        }
+
+        m_uNumTilesX = ( Desc.uWindowWidth + m_uTileRes - 1 ) / m_uTileRes;
+        m_uNumTilesY = ( Desc.uWindowHeight + m_uTileRes - 1 ) / m_uTileRes;
+        m_uNumClusterSlices = ( Desc.pClusterConfig != NULL ) ? Desc.pClusterConfig->uNumSlices : 1;
+        m_uMaxNumLightsPerList = ( Desc.pClusterConfig != NULL ) ? Desc.pClusterConfig->uMaxNumLightsPerCluster : Desc.uMaxNumLightsPerTile;
+        assert( m_uMaxNumLightsPerList >= 2 );  // need room for the two sentinels
+        assert( m_uNumClusterSlices >= 1 && m_uNumClusterSlices <= MAX_NUM_CLUSTER_SLICES );
+
+        unsigned uNumTiles = m_uNumTilesX*m_uNumTilesY;
+        m_LightIndexBuffer.resize( GetNumLists()*m_uMaxNumLightsPerList );
+        m_ListNumLights.resize( GetNumLists() );
+        m_TileNumSpotConeRejections.resize( uNumTiles );
+        m_TileClasses.resize( uNumTiles );
+        m_TileNumLightLodRejections.resize( uNumTiles );
+        m_TileAmbient.resize( uNumTiles );
+
+        const unsigned* pPointLightLodColors = GetLightLodColors( Desc, Desc.pPointLightColor );
+        const unsigned* pSpotLightLodColors = GetLightLodColors( Desc, ( Desc.pSpotLightSpotParams != NULL ) ? Desc.pSpotLightColor : NULL );
+        m_bMergeDroppedLights = Desc.bMergeDroppedLights && ( pPointLightLodColors != NULL || pSpotLightLodColors != NULL );
+
+        // with temporal reuse, start from what changed since the previous Cull
+        // (the buffers above kept their lists, since their size did not change)
+        bool bReuseLists = m_bUseTemporalReuse && HasSameSetupAsPrevCull( Desc );
+        m_TileNeedsCull.assign( uNumTiles, bReuseLists ? 0 : 1 );
+        if( bReuseLists )
+        {
+            FindTilesWithChangedDepth( Desc );
+            FindChangedLights( Desc.pPointLightCenterAndRadius, Desc.uNumPointLights, NULL, pPointLightLodColors,
+                               m_PrevPointLights, m_PrevSpotParams, m_PrevPointLightColors, m_ChangedPointLights );
+            FindChangedLights( Desc.pSpotLightCenterAndRadius, Desc.uNumSpotLights, Desc.pSpotLightSpotParams, pSpotLightLodColors,
+                               m_PrevSpotLights, m_PrevSpotParams, m_PrevSpotLightColors, m_ChangedSpotLights );
+            if( m_ChangedPointLights.empty() && m_ChangedSpotLights.empty() &&
+                std::find( m_TileNeedsCull.begin(), m_TileNeedsCull.end(), 1 ) == m_TileNeedsCull.end() )
+            {
+                // nothing changed, so neither did the lists
+                m_uNumCulledTiles = 0;
+                m_uNumReusedTiles = uNumTiles;
+                return;
+            }
+        }
+
+        UpdateTileFrustums( Desc );
+
+        // transform the lights into view space once, instead of once per tile
+        m_PointLightsView.Resize( Desc.uNumPointLights );
+        for( unsigned i = 0; i < Desc.uNumPointLights; i++ )
+        {
+            XMFLOAT3 Center = TransformPoint( Desc.pPointLightCenterAndRadius[i], Desc.mWorldView );
+            m_PointLightsView.Set( i, Center.x, Center.y, Center.z, Desc.pPointLightCenterAndRadius[i].w );
+        }
+
+        m_SpotLightsView.Resize( Desc.uNumSpotLights );
+        for( unsigned i = 0; i < Desc.uNumSpotLights; i++ )
+        {
+            XMFLOAT3 Center = TransformPoint( Desc.pSpotLightCenterAndRadius[i], Desc.mWorldView );
+            m_SpotLightsView.Set( i, Center.x, Center.y, Center.z, Desc.pSpotLightCenterAndRadius[i].w );
+        }
+
+        // and their cones, with the light direction rotated into view space
+        m_SpotConesView.resize( ( Desc.pSpotLightSpotParams != NULL ) ? Desc.uNumSpotLights : 0 );
+        for( unsigned i = 0; i < (unsigned)m_SpotConesView.size(); i++ )
+        {
+            SpotLightCone Cone;
+            UnpackSpotParams( Desc.pSpotLightSpotParams[i], &Cone );
+            Cone.vLightDir = TransformDirection( Cone.vLightDir, Desc.mWorldView );
+            CalculateSpotCone( m_SpotLightsView.X[i], m_SpotLightsView.Y[i], m_SpotLightsView.Z[i], m_SpotLightsView.R[i], Cone, &m_SpotConesView[i] );
+        }
+
+        // and for the light LOD, their colors, and where the falloff of the spot lights starts
+        UnpackLightColors( pPointLightLodColors, ( pPointLightLodColors != NULL ) ? Desc.uNumPointLights : 0, m_PointLightColors );
+        UnpackLightColors( pSpotLightLodColors, ( pSpotLightLodColors != NULL ) ? Desc.uNumSpotLights : 0, m_SpotLightColors );
+        m_SpotLightFalloffsView.Resize( (unsigned)m_SpotLightColors.size() );
+        for( unsigned i = 0; i < (unsigned)m_SpotLightColors.size(); i++ )
+        {
+            const CpuCullSpotCone& Cone = m_SpotConesView[i];
+            m_SpotLightFalloffsView.Set( i, Cone.fApexX, Cone.fApexY, Cone.fApexZ, Cone.fHeight );
+        }
+
+        // the coarse tiles cover COARSE_TILE_RES pixels of the tile grid
+        bool bUseCoarseTiles = m_bUseCoarseTiles && m_uTileRes < COARSE_TILE_RES;
+        unsigned uTilesPerCoarseTile = COARSE_TILE_RES / m_uTileRes;
+        m_uNumCoarseTilesX = bUseCoarseTiles ? ( m_uNumTilesX + uTilesPerCoarseTile - 1 ) / uTilesPerCoarseTile : 0;
+        m_uNumCoarseTilesY = bUseCoarseTiles ? ( m_uNumTilesY + uTilesPerCoarseTile - 1 ) / uTilesPerCoarseTile : 0;
+        m_CoarseTiles.resize( m_uNumCoarseTilesX*m_uNumCoarseTilesY );
+        if( bUseCoarseTiles )
+        {
+            m_PointLightsCoarse.Resize( Desc.uNumPointLights );
+            for( unsigned i = 0; i < Desc.uNumPointLights; i++ )
+            {
+                float x = m_PointLightsView.X[i], y = m_PointLightsView.Y[i], z = m_PointLightsView.Z[i];
+                m_PointLightsCoarse.Set( i, x, y, z, GetCoarseTileTestRadius( x, y, z, m_PointLightsView.R[i] ) );
+            }
+
+            m_SpotLightsCoarse.Resize( Desc.uNumSpotLights );
+            for( unsigned i = 0; i < Desc.uNumSpotLights; i++ )
+            {
+                float x = m_SpotLightsView.X[i], y = m_SpotLightsView.Y[i], z = m_SpotLightsView.Z[i];
+                m_SpotLightsCoarse.Set( i, x, y, z, GetCoarseTileTestRadius( x, y, z, m_SpotLightsView.R[i] ) );
+            }
+        }
+
+        m_pfnKernel = GetCpuCullKernel( m_eKernel );
+        m_pfnRangeKernel = GetCpuCullRangeKernel( m_eKernel );
+
+        // the BVH is walked by whichever pass tests all the lights
+        unsigned uNumThreads = ( m_uNumThreads == 0 ) ? GetDefaultNumThreads() : m_uNumThreads;
+        if( m_bUseLightBvh )
+        {
+            m_PointLightBvh.Build( bUseCoarseTiles ? m_PointLightsCoarse : m_PointLightsView, uNumThreads );
+            m_SpotLightBvh.Build( bUseCoarseTiles ? m_SpotLightsCoarse : m_SpotLightsView, uNumThreads );
+        }
+
+        // the kernels store whole batches, so the scratch lists
+        // need room for every light, including the padding
+        unsigned uScratchSize = m_PointLightsView.uNumLightsPadded + m_SpotLightsView.uNumLightsPadded + 1;
+        m_ThreadScratch.resize( uNumThreads );
+        for( unsigned i = 0; i < uNumThreads; i++ )
+        {
+            m_ThreadScratch[i].TileLights.resize( uScratchSize );
+            m_ThreadScratch[i].ClusterLights.resize( ( Desc.pClusterConfig != NULL ) ? uScratchSize : 0 );
+        }
+
+        // add the tiles the changed lights were in, or are in now
+        bool bCullAllTiles = !bReuseLists || FindTilesWithChangedLights();
+
+        // a coarse tile is culled again if any of its tiles are, and then all of its tiles are
+        std::vector<unsigned> CoarseTilesToCull;
+        for( unsigned uCoarseTileIdx = 0; uCoarseTileIdx < (unsigned)m_CoarseTiles.size(); uCoarseTileIdx++ )
+        {
+            unsigned uStartX = ( uCoarseTileIdx % m_uNumCoarseTilesX )*uTilesPerCoarseTile;
+            unsigned uStartY = ( uCoarseTileIdx / m_uNumCoarseTilesX )*uTilesPerCoarseTile;
+            unsigned uEndX = ( uStartX + uTilesPerCoarseTile < m_uNumTilesX ) ? uStartX + uTilesPerCoarseTile : m_uNumTilesX;
+            unsigned uEndY = ( uStartY + uTilesPerCoarseTile < m_uNumTilesY ) ? uStartY + uTilesPerCoarseTile : m_uNumTilesY;
+            bool bNeedsCull = bCullAllTiles;
+            for( unsigned uTileY = uStartY; uTileY < uEndY && !bNeedsCull; uTileY++ )
+            {
+                for( unsigned uTileX = uStartX; uTileX < uEndX; uTileX++ )
+                {
+                    bNeedsCull = bNeedsCull || ( m_TileNeedsCull[uTileY*m_uNumTilesX + uTileX] != 0 );
+                }
+            }
+            if( bNeedsCull )
+            {
+                CoarseTilesToCull.push_back( uCoarseTileIdx );
+                for( unsigned uTileY = uStartY; uTileY < uEndY; uTileY++ )
+                {
+                    memset( &m_TileNeedsCull[uTileY*m_uNumTilesX + uStartX], 1, uEndX - uStartX );
+                }
+            }
+        }
+
+        m_TilesToCull.clear();
+        for( unsigned uTileIdx = 0; uTileIdx < uNumTiles; uTileIdx++ )
+        {
+            if( bCullAllTiles || m_TileNeedsCull[uTileIdx] != 0 )
+            {
+                m_TilesToCull.push_back( uTileIdx );
+            }
+        }
+
+        // the coarse tiles first, since their tiles read their lights
+        struct CullCoarseTileFunc
+        {
+            CpuLightCuller* pThis;
+            const CpuLightCullDesc* pDesc;
+            const unsigned* pCoarseTileIndices;
+            void operator()( unsigned uIdx, unsigned uThreadIdx )
+            {
+                pThis->CullCoarseTile( *pDesc, pCoarseTileIndices[uIdx], pThis->m_ThreadScratch[uThreadIdx] );
+            }
+        };
+
+        CullCoarseTileFunc CoarseFunc = { this, &Desc, CoarseTilesToCull.empty() ? NULL : &CoarseTilesToCull[0] };
+        ParallelFor( (unsigned)CoarseTilesToCull.size(), uNumThreads, 1, CoarseFunc );
+
+        // each tile is independent, just like the thread groups of CullLightsCS
+        struct CullTileFunc
+        {
+            CpuLightCuller* pThis;
+            const CpuLightCullDesc* pDesc;
+            const unsigned* pTileIndices;
+            void operator()( unsigned uIdx, unsigned uThreadIdx )
+            {
+                pThis->CullTile( *pDesc, pTileIndices[uIdx], pThis->m_ThreadScratch[uThreadIdx] );
+            }
+        };
+
+        CullTileFunc Func = { this, &Desc, m_TilesToCull.empty() ? NULL : &m_TilesToCull[0] };
+        ParallelFor( (unsigned)m_TilesToCull.size(), uNumThreads, 16, Func );
+
+        m_uNumCulledTiles = (unsigned)m_TilesToCull.size();
+        m_uNumReusedTiles = uNumTiles - m_uNumCulledTiles;
+
+        if( m_bUseTemporalReuse )
+        {
+            SavePrevCullInputs( Desc );
+        }
+        m_bPrevCullValid = m_bUseTemporalReuse;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Whether the previous Cull had the same tiles, lists and options as this one,
+    // so that the lists of its tiles can be kept if their lights and depth did not change
+    //--------------------------------------------------------------------------------------
+    bool CpuLightCuller::HasSameSetupAsPrevCull( const CpuLightCullDesc& Desc ) const
+    {
+        const CpuLightCullDesc& Prev = m_PrevCullDesc;
+        bool bSameSetup = m_bPrevCullValid &&
+            memcmp( &Desc.mWorldView, &Prev.mWorldView, sizeof(XMFLOAT4X4) ) == 0 &&
+            memcmp( &Desc.mProjectionInv, &Prev.mProjectionInv, sizeof(XMFLOAT4X4) ) == 0 &&
+            Desc.uWindowWidth == Prev.uWindowWidth &&
+            Desc.uWindowHeight == Prev.uWindowHeight &&
+            Desc.uTileRes == Prev.uTileRes &&
+            Desc.uMaxNumLightsPerTile == Prev.uMaxNumLightsPerTile &&
+            ( Desc.pDepthBuffer != NULL ) == ( Prev.pDepthBuffer != NULL ) &&
+            Desc.uDepthBufferPitch == Prev.uDepthBufferPitch &&
+            Desc.uDepthBufferNumSamples == Prev.uDepthBufferNumSamples &&
+            Desc.bUseDepthMask == Prev.bUseDepthMask &&
+            ( Desc.pDepthPyramid != NULL ) == ( Prev.pDepthPyramid != NULL ) &&
+            ( Desc.pSpotLightSpotParams != NULL ) == ( Prev.pSpotLightSpotParams != NULL ) &&
+            ( Desc.pClusterConfig != NULL ) == ( Prev.pClusterConfig != NULL ) &&
+            Desc.fMinLightContribution == Prev.fMinLightContribution &&
+            Desc.bMergeDroppedLights == Prev.bMergeDroppedLights &&
+            ( GetLightLodColors( Desc, Desc.pPointLightColor ) != NULL ) == ( GetLightLodColors( Prev, Prev.pPointLightColor ) != NULL ) &&
+            ( GetLightLodColors( Desc, Desc.pSpotLightColor ) != NULL ) == ( GetLightLodColors( Prev, Prev.pSpotLightColor ) != NULL ) &&
+            m_bUseCoarseTiles == m_bPrevCullUseCoarseTiles;
+
+        // the pyramid is only compared through the depth buffer it was built from
+        bSameSetup = bSameSetup && ( Desc.pDepthPyramid == NULL || Desc.pDepthBuffer != NULL );
+
+        if( bSameSetup && Desc.pClusterConfig != NULL )
+        {
+            const ClusterConfig& Config = *Desc.pClusterConfig;
+            bSameSetup = Config.uNumSlices == m_PrevClusterConfig.uNumSlices &&
+                Config.uMaxNumLightsPerCluster == m_PrevClusterConfig.uMaxNumLightsPerCluster &&
+                Config.fNearZ == m_PrevClusterConfig.fNearZ &&
+                Config.fFarZ == m_PrevClusterConfig.fFarZ &&
+                Config.eSliceDistribution == m_PrevClusterConfig.eSliceDistribution;
+        }
+
+        return bSameSetup;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Mark the tiles whose depth is not the same as in the previous Cull, 
+    // and keep their new depth for the next one
+    //--------------------------------------------------------------------------------------
+    void CpuLightCuller::FindTilesWithChangedDepth( const CpuLightCullDesc& Desc )
+    {
+        if( Desc.pDepthBuffer == NULL )
+        {
+            return;
+        }
+
+        unsigned uPitch = ( Desc.uDepthBufferPitch == 0 ) ? Desc.uWindowWidth : Desc.uDepthBufferPitch;
+        unsigned uNumSamples = ( Desc.uDepthBufferNumSamples == 0 ) ? 1 : Desc.uDepthBufferNumSamples;
+        for( unsigned uTileY = 0; uTileY < m_uNumTilesY; uTileY++ )
+        {
+            unsigned uStartY = uTileY*m_uTileRes;
+            unsigned uEndY = ( uStartY + m_uTileRes < Desc.uWindowHeight ) ? uStartY + m_uTileRes : Desc.uWindowHeight;
+            for( unsigned uTileX = 0; uTileX < m_uNumTilesX; uTileX++ )
+            {
+                unsigned uStartX = uTileX*m_uTileRes;
+                unsigned uEndX = ( uStartX + m_uTileRes < Desc.uWindowWidth ) ? uStartX + m_uTileRes : Desc.uWindowWidth;
+                size_t uRowSize = ( uEndX - uStartX )*uNumSamples*sizeof(float);
+                for( unsigned y = uStartY; y < uEndY; y++ )
+                {
+                    size_t uOffset = ( (size_t)y*uPitch + uStartX )*uNumSamples;
+                    if( memcmp( &m_PrevDepthBuffer[uOffset], Desc.pDepthBuffer + uOffset, uRowSize ) != 0 )
+                    {
+                        m_TileNeedsCull[uTileY*m_uNumTilesX + uTileX] = 1;
+                        memcpy( &m_PrevDepthBuffer[uOffset], Desc.pDepthBuffer + uOffset, uRowSize );
+                    }
+                }
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Mark the tiles a changed light touched in the previous Cull, or touches now. Returns 
+    // true when so many lights changed that culling all the tiles is cheaper than finding them.
+    //--------------------------------------------------------------------------------------
+    bool CpuLightCuller::FindTilesWithChangedLights()
+    {
+        unsigned uNumChangedLights = (unsigned)( m_ChangedPointLights.size() + m_ChangedSpotLights.size() );
+        unsigned uNumLights = m_PointLightsView.uNumLights + m_SpotLightsView.uNumLights;
+        if( uNumChangedLights == 0 )
+        {
+            return false;
+        }
+        if( 4*uNumChangedLights > uNumLights )
+        {
+            return true;
+        }
+
+        // the lists that overflowed could get one of the lights they dropped, if a changed light left
+        for( unsigned uListIdx = 0; uListIdx < GetNumLists(); uListIdx++ )
+        {
+            if( m_ListNumLights[uListIdx] + 2 > m_uMaxNumLightsPerList )
+            {
+                m_TileNeedsCull[uListIdx / m_uNumClusterSlices] = 1;
+            }
+        }
+
+        // the tiles the changed lights touched before, or touch now, with the same sphere vs. 
+        // side planes test CullTile starts with (which passes every light that it goes on to 
+        // keep, or to count as rejected by its cone)
+        GatherChangedLights( m_ChangedPointLights, m_PointLightsView, m_PrevPointLights, m_PrevCullDesc.mWorldView, m_ChangedPointLightsView );
+        GatherChangedLights( m_ChangedSpotLights, m_SpotLightsView, m_PrevSpotLights, m_PrevCullDesc.mWorldView, m_ChangedSpotLightsView );
+
+        unsigned* pScratch = &m_ThreadScratch[0].TileLights[0];
+        for( unsigned uTileIdx = 0; uTileIdx < (unsigned)m_TileNeedsCull.size(); uTileIdx++ )
+        {
+            if( m_TileNeedsCull[uTileIdx] == 0 &&
+                ( m_pfnKernel( m_TileFrustums[uTileIdx], m_ChangedPointLightsView, pScratch ) > 0 ||
+                  m_pfnKernel( m_TileFrustums[uTileIdx], m_ChangedSpotLightsView, pScratch ) > 0 ) )
+            {
+                m_TileNeedsCull[uTileIdx] = 1;
+            }
+        }
+
+        return false;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Keep the inputs of this Cull, to compare the next one with
+    //--------------------------------------------------------------------------------------
+    void CpuLightCuller::SavePrevCullInputs( const CpuLightCullDesc& Desc )
+    {
+        bool bSameSetup = HasSameSetupAsPrevCull( Desc );
+
+        m_PrevCullDesc = Desc;
+        m_PrevClusterConfig = ( Desc.pClusterConfig != NULL ) ? *Desc.pClusterConfig : m_PrevClusterConfig;
+        m_bPrevCullUseCoarseTiles = m_bUseCoarseTiles;
+
+        m_PrevPointLights.assign( Desc.pPointLightCenterAndRadius, Desc.pPointLightCenterAndRadius + Desc.uNumPointLights );
+        m_PrevSpotLights.assign( Desc.pSpotLightCenterAndRadius, Desc.pSpotLightCenterAndRadius + Desc.uNumSpotLights );
+        if( Desc.pSpotLightSpotParams != NULL )
+        {
+            m_PrevSpotParams.assign( Desc.pSpotLightSpotParams, Desc.pSpotLightSpotParams + Desc.uNumSpotLights );
+        }
+        else
+        {
+            m_PrevSpotParams.clear();
+        }
+
+        const unsigned* pPointLightLodColors = GetLightLodColors( Desc, Desc.pPointLightColor );
+        const unsigned* pSpotLightLodColors = GetLightLodColors( Desc, ( Desc.pSpotLightSpotParams != NULL ) ? Desc.pSpotLightColor : NULL );
+        m_PrevPointLightColors.assign( pPointLightLodColors, pPointLightLodColors + ( ( pPointLightLodColors != NULL ) ? Desc.uNumPointLights : 0 ) );
+        m_PrevSpotLightColors.assign( pSpotLightLodColors, pSpotLightLodColors + ( ( pSpotLightLodColors != NULL ) ? Desc.uNumSpotLights : 0 ) );
+
+        // with the same setup, FindTilesWithChangedDepth already copied the tiles that changed
+        if( !bSameSetup && Desc.pDepthBuffer != NULL )
+        {
+            unsigned uPitch = ( Desc.uDepthBufferPitch == 0 ) ? Desc.uWindowWidth : Desc.uDepthBufferPitch;
+            unsigned uNumSamples = ( Desc.uDepthBufferNumSamples == 0 ) ? 1 : Desc.uDepthBufferNumSamples;
+            size_t uSize = ( (size_t)( Desc.uWindowHeight - 1 )*uPitch + Desc.uWindowWidth )*uNumSamples;
+            m_PrevDepthBuffer.assign( Desc.pDepthBuffer, Desc.pDepthBuffer + uSize );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Statistics on the length of the lists
+    //--------------------------------------------------------------------------------------
+    void CpuLightCuller::GetLightCullStats( LightCullStats* pStats ) const
+    {
+        std::vector<unsigned> StatsBuffer( LIGHT_CULL_STATS_BUFFER_SIZE, 0 );
+        for( unsigned uListIdx = 0; uListIdx < (unsigned)m_ListNumLights.size(); uListIdx++ )
+        {
+            unsigned uNumLights = m_ListNumLights[uListIdx];
+            AccumulateLightCullStats( &StatsBuffer[0], uNumLights, uNumLights + 2 > m_uMaxNumLightsPerList );
+        }
+        for( unsigned uTileIdx = 0; uTileIdx < (unsigned)m_TileNumSpotConeRejections.size(); uTileIdx++ )
+        {
+            StatsBuffer[LIGHT_CULL_STATS_SPOT_CONE_OFFSET] += m_TileNumSpotConeRejections[uTileIdx];
+        }
+        for( unsigned uTileIdx = 0; uTileIdx < (unsigned)m_TileClasses.size(); uTileIdx++ )
+        {
+            StatsBuffer[LIGHT_CULL_STATS_TILE_CLASS_OFFSET + m_TileClasses[uTileIdx]]++;
+        }
+
+        CalculateLightCullStats( &StatsBuffer[0], pStats );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Number of lights the light LOD dropped from the lists
+    //--------------------------------------------------------------------------------------
+    unsigned CpuLightCuller::GetNumLightLodRejections() const
+    {
+        unsigned uNumRejections = 0;
+        for( unsigned uTileIdx = 0; uTileIdx < (unsigned)m_TileNumLightLodRejections.size(); uTileIdx++ )
+        {
+            uNumRejections += m_TileNumLightLodRejections[uTileIdx];
+        }
+        return uNumRejections;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Number of lights that passed a coarse tile
+    //--------------------------------------------------------------------------------------
+    unsigned CpuLightCuller::GetNumLightsInCoarseTile( unsigned uCoarseTileIdx ) const
+    {
+        assert( uCoarseTileIdx < (unsigned)m_CoarseTiles.size() );
+        const CoarseTile& Tile = m_CoarseTiles[uCoarseTileIdx];
+        return (unsigned)( Tile.PointLights.size() + Tile.SpotLights.size() );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Number of point lights in a list
+    //--------------------------------------------------------------------------------------
+    unsigned CpuLightCuller::GetNumPointLightsInTile( unsigned uListIdx ) const
+    {
+        const unsigned* pList = GetPointLightsInTile( uListIdx );
+        unsigned uCount = 0;
+        while( pList[uCount] != LIGHT_INDEX_BUFFER_SENTINEL )
+        {
+            uCount++;
+        }
+        return uCount;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Number of spot lights in a list
+    //--------------------------------------------------------------------------------------
+    unsigned CpuLightCuller::GetNumSpotLightsInTile( unsigned uListIdx ) const
+    {
+        const unsigned* pList = GetSpotLightsInTile( uListIdx );
+        unsigned uCount = 0;
+        while( pList[uCount] != LIGHT_INDEX_BUFFER_SENTINEL )
+        {
+            uCount++;
+        }
+        return uCount;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Start of the point lights in a list
+    //--------------------------------------------------------------------------------------
+    const unsigned* CpuLightCuller::GetPointLightsInTile( unsigned uListIdx ) const
+    {
+        assert( uListIdx < GetNumLists() );
+        return &m_LightIndexBuffer[m_uMaxNumLightsPerList*uListIdx];
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Start of the spot lights in a list (i.e. just past the first sentinel)
+    //--------------------------------------------------------------------------------------
+    const unsigned* CpuLightCuller::GetSpotLightsInTile( unsigned uListIdx ) const
+    {
+        return GetPointLightsInTile( uListIdx ) + GetNumPointLightsInTile( uListIdx ) + 1;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Pack the lists into the compact layout
+    //--------------------------------------------------------------------------------------
+    unsigned CpuLightCuller::BuildCompactLightIndexBuffer( unsigned uNumElements, std::vector<unsigned>& Buffer ) const
+    {
+        unsigned uNumLists = GetNumLists();
+        unsigned uDataOffset = GetCompactListDataOffset( uNumLists );
+        assert( uNumElements >= uDataOffset );
+
+        Buffer.assign( uNumElements, 0 );
+        Buffer[COMPACT_LIST_EMPTY_LIST_OFFSET] = LIGHT_INDEX_BUFFER_SENTINEL;
+        Buffer[COMPACT_LIST_EMPTY_LIST_OFFSET + 1] = LIGHT_INDEX_BUFFER_SENTINEL;
+
+        // the counter ends up the same as on the GPU: everything that was asked for,
+        // including what did not fit
+        unsigned uNumEntriesAllocated = 0;
+        unsigned uNumOverflowedLists = 0;
+        for( unsigned uListIdx = 0; uListIdx < uNumLists; uListIdx++ )
+        {
+            unsigned uNumPointLights = GetNumPointLightsInTile( uListIdx );
+            unsigned uNumSpotLights = GetNumSpotLightsInTile( uListIdx );
+            unsigned uNumEntries = uNumPointLights + uNumSpotLights + 2;
+            unsigned uOffset = uDataOffset + uNumEntriesAllocated;
+            uNumEntriesAllocated += uNumEntries;
+
+            unsigned* pHeader = &Buffer[COMPACT_LIST_HEADER_OFFSET + COMPACT_LIST_HEADER_SIZE*uListIdx];
+            if( uOffset + uNumEntries > uNumElements )
+            {
+                pHeader[0] = COMPACT_LIST_EMPTY_LIST_OFFSET;
+                pHeader[1] = 0;
+                uNumOverflowedLists++;
+                continue;
+            }
+
+            pHeader[0] = uOffset;
+            pHeader[1] = PackCompactListCounts( uNumPointLights, uNumSpotLights );
+
+            // the fixed-slot list already has the sentinels in the right places
+            const unsigned* pList = GetPointLightsInTile( uListIdx );
+            memcpy( &Buffer[uOffset], pList, uNumEntries*sizeof(unsigned) );
+        }
+
+        Buffer[COMPACT_LIST_COUNTER_OFFSET] = uNumEntriesAllocated;
+        return uNumOverflowedLists;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Pack the lists into the compact layout, with one copy of each distinct list
+    //--------------------------------------------------------------------------------------
+    unsigned CpuLightCuller::BuildSharedLightIndexBuffer( unsigned uNumElements, std::vector<unsigned>& Buffer, unsigned* pNumSharedLists ) const
+    {
+        unsigned uNumLists = GetNumLists();
+        unsigned uDataOffset = GetCompactListDataOffset( uNumLists );
+        assert( uNumElements >= uDataOffset );
+
+        Buffer.assign( uNumElements, 0 );
+        Buffer[COMPACT_LIST_EMPTY_LIST_OFFSET] = LIGHT_INDEX_BUFFER_SENTINEL;
+        Buffer[COMPACT_LIST_EMPTY_LIST_OFFSET + 1] = LIGHT_INDEX_BUFFER_SENTINEL;
+
+        // the lists packed so far, by hash (open addressing, at most half full),
+        // as list index + 1, so that 0 is a free slot
+        unsigned uTableSize = 1;
+        while( uTableSize < 2*uNumLists )
+        {
+            uTableSize *= 2;
+        }
+        std::vector<unsigned> HashTable( uTableSize, 0 );
+
+        // unlike BuildCompactLightIndexBuffer, the counter only counts the entries of the 
+        // lists that were packed (the copies that are shared are only counted once)
+        unsigned uNumEntriesAllocated = 0;
+        unsigned uNumOverflowedLists = 0;
+        unsigned uNumSharedLists = 0;
+        for( unsigned uListIdx = 0; uListIdx < uNumLists; uListIdx++ )
+        {
+            unsigned uNumPointLights = GetNumPointLightsInTile( uListIdx );
+            unsigned uNumSpotLights = GetNumSpotLightsInTile( uListIdx );
+            unsigned uNumEntries = uNumPointLights + uNumSpotLights + 2;
+            const unsigned* pList = GetPointLightsInTile( uListIdx );
+
+            unsigned* pHeader = &Buffer[COMPACT_LIST_HEADER_OFFSET + COMPACT_LIST_HEADER_SIZE*uListIdx];
+            pHeader[1] = PackCompactListCounts( uNumPointLights, uNumSpotLights );
+
+            // every empty list is the same as the one that is always there
+            if( uNumEntries == 2 )
+            {
+                pHeader[0] = COMPACT_LIST_EMPTY_LIST_OFFSET;
+                uNumSharedLists++;
+                continue;
+            }
+
+            // the lists are in ascending order, so the same lights make the same entries
+            unsigned uSlot = HashLightList( pList, uNumEntries ) & ( uTableSize - 1 );
+            bool bFound = false;
+            while( HashTable[uSlot] != 0 )
+            {
+                unsigned uOtherListIdx = HashTable[uSlot] - 1;
+                const unsigned* pOtherHeader = &Buffer[COMPACT_LIST_HEADER_OFFSET + COMPACT_LIST_HEADER_SIZE*uOtherListIdx];
+                if( pOtherHeader[1] == pHeader[1] && memcmp( &Buffer[pOtherHeader[0]], pList, uNumEntries*sizeof(unsigned) ) == 0 )
+                {
+                    pHeader[0] = pOtherHeader[0];
+                    bFound = true;
+                    break;
+                }
+                uSlot = ( uSlot + 1 ) & ( uTableSize - 1 );
+            }
+            if( bFound )
+            {
+                uNumSharedLists++;
+                continue;
+            }
+
+            unsigned uOffset = uDataOffset + uNumEntriesAllocated;
+            uNumEntriesAllocated += uNumEntries;
+            if( uOffset + uNumEntries > uNumElements )
+            {
+                pHeader[0] = COMPACT_LIST_EMPTY_LIST_OFFSET;
+                pHeader[1] = 0;
+                uNumOverflowedLists++;
+                continue;
+            }
+
+            // the fixed-slot list already has the sentinels in the right places
+            pHeader[0] = uOffset;
+            memcpy( &Buffer[uOffset], pList, uNumEntries*sizeof(unsigned) );
+            HashTable[uSlot] = uListIdx + 1;
+        }
+
+        Buffer[COMPACT_LIST_COUNTER_OFFSET] = uNumEntriesAllocated;
+        if( pNumSharedLists != NULL )
+        {
+            *pNumSharedLists = uNumSharedLists;
+        }
+        return uNumOverflowedLists;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Recalculate the side planes of all tiles, if the projection or window size changed
+    //--------------------------------------------------------------------------------------
+    void CpuLightCuller::UpdateTileFrustums( const CpuLightCullDesc& Desc )
+    {
+        unsigned uNumTiles = m_uNumTilesX*m_uNumTilesY;
+        if( m_TileFrustums.size() == uNumTiles &&
+            m_uTileFrustumsTileRes == m_uTileRes &&
+            m_uTileFrustumsWindowWidth == Desc.uWindowWidth &&
+            m_uTileFrustumsWindowHeight == Desc.uWindowHeight &&
+            memcmp( &m_mTileFrustumsProjectionInv, &Desc.mProjectionInv, sizeof(XMFLOAT4X4) ) == 0 )
+        {
+            return;
+        }
+
+        m_TileFrustums.resize( uNumTiles );
+        for( unsigned uTileY = 0; uTileY < m_uNumTilesY; uTileY++ )
+        {
+            for( unsigned uTileX = 0; uTileX < m_uNumTilesX; uTileX++ )
+            {
+                CalculateTileFrustum( Desc, uTileX, uTileY, &m_TileFrustums[uTileY*m_uNumTilesX + uTileX] );
+            }
+        }
+
+        // The coarse tiles are the union of their tiles, so they are calculated on the same 
+        // grid (the window size rounded up to the tile size), and they stop where it does.
+        // There are few enough of them to always have them ready.
+        unsigned uGridWidth = m_uTileRes*m_uNumTilesX;
+        unsigned uGridHeight = m_uTileRes*m_uNumTilesY;
+        unsigned uNumCoarseTilesX = ( uGridWidth + COARSE_TILE_RES - 1 ) / COARSE_TILE_RES;
+        unsigned uNumCoarseTilesY = ( uGridHeight + COARSE_TILE_RES - 1 ) / COARSE_TILE_RES;
+        m_CoarseTileFrustums.resize( uNumCoarseTilesX*uNumCoarseTilesY );
+        for( unsigned uCoarseTileY = 0; uCoarseTileY < uNumCoarseTilesY; uCoarseTileY++ )
+        {
+            for( unsigned uCoarseTileX = 0; uCoarseTileX < uNumCoarseTilesX; uCoarseTileX++ )
+            {
+                unsigned pxp = COARSE_TILE_RES*(uCoarseTileX+1);
+                unsigned pyp = COARSE_TILE_RES*(uCoarseTileY+1);
+                CalculateFrustum( Desc, COARSE_TILE_RES*uCoarseTileX, COARSE_TILE_RES*uCoarseTileY,
+                    ( pxp < uGridWidth ) ? pxp : uGridWidth, ( pyp < uGridHeight ) ? pyp : uGridHeight,
+                    &m_CoarseTileFrustums[uCoarseTileY*uNumCoarseTilesX + uCoarseTileX] );
+            }
+        }
+
+        m_uTileFrustumsTileRes = m_uTileRes;
+        m_uTileFrustumsWindowWidth = Desc.uWindowWidth;
+        m_uTileFrustumsWindowHeight = Desc.uWindowHeight;
+        m_mTileFrustumsProjectionInv = Desc.mProjectionInv;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Construct the four side planes of the frustum for a tile, exactly as CullLightsCS does
+    //--------------------------------------------------------------------------------------
+    void CpuLightCuller::CalculateTileFrustum( const CpuLightCullDesc& Desc, unsigned uTileX, unsigned uTileY, CpuCullTileFrustum* pFrustum ) const
+    {
+        CalculateFrustum( Desc, m_uTileRes*uTileX, m_uTileRes*uTileY, m_uTileRes*(uTileX+1), m_uTileRes*(uTileY+1), pFrustum );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Same, for any rectangle of pixels on the tile grid, like CalculateFrustum
+    //--------------------------------------------------------------------------------------
+    void CpuLightCuller::CalculateFrustum( const CpuLightCullDesc& Desc, unsigned pxm, unsigned pym, unsigned pxp, unsigned pyp, CpuCullTileFrustum* pFrustum ) const
+    {
+        unsigned uWindowWidthEvenlyDivisibleByTileRes = m_uTileRes*m_uNumTilesX;
+        unsigned uWindowHeightEvenlyDivisibleByTileRes = m_uTileRes*m_uNumTilesY;
+
+        float fXM = pxm/(float)uWindowWidthEvenlyDivisibleByTileRes*2.f-1.f;
+        float fXP = pxp/(float)uWindowWidthEvenlyDivisibleByTileRes*2.f-1.f;
+        float fYM = (uWindowHeightEvenlyDivisibleByTileRes-pym)/(float)uWindowHeightEvenlyDivisibleByTileRes*2.f-1.f;
+        float fYP = (uWindowHeightEvenlyDivisibleByTileRes-pyp)/(float)uWindowHeightEvenlyDivisibleByTileRes*2.f-1.f;
+
+        // four corners of the tile, clockwise from top-left
+        XMFLOAT3 Frustum0 = ConvertProjToView( fXM, fYM, 1.f, 1.f, Desc.mProjectionInv );
+        XMFLOAT3 Frustum1 = ConvertProjToView( fXP, fYM, 1.f, 1.f, Desc.mProjectionInv );
+        XMFLOAT3 Frustum2 = ConvertProjToView( fXP, fYP, 1.f, 1.f, Desc.mProjectionInv );
+        XMFLOAT3 Frustum3 = ConvertProjToView( fXM, fYP, 1.f, 1.f, Desc.mProjectionInv );
+
+        // create plane equations for the four sides of the frustum,
+        // with the positive half-space outside the frustum (and remember,
+        // view space is left handed, so use the left-hand rule to determine
+        // cross product direction)
+        XMFLOAT3 FrustumEqn[4];
+        FrustumEqn[0] = CreatePlaneEquation( Frustum0, Frustum1 );
+        FrustumEqn[1] = CreatePlaneEquation( Frustum1, Frustum2 );
+        FrustumEqn[2] = CreatePlaneEquation( Frustum2, Frustum3 );
+        FrustumEqn[3] = CreatePlaneEquation( Frustum3, Frustum0 );
+
+        for( int i = 0; i < 4; i++ )
+        {
+            pFrustum->fPlaneX[i] = FrustumEqn[i].x;
+            pFrustum->fPlaneY[i] = FrustumEqn[i].y;
+            pFrustum->fPlaneZ[i] = FrustumEqn[i].z;
+        }
+
+        // no depth bounds, just the near plane
+        pFrustum->fMinZ = 0.f;
+        pFrustum->fMaxZ = FLT_MAX;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Cull all lights against one coarse tile, like CullLightsCoarseCS, and gather the ones
+    // that passed for its tiles. Its depth bounds are those of all its pixels, which is the
+    // level of the depth pyramid with a texel per COARSE_TILE_RES pixels.
+    //--------------------------------------------------------------------------------------
+    void CpuLightCuller::CullCoarseTile( const CpuLightCullDesc& Desc, unsigned uCoarseTileIdx, ThreadScratch& Scratch )
+    {
+        unsigned uCoarseTileX = uCoarseTileIdx % m_uNumCoarseTilesX;
+        unsigned uCoarseTileY = uCoarseTileIdx / m_uNumCoarseTilesX;
+
+        CpuCullTileFrustum Frustum = m_CoarseTileFrustums[uCoarseTileIdx];
+        if( Desc.pDepthPyramid != NULL )
+        {
+            GetTileMinMaxDepthFromPyramid( Desc, COARSE_TILE_RES, uCoarseTileX, uCoarseTileY, &Frustum.fMinZ, &Frustum.fMaxZ );
+        }
+        else if( Desc.pDepthBuffer != NULL )
+        {
+            CalculateTileMinMaxDepth<COARSE_TILE_RES>( Desc, uCoarseTileX, uCoarseTileY, &Frustum.fMinZ, &Frustum.fMaxZ );
+        }
+
+        unsigned* pLights = &Scratch.TileLights[0];
+        unsigned uNumPointLights, uNumSpotLights;
+        if( m_bUseLightBvh )
+        {
+            uNumPointLights = m_PointLightBvh.Cull( Frustum, m_pfnRangeKernel, pLights );
+            uNumSpotLights = m_SpotLightBvh.Cull( Frustum, m_pfnRangeKernel, pLights + uNumPointLights );
+        }
+        else
+        {
+            uNumPointLights = m_pfnKernel( Frustum, m_PointLightsCoarse, pLights );
+            uNumSpotLights = m_pfnKernel( Frustum, m_SpotLightsCoarse, pLights + uNumPointLights );
+        }
+
+        // the tiles test these with their real radii
+        CoarseTile& Tile = m_CoarseTiles[uCoarseTileIdx];
+        Tile.PointLights.assign( pLights, pLights + uNumPointLights );
+        Tile.PointCandidates.Resize( uNumPointLights );
+        for( unsigned i = 0; i < uNumPointLights; i++ )
+        {
+            unsigned uLightIdx = pLights[i];
+            Tile.PointCandidates.Set( i, m_PointLightsView.X[uLightIdx], m_PointLightsView.Y[uLightIdx], m_PointLightsView.Z[uLightIdx], m_PointLightsView.R[uLightIdx] );
+        }
+
+        const unsigned* pSpotLights = pLights + uNumPointLights;
+        Tile.SpotLights.assign( pSpotLights, pSpotLights + uNumSpotLights );
+        Tile.SpotCandidates.Resize( uNumSpotLights );
+        for( unsigned i = 0; i < uNumSpotLights; i++ )
+        {
+            unsigned uLightIdx = pSpotLights[i];
+            Tile.SpotCandidates.Set( i, m_SpotLightsView.X[uLightIdx], m_SpotLightsView.Y[uLightIdx], m_SpotLightsView.Z[uLightIdx], m_SpotLightsView.R[uLightIdx] );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Cull all lights against one tile and write its list(s) to the light index buffer
+    //--------------------------------------------------------------------------------------
+    void CpuLightCuller::CullTile( const CpuLightCullDesc& Desc, unsigned uTileIdx, ThreadScratch& Scratch )
+    {
+        unsigned uTileX = uTileIdx % m_uNumTilesX;
+        unsigned uTileY = uTileIdx / m_uNumTilesX;
+
+        CpuCullTileFrustum Frustum = m_TileFrustums[uTileIdx];
+
+        // calculate the min and max depth for this tile,
+        // to form the front and back of the frustum
+        if( Desc.pDepthPyramid != NULL )
+        {
+            GetTileMinMaxDepthFromPyramid( Desc, m_uTileRes, uTileX, uTileY, &Frustum.fMinZ, &Frustum.fMaxZ );
+        }
+        else if( Desc.pDepthBuffer != NULL )
+        {
+            m_pfnTileMinMaxDepth( Desc, uTileX, uTileY, &Frustum.fMinZ, &Frustum.fMaxZ );
+        }
+        TileClass eTileClass = ClassifyTile( Frustum.fMinZ, Frustum.fMaxZ );
+        m_TileClasses[uTileIdx] = (unsigned char)eTileClass;
+
+        // loop over the lights and do a sphere vs. frustum intersection test,
+        // point lights first, then spot lights (or walk the BVHs, which does
+        // the same test, but only for the lights in the leaves that overlap the tile)
+        unsigned* pTileLights = &Scratch.TileLights[0];
+        unsigned uNumPointLightsInThisTile, uNumSpotLightsInThisTile;
+        if( eTileClass == TILE_CLASS_EMPTY )
+        {
+            // nothing to light (the depth test would reject every light anyway)
+            uNumPointLightsInThisTile = 0;
+            uNumSpotLightsInThisTile = 0;
+        }
+        else if( !m_CoarseTiles.empty() )
+        {
+            // only the lights of the coarse tile, mapped back to light indices
+            unsigned uTilesPerCoarseTile = COARSE_TILE_RES / m_uTileRes;
+            const CoarseTile& Parent = m_CoarseTiles[( uTileY / uTilesPerCoarseTile )*m_uNumCoarseTilesX + uTileX / uTilesPerCoarseTile];
+            uNumPointLightsInThisTile = m_pfnKernel( Frustum, Parent.PointCandidates, pTileLights );
+            for( unsigned i = 0; i < uNumPointLightsInThisTile; i++ )
+            {
+                pTileLights[i] = Parent.PointLights[pTileLights[i]];
+            }
+
+            unsigned* pTileSpotLights = pTileLights + uNumPointLightsInThisTile;
+            uNumSpotLightsInThisTile = m_pfnKernel( Frustum, Parent.SpotCandidates, pTileSpotLights );
+            for( unsigned j = 0; j < uNumSpotLightsInThisTile; j++ )
+            {
+                pTileSpotLights[j] = Parent.SpotLights[pTileSpotLights[j]];
+            }
+        }
+        else if( m_bUseLightBvh )
+        {
+            uNumPointLightsInThisTile = m_PointLightBvh.Cull( Frustum, m_pfnRangeKernel, pTileLights );
+            uNumSpotLightsInThisTile = m_SpotLightBvh.Cull( Frustum, m_pfnRangeKernel, pTileLights + uNumPointLightsInThisTile );
+        }
+        else
+        {
+            uNumPointLightsInThisTile = m_pfnKernel( Frustum, m_PointLightsView, pTileLights );
+            uNumSpotLightsInThisTile = m_pfnKernel( Frustum, m_SpotLightsView, pTileLights + uNumPointLightsInThisTile );
+        }
+
+        // then reject the lights that fall into gaps between the surfaces in the tile
+        // (the GPU does both tests before adding a light, but the result is the same),
+        // in the tiles that have gaps worth looking for
+        if( Desc.bUseDepthMask && Desc.pDepthBuffer != NULL && Desc.pClusterConfig == NULL && eTileClass == TILE_CLASS_COMPLEX )
+        {
+            float fDepthRange = Frustum.fMaxZ - Frustum.fMinZ;
+            float fInvCellSize = (float)DEPTH_MASK_NUM_CELLS / ( ( fDepthRange > 1e-6f ) ? fDepthRange : 1e-6f );
+            unsigned uDepthMask = m_pfnTileDepthMask( Desc, uTileX, uTileY, Frustum.fMinZ, fInvCellSize );
+
+            unsigned* pTileSpotLights = pTileLights + uNumPointLightsInThisTile;
+            uNumSpotLightsInThisTile = ApplyDepthMask( pTileSpotLights, uNumSpotLightsInThisTile, m_SpotLightsView, uDepthMask, Frustum.fMinZ, fInvCellSize );
+            uNumPointLightsInThisTile = ApplyDepthMask( pTileLights, uNumPointLightsInThisTile, m_PointLightsView, uDepthMask, Frustum.fMinZ, fInvCellSize );
+
+            // the spot lights move down to right after the remaining point lights
+            memmove( pTileLights + uNumPointLightsInThisTile, pTileSpotLights, uNumSpotLightsInThisTile*sizeof(unsigned) );
+        }
+
+        // and the spot lights whose bounding sphere passed, but whose cone does not
+        // (the GPU does this test last too, so it counts the same ones)
+        m_TileNumSpotConeRejections[uTileIdx] = 0;
+        if( !m_SpotConesView.empty() && Desc.pClusterConfig == NULL )
+        {
+            unsigned uNumSpotLightsKept = ApplySpotCones( pTileLights + uNumPointLightsInThisTile, uNumSpotLightsInThisTile, m_SpotConesView, Frustum );
+            m_TileNumSpotConeRejections[uTileIdx] = uNumSpotLightsInThisTile - uNumSpotLightsKept;
+            uNumSpotLightsInThisTile = uNumSpotLightsKept;
+        }
+
+        // and the lights that can not add enough to any of its pixels to be worth evaluating
+        // (after the cones, so that only lights that touch the tile go into the ambient)
+        m_TileNumLightLodRejections[uTileIdx] = 0;
+        m_TileAmbient[uTileIdx] = XMFLOAT3( 0.f, 0.f, 0.f );
+        if( !m_PointLightColors.empty() || !m_SpotLightColors.empty() )
+        {
+            XMFLOAT3* pAmbient = m_bMergeDroppedLights ? &m_TileAmbient[uTileIdx] : NULL;
+            unsigned* pTileSpotLights = pTileLights + uNumPointLightsInThisTile;
+            unsigned uNumSpotLightsKept = m_SpotLightColors.empty() ? uNumSpotLightsInThisTile :
+                ApplyLightLod( pTileSpotLights, uNumSpotLightsInThisTile, m_SpotLightFalloffsView, m_SpotLightColors, Frustum, Desc.fMinLightContribution, pAmbient );
+            unsigned uNumPointLightsKept = m_PointLightColors.empty() ? uNumPointLightsInThisTile :
+                ApplyLightLod( pTileLights, uNumPointLightsInThisTile, m_PointLightsView, m_PointLightColors, Frustum, Desc.fMinLightContribution, pAmbient );
+            m_TileNumLightLodRejections[uTileIdx] = ( uNumPointLightsInThisTile - uNumPointLightsKept ) + ( uNumSpotLightsInThisTile - uNumSpotLightsKept );
+            uNumPointLightsInThisTile = uNumPointLightsKept;
+            uNumSpotLightsInThisTile = uNumSpotLightsKept;
+
+            // the spot lights move down to right after the remaining point lights
+            memmove( pTileLights + uNumPointLightsInThisTile, pTileSpotLights, uNumSpotLightsInThisTile*sizeof(unsigned) );
+        }
+
+        if( Desc.pClusterConfig == NULL )
+        {
+            WriteLightList( uTileIdx, pTileLights, uNumPointLightsInThisTile, pTileLights + uNumPointLightsInThisTile, uNumSpotLightsInThisTile );
+        }
+        else
+        {
+            CullClustersInTile( *Desc.pClusterConfig, Frustum, uTileIdx, uNumPointLightsInThisTile, uNumSpotLightsInThisTile, Scratch );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Cull the lights of a tile against each of its clusters, like CullLightsClusteredCS.
+    // The GPU tests every light against every cluster, but a light can only touch a
+    // cluster if it touches the tile (same side planes, and the cluster's depth range
+    // is inside the tile's), so only the lights that survived the tile test are tested.
+    //--------------------------------------------------------------------------------------
+    void CpuLightCuller::CullClustersInTile( const ClusterConfig& Config, const CpuCullTileFrustum& TileFrustum, unsigned uTileIdx,
+                                             unsigned uNumPointLightsInTile, unsigned uNumSpotLightsInTile, ThreadScratch& Scratch )
+    {
+        const unsigned* pTilePointLights = &Scratch.TileLights[0];
+        const unsigned* pTileSpotLights = pTilePointLights + uNumPointLightsInTile;
+
+        // gather the tile's lights, so that the kernels can run on them
+        Scratch.PointCandidates.Resize( uNumPointLightsInTile );
+        for( unsigned i = 0; i < uNumPointLightsInTile; i++ )
+        {
+            unsigned uLightIdx = pTilePointLights[i];
+            Scratch.PointCandidates.Set( i, m_PointLightsView.X[uLightIdx], m_PointLightsView.Y[uLightIdx], m_PointLightsView.Z[uLightIdx], m_PointLightsView.R[uLightIdx] );
+        }
+
+        Scratch.SpotCandidates.Resize( uNumSpotLightsInTile );
+        for( unsigned i = 0; i < uNumSpotLightsInTile; i++ )
+        {
+            unsigned uLightIdx = pTileSpotLights[i];
+            Scratch.SpotCandidates.Set( i, m_SpotLightsView.X[uLightIdx], m_SpotLightsView.Y[uLightIdx], m_SpotLightsView.Z[uLightIdx], m_SpotLightsView.R[uLightIdx] );
+        }
+
+        unsigned* pClusterLights = &Scratch.ClusterLights[0];
+        for( unsigned uSlice = 0; uSlice < Config.uNumSlices; uSlice++ )
+        {
+            // the slice's depth range, clipped to the tile's depth bounds
+            // (clusters outside the depth bounds contain no pixels, so they stay empty)
+            CpuCullTileFrustum Frustum = TileFrustum;
+            float fSliceNearZ, fSliceFarZ;
+            GetClusterSliceBounds( Config, uSlice, &fSliceNearZ, &fSliceFarZ );
+            Frustum.fMinZ = ( fSliceNearZ > TileFrustum.fMinZ ) ? fSliceNearZ : TileFrustum.fMinZ;
+            Frustum.fMaxZ = ( fSliceFarZ < TileFrustum.fMaxZ ) ? fSliceFarZ : TileFrustum.fMaxZ;
+
+            unsigned uNumPointLightsInCluster = 0;
+            unsigned uNumSpotLightsInCluster = 0;
+            if( Frustum.fMinZ <= Frustum.fMaxZ )
+            {
+                uNumPointLightsInCluster = m_pfnKernel( Frustum, Scratch.PointCandidates, pClusterLights );
+                uNumSpotLightsInCluster = m_pfnKernel( Frustum, Scratch.SpotCandidates, pClusterLights + uNumPointLightsInCluster );
+            }
+
+            // map candidate indices back to light indices
+            for( unsigned i = 0; i < uNumPointLightsInCluster; i++ )
+            {
+                pClusterLights[i] = pTilePointLights[pClusterLights[i]];
+            }
+            for( unsigned j = uNumPointLightsInCluster; j < uNumPointLightsInCluster + uNumSpotLightsInCluster; j++ )
+            {
+                pClusterLights[j] = pTileSpotLights[pClusterLights[j]];
+            }
+
+            WriteLightList( GetClusterIndex( uTileIdx, uSlice ), pClusterLights, uNumPointLightsInCluster, pClusterLights + uNumPointLightsInCluster, uNumSpotLightsInCluster );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Write one list to the light index buffer
+    //--------------------------------------------------------------------------------------
+    void CpuLightCuller::WriteLightList( unsigned uListIdx, const unsigned* pPointLights, unsigned uNumPointLights, const unsigned* pSpotLights, unsigned uNumSpotLights )
+    {
+        // like the culling shaders, drop whatever does not fit rather than scribble 
+        // over the neighboring list, keeping both sentinels, and remember how long 
+        // the list should have been, for the statistics
+        m_ListNumLights[uListIdx] = uNumPointLights + uNumSpotLights;
+
+        unsigned uCapacity = m_uMaxNumLightsPerList - 2;
+        unsigned uNumPointLightsToWrite = ( uNumPointLights < uCapacity ) ? uNumPointLights : uCapacity;
+        unsigned uNumSpotLightsToWrite = ( uNumSpotLights < uCapacity - uNumPointLightsToWrite ) ? uNumSpotLights : uCapacity - uNumPointLightsToWrite;
+
+        unsigned* pOut = &m_LightIndexBuffer[m_uMaxNumLightsPerList*uListIdx];
+        for( unsigned i = 0; i < uNumPointLightsToWrite; i++ )
+        {
+            *pOut++ = pPointLights[i];
+        }
+        *pOut++ = LIGHT_INDEX_BUFFER_SENTINEL;
+
+        for( unsigned j = 0; j < uNumSpotLightsToWrite; j++ )
+        {
+            *pOut++ = pSpotLights[j];
+        }
+        *pOut = LIGHT_INDEX_BUFFER_SENTINEL;
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
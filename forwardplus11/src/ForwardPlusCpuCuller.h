@@ -0,0 +1,472 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusCpuCuller.h
+//
+// CPU implementation of the tiled light culling done by CullLightsCS in
+// ForwardPlus11Tiling.hlsl. It has no dependencies on D3D or DXUT, so that it
+// can run headless (e.g. on machines without a GPU), and it produces the same
+// per-tile light index buffer layout as the compute shader, so that it can be
+// used as a reference when validating changes to the GPU culling.
+//
+// It also implements clustered culling (CullLightsClusteredCS), where every tile
+// is cut into depth slices and each slice gets its own list (see ForwardPlusClusters.h).
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ForwardPlusClusters.h"
+#include "ForwardPlusCompactLists.h"
+#include "ForwardPlusCpuCullKernels.h"
+#include "ForwardPlusHiZ.h"
+#include "ForwardPlusLightBvh.h"
+#include "ForwardPlusLightCullStats.h"
+#include "ForwardPlusLightLod.h"
+#include "ForwardPlusSpotCones.h"
+
+#include <DirectXMath.h>
+#include <vector>
+
+namespace ForwardPlus11
+{
+    // Light culling constants.
+    // These must match their counterparts in ForwardPlus11Common.hlsl
+    static const unsigned DEFAULT_TILE_RES = 16;            // TILE_RES, when a shader is compiled without it
+    static const unsigned MAX_NUM_LIGHTS_PER_TILE = 544;    // at DEFAULT_TILE_RES, see GetMaxNumLightsPerTileForTileRes
+    static const unsigned LIGHT_INDEX_BUFFER_SENTINEL = 0x7fffffff;
+
+    // The supported tile sizes are NUM_TILE_RES powers of two, from MIN_TILE_RES up
+    // (8x8, 16x16, 32x32 and 64x64 pixels). Each one has its own shader permutations
+    // (TILE_RES) and its own CPU depth kernels.
+    static const unsigned NUM_TILE_RES = 4;
+    static const unsigned MIN_TILE_RES = 8;
+
+    inline unsigned GetTileRes( unsigned uTileResIdx )
+    {
+        return MIN_TILE_RES << uTileResIdx;
+    }
+
+    // Returns NUM_TILE_RES for unsupported tile sizes
+    inline unsigned GetTileResIndex( unsigned uTileRes )
+    {
+        unsigned uTileResIdx = 0;
+        while( uTileResIdx < NUM_TILE_RES && GetTileRes( uTileResIdx ) != uTileRes )
+        {
+            uTileResIdx++;
+        }
+        return uTileResIdx;
+    }
+
+    // Length of ldsLightIdx in CullLightsCS (MAX_NUM_LIGHTS_PER_TILE in the shader) for a 
+    // tile size. It grows with the width of the tile rather than its area, since lights 
+    // are about as big as a tile at the default size, and the bigger the tiles, the more 
+    // lights overlap several of them.
+    inline unsigned GetMaxNumLightsPerTileForTileRes( unsigned uTileRes )
+    {
+        return MAX_NUM_LIGHTS_PER_TILE*uTileRes/DEFAULT_TILE_RES;
+    }
+
+    // A first guess at how many lights a tile needs at a screen height, used until the
+    // first lists have been measured (see LightListCapacitySizer), so it errs on the
+    // generous side. This assumes that the demo has a constant vertical field of view
+    // (fovy), so that the taller the screen, the less of the scene a tile sees, and the
+    // fewer lights fall into it. It was tuned for this particular demo at up to 1080p,
+    // and is kept at the 1080p value above that (the lists only get shorter). Both the
+    // max and the adjustment scale with the tile size (they were tuned for 16x16 tiles).
+    inline unsigned GetInitialMaxNumLightsPerTile( unsigned uTileRes, unsigned uHeight )
+    {
+        const unsigned kAdjustmentMultiplier = 32*uTileRes/DEFAULT_TILE_RES;
+
+        // adjust max lights per tile down as height increases
+        unsigned uTunedHeight = ( uHeight > 1080 ) ? 1080 : uHeight;
+        return GetMaxNumLightsPerTileForTileRes( uTileRes ) - kAdjustmentMultiplier*( uTunedHeight/120 );
+    }
+
+    // Number of cells in the per-tile depth mask (one bit each, see USE_DEPTH_MASK)
+    static const unsigned DEPTH_MASK_NUM_CELLS = 32;
+
+    // Two-level culling (see USE_COARSE_TILES): the lights are first culled against 
+    // coarse tiles of COARSE_TILE_RES pixels, and each tile then only tests the lights 
+    // of the coarse tile it is in. The coarse lists on the GPU hold up to 
+    // MAX_NUM_LIGHTS_PER_COARSE_TILE lights (the tiles of a coarse tile that did not 
+    // fit test all lights instead).
+    static const unsigned COARSE_TILE_RES = 64;
+    static const unsigned MAX_NUM_LIGHTS_PER_COARSE_TILE = 34*COARSE_TILE_RES;
+
+    // The radius a light is tested with against a coarse tile. A coarse tile is the union 
+    // of its tiles, but the planes of its outer edges are calculated from different corners 
+    // than those of the tiles along them, so they can be off by a rounding error, and the 
+    // radius is grown by a bound on the error of the plane distance, so that a light that 
+    // touches a tile always passes its coarse tile, like GetCoarseTileTestRadius.
+    inline float GetCoarseTileTestRadius( float x, float y, float z, float r )
+    {
+        float fAbsSum = ( ( x < 0.f ) ? -x : x ) + ( ( y < 0.f ) ? -y : y ) + ( ( z < 0.f ) ? -z : z );
+        return r + 1e-4f*( fAbsSum + r );
+    }
+
+    // Tile classification, from the depth bounds of a tile, like ClassifyTile:
+    //   TILE_CLASS_EMPTY    no pixel was drawn (the depth is all cleared, e.g. sky), so no 
+    //                       light can touch the tile, and the light loops are skipped
+    //   TILE_CLASS_UNIFORM  the depth range is at most TILE_UNIFORM_DEPTH_RANGE of the 
+    //                       min depth (e.g. a single wall or floor), so there is no gap
+    //                       worth finding, and the depth mask is not built (all cells set)
+    //   TILE_CLASS_COMPLEX  everything else, the tiles that get the depth mask
+    // Without depth bounds, every tile is complex.
+    enum TileClass
+    {
+        TILE_CLASS_EMPTY = 0,
+        TILE_CLASS_UNIFORM,
+        TILE_CLASS_COMPLEX,
+        TILE_CLASS_COUNT
+    };
+    static const float TILE_UNIFORM_DEPTH_RANGE = 1.f/64.f;
+
+    inline TileClass ClassifyTile( float fMinZ, float fMaxZ )
+    {
+        if( fMinZ > fMaxZ )
+        {
+            return TILE_CLASS_EMPTY;
+        }
+        return ( fMaxZ - fMinZ <= TILE_UNIFORM_DEPTH_RANGE*fMinZ ) ? TILE_CLASS_UNIFORM : TILE_CLASS_COMPLEX;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Everything CullLightsCS reads, in CPU form.
+    //
+    // The matrices are the ones ForwardPlus11.cpp puts into the constant buffers,
+    // before they get transposed for HLSL (i.e. row vectors, DirectXMath convention).
+    //
+    // The depth buffer is optional. When pDepthBuffer is NULL, only the near plane
+    // is used (like USE_DEPTH_BOUNDS == 0). Otherwise it holds uWindowWidth*uWindowHeight
+    // pixels of inverted 32-bit float depth, in rows of uDepthBufferPitch floats, and
+    // with uDepthBufferNumSamples consecutive samples per pixel (1 for non-MSAA,
+    // like USE_DEPTH_BOUNDS == 1, more than 1 for MSAA, like USE_DEPTH_BOUNDS == 2).
+    //
+    // With bUseDepthMask (like USE_DEPTH_MASK == 1, tiled culling only), the depth
+    // bounds are split into DEPTH_MASK_NUM_CELLS cells, and lights whose depth extent
+    // only covers cells without any pixels in them are culled (in complex tiles only,
+    // see ClassifyTile). It needs pDepthBuffer.
+    //
+    // When pSpotLightSpotParams is not NULL (it then holds the packed parameters of 
+    // each spot light, like g_SpotLightBufferSpotParams), a spot light that passed a 
+    // tile with its bounding sphere must also pass it with its cone, like CullLightsCS 
+    // does when g_uCullSpotCones is set (tiled culling only, see ForwardPlusSpotCones.h).
+    //
+    // With fMinLightContribution above 0 (tiled culling only), a light that can not add 
+    // that much to any channel of any pixel of the tile is dropped from its list, like 
+    // CullLightsCS does with g_fMinLightContribution (see ForwardPlusLightLod.h). This 
+    // needs the light colors (packed like g_PointLightBufferColor), and for spot lights, 
+    // pSpotLightSpotParams. With bMergeDroppedLights, what the dropped lights would have 
+    // added is estimated and kept as an ambient term per tile (see GetTileAmbient).
+    //
+    // The tiles are uTileRes pixels square, one of the sizes GetTileRes returns.
+    //
+    // When pClusterConfig is NULL, there is one list per tile, of uMaxNumLightsPerTile
+    // entries. Otherwise there is one list per cluster, of uMaxNumLightsPerCluster
+    // entries, and uMaxNumLightsPerTile is not used.
+    //--------------------------------------------------------------------------------------
+    struct CpuLightCullDesc
+    {
+        const DirectX::XMFLOAT4*    pPointLightCenterAndRadius;
+        unsigned                    uNumPointLights;
+        const DirectX::XMFLOAT4*    pSpotLightCenterAndRadius;
+        unsigned                    uNumSpotLights;
+        const SpotParams*           pSpotLightSpotParams;       // NULL to cull spot lights by their bounding sphere only
+
+        DirectX::XMFLOAT4X4         mWorldView;
+        DirectX::XMFLOAT4X4         mProjectionInv;
+
+        unsigned                    uWindowWidth;
+        unsigned                    uWindowHeight;
+        unsigned                    uTileRes;                   // 0 means DEFAULT_TILE_RES
+        unsigned                    uMaxNumLightsPerTile;
+
+        const float*                pDepthBuffer;
+        unsigned                    uDepthBufferPitch;          // in pixels, 0 means uWindowWidth
+        unsigned                    uDepthBufferNumSamples;     // 0 means 1
+        bool                        bUseDepthMask;
+        const CpuDepthPyramid*      pDepthPyramid;              // if not NULL, the depth bounds come from here instead
+                                                                // of pDepthBuffer (the depth mask still needs pDepthBuffer)
+
+        const ClusterConfig*        pClusterConfig;             // NULL for tiled culling
+
+        const unsigned*             pPointLightColor;           // only needed for the light LOD
+        const unsigned*             pSpotLightColor;
+        float                       fMinLightContribution;      // 0 to keep every light that touches a tile
+        bool                        bMergeDroppedLights;
+    };
+
+    class CpuLightCuller
+    {
+    public:
+        // Constructor / destructor
+        CpuLightCuller();
+        ~CpuLightCuller();
+
+        // Number of worker threads used by Cull (0, the default, means one per hardware thread)
+        void SetNumThreads( unsigned uNumThreads ) { m_uNumThreads = uNumThreads; }
+        unsigned GetNumThreads() const { return m_uNumThreads; }
+
+        // Which sphere vs. tile kernel Cull uses (CPU_CULL_KERNEL_AUTO, the default, picks the
+        // fastest one the CPU supports). GetKernel returns the one that is actually used.
+        void SetKernel( CpuCullKernel eKernel ) { m_eKernel = ResolveCpuCullKernel( eKernel ); }
+        CpuCullKernel GetKernel() const { return m_eKernel; }
+
+        // Whether Cull builds a BVH over the lights (see ForwardPlusLightBvh.h) and walks it
+        // for every tile, instead of testing every light against every tile. The lists are
+        // the same either way, but the BVH is only faster with many lights (see the light
+        // BVH benchmark for where the crossover is). Off by default.
+        void SetUseLightBvh( bool bUseLightBvh ) { m_bUseLightBvh = bUseLightBvh; }
+        bool GetUseLightBvh() const { return m_bUseLightBvh; }
+
+        // Whether Cull first culls the lights against coarse tiles of COARSE_TILE_RES pixels,
+        // and then only tests each tile against the lights of its coarse tile. Every light
+        // that can touch a tile is in its list either way, but the side plane test passes
+        // some spheres that pass each plane of a tile without touching it (big lights near
+        // the camera), and a plane of the coarse tile can reject those, so the lists can be
+        // shorter (with depth bounds, they are almost always the same). It has no effect 
+        // with COARSE_TILE_RES tiles. With the BVH, the BVH is walked for the coarse tiles.
+        // Off by default.
+        void SetUseCoarseTiles( bool bUseCoarseTiles ) { m_bUseCoarseTiles = bUseCoarseTiles; }
+        bool GetUseCoarseTiles() const { return m_bUseCoarseTiles; }
+
+        // Whether Cull keeps the lists of the previous Cull where nothing that went into them
+        // changed. It compares its inputs with the previous ones: when the matrices, the window,
+        // the tile and list sizes, the cluster config or the options changed, all the tiles are
+        // culled again. Otherwise only the tiles whose depth changed, and the tiles that a changed
+        // light (one that moved, changed size, cone or color, or was added or removed) was in
+        // before or touches now, are culled again, and when nothing changed, nothing is. It keeps
+        // a copy of the lights and the depth buffer to compare with (and of the light colors, 
+        // with the light LOD). A depth pyramid is taken to be built
+        // from the depth buffer, so without a depth buffer it always culls everything. Off by default.
+        void SetUseTemporalReuse( bool bUseTemporalReuse ) { m_bUseTemporalReuse = bUseTemporalReuse; m_bPrevCullValid = false; }
+        bool GetUseTemporalReuse() const { return m_bUseTemporalReuse; }
+
+        // Cull all lights against all tiles. The results stay valid until the next call.
+        void Cull( const CpuLightCullDesc& Desc );
+
+        // How many tiles the last Cull culled, and how many it kept the lists of
+        // (all of them are culled without temporal reuse)
+        unsigned GetNumCulledTiles() const { return m_uNumCulledTiles; }
+        unsigned GetNumReusedTiles() const { return m_uNumReusedTiles; }
+
+        unsigned GetTileRes() const { return m_uTileRes; }
+        unsigned GetNumTilesX() const { return m_uNumTilesX; }
+        unsigned GetNumTilesY() const { return m_uNumTilesY; }
+        unsigned GetNumClusterSlices() const { return m_uNumClusterSlices; }   // 1 for tiled culling
+
+        // The coarse tiles of the last Cull (0 if it did not use them), and the number of 
+        // lights that passed one of them, i.e. how many its tiles tested
+        unsigned GetNumCoarseTilesX() const { return m_uNumCoarseTilesX; }
+        unsigned GetNumCoarseTilesY() const { return m_uNumCoarseTilesY; }
+        unsigned GetNumLightsInCoarseTile( unsigned uCoarseTileIdx ) const;
+
+        // A list per tile for tiled culling, a list per cluster for clustered culling
+        unsigned GetNumLists() const { return m_uNumTilesX*m_uNumTilesY*m_uNumClusterSlices; }
+        unsigned GetMaxNumLightsPerList() const { return m_uMaxNumLightsPerList; }
+        unsigned GetMaxNumLightsPerTile() const { return m_uMaxNumLightsPerList; }
+
+        // The clusters of a tile are consecutive, like CullLightsClusteredCS lays them out
+        unsigned GetClusterIndex( unsigned uTileIdx, unsigned uSlice ) const { return uTileIdx*m_uNumClusterSlices + uSlice; }
+
+        // The light index buffer, in the same layout as g_PerTileLightIndexBufferOut
+        // (as written by CullLightsCS or CullLightsClusteredCS): GetMaxNumLightsPerList() entries per list,
+        // holding the point light indices, a sentinel, the spot light indices, and another
+        // sentinel. Unlike the GPU, which appends with InterlockedAdd, indices are in
+        // ascending order within each list, so compare the GPU output against this as
+        // sets, not as sequences.
+        const unsigned* GetLightIndexBuffer() const { return m_LightIndexBuffer.empty() ? NULL : &m_LightIndexBuffer[0]; }
+        unsigned GetLightIndexBufferSize() const { return (unsigned)m_LightIndexBuffer.size(); }
+
+        // Convenience accessors for a single list. uListIdx is a tile
+        // index for tiled culling and a cluster index for clustered culling.
+        unsigned GetNumPointLightsInTile( unsigned uListIdx ) const;
+        unsigned GetNumSpotLightsInTile( unsigned uListIdx ) const;
+        const unsigned* GetPointLightsInTile( unsigned uListIdx ) const;
+        const unsigned* GetSpotLightsInTile( unsigned uListIdx ) const;
+
+        // Packs the lists into the compact layout (see ForwardPlusCompactLists.h), in a
+        // buffer of uNumElements entries. This is the two-pass version of what CullLightsCS
+        // does with USE_COMPACT_LIGHT_LISTS (count, prefix sum, copy), so the lists are in
+        // list order, while the GPU allocates with InterlockedAdd, so compare the two list
+        // by list. Returns the number of lists that did not fit (and got the empty list).
+        unsigned BuildCompactLightIndexBuffer( unsigned uNumElements, std::vector<unsigned>& Buffer ) const;
+
+        // Like BuildCompactLightIndexBuffer, but a list that is the same as one already in 
+        // the buffer (e.g. the neighbouring tiles under the same big lights) points at that 
+        // copy instead of getting its own, and every empty list points at the empty list. 
+        // The lists are hashed to find the ones that are the same. The headers are the same,
+        // so the shaders read this as they are. pNumSharedLists (if not NULL) gets the number
+        // of lists that point at a copy they share. Returns the number of lists that did not fit.
+        unsigned BuildSharedLightIndexBuffer( unsigned uNumElements, std::vector<unsigned>& Buffer, unsigned* pNumSharedLists ) const;
+
+        // Statistics on the length of the lists of the last Cull (see ForwardPlusLightCullStats.h),
+        // the same ones the culling shaders gather. Lists that did not fit GetMaxNumLightsPerList()
+        // were clamped (the point lights are kept first) and count as overflowed. The spot
+        // lights dropped because of their cones are the false positives of the sphere test.
+        void GetLightCullStats( LightCullStats* pStats ) const;
+
+        // The class of each tile in the last Cull (see ClassifyTile)
+        TileClass GetTileClass( unsigned uTileIdx ) const { return (TileClass)m_TileClasses[uTileIdx]; }
+
+        // The lights the light LOD dropped from the lists of the last Cull, and with 
+        // bMergeDroppedLights, the ambient color they add to each tile (NULL otherwise,
+        // ready for CpuShadingDesc::pTileAmbient)
+        unsigned GetNumLightLodRejections() const;
+        unsigned GetNumLightLodRejectionsInTile( unsigned uTileIdx ) const { return m_TileNumLightLodRejections[uTileIdx]; }
+        const DirectX::XMFLOAT3* GetTileAmbient() const { return ( m_bMergeDroppedLights && !m_TileAmbient.empty() ) ? &m_TileAmbient[0] : NULL; }
+
+    private:
+
+        // per-thread scratch memory
+        struct ThreadScratch
+        {
+            std::vector<unsigned>   TileLights;         // the CPU counterpart of ldsLightIdx
+            std::vector<unsigned>   ClusterLights;
+            CpuCullLightsSoA        PointCandidates;    // the lights in TileLights, for clustered culling
+            CpuCullLightsSoA        SpotCandidates;
+        };
+
+        // the lights that passed a coarse tile, as indices and gathered for the kernels
+        struct CoarseTile
+        {
+            std::vector<unsigned>   PointLights;
+            std::vector<unsigned>   SpotLights;
+            CpuCullLightsSoA        PointCandidates;
+            CpuCullLightsSoA        SpotCandidates;
+        };
+
+        // the depth kernels, specialized for each tile size (see ForwardPlusCpuCuller.cpp)
+        typedef void (*PFN_TILE_MIN_MAX_DEPTH)( const CpuLightCullDesc& Desc, unsigned uTileX, unsigned uTileY, float* pMinZ, float* pMaxZ );
+        typedef unsigned (*PFN_TILE_DEPTH_MASK)( const CpuLightCullDesc& Desc, unsigned uTileX, unsigned uTileY, float fMinZ, float fInvCellSize );
+
+        bool HasSameSetupAsPrevCull( const CpuLightCullDesc& Desc ) const;
+        void FindTilesWithChangedDepth( const CpuLightCullDesc& Desc );
+        bool FindTilesWithChangedLights();
+        void SavePrevCullInputs( const CpuLightCullDesc& Desc );
+        void UpdateTileFrustums( const CpuLightCullDesc& Desc );
+        void CalculateTileFrustum( const CpuLightCullDesc& Desc, unsigned uTileX, unsigned uTileY, CpuCullTileFrustum* pFrustum ) const;
+        void CalculateFrustum( const CpuLightCullDesc& Desc, unsigned pxm, unsigned pym, unsigned pxp, unsigned pyp, CpuCullTileFrustum* pFrustum ) const;
+        void CullCoarseTile( const CpuLightCullDesc& Desc, unsigned uCoarseTileIdx, ThreadScratch& Scratch );
+        void CullTile( const CpuLightCullDesc& Desc, unsigned uTileIdx, ThreadScratch& Scratch );
+        void CullClustersInTile( const ClusterConfig& Config, const CpuCullTileFrustum& TileFrustum, unsigned uTileIdx,
+                                 unsigned uNumPointLightsInTile, unsigned uNumSpotLightsInTile, ThreadScratch& Scratch );
+        void WriteLightList( unsigned uListIdx, const unsigned* pPointLights, unsigned uNumPointLights, const unsigned* pSpotLights, unsigned uNumSpotLights );
+
+        unsigned                    m_uNumThreads;
+        CpuCullKernel               m_eKernel;
+        PFN_CPU_CULL_KERNEL         m_pfnKernel;
+        PFN_CPU_CULL_RANGE_KERNEL   m_pfnRangeKernel;
+        bool                        m_bUseLightBvh;
+        bool                        m_bUseCoarseTiles;
+
+        unsigned                    m_uTileRes;
+        PFN_TILE_MIN_MAX_DEPTH      m_pfnTileMinMaxDepth;
+        PFN_TILE_DEPTH_MASK         m_pfnTileDepthMask;
+
+        unsigned                    m_uNumTilesX;
+        unsigned                    m_uNumTilesY;
+        unsigned                    m_uNumClusterSlices;
+        unsigned                    m_uMaxNumLightsPerList;
+
+        // the side planes of every tile only depend on the projection, the window
+        // size and the tile size, so they are only recalculated when one of those changes
+        std::vector<CpuCullTileFrustum> m_TileFrustums;
+        std::vector<CpuCullTileFrustum> m_CoarseTileFrustums;
+        DirectX::XMFLOAT4X4         m_mTileFrustumsProjectionInv;
+        unsigned                    m_uTileFrustumsTileRes;
+        unsigned                    m_uTileFrustumsWindowWidth;
+        unsigned                    m_uTileFrustumsWindowHeight;
+
+        // light bounding spheres transformed into view space,
+        // once per frame instead of once per tile like the GPU does
+        CpuCullLightsSoA            m_PointLightsView;
+        CpuCullLightsSoA            m_SpotLightsView;
+
+        // the cones of the spot lights in view space, when they are culled by their cones
+        std::vector<CpuCullSpotCone> m_SpotConesView;
+
+        // for the light LOD, the spheres the falloff of each spot light is 0 outside of 
+        // (the cone's apex and height, for point lights it is their bounding sphere), and 
+        // the light colors (empty when the light LOD is off)
+        CpuCullLightsSoA            m_SpotLightFalloffsView;
+        std::vector<DirectX::XMFLOAT3> m_PointLightColors;
+        std::vector<DirectX::XMFLOAT3> m_SpotLightColors;
+        bool                        m_bMergeDroppedLights;
+
+        // the same, with the radii grown for the coarse tiles (see GetCoarseTileTestRadius),
+        // and the lights that passed each coarse tile, when coarse tiles are used
+        CpuCullLightsSoA            m_PointLightsCoarse;
+        CpuCullLightsSoA            m_SpotLightsCoarse;
+        unsigned                    m_uNumCoarseTilesX;
+        unsigned                    m_uNumCoarseTilesY;
+        std::vector<CoarseTile>     m_CoarseTiles;
+
+        // rebuilt every frame from the above, when m_bUseLightBvh is set
+        CpuLightBvh                 m_PointLightBvh;
+        CpuLightBvh                 m_SpotLightBvh;
+
+        // temporal reuse: the inputs of the previous Cull (the pointers in m_PrevCullDesc 
+        // are only compared against NULL), the lights that changed since then (in view 
+        // space, for testing them against the tiles), and the tiles to cull this time
+        bool                        m_bUseTemporalReuse;
+        bool                        m_bPrevCullValid;
+        CpuLightCullDesc            m_PrevCullDesc;
+        ClusterConfig               m_PrevClusterConfig;
+        bool                        m_bPrevCullUseCoarseTiles;
+        std::vector<DirectX::XMFLOAT4> m_PrevPointLights;
+        std::vector<DirectX::XMFLOAT4> m_PrevSpotLights;
+        std::vector<SpotParams>     m_PrevSpotParams;
+        std::vector<unsigned>       m_PrevPointLightColors;
+        std::vector<unsigned>       m_PrevSpotLightColors;
+        std::vector<float>          m_PrevDepthBuffer;
+        std::vector<unsigned>       m_ChangedPointLights;
+        std::vector<unsigned>       m_ChangedSpotLights;
+        CpuCullLightsSoA            m_ChangedPointLightsView;
+        CpuCullLightsSoA            m_ChangedSpotLightsView;
+        std::vector<unsigned char>  m_TileNeedsCull;
+        std::vector<unsigned>       m_TilesToCull;
+        unsigned                    m_uNumCulledTiles;
+        unsigned                    m_uNumReusedTiles;
+
+        std::vector<ThreadScratch>  m_ThreadScratch;
+
+        // the output
+        std::vector<unsigned>       m_LightIndexBuffer;
+
+        // the number of lights in each list, before clamping, and the number of spot lights 
+        // each tile dropped because of their cones (for GetLightCullStats)
+        std::vector<unsigned>       m_ListNumLights;
+        std::vector<unsigned>       m_TileNumSpotConeRejections;
+        std::vector<unsigned char>  m_TileClasses;
+
+        // the lights each tile dropped because of the light LOD, and their ambient
+        std::vector<unsigned>       m_TileNumLightLodRejections;
+        std::vector<DirectX::XMFLOAT3> m_TileAmbient;
+    };
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
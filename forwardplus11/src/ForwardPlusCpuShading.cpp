@@ -0,0 +1,1076 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusCpuShading.cpp
+//
+// CPU implementation of the lighting done by RenderScenePS.
+//--------------------------------------------------------------------------------------
+
+#include "ForwardPlusCpuShading.h"
+#include "ForwardPlusCpuCuller.h"
+#include "ForwardPlusCpuCullKernels.h"
+#include "ForwardPlusParallel.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define CPU_SHADING_X86 1
+#include <immintrin.h>
+#else
+#define CPU_SHADING_X86 0
+#endif
+
+// MSVC lets any function use any intrinsic, GCC and clang
+// need to be told which functions may use which instruction sets
+#if CPU_SHADING_X86 && defined(__GNUC__)
+#define CPU_SHADING_TARGET_SSE2 __attribute__((target("sse2")))
+#define CPU_SHADING_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CPU_SHADING_TARGET_SSE2
+#define CPU_SHADING_TARGET_AVX2
+#endif
+
+using namespace DirectX;
+
+//-----------------------------------------------------------------------------------------
+// The lights and pixels, set up for the light loops
+//-----------------------------------------------------------------------------------------
+
+// The pixels of a tile are shaded in batches of up to this many (the widest kernel), 
+// so the per-tile arrays are padded to a multiple of it
+static const unsigned CPU_SHADING_BATCH_SIZE = 8;
+
+// the point lights, with their colors unpacked, in structure-of-arrays form
+struct ShadingPointLights
+{
+    std::vector<float>  CenterX, CenterY, CenterZ;
+    std::vector<float>  Radius;
+    std::vector<float>  InvRadius;
+    std::vector<float>  ColorR, ColorG, ColorB;
+};
+
+// the spot lights, with their apex, direction and cone unpacked the way RenderScenePS 
+// does it, in structure-of-arrays form
+struct ShadingSpotLights
+{
+    std::vector<float>  PositionX, PositionY, PositionZ;
+    std::vector<float>  DirX, DirY, DirZ;
+    std::vector<float>  CosineOfConeAngle;
+    std::vector<float>  InvOneMinusCosineOfConeAngle;
+    std::vector<float>  FalloffRadius;
+    std::vector<float>  InvFalloffRadius;
+    std::vector<float>  ColorR, ColorG, ColorB;
+};
+
+struct ShadingLights
+{
+    ShadingPointLights              PointLights;
+    ShadingSpotLights               SpotLights;
+
+    // when there are no per-tile lists, every pixel loops over all the lights, 
+    // which is the list of all point lights, a sentinel, all spot lights, and a sentinel
+    std::vector<unsigned>           AllLightsList;
+};
+
+// The shaded pixels of one tile (sky and discarded pixels are left out), in 
+// structure-of-arrays form: what the light loops read, what they accumulate, and 
+// what the rest of RenderScenePS needs afterwards
+struct ShadingTilePixels
+{
+    unsigned            uNumPixels;
+    unsigned            uNumPixelsPadded;
+    std::vector<float>  PositionX, PositionY, PositionZ;
+    std::vector<float>  NormalX, NormalY, NormalZ;         // from the normal map, in world space
+    std::vector<float>  ViewDirX, ViewDirY, ViewDirZ;
+    std::vector<float>  DiffuseR, DiffuseG, DiffuseB;
+    std::vector<float>  SpecularR, SpecularG, SpecularB;
+    std::vector<unsigned> PixelIndices;
+    std::vector<float>  SpecMask;
+
+    ShadingTilePixels() : uNumPixels(0), uNumPixelsPadded(0) {}
+
+    void Reserve( unsigned uMaxNumPixels )
+    {
+        std::vector<float>* Arrays[] = { &PositionX, &PositionY, &PositionZ, &NormalX, &NormalY, &NormalZ, &ViewDirX, &ViewDirY, &ViewDirZ,
+                                         &DiffuseR, &DiffuseG, &DiffuseB, &SpecularR, &SpecularG, &SpecularB, &SpecMask };
+        for( unsigned i = 0; i < sizeof(Arrays)/sizeof(Arrays[0]); i++ )
+        {
+            Arrays[i]->resize( uMaxNumPixels );
+        }
+        PixelIndices.resize( uMaxNumPixels );
+    }
+};
+
+// adds the uNumLights lights of pList to the pixels of a tile, for each kind of light
+typedef void (*PFN_SHADE_POINT_LIGHTS)( const ShadingPointLights& Lights, const unsigned* pList, unsigned uNumLights, ShadingTilePixels& Pixels );
+typedef void (*PFN_SHADE_SPOT_LIGHTS)( const ShadingSpotLights& Lights, const unsigned* pList, unsigned uNumLights, ShadingTilePixels& Pixels );
+
+//-----------------------------------------------------------------------------------------
+// Helper functions
+//-----------------------------------------------------------------------------------------
+
+// the same comparisons as _mm_max_ps and _mm_min_ps, so that the SIMD kernels match
+static inline float MaxScalar( float a, float b ) { return ( a > b ) ? a : b; }
+static inline float MinScalar( float a, float b ) { return ( a < b ) ? a : b; }
+static inline float SaturateScalar( float a ) { return MinScalar( MaxScalar( a, 0.f ), 1.f ); }
+
+// unpack a DXGI_FORMAT_R8G8B8A8_UNORM color
+static void UnpackColor( unsigned uColor, float* pR, float* pG, float* pB )
+{
+    *pR = (float)( uColor & 0xff ) / 255.f;
+    *pG = (float)( ( uColor >> 8 ) & 0xff ) / 255.f;
+    *pB = (float)( ( uColor >> 16 ) & 0xff ) / 255.f;
+}
+
+// normalize, as v*(1/sqrt(dot(v,v)))
+static void NormalizeScalar( float* pX, float* pY, float* pZ )
+{
+    float fInvLength = 1.f / sqrtf( (*pX)*(*pX) + (*pY)*(*pY) + (*pZ)*(*pZ) );
+    *pX *= fInvLength;
+    *pY *= fInvLength;
+    *pZ *= fInvLength;
+}
+
+// fake inverse squared falloff:
+// -(1/k)*(1-(k+1)/(1+k*x^2))
+// k=20: -(1/20)*(1 - 21/(1+20*x^2))
+static inline float GetFalloffScalar( float fLightDistance, float fRadius )
+{
+    float x = fLightDistance / fRadius;
+    return -0.05f + 1.05f/( 1.f + 20.f*x*x );
+}
+
+// pow( saturate( dot( normalize( vViewDir + vLightDir ), vNorm ) ), 8 )
+static inline float GetSpecularScalar( const ShadingTilePixels& Pixels, unsigned i, float fLightDirX, float fLightDirY, float fLightDirZ )
+{
+    float fHalfAngleX = Pixels.ViewDirX[i] + fLightDirX;
+    float fHalfAngleY = Pixels.ViewDirY[i] + fLightDirY;
+    float fHalfAngleZ = Pixels.ViewDirZ[i] + fLightDirZ;
+    NormalizeScalar( &fHalfAngleX, &fHalfAngleY, &fHalfAngleZ );
+    float fSpec = SaturateScalar( fHalfAngleX*Pixels.NormalX[i] + fHalfAngleY*Pixels.NormalY[i] + fHalfAngleZ*Pixels.NormalZ[i] );
+    fSpec *= fSpec;
+    fSpec *= fSpec;
+    return fSpec*fSpec;
+}
+
+//-----------------------------------------------------------------------------------------
+// Scalar kernels, one pixel at a time, the reference for the SIMD ones
+//-----------------------------------------------------------------------------------------
+static void ShadePointLightsScalar( const ShadingPointLights& Lights, const unsigned* pList, unsigned uNumLights, ShadingTilePixels& Pixels )
+{
+    for( unsigned uLight = 0; uLight < uNumLights; uLight++ )
+    {
+        unsigned uLightIdx = pList[uLight];
+        float fRadius = Lights.Radius[uLightIdx];
+        for( unsigned i = 0; i < Pixels.uNumPixels; i++ )
+        {
+            float fToLightX = Lights.CenterX[uLightIdx] - Pixels.PositionX[i];
+            float fToLightY = Lights.CenterY[uLightIdx] - Pixels.PositionY[i];
+            float fToLightZ = Lights.CenterZ[uLightIdx] - Pixels.PositionZ[i];
+            float fLightDistance = sqrtf( fToLightX*fToLightX + fToLightY*fToLightY + fToLightZ*fToLightZ );
+            if( fLightDistance < fRadius )
+            {
+                float fInvLightDistance = 1.f / fLightDistance;
+                float fLightDirX = fToLightX*fInvLightDistance;
+                float fLightDirY = fToLightY*fInvLightDistance;
+                float fLightDirZ = fToLightZ*fInvLightDistance;
+
+                float fFalloff = GetFalloffScalar( fLightDistance, fRadius );
+                float fDiffuse = SaturateScalar( fLightDirX*Pixels.NormalX[i] + fLightDirY*Pixels.NormalY[i] + fLightDirZ*Pixels.NormalZ[i] );
+                float fSpecular = GetSpecularScalar( Pixels, i, fLightDirX, fLightDirY, fLightDirZ );
+
+                Pixels.DiffuseR[i] += Lights.ColorR[uLightIdx]*fDiffuse*fFalloff;
+                Pixels.DiffuseG[i] += Lights.ColorG[uLightIdx]*fDiffuse*fFalloff;
+                Pixels.DiffuseB[i] += Lights.ColorB[uLightIdx]*fDiffuse*fFalloff;
+                Pixels.SpecularR[i] += Lights.ColorR[uLightIdx]*fSpecular*fFalloff;
+                Pixels.SpecularG[i] += Lights.ColorG[uLightIdx]*fSpecular*fFalloff;
+                Pixels.SpecularB[i] += Lights.ColorB[uLightIdx]*fSpecular*fFalloff;
+            }
+        }
+    }
+}
+
+static void ShadeSpotLightsScalar( const ShadingSpotLights& Lights, const unsigned* pList, unsigned uNumLights, ShadingTilePixels& Pixels )
+{
+    for( unsigned uLight = 0; uLight < uNumLights; uLight++ )
+    {
+        unsigned uLightIdx = pList[uLight];
+        float fCosineOfConeAngle = Lights.CosineOfConeAngle[uLightIdx];
+        float fFalloffRadius = Lights.FalloffRadius[uLightIdx];
+        for( unsigned i = 0; i < Pixels.uNumPixels; i++ )
+        {
+            float fToLightX = Lights.PositionX[uLightIdx] - Pixels.PositionX[i];
+            float fToLightY = Lights.PositionY[uLightIdx] - Pixels.PositionY[i];
+            float fToLightZ = Lights.PositionZ[uLightIdx] - Pixels.PositionZ[i];
+            float fLightDistance = sqrtf( fToLightX*fToLightX + fToLightY*fToLightY + fToLightZ*fToLightZ );
+            float fInvLightDistance = 1.f / fLightDistance;
+            float fLightDirX = fToLightX*fInvLightDistance;
+            float fLightDirY = fToLightY*fInvLightDistance;
+            float fLightDirZ = fToLightZ*fInvLightDistance;
+
+            // dot(-vToLightNormalized, SpotLightDir)
+            float fCosineOfCurrentConeAngle = -( fLightDirX*Lights.DirX[uLightIdx] + fLightDirY*Lights.DirY[uLightIdx] + fLightDirZ*Lights.DirZ[uLightIdx] );
+            if( fLightDistance < fFalloffRadius && fCosineOfCurrentConeAngle > fCosineOfConeAngle )
+            {
+                float fRadialAttenuation = ( fCosineOfCurrentConeAngle - fCosineOfConeAngle ) / ( 1.f - fCosineOfConeAngle );
+                fRadialAttenuation = fRadialAttenuation*fRadialAttenuation;
+
+                float fFalloff = GetFalloffScalar( fLightDistance, fFalloffRadius );
+                float fDiffuse = SaturateScalar( fLightDirX*Pixels.NormalX[i] + fLightDirY*Pixels.NormalY[i] + fLightDirZ*Pixels.NormalZ[i] );
+                float fSpecular = GetSpecularScalar( Pixels, i, fLightDirX, fLightDirY, fLightDirZ );
+
+                Pixels.DiffuseR[i] += Lights.ColorR[uLightIdx]*fDiffuse*fFalloff*fRadialAttenuation;
+                Pixels.DiffuseG[i] += Lights.ColorG[uLightIdx]*fDiffuse*fFalloff*fRadialAttenuation;
+                Pixels.DiffuseB[i] += Lights.ColorB[uLightIdx]*fDiffuse*fFalloff*fRadialAttenuation;
+                Pixels.SpecularR[i] += Lights.ColorR[uLightIdx]*fSpecular*fFalloff*fRadialAttenuation;
+                Pixels.SpecularG[i] += Lights.ColorG[uLightIdx]*fSpecular*fFalloff*fRadialAttenuation;
+                Pixels.SpecularB[i] += Lights.ColorB[uLightIdx]*fSpecular*fFalloff*fRadialAttenuation;
+            }
+        }
+    }
+}
+
+#if CPU_SHADING_X86
+
+//-----------------------------------------------------------------------------------------
+// SSE2 kernels, 4 pixels at a time. Every pixel computes every light, and the lights
+// that do not reach it add 0 (the scalar kernels skip the adds, which is the same).
+//-----------------------------------------------------------------------------------------
+CPU_SHADING_TARGET_SSE2
+static inline __m128 SaturateSSE2( __m128 a )
+{
+    return _mm_min_ps( _mm_max_ps( a, _mm_setzero_ps() ), _mm_set1_ps( 1.f ) );
+}
+
+CPU_SHADING_TARGET_SSE2
+static inline __m128 GetFalloffSSE2( __m128 vLightDistance, __m128 vRadius )
+{
+    __m128 x = _mm_div_ps( vLightDistance, vRadius );
+    __m128 vDenominator = _mm_add_ps( _mm_set1_ps( 1.f ), _mm_mul_ps( _mm_mul_ps( _mm_set1_ps( 20.f ), x ), x ) );
+    return _mm_add_ps( _mm_set1_ps( -0.05f ), _mm_div_ps( _mm_set1_ps( 1.05f ), vDenominator ) );
+}
+
+CPU_SHADING_TARGET_SSE2
+static inline __m128 GetSpecularSSE2( const ShadingTilePixels& Pixels, unsigned i, __m128 vLightDirX, __m128 vLightDirY, __m128 vLightDirZ,
+                                      __m128 vNormalX, __m128 vNormalY, __m128 vNormalZ )
+{
+    __m128 vHalfAngleX = _mm_add_ps( _mm_loadu_ps( &Pixels.ViewDirX[i] ), vLightDirX );
+    __m128 vHalfAngleY = _mm_add_ps( _mm_loadu_ps( &Pixels.ViewDirY[i] ), vLightDirY );
+    __m128 vHalfAngleZ = _mm_add_ps( _mm_loadu_ps( &Pixels.ViewDirZ[i] ), vLightDirZ );
+    __m128 vLengthSq = _mm_add_ps( _mm_add_ps( _mm_mul_ps( vHalfAngleX, vHalfAngleX ), _mm_mul_ps( vHalfAngleY, vHalfAngleY ) ), _mm_mul_ps( vHalfAngleZ, vHalfAngleZ ) );
+    __m128 vInvLength = _mm_div_ps( _mm_set1_ps( 1.f ), _mm_sqrt_ps( vLengthSq ) );
+    vHalfAngleX = _mm_mul_ps( vHalfAngleX, vInvLength );
+    vHalfAngleY = _mm_mul_ps( vHalfAngleY, vInvLength );
+    vHalfAngleZ = _mm_mul_ps( vHalfAngleZ, vInvLength );
+
+    __m128 vSpec = SaturateSSE2( _mm_add_ps( _mm_add_ps( _mm_mul_ps( vHalfAngleX, vNormalX ), _mm_mul_ps( vHalfAngleY, vNormalY ) ), _mm_mul_ps( vHalfAngleZ, vNormalZ ) ) );
+    vSpec = _mm_mul_ps( vSpec, vSpec );
+    vSpec = _mm_mul_ps( vSpec, vSpec );
+    return _mm_mul_ps( vSpec, vSpec );
+}
+
+// Pixels.X[i..i+3] += mask ? Color*a*b : 0
+CPU_SHADING_TARGET_SSE2
+static inline void AccumulateSSE2( float* pAccum, __m128 vMask, float fColor, __m128 a, __m128 b )
+{
+    __m128 vValue = _mm_mul_ps( _mm_mul_ps( _mm_set1_ps( fColor ), a ), b );
+    _mm_storeu_ps( pAccum, _mm_add_ps( _mm_loadu_ps( pAccum ), _mm_and_ps( vMask, vValue ) ) );
+}
+
+CPU_SHADING_TARGET_SSE2
+static inline void AccumulateSSE2( float* pAccum, __m128 vMask, float fColor, __m128 a, __m128 b, __m128 c )
+{
+    __m128 vValue = _mm_mul_ps( _mm_mul_ps( _mm_mul_ps( _mm_set1_ps( fColor ), a ), b ), c );
+    _mm_storeu_ps( pAccum, _mm_add_ps( _mm_loadu_ps( pAccum ), _mm_and_ps( vMask, vValue ) ) );
+}
+
+CPU_SHADING_TARGET_SSE2
+static void ShadePointLightsSSE2( const ShadingPointLights& Lights, const unsigned* pList, unsigned uNumLights, ShadingTilePixels& Pixels )
+{
+    for( unsigned uLight = 0; uLight < uNumLights; uLight++ )
+    {
+        unsigned uLightIdx = pList[uLight];
+        __m128 vCenterX = _mm_set1_ps( Lights.CenterX[uLightIdx] );
+        __m128 vCenterY = _mm_set1_ps( Lights.CenterY[uLightIdx] );
+        __m128 vCenterZ = _mm_set1_ps( Lights.CenterZ[uLightIdx] );
+        __m128 vRadius = _mm_set1_ps( Lights.Radius[uLightIdx] );
+
+        for( unsigned i = 0; i < Pixels.uNumPixelsPadded; i += 4 )
+        {
+            __m128 vToLightX = _mm_sub_ps( vCenterX, _mm_loadu_ps( &Pixels.PositionX[i] ) );
+            __m128 vToLightY = _mm_sub_ps( vCenterY, _mm_loadu_ps( &Pixels.PositionY[i] ) );
+            __m128 vToLightZ = _mm_sub_ps( vCenterZ, _mm_loadu_ps( &Pixels.PositionZ[i] ) );
+            __m128 vLengthSq = _mm_add_ps( _mm_add_ps( _mm_mul_ps( vToLightX, vToLightX ), _mm_mul_ps( vToLightY, vToLightY ) ), _mm_mul_ps( vToLightZ, vToLightZ ) );
+            __m128 vLightDistance = _mm_sqrt_ps( vLengthSq );
+            __m128 vMask = _mm_cmplt_ps( vLightDistance, vRadius );
+            if( _mm_movemask_ps( vMask ) == 0 )
+            {
+                continue;
+            }
+
+            __m128 vInvLightDistance = _mm_div_ps( _mm_set1_ps( 1.f ), vLightDistance );
+            __m128 vLightDirX = _mm_mul_ps( vToLightX, vInvLightDistance );
+            __m128 vLightDirY = _mm_mul_ps( vToLightY, vInvLightDistance );
+            __m128 vLightDirZ = _mm_mul_ps( vToLightZ, vInvLightDistance );
+
+            __m128 vNormalX = _mm_loadu_ps( &Pixels.NormalX[i] );
+            __m128 vNormalY = _mm_loadu_ps( &Pixels.NormalY[i] );
+            __m128 vNormalZ = _mm_loadu_ps( &Pixels.NormalZ[i] );
+
+            __m128 vFalloff = GetFalloffSSE2( vLightDistance, vRadius );
+            __m128 vDiffuse = SaturateSSE2( _mm_add_ps( _mm_add_ps( _mm_mul_ps( vLightDirX, vNormalX ), _mm_mul_ps( vLightDirY, vNormalY ) ), _mm_mul_ps( vLightDirZ, vNormalZ ) ) );
+            __m128 vSpecular = GetSpecularSSE2( Pixels, i, vLightDirX, vLightDirY, vLightDirZ, vNormalX, vNormalY, vNormalZ );
+
+            AccumulateSSE2( &Pixels.DiffuseR[i], vMask, Lights.ColorR[uLightIdx], vDiffuse, vFalloff );
+            AccumulateSSE2( &Pixels.DiffuseG[i], vMask, Lights.ColorG[uLightIdx], vDiffuse, vFalloff );
+            AccumulateSSE2( &Pixels.DiffuseB[i], vMask, Lights.ColorB[uLightIdx], vDiffuse, vFalloff );
+            AccumulateSSE2( &Pixels.SpecularR[i], vMask, Lights.ColorR[uLightIdx], vSpecular, vFalloff );
+            AccumulateSSE2( &Pixels.SpecularG[i], vMask, Lights.ColorG[uLightIdx], vSpecular, vFalloff );
+            AccumulateSSE2( &Pixels.SpecularB[i], vMask, Lights.ColorB[uLightIdx], vSpecular, vFalloff );
+        }
+    }
+}
+
+CPU_SHADING_TARGET_SSE2
+static void ShadeSpotLightsSSE2( const ShadingSpotLights& Lights, const unsigned* pList, unsigned uNumLights, ShadingTilePixels& Pixels )
+{
+    __m128 vSignBit = _mm_set1_ps( -0.f );
+    for( unsigned uLight = 0; uLight < uNumLights; uLight++ )
+    {
+        unsigned uLightIdx = pList[uLight];
+        __m128 vPositionX = _mm_set1_ps( Lights.PositionX[uLightIdx] );
+        __m128 vPositionY = _mm_set1_ps( Lights.PositionY[uLightIdx] );
+        __m128 vPositionZ = _mm_set1_ps( Lights.PositionZ[uLightIdx] );
+        __m128 vDirX = _mm_set1_ps( Lights.DirX[uLightIdx] );
+        __m128 vDirY = _mm_set1_ps( Lights.DirY[uLightIdx] );
+        __m128 vDirZ = _mm_set1_ps( Lights.DirZ[uLightIdx] );
+        __m128 vCosineOfConeAngle = _mm_set1_ps( Lights.CosineOfConeAngle[uLightIdx] );
+        __m128 vOneMinusCosineOfConeAngle = _mm_set1_ps( 1.f - Lights.CosineOfConeAngle[uLightIdx] );
+        __m128 vFalloffRadius = _mm_set1_ps( Lights.FalloffRadius[uLightIdx] );
+
+        for( unsigned i = 0; i < Pixels.uNumPixelsPadded; i += 4 )
+        {
+            __m128 vToLightX = _mm_sub_ps( vPositionX, _mm_loadu_ps( &Pixels.PositionX[i] ) );
+            __m128 vToLightY = _mm_sub_ps( vPositionY, _mm_loadu_ps( &Pixels.PositionY[i] ) );
+            __m128 vToLightZ = _mm_sub_ps( vPositionZ, _mm_loadu_ps( &Pixels.PositionZ[i] ) );
+            __m128 vLengthSq = _mm_add_ps( _mm_add_ps( _mm_mul_ps( vToLightX, vToLightX ), _mm_mul_ps( vToLightY, vToLightY ) ), _mm_mul_ps( vToLightZ, vToLightZ ) );
+            __m128 vLightDistance = _mm_sqrt_ps( vLengthSq );
+            __m128 vInvLightDistance = _mm_div_ps( _mm_set1_ps( 1.f ), vLightDistance );
+            __m128 vLightDirX = _mm_mul_ps( vToLightX, vInvLightDistance );
+            __m128 vLightDirY = _mm_mul_ps( vToLightY, vInvLightDistance );
+            __m128 vLightDirZ = _mm_mul_ps( vToLightZ, vInvLightDistance );
+
+            __m128 vCosineOfCurrentConeAngle = _mm_xor_ps( vSignBit, _mm_add_ps( _mm_add_ps( _mm_mul_ps( vLightDirX, vDirX ), _mm_mul_ps( vLightDirY, vDirY ) ), _mm_mul_ps( vLightDirZ, vDirZ ) ) );
+            __m128 vMask = _mm_and_ps( _mm_cmplt_ps( vLightDistance, vFalloffRadius ), _mm_cmpgt_ps( vCosineOfCurrentConeAngle, vCosineOfConeAngle ) );
+            if( _mm_movemask_ps( vMask ) == 0 )
+            {
+                continue;
+            }
+
+            __m128 vRadialAttenuation = _mm_div_ps( _mm_sub_ps( vCosineOfCurrentConeAngle, vCosineOfConeAngle ), vOneMinusCosineOfConeAngle );
+            vRadialAttenuation = _mm_mul_ps( vRadialAttenuation, vRadialAttenuation );
+
+            __m128 vNormalX = _mm_loadu_ps( &Pixels.NormalX[i] );
+            __m128 vNormalY = _mm_loadu_ps( &Pixels.NormalY[i] );
+            __m128 vNormalZ = _mm_loadu_ps( &Pixels.NormalZ[i] );
+
+            __m128 vFalloff = GetFalloffSSE2( vLightDistance, vFalloffRadius );
+            __m128 vDiffuse = SaturateSSE2( _mm_add_ps( _mm_add_ps( _mm_mul_ps( vLightDirX, vNormalX ), _mm_mul_ps( vLightDirY, vNormalY ) ), _mm_mul_ps( vLightDirZ, vNormalZ ) ) );
+            __m128 vSpecular = GetSpecularSSE2( Pixels, i, vLightDirX, vLightDirY, vLightDirZ, vNormalX, vNormalY, vNormalZ );
+
+            AccumulateSSE2( &Pixels.DiffuseR[i], vMask, Lights.ColorR[uLightIdx], vDiffuse, vFalloff, vRadialAttenuation );
+            AccumulateSSE2( &Pixels.DiffuseG[i], vMask, Lights.ColorG[uLightIdx], vDiffuse, vFalloff, vRadialAttenuation );
+            AccumulateSSE2( &Pixels.DiffuseB[i], vMask, Lights.ColorB[uLightIdx], vDiffuse, vFalloff, vRadialAttenuation );
+            AccumulateSSE2( &Pixels.SpecularR[i], vMask, Lights.ColorR[uLightIdx], vSpecular, vFalloff, vRadialAttenuation );
+            AccumulateSSE2( &Pixels.SpecularG[i], vMask, Lights.ColorG[uLightIdx], vSpecular, vFalloff, vRadialAttenuation );
+            AccumulateSSE2( &Pixels.SpecularB[i], vMask, Lights.ColorB[uLightIdx], vSpecular, vFalloff, vRadialAttenuation );
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------------------
+// AVX2 kernels, 8 pixels at a time. Unlike the kernels above, the 8 pixels loop over 
+// the whole list with their inputs and sums in registers, and the square roots and 
+// divisions are approximations refined with a Newton-Raphson step, so the frames are 
+// close to the scalar ones but not the same.
+//-----------------------------------------------------------------------------------------
+CPU_SHADING_TARGET_AVX2
+static inline __m256 SaturateAVX2( __m256 a )
+{
+    return _mm256_min_ps( _mm256_max_ps( a, _mm256_setzero_ps() ), _mm256_set1_ps( 1.f ) );
+}
+
+// 1/sqrt(x), from the 12 bits of _mm256_rsqrt_ps to about 23: r*(1.5 - 0.5*x*r*r)
+CPU_SHADING_TARGET_AVX2
+static inline __m256 ReciprocalSqrtAVX2( __m256 x )
+{
+    __m256 r = _mm256_rsqrt_ps( x );
+    __m256 vHalfXRR = _mm256_mul_ps( _mm256_mul_ps( _mm256_mul_ps( _mm256_set1_ps( 0.5f ), x ), r ), r );
+    return _mm256_mul_ps( r, _mm256_sub_ps( _mm256_set1_ps( 1.5f ), vHalfXRR ) );
+}
+
+// 1/x, from the 12 bits of _mm256_rcp_ps to about 23: r*(2 - x*r)
+CPU_SHADING_TARGET_AVX2
+static inline __m256 ReciprocalAVX2( __m256 x )
+{
+    __m256 r = _mm256_rcp_ps( x );
+    return _mm256_mul_ps( r, _mm256_sub_ps( _mm256_set1_ps( 2.f ), _mm256_mul_ps( x, r ) ) );
+}
+
+CPU_SHADING_TARGET_AVX2
+static inline __m256 Dot3AVX2( __m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz )
+{
+    return _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( ax, bx ), _mm256_mul_ps( ay, by ) ), _mm256_mul_ps( az, bz ) );
+}
+
+// the 8 pixels a batch of the AVX2 kernels shades
+struct ShadingPixelsAVX2
+{
+    __m256 vPositionX, vPositionY, vPositionZ;
+    __m256 vNormalX, vNormalY, vNormalZ;
+    __m256 vViewDirX, vViewDirY, vViewDirZ;
+    __m256 vDiffuseR, vDiffuseG, vDiffuseB;
+    __m256 vSpecularR, vSpecularG, vSpecularB;
+};
+
+CPU_SHADING_TARGET_AVX2
+static inline void LoadPixelsAVX2( const ShadingTilePixels& Pixels, unsigned i, ShadingPixelsAVX2* pBatch )
+{
+    pBatch->vPositionX = _mm256_loadu_ps( &Pixels.PositionX[i] );
+    pBatch->vPositionY = _mm256_loadu_ps( &Pixels.PositionY[i] );
+    pBatch->vPositionZ = _mm256_loadu_ps( &Pixels.PositionZ[i] );
+    pBatch->vNormalX = _mm256_loadu_ps( &Pixels.NormalX[i] );
+    pBatch->vNormalY = _mm256_loadu_ps( &Pixels.NormalY[i] );
+    pBatch->vNormalZ = _mm256_loadu_ps( &Pixels.NormalZ[i] );
+    pBatch->vViewDirX = _mm256_loadu_ps( &Pixels.ViewDirX[i] );
+    pBatch->vViewDirY = _mm256_loadu_ps( &Pixels.ViewDirY[i] );
+    pBatch->vViewDirZ = _mm256_loadu_ps( &Pixels.ViewDirZ[i] );
+    pBatch->vDiffuseR = _mm256_loadu_ps( &Pixels.DiffuseR[i] );
+    pBatch->vDiffuseG = _mm256_loadu_ps( &Pixels.DiffuseG[i] );
+    pBatch->vDiffuseB = _mm256_loadu_ps( &Pixels.DiffuseB[i] );
+    pBatch->vSpecularR = _mm256_loadu_ps( &Pixels.SpecularR[i] );
+    pBatch->vSpecularG = _mm256_loadu_ps( &Pixels.SpecularG[i] );
+    pBatch->vSpecularB = _mm256_loadu_ps( &Pixels.SpecularB[i] );
+}
+
+CPU_SHADING_TARGET_AVX2
+static inline void StorePixelsAVX2( const ShadingPixelsAVX2& Batch, unsigned i, ShadingTilePixels& Pixels )
+{
+    _mm256_storeu_ps( &Pixels.DiffuseR[i], Batch.vDiffuseR );
+    _mm256_storeu_ps( &Pixels.DiffuseG[i], Batch.vDiffuseG );
+    _mm256_storeu_ps( &Pixels.DiffuseB[i], Batch.vDiffuseB );
+    _mm256_storeu_ps( &Pixels.SpecularR[i], Batch.vSpecularR );
+    _mm256_storeu_ps( &Pixels.SpecularG[i], Batch.vSpecularG );
+    _mm256_storeu_ps( &Pixels.SpecularB[i], Batch.vSpecularB );
+}
+
+// adds one light to the batch, given the normalized direction to it and its distance 
+// (vLightDistance*vInvRadius), with the lights that do not reach a pixel masked out
+CPU_SHADING_TARGET_AVX2
+static inline void AccumulateLightAVX2( ShadingPixelsAVX2& Batch, __m256 vMask, __m256 vLightDirX, __m256 vLightDirY, __m256 vLightDirZ, __m256 vDistanceOverRadius,
+                                        __m256 vAttenuation, float fColorR, float fColorG, float fColorB )
+{
+    // fake inverse squared falloff
+    __m256 vDenominator = _mm256_add_ps( _mm256_set1_ps( 1.f ), _mm256_mul_ps( _mm256_mul_ps( _mm256_set1_ps( 20.f ), vDistanceOverRadius ), vDistanceOverRadius ) );
+    __m256 vFalloff = _mm256_add_ps( _mm256_set1_ps( -0.05f ), _mm256_mul_ps( _mm256_set1_ps( 1.05f ), ReciprocalAVX2( vDenominator ) ) );
+    vFalloff = _mm256_and_ps( vMask, _mm256_mul_ps( vFalloff, vAttenuation ) );
+
+    __m256 vDiffuse = SaturateAVX2( Dot3AVX2( vLightDirX, vLightDirY, vLightDirZ, Batch.vNormalX, Batch.vNormalY, Batch.vNormalZ ) );
+
+    __m256 vHalfAngleX = _mm256_add_ps( Batch.vViewDirX, vLightDirX );
+    __m256 vHalfAngleY = _mm256_add_ps( Batch.vViewDirY, vLightDirY );
+    __m256 vHalfAngleZ = _mm256_add_ps( Batch.vViewDirZ, vLightDirZ );
+    __m256 vInvLength = ReciprocalSqrtAVX2( Dot3AVX2( vHalfAngleX, vHalfAngleY, vHalfAngleZ, vHalfAngleX, vHalfAngleY, vHalfAngleZ ) );
+    __m256 vSpecular = SaturateAVX2( _mm256_mul_ps( Dot3AVX2( vHalfAngleX, vHalfAngleY, vHalfAngleZ, Batch.vNormalX, Batch.vNormalY, Batch.vNormalZ ), vInvLength ) );
+    vSpecular = _mm256_mul_ps( vSpecular, vSpecular );
+    vSpecular = _mm256_mul_ps( vSpecular, vSpecular );
+    vSpecular = _mm256_mul_ps( vSpecular, vSpecular );
+
+    // the masked out lanes can be NaN, and AND with 0 clears them
+    vDiffuse = _mm256_mul_ps( vDiffuse, vFalloff );
+    vSpecular = _mm256_mul_ps( vSpecular, vFalloff );
+    __m256 vColorR = _mm256_set1_ps( fColorR );
+    __m256 vColorG = _mm256_set1_ps( fColorG );
+    __m256 vColorB = _mm256_set1_ps( fColorB );
+    Batch.vDiffuseR = _mm256_add_ps( Batch.vDiffuseR, _mm256_and_ps( vMask, _mm256_mul_ps( vColorR, vDiffuse ) ) );
+    Batch.vDiffuseG = _mm256_add_ps( Batch.vDiffuseG, _mm256_and_ps( vMask, _mm256_mul_ps( vColorG, vDiffuse ) ) );
+    Batch.vDiffuseB = _mm256_add_ps( Batch.vDiffuseB, _mm256_and_ps( vMask, _mm256_mul_ps( vColorB, vDiffuse ) ) );
+    Batch.vSpecularR = _mm256_add_ps( Batch.vSpecularR, _mm256_and_ps( vMask, _mm256_mul_ps( vColorR, vSpecular ) ) );
+    Batch.vSpecularG = _mm256_add_ps( Batch.vSpecularG, _mm256_and_ps( vMask, _mm256_mul_ps( vColorG, vSpecular ) ) );
+    Batch.vSpecularB = _mm256_add_ps( Batch.vSpecularB, _mm256_and_ps( vMask, _mm256_mul_ps( vColorB, vSpecular ) ) );
+}
+
+CPU_SHADING_TARGET_AVX2
+static void ShadePointLightsAVX2( const ShadingPointLights& Lights, const unsigned* pList, unsigned uNumLights, ShadingTilePixels& Pixels )
+{
+    __m256 vOne = _mm256_set1_ps( 1.f );
+    for( unsigned i = 0; i < Pixels.uNumPixelsPadded; i += 8 )
+    {
+        ShadingPixelsAVX2 Batch;
+        LoadPixelsAVX2( Pixels, i, &Batch );
+
+        for( unsigned uLight = 0; uLight < uNumLights; uLight++ )
+        {
+            unsigned uLightIdx = pList[uLight];
+            __m256 vToLightX = _mm256_sub_ps( _mm256_set1_ps( Lights.CenterX[uLightIdx] ), Batch.vPositionX );
+            __m256 vToLightY = _mm256_sub_ps( _mm256_set1_ps( Lights.CenterY[uLightIdx] ), Batch.vPositionY );
+            __m256 vToLightZ = _mm256_sub_ps( _mm256_set1_ps( Lights.CenterZ[uLightIdx] ), Batch.vPositionZ );
+            __m256 vLengthSq = Dot3AVX2( vToLightX, vToLightY, vToLightZ, vToLightX, vToLightY, vToLightZ );
+            __m256 vRadius = _mm256_set1_ps( Lights.Radius[uLightIdx] );
+            __m256 vMask = _mm256_cmp_ps( vLengthSq, _mm256_mul_ps( vRadius, vRadius ), _CMP_LT_OQ );
+            if( _mm256_movemask_ps( vMask ) == 0 )
+            {
+                continue;
+            }
+
+            __m256 vInvLightDistance = ReciprocalSqrtAVX2( vLengthSq );
+            __m256 vDistanceOverRadius = _mm256_mul_ps( _mm256_mul_ps( vLengthSq, vInvLightDistance ), _mm256_set1_ps( Lights.InvRadius[uLightIdx] ) );
+            AccumulateLightAVX2( Batch, vMask, _mm256_mul_ps( vToLightX, vInvLightDistance ), _mm256_mul_ps( vToLightY, vInvLightDistance ), _mm256_mul_ps( vToLightZ, vInvLightDistance ),
+                vDistanceOverRadius, vOne, Lights.ColorR[uLightIdx], Lights.ColorG[uLightIdx], Lights.ColorB[uLightIdx] );
+        }
+
+        StorePixelsAVX2( Batch, i, Pixels );
+    }
+}
+
+CPU_SHADING_TARGET_AVX2
+static void ShadeSpotLightsAVX2( const ShadingSpotLights& Lights, const unsigned* pList, unsigned uNumLights, ShadingTilePixels& Pixels )
+{
+    for( unsigned i = 0; i < Pixels.uNumPixelsPadded; i += 8 )
+    {
+        ShadingPixelsAVX2 Batch;
+        LoadPixelsAVX2( Pixels, i, &Batch );
+
+        for( unsigned uLight = 0; uLight < uNumLights; uLight++ )
+        {
+            unsigned uLightIdx = pList[uLight];
+            __m256 vToLightX = _mm256_sub_ps( _mm256_set1_ps( Lights.PositionX[uLightIdx] ), Batch.vPositionX );
+            __m256 vToLightY = _mm256_sub_ps( _mm256_set1_ps( Lights.PositionY[uLightIdx] ), Batch.vPositionY );
+            __m256 vToLightZ = _mm256_sub_ps( _mm256_set1_ps( Lights.PositionZ[uLightIdx] ), Batch.vPositionZ );
+            __m256 vLengthSq = Dot3AVX2( vToLightX, vToLightY, vToLightZ, vToLightX, vToLightY, vToLightZ );
+            __m256 vFalloffRadius = _mm256_set1_ps( Lights.FalloffRadius[uLightIdx] );
+            __m256 vMask = _mm256_cmp_ps( vLengthSq, _mm256_mul_ps( vFalloffRadius, vFalloffRadius ), _CMP_LT_OQ );
+            if( _mm256_movemask_ps( vMask ) == 0 )
+            {
+                continue;
+            }
+
+            __m256 vInvLightDistance = ReciprocalSqrtAVX2( vLengthSq );
+            __m256 vLightDirX = _mm256_mul_ps( vToLightX, vInvLightDistance );
+            __m256 vLightDirY = _mm256_mul_ps( vToLightY, vInvLightDistance );
+            __m256 vLightDirZ = _mm256_mul_ps( vToLightZ, vInvLightDistance );
+
+            // dot(-vToLightNormalized, SpotLightDir)
+            __m256 vCosineOfConeAngle = _mm256_set1_ps( Lights.CosineOfConeAngle[uLightIdx] );
+            __m256 vCosineOfCurrentConeAngle = _mm256_sub_ps( _mm256_setzero_ps(), Dot3AVX2( vLightDirX, vLightDirY, vLightDirZ,
+                _mm256_set1_ps( Lights.DirX[uLightIdx] ), _mm256_set1_ps( Lights.DirY[uLightIdx] ), _mm256_set1_ps( Lights.DirZ[uLightIdx] ) ) );
+            vMask = _mm256_and_ps( vMask, _mm256_cmp_ps( vCosineOfCurrentConeAngle, vCosineOfConeAngle, _CMP_GT_OQ ) );
+            if( _mm256_movemask_ps( vMask ) == 0 )
+            {
+                continue;
+            }
+
+            __m256 vRadialAttenuation = _mm256_mul_ps( _mm256_sub_ps( vCosineOfCurrentConeAngle, vCosineOfConeAngle ), _mm256_set1_ps( Lights.InvOneMinusCosineOfConeAngle[uLightIdx] ) );
+            vRadialAttenuation = _mm256_mul_ps( vRadialAttenuation, vRadialAttenuation );
+
+            __m256 vDistanceOverRadius = _mm256_mul_ps( _mm256_mul_ps( vLengthSq, vInvLightDistance ), _mm256_set1_ps( Lights.InvFalloffRadius[uLightIdx] ) );
+            AccumulateLightAVX2( Batch, vMask, vLightDirX, vLightDirY, vLightDirZ, vDistanceOverRadius, vRadialAttenuation,
+                Lights.ColorR[uLightIdx], Lights.ColorG[uLightIdx], Lights.ColorB[uLightIdx] );
+        }
+
+        StorePixelsAVX2( Batch, i, Pixels );
+    }
+}
+
+#endif // CPU_SHADING_X86
+
+//-----------------------------------------------------------------------------------------
+// Everything but the light loops
+//-----------------------------------------------------------------------------------------
+
+// unpack the lights, like the light loops of RenderScenePS do
+static void SetupShadingLights( const ForwardPlus11::CpuShadingDesc& Desc, ShadingLights* pLights )
+{
+    ShadingPointLights& PointLights = pLights->PointLights;
+    std::vector<float>* PointArrays[] = { &PointLights.CenterX, &PointLights.CenterY, &PointLights.CenterZ, &PointLights.Radius, &PointLights.InvRadius,
+                                          &PointLights.ColorR, &PointLights.ColorG, &PointLights.ColorB };
+    for( unsigned i = 0; i < sizeof(PointArrays)/sizeof(PointArrays[0]); i++ )
+    {
+        PointArrays[i]->resize( Desc.uNumPointLights );
+    }
+    for( unsigned i = 0; i < Desc.uNumPointLights; i++ )
+    {
+        const XMFLOAT4& CenterAndRadius = Desc.pPointLightCenterAndRadius[i];
+        PointLights.CenterX[i] = CenterAndRadius.x;
+        PointLights.CenterY[i] = CenterAndRadius.y;
+        PointLights.CenterZ[i] = CenterAndRadius.z;
+        PointLights.Radius[i] = CenterAndRadius.w;
+        PointLights.InvRadius[i] = 1.f / CenterAndRadius.w;
+        UnpackColor( Desc.pPointLightColor[i], &PointLights.ColorR[i], &PointLights.ColorG[i], &PointLights.ColorB[i] );
+    }
+
+    ShadingSpotLights& SpotLights = pLights->SpotLights;
+    std::vector<float>* SpotArrays[] = { &SpotLights.PositionX, &SpotLights.PositionY, &SpotLights.PositionZ, &SpotLights.DirX, &SpotLights.DirY, &SpotLights.DirZ,
+                                         &SpotLights.CosineOfConeAngle, &SpotLights.InvOneMinusCosineOfConeAngle, &SpotLights.FalloffRadius, &SpotLights.InvFalloffRadius,
+                                         &SpotLights.ColorR, &SpotLights.ColorG, &SpotLights.ColorB };
+    for( unsigned i = 0; i < sizeof(SpotArrays)/sizeof(SpotArrays[0]); i++ )
+    {
+        SpotArrays[i]->resize( Desc.uNumSpotLights );
+    }
+    for( unsigned i = 0; i < Desc.uNumSpotLights; i++ )
+    {
+        ForwardPlus11::SpotLightCone Cone;
+        ForwardPlus11::UnpackSpotParams( Desc.pSpotLightSpotParams[i], &Cone );
+
+        // the top of the cone is r_bounding_sphere units away from the 
+        // bounding sphere center along the negated light direction
+        const XMFLOAT4& BoundingSphere = Desc.pSpotLightCenterAndRadius[i];
+        SpotLights.PositionX[i] = BoundingSphere.x - BoundingSphere.w*Cone.vLightDir.x;
+        SpotLights.PositionY[i] = BoundingSphere.y - BoundingSphere.w*Cone.vLightDir.y;
+        SpotLights.PositionZ[i] = BoundingSphere.z - BoundingSphere.w*Cone.vLightDir.z;
+        SpotLights.DirX[i] = Cone.vLightDir.x;
+        SpotLights.DirY[i] = Cone.vLightDir.y;
+        SpotLights.DirZ[i] = Cone.vLightDir.z;
+        SpotLights.CosineOfConeAngle[i] = Cone.fCosineOfConeAngle;
+        SpotLights.InvOneMinusCosineOfConeAngle[i] = 1.f / ( 1.f - Cone.fCosineOfConeAngle );
+        SpotLights.FalloffRadius[i] = Cone.fFalloffRadius;
+        SpotLights.InvFalloffRadius[i] = 1.f / Cone.fFalloffRadius;
+        UnpackColor( Desc.pSpotLightColor[i], &SpotLights.ColorR[i], &SpotLights.ColorG[i], &SpotLights.ColorB[i] );
+    }
+
+    pLights->AllLightsList.clear();
+    if( Desc.pLightIndexBuffer == NULL )
+    {
+        for( unsigned i = 0; i < Desc.uNumPointLights; i++ )
+        {
+            pLights->AllLightsList.push_back( i );
+        }
+        pLights->AllLightsList.push_back( ForwardPlus11::LIGHT_INDEX_BUFFER_SENTINEL );
+        for( unsigned i = 0; i < Desc.uNumSpotLights; i++ )
+        {
+            pLights->AllLightsList.push_back( i );
+        }
+        pLights->AllLightsList.push_back( ForwardPlus11::LIGHT_INDEX_BUFFER_SENTINEL );
+    }
+}
+
+// Gather the pixels of a tile that get shaded, with what RenderScenePS does before the 
+// light loops: the alpha test, the normal from the normal map, and the view direction
+static void SetupTilePixels( const ForwardPlus11::CpuShadingDesc& Desc, unsigned uTileX, unsigned uTileY, unsigned uTileRes, ShadingTilePixels& Pixels )
+{
+    unsigned uStartX = uTileX*uTileRes;
+    unsigned uStartY = uTileY*uTileRes;
+    unsigned uEndX = ( uStartX + uTileRes < Desc.uWidth ) ? uStartX + uTileRes : Desc.uWidth;
+    unsigned uEndY = ( uStartY + uTileRes < Desc.uHeight ) ? uStartY + uTileRes : Desc.uHeight;
+
+    unsigned uNumPixels = 0;
+    for( unsigned y = uStartY; y < uEndY; y++ )
+    {
+        for( unsigned x = uStartX; x < uEndX; x++ )
+        {
+            unsigned uPixelIdx = y*Desc.uWidth + x;
+            if( Desc.pDepth[uPixelIdx] == 0.f )
+            {
+                continue;
+            }
+
+            const XMFLOAT4& DiffuseTex = Desc.pDiffuseSample[uPixelIdx];
+            if( Desc.bAlphaTest && DiffuseTex.w < Desc.fAlphaTest )
+            {
+                continue;
+            }
+
+            // get normal from normal map
+            const XMFLOAT3& NormalMap = Desc.pNormalMapSample[uPixelIdx];
+            float fNormX = NormalMap.x*2.f - 1.f;
+            float fNormY = NormalMap.y*2.f - 1.f;
+            float fNormZ = NormalMap.z*2.f - 1.f;
+
+            // transform normal into world space
+            const XMFLOAT3& N = Desc.pNormalWS[uPixelIdx];
+            const XMFLOAT3& T = Desc.pTangentWS[uPixelIdx];
+            float fBinormX = N.y*T.z - N.z*T.y;
+            float fBinormY = N.z*T.x - N.x*T.z;
+            float fBinormZ = N.x*T.y - N.y*T.x;
+            NormalizeScalar( &fBinormX, &fBinormY, &fBinormZ );
+            float fNormalX = fNormX*fBinormX + fNormY*T.x + fNormZ*N.x;
+            float fNormalY = fNormX*fBinormY + fNormY*T.y + fNormZ*N.y;
+            float fNormalZ = fNormX*fBinormZ + fNormY*T.z + fNormZ*N.z;
+            NormalizeScalar( &fNormalX, &fNormalY, &fNormalZ );
+
+            const XMFLOAT3& P = Desc.pPositionWS[uPixelIdx];
+            float fViewDirX = Desc.vCameraPos.x - P.x;
+            float fViewDirY = Desc.vCameraPos.y - P.y;
+            float fViewDirZ = Desc.vCameraPos.z - P.z;
+            NormalizeScalar( &fViewDirX, &fViewDirY, &fViewDirZ );
+
+            Pixels.PositionX[uNumPixels] = P.x;
+            Pixels.PositionY[uNumPixels] = P.y;
+            Pixels.PositionZ[uNumPixels] = P.z;
+            Pixels.NormalX[uNumPixels] = fNormalX;
+            Pixels.NormalY[uNumPixels] = fNormalY;
+            Pixels.NormalZ[uNumPixels] = fNormalZ;
+            Pixels.ViewDirX[uNumPixels] = fViewDirX;
+            Pixels.ViewDirY[uNumPixels] = fViewDirY;
+            Pixels.ViewDirZ[uNumPixels] = fViewDirZ;
+            Pixels.SpecMask[uNumPixels] = Desc.bAlphaTest ? 0.f : DiffuseTex.w;
+            Pixels.PixelIndices[uNumPixels] = uPixelIdx;
+            uNumPixels++;
+        }
+    }
+
+    // pad with a pixel that no light reaches (its results are never written)
+    Pixels.uNumPixels = uNumPixels;
+    Pixels.uNumPixelsPadded = ( uNumPixels + CPU_SHADING_BATCH_SIZE - 1 ) & ~( CPU_SHADING_BATCH_SIZE - 1 );
+    for( unsigned i = uNumPixels; i < Pixels.uNumPixelsPadded; i++ )
+    {
+        Pixels.PositionX[i] = Pixels.PositionY[i] = Pixels.PositionZ[i] = 3.0e+38f;
+        Pixels.NormalX[i] = Pixels.NormalZ[i] = 0.f;
+        Pixels.NormalY[i] = 1.f;
+        Pixels.ViewDirX[i] = Pixels.ViewDirY[i] = 0.f;
+        Pixels.ViewDirZ[i] = -1.f;
+    }
+
+    for( unsigned i = 0; i < Pixels.uNumPixelsPadded; i++ )
+    {
+        Pixels.DiffuseR[i] = Pixels.DiffuseG[i] = Pixels.DiffuseB[i] = 0.f;
+        Pixels.SpecularR[i] = Pixels.SpecularG[i] = Pixels.SpecularB[i] = 0.f;
+    }
+}
+
+// What RenderScenePS does after the light loops: the ambient, and the texture.
+// pTileAmbient is the tile's share of CpuShadingDesc::pTileAmbient, or NULL.
+static void ResolveTilePixels( const ForwardPlus11::CpuShadingDesc& Desc, const ShadingTilePixels& Pixels, const XMFLOAT3* pTileAmbient, XMFLOAT4* pOutput )
+{
+    XMFLOAT3 TileAmbient = ( pTileAmbient != NULL ) ? *pTileAmbient : XMFLOAT3( 0.f, 0.f, 0.f );
+
+    for( unsigned i = 0; i < Pixels.uNumPixels; i++ )
+    {
+        // pump up the lights
+        float fDiffuseR = Pixels.DiffuseR[i]*2.f;
+        float fDiffuseG = Pixels.DiffuseG[i]*2.f;
+        float fDiffuseB = Pixels.DiffuseB[i]*2.f;
+        float fSpecularR = Pixels.SpecularR[i]*8.f;
+        float fSpecularG = Pixels.SpecularG[i]*8.f;
+        float fSpecularB = Pixels.SpecularB[i]*8.f;
+
+        // This is a poor man's ambient cubemap (blend between an up color and a down color)
+        float fAmbientBlend = 0.5f*Pixels.NormalY[i] + 0.5f;
+        float fAmbientR = Desc.AmbientColorUp.x*fAmbientBlend + Desc.AmbientColorDown.x*( 1.f - fAmbientBlend ) + TileAmbient.x;
+        float fAmbientG = Desc.AmbientColorUp.y*fAmbientBlend + Desc.AmbientColorDown.y*( 1.f - fAmbientBlend ) + TileAmbient.y;
+        float fAmbientB = Desc.AmbientColorUp.z*fAmbientBlend + Desc.AmbientColorDown.z*( 1.f - fAmbientBlend ) + TileAmbient.z;
+
+        // modulate mesh texture with lighting
+        unsigned uPixelIdx = Pixels.PixelIndices[i];
+        const XMFLOAT4& DiffuseTex = Desc.pDiffuseSample[uPixelIdx];
+        float fSpecMask = Pixels.SpecMask[i];
+        pOutput[uPixelIdx] = XMFLOAT4( DiffuseTex.x*( fDiffuseR + fAmbientR + fSpecularR*fSpecMask ),
+                                       DiffuseTex.y*( fDiffuseG + fAmbientG + fSpecularG*fSpecMask ),
+                                       DiffuseTex.z*( fDiffuseB + fAmbientB + fSpecularB*fSpecMask ), 1.f );
+    }
+}
+
+static void WriteLittleEndian( unsigned char* pBytes, unsigned uValue, unsigned uNumBytes )
+{
+    for( unsigned i = 0; i < uNumBytes; i++ )
+    {
+        pBytes[i] = (unsigned char)( uValue >> ( 8*i ) );
+    }
+}
+
+namespace ForwardPlus11
+{
+    //--------------------------------------------------------------------------------------
+    // Shade a frame
+    //--------------------------------------------------------------------------------------
+    void ShadeFrame( const CpuShadingDesc& Desc, CpuShadingKernel eKernel, unsigned uNumThreads, XMFLOAT4* pOutput )
+    {
+        assert( Desc.pLightIndexBuffer == NULL || Desc.uMaxNumLightsPerTile >= 2 );
+
+        PFN_SHADE_POINT_LIGHTS pfnShadePointLights = ShadePointLightsScalar;
+        PFN_SHADE_SPOT_LIGHTS pfnShadeSpotLights = ShadeSpotLightsScalar;
+#if CPU_SHADING_X86
+        switch( ResolveCpuShadingKernel( eKernel ) )
+        {
+        case CPU_SHADING_KERNEL_SSE2:
+            pfnShadePointLights = ShadePointLightsSSE2;
+            pfnShadeSpotLights = ShadeSpotLightsSSE2;
+            break;
+        case CPU_SHADING_KERNEL_AVX2:
+            pfnShadePointLights = ShadePointLightsAVX2;
+            pfnShadeSpotLights = ShadeSpotLightsAVX2;
+            break;
+        default:
+            break;
+        }
+#endif
+
+        ShadingLights Lights;
+        SetupShadingLights( Desc, &Lights );
+
+        // the pixels that are not shaded stay 0
+        for( unsigned i = 0; i < Desc.uWidth*Desc.uHeight; i++ )
+        {
+            pOutput[i] = XMFLOAT4( 0.f, 0.f, 0.f, 0.f );
+        }
+
+        // without lists, the tiles are just for spreading the work
+        unsigned uTileRes = ( Desc.pLightIndexBuffer != NULL ) ? Desc.uTileRes : 16;
+        unsigned uNumTilesX = ( Desc.uWidth + uTileRes - 1 ) / uTileRes;
+        unsigned uNumTilesY = ( Desc.uHeight + uTileRes - 1 ) / uTileRes;
+
+        if( uNumThreads == 0 )
+        {
+            uNumThreads = GetDefaultNumThreads();
+        }
+        std::vector<ShadingTilePixels> ThreadPixels( uNumThreads );
+        for( unsigned i = 0; i < uNumThreads; i++ )
+        {
+            ThreadPixels[i].Reserve( uTileRes*uTileRes + CPU_SHADING_BATCH_SIZE );
+        }
+
+        // each tile is independent, just like the pixels of RenderScenePS
+        struct ShadeTileFunc
+        {
+            const CpuShadingDesc* pDesc;
+            const ShadingLights* pLights;
+            PFN_SHADE_POINT_LIGHTS pfnShadePointLights;
+            PFN_SHADE_SPOT_LIGHTS pfnShadeSpotLights;
+            unsigned uTileRes;
+            unsigned uNumTilesX;
+            ShadingTilePixels* pThreadPixels;
+            XMFLOAT4* pOutput;
+
+            void operator()( unsigned uTileIdx, unsigned uThreadIdx )
+            {
+                ShadingTilePixels& Pixels = pThreadPixels[uThreadIdx];
+                SetupTilePixels( *pDesc, uTileIdx % uNumTilesX, uTileIdx / uNumTilesX, uTileRes, Pixels );
+                if( Pixels.uNumPixels == 0 )
+                {
+                    return;
+                }
+
+                const unsigned* pList = ( pDesc->pLightIndexBuffer != NULL ) ? pDesc->pLightIndexBuffer + pDesc->uMaxNumLightsPerTile*uTileIdx : &pLights->AllLightsList[0];
+
+                // the point lights, then past the first sentinel, the spot lights
+                unsigned uNumPointLights = 0;
+                while( pList[uNumPointLights] != LIGHT_INDEX_BUFFER_SENTINEL )
+                {
+                    uNumPointLights++;
+                }
+                const unsigned* pSpotList = pList + uNumPointLights + 1;
+                unsigned uNumSpotLights = 0;
+                while( pSpotList[uNumSpotLights] != LIGHT_INDEX_BUFFER_SENTINEL )
+                {
+                    uNumSpotLights++;
+                }
+
+                pfnShadePointLights( pLights->PointLights, pList, uNumPointLights, Pixels );
+                pfnShadeSpotLights( pLights->SpotLights, pSpotList, uNumSpotLights, Pixels );
+
+                const XMFLOAT3* pTileAmbient = ( pDesc->pLightIndexBuffer != NULL && pDesc->pTileAmbient != NULL ) ? &pDesc->pTileAmbient[uTileIdx] : NULL;
+                ResolveTilePixels( *pDesc, Pixels, pTileAmbient, pOutput );
+            }
+        };
+
+        ShadeTileFunc Func = { &Desc, &Lights, pfnShadePointLights, pfnShadeSpotLights, uTileRes, uNumTilesX, &ThreadPixels[0], pOutput };
+        ParallelFor( uNumTilesX*uNumTilesY, uNumThreads, 4, Func );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Runtime ISA dispatch (the culling kernels already know what the CPU supports)
+    //--------------------------------------------------------------------------------------
+    CpuShadingKernel ResolveCpuShadingKernel( CpuShadingKernel eKernel )
+    {
+#if CPU_SHADING_X86
+        if( ( eKernel == CPU_SHADING_KERNEL_AUTO || eKernel == CPU_SHADING_KERNEL_AVX2 ) && ResolveCpuCullKernel( CPU_CULL_KERNEL_AVX2 ) == CPU_CULL_KERNEL_AVX2 )
+        {
+            return CPU_SHADING_KERNEL_AVX2;
+        }
+        if( eKernel != CPU_SHADING_KERNEL_SCALAR && ResolveCpuCullKernel( CPU_CULL_KERNEL_SSE2 ) == CPU_CULL_KERNEL_SSE2 )
+        {
+            return CPU_SHADING_KERNEL_SSE2;
+        }
+#else
+        (void)eKernel;
+#endif
+        return CPU_SHADING_KERNEL_SCALAR;
+    }
+
+    const char* GetCpuShadingKernelName( CpuShadingKernel eKernel )
+    {
+        switch( eKernel )
+        {
+        case CPU_SHADING_KERNEL_AUTO:       return "Auto";
+        case CPU_SHADING_KERNEL_SCALAR:     return "Scalar";
+        case CPU_SHADING_KERNEL_SSE2:       return "SSE2";
+        case CPU_SHADING_KERNEL_AVX2:       return "AVX2";
+        default:                            assert( false ); return "Unknown";
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Compare a frame against a golden one
+    //--------------------------------------------------------------------------------------
+    void CompareImages( const XMFLOAT4* pImage, const XMFLOAT4* pGolden, unsigned uNumPixels, float fTolerance, ImageDiff* pDiff )
+    {
+        pDiff->uNumPixels = uNumPixels;
+        pDiff->uNumPixelsOverTolerance = 0;
+        pDiff->fMaxError = 0.f;
+
+        double fErrorSum = 0.0;
+        for( unsigned i = 0; i < uNumPixels; i++ )
+        {
+            const float* pA = &pImage[i].x;
+            const float* pB = &pGolden[i].x;
+            bool bOverTolerance = false;
+            for( unsigned c = 0; c < 4; c++ )
+            {
+                // NaNs count as over the tolerance
+                float fError = fabsf( pA[c] - pB[c] );
+                bOverTolerance = bOverTolerance || !( fError <= fTolerance );
+                pDiff->fMaxError = ( fError > pDiff->fMaxError ) ? fError : pDiff->fMaxError;
+                fErrorSum += fError;
+            }
+            pDiff->uNumPixelsOverTolerance += bOverTolerance ? 1 : 0;
+        }
+        pDiff->fMeanError = ( uNumPixels > 0 ) ? fErrorSum / ( 4.0*uNumPixels ) : 0.0;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // PFM: a text header ("PF", the size, and a negative scale for little endian), 
+    // then the rows of RGB floats, bottom-up
+    //--------------------------------------------------------------------------------------
+    bool WriteImagePfm( FILE* pFile, unsigned uWidth, unsigned uHeight, const XMFLOAT4* pImage )
+    {
+        if( fprintf( pFile, "PF\n%u %u\n-1.0\n", uWidth, uHeight ) < 0 )
+        {
+            return false;
+        }
+
+        std::vector<float> Row( 3*uWidth );
+        for( unsigned y = 0; y < uHeight; y++ )
+        {
+            const XMFLOAT4* pRow = pImage + ( uHeight - 1 - y )*uWidth;
+            for( unsigned x = 0; x < uWidth; x++ )
+            {
+                Row[3*x + 0] = pRow[x].x;
+                Row[3*x + 1] = pRow[x].y;
+                Row[3*x + 2] = pRow[x].z;
+            }
+
+            if( uWidth > 0 && fwrite( &Row[0], sizeof(float)*3*uWidth, 1, pFile ) != 1 )
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool ReadImagePfm( FILE* pFile, unsigned* pWidth, unsigned* pHeight, std::vector<XMFLOAT4>& Image )
+    {
+        char szMagic[3] = { 0, 0, 0 };
+        float fScale = 0.f;
+        if( fread( szMagic, 2, 1, pFile ) != 1 || strcmp( szMagic, "PF" ) != 0 ||
+            fscanf_s( pFile, "%u %u %f", pWidth, pHeight, &fScale ) != 3 || fScale >= 0.f || fgetc( pFile ) == EOF )
+        {
+            return false;
+        }
+
+        unsigned uWidth = *pWidth;
+        unsigned uHeight = *pHeight;
+        Image.resize( uWidth*uHeight );
+        std::vector<float> Row( 3*uWidth );
+        for( unsigned y = 0; y < uHeight; y++ )
+        {
+            if( uWidth > 0 && fread( &Row[0], sizeof(float)*3*uWidth, 1, pFile ) != 1 )
+            {
+                return false;
+            }
+
+            XMFLOAT4* pRow = &Image[( uHeight - 1 - y )*uWidth];
+            for( unsigned x = 0; x < uWidth; x++ )
+            {
+                pRow[x] = XMFLOAT4( Row[3*x + 0], Row[3*x + 1], Row[3*x + 2], 1.f );
+            }
+        }
+
+        return true;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Write a frame as a BMP, like WriteHeatMapBmp
+    //--------------------------------------------------------------------------------------
+    bool WriteImageBmp( FILE* pFile, unsigned uWidth, unsigned uHeight, const XMFLOAT4* pImage )
+    {
+        // BMP rows are padded to 4 bytes, and stored bottom-up
+        unsigned uRowSize = ( 3*uWidth + 3 ) & ~3u;
+        unsigned uImageSize = uRowSize*uHeight;
+
+        // BITMAPFILEHEADER and BITMAPINFOHEADER
+        unsigned char Header[54];
+        memset( Header, 0, sizeof(Header) );
+        Header[0] = 'B';
+        Header[1] = 'M';
+        WriteLittleEndian( &Header[2], sizeof(Header) + uImageSize, 4 );    // bfSize
+        WriteLittleEndian( &Header[10], sizeof(Header), 4 );                // bfOffBits
+        WriteLittleEndian( &Header[14], 40, 4 );                            // biSize
+        WriteLittleEndian( &Header[18], uWidth, 4 );                        // biWidth
+        WriteLittleEndian( &Header[22], uHeight, 4 );                       // biHeight
+        WriteLittleEndian( &Header[26], 1, 2 );                             // biPlanes
+        WriteLittleEndian( &Header[28], 24, 2 );                            // biBitCount
+        WriteLittleEndian( &Header[34], uImageSize, 4 );                    // biSizeImage
+        if( fwrite( Header, sizeof(Header), 1, pFile ) != 1 )
+        {
+            return false;
+        }
+
+        std::vector<unsigned char> Row( uRowSize, 0 );
+        for( unsigned y = 0; y < uHeight; y++ )
+        {
+            const XMFLOAT4* pRow = pImage + ( uHeight - 1 - y )*uWidth;
+            for( unsigned x = 0; x < uWidth; x++ )
+            {
+                // BGR
+                Row[3*x + 0] = (unsigned char)( SaturateScalar( pRow[x].z )*255.f + 0.5f );
+                Row[3*x + 1] = (unsigned char)( SaturateScalar( pRow[x].y )*255.f + 0.5f );
+                Row[3*x + 2] = (unsigned char)( SaturateScalar( pRow[x].x )*255.f + 0.5f );
+            }
+
+            if( fwrite( &Row[0], uRowSize, 1, pFile ) != 1 )
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
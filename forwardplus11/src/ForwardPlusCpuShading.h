@@ -0,0 +1,153 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusCpuShading.h
+//
+// CPU version of RenderScenePS, for rendering frames offline and checking the lighting
+// without a GPU. It shades G-buffer-like inputs (the world-space position, normal and
+// tangent of each pixel, and what the two textures return for it) with the same math
+// as the shader: the normal map through the tangent frame, the fake inverse squared 
+// falloff, the radial attenuation of the spot lights, specular power 8, and the blend 
+// between the ambient up and down colors. The pixels of a tile loop over its light list 
+// (or over all the lights), like USE_LIGHT_CULLING.
+//
+// The SSE2 kernel shades 4 pixels of a tile at once, evaluating the same expressions in 
+// the same order as the scalar one, so both write the same image. The AVX2 kernel shades 
+// 8 pixels at once against the whole list, with approximate square roots and divisions 
+// (refined with a Newton-Raphson step), so it is close to the other two but not the same.
+// pow(x,8) is three squarings, and the shader's normalize is v*(1/sqrt(dot(v,v))), so 
+// the result can differ from the GPU in the last bits; compare with a tolerance.
+//
+// Has no dependencies on D3D or DXUT, so that it can be used headless.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ForwardPlusSpotCones.h"
+
+#include <DirectXMath.h>
+#include <stdio.h>
+#include <vector>
+
+namespace ForwardPlus11
+{
+    enum CpuShadingKernel
+    {
+        CPU_SHADING_KERNEL_AUTO = 0,    // the fastest one the CPU supports
+        CPU_SHADING_KERNEL_SCALAR,
+        CPU_SHADING_KERNEL_SSE2,        // 4 pixels at a time
+        CPU_SHADING_KERNEL_AVX2,        // 8 pixels at a time, with rsqrt and rcp approximations
+        CPU_SHADING_KERNEL_COUNT
+    };
+
+    //--------------------------------------------------------------------------------------
+    // Everything RenderScenePS reads, in CPU form.
+    //
+    // The G-buffer has uWidth*uHeight pixels, in rows of uWidth. Pixels with a depth of 0 
+    // (the cleared inverted depth, i.e. sky) are not shaded. The normal map and diffuse 
+    // samples are what g_TxNormal and g_TxDiffuse return for the pixel, in [0,1].
+    //
+    // The light colors are packed like g_PointLightBufferColor (DXGI_FORMAT_R8G8B8A8_UNORM, 
+    // red in the low byte). The spot lights also need their packed parameters.
+    //
+    // When pLightIndexBuffer is not NULL, it holds the per-tile lists in the fixed-slot 
+    // layout of g_PerTileLightIndexBuffer (uMaxNumLightsPerTile entries per tile of 
+    // uTileRes pixels, see CpuLightCuller::GetLightIndexBuffer). Otherwise every pixel 
+    // loops over all the lights, like USE_LIGHT_CULLING == 0.
+    //
+    // pTileAmbient (if not NULL, with pLightIndexBuffer) holds a color per tile that is 
+    // added to the ambient of its pixels: the lights the culling dropped from the tile's 
+    // list and merged into its ambient instead (see CpuLightCuller::GetTileAmbient).
+    //
+    // With bAlphaTest (like USE_ALPHA_TEST == 1), pixels whose diffuse alpha is below 
+    // fAlphaTest are discarded, and there is no specular (the alpha is the specular 
+    // mask otherwise).
+    //--------------------------------------------------------------------------------------
+    struct CpuShadingDesc
+    {
+        unsigned                    uWidth;
+        unsigned                    uHeight;
+        const float*                pDepth;
+        const DirectX::XMFLOAT3*    pPositionWS;
+        const DirectX::XMFLOAT3*    pNormalWS;                  // the interpolated vertex normal
+        const DirectX::XMFLOAT3*    pTangentWS;
+        const DirectX::XMFLOAT3*    pNormalMapSample;
+        const DirectX::XMFLOAT4*    pDiffuseSample;
+
+        DirectX::XMFLOAT3           vCameraPos;
+        DirectX::XMFLOAT4           AmbientColorUp;
+        DirectX::XMFLOAT4           AmbientColorDown;
+        bool                        bAlphaTest;
+        float                       fAlphaTest;
+
+        const DirectX::XMFLOAT4*    pPointLightCenterAndRadius;
+        const unsigned*             pPointLightColor;
+        unsigned                    uNumPointLights;
+        const DirectX::XMFLOAT4*    pSpotLightCenterAndRadius;
+        const unsigned*             pSpotLightColor;
+        const SpotParams*           pSpotLightSpotParams;
+        unsigned                    uNumSpotLights;
+
+        const unsigned*             pLightIndexBuffer;          // NULL to loop over all the lights
+        unsigned                    uTileRes;
+        unsigned                    uMaxNumLightsPerTile;
+        const DirectX::XMFLOAT3*    pTileAmbient;               // NULL for none
+    };
+
+    // Shades every pixel of Desc into pOutput (uWidth*uHeight colors, alpha 1 for the 
+    // shaded pixels, and all 0 for the ones that are not), spreading the tiles across 
+    // uNumThreads threads (0 means one per hardware thread)
+    void ShadeFrame( const CpuShadingDesc& Desc, CpuShadingKernel eKernel, unsigned uNumThreads, DirectX::XMFLOAT4* pOutput );
+
+    // Runtime ISA dispatch, like ResolveCpuCullKernel
+    CpuShadingKernel ResolveCpuShadingKernel( CpuShadingKernel eKernel );
+    const char* GetCpuShadingKernelName( CpuShadingKernel eKernel );
+
+    //--------------------------------------------------------------------------------------
+    // Comparing a frame against a golden one: the pixels where any channel is off by more 
+    // than the tolerance, and the largest and mean (over all channels) absolute errors
+    //--------------------------------------------------------------------------------------
+    struct ImageDiff
+    {
+        unsigned    uNumPixels;
+        unsigned    uNumPixelsOverTolerance;
+        float       fMaxError;
+        double      fMeanError;
+    };
+
+    void CompareImages( const DirectX::XMFLOAT4* pImage, const DirectX::XMFLOAT4* pGolden, unsigned uNumPixels, float fTolerance, ImageDiff* pDiff );
+
+    // Writes a frame as a float RGB PFM (lossless, for golden images), or reads one back. 
+    // Returns false if writing or reading failed (or the file is not a PFM ReadImagePfm 
+    // understands: 3 channels, little endian). The alpha of what is read back is 1.
+    bool WriteImagePfm( FILE* pFile, unsigned uWidth, unsigned uHeight, const DirectX::XMFLOAT4* pImage );
+    bool ReadImagePfm( FILE* pFile, unsigned* pWidth, unsigned* pHeight, std::vector<DirectX::XMFLOAT4>& Image );
+
+    // Writes a frame as a 24-bit BMP (clamped to [0,1]), for looking at. Returns false if writing failed.
+    bool WriteImageBmp( FILE* pFile, unsigned uWidth, unsigned uHeight, const DirectX::XMFLOAT4* pImage );
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,362 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusCullingQuality.cpp
+//
+// Scoring the light lists against the lights that actually affect each pixel.
+//--------------------------------------------------------------------------------------
+
+#include "ForwardPlusCullingQuality.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+using namespace DirectX;
+using namespace ForwardPlus11;
+
+//-----------------------------------------------------------------------------------------
+// Helper functions
+//-----------------------------------------------------------------------------------------
+
+// The weather radar colors of kRadarColors in ForwardPlus11DebugDraw.hlsl, as 8-bit RGB
+static const unsigned char RADAR_COLORS[14][3] =
+{
+    { 0, 236, 236 },    // cyan
+    { 0, 160, 246 },    // light blue
+    { 0, 0, 246 },      // blue
+    { 0, 255, 0 },      // bright green
+    { 0, 200, 0 },      // green
+    { 0, 144, 0 },      // dark green
+    { 255, 255, 0 },    // yellow
+    { 231, 192, 0 },    // yellow-orange
+    { 255, 144, 0 },    // orange
+    { 255, 0, 0 },      // bright red
+    { 214, 0, 0 },      // red
+    { 192, 0, 0 },      // dark red
+    { 255, 0, 255 },    // magenta
+    { 153, 85, 201 },   // purple
+};
+
+// mul( float4(p.xyz,1), m ).xyz, keeping the radius in w
+static XMFLOAT4 TransformSphere( const XMFLOAT4& p, const XMFLOAT4X4& m )
+{
+    return XMFLOAT4( p.x*m._11 + p.y*m._21 + p.z*m._31 + m._41,
+                     p.x*m._12 + p.y*m._22 + p.z*m._32 + m._42,
+                     p.x*m._13 + p.y*m._23 + p.z*m._33 + m._43, p.w );
+}
+
+// mul( float4(d.xyz,0), m ).xyz
+static XMFLOAT3 TransformDirection( const XMFLOAT3& d, const XMFLOAT4X4& m )
+{
+    return XMFLOAT3( d.x*m._11 + d.y*m._21 + d.z*m._31,
+                     d.x*m._12 + d.y*m._22 + d.z*m._32,
+                     d.x*m._13 + d.y*m._23 + d.z*m._33 );
+}
+
+// whether a point light affects a view-space position, like RenderScenePS
+static bool IsLitByPointLight( const XMFLOAT4& CenterAndRadius, const XMFLOAT3& vPosition )
+{
+    float dx = CenterAndRadius.x - vPosition.x;
+    float dy = CenterAndRadius.y - vPosition.y;
+    float dz = CenterAndRadius.z - vPosition.z;
+    return dx*dx + dy*dy + dz*dz < CenterAndRadius.w*CenterAndRadius.w;
+}
+
+// whether a spot light affects a view-space position, like RenderScenePS (the cone 
+// starts the bounding sphere radius behind the center, see ForwardPlusSpotCones.h)
+static bool IsLitBySpotLight( const XMFLOAT4& CenterAndRadius, const SpotLightCone& Cone, const XMFLOAT3& vPosition )
+{
+    float fToLightX = CenterAndRadius.x - CenterAndRadius.w*Cone.vLightDir.x - vPosition.x;
+    float fToLightY = CenterAndRadius.y - CenterAndRadius.w*Cone.vLightDir.y - vPosition.y;
+    float fToLightZ = CenterAndRadius.z - CenterAndRadius.w*Cone.vLightDir.z - vPosition.z;
+    float fLightDistance = sqrtf( fToLightX*fToLightX + fToLightY*fToLightY + fToLightZ*fToLightZ );
+    float fCosineOfCurrentConeAngle = -( fToLightX*Cone.vLightDir.x + fToLightY*Cone.vLightDir.y + fToLightZ*Cone.vLightDir.z ) / fLightDistance;
+    return fLightDistance < Cone.fFalloffRadius && fCosineOfCurrentConeAngle > Cone.fCosineOfConeAngle;
+}
+
+// a light (NULL cone for point lights, and for spot lights without their cones)
+static bool IsLit( const XMFLOAT4& CenterAndRadius, const SpotLightCone* pCone, const XMFLOAT3& vPosition )
+{
+    return pCone ? IsLitBySpotLight( CenterAndRadius, *pCone, vPosition ) : IsLitByPointLight( CenterAndRadius, vPosition );
+}
+
+// The lights whose bounding spheres touch a view-space box. Everything a light affects 
+// is inside its bounding sphere, so only these can affect the pixels in the box. The 
+// radius is grown by a little, so that rounding cannot lose a light.
+static void GatherLightsTouchingBox( const std::vector<XMFLOAT4>& Lights, const XMFLOAT3& vMin, const XMFLOAT3& vMax, std::vector<unsigned>& Candidates )
+{
+    Candidates.clear();
+    for( unsigned i = 0; i < (unsigned)Lights.size(); i++ )
+    {
+        const XMFLOAT4& Light = Lights[i];
+        float dx = ( Light.x < vMin.x ) ? vMin.x - Light.x : ( ( Light.x > vMax.x ) ? Light.x - vMax.x : 0.f );
+        float dy = ( Light.y < vMin.y ) ? vMin.y - Light.y : ( ( Light.y > vMax.y ) ? Light.y - vMax.y : 0.f );
+        float dz = ( Light.z < vMin.z ) ? vMin.z - Light.z : ( ( Light.z > vMax.z ) ? Light.z - vMax.z : 0.f );
+        float fRadius = 1.01f*Light.w;
+        if( dx*dx + dy*dy + dz*dz < fRadius*fRadius )
+        {
+            Candidates.push_back( i );
+        }
+    }
+}
+
+static void WriteLittleEndian( unsigned char* pBytes, unsigned uValue, unsigned uNumBytes )
+{
+    for( unsigned i = 0; i < uNumBytes; i++ )
+    {
+        pBytes[i] = (unsigned char)( uValue >> ( 8*i ) );
+    }
+}
+
+namespace ForwardPlus11
+{
+
+    //--------------------------------------------------------------------------------------
+    // Score the lists of a culling variant
+    //--------------------------------------------------------------------------------------
+    void AnalyzeCullingQuality( const CpuLightCullDesc& Desc, const SpotParams* pSpotLightSpotParams, 
+                                const CpuLightCuller& Culler, CullingQualityReport* pReport )
+    {
+        assert( Desc.pDepthBuffer != NULL );
+
+        unsigned uWidth = Desc.uWindowWidth;
+        unsigned uHeight = Desc.uWindowHeight;
+        unsigned uPitch = ( Desc.uDepthBufferPitch != 0 ) ? Desc.uDepthBufferPitch : uWidth;
+        unsigned uNumSamples = ( Desc.uDepthBufferNumSamples != 0 ) ? Desc.uDepthBufferNumSamples : 1;
+        const XMFLOAT4X4& ProjectionInv = Desc.mProjectionInv;
+
+        // the lights in view space, where the culling happens
+        std::vector<XMFLOAT4> Lights[2];
+        Lights[0].resize( Desc.uNumPointLights );
+        for( unsigned i = 0; i < Desc.uNumPointLights; i++ )
+        {
+            Lights[0][i] = TransformSphere( Desc.pPointLightCenterAndRadius[i], Desc.mWorldView );
+        }
+        Lights[1].resize( Desc.uNumSpotLights );
+        std::vector<SpotLightCone> SpotCones( pSpotLightSpotParams ? Desc.uNumSpotLights : 0 );
+        for( unsigned i = 0; i < Desc.uNumSpotLights; i++ )
+        {
+            Lights[1][i] = TransformSphere( Desc.pSpotLightCenterAndRadius[i], Desc.mWorldView );
+            if( pSpotLightSpotParams )
+            {
+                UnpackSpotParams( pSpotLightSpotParams[i], &SpotCones[i] );
+                SpotCones[i].vLightDir = TransformDirection( SpotCones[i].vLightDir, Desc.mWorldView );
+            }
+        }
+
+        pReport->uWidth = uWidth;
+        pReport->uHeight = uHeight;
+        pReport->uNumPixels = 0;
+        pReport->uMaxWastedEvaluations = 0;
+        pReport->uNumMissedLights = 0;
+        pReport->NumListedLights.assign( uWidth*uHeight, 0 );
+        pReport->NumWastedEvaluations.assign( uWidth*uHeight, 0 );
+
+        double fTotalNumListedLights = 0.0;
+        double fTotalNumExactLights = 0.0;
+        double fTotalNumWastedEvaluations = 0.0;
+
+        unsigned uTileRes = Culler.GetTileRes();
+        unsigned uNumTilesX = Culler.GetNumTilesX();
+        unsigned uNumTilesY = Culler.GetNumTilesY();
+        std::vector<XMFLOAT3> Positions;
+        std::vector<unsigned> PixelIndices;
+        std::vector<unsigned> Candidates[2];
+        for( unsigned uTileY = 0; uTileY < uNumTilesY; uTileY++ )
+        {
+            for( unsigned uTileX = 0; uTileX < uNumTilesX; uTileX++ )
+            {
+                // the view-space positions of the shaded pixels of the tile, placed the 
+                // way the tile frustums see them: they map the window, rounded up to 
+                // whole tiles, onto [-1,1] (see CalculateTileFrustum)
+                Positions.clear();
+                PixelIndices.clear();
+                XMFLOAT3 vMin( 0.f, 0.f, 0.f ), vMax( 0.f, 0.f, 0.f );
+                unsigned uEndX = ( ( uTileX + 1 )*uTileRes < uWidth ) ? ( uTileX + 1 )*uTileRes : uWidth;
+                unsigned uEndY = ( ( uTileY + 1 )*uTileRes < uHeight ) ? ( uTileY + 1 )*uTileRes : uHeight;
+                for( unsigned y = uTileY*uTileRes; y < uEndY; y++ )
+                {
+                    for( unsigned x = uTileX*uTileRes; x < uEndX; x++ )
+                    {
+                        float fDepth = Desc.pDepthBuffer[( y*uPitch + x )*uNumSamples];
+                        if( fDepth == 0.f )
+                        {
+                            // sky, not shaded
+                            continue;
+                        }
+
+                        float fViewZ = 1.f / ( fDepth*ProjectionInv._34 + ProjectionInv._44 );
+                        float fViewX = ( 2.f*( (float)x + 0.5f ) / (float)( uTileRes*uNumTilesX ) - 1.f )*ProjectionInv._11*fViewZ;
+                        float fViewY = ( 1.f - 2.f*( (float)y + 0.5f ) / (float)( uTileRes*uNumTilesY ) )*ProjectionInv._22*fViewZ;
+                        XMFLOAT3 vPosition( fViewX, fViewY, fViewZ );
+                        if( Positions.empty() )
+                        {
+                            vMin = vMax = vPosition;
+                        }
+                        vMin = XMFLOAT3( ( fViewX < vMin.x ) ? fViewX : vMin.x, ( fViewY < vMin.y ) ? fViewY : vMin.y, ( fViewZ < vMin.z ) ? fViewZ : vMin.z );
+                        vMax = XMFLOAT3( ( fViewX > vMax.x ) ? fViewX : vMax.x, ( fViewY > vMax.y ) ? fViewY : vMax.y, ( fViewZ > vMax.z ) ? fViewZ : vMax.z );
+                        Positions.push_back( vPosition );
+                        PixelIndices.push_back( y*uWidth + x );
+                    }
+                }
+
+                if( Positions.empty() )
+                {
+                    continue;
+                }
+
+                GatherLightsTouchingBox( Lights[0], vMin, vMax, Candidates[0] );
+                GatherLightsTouchingBox( Lights[1], vMin, vMax, Candidates[1] );
+
+                unsigned uTileIdx = uTileX + uTileY*uNumTilesX;
+                for( unsigned uPixel = 0; uPixel < (unsigned)Positions.size(); uPixel++ )
+                {
+                    const XMFLOAT3& vPosition = Positions[uPixel];
+                    unsigned uListIdx = Desc.pClusterConfig ? Culler.GetClusterIndex( uTileIdx, GetClusterSlice( *Desc.pClusterConfig, vPosition.z ) ) : uTileIdx;
+                    unsigned uNumListedLights = Culler.GetNumPointLightsInTile( uListIdx ) + Culler.GetNumSpotLightsInTile( uListIdx );
+
+                    // lists that overflowed are missing lights by design
+                    bool bListIsFull = ( uNumListedLights + 2 >= Culler.GetMaxNumLightsPerList() );
+
+                    unsigned uNumUsefulLights = 0;
+                    unsigned uNumExactLights = 0;
+                    for( int nType = 0; nType < 2; nType++ )
+                    {
+                        const unsigned* pList = nType ? Culler.GetSpotLightsInTile( uListIdx ) : Culler.GetPointLightsInTile( uListIdx );
+                        unsigned uNumLightsInList = nType ? Culler.GetNumSpotLightsInTile( uListIdx ) : Culler.GetNumPointLightsInTile( uListIdx );
+                        bool bUseCones = ( nType != 0 ) && ( pSpotLightSpotParams != NULL );
+
+                        // what the pixel shader loops over
+                        for( unsigned i = 0; i < uNumLightsInList; i++ )
+                        {
+                            unsigned uLightIdx = pList[i];
+                            uNumUsefulLights += IsLit( Lights[nType][uLightIdx], bUseCones ? &SpotCones[uLightIdx] : NULL, vPosition ) ? 1 : 0;
+                        }
+
+                        // what it should have looped over
+                        const std::vector<unsigned>& LightsTouchingTile = Candidates[nType];
+                        for( unsigned i = 0; i < (unsigned)LightsTouchingTile.size(); i++ )
+                        {
+                            unsigned uLightIdx = LightsTouchingTile[i];
+                            if( IsLit( Lights[nType][uLightIdx], bUseCones ? &SpotCones[uLightIdx] : NULL, vPosition ) )
+                            {
+                                uNumExactLights++;
+                                bool bListed = std::binary_search( pList, pList + uNumLightsInList, uLightIdx );
+                                pReport->uNumMissedLights += ( !bListed && !bListIsFull ) ? 1 : 0;
+                            }
+                        }
+                    }
+
+                    unsigned uNumWastedEvaluations = uNumListedLights - uNumUsefulLights;
+                    pReport->NumListedLights[PixelIndices[uPixel]] = (unsigned short)( ( uNumListedLights < 0xffff ) ? uNumListedLights : 0xffff );
+                    pReport->NumWastedEvaluations[PixelIndices[uPixel]] = (unsigned short)( ( uNumWastedEvaluations < 0xffff ) ? uNumWastedEvaluations : 0xffff );
+                    pReport->uMaxWastedEvaluations = ( uNumWastedEvaluations > pReport->uMaxWastedEvaluations ) ? uNumWastedEvaluations : pReport->uMaxWastedEvaluations;
+                    pReport->uNumPixels++;
+
+                    fTotalNumListedLights += uNumListedLights;
+                    fTotalNumExactLights += uNumExactLights;
+                    fTotalNumWastedEvaluations += uNumWastedEvaluations;
+                }
+            }
+        }
+
+        double fNumPixels = ( pReport->uNumPixels > 0 ) ? (double)pReport->uNumPixels : 1.0;
+        pReport->fListedLightsPerPixel = fTotalNumListedLights / fNumPixels;
+        pReport->fExactLightsPerPixel = fTotalNumExactLights / fNumPixels;
+        pReport->fWastedEvaluationsPerPixel = fTotalNumWastedEvaluations / fNumPixels;
+        pReport->fFalsePositiveRate = ( fTotalNumListedLights > 0.0 ) ? fTotalNumWastedEvaluations / fTotalNumListedLights : 0.0;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Write per-pixel counts as a heat map
+    //--------------------------------------------------------------------------------------
+    bool WriteHeatMapBmp( FILE* pFile, unsigned uWidth, unsigned uHeight, const unsigned short* pValues, unsigned uMaxValue )
+    {
+        // BMP rows are padded to 4 bytes, and stored bottom-up
+        unsigned uRowSize = ( 3*uWidth + 3 ) & ~3u;
+        unsigned uImageSize = uRowSize*uHeight;
+
+        // BITMAPFILEHEADER and BITMAPINFOHEADER
+        unsigned char Header[54];
+        memset( Header, 0, sizeof(Header) );
+        Header[0] = 'B';
+        Header[1] = 'M';
+        WriteLittleEndian( &Header[2], sizeof(Header) + uImageSize, 4 );    // bfSize
+        WriteLittleEndian( &Header[10], sizeof(Header), 4 );                // bfOffBits
+        WriteLittleEndian( &Header[14], 40, 4 );                            // biSize
+        WriteLittleEndian( &Header[18], uWidth, 4 );                        // biWidth
+        WriteLittleEndian( &Header[22], uHeight, 4 );                       // biHeight
+        WriteLittleEndian( &Header[26], 1, 2 );                             // biPlanes
+        WriteLittleEndian( &Header[28], 24, 2 );                            // biBitCount
+        WriteLittleEndian( &Header[34], uImageSize, 4 );                    // biSizeImage
+        if( fwrite( Header, sizeof(Header), 1, pFile ) != 1 )
+        {
+            return false;
+        }
+
+        // like DebugDrawNumLightsPerTileRadarColorsPS, the log base b is the one 
+        // that makes logb of the max value 14 (because there are 14 radar colors)
+        float fInvLogBase = ( uMaxValue > 1 ) ? 14.f / logf( (float)uMaxValue ) : 0.f;
+
+        std::vector<unsigned char> Row( uRowSize, 0 );
+        for( unsigned y = 0; y < uHeight; y++ )
+        {
+            const unsigned short* pRowValues = pValues + ( uHeight - 1 - y )*uWidth;
+            for( unsigned x = 0; x < uWidth; x++ )
+            {
+                unsigned uValue = pRowValues[x];
+                unsigned char Color[3] = { 0, 0, 0 };   // black for 0
+                if( uValue >= uMaxValue )
+                {
+                    // white for reaching the max
+                    Color[0] = Color[1] = Color[2] = 255;
+                }
+                else if( uValue > 0 )
+                {
+                    unsigned uColorIdx = (unsigned)( logf( (float)uValue )*fInvLogBase );
+                    uColorIdx = ( uColorIdx < 13 ) ? uColorIdx : 13;
+                    memcpy( Color, RADAR_COLORS[uColorIdx], sizeof(Color) );
+                }
+
+                // BGR
+                Row[3*x + 0] = Color[2];
+                Row[3*x + 1] = Color[1];
+                Row[3*x + 2] = Color[0];
+            }
+
+            if( fwrite( &Row[0], uRowSize, 1, pFile ) != 1 )
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,86 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusCullingQuality.h
+//
+// Scoring how tight the light lists of a culling variant are. For every shaded pixel
+// of a depth buffer, the lights that actually affect it are found the way RenderScenePS
+// decides it (inside the radius of a point light, inside the falloff radius and the
+// cone of a spot light), and compared against the list the pixel loops over. Every
+// listed light that does not affect the pixel is a wasted evaluation, a false positive
+// of the culling.
+//
+// It takes the same inputs as the culling (a CpuLightCullDesc) and the CpuLightCuller
+// that culled them, so every variant (tile size, depth bounds, depth mask, spot cones,
+// coarse tiles, clusters) can be scored against the same scene. It has no dependencies
+// on D3D or DXUT, like the CPU culler.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ForwardPlusCpuCuller.h"
+
+#include <stdio.h>
+#include <vector>
+
+namespace ForwardPlus11
+{
+    //--------------------------------------------------------------------------------------
+    // The result of AnalyzeCullingQuality. The per-pixel counts are in rows of 
+    // uWindowWidth pixels, and are 0 for the sky (cleared depth), which is not shaded.
+    //--------------------------------------------------------------------------------------
+    struct CullingQualityReport
+    {
+        unsigned                    uWidth;
+        unsigned                    uHeight;
+        unsigned                    uNumPixels;                 // shaded (non-sky) pixels
+        double                      fListedLightsPerPixel;      // mean length of the list a pixel loops over
+        double                      fExactLightsPerPixel;       // mean number of lights that affect a pixel
+        double                      fWastedEvaluationsPerPixel; // mean number of listed lights that do not
+        double                      fFalsePositiveRate;         // wasted evaluations over listed lights
+        unsigned                    uMaxWastedEvaluations;      // in any one pixel
+        unsigned                    uNumMissedLights;           // pixel and light pairs that the light affects, but whose
+                                                                // list (unless it overflowed) does not have the light, i.e.
+                                                                // culling errors, which must be 0
+        std::vector<unsigned short> NumListedLights;            // per pixel
+        std::vector<unsigned short> NumWastedEvaluations;       // per pixel
+    };
+
+    // Scores the lists Culler made from Desc. pSpotLightSpotParams (one per spot light, 
+    // like CpuLightCullDesc::pSpotLightSpotParams) gives the spot light cones; it is 
+    // needed even when the culling only used the bounding spheres (when it is NULL, a 
+    // spot light is taken to affect its whole bounding sphere). Desc must have a depth 
+    // buffer; the first sample of each pixel is scored with MSAA.
+    void AnalyzeCullingQuality( const CpuLightCullDesc& Desc, const SpotParams* pSpotLightSpotParams, 
+                                const CpuLightCuller& Culler, CullingQualityReport* pReport );
+
+    // Writes per-pixel counts as a 24-bit BMP heat map, using the weather radar colors 
+    // of DebugDrawNumLightsPerTileRadarColorsPS on a log scale up to uMaxValue (black for 
+    // 0, white for uMaxValue and above). Returns false if writing failed.
+    bool WriteHeatMapBmp( FILE* pFile, unsigned uWidth, unsigned uHeight, const unsigned short* pValues, unsigned uMaxValue );
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,408 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusHalf.cpp
+//
+// Conversions between single-precision and half-precision floats.
+//--------------------------------------------------------------------------------------
+
+#include "ForwardPlusHalf.h"
+#include "ForwardPlusCpuCullKernels.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define HALF_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define HALF_X86 0
+#endif
+
+// MSVC lets any function use any intrinsic, GCC and clang
+// need to be told which functions may use which instruction sets
+#if HALF_X86 && defined(__GNUC__)
+#define HALF_TARGET_SSE2 __attribute__((target("sse2")))
+#define HALF_TARGET_F16C __attribute__((target("avx,f16c")))
+#else
+#define HALF_TARGET_SSE2
+#define HALF_TARGET_F16C
+#endif
+
+// Bits of the single-precision magnitudes where the half-precision ranges start
+static const unsigned F32_BITS_HALF_MIN_NORMAL = ( 127 - 14 ) << 23;    // 2^-14
+static const unsigned F32_BITS_HALF_OVERFLOW = ( 127 + 16 ) << 23;      // 2^16, the first value too big to truncate to a half
+static const unsigned F32_BITS_INFINITY = 0x7F800000u;
+
+// What gets subtracted from the single-precision exponent to make a half-precision one
+static const unsigned F32_TO_F16_EXPONENT_BIAS = ( 127 - 15 ) << 23;
+
+namespace ForwardPlus11
+{
+
+    //--------------------------------------------------------------------------------------
+    // Convert single-precision float to half-precision float
+    //--------------------------------------------------------------------------------------
+    unsigned short ConvertF32ToF16( float fValue, HalfRounding eRounding )
+    {
+        unsigned uFloatBits;
+        memcpy( &uFloatBits, &fValue, sizeof(uFloatBits) );
+
+        unsigned uSignBit = ( uFloatBits & 0x80000000u ) >> 16;
+        unsigned uAbsBits = uFloatBits & 0x7FFFFFFFu;
+        bool bNearestEven = ( eRounding == HALF_ROUND_NEAREST_EVEN );
+
+        if( uAbsBits >= F32_BITS_INFINITY )
+        {
+            // infinity, or NaN made quiet, keeping the top of the payload
+            unsigned uNaNBits = ( uAbsBits > F32_BITS_INFINITY ) ? 0x200u | ( ( uAbsBits >> 13 ) & 0x3FFu ) : 0;
+            return (unsigned short)( uSignBit | 0x7C00u | uNaNBits );
+        }
+
+        if( uAbsBits >= F32_BITS_HALF_OVERFLOW )
+        {
+            return (unsigned short)( uSignBit | ( bNearestEven ? 0x7C00u : 0x7BFFu ) );
+        }
+
+        unsigned uHalfBits;
+        unsigned uRemainder;
+        unsigned uHalfway;
+        if( uAbsBits >= F32_BITS_HALF_MIN_NORMAL )
+        {
+            // normalized: rebias the exponent and drop 13 bits of mantissa
+            uHalfBits = ( uAbsBits - F32_TO_F16_EXPONENT_BIAS ) >> 13;
+            uRemainder = uAbsBits & 0x1FFFu;
+            uHalfway = 0x1000u;
+        }
+        else
+        {
+            // denormalized, in steps of 2^-24: shift the mantissa, with its implicit one, 
+            // right by however many bits the exponent is short (anything 25 or more 
+            // bits short, single-precision denormals included, is less than half a step)
+            unsigned uExponent = uAbsBits >> 23;
+            unsigned uShift = 126 - uExponent;
+            if( uExponent == 0 || uShift > 24 )
+            {
+                return (unsigned short)uSignBit;
+            }
+
+            unsigned uMantissa = ( uAbsBits & 0x007FFFFFu ) | 0x00800000u;
+            uHalfBits = uMantissa >> uShift;
+            uRemainder = uMantissa & ( ( 1u << uShift ) - 1 );
+            uHalfway = 1u << ( uShift - 1 );
+        }
+
+        // round to nearest even (which may carry into the exponent, up to infinity)
+        if( bNearestEven && ( uRemainder > uHalfway || ( uRemainder == uHalfway && ( uHalfBits & 1 ) ) ) )
+        {
+            uHalfBits++;
+        }
+
+        return (unsigned short)( uSignBit | uHalfBits );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Convert half-precision float to single-precision float
+    //--------------------------------------------------------------------------------------
+    float ConvertF16ToF32( unsigned short uHalf )
+    {
+        unsigned uSignBit = ( (unsigned)uHalf & 0x8000u ) << 16;
+        unsigned uExponent = ( (unsigned)uHalf >> 10 ) & 0x1Fu;
+        unsigned uMantissa = (unsigned)uHalf & 0x3FFu;
+
+        unsigned uFloatBits;
+        if( uExponent == 0x1Fu )
+        {
+            // infinity, or NaN made quiet
+            uFloatBits = uSignBit | F32_BITS_INFINITY | ( uMantissa << 13 ) | ( uMantissa != 0 ? 0x00400000u : 0 );
+        }
+        else if( uExponent != 0 )
+        {
+            uFloatBits = uSignBit | ( ( uExponent - 15 + 127 ) << 23 ) | ( uMantissa << 13 );
+        }
+        else if( uMantissa != 0 )
+        {
+            // denormalized, so normalize it
+            int nExponent = 1 - 15 + 127;
+            while( ( uMantissa & 0x400u ) == 0 )
+            {
+                uMantissa <<= 1;
+                nExponent--;
+            }
+            uFloatBits = uSignBit | ( (unsigned)nExponent << 23 ) | ( ( uMantissa & 0x3FFu ) << 13 );
+        }
+        else
+        {
+            uFloatBits = uSignBit;
+        }
+
+        float fValue;
+        memcpy( &fValue, &uFloatBits, sizeof(fValue) );
+        return fValue;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Whole-array scalar kernels
+    //--------------------------------------------------------------------------------------
+    static void ConvertF32ToF16Scalar( const float* pSrc, unsigned short* pDst, unsigned uCount, HalfRounding eRounding )
+    {
+        for( unsigned i = 0; i < uCount; i++ )
+        {
+            pDst[i] = ConvertF32ToF16( pSrc[i], eRounding );
+        }
+    }
+
+    static void ConvertF16ToF32Scalar( const unsigned short* pSrc, float* pDst, unsigned uCount )
+    {
+        for( unsigned i = 0; i < uCount; i++ )
+        {
+            pDst[i] = ConvertF16ToF32( pSrc[i] );
+        }
+    }
+
+#if HALF_X86
+
+    //--------------------------------------------------------------------------------------
+    // SSE2 kernels: the scalar conversions, 4 lanes at a time. There are no variable 
+    // shifts, so the denormalized halves go through the float-to-int conversion 
+    // (exact, as they are whole multiples of 2^-24); it rounds by MXCSR, which is 
+    // left at its default of round to nearest even.
+    //--------------------------------------------------------------------------------------
+    HALF_TARGET_SSE2 static __m128i SelectSSE2( __m128i vMask, __m128i vTrue, __m128i vFalse )
+    {
+        return _mm_or_si128( _mm_and_si128( vMask, vTrue ), _mm_andnot_si128( vMask, vFalse ) );
+    }
+
+    // Returns the halves in the low 16 bits of each 32-bit lane
+    HALF_TARGET_SSE2 static __m128i ConvertF32ToF16SSE2( __m128 vValue, bool bNearestEven )
+    {
+        __m128i vBits = _mm_castps_si128( vValue );
+        __m128i vAbsBits = _mm_and_si128( vBits, _mm_set1_epi32( 0x7FFFFFFF ) );
+        __m128i vSignBit = _mm_srli_epi32( _mm_andnot_si128( _mm_set1_epi32( 0x7FFFFFFF ), vBits ), 16 );
+
+        // normalized, rounding by adding just under half a step, plus one more if the 
+        // kept mantissa is odd (the carry can run up to infinity)
+        __m128i vNormal = _mm_sub_epi32( vAbsBits, _mm_set1_epi32( (int)F32_TO_F16_EXPONENT_BIAS ) );
+        if( bNearestEven )
+        {
+            __m128i vOdd = _mm_and_si128( _mm_srli_epi32( vAbsBits, 13 ), _mm_set1_epi32( 1 ) );
+            vNormal = _mm_add_epi32( vNormal, _mm_add_epi32( _mm_set1_epi32( 0xFFF ), vOdd ) );
+        }
+        vNormal = _mm_srli_epi32( vNormal, 13 );
+
+        // denormalized
+        __m128 vScaled = _mm_mul_ps( _mm_castsi128_ps( vAbsBits ), _mm_set1_ps( 16777216.f ) );
+        __m128i vDenormal = bNearestEven ? _mm_cvtps_epi32( vScaled ) : _mm_cvttps_epi32( vScaled );
+
+        // overflow, infinity and NaN
+        __m128i vIsNaN = _mm_cmpgt_epi32( vAbsBits, _mm_set1_epi32( (int)F32_BITS_INFINITY ) );
+        __m128i vIsInfinity = _mm_cmpeq_epi32( vAbsBits, _mm_set1_epi32( (int)F32_BITS_INFINITY ) );
+        __m128i vNaN = _mm_or_si128( _mm_set1_epi32( 0x7E00 ), _mm_and_si128( _mm_srli_epi32( vAbsBits, 13 ), _mm_set1_epi32( 0x3FF ) ) );
+        __m128i vOverflow = _mm_set1_epi32( bNearestEven ? 0x7C00 : 0x7BFF );
+        __m128i vSpecial = SelectSSE2( vIsNaN, vNaN, SelectSSE2( vIsInfinity, _mm_set1_epi32( 0x7C00 ), vOverflow ) );
+
+        __m128i vIsDenormal = _mm_cmplt_epi32( vAbsBits, _mm_set1_epi32( (int)F32_BITS_HALF_MIN_NORMAL ) );
+        __m128i vIsSpecial = _mm_cmpgt_epi32( vAbsBits, _mm_set1_epi32( (int)F32_BITS_HALF_OVERFLOW - 1 ) );
+        __m128i vResult = SelectSSE2( vIsSpecial, vSpecial, SelectSSE2( vIsDenormal, vDenormal, vNormal ) );
+        return _mm_or_si128( vResult, vSignBit );
+    }
+
+    // Takes the halves in the low 16 bits of each 32-bit lane
+    HALF_TARGET_SSE2 static __m128 ConvertF16ToF32SSE2( __m128i vHalf )
+    {
+        __m128i vAbsBits = _mm_and_si128( vHalf, _mm_set1_epi32( 0x7FFF ) );
+        __m128i vSignBit = _mm_slli_epi32( _mm_andnot_si128( _mm_set1_epi32( 0x7FFF ), vHalf ), 16 );
+        __m128i vShifted = _mm_slli_epi32( vAbsBits, 13 );
+
+        __m128i vNormal = _mm_add_epi32( vShifted, _mm_set1_epi32( (int)F32_TO_F16_EXPONENT_BIAS ) );
+        __m128i vDenormal = _mm_castps_si128( _mm_mul_ps( _mm_cvtepi32_ps( vAbsBits ), _mm_set1_ps( 1.f/16777216.f ) ) );
+        __m128i vIsNaN = _mm_cmpgt_epi32( vAbsBits, _mm_set1_epi32( 0x7C00 ) );
+        __m128i vSpecial = _mm_or_si128( _mm_or_si128( vShifted, _mm_set1_epi32( (int)F32_BITS_INFINITY ) ), _mm_and_si128( vIsNaN, _mm_set1_epi32( 0x00400000 ) ) );
+
+        __m128i vIsDenormal = _mm_cmplt_epi32( vAbsBits, _mm_set1_epi32( 0x400 ) );
+        __m128i vIsSpecial = _mm_cmpgt_epi32( vAbsBits, _mm_set1_epi32( 0x7BFF ) );
+        __m128i vResult = SelectSSE2( vIsSpecial, vSpecial, SelectSSE2( vIsDenormal, vDenormal, vNormal ) );
+        return _mm_castsi128_ps( _mm_or_si128( vResult, vSignBit ) );
+    }
+
+    HALF_TARGET_SSE2 static void ConvertF32ToF16SSE2( const float* pSrc, unsigned short* pDst, unsigned uCount, HalfRounding eRounding )
+    {
+        bool bNearestEven = ( eRounding == HALF_ROUND_NEAREST_EVEN );
+        unsigned i = 0;
+        for( ; i + 8 <= uCount; i += 8 )
+        {
+            __m128i vLo = ConvertF32ToF16SSE2( _mm_loadu_ps( &pSrc[i] ), bNearestEven );
+            __m128i vHi = ConvertF32ToF16SSE2( _mm_loadu_ps( &pSrc[i + 4] ), bNearestEven );
+
+            // sign extend, so that the signed saturating pack keeps all 16 bits
+            vLo = _mm_srai_epi32( _mm_slli_epi32( vLo, 16 ), 16 );
+            vHi = _mm_srai_epi32( _mm_slli_epi32( vHi, 16 ), 16 );
+            _mm_storeu_si128( (__m128i*)&pDst[i], _mm_packs_epi32( vLo, vHi ) );
+        }
+        ConvertF32ToF16Scalar( &pSrc[i], &pDst[i], uCount - i, eRounding );
+    }
+
+    HALF_TARGET_SSE2 static void ConvertF16ToF32SSE2( const unsigned short* pSrc, float* pDst, unsigned uCount )
+    {
+        unsigned i = 0;
+        for( ; i + 8 <= uCount; i += 8 )
+        {
+            __m128i vHalves = _mm_loadu_si128( (const __m128i*)&pSrc[i] );
+            _mm_storeu_ps( &pDst[i], ConvertF16ToF32SSE2( _mm_unpacklo_epi16( vHalves, _mm_setzero_si128() ) ) );
+            _mm_storeu_ps( &pDst[i + 4], ConvertF16ToF32SSE2( _mm_unpackhi_epi16( vHalves, _mm_setzero_si128() ) ) );
+        }
+        ConvertF16ToF32Scalar( &pSrc[i], &pDst[i], uCount - i );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // F16C kernels (the rounding mode is an immediate, so it is a template parameter)
+    //--------------------------------------------------------------------------------------
+    template <int ROUNDING>
+    HALF_TARGET_F16C static void ConvertF32ToF16F16C( const float* pSrc, unsigned short* pDst, unsigned uCount )
+    {
+        unsigned i = 0;
+        for( ; i + 8 <= uCount; i += 8 )
+        {
+            _mm_storeu_si128( (__m128i*)&pDst[i], _mm256_cvtps_ph( _mm256_loadu_ps( &pSrc[i] ), ROUNDING ) );
+        }
+        ConvertF32ToF16Scalar( &pSrc[i], &pDst[i], uCount - i, ROUNDING == _MM_FROUND_TO_ZERO ? HALF_ROUND_TOWARD_ZERO : HALF_ROUND_NEAREST_EVEN );
+    }
+
+    HALF_TARGET_F16C static void ConvertF16ToF32F16C( const unsigned short* pSrc, float* pDst, unsigned uCount )
+    {
+        unsigned i = 0;
+        for( ; i + 8 <= uCount; i += 8 )
+        {
+            _mm256_storeu_ps( &pDst[i], _mm256_cvtph_ps( _mm_loadu_si128( (const __m128i*)&pSrc[i] ) ) );
+        }
+        ConvertF16ToF32Scalar( &pSrc[i], &pDst[i], uCount - i );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // CPU feature detection: F16C, and the OS saving the YMM registers it works on
+    //--------------------------------------------------------------------------------------
+    static bool CpuSupportsF16C()
+    {
+#if defined(_MSC_VER)
+        int Info[4];
+        __cpuid( Info, 1 );
+        bool bOSXSAVE = ( Info[2] & ( 1 << 27 ) ) != 0;
+        bool bAVX = ( Info[2] & ( 1 << 28 ) ) != 0;
+        bool bF16C = ( Info[2] & ( 1 << 29 ) ) != 0;
+        return bOSXSAVE && bAVX && bF16C && ( _xgetbv( 0 ) & 6 ) == 6;
+#else
+        unsigned uEAX, uEBX, uECX, uEDX;
+        if( !__get_cpuid( 1, &uEAX, &uEBX, &uECX, &uEDX ) )
+        {
+            return false;
+        }
+        return ( uECX & ( 1u << 29 ) ) != 0 && __builtin_cpu_supports( "avx" ) != 0;
+#endif
+    }
+
+    static const bool g_bCpuSupportsF16C = CpuSupportsF16C();
+
+#endif // HALF_X86
+
+    //--------------------------------------------------------------------------------------
+    // Whole-array conversions
+    //--------------------------------------------------------------------------------------
+    void ConvertF32ToF16( const float* pSrc, unsigned short* pDst, unsigned uCount, HalfRounding eRounding, HalfConversionKernel eKernel )
+    {
+        switch( ResolveHalfConversionKernel( eKernel ) )
+        {
+#if HALF_X86
+        case HALF_CONVERSION_KERNEL_F16C:
+            if( eRounding == HALF_ROUND_TOWARD_ZERO )
+            {
+                ConvertF32ToF16F16C<_MM_FROUND_TO_ZERO>( pSrc, pDst, uCount );
+            }
+            else
+            {
+                ConvertF32ToF16F16C<_MM_FROUND_TO_NEAREST_INT>( pSrc, pDst, uCount );
+            }
+            break;
+        case HALF_CONVERSION_KERNEL_SSE2:
+            ConvertF32ToF16SSE2( pSrc, pDst, uCount, eRounding );
+            break;
+#endif
+        default:
+            ConvertF32ToF16Scalar( pSrc, pDst, uCount, eRounding );
+            break;
+        }
+    }
+
+    void ConvertF16ToF32( const unsigned short* pSrc, float* pDst, unsigned uCount, HalfConversionKernel eKernel )
+    {
+        switch( ResolveHalfConversionKernel( eKernel ) )
+        {
+#if HALF_X86
+        case HALF_CONVERSION_KERNEL_F16C:   ConvertF16ToF32F16C( pSrc, pDst, uCount ); break;
+        case HALF_CONVERSION_KERNEL_SSE2:   ConvertF16ToF32SSE2( pSrc, pDst, uCount ); break;
+#endif
+        default:                            ConvertF16ToF32Scalar( pSrc, pDst, uCount ); break;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Runtime ISA dispatch (the culling kernels already know about SSE2)
+    //--------------------------------------------------------------------------------------
+    HalfConversionKernel ResolveHalfConversionKernel( HalfConversionKernel eKernel )
+    {
+#if HALF_X86
+        if( ( eKernel == HALF_CONVERSION_KERNEL_AUTO || eKernel == HALF_CONVERSION_KERNEL_F16C ) && g_bCpuSupportsF16C )
+        {
+            return HALF_CONVERSION_KERNEL_F16C;
+        }
+        if( eKernel != HALF_CONVERSION_KERNEL_SCALAR && ResolveCpuCullKernel( CPU_CULL_KERNEL_SSE2 ) == CPU_CULL_KERNEL_SSE2 )
+        {
+            return HALF_CONVERSION_KERNEL_SSE2;
+        }
+#else
+        (void)eKernel;
+#endif
+        return HALF_CONVERSION_KERNEL_SCALAR;
+    }
+
+    const char* GetHalfConversionKernelName( HalfConversionKernel eKernel )
+    {
+        switch( eKernel )
+        {
+        case HALF_CONVERSION_KERNEL_AUTO:   return "Auto";
+        case HALF_CONVERSION_KERNEL_SCALAR: return "Scalar";
+        case HALF_CONVERSION_KERNEL_SSE2:   return "SSE2";
+        case HALF_CONVERSION_KERNEL_F16C:   return "F16C";
+        default:                            assert( false ); return "Unknown";
+        }
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
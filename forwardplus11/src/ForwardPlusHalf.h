@@ -0,0 +1,77 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusHalf.h
+//
+// Conversions between single-precision and half-precision (16-bit) floats, for the 
+// light data that goes to the GPU in half precision (see ForwardPlusSpotCones.h and 
+// ForwardPlusLightPacking.h), one value at a time or a whole array at a time.
+//
+// All kernels give the same bits as the F16C instructions (and so as the GPU): 
+// denormals are kept, infinities stay infinities, and NaNs come out quiet, 
+// keeping the top of their payload.
+//
+// Has no dependencies on D3D or DXUT, so that it can be used headless.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+namespace ForwardPlus11
+{
+    enum HalfRounding
+    {
+        HALF_ROUND_NEAREST_EVEN = 0,    // the IEEE default; overflows to infinity
+        HALF_ROUND_TOWARD_ZERO,         // never increases the magnitude; saturates at 65504
+    };
+
+    enum HalfConversionKernel
+    {
+        HALF_CONVERSION_KERNEL_AUTO = 0,    // the fastest one the CPU supports
+        HALF_CONVERSION_KERNEL_SCALAR,
+        HALF_CONVERSION_KERNEL_SSE2,        // 8 values at a time, in integer math
+        HALF_CONVERSION_KERNEL_F16C,        // 8 values at a time, with VCVTPS2PH and VCVTPH2PS
+        HALF_CONVERSION_KERNEL_COUNT
+    };
+
+    // Convert single-precision float to half-precision float
+    unsigned short ConvertF32ToF16( float fValue, HalfRounding eRounding = HALF_ROUND_NEAREST_EVEN );
+
+    // Convert half-precision float to single-precision float, exactly (like the 
+    // R16G16B16A16_FLOAT loads and f16tof32 in the shaders)
+    float ConvertF16ToF32( unsigned short uHalf );
+
+    // The same, for uCount values (the arrays need no particular alignment)
+    void ConvertF32ToF16( const float* pSrc, unsigned short* pDst, unsigned uCount, 
+                          HalfRounding eRounding = HALF_ROUND_NEAREST_EVEN, HalfConversionKernel eKernel = HALF_CONVERSION_KERNEL_AUTO );
+    void ConvertF16ToF32( const unsigned short* pSrc, float* pDst, unsigned uCount, HalfConversionKernel eKernel = HALF_CONVERSION_KERNEL_AUTO );
+
+    // Runtime ISA dispatch, like ResolveCpuCullKernel
+    HalfConversionKernel ResolveHalfConversionKernel( HalfConversionKernel eKernel );
+    const char* GetHalfConversionKernelName( HalfConversionKernel eKernel );
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,330 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusHiZ.cpp
+//
+// Min/max depth pyramid (Hi-Z) of the inverted-Z depth buffer.
+//--------------------------------------------------------------------------------------
+
+#include "ForwardPlusHiZ.h"
+#include "ForwardPlusParallel.h"
+
+#include <assert.h>
+#include <float.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define HIZ_X86 1
+#include <immintrin.h>
+#else
+#define HIZ_X86 0
+#endif
+
+// gcc and clang only allow intrinsics for instruction sets enabled for the function
+#if HIZ_X86 && defined(__GNUC__)
+#define HIZ_TARGET_SSE2 __attribute__((target("sse2")))
+#else
+#define HIZ_TARGET_SSE2
+#endif
+
+// the cells of the first level, and how many of them there are across a block
+static const unsigned HIZ_CELL_RES = 1 << ForwardPlus11::HIZ_FIRST_LEVEL;
+static const unsigned HIZ_CELLS_PER_BLOCK = ForwardPlus11::HIZ_BLOCK_RES / HIZ_CELL_RES;
+
+//-----------------------------------------------------------------------------------------
+// Cell reductions. Each one reduces uNumCells cells side by side, each uNumRows rows
+// (uRowPitch apart) of uCellRowLength depths, into the min of each, skipping the cleared
+// depth (zero), and the max of each. The rows are walked from left to right across all
+// the cells, so the depth buffer is read in long runs. The SSE2 version needs 
+// uCellRowLength to be a multiple of 4, which it is for full cells.
+//-----------------------------------------------------------------------------------------
+typedef void (*PFN_REDUCE_CELLS)( const float* pRow, size_t uRowPitch, unsigned uNumRows, unsigned uNumCells, unsigned uCellRowLength,
+                                  float* pMinDepth, float* pMaxDepth );
+
+static void ReduceCellsScalar( const float* pRow, size_t uRowPitch, unsigned uNumRows, unsigned uNumCells, unsigned uCellRowLength,
+                               float* pMinDepth, float* pMaxDepth )
+{
+    assert( uNumCells <= HIZ_CELLS_PER_BLOCK );
+
+    float MinDepth[HIZ_CELLS_PER_BLOCK];
+    float MaxDepth[HIZ_CELLS_PER_BLOCK];
+    for( unsigned uCell = 0; uCell < uNumCells; uCell++ )
+    {
+        MinDepth[uCell] = FLT_MAX;
+        MaxDepth[uCell] = 0.f;
+    }
+
+    for( unsigned y = 0; y < uNumRows; y++, pRow += uRowPitch )
+    {
+        const float* pDepth = pRow;
+        for( unsigned uCell = 0; uCell < uNumCells; uCell++ )
+        {
+            float fMinDepth = MinDepth[uCell];
+            float fMaxDepth = MaxDepth[uCell];
+            for( unsigned i = 0; i < uCellRowLength; i++ )
+            {
+                float fDepth = *pDepth++;
+                float fDepthOrMax = ( fDepth != 0.f ) ? fDepth : FLT_MAX;
+                fMinDepth = ( fDepthOrMax < fMinDepth ) ? fDepthOrMax : fMinDepth;
+                fMaxDepth = ( fDepth > fMaxDepth ) ? fDepth : fMaxDepth;
+            }
+            MinDepth[uCell] = fMinDepth;
+            MaxDepth[uCell] = fMaxDepth;
+        }
+    }
+
+    for( unsigned uCell = 0; uCell < uNumCells; uCell++ )
+    {
+        pMinDepth[uCell] = MinDepth[uCell];
+        pMaxDepth[uCell] = MaxDepth[uCell];
+    }
+}
+
+#if HIZ_X86
+
+// 4 depths at a time
+HIZ_TARGET_SSE2
+static void ReduceCellsSSE2( const float* pRow, size_t uRowPitch, unsigned uNumRows, unsigned uNumCells, unsigned uCellRowLength,
+                             float* pMinDepth, float* pMaxDepth )
+{
+    assert( uNumCells <= HIZ_CELLS_PER_BLOCK && uCellRowLength % 4 == 0 );
+
+    const __m128 vZero = _mm_setzero_ps();
+    const __m128 vFltMax = _mm_set1_ps( FLT_MAX );
+    __m128 vMinDepth[HIZ_CELLS_PER_BLOCK];
+    __m128 vMaxDepth[HIZ_CELLS_PER_BLOCK];
+    for( unsigned uCell = 0; uCell < uNumCells; uCell++ )
+    {
+        vMinDepth[uCell] = vFltMax;
+        vMaxDepth[uCell] = vZero;
+    }
+
+    for( unsigned y = 0; y < uNumRows; y++, pRow += uRowPitch )
+    {
+        const float* pDepth = pRow;
+        for( unsigned uCell = 0; uCell < uNumCells; uCell++ )
+        {
+            __m128 vCellMinDepth = vMinDepth[uCell];
+            __m128 vCellMaxDepth = vMaxDepth[uCell];
+            for( unsigned i = 0; i < uCellRowLength; i += 4, pDepth += 4 )
+            {
+                __m128 vDepth = _mm_loadu_ps( pDepth );
+                __m128 vCleared = _mm_cmpeq_ps( vDepth, vZero );
+                __m128 vDepthOrMax = _mm_or_ps( _mm_and_ps( vCleared, vFltMax ), _mm_andnot_ps( vCleared, vDepth ) );
+                vCellMinDepth = _mm_min_ps( vCellMinDepth, vDepthOrMax );
+                vCellMaxDepth = _mm_max_ps( vCellMaxDepth, vDepth );
+            }
+            vMinDepth[uCell] = vCellMinDepth;
+            vMaxDepth[uCell] = vCellMaxDepth;
+        }
+    }
+
+    // reduce the lanes
+    for( unsigned uCell = 0; uCell < uNumCells; uCell++ )
+    {
+        __m128 vCellMinDepth = vMinDepth[uCell];
+        __m128 vCellMaxDepth = vMaxDepth[uCell];
+        vCellMinDepth = _mm_min_ps( vCellMinDepth, _mm_shuffle_ps( vCellMinDepth, vCellMinDepth, _MM_SHUFFLE(1,0,3,2) ) );
+        vCellMinDepth = _mm_min_ss( vCellMinDepth, _mm_shuffle_ps( vCellMinDepth, vCellMinDepth, _MM_SHUFFLE(2,3,0,1) ) );
+        vCellMaxDepth = _mm_max_ps( vCellMaxDepth, _mm_shuffle_ps( vCellMaxDepth, vCellMaxDepth, _MM_SHUFFLE(1,0,3,2) ) );
+        vCellMaxDepth = _mm_max_ss( vCellMaxDepth, _mm_shuffle_ps( vCellMaxDepth, vCellMaxDepth, _MM_SHUFFLE(2,3,0,1) ) );
+        pMinDepth[uCell] = _mm_cvtss_f32( vCellMinDepth );
+        pMaxDepth[uCell] = _mm_cvtss_f32( vCellMaxDepth );
+    }
+}
+
+#endif // HIZ_X86
+
+static PFN_REDUCE_CELLS GetReduceCells( ForwardPlus11::CpuCullKernel eKernel )
+{
+    switch( eKernel )
+    {
+#if HIZ_X86
+    // (8 at a time is no faster, the reduction is bound by the loads)
+    case ForwardPlus11::CPU_CULL_KERNEL_AVX2:
+    case ForwardPlus11::CPU_CULL_KERNEL_SSE2:   return ReduceCellsSSE2;
+#endif
+    default:                                    return ReduceCellsScalar;
+    }
+}
+
+namespace ForwardPlus11
+{
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CpuDepthPyramid::CpuDepthPyramid()
+        :m_uNumThreads(0)
+        ,m_eKernel(ResolveCpuCullKernel(CPU_CULL_KERNEL_AUTO))
+        ,m_pDepthBuffer(NULL)
+        ,m_uWidth(0)
+        ,m_uHeight(0)
+        ,m_uPitch(0)
+        ,m_uNumSamples(1)
+    {
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CpuDepthPyramid::~CpuDepthPyramid()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Build all levels
+    //--------------------------------------------------------------------------------------
+    void CpuDepthPyramid::Build( const float* pDepthBuffer, unsigned uWidth, unsigned uHeight, unsigned uPitch, unsigned uNumSamples )
+    {
+        assert( pDepthBuffer != NULL || uWidth*uHeight == 0 );
+
+        m_pDepthBuffer = pDepthBuffer;
+        m_uWidth = uWidth;
+        m_uHeight = uHeight;
+        m_uPitch = ( uPitch == 0 ) ? uWidth : uPitch;
+        m_uNumSamples = ( uNumSamples == 0 ) ? 1 : uNumSamples;
+
+        for( unsigned uLevel = HIZ_FIRST_LEVEL; uLevel <= HIZ_LAST_LEVEL; uLevel++ )
+        {
+            unsigned uNumTexels = GetLevelWidth( uLevel )*GetLevelHeight( uLevel );
+            m_MinDepth[uLevel - HIZ_FIRST_LEVEL].resize( uNumTexels );
+            m_MaxDepth[uLevel - HIZ_FIRST_LEVEL].resize( uNumTexels );
+        }
+
+        // every block is independent
+        struct BuildBlockFunc
+        {
+            CpuDepthPyramid* pThis;
+            void operator()( unsigned uBlockIdx, unsigned /*uThreadIdx*/ )
+            {
+                pThis->BuildBlock( uBlockIdx );
+            }
+        };
+
+        unsigned uNumBlocks = GetLevelWidth( HIZ_LAST_LEVEL )*GetLevelHeight( HIZ_LAST_LEVEL );
+        BuildBlockFunc Func = { this };
+        ParallelFor( uNumBlocks, m_uNumThreads, 1, Func );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Build the texels of all levels that cover a block of pixels: reduce the pixels of
+    // each first level cell, then keep reducing 2x2 texels into one for the next level
+    //--------------------------------------------------------------------------------------
+    void CpuDepthPyramid::BuildBlock( unsigned uBlockIdx )
+    {
+        unsigned uBlockX = uBlockIdx % GetLevelWidth( HIZ_LAST_LEVEL );
+        unsigned uBlockY = uBlockIdx / GetLevelWidth( HIZ_LAST_LEVEL );
+        PFN_REDUCE_CELLS pfnReduceCells = GetReduceCells( m_eKernel );
+        size_t uRowPitch = (size_t)m_uPitch*m_uNumSamples;
+
+        // the texels of the current level in this block, row by row 
+        // (cells outside the depth buffer are left empty, so they have no effect)
+        float MinDepth[HIZ_CELLS_PER_BLOCK*HIZ_CELLS_PER_BLOCK];
+        float MaxDepth[HIZ_CELLS_PER_BLOCK*HIZ_CELLS_PER_BLOCK];
+        for( unsigned uCellIdx = 0; uCellIdx < HIZ_CELLS_PER_BLOCK*HIZ_CELLS_PER_BLOCK; uCellIdx++ )
+        {
+            MinDepth[uCellIdx] = FLT_MAX;
+            MaxDepth[uCellIdx] = 0.f;
+        }
+
+        // the full cells of each row of cells, then the partial one at the right edge, if
+        // any (cells at the bottom edge just have fewer rows, and the ones at the right edge
+        // have rows too short for the SIMD width, so they go scalar)
+        unsigned uStartX = uBlockX*HIZ_BLOCK_RES;
+        unsigned uEndX = ( uStartX + HIZ_BLOCK_RES < m_uWidth ) ? uStartX + HIZ_BLOCK_RES : m_uWidth;
+        unsigned uNumFullCells = ( uEndX - uStartX ) / HIZ_CELL_RES;
+        unsigned uPartialCellWidth = ( uEndX - uStartX ) % HIZ_CELL_RES;
+        for( unsigned uCellY = 0; uCellY < HIZ_CELLS_PER_BLOCK; uCellY++ )
+        {
+            unsigned uStartY = uBlockY*HIZ_BLOCK_RES + uCellY*HIZ_CELL_RES;
+            if( uStartY >= m_uHeight )
+            {
+                break;
+            }
+
+            unsigned uEndY = ( uStartY + HIZ_CELL_RES < m_uHeight ) ? uStartY + HIZ_CELL_RES : m_uHeight;
+            const float* pRow = m_pDepthBuffer + ( (size_t)uStartY*m_uPitch + uStartX )*m_uNumSamples;
+            unsigned uCellIdx = uCellY*HIZ_CELLS_PER_BLOCK;
+            pfnReduceCells( pRow, uRowPitch, uEndY - uStartY, uNumFullCells, HIZ_CELL_RES*m_uNumSamples, &MinDepth[uCellIdx], &MaxDepth[uCellIdx] );
+            if( uPartialCellWidth != 0 )
+            {
+                ReduceCellsScalar( pRow + uNumFullCells*HIZ_CELL_RES*m_uNumSamples, uRowPitch, uEndY - uStartY, 1, uPartialCellWidth*m_uNumSamples,
+                                   &MinDepth[uCellIdx + uNumFullCells], &MaxDepth[uCellIdx + uNumFullCells] );
+            }
+        }
+
+        // write out this block's texels of each level, then reduce them for the next one 
+        // (in place, since texel (x,y) only reads texels (2x,2y) to (2x+1,2y+1) of the 
+        // level below, which come at or after it, and no later texel reads it)
+        unsigned uNumTexelsAcross = HIZ_CELLS_PER_BLOCK;
+        for( unsigned uLevel = HIZ_FIRST_LEVEL; ; uLevel++ )
+        {
+            unsigned uLevelWidth = GetLevelWidth( uLevel );
+            unsigned uLevelHeight = GetLevelHeight( uLevel );
+            float* pLevelMinDepth = &m_MinDepth[uLevel - HIZ_FIRST_LEVEL][0];
+            float* pLevelMaxDepth = &m_MaxDepth[uLevel - HIZ_FIRST_LEVEL][0];
+            for( unsigned y = 0; y < uNumTexelsAcross; y++ )
+            {
+                unsigned uTexelY = uBlockY*uNumTexelsAcross + y;
+                for( unsigned x = 0; x < uNumTexelsAcross; x++ )
+                {
+                    unsigned uTexelX = uBlockX*uNumTexelsAcross + x;
+                    if( uTexelX < uLevelWidth && uTexelY < uLevelHeight )
+                    {
+                        pLevelMinDepth[uTexelY*uLevelWidth + uTexelX] = MinDepth[y*uNumTexelsAcross + x];
+                        pLevelMaxDepth[uTexelY*uLevelWidth + uTexelX] = MaxDepth[y*uNumTexelsAcross + x];
+                    }
+                }
+            }
+
+            if( uLevel == HIZ_LAST_LEVEL )
+            {
+                break;
+            }
+
+            unsigned uNumTexelsAcrossBelow = uNumTexelsAcross;
+            uNumTexelsAcross /= 2;
+            for( unsigned y = 0; y < uNumTexelsAcross; y++ )
+            {
+                for( unsigned x = 0; x < uNumTexelsAcross; x++ )
+                {
+                    unsigned uIdx0 = 2*y*uNumTexelsAcrossBelow + 2*x;
+                    unsigned uIdx1 = uIdx0 + uNumTexelsAcrossBelow;
+                    float fMinDepth0 = ( MinDepth[uIdx0] < MinDepth[uIdx0 + 1] ) ? MinDepth[uIdx0] : MinDepth[uIdx0 + 1];
+                    float fMinDepth1 = ( MinDepth[uIdx1] < MinDepth[uIdx1 + 1] ) ? MinDepth[uIdx1] : MinDepth[uIdx1 + 1];
+                    float fMaxDepth0 = ( MaxDepth[uIdx0] > MaxDepth[uIdx0 + 1] ) ? MaxDepth[uIdx0] : MaxDepth[uIdx0 + 1];
+                    float fMaxDepth1 = ( MaxDepth[uIdx1] > MaxDepth[uIdx1 + 1] ) ? MaxDepth[uIdx1] : MaxDepth[uIdx1 + 1];
+                    MinDepth[y*uNumTexelsAcross + x] = ( fMinDepth0 < fMinDepth1 ) ? fMinDepth0 : fMinDepth1;
+                    MaxDepth[y*uNumTexelsAcross + x] = ( fMaxDepth0 > fMaxDepth1 ) ? fMaxDepth0 : fMaxDepth1;
+                }
+            }
+        }
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
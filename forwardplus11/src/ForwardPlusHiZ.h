@@ -0,0 +1,131 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusHiZ.h
+//
+// Min/max depth pyramid (Hi-Z) of the inverted-Z depth buffer, the CPU counterpart of
+// BuildHiZCS in ForwardPlus11HiZ.hlsl. Level L has a texel per 2^L x 2^L pixel cell,
+// holding the min and the max stored depth of the pixels (and samples) in the cell,
+// for levels HIZ_FIRST_LEVEL (8x8 pixels) to HIZ_LAST_LEVEL (64x64 pixels), so that
+// the depth bounds of a light culling tile of any of the supported sizes are a single
+// lookup, instead of a reduction over the tile's pixels.
+//
+// All levels are built in one pass over the depth buffer, a HIZ_BLOCK_RES x HIZ_BLOCK_RES
+// block of pixels at a time. The min skips the cleared depth (zero, since depth is
+// inverted), like CalculateMinMaxDepthInLds, so a cell with nothing but cleared depth
+// has a min of FLT_MAX and a max of 0.
+//
+// Has no dependencies on D3D or DXUT, so that it can be used headless.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ForwardPlusCpuCullKernels.h"
+
+#include <vector>
+
+namespace ForwardPlus11
+{
+    // The levels of the pyramid, from the smallest to the biggest tile size
+    static const unsigned HIZ_FIRST_LEVEL = 3;
+    static const unsigned HIZ_LAST_LEVEL = 6;
+    static const unsigned HIZ_NUM_LEVELS = HIZ_LAST_LEVEL - HIZ_FIRST_LEVEL + 1;
+
+    // The pyramid is built a block of this many pixels across at a time (a texel of the last level)
+    static const unsigned HIZ_BLOCK_RES = 1 << HIZ_LAST_LEVEL;
+
+    //--------------------------------------------------------------------------------------
+    // The level with a texel per tile, for one of the GetTileRes sizes
+    //--------------------------------------------------------------------------------------
+    inline unsigned GetHiZLevel( unsigned uTileRes )
+    {
+        unsigned uLevel = 0;
+        while( ( 1u << uLevel ) < uTileRes )
+        {
+            uLevel++;
+        }
+        return uLevel;
+    }
+
+    class CpuDepthPyramid
+    {
+    public:
+        // Constructor / destructor
+        CpuDepthPyramid();
+        ~CpuDepthPyramid();
+
+        // Number of worker threads used by Build (0, the default, means one per hardware thread)
+        void SetNumThreads( unsigned uNumThreads ) { m_uNumThreads = uNumThreads; }
+        unsigned GetNumThreads() const { return m_uNumThreads; }
+
+        // Which reduction Build uses (CPU_CULL_KERNEL_AUTO, the default, picks the fastest 
+        // one the CPU supports, and AVX2 uses the SSE2 one). All of them give the same 
+        // pyramid, since min and max are exact.
+        void SetKernel( CpuCullKernel eKernel ) { m_eKernel = ResolveCpuCullKernel( eKernel ); }
+        CpuCullKernel GetKernel() const { return m_eKernel; }
+
+        // Build all levels from a uWidth x uHeight depth buffer, with rows uPitch pixels
+        // apart (0 means uWidth), and the uNumSamples samples of a pixel next to each other
+        void Build( const float* pDepthBuffer, unsigned uWidth, unsigned uHeight, unsigned uPitch, unsigned uNumSamples );
+
+        unsigned GetWidth() const { return m_uWidth; }
+        unsigned GetHeight() const { return m_uHeight; }
+
+        // Level dimensions, rounded up, so that partial cells at the right and bottom 
+        // edges get a texel too (covering only the pixels inside the depth buffer)
+        unsigned GetLevelWidth( unsigned uLevel ) const { return ( m_uWidth + ( 1u << uLevel ) - 1 ) >> uLevel; }
+        unsigned GetLevelHeight( unsigned uLevel ) const { return ( m_uHeight + ( 1u << uLevel ) - 1 ) >> uLevel; }
+
+        // Min and max stored depth of a cell of a level in [HIZ_FIRST_LEVEL,HIZ_LAST_LEVEL]
+        void GetMinMaxDepth( unsigned uLevel, unsigned uX, unsigned uY, float* pMinDepth, float* pMaxDepth ) const
+        {
+            unsigned uIdx = uY*GetLevelWidth( uLevel ) + uX;
+            *pMinDepth = m_MinDepth[uLevel - HIZ_FIRST_LEVEL][uIdx];
+            *pMaxDepth = m_MaxDepth[uLevel - HIZ_FIRST_LEVEL][uIdx];
+        }
+
+    private:
+
+        void BuildBlock( unsigned uBlockIdx );
+
+        unsigned                    m_uNumThreads;
+        CpuCullKernel               m_eKernel;
+
+        // Build state
+        const float*                m_pDepthBuffer;
+        unsigned                    m_uWidth;
+        unsigned                    m_uHeight;
+        unsigned                    m_uPitch;
+        unsigned                    m_uNumSamples;
+
+        // the levels, row by row
+        std::vector<float>          m_MinDepth[HIZ_NUM_LEVELS];
+        std::vector<float>          m_MaxDepth[HIZ_NUM_LEVELS];
+    };
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
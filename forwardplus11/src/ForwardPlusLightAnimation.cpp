@@ -0,0 +1,273 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusLightAnimation.cpp
+//
+// Per-frame light animation for the ForwardPlus11 sample.
+//--------------------------------------------------------------------------------------
+
+#include "ForwardPlusLightAnimation.h"
+#include "ForwardPlusParallel.h"
+
+#include <assert.h>
+#include <math.h>
+
+using namespace DirectX;
+
+//-----------------------------------------------------------------------------------------
+// Helper functions
+//-----------------------------------------------------------------------------------------
+
+static const float TWO_PI = 6.28318530718f;
+
+// integer hash, for picking the animation of a light from its seed
+static unsigned HashSeed( unsigned x )
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+// uniform in [0,1), from the top 24 bits of a hash
+static float HashToFloat( unsigned uHash )
+{
+    return (float)( uHash >> 8 ) / 16777216.f;
+}
+
+// scale the RGB channels of an RGBA8 color (ABGR in memory, like the light colors), keeping alpha
+static unsigned ScaleColor( unsigned uColor, float fScale )
+{
+    unsigned uR = (unsigned)( (float)( uColor & 0xff )*fScale + 0.5f );
+    unsigned uG = (unsigned)( (float)( ( uColor >> 8 ) & 0xff )*fScale + 0.5f );
+    unsigned uB = (unsigned)( (float)( ( uColor >> 16 ) & 0xff )*fScale + 0.5f );
+    return ( uColor & 0xff000000u ) | ( uB << 16 ) | ( uG << 8 ) | uR;
+}
+
+namespace ForwardPlus11
+{
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    LightAnimator::LightAnimator()
+        :m_fTime(0.f)
+        ,m_uNumActiveLights(0)
+    {
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    LightAnimator::~LightAnimator()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Set the number of lights
+    //--------------------------------------------------------------------------------------
+    void LightAnimator::Resize( unsigned uNumLights )
+    {
+        m_RestX.assign( uNumLights, 0.f );
+        m_RestY.assign( uNumLights, 0.f );
+        m_RestZ.assign( uNumLights, 0.f );
+        m_Radius.assign( uNumLights, 0.f );
+        m_RestColor.assign( uNumLights, 0 );
+        m_Type.assign( uNumLights, (unsigned char)LIGHT_ANIMATION_NONE );
+        m_Amplitude.assign( uNumLights, 0.f );
+        m_Frequency.assign( uNumLights, 0.f );
+        m_Phase.assign( uNumLights, 0.f );
+        m_DirX.assign( uNumLights, 0.f );
+        m_DirY.assign( uNumLights, 0.f );
+        m_DirZ.assign( uNumLights, 0.f );
+
+        m_CenterAndRadius.assign( uNumLights, XMFLOAT4( 0.f, 0.f, 0.f, 0.f ) );
+        m_Colors.assign( uNumLights, 0 );
+
+        m_BlockDirty.assign( ( uNumLights + LIGHT_ANIMATION_BLOCK_SIZE - 1 ) / LIGHT_ANIMATION_BLOCK_SIZE, 0 );
+        m_DirtyRanges.clear();
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Set the rest state of a light, and pick its animation
+    //--------------------------------------------------------------------------------------
+    void LightAnimator::SetLight( unsigned uLightIdx, const XMFLOAT4& CenterAndRadius, unsigned uColor, unsigned uSeed, float fMotionScale )
+    {
+        assert( uLightIdx < GetNumLights() );
+
+        m_RestX[uLightIdx] = CenterAndRadius.x;
+        m_RestY[uLightIdx] = CenterAndRadius.y;
+        m_RestZ[uLightIdx] = CenterAndRadius.z;
+        m_Radius[uLightIdx] = CenterAndRadius.w;
+        m_RestColor[uLightIdx] = uColor;
+
+        unsigned uHash = HashSeed( uSeed );
+        m_Type[uLightIdx] = (unsigned char)( uHash % LIGHT_ANIMATION_TYPE_COUNT );
+        uHash = HashSeed( uHash );
+        m_Amplitude[uLightIdx] = fMotionScale*( 0.5f + HashToFloat( uHash ) );
+        uHash = HashSeed( uHash );
+        m_Frequency[uLightIdx] = 0.5f + 1.5f*HashToFloat( uHash );
+        uHash = HashSeed( uHash );
+        m_Phase[uLightIdx] = TWO_PI*HashToFloat( uHash );
+
+        // mostly horizontal paths
+        uHash = HashSeed( uHash );
+        float fDirX = 2.f*HashToFloat( uHash ) - 1.f;
+        uHash = HashSeed( uHash );
+        float fDirY = 0.25f*( 2.f*HashToFloat( uHash ) - 1.f );
+        uHash = HashSeed( uHash );
+        float fDirZ = 2.f*HashToFloat( uHash ) - 1.f;
+        float fLength = sqrtf( fDirX*fDirX + fDirY*fDirY + fDirZ*fDirZ );
+        m_DirX[uLightIdx] = ( fLength > 1e-3f ) ? fDirX/fLength : 1.f;
+        m_DirY[uLightIdx] = ( fLength > 1e-3f ) ? fDirY/fLength : 0.f;
+        m_DirZ[uLightIdx] = ( fLength > 1e-3f ) ? fDirZ/fLength : 0.f;
+
+        m_CenterAndRadius[uLightIdx] = CenterAndRadius;
+        m_Colors[uLightIdx] = uColor;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Animate the active lights
+    //--------------------------------------------------------------------------------------
+    void LightAnimator::Update( float fTime, unsigned uNumActiveLights, unsigned uNumThreads )
+    {
+        assert( uNumActiveLights <= GetNumLights() );
+        m_fTime = fTime;
+        m_uNumActiveLights = uNumActiveLights;
+
+        // every block is independent
+        struct UpdateBlockFunc
+        {
+            LightAnimator* pThis;
+            void operator()( unsigned uBlockIdx, unsigned /*uThreadIdx*/ )
+            {
+                pThis->UpdateBlock( uBlockIdx );
+            }
+        };
+
+        unsigned uNumActiveBlocks = ( uNumActiveLights + LIGHT_ANIMATION_BLOCK_SIZE - 1 ) / LIGHT_ANIMATION_BLOCK_SIZE;
+        UpdateBlockFunc Func = { this };
+        ParallelFor( uNumActiveBlocks, uNumThreads, 4, Func );
+
+        // merge runs of dirty blocks into ranges
+        m_DirtyRanges.clear();
+        for( unsigned uBlockIdx = 0; uBlockIdx < uNumActiveBlocks; uBlockIdx++ )
+        {
+            if( !m_BlockDirty[uBlockIdx] )
+            {
+                continue;
+            }
+
+            unsigned uBegin = uBlockIdx*LIGHT_ANIMATION_BLOCK_SIZE;
+            unsigned uEnd = ( uBegin + LIGHT_ANIMATION_BLOCK_SIZE < uNumActiveLights ) ? uBegin + LIGHT_ANIMATION_BLOCK_SIZE : uNumActiveLights;
+            if( !m_DirtyRanges.empty() && m_DirtyRanges.back().uEnd == uBegin )
+            {
+                m_DirtyRanges.back().uEnd = uEnd;
+            }
+            else
+            {
+                LightRange Range = { uBegin, uEnd };
+                m_DirtyRanges.push_back( Range );
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Total number of lights in the dirty ranges
+    //--------------------------------------------------------------------------------------
+    unsigned LightAnimator::GetNumDirtyLights() const
+    {
+        unsigned uNumDirtyLights = 0;
+        for( size_t i = 0; i < m_DirtyRanges.size(); i++ )
+        {
+            uNumDirtyLights += m_DirtyRanges[i].uEnd - m_DirtyRanges[i].uBegin;
+        }
+        return uNumDirtyLights;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Animate one block of lights, and note whether any of them changed
+    //--------------------------------------------------------------------------------------
+    void LightAnimator::UpdateBlock( unsigned uBlockIdx )
+    {
+        unsigned uBegin = uBlockIdx*LIGHT_ANIMATION_BLOCK_SIZE;
+        unsigned uEnd = ( uBegin + LIGHT_ANIMATION_BLOCK_SIZE < m_uNumActiveLights ) ? uBegin + LIGHT_ANIMATION_BLOCK_SIZE : m_uNumActiveLights;
+        float fTime = m_fTime;
+
+        bool bDirty = false;
+        for( unsigned i = uBegin; i < uEnd; i++ )
+        {
+            XMFLOAT4 CenterAndRadius( m_RestX[i], m_RestY[i], m_RestZ[i], m_Radius[i] );
+            unsigned uColor = m_RestColor[i];
+            float fAngle = m_Frequency[i]*fTime + m_Phase[i];
+
+            switch( m_Type[i] )
+            {
+            case LIGHT_ANIMATION_ORBIT:
+                CenterAndRadius.x += m_Amplitude[i]*cosf( fAngle );
+                CenterAndRadius.z += m_Amplitude[i]*sinf( fAngle );
+                break;
+
+            case LIGHT_ANIMATION_FLICKER:
+                {
+                    // two fast sine waves at an irrational ratio, so the flicker does not look periodic
+                    float fFlicker = ( 0.5f + 0.5f*sinf( 7.f*fAngle ) )*( 0.5f + 0.5f*sinf( 11.3f*fAngle + m_Phase[i] ) );
+                    uColor = ScaleColor( uColor, 0.6f + 0.4f*fFlicker );
+                }
+                break;
+
+            case LIGHT_ANIMATION_PATH:
+                {
+                    float fOffset = m_Amplitude[i]*sinf( fAngle );
+                    CenterAndRadius.x += fOffset*m_DirX[i];
+                    CenterAndRadius.y += fOffset*m_DirY[i];
+                    CenterAndRadius.z += fOffset*m_DirZ[i];
+                }
+                break;
+
+            default:
+                break;
+            }
+
+            const XMFLOAT4& OldCenterAndRadius = m_CenterAndRadius[i];
+            if( CenterAndRadius.x != OldCenterAndRadius.x || CenterAndRadius.y != OldCenterAndRadius.y ||
+                CenterAndRadius.z != OldCenterAndRadius.z || CenterAndRadius.w != OldCenterAndRadius.w || uColor != m_Colors[i] )
+            {
+                m_CenterAndRadius[i] = CenterAndRadius;
+                m_Colors[i] = uColor;
+                bDirty = true;
+            }
+        }
+
+        m_BlockDirty[uBlockIdx] = bDirty ? 1 : 0;
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
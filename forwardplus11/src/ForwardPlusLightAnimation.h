@@ -0,0 +1,128 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusLightAnimation.h
+//
+// Per-frame light animation for the ForwardPlus11 sample. The animation state lives
+// in structure-of-arrays form, every frame's update runs in parallel over blocks of
+// lights, and the result is kept in the layout of the light buffers (a float4 center
+// and radius and an RGBA8 color per light), along with the ranges of lights that
+// changed, so that only those need to be uploaded.
+//
+// Has no dependencies on D3D or DXUT, so that it can be used headless.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+namespace ForwardPlus11
+{
+    // Lights are animated (and tracked for changes) in blocks of this many
+    static const unsigned LIGHT_ANIMATION_BLOCK_SIZE = 256;
+
+    enum LightAnimationType
+    {
+        LIGHT_ANIMATION_NONE = 0,       // stays put
+        LIGHT_ANIMATION_ORBIT,          // circles around its rest position, in the horizontal plane
+        LIGHT_ANIMATION_FLICKER,        // stays put, but its brightness flickers
+        LIGHT_ANIMATION_PATH,           // moves back and forth along a line through its rest position
+        LIGHT_ANIMATION_TYPE_COUNT
+    };
+
+    // A range [uBegin,uEnd) of lights
+    struct LightRange
+    {
+        unsigned uBegin;
+        unsigned uEnd;
+    };
+
+    class LightAnimator
+    {
+    public:
+        // Constructor / destructor
+        LightAnimator();
+        ~LightAnimator();
+
+        // Number of lights, all at the origin and not animated until SetLight is called for them
+        void Resize( unsigned uNumLights );
+        unsigned GetNumLights() const { return (unsigned)m_CenterAndRadius.size(); }
+
+        // Set the rest state of a light, and pick its animation (type, speed, phase, ...)
+        // from uSeed, so that the same seed always gets the same animation. fMotionScale
+        // is how far the light moves (about, depending on the animation).
+        // This also resets the light's output to its rest state (see GetCenterAndRadius).
+        void SetLight( unsigned uLightIdx, const DirectX::XMFLOAT4& CenterAndRadius, unsigned uColor, unsigned uSeed, float fMotionScale );
+
+        // Animate lights [0,uNumActiveLights) to time fTime (in seconds), using uNumThreads
+        // threads (0 means one per hardware thread). Inactive lights keep their output.
+        void Update( float fTime, unsigned uNumActiveLights, unsigned uNumThreads );
+
+        // The output, in the layout of the light buffers
+        const DirectX::XMFLOAT4* GetCenterAndRadius() const { return m_CenterAndRadius.empty() ? NULL : &m_CenterAndRadius[0]; }
+        const unsigned* GetColors() const { return m_Colors.empty() ? NULL : &m_Colors[0]; }
+
+        // The lights whose output changed in the last Update, as sorted, non-overlapping ranges
+        // (in whole blocks, clipped to the active lights). Lights outside these ranges have the
+        // same output as before the last Update.
+        const std::vector<LightRange>& GetDirtyRanges() const { return m_DirtyRanges; }
+        unsigned GetNumDirtyLights() const;
+
+    private:
+
+        void UpdateBlock( unsigned uBlockIdx );
+
+        // the rest state and animation of each light
+        std::vector<float>          m_RestX;
+        std::vector<float>          m_RestY;
+        std::vector<float>          m_RestZ;
+        std::vector<float>          m_Radius;
+        std::vector<unsigned>       m_RestColor;
+        std::vector<unsigned char>  m_Type;
+        std::vector<float>          m_Amplitude;
+        std::vector<float>          m_Frequency;     // in radians per second
+        std::vector<float>          m_Phase;
+        std::vector<float>          m_DirX;          // direction of LIGHT_ANIMATION_PATH
+        std::vector<float>          m_DirY;
+        std::vector<float>          m_DirZ;
+
+        // the output
+        std::vector<DirectX::XMFLOAT4> m_CenterAndRadius;
+        std::vector<unsigned>       m_Colors;
+
+        // change tracking
+        std::vector<unsigned char>  m_BlockDirty;
+        std::vector<LightRange>     m_DirtyRanges;
+
+        // Update state
+        float                       m_fTime;
+        unsigned                    m_uNumActiveLights;
+    };
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,536 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusLightBvh.cpp
+//
+// Linear BVH over the view-space light bounding spheres, for the CPU light culler.
+//--------------------------------------------------------------------------------------
+
+#include "ForwardPlusLightBvh.h"
+#include "ForwardPlusLightSort.h"
+#include "ForwardPlusParallel.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//-----------------------------------------------------------------------------------------
+// Build constants
+//-----------------------------------------------------------------------------------------
+
+// the lights are processed in blocks of this many by the parallel build steps
+// (the block layout does not depend on the number of threads, so neither does the BVH)
+static const unsigned LIGHT_BVH_BUILD_BLOCK_SIZE = 4096;
+
+// the Morton codes are sorted 10 bits at a time
+static const unsigned LIGHT_BVH_RADIX_BITS = 10;
+static const unsigned LIGHT_BVH_RADIX_SIZE = 1 << LIGHT_BVH_RADIX_BITS;
+
+// deep enough for any LBVH over 30-bit keys and 32-bit leaf indices
+static const unsigned LIGHT_BVH_MAX_STACK_DEPTH = 64;
+
+// Relative slack for the node tests, so that rounding can never make a node test reject
+// a light that the per-light test would accept. It is far bigger than the rounding error
+// of a few float operations, and far too small to matter for culling efficiency.
+static const float LIGHT_BVH_TEST_EPSILON = 1e-5f;
+
+//-----------------------------------------------------------------------------------------
+// Helper functions
+//-----------------------------------------------------------------------------------------
+
+// number of leading zero bits, for x != 0
+static int CountLeadingZeros( unsigned x )
+{
+#if defined(_MSC_VER)
+    unsigned long uBitIdx;
+    _BitScanReverse( &uBitIdx, x );
+    return 31 - (int)uBitIdx;
+#else
+    return __builtin_clz( x );
+#endif
+}
+
+//-----------------------------------------------------------------------------------------
+// Conservative AABB vs. tile frustum test. The box bounds the spheres of all the lights
+// below the node, so if every point of the box is on the outside of one of the side
+// planes, or in front of or behind the depth slab, every light below the node fails
+// the corresponding per-light test in the kernels.
+//-----------------------------------------------------------------------------------------
+static bool TestNodeAgainstTile( const ForwardPlus11::CpuCullTileFrustum& Tile, const ForwardPlus11::CpuLightBvhNode& Node )
+{
+    float fDepthMagnitude = fabsf( Node.fMin[2] ) + fabsf( Node.fMax[2] );
+    if( Node.fMax[2] + LIGHT_BVH_TEST_EPSILON*( fDepthMagnitude + fabsf( Tile.fMinZ ) ) < Tile.fMinZ ||
+        Node.fMin[2] - LIGHT_BVH_TEST_EPSILON*( fDepthMagnitude + fabsf( Tile.fMaxZ ) ) > Tile.fMaxZ )
+    {
+        return false;
+    }
+
+    for( int p = 0; p < 4; p++ )
+    {
+        const float n[3] = { Tile.fPlaneX[p], Tile.fPlaneY[p], Tile.fPlaneZ[p] };
+
+        // the distance to the plane of the box corner furthest inside
+        float fMinDistance = 0.f;
+        float fMagnitude = 0.f;
+        for( int i = 0; i < 3; i++ )
+        {
+            fMinDistance += ( n[i] >= 0.f ) ? n[i]*Node.fMin[i] : n[i]*Node.fMax[i];
+            float fMaxAbs = ( fabsf( Node.fMin[i] ) > fabsf( Node.fMax[i] ) ) ? fabsf( Node.fMin[i] ) : fabsf( Node.fMax[i] );
+            fMagnitude += fabsf( n[i] )*fMaxAbs;
+        }
+
+        if( fMinDistance > LIGHT_BVH_TEST_EPSILON*fMagnitude )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// the union of two boxes
+static void MergeNodeBounds( const ForwardPlus11::CpuLightBvhNode& A, const ForwardPlus11::CpuLightBvhNode& B, ForwardPlus11::CpuLightBvhNode* pOut )
+{
+    for( int i = 0; i < 3; i++ )
+    {
+        pOut->fMin[i] = ( A.fMin[i] < B.fMin[i] ) ? A.fMin[i] : B.fMin[i];
+        pOut->fMax[i] = ( A.fMax[i] > B.fMax[i] ) ? A.fMax[i] : B.fMax[i];
+    }
+}
+
+namespace ForwardPlus11
+{
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    CpuLightBvh::CpuLightBvh()
+        :m_uNumThreads(0)
+        ,m_uNumLeaves(0)
+        ,m_pBuildLights(NULL)
+        ,m_uNumBlocks(0)
+        ,m_uRadixShift(0)
+    {
+        for( int i = 0; i < 3; i++ )
+        {
+            m_fSceneMin[i] = 0.f;
+            m_fSceneScale[i] = 0.f;
+        }
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Destructor
+    //--------------------------------------------------------------------------------------
+    CpuLightBvh::~CpuLightBvh()
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Rebuild the BVH
+    //--------------------------------------------------------------------------------------
+    void CpuLightBvh::Build( const CpuCullLightsSoA& Lights, unsigned uNumThreads )
+    {
+        unsigned uNumLights = Lights.uNumLights;
+
+        m_uNumThreads = uNumThreads;
+        m_pBuildLights = &Lights;
+        m_uNumBlocks = ( uNumLights + LIGHT_BVH_BUILD_BLOCK_SIZE - 1 ) / LIGHT_BVH_BUILD_BLOCK_SIZE;
+        m_uNumLeaves = ( uNumLights + LIGHT_BVH_LEAF_SIZE - 1 ) / LIGHT_BVH_LEAF_SIZE;
+
+        m_SortedLights.Resize( uNumLights );
+        if( uNumLights == 0 )
+        {
+            m_SortedToLight.clear();
+            m_Nodes.clear();
+            m_pBuildLights = NULL;
+            return;
+        }
+
+        // the bounds of the light centers, which the Morton codes are relative to
+        m_BlockBounds.resize( 6*m_uNumBlocks );
+        RunBuildStep( &CpuLightBvh::CalculateBlockBounds, m_uNumBlocks, 1 );
+
+        float fSceneMax[3];
+        for( int i = 0; i < 3; i++ )
+        {
+            m_fSceneMin[i] = FLT_MAX;
+            fSceneMax[i] = -FLT_MAX;
+            for( unsigned uBlockIdx = 0; uBlockIdx < m_uNumBlocks; uBlockIdx++ )
+            {
+                m_fSceneMin[i] = ( m_BlockBounds[6*uBlockIdx + i] < m_fSceneMin[i] ) ? m_BlockBounds[6*uBlockIdx + i] : m_fSceneMin[i];
+                fSceneMax[i] = ( m_BlockBounds[6*uBlockIdx + 3 + i] > fSceneMax[i] ) ? m_BlockBounds[6*uBlockIdx + 3 + i] : fSceneMax[i];
+            }
+
+            m_fSceneScale[i] = CalculateMortonScale( m_fSceneMin[i], fSceneMax[i] );
+        }
+
+        m_MortonCodes.resize( uNumLights );
+        m_MortonCodesTemp.resize( uNumLights );
+        m_SortedToLight.resize( uNumLights );
+        m_SortedToLightTemp.resize( uNumLights );
+        RunBuildStep( &CpuLightBvh::CalculateBlockMortonCodes, m_uNumBlocks, 1 );
+
+        // Stable LSD radix sort of the Morton codes, carrying the light indices along.
+        // Each pass counts the digits per block, turns the counts into the offset where
+        // each block writes each digit (digit-major, then block order, which keeps the
+        // sort stable), and then scatters every block independently.
+        m_BlockDigitOffsets.resize( LIGHT_BVH_RADIX_SIZE*m_uNumBlocks );
+        for( m_uRadixShift = 0; m_uRadixShift < 3*MORTON_BITS_PER_AXIS; m_uRadixShift += LIGHT_BVH_RADIX_BITS )
+        {
+            RunBuildStep( &CpuLightBvh::CountBlockRadixDigits, m_uNumBlocks, 1 );
+
+            unsigned uOffset = 0;
+            for( unsigned uDigit = 0; uDigit < LIGHT_BVH_RADIX_SIZE; uDigit++ )
+            {
+                for( unsigned uBlockIdx = 0; uBlockIdx < m_uNumBlocks; uBlockIdx++ )
+                {
+                    unsigned uCount = m_BlockDigitOffsets[LIGHT_BVH_RADIX_SIZE*uBlockIdx + uDigit];
+                    m_BlockDigitOffsets[LIGHT_BVH_RADIX_SIZE*uBlockIdx + uDigit] = uOffset;
+                    uOffset += uCount;
+                }
+            }
+
+            RunBuildStep( &CpuLightBvh::ScatterBlockRadixDigits, m_uNumBlocks, 1 );
+            m_MortonCodes.swap( m_MortonCodesTemp );
+            m_SortedToLight.swap( m_SortedToLightTemp );
+        }
+
+        // copy the lights in sorted order, so that the leaves are contiguous
+        RunBuildStep( &CpuLightBvh::GatherBlockSortedLights, m_uNumBlocks, 1 );
+        m_pBuildLights = NULL;
+
+        // the leaves, then the internal nodes, then the bounds of the internal nodes
+        unsigned uNumInternalNodes = m_uNumLeaves - 1;
+        m_Nodes.resize( uNumInternalNodes + m_uNumLeaves );
+        m_Parents.resize( uNumInternalNodes + m_uNumLeaves );
+        if( m_RefitCounters.size() < uNumInternalNodes )
+        {
+            // atomics cannot be copied, so the vector cannot be resized in place
+            std::vector<std::atomic<unsigned> > RefitCounters( uNumInternalNodes );
+            m_RefitCounters.swap( RefitCounters );
+        }
+
+        RunBuildStep( &CpuLightBvh::CalculateLeafBounds, m_uNumLeaves, 64 );
+        RunBuildStep( &CpuLightBvh::BuildInternalNode, uNumInternalNodes, 64 );
+        RunBuildStep( &CpuLightBvh::RefitFromLeaf, m_uNumLeaves, 64 );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Cull the lights against one tile
+    //--------------------------------------------------------------------------------------
+    unsigned CpuLightBvh::Cull( const CpuCullTileFrustum& Tile, PFN_CPU_CULL_RANGE_KERNEL pfnKernel, unsigned* pOut ) const
+    {
+        if( m_uNumLeaves == 0 )
+        {
+            return 0;
+        }
+
+        unsigned uFirstLeafNode = m_uNumLeaves - 1;
+        unsigned Stack[LIGHT_BVH_MAX_STACK_DEPTH];
+        unsigned uStackSize = 0;
+        Stack[uStackSize++] = 0;
+
+        // the kernels write indices into m_SortedLights
+        unsigned uNumOut = 0;
+        while( uStackSize > 0 )
+        {
+            unsigned uNodeIdx = Stack[--uStackSize];
+            const CpuLightBvhNode& Node = m_Nodes[uNodeIdx];
+            if( !TestNodeAgainstTile( Tile, Node ) )
+            {
+                continue;
+            }
+
+            if( uNodeIdx >= uFirstLeafNode )
+            {
+                unsigned uBegin = ( uNodeIdx - uFirstLeafNode )*LIGHT_BVH_LEAF_SIZE;
+                unsigned uEnd = ( uBegin + LIGHT_BVH_LEAF_SIZE < m_SortedLights.uNumLightsPadded ) ? uBegin + LIGHT_BVH_LEAF_SIZE : m_SortedLights.uNumLightsPadded;
+                uNumOut += pfnKernel( Tile, m_SortedLights, uBegin, uEnd, pOut + uNumOut );
+            }
+            else
+            {
+                assert( uStackSize + 2 <= LIGHT_BVH_MAX_STACK_DEPTH );
+                Stack[uStackSize++] = Node.uChild[1];
+                Stack[uStackSize++] = Node.uChild[0];
+            }
+        }
+
+        // back to light indices, in the same order as the brute-force path produces them
+        for( unsigned i = 0; i < uNumOut; i++ )
+        {
+            pOut[i] = m_SortedToLight[pOut[i]];
+        }
+        std::sort( pOut, pOut + uNumOut );
+
+        return uNumOut;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Run a build step over uNumItems items in parallel
+    //--------------------------------------------------------------------------------------
+    void CpuLightBvh::RunBuildStep( PFN_BUILD_STEP pfnStep, unsigned uNumItems, unsigned uChunkSize )
+    {
+        struct BuildStepFunc
+        {
+            CpuLightBvh* pThis;
+            PFN_BUILD_STEP pfnStep;
+            void operator()( unsigned uItem, unsigned /*uThreadIdx*/ )
+            {
+                (pThis->*pfnStep)( uItem );
+            }
+        };
+
+        BuildStepFunc Func = { this, pfnStep };
+        ParallelFor( uNumItems, m_uNumThreads, uChunkSize, Func );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Bounds of the light centers in a block
+    //--------------------------------------------------------------------------------------
+    void CpuLightBvh::CalculateBlockBounds( unsigned uBlockIdx )
+    {
+        const CpuCullLightsSoA& Lights = *m_pBuildLights;
+        unsigned uBegin = uBlockIdx*LIGHT_BVH_BUILD_BLOCK_SIZE;
+        unsigned uEnd = ( uBegin + LIGHT_BVH_BUILD_BLOCK_SIZE < Lights.uNumLights ) ? uBegin + LIGHT_BVH_BUILD_BLOCK_SIZE : Lights.uNumLights;
+
+        float* pBounds = &m_BlockBounds[6*uBlockIdx];
+        pBounds[0] = pBounds[1] = pBounds[2] = FLT_MAX;
+        pBounds[3] = pBounds[4] = pBounds[5] = -FLT_MAX;
+        for( unsigned i = uBegin; i < uEnd; i++ )
+        {
+            const float Center[3] = { Lights.X[i], Lights.Y[i], Lights.Z[i] };
+            for( int j = 0; j < 3; j++ )
+            {
+                pBounds[j] = ( Center[j] < pBounds[j] ) ? Center[j] : pBounds[j];
+                pBounds[3 + j] = ( Center[j] > pBounds[3 + j] ) ? Center[j] : pBounds[3 + j];
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Morton codes of the light centers in a block
+    //--------------------------------------------------------------------------------------
+    void CpuLightBvh::CalculateBlockMortonCodes( unsigned uBlockIdx )
+    {
+        const CpuCullLightsSoA& Lights = *m_pBuildLights;
+        unsigned uBegin = uBlockIdx*LIGHT_BVH_BUILD_BLOCK_SIZE;
+        unsigned uEnd = ( uBegin + LIGHT_BVH_BUILD_BLOCK_SIZE < Lights.uNumLights ) ? uBegin + LIGHT_BVH_BUILD_BLOCK_SIZE : Lights.uNumLights;
+
+        for( unsigned i = uBegin; i < uEnd; i++ )
+        {
+            m_MortonCodes[i] = GetMortonCode( Lights.X[i], Lights.Y[i], Lights.Z[i], m_fSceneMin, m_fSceneScale );
+            m_SortedToLight[i] = i;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Histogram of the current radix digit in a block
+    //--------------------------------------------------------------------------------------
+    void CpuLightBvh::CountBlockRadixDigits( unsigned uBlockIdx )
+    {
+        unsigned uNumLights = (unsigned)m_MortonCodes.size();
+        unsigned uBegin = uBlockIdx*LIGHT_BVH_BUILD_BLOCK_SIZE;
+        unsigned uEnd = ( uBegin + LIGHT_BVH_BUILD_BLOCK_SIZE < uNumLights ) ? uBegin + LIGHT_BVH_BUILD_BLOCK_SIZE : uNumLights;
+
+        unsigned* pCounts = &m_BlockDigitOffsets[LIGHT_BVH_RADIX_SIZE*uBlockIdx];
+        for( unsigned uDigit = 0; uDigit < LIGHT_BVH_RADIX_SIZE; uDigit++ )
+        {
+            pCounts[uDigit] = 0;
+        }
+
+        for( unsigned i = uBegin; i < uEnd; i++ )
+        {
+            pCounts[( m_MortonCodes[i] >> m_uRadixShift ) & ( LIGHT_BVH_RADIX_SIZE - 1 )]++;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Move the codes of a block to their place for the current radix digit
+    //--------------------------------------------------------------------------------------
+    void CpuLightBvh::ScatterBlockRadixDigits( unsigned uBlockIdx )
+    {
+        unsigned uNumLights = (unsigned)m_MortonCodes.size();
+        unsigned uBegin = uBlockIdx*LIGHT_BVH_BUILD_BLOCK_SIZE;
+        unsigned uEnd = ( uBegin + LIGHT_BVH_BUILD_BLOCK_SIZE < uNumLights ) ? uBegin + LIGHT_BVH_BUILD_BLOCK_SIZE : uNumLights;
+
+        unsigned* pOffsets = &m_BlockDigitOffsets[LIGHT_BVH_RADIX_SIZE*uBlockIdx];
+        for( unsigned i = uBegin; i < uEnd; i++ )
+        {
+            unsigned uDst = pOffsets[( m_MortonCodes[i] >> m_uRadixShift ) & ( LIGHT_BVH_RADIX_SIZE - 1 )]++;
+            m_MortonCodesTemp[uDst] = m_MortonCodes[i];
+            m_SortedToLightTemp[uDst] = m_SortedToLight[i];
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Copy the lights of a block of sorted positions
+    //--------------------------------------------------------------------------------------
+    void CpuLightBvh::GatherBlockSortedLights( unsigned uBlockIdx )
+    {
+        const CpuCullLightsSoA& Lights = *m_pBuildLights;
+        unsigned uBegin = uBlockIdx*LIGHT_BVH_BUILD_BLOCK_SIZE;
+        unsigned uEnd = ( uBegin + LIGHT_BVH_BUILD_BLOCK_SIZE < Lights.uNumLights ) ? uBegin + LIGHT_BVH_BUILD_BLOCK_SIZE : Lights.uNumLights;
+
+        for( unsigned i = uBegin; i < uEnd; i++ )
+        {
+            unsigned uLightIdx = m_SortedToLight[i];
+            m_SortedLights.Set( i, Lights.X[uLightIdx], Lights.Y[uLightIdx], Lights.Z[uLightIdx], Lights.R[uLightIdx] );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Bounds of the spheres in a leaf (not counting the padding)
+    //--------------------------------------------------------------------------------------
+    void CpuLightBvh::CalculateLeafBounds( unsigned uLeafIdx )
+    {
+        unsigned uBegin = uLeafIdx*LIGHT_BVH_LEAF_SIZE;
+        unsigned uEnd = ( uBegin + LIGHT_BVH_LEAF_SIZE < m_SortedLights.uNumLights ) ? uBegin + LIGHT_BVH_LEAF_SIZE : m_SortedLights.uNumLights;
+
+        CpuLightBvhNode& Node = m_Nodes[m_uNumLeaves - 1 + uLeafIdx];
+        Node.fMin[0] = Node.fMin[1] = Node.fMin[2] = FLT_MAX;
+        Node.fMax[0] = Node.fMax[1] = Node.fMax[2] = -FLT_MAX;
+        Node.uChild[0] = Node.uChild[1] = 0;
+        for( unsigned i = uBegin; i < uEnd; i++ )
+        {
+            const float Center[3] = { m_SortedLights.X[i], m_SortedLights.Y[i], m_SortedLights.Z[i] };
+            float r = m_SortedLights.R[i];
+            for( int j = 0; j < 3; j++ )
+            {
+                Node.fMin[j] = ( Center[j] - r < Node.fMin[j] ) ? Center[j] - r : Node.fMin[j];
+                Node.fMax[j] = ( Center[j] + r > Node.fMax[j] ) ? Center[j] + r : Node.fMax[j];
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Length of the common prefix of the keys of two leaves, where the key of a leaf is
+    // the Morton code of its first light, with the leaf index appended to make the keys
+    // unique. -1 if leaf B is out of range.
+    //--------------------------------------------------------------------------------------
+    int CpuLightBvh::GetLeafKeyPrefixLength( unsigned uLeafA, int nLeafB ) const
+    {
+        if( nLeafB < 0 || nLeafB >= (int)m_uNumLeaves )
+        {
+            return -1;
+        }
+
+        unsigned uCodeA = m_MortonCodes[uLeafA*LIGHT_BVH_LEAF_SIZE];
+        unsigned uCodeB = m_MortonCodes[(unsigned)nLeafB*LIGHT_BVH_LEAF_SIZE];
+        if( uCodeA == uCodeB )
+        {
+            return 32 + CountLeadingZeros( uLeafA ^ (unsigned)nLeafB );
+        }
+        return CountLeadingZeros( uCodeA ^ uCodeB );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Find the range of leaves an internal node covers, and where it splits (Karras 2012).
+    // Every internal node is independent of the others.
+    //--------------------------------------------------------------------------------------
+    void CpuLightBvh::BuildInternalNode( unsigned uNodeIdx )
+    {
+        int i = (int)uNodeIdx;
+
+        // which end of the range i is at, and the direction towards the other end
+        int d = ( GetLeafKeyPrefixLength( uNodeIdx, i + 1 ) > GetLeafKeyPrefixLength( uNodeIdx, i - 1 ) ) ? 1 : -1;
+
+        // find the other end, j, by exponential and then binary search
+        int nMinPrefixLength = GetLeafKeyPrefixLength( uNodeIdx, i - d );
+        int nMaxLength = 2;
+        while( GetLeafKeyPrefixLength( uNodeIdx, i + nMaxLength*d ) > nMinPrefixLength )
+        {
+            nMaxLength *= 2;
+        }
+
+        int nLength = 0;
+        for( int t = nMaxLength / 2; t >= 1; t /= 2 )
+        {
+            if( GetLeafKeyPrefixLength( uNodeIdx, i + ( nLength + t )*d ) > nMinPrefixLength )
+            {
+                nLength += t;
+            }
+        }
+        int j = i + nLength*d;
+
+        // find the split, the last leaf that shares more than the node's prefix with i
+        int nNodePrefixLength = GetLeafKeyPrefixLength( uNodeIdx, j );
+        int nSplit = 0;
+        int t = nLength;
+        do
+        {
+            t = ( t + 1 ) / 2;
+            if( GetLeafKeyPrefixLength( uNodeIdx, i + ( nSplit + t )*d ) > nNodePrefixLength )
+            {
+                nSplit += t;
+            }
+        }
+        while( t > 1 );
+        int nGamma = i + nSplit*d + ( ( d < 0 ) ? -1 : 0 );
+
+        // the children are leaves if their range is a single leaf
+        unsigned uFirstLeafNode = m_uNumLeaves - 1;
+        unsigned uLeft = ( ( i < j ? i : j ) == nGamma ) ? uFirstLeafNode + (unsigned)nGamma : (unsigned)nGamma;
+        unsigned uRight = ( ( i > j ? i : j ) == nGamma + 1 ) ? uFirstLeafNode + (unsigned)nGamma + 1 : (unsigned)nGamma + 1;
+
+        CpuLightBvhNode& Node = m_Nodes[uNodeIdx];
+        Node.uChild[0] = uLeft;
+        Node.uChild[1] = uRight;
+        m_Parents[uLeft] = uNodeIdx;
+        m_Parents[uRight] = uNodeIdx;
+        m_RefitCounters[uNodeIdx].store( 0 );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Walk up from a leaf, calculating the bounds of its ancestors. Of the two children
+    // of a node, the one that gets there second does the work (the first one has its
+    // bounds ready by then), so every node is done exactly once, after its children.
+    //--------------------------------------------------------------------------------------
+    void CpuLightBvh::RefitFromLeaf( unsigned uLeafIdx )
+    {
+        unsigned uNodeIdx = m_uNumLeaves - 1 + uLeafIdx;
+        while( uNodeIdx != 0 )
+        {
+            unsigned uParentIdx = m_Parents[uNodeIdx];
+            if( m_RefitCounters[uParentIdx].fetch_add( 1 ) == 0 )
+            {
+                return;
+            }
+
+            CpuLightBvhNode& Parent = m_Nodes[uParentIdx];
+            MergeNodeBounds( m_Nodes[Parent.uChild[0]], m_Nodes[Parent.uChild[1]], &Parent );
+            uNodeIdx = uParentIdx;
+        }
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
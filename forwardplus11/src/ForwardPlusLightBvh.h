@@ -0,0 +1,136 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusLightBvh.h
+//
+// Bounding volume hierarchy over the view-space light bounding spheres, for the CPU
+// light culler. With a large number of small lights, testing every light against
+// every tile costs O(tiles x lights), while walking a BVH only visits the subtrees
+// that overlap the tile.
+//
+// The BVH is a linear BVH (LBVH): the lights are sorted along a Morton curve through
+// their centers, the leaves are runs of LIGHT_BVH_LEAF_SIZE consecutive sorted lights,
+// and the internal nodes are found from the Morton codes of the leaves as in Karras,
+// "Maximizing Parallelism in the Construction of BVHs, Octrees, and k-d Trees" (HPG 2012).
+// Every step of the build is parallel, so it is cheap enough to rebuild every frame
+// (lights move, and so does the camera).
+//
+// Culling a tile against the BVH produces exactly the same list as testing every
+// light with the batched kernels: the node tests are conservative, and the lights
+// in the leaves that pass are tested with the same kernels.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ForwardPlusCpuCullKernels.h"
+
+#include <atomic>
+#include <vector>
+
+namespace ForwardPlus11
+{
+    // Lights per leaf, a multiple of CPU_CULL_BATCH_SIZE
+    static const unsigned LIGHT_BVH_LEAF_SIZE = 4*CPU_CULL_BATCH_SIZE;
+
+    //--------------------------------------------------------------------------------------
+    // A node of the BVH: the view-space AABB of the bounding spheres below it.
+    // The first GetNumLeaves()-1 nodes are the internal nodes, with node 0 as the root,
+    // and they are followed by the leaves (so with a single leaf, the root is that leaf).
+    //--------------------------------------------------------------------------------------
+    struct CpuLightBvhNode
+    {
+        float       fMin[3];
+        float       fMax[3];
+        unsigned    uChild[2];      // node indices, internal nodes only
+    };
+
+    class CpuLightBvh
+    {
+    public:
+        // Constructor / destructor
+        CpuLightBvh();
+        ~CpuLightBvh();
+
+        // Rebuild the BVH over Lights, using uNumThreads threads (0 means one per hardware thread).
+        // Only the light positions are copied, so Lights may change after this returns.
+        void Build( const CpuCullLightsSoA& Lights, unsigned uNumThreads );
+
+        // Writes the indices (into the Lights passed to Build) of the lights that pass the tile
+        // test to pOut, in ascending order, returning how many passed. Lights are tested with
+        // pfnKernel. pOut must have room for Lights.uNumLightsPadded entries.
+        unsigned Cull( const CpuCullTileFrustum& Tile, PFN_CPU_CULL_RANGE_KERNEL pfnKernel, unsigned* pOut ) const;
+
+        unsigned GetNumLights() const { return m_SortedLights.uNumLights; }
+        unsigned GetNumLeaves() const { return m_uNumLeaves; }
+        unsigned GetNumNodes() const { return (unsigned)m_Nodes.size(); }
+        const CpuLightBvhNode& GetNode( unsigned uNodeIdx ) const { return m_Nodes[uNodeIdx]; }
+
+        // The light index of the i-th light along the Morton curve
+        unsigned GetSortedLightIndex( unsigned i ) const { return m_SortedToLight[i]; }
+
+    private:
+
+        typedef void (CpuLightBvh::*PFN_BUILD_STEP)( unsigned uItem );
+        void RunBuildStep( PFN_BUILD_STEP pfnStep, unsigned uNumItems, unsigned uChunkSize );
+
+        // the build steps, each one run in parallel over blocks of lights, leaves, or nodes
+        void CalculateBlockBounds( unsigned uBlockIdx );
+        void CalculateBlockMortonCodes( unsigned uBlockIdx );
+        void CountBlockRadixDigits( unsigned uBlockIdx );
+        void ScatterBlockRadixDigits( unsigned uBlockIdx );
+        void GatherBlockSortedLights( unsigned uBlockIdx );
+        void CalculateLeafBounds( unsigned uLeafIdx );
+        void BuildInternalNode( unsigned uNodeIdx );
+        void RefitFromLeaf( unsigned uLeafIdx );
+
+        int GetLeafKeyPrefixLength( unsigned uLeafA, int nLeafB ) const;
+
+        unsigned                    m_uNumThreads;
+        unsigned                    m_uNumLeaves;
+
+        // build state
+        const CpuCullLightsSoA*     m_pBuildLights;
+        unsigned                    m_uNumBlocks;
+        float                       m_fSceneMin[3];
+        float                       m_fSceneScale[3];
+        unsigned                    m_uRadixShift;
+        std::vector<float>          m_BlockBounds;          // min xyz, max xyz per block
+        std::vector<unsigned>       m_BlockDigitOffsets;    // histogram, then scatter offsets, per block
+        std::vector<unsigned>       m_MortonCodes;
+        std::vector<unsigned>       m_MortonCodesTemp;
+        std::vector<unsigned>       m_SortedToLightTemp;
+        std::vector<unsigned>       m_Parents;
+        std::vector<std::atomic<unsigned> > m_RefitCounters;
+
+        // the BVH
+        CpuCullLightsSoA            m_SortedLights;
+        std::vector<unsigned>       m_SortedToLight;
+        std::vector<CpuLightBvhNode> m_Nodes;
+    };
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,177 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusLightCullStats.cpp
+//
+// Digesting the light list statistics gathered during culling.
+//--------------------------------------------------------------------------------------
+
+#include "ForwardPlusLightCullStats.h"
+
+#include <assert.h>
+
+namespace ForwardPlus11
+{
+
+    //--------------------------------------------------------------------------------------
+    // Digest a statistics buffer
+    //--------------------------------------------------------------------------------------
+    void CalculateLightCullStats( const unsigned* pStatsBuffer, LightCullStats* pStats )
+    {
+        const unsigned* pHistogram = pStatsBuffer + LIGHT_CULL_STATS_HISTOGRAM_OFFSET;
+        pStats->Histogram.assign( pHistogram, pHistogram + LIGHT_CULL_STATS_NUM_BINS );
+
+        // every list lands in exactly one bin
+        unsigned uNumLists = 0;
+        for( unsigned i = 0; i < LIGHT_CULL_STATS_NUM_BINS; i++ )
+        {
+            uNumLists += pHistogram[i];
+        }
+
+        pStats->uNumLists = uNumLists;
+        pStats->uNumOverflowedLists = pStatsBuffer[LIGHT_CULL_STATS_OVERFLOW_OFFSET];
+        pStats->uMaxNumLights = pStatsBuffer[LIGHT_CULL_STATS_MAX_OFFSET];
+        pStats->fMeanNumLights = ( uNumLists > 0 ) ? (float)pStatsBuffer[LIGHT_CULL_STATS_SUM_OFFSET] / (float)uNumLists : 0.f;
+        pStats->uNumSpotConeRejections = pStatsBuffer[LIGHT_CULL_STATS_SPOT_CONE_OFFSET];
+        pStats->uNumEmptyTiles = pStatsBuffer[LIGHT_CULL_STATS_TILE_CLASS_OFFSET + 0];
+        pStats->uNumUniformTiles = pStatsBuffer[LIGHT_CULL_STATS_TILE_CLASS_OFFSET + 1];
+        pStats->uNumComplexTiles = pStatsBuffer[LIGHT_CULL_STATS_TILE_CLASS_OFFSET + 2];
+        pStats->uP99NumLights = GetLightCullStatsPercentile( *pStats, 99.f );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Light count at a percentile of the lists
+    //--------------------------------------------------------------------------------------
+    unsigned GetLightCullStatsPercentile( const LightCullStats& Stats, float fPercentile )
+    {
+        assert( fPercentile >= 0.f && fPercentile <= 100.f );
+        if( Stats.uNumLists == 0 || Stats.Histogram.size() != LIGHT_CULL_STATS_NUM_BINS )
+        {
+            return 0;
+        }
+
+        // the number of lists that have to be covered, rounded up
+        double fNumLists = (double)Stats.uNumLists * fPercentile / 100.0;
+        unsigned uNumListsToCover = (unsigned)fNumLists;
+        uNumListsToCover += ( (double)uNumListsToCover < fNumLists ) ? 1 : 0;
+
+        unsigned uNumListsCovered = 0;
+        for( unsigned i = 0; i < LIGHT_CULL_STATS_NUM_BINS - 1; i++ )
+        {
+            uNumListsCovered += Stats.Histogram[i];
+            if( uNumListsCovered >= uNumListsToCover )
+            {
+                return i;
+            }
+        }
+
+        return Stats.uMaxNumLights;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Constructor
+    //--------------------------------------------------------------------------------------
+    LightListCapacitySizer::LightListCapacitySizer()
+        :m_uCapacity(0)
+        ,m_uMaxCapacity(0)
+        ,m_uNumResizes(0)
+        ,m_History(HISTORY_LENGTH, 0)
+        ,m_uNumFrames(0)
+    {
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Start over from a guess
+    //--------------------------------------------------------------------------------------
+    void LightListCapacitySizer::Reset( unsigned uCapacity, unsigned uMaxCapacity )
+    {
+        m_uMaxCapacity = uMaxCapacity;
+        m_uCapacity = ( uCapacity < uMaxCapacity ) ? uCapacity : uMaxCapacity;
+        m_uNumResizes = 0;
+        m_History.assign( HISTORY_LENGTH, 0 );
+        m_uNumFrames = 0;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The capacity a frame asks for
+    //--------------------------------------------------------------------------------------
+    unsigned LightListCapacitySizer::GetRequiredCapacity( const LightCullStats& Stats ) const
+    {
+        unsigned uNumLights = Stats.uP99NumLights + ( Stats.uP99NumLights*CAPACITY_HEADROOM_PERCENT + 99 ) / 100;
+        unsigned uMaxNumLights = Stats.uMaxNumLights + ( Stats.uMaxNumLights*MAX_HEADROOM_PERCENT + 99 ) / 100;
+        uNumLights = ( uMaxNumLights > uNumLights ) ? uMaxNumLights : uNumLights;
+
+        // plus the sentinels
+        unsigned uCapacity = ( ( uNumLights + 2 + CAPACITY_GRANULARITY - 1 ) / CAPACITY_GRANULARITY ) * CAPACITY_GRANULARITY;
+        return ( uCapacity < m_uMaxCapacity ) ? uCapacity : m_uMaxCapacity;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Grow right away, shrink with hysteresis
+    //--------------------------------------------------------------------------------------
+    bool LightListCapacitySizer::Update( const LightCullStats& Stats )
+    {
+        if( Stats.uNumLists == 0 )
+        {
+            return false;
+        }
+
+        unsigned uRequiredCapacity = GetRequiredCapacity( Stats );
+        bool bFirstFrame = ( m_uNumFrames == 0 );
+        m_History[m_uNumFrames % HISTORY_LENGTH] = uRequiredCapacity;
+        m_uNumFrames++;
+
+        unsigned uNewCapacity = m_uCapacity;
+        if( uRequiredCapacity > m_uCapacity || bFirstFrame )
+        {
+            uNewCapacity = uRequiredCapacity;
+        }
+        else if( m_uNumFrames >= HISTORY_LENGTH )
+        {
+            unsigned uRecentCapacity = 0;
+            for( unsigned i = 0; i < HISTORY_LENGTH; i++ )
+            {
+                uRecentCapacity = ( m_History[i] > uRecentCapacity ) ? m_History[i] : uRecentCapacity;
+            }
+
+            if( 100*uRecentCapacity <= SHRINK_THRESHOLD_PERCENT*m_uCapacity )
+            {
+                uNewCapacity = uRecentCapacity;
+            }
+        }
+
+        if( uNewCapacity == m_uCapacity )
+        {
+            return false;
+        }
+
+        m_uCapacity = uNewCapacity;
+        m_uNumResizes++;
+        return true;
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
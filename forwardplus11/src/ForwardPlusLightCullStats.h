@@ -0,0 +1,167 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusLightCullStats.h
+//
+// Per-frame statistics on the length of the light lists, gathered by CullLightsCS and 
+// CullLightsClusteredCS (into a small R32_UINT buffer, read back by ForwardPlusUtil) 
+// and by the CPU culler (CpuLightCuller::GetLightCullStats), so that the light index 
+// buffers can be sized from measurements:
+//
+//   [LIGHT_CULL_STATS_OVERFLOW_OFFSET]     number of lists that did not fit their slot
+//                                          (and got clamped)
+//   [LIGHT_CULL_STATS_MAX_OFFSET]          number of lights in the longest list
+//   [LIGHT_CULL_STATS_SUM_OFFSET]          number of lights in all the lists together
+//   [LIGHT_CULL_STATS_SPOT_CONE_OFFSET]    number of spot lights that passed a tile with
+//                                          their bounding sphere, but were dropped from
+//                                          its list because their cone did not (see
+//                                          ForwardPlusSpotCones.h), i.e. the false
+//                                          positives of the sphere test
+//   [LIGHT_CULL_STATS_TILE_CLASS_OFFSET]   TILE_CLASS_COUNT counters, the number of tiles
+//                                          of each class (see ClassifyTile in
+//                                          ForwardPlusCpuCuller.h)
+//   [LIGHT_CULL_STATS_HISTOGRAM_OFFSET]    LIGHT_CULL_STATS_NUM_BINS counters, the i-th
+//                                          one counting the lists with i lights (the last
+//                                          one also counts all the longer lists)
+//
+// The light counts are the ones before clamping, so they show how long the lists 
+// would need to be, and the sentinels are not counted. The buffer is cleared to 0 
+// before culling.
+//
+// This must match the statistics code in ForwardPlus11Tiling.hlsl.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <vector>
+
+namespace ForwardPlus11
+{
+    static const unsigned LIGHT_CULL_STATS_OVERFLOW_OFFSET = 0;
+    static const unsigned LIGHT_CULL_STATS_MAX_OFFSET = 1;
+    static const unsigned LIGHT_CULL_STATS_SUM_OFFSET = 2;
+    static const unsigned LIGHT_CULL_STATS_SPOT_CONE_OFFSET = 3;
+    static const unsigned LIGHT_CULL_STATS_TILE_CLASS_OFFSET = 4;
+    static const unsigned LIGHT_CULL_STATS_HISTOGRAM_OFFSET = 7;
+
+    // One bin per light count, enough for twice the longest list of 
+    // the biggest tiles (GetMaxNumLightsPerTileForTileRes( 64 ))
+    static const unsigned LIGHT_CULL_STATS_NUM_BINS = 4096;
+    static const unsigned LIGHT_CULL_STATS_BUFFER_SIZE = LIGHT_CULL_STATS_HISTOGRAM_OFFSET + LIGHT_CULL_STATS_NUM_BINS;
+
+    //--------------------------------------------------------------------------------------
+    // The statistics buffer, digested
+    //--------------------------------------------------------------------------------------
+    struct LightCullStats
+    {
+        unsigned                uNumLists;
+        unsigned                uNumOverflowedLists;
+        unsigned                uMaxNumLights;
+        unsigned                uP99NumLights;          // 99% of the lists have this many lights or fewer
+        float                   fMeanNumLights;
+        unsigned                uNumSpotConeRejections; // 0 unless spot lights are culled by their cones
+        unsigned                uNumEmptyTiles;         // the tiles of each class (see ClassifyTile)
+        unsigned                uNumUniformTiles;
+        unsigned                uNumComplexTiles;
+        std::vector<unsigned>   Histogram;              // LIGHT_CULL_STATS_NUM_BINS bins, see above
+
+        LightCullStats() : uNumLists(0), uNumOverflowedLists(0), uMaxNumLights(0), uP99NumLights(0), fMeanNumLights(0.f), uNumSpotConeRejections(0),
+                           uNumEmptyTiles(0), uNumUniformTiles(0), uNumComplexTiles(0) {}
+    };
+
+    //--------------------------------------------------------------------------------------
+    // Add one list to a statistics buffer of LIGHT_CULL_STATS_BUFFER_SIZE entries 
+    // (the CPU version of what the shaders do for every list)
+    //--------------------------------------------------------------------------------------
+    inline void AccumulateLightCullStats( unsigned* pStatsBuffer, unsigned uNumLights, bool bOverflowed )
+    {
+        unsigned uBin = ( uNumLights < LIGHT_CULL_STATS_NUM_BINS - 1 ) ? uNumLights : LIGHT_CULL_STATS_NUM_BINS - 1;
+        pStatsBuffer[LIGHT_CULL_STATS_OVERFLOW_OFFSET] += bOverflowed ? 1 : 0;
+        pStatsBuffer[LIGHT_CULL_STATS_MAX_OFFSET] = ( uNumLights > pStatsBuffer[LIGHT_CULL_STATS_MAX_OFFSET] ) ? uNumLights : pStatsBuffer[LIGHT_CULL_STATS_MAX_OFFSET];
+        pStatsBuffer[LIGHT_CULL_STATS_SUM_OFFSET] += uNumLights;
+        pStatsBuffer[LIGHT_CULL_STATS_HISTOGRAM_OFFSET + uBin]++;
+    }
+
+    // Digest a statistics buffer (LIGHT_CULL_STATS_BUFFER_SIZE entries)
+    void CalculateLightCullStats( const unsigned* pStatsBuffer, LightCullStats* pStats );
+
+    // Smallest light count that fPercentile percent of the lists do not exceed 
+    // (uMaxNumLights if that falls into the last bin)
+    unsigned GetLightCullStatsPercentile( const LightCullStats& Stats, float fPercentile );
+
+    //--------------------------------------------------------------------------------------
+    // Sizes the fixed list slots of the light index buffer (GetMaxNumLightsPerTile) from 
+    // the statistics of recent frames, rather than from the screen height.
+    //
+    // Each frame asks for the p99 list length plus CAPACITY_HEADROOM_PERCENT, but at least 
+    // the longest list plus MAX_HEADROOM_PERCENT, plus the two sentinels, rounded up to 
+    // CAPACITY_GRANULARITY. The first frame measured replaces the guess the sizer started 
+    // from. After that, the capacity grows right away, and only shrinks once every frame 
+    // of the last HISTORY_LENGTH has asked for at most SHRINK_THRESHOLD_PERCENT of it (and 
+    // then to the most any of them asked for), so that it does not flip back and forth. 
+    // It never goes past the most a list can hold (the length of the list in LDS). 
+    //
+    // The statistics arrive a few frames late, so the headroom is what keeps lists from 
+    // being clamped while the scene changes; when one does overflow anyway, the next 
+    // update grows the capacity to fit it.
+    //--------------------------------------------------------------------------------------
+    class LightListCapacitySizer
+    {
+    public:
+        static const unsigned CAPACITY_GRANULARITY = 32;
+        static const unsigned CAPACITY_HEADROOM_PERCENT = 25;
+        static const unsigned MAX_HEADROOM_PERCENT = 12;
+        static const unsigned SHRINK_THRESHOLD_PERCENT = 75;
+        static const unsigned HISTORY_LENGTH = 60;
+
+        LightListCapacitySizer();
+
+        // Start over from uCapacity (a guess, until frames have been measured), 
+        // which is never allowed to grow past uMaxCapacity
+        void Reset( unsigned uCapacity, unsigned uMaxCapacity );
+
+        // Take one frame's statistics into account (frames without any lists are ignored). 
+        // Returns true if the capacity changed.
+        bool Update( const LightCullStats& Stats );
+
+        unsigned GetCapacity() const { return m_uCapacity; }
+        unsigned GetNumResizes() const { return m_uNumResizes; }
+
+        // The capacity a frame with these statistics asks for
+        unsigned GetRequiredCapacity( const LightCullStats& Stats ) const;
+
+    private:
+        unsigned                m_uCapacity;
+        unsigned                m_uMaxCapacity;
+        unsigned                m_uNumResizes;
+
+        // GetRequiredCapacity of the last HISTORY_LENGTH frames (a ring)
+        std::vector<unsigned>   m_History;
+        unsigned                m_uNumFrames;
+    };
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
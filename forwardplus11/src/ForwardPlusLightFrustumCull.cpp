@@ -0,0 +1,177 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusLightFrustumCull.cpp
+//
+// Culling the lights against the camera frustum on the CPU.
+//--------------------------------------------------------------------------------------
+
+#include "ForwardPlusLightFrustumCull.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define LIGHT_FRUSTUM_CULL_SSE2 1
+#include <emmintrin.h>
+#else
+#define LIGHT_FRUSTUM_CULL_SSE2 0
+#endif
+
+using namespace DirectX;
+
+namespace ForwardPlus11
+{
+    //--------------------------------------------------------------------------------------
+    // The radius a light is tested with. The plane distance has a rounding error of about 
+    // an ulp of the terms that go into it, and the center coordinates are world space, so 
+    // they can be much larger than the distance.
+    //--------------------------------------------------------------------------------------
+    static float GetFrustumTestRadius( const XMFLOAT4& CenterAndRadius, float fAbsPlaneW )
+    {
+        float x = CenterAndRadius.x, y = CenterAndRadius.y, z = CenterAndRadius.z, r = CenterAndRadius.w;
+        float fAbsSum = ( ( x < 0.f ) ? -x : x ) + ( ( y < 0.f ) ? -y : y ) + ( ( z < 0.f ) ? -z : z );
+        return r + 1e-4f*( fAbsSum + fAbsPlaneW + r );
+    }
+
+    static float GetMaxAbsPlaneW( const XMFLOAT4* pPlanes )
+    {
+        float fMaxAbsW = 0.f;
+        for( unsigned p = 0; p < NUM_FRUSTUM_PLANES; p++ )
+        {
+            float fAbsW = ( pPlanes[p].w < 0.f ) ? -pPlanes[p].w : pPlanes[p].w;
+            fMaxAbsW = ( fAbsW > fMaxAbsW ) ? fAbsW : fMaxAbsW;
+        }
+        return fMaxAbsW;
+    }
+
+    static bool IsLightInFrustum( const XMFLOAT4* pPlanes, float fMaxAbsPlaneW, const XMFLOAT4& CenterAndRadius )
+    {
+        float r = GetFrustumTestRadius( CenterAndRadius, fMaxAbsPlaneW );
+        for( unsigned p = 0; p < NUM_FRUSTUM_PLANES; p++ )
+        {
+            float d = pPlanes[p].x*CenterAndRadius.x + pPlanes[p].y*CenterAndRadius.y + pPlanes[p].z*CenterAndRadius.z + pPlanes[p].w;
+            if( d < -r )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Scalar version
+    //--------------------------------------------------------------------------------------
+    unsigned CullLightsToFrustumScalar( const XMFLOAT4* pPlanes, const XMFLOAT4* pCenterAndRadius, unsigned uNumLights, unsigned* pVisibleLights )
+    {
+        float fMaxAbsPlaneW = GetMaxAbsPlaneW( pPlanes );
+
+        unsigned uNumVisibleLights = 0;
+        for( unsigned i = 0; i < uNumLights; i++ )
+        {
+            if( IsLightInFrustum( pPlanes, fMaxAbsPlaneW, pCenterAndRadius[i] ) )
+            {
+                pVisibleLights[uNumVisibleLights++] = i;
+            }
+        }
+        return uNumVisibleLights;
+    }
+
+#if LIGHT_FRUSTUM_CULL_SSE2
+
+    //--------------------------------------------------------------------------------------
+    // SSE2 version, 4 lights at a time. The lights are transposed into x, y, z and r 
+    // registers, and the indices of the ones that pass are written out without branching: 
+    // every lane stores its index at the current end, and only the passing ones move it on.
+    // The lights after the last multiple of 4 go through the scalar test.
+    //--------------------------------------------------------------------------------------
+    unsigned CullLightsToFrustum( const XMFLOAT4* pPlanes, const XMFLOAT4* pCenterAndRadius, unsigned uNumLights, unsigned* pVisibleLights )
+    {
+        float fMaxAbsPlaneW = GetMaxAbsPlaneW( pPlanes );
+
+        __m128 vPlaneX[NUM_FRUSTUM_PLANES], vPlaneY[NUM_FRUSTUM_PLANES], vPlaneZ[NUM_FRUSTUM_PLANES], vPlaneW[NUM_FRUSTUM_PLANES];
+        for( unsigned p = 0; p < NUM_FRUSTUM_PLANES; p++ )
+        {
+            vPlaneX[p] = _mm_set1_ps( pPlanes[p].x );
+            vPlaneY[p] = _mm_set1_ps( pPlanes[p].y );
+            vPlaneZ[p] = _mm_set1_ps( pPlanes[p].z );
+            vPlaneW[p] = _mm_set1_ps( pPlanes[p].w );
+        }
+        const __m128 vAbsMask = _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) );
+        const __m128 vEpsilon = _mm_set1_ps( 1e-4f );
+        const __m128 vMaxAbsPlaneW = _mm_set1_ps( fMaxAbsPlaneW );
+
+        unsigned uNumVisibleLights = 0;
+        unsigned uNumLightsSIMD = uNumLights & ~3u;
+        for( unsigned i = 0; i < uNumLightsSIMD; i += 4 )
+        {
+            __m128 x = _mm_loadu_ps( &pCenterAndRadius[i].x );
+            __m128 y = _mm_loadu_ps( &pCenterAndRadius[i + 1].x );
+            __m128 z = _mm_loadu_ps( &pCenterAndRadius[i + 2].x );
+            __m128 r = _mm_loadu_ps( &pCenterAndRadius[i + 3].x );
+            _MM_TRANSPOSE4_PS( x, y, z, r );
+
+            // the same expression as GetFrustumTestRadius, negated for the test below
+            __m128 vAbsSum = _mm_add_ps( _mm_add_ps( _mm_and_ps( x, vAbsMask ), _mm_and_ps( y, vAbsMask ) ), _mm_and_ps( z, vAbsMask ) );
+            __m128 vNegR = _mm_sub_ps( _mm_setzero_ps(), _mm_add_ps( r, _mm_mul_ps( vEpsilon, _mm_add_ps( _mm_add_ps( vAbsSum, vMaxAbsPlaneW ), r ) ) ) );
+
+            __m128 vPass = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+            for( unsigned p = 0; p < NUM_FRUSTUM_PLANES; p++ )
+            {
+                __m128 d = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( vPlaneX[p], x ), _mm_mul_ps( vPlaneY[p], y ) ), _mm_mul_ps( vPlaneZ[p], z ) ), vPlaneW[p] );
+                vPass = _mm_and_ps( vPass, _mm_cmpge_ps( d, vNegR ) );
+            }
+
+            unsigned uMask = (unsigned)_mm_movemask_ps( vPass );
+            pVisibleLights[uNumVisibleLights] = i;
+            uNumVisibleLights += uMask & 1;
+            pVisibleLights[uNumVisibleLights] = i + 1;
+            uNumVisibleLights += ( uMask >> 1 ) & 1;
+            pVisibleLights[uNumVisibleLights] = i + 2;
+            uNumVisibleLights += ( uMask >> 2 ) & 1;
+            pVisibleLights[uNumVisibleLights] = i + 3;
+            uNumVisibleLights += ( uMask >> 3 ) & 1;
+        }
+
+        for( unsigned i = uNumLightsSIMD; i < uNumLights; i++ )
+        {
+            if( IsLightInFrustum( pPlanes, fMaxAbsPlaneW, pCenterAndRadius[i] ) )
+            {
+                pVisibleLights[uNumVisibleLights++] = i;
+            }
+        }
+
+        return uNumVisibleLights;
+    }
+
+#else
+
+    unsigned CullLightsToFrustum( const XMFLOAT4* pPlanes, const XMFLOAT4* pCenterAndRadius, unsigned uNumLights, unsigned* pVisibleLights )
+    {
+        return CullLightsToFrustumScalar( pPlanes, pCenterAndRadius, uNumLights, pVisibleLights );
+    }
+
+#endif
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
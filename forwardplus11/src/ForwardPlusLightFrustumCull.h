@@ -0,0 +1,72 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusLightFrustumCull.h
+//
+// Culling the lights against the camera frustum on the CPU, before they go to the GPU.
+// Without it, every tile loops over all the active lights, including the ones behind the
+// camera. The lights that pass are compacted (in the order they were in), so that the
+// light culling shaders (and CpuLightCuller) only loop over those, and the index of the
+// light each one came from is kept as a remap table, to map the indices in the light
+// lists back to the full light arrays.
+//
+// Only lights that can not light any pixel are dropped, so with depth bounds, the lists
+// are the same after remapping as without the pre-cull. Without depth bounds, the tiles
+// reach to infinity, so their lists lose the lights beyond the far plane too.
+//
+// Has no dependencies on D3D or DXUT, so that it can be used headless.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <DirectXMath.h>
+
+namespace ForwardPlus11
+{
+    static const unsigned NUM_FRUSTUM_PLANES = 6;
+
+    //--------------------------------------------------------------------------------------
+    // Writes the indices of the lights in [0,uNumLights) whose bounding sphere is not 
+    // completely outside one of the planes to pVisibleLights (which must have room for 
+    // uNumLights), in ascending order, and returns how many there are. The planes are 
+    // NUM_FRUSTUM_PLANES planes like AMD::ExtractPlanesFromFrustum returns them: normalized, 
+    // with the inside of the frustum in the positive half-space, and in the same space as 
+    // the light centers. Tests 4 lights at a time with SSE2 where it is available.
+    //
+    // The spheres are grown by a bound on the rounding error of the plane distance (like 
+    // GetCoarseTileTestRadius), since the tiles get their planes from different corners.
+    //
+    // pVisibleLights is the remap table: compact the light arrays with ReorderLightArray 
+    // (see ForwardPlusLightSort.h), and light i of the compacted arrays is light 
+    // pVisibleLights[i] of the full ones.
+    //--------------------------------------------------------------------------------------
+    unsigned CullLightsToFrustum( const DirectX::XMFLOAT4* pPlanes, const DirectX::XMFLOAT4* pCenterAndRadius, unsigned uNumLights, unsigned* pVisibleLights );
+
+    // The same, one light at a time, as the reference for the SSE2 version
+    unsigned CullLightsToFrustumScalar( const DirectX::XMFLOAT4* pPlanes, const DirectX::XMFLOAT4* pCenterAndRadius, unsigned uNumLights, unsigned* pVisibleLights );
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,120 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusLightLod.h
+//
+// Light LOD: dropping the lights of a tile that can not add enough to any of its pixels 
+// to be worth evaluating. A light is in a tile's list if its sphere touches the tile, but 
+// RenderScenePS scales it by a falloff that is already down to 0.5% of its color at 95% 
+// of its radius, so the lights that only reach a tile with the edge of their sphere cost 
+// a full evaluation per pixel for next to nothing.
+//
+// The most a light can add to a pixel of a tile is its color, times the most RenderScenePS 
+// scales a light by (2 for diffuse plus 8 for specular, with every other factor at 1), 
+// times its falloff at the closest point of the tile. The distance to that point is at 
+// least the distance to any one of the tile's side planes or its depth slab, so this 
+// bound holds for every pixel, and a light whose bound is below the threshold is dropped. 
+// Spot lights are bounded by their cone's apex and falloff radius, so they need their 
+// cones (see ForwardPlusSpotCones.h).
+//
+// The dropped lights can be merged into an ambient term per tile instead, each adding 
+// an estimate of its average contribution to every pixel of the tile.
+//
+// The bound must match TestLightContribution in ForwardPlus11Tiling.hlsl.
+//
+// Has no dependencies on D3D or DXUT, so that it can be used headless.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ForwardPlusCpuCullKernels.h"
+
+namespace ForwardPlus11
+{
+    // The most RenderScenePS scales a light's color by: AccumDiffuse*2 + AccumSpecular*8, 
+    // with the diffuse and specular terms, the specular mask and the texture all at most 1
+    static const float LIGHT_LOD_MAX_LIGHTING_SCALE = 10.f;
+
+    // Half a step of an 8-bit target: a light that adds less than this to every pixel 
+    // can not change the rounded color on its own
+    static const float LIGHT_LOD_DEFAULT_THRESHOLD = 0.5f/255.f;
+
+    // How much of its color a dropped light adds to the ambient term of a tile, per unit of 
+    // its largest falloff in the tile. The bound is far above what a dropped light adds on 
+    // average (it only reaches a corner of most tiles it is dropped from, and faces few of 
+    // their pixels), so this is small: in the light LOD benchmark, larger values make the 
+    // merged frame worse than leaving the dropped lights out.
+    static const float LIGHT_LOD_AMBIENT_SCALE = 0.02f;
+
+    //--------------------------------------------------------------------------------------
+    // The falloff of RenderScenePS, -0.05 + 1.05/(1+20x^2) with x the distance over the 
+    // radius, which reaches 0 at the radius
+    //--------------------------------------------------------------------------------------
+    inline float GetLightLodFalloff( float fDistance, float fRadius )
+    {
+        float x = fDistance / fRadius;
+        x = ( x < 1.f ) ? x : 1.f;
+        float fFalloff = -0.05f + 1.05f/( 1.f + 20.f*x*x );
+        return ( fFalloff > 0.f ) ? fFalloff : 0.f;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // A lower bound of the distance from a view-space point to the tile: the largest of 
+    // its signed distances to the side planes and to the depth slab, or 0 inside the tile
+    //--------------------------------------------------------------------------------------
+    inline float GetMinDistanceToTile( const CpuCullTileFrustum& Frustum, float x, float y, float z )
+    {
+        float fDistance = 0.f;
+        for( unsigned i = 0; i < 4; i++ )
+        {
+            float fPlaneDistance = Frustum.fPlaneX[i]*x + Frustum.fPlaneY[i]*y + Frustum.fPlaneZ[i]*z;
+            fDistance = ( fPlaneDistance > fDistance ) ? fPlaneDistance : fDistance;
+        }
+        fDistance = ( Frustum.fMinZ - z > fDistance ) ? Frustum.fMinZ - z : fDistance;
+        fDistance = ( z - Frustum.fMaxZ > fDistance ) ? z - Frustum.fMaxZ : fDistance;
+        return fDistance;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The largest falloff a light has in the tile, with its falloff centered on (x,y,z)
+    // in view space
+    //--------------------------------------------------------------------------------------
+    inline float GetMaxFalloffInTile( const CpuCullTileFrustum& Frustum, float x, float y, float z, float fFalloffRadius )
+    {
+        return GetLightLodFalloff( GetMinDistanceToTile( Frustum, x, y, z ), fFalloffRadius );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The most a light can add to any channel of any pixel of the tile, given its largest 
+    // falloff in the tile and its brightest channel
+    //--------------------------------------------------------------------------------------
+    inline float GetMaxLightContribution( float fMaxFalloff, float fMaxColor )
+    {
+        return LIGHT_LOD_MAX_LIGHTING_SCALE*fMaxColor*fMaxFalloff;
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
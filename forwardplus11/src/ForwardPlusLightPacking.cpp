@@ -0,0 +1,240 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusLightPacking.cpp
+//
+// Packed light buffers, see ForwardPlusLightPacking.h.
+//--------------------------------------------------------------------------------------
+
+#include "ForwardPlusLightPacking.h"
+#include "ForwardPlusHalf.h"
+
+#include <assert.h>
+#include <math.h>
+
+using namespace DirectX;
+
+// Largest radius a half can hold
+static const float MAX_PACKED_LIGHT_RADIUS = 65504.f;
+
+// Quantize one coordinate to 16 bits across the bounds, rounding to nearest
+static unsigned PackCoordinate( float fValue, float fOrigin, float fScale )
+{
+    float fSteps = floorf( ( fValue - fOrigin ) / fScale + 0.5f );
+    fSteps = fSteps < 0.f ? 0.f : fSteps;
+    fSteps = fSteps > 65535.f ? 65535.f : fSteps;
+    return (unsigned)fSteps;
+}
+
+static float UnpackCoordinate( unsigned uSteps, float fOrigin, float fScale )
+{
+    return fOrigin + (float)uSteps*fScale;
+}
+
+// Clamp a color channel to what RGB9E5 can hold (NaN goes to 0)
+static float ClampRGB9E5Channel( float fValue )
+{
+    return ( fValue > 0.f ) ? ( fValue < ForwardPlus11::MAX_RGB9E5_VALUE ? fValue : ForwardPlus11::MAX_RGB9E5_VALUE ) : 0.f;
+}
+
+namespace ForwardPlus11
+{
+
+    //--------------------------------------------------------------------------------------
+    // The bounds for packing positions in [vMin,vMax]
+    //--------------------------------------------------------------------------------------
+    PackedLightBounds GetPackedLightBounds( const XMFLOAT3& vMin, const XMFLOAT3& vMax )
+    {
+        const float fMinExtent = 1e-6f;
+        float fExtentX = vMax.x - vMin.x;
+        float fExtentY = vMax.y - vMin.y;
+        float fExtentZ = vMax.z - vMin.z;
+
+        PackedLightBounds Bounds;
+        Bounds.vOrigin = vMin;
+        Bounds.vScale.x = ( fExtentX > fMinExtent ? fExtentX : fMinExtent ) / 65535.f;
+        Bounds.vScale.y = ( fExtentY > fMinExtent ? fExtentY : fMinExtent ) / 65535.f;
+        Bounds.vScale.z = ( fExtentZ > fMinExtent ? fExtentZ : fMinExtent ) / 65535.f;
+        return Bounds;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Pack the position of one light, returning the radius it needs to stay inside the 
+    // original sphere (which still has to be rounded down to half precision)
+    //--------------------------------------------------------------------------------------
+    static float PackLightPosition( const PackedLightBounds& Bounds, const XMFLOAT4& CenterAndRadius, unsigned* pPositionXY, unsigned* pPositionZ )
+    {
+        unsigned uX = PackCoordinate( CenterAndRadius.x, Bounds.vOrigin.x, Bounds.vScale.x );
+        unsigned uY = PackCoordinate( CenterAndRadius.y, Bounds.vOrigin.y, Bounds.vScale.y );
+        unsigned uZ = PackCoordinate( CenterAndRadius.z, Bounds.vOrigin.z, Bounds.vScale.z );
+        *pPositionXY = uX | ( uY << 16 );
+        *pPositionZ = uZ;
+
+        // shrink the radius by how far the center moved
+        float fDeltaX = UnpackCoordinate( uX, Bounds.vOrigin.x, Bounds.vScale.x ) - CenterAndRadius.x;
+        float fDeltaY = UnpackCoordinate( uY, Bounds.vOrigin.y, Bounds.vScale.y ) - CenterAndRadius.y;
+        float fDeltaZ = UnpackCoordinate( uZ, Bounds.vOrigin.z, Bounds.vScale.z ) - CenterAndRadius.z;
+        float fRadius = CenterAndRadius.w - sqrtf( fDeltaX*fDeltaX + fDeltaY*fDeltaY + fDeltaZ*fDeltaZ );
+        fRadius = fRadius > 0.f ? fRadius : 0.f;
+        return fRadius < MAX_PACKED_LIGHT_RADIUS ? fRadius : MAX_PACKED_LIGHT_RADIUS;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Pack one light
+    //--------------------------------------------------------------------------------------
+    PackedLight PackLight( const PackedLightBounds& Bounds, const XMFLOAT4& CenterAndRadius, const XMFLOAT3& Color )
+    {
+        PackedLight Light;
+        float fRadius = PackLightPosition( Bounds, CenterAndRadius, &Light.uPositionXY, &Light.uPositionZAndRadius );
+
+        // the radius is positive, so rounding toward zero rounds it down
+        Light.uPositionZAndRadius |= (unsigned)ConvertF32ToF16( fRadius, HALF_ROUND_TOWARD_ZERO ) << 16;
+        Light.uColor = PackColorRGB9E5( Color );
+        return Light;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Unpack one light
+    //--------------------------------------------------------------------------------------
+    void UnpackLight( const PackedLightBounds& Bounds, const PackedLight& Light, XMFLOAT4* pCenterAndRadius, XMFLOAT3* pColor )
+    {
+        pCenterAndRadius->x = UnpackCoordinate( Light.uPositionXY & 0xFFFFu, Bounds.vOrigin.x, Bounds.vScale.x );
+        pCenterAndRadius->y = UnpackCoordinate( Light.uPositionXY >> 16, Bounds.vOrigin.y, Bounds.vScale.y );
+        pCenterAndRadius->z = UnpackCoordinate( Light.uPositionZAndRadius & 0xFFFFu, Bounds.vOrigin.z, Bounds.vScale.z );
+        pCenterAndRadius->w = ConvertF16ToF32( (unsigned short)( Light.uPositionZAndRadius >> 16 ) );
+        *pColor = UnpackColorRGB9E5( Light.uColor );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Pack the lights pIndices picks
+    //--------------------------------------------------------------------------------------
+    void PackLights( const PackedLightBounds& Bounds, const XMFLOAT4* pCenterAndRadius, const unsigned* pColors, 
+                     const unsigned* pIndices, unsigned uNumLights, PackedLight* pPackedLights )
+    {
+        // the radii are converted to half precision a batch at a time
+        const unsigned BATCH_SIZE = 256;
+        float fRadii[BATCH_SIZE];
+        unsigned short uRadii[BATCH_SIZE];
+
+        for( unsigned uBatchStart = 0; uBatchStart < uNumLights; uBatchStart += BATCH_SIZE )
+        {
+            unsigned uBatchSize = ( uNumLights - uBatchStart < BATCH_SIZE ) ? uNumLights - uBatchStart : BATCH_SIZE;
+            PackedLight* pBatch = &pPackedLights[uBatchStart];
+
+            for( unsigned i = 0; i < uBatchSize; i++ )
+            {
+                unsigned uLightIdx = pIndices ? pIndices[uBatchStart + i] : uBatchStart + i;
+                fRadii[i] = PackLightPosition( Bounds, pCenterAndRadius[uLightIdx], &pBatch[i].uPositionXY, &pBatch[i].uPositionZAndRadius );
+                pBatch[i].uColor = PackColorRGB9E5( UnpackColorRGBA8( pColors[uLightIdx] ) );
+            }
+
+            ConvertF32ToF16( fRadii, uRadii, uBatchSize, HALF_ROUND_TOWARD_ZERO );
+            for( unsigned i = 0; i < uBatchSize; i++ )
+            {
+                pBatch[i].uPositionZAndRadius |= (unsigned)uRadii[i] << 16;
+            }
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Shared-exponent color: a 9-bit mantissa per channel (no implicit one) and a 5-bit 
+    // exponent with a bias of 15, so each channel is mantissa*2^(exponent-15-9)
+    //--------------------------------------------------------------------------------------
+    unsigned PackColorRGB9E5( const XMFLOAT3& Color )
+    {
+        float fR = ClampRGB9E5Channel( Color.x );
+        float fG = ClampRGB9E5Channel( Color.y );
+        float fB = ClampRGB9E5Channel( Color.z );
+        float fMax = fR > fG ? fR : fG;
+        fMax = fMax > fB ? fMax : fB;
+
+        // the exponent that puts the largest channel in [256,512) steps, 
+        // i.e. floor(log2(fMax)) + 1 + 15, but at least 0
+        int nExponent = 0;
+        frexpf( fMax, &nExponent );
+        int nSharedExponent = nExponent + 15 > 0 ? nExponent + 15 : 0;
+
+        // rounding can carry the largest channel over, into the next exponent
+        float fStep = ldexpf( 1.f, nSharedExponent - 15 - 9 );
+        if( floorf( fMax/fStep + 0.5f ) >= 512.f )
+        {
+            nSharedExponent++;
+            fStep *= 2.f;
+        }
+        assert( nSharedExponent <= 31 );
+
+        unsigned uR = (unsigned)floorf( fR/fStep + 0.5f );
+        unsigned uG = (unsigned)floorf( fG/fStep + 0.5f );
+        unsigned uB = (unsigned)floorf( fB/fStep + 0.5f );
+        return uR | ( uG << 9 ) | ( uB << 18 ) | ( (unsigned)nSharedExponent << 27 );
+    }
+
+    XMFLOAT3 UnpackColorRGB9E5( unsigned uColor )
+    {
+        float fStep = ldexpf( 1.f, (int)( uColor >> 27 ) - 15 - 9 );
+        return XMFLOAT3( (float)( uColor & 0x1FFu )*fStep, (float)( ( uColor >> 9 ) & 0x1FFu )*fStep, (float)( ( uColor >> 18 ) & 0x1FFu )*fStep );
+    }
+
+    XMFLOAT3 UnpackColorRGBA8( unsigned uColor )
+    {
+        return XMFLOAT3( (float)( uColor & 0xff ) / 255.f, (float)( ( uColor >> 8 ) & 0xff ) / 255.f, (float)( ( uColor >> 16 ) & 0xff ) / 255.f );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Error bounds
+    //--------------------------------------------------------------------------------------
+    XMFLOAT3 GetPackedLightPositionErrorBound( const PackedLightBounds& Bounds )
+    {
+        // half a step, plus the rounding of the unpacking (a relative error of 
+        // at most 2^-23 of the largest value it goes through, each way)
+        XMFLOAT3 vBound;
+        vBound.x = 0.5f*Bounds.vScale.x + ldexpf( fabsf( Bounds.vOrigin.x ) + 65535.f*Bounds.vScale.x, -22 );
+        vBound.y = 0.5f*Bounds.vScale.y + ldexpf( fabsf( Bounds.vOrigin.y ) + 65535.f*Bounds.vScale.y, -22 );
+        vBound.z = 0.5f*Bounds.vScale.z + ldexpf( fabsf( Bounds.vOrigin.z ) + 65535.f*Bounds.vScale.z, -22 );
+        return vBound;
+    }
+
+    float GetPackedLightRadiusErrorBound( const PackedLightBounds& Bounds, float fRadius )
+    {
+        // the distance the center can move, plus one half-precision step at the radius
+        XMFLOAT3 vPositionBound = GetPackedLightPositionErrorBound( Bounds );
+        int nExponent = 0;
+        frexpf( fRadius, &nExponent );
+        float fHalfStep = ldexpf( 1.f, ( nExponent > -13 ? nExponent : -13 ) - 11 );
+        return sqrtf( vPositionBound.x*vPositionBound.x + vPositionBound.y*vPositionBound.y + vPositionBound.z*vPositionBound.z ) + fHalfStep;
+    }
+
+    float GetRGB9E5ErrorBound( float fMaxChannel )
+    {
+        // half a step, and the step is at most 2^-8 of the largest channel 
+        // (or the smallest step, 2^-24, for tiny colors)
+        float fBound = ldexpf( ClampRGB9E5Channel( fMaxChannel ), -9 );
+        return fBound > ldexpf( 1.f, -25 ) ? fBound : ldexpf( 1.f, -25 );
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusLightPacking.h
+//
+// Packed light buffers, an optional compact format for the lights the forward pass 
+// shades with (the USE_PACKED_LIGHTS permutations of RenderScenePS). A light's bounding 
+// sphere and color take 12 bytes instead of 20 (a float4 center and radius and an RGBA8 
+// color), in one buffer instead of two:
+//
+//   uint 0: center x (bits 0-15) and y (bits 16-31), 16-bit unorm across the bounds
+//   uint 1: center z (bits 0-15), 16-bit unorm, and the radius (bits 16-31), a half
+//   uint 2: color, RGB9E5 (like DXGI_FORMAT_R9G9B9E5_SHAREDEXP)
+//
+// The bounds are the scene AABB from CalculateSceneMinMax, grown to cover where the 
+// lights can go. So a point light is one fetch instead of two, and a spot light two 
+// instead of three (its SpotParams stay in their own buffer).
+//
+// The culling still uses the full-precision light buffers. The packed radius is rounded 
+// down, so that the packed sphere is inside the one the lists were built from, and the 
+// tiles never shade a light their lists missed. The packed spot light apex (the top of 
+// the bounding sphere) moves by up to the position error plus the radius error.
+//
+// Has no dependencies on D3D or DXUT, so that it can be used headless.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <DirectXMath.h>
+
+namespace ForwardPlus11
+{
+    //--------------------------------------------------------------------------------------
+    // What the packed positions are relative to: position = vOrigin + q*vScale, for the 
+    // 16-bit integers q. Goes into the per-frame constant buffer for the shaders.
+    //--------------------------------------------------------------------------------------
+    struct PackedLightBounds
+    {
+        DirectX::XMFLOAT3   vOrigin;
+        DirectX::XMFLOAT3   vScale;
+    };
+
+    // The bounds for packing positions in [vMin,vMax] (an empty axis gets a tiny extent)
+    PackedLightBounds GetPackedLightBounds( const DirectX::XMFLOAT3& vMin, const DirectX::XMFLOAT3& vMax );
+
+    //--------------------------------------------------------------------------------------
+    // One packed light, as stored in the packed light buffers (see above)
+    //--------------------------------------------------------------------------------------
+    struct PackedLight
+    {
+        unsigned uPositionXY;
+        unsigned uPositionZAndRadius;
+        unsigned uColor;
+    };
+
+    // Pack one light. Positions outside the bounds are clamped to them (with the radius 
+    // shrunk by how far the center moves, like any other position error).
+    PackedLight PackLight( const PackedLightBounds& Bounds, const DirectX::XMFLOAT4& CenterAndRadius, const DirectX::XMFLOAT3& Color );
+
+    // Unpack one light, the way the shaders do it
+    void UnpackLight( const PackedLightBounds& Bounds, const PackedLight& Light, DirectX::XMFLOAT4* pCenterAndRadius, DirectX::XMFLOAT3* pColor );
+
+    // Pack the lights pIndices picks (or the first uNumLights, if pIndices is NULL) from 
+    // the light buffer layout (float4 center and radius and RGBA8 color) into pPackedLights
+    void PackLights( const PackedLightBounds& Bounds, const DirectX::XMFLOAT4* pCenterAndRadius, const unsigned* pColors, 
+                     const unsigned* pIndices, unsigned uNumLights, PackedLight* pPackedLights );
+
+    //--------------------------------------------------------------------------------------
+    // The shared-exponent color. Channels are clamped to [0,MAX_RGB9E5_VALUE] and rounded 
+    // to nearest, so each is off by at most GetRGB9E5ErrorBound of the largest one. An 
+    // RGBA8 color (as in the light buffers) comes back exactly when rounded to 8 bits again.
+    //--------------------------------------------------------------------------------------
+    static const float MAX_RGB9E5_VALUE = 65408.f;    // (511/512)*2^16
+
+    unsigned PackColorRGB9E5( const DirectX::XMFLOAT3& Color );
+    DirectX::XMFLOAT3 UnpackColorRGB9E5( unsigned uColor );
+    DirectX::XMFLOAT3 UnpackColorRGBA8( unsigned uColor );
+
+    //--------------------------------------------------------------------------------------
+    // Error bounds. The packed center of a light inside the bounds is off by at most 
+    // GetPackedLightPositionErrorBound on each axis (half a step, plus float rounding). The 
+    // packed radius is never larger than the radius minus the distance the center moved, 
+    // and smaller by at most that distance plus one half-precision step at the radius 
+    // (GetPackedLightRadiusErrorBound). A color channel is off by at most 
+    // GetRGB9E5ErrorBound( the largest channel ).
+    //--------------------------------------------------------------------------------------
+    DirectX::XMFLOAT3 GetPackedLightPositionErrorBound( const PackedLightBounds& Bounds );
+    float GetPackedLightRadiusErrorBound( const PackedLightBounds& Bounds, float fRadius );
+    float GetRGB9E5ErrorBound( float fMaxChannel );
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
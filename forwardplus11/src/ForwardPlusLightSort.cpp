@@ -0,0 +1,117 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusLightSort.cpp
+//
+// Sorting lights along a Morton curve through their centers.
+//--------------------------------------------------------------------------------------
+
+#include "ForwardPlusLightSort.h"
+
+#include <float.h>
+
+using namespace DirectX;
+
+// the codes are sorted 10 bits at a time, in 3 passes
+static const unsigned LIGHT_SORT_RADIX_BITS = 10;
+static const unsigned LIGHT_SORT_RADIX_SIZE = 1 << LIGHT_SORT_RADIX_BITS;
+
+namespace ForwardPlus11
+{
+
+    //--------------------------------------------------------------------------------------
+    // Sort the lights by Morton code
+    //--------------------------------------------------------------------------------------
+    void SortLightsByMortonCode( const XMFLOAT4* pCenterAndRadius, unsigned uNumLights, std::vector<unsigned>& SortedToLight )
+    {
+        SortedToLight.resize( uNumLights );
+        if( uNumLights == 0 )
+        {
+            return;
+        }
+
+        // the bounds of the centers
+        float fMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float fMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        for( unsigned i = 0; i < uNumLights; i++ )
+        {
+            const float Center[3] = { pCenterAndRadius[i].x, pCenterAndRadius[i].y, pCenterAndRadius[i].z };
+            for( int j = 0; j < 3; j++ )
+            {
+                fMin[j] = ( Center[j] < fMin[j] ) ? Center[j] : fMin[j];
+                fMax[j] = ( Center[j] > fMax[j] ) ? Center[j] : fMax[j];
+            }
+        }
+
+        float fScale[3];
+        for( int j = 0; j < 3; j++ )
+        {
+            fScale[j] = CalculateMortonScale( fMin[j], fMax[j] );
+        }
+
+        std::vector<unsigned> Codes( uNumLights ), CodesTemp( uNumLights ), SortedToLightTemp( uNumLights );
+        for( unsigned i = 0; i < uNumLights; i++ )
+        {
+            Codes[i] = GetMortonCode( pCenterAndRadius[i].x, pCenterAndRadius[i].y, pCenterAndRadius[i].z, fMin, fScale );
+            SortedToLight[i] = i;
+        }
+
+        // stable LSD radix sort, carrying the light indices along
+        std::vector<unsigned> Offsets( LIGHT_SORT_RADIX_SIZE );
+        for( unsigned uShift = 0; uShift < 3*MORTON_BITS_PER_AXIS; uShift += LIGHT_SORT_RADIX_BITS )
+        {
+            for( unsigned uDigit = 0; uDigit < LIGHT_SORT_RADIX_SIZE; uDigit++ )
+            {
+                Offsets[uDigit] = 0;
+            }
+            for( unsigned i = 0; i < uNumLights; i++ )
+            {
+                Offsets[( Codes[i] >> uShift ) & ( LIGHT_SORT_RADIX_SIZE - 1 )]++;
+            }
+
+            unsigned uOffset = 0;
+            for( unsigned uDigit = 0; uDigit < LIGHT_SORT_RADIX_SIZE; uDigit++ )
+            {
+                unsigned uCount = Offsets[uDigit];
+                Offsets[uDigit] = uOffset;
+                uOffset += uCount;
+            }
+
+            for( unsigned i = 0; i < uNumLights; i++ )
+            {
+                unsigned uDst = Offsets[( Codes[i] >> uShift ) & ( LIGHT_SORT_RADIX_SIZE - 1 )]++;
+                CodesTemp[uDst] = Codes[i];
+                SortedToLightTemp[uDst] = SortedToLight[i];
+            }
+
+            Codes.swap( CodesTemp );
+            SortedToLight.swap( SortedToLightTemp );
+        }
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
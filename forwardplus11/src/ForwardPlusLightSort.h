@@ -0,0 +1,112 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusLightSort.h
+//
+// Sorting lights along a Morton (Z-order) curve through their centers. Lights that are
+// close together in space then get indices that are close together, so the indices
+// in each per-tile list are close together too, and fetching the light data for a
+// tile (in CullLightsCS and in the shading loop) touches fewer cache lines.
+//
+// Has no dependencies on D3D or DXUT, so that it can be used headless.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+namespace ForwardPlus11
+{
+    // Morton codes have this many bits per axis (30 bits in total)
+    static const unsigned MORTON_BITS_PER_AXIS = 10;
+
+    //--------------------------------------------------------------------------------------
+    // Spread the low 10 bits of v out to every third bit
+    //--------------------------------------------------------------------------------------
+    inline unsigned ExpandMortonBits( unsigned v )
+    {
+        v = ( v*0x00010001u ) & 0xFF0000FFu;
+        v = ( v*0x00000101u ) & 0x0F00F00Fu;
+        v = ( v*0x00000011u ) & 0xC30C30C3u;
+        v = ( v*0x00000005u ) & 0x49249249u;
+        return v;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Quantize a coordinate to MORTON_BITS_PER_AXIS bits, where fScale is
+    // 2^MORTON_BITS_PER_AXIS divided by the extent of the bounds along that axis
+    // (see CalculateMortonScale), or 0 if the extent is 0
+    //--------------------------------------------------------------------------------------
+    inline unsigned QuantizeMortonCoordinate( float f, float fMin, float fScale )
+    {
+        const unsigned uMaxValue = ( 1 << MORTON_BITS_PER_AXIS ) - 1;
+        float fValue = ( f - fMin )*fScale;
+        fValue = ( fValue > 0.f ) ? fValue : 0.f;
+        unsigned uValue = (unsigned)fValue;
+        return ( uValue < uMaxValue ) ? uValue : uMaxValue;
+    }
+
+    inline float CalculateMortonScale( float fMin, float fMax )
+    {
+        float fExtent = fMax - fMin;
+        return ( fExtent > 0.f ) ? (float)( 1 << MORTON_BITS_PER_AXIS ) / fExtent : 0.f;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The 30-bit Morton code of a point, relative to bounds with the given minimum and scale
+    //--------------------------------------------------------------------------------------
+    inline unsigned GetMortonCode( float x, float y, float z, const float fMin[3], const float fScale[3] )
+    {
+        return ( ExpandMortonBits( QuantizeMortonCoordinate( x, fMin[0], fScale[0] ) ) << 2 ) |
+               ( ExpandMortonBits( QuantizeMortonCoordinate( y, fMin[1], fScale[1] ) ) << 1 ) |
+                 ExpandMortonBits( QuantizeMortonCoordinate( z, fMin[2], fScale[2] ) );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Radix sorts lights [0,uNumLights) by the Morton code of their centers (relative to
+    // the bounds of the centers), returning the light indices in sorted order. The sort is
+    // stable, so lights with the same code keep their relative order.
+    //--------------------------------------------------------------------------------------
+    void SortLightsByMortonCode( const DirectX::XMFLOAT4* pCenterAndRadius, unsigned uNumLights, std::vector<unsigned>& SortedToLight );
+
+    //--------------------------------------------------------------------------------------
+    // Reorders a light data array: pDst[i] = pSrc[pSortedToLight[i]], for i in [0,uNumLights).
+    // Every array of a light type (centers, colors, spot parameters, ...) must be
+    // reordered with the same indices.
+    //--------------------------------------------------------------------------------------
+    template<typename T>
+    void ReorderLightArray( const unsigned* pSortedToLight, unsigned uNumLights, const T* pSrc, T* pDst )
+    {
+        for( unsigned i = 0; i < uNumLights; i++ )
+        {
+            pDst[i] = pSrc[pSortedToLight[i]];
+        }
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
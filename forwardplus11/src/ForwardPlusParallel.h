@@ -0,0 +1,118 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusParallel.h
+//
+// Minimal fork-join helper used by the CPU side of the ForwardPlus11 sample.
+// Has no dependencies on D3D or DXUT, so that it can be used headless.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace ForwardPlus11
+{
+    //--------------------------------------------------------------------------------------
+    // Returns the number of worker threads to use when the caller asks for zero
+    //--------------------------------------------------------------------------------------
+    inline unsigned GetDefaultNumThreads()
+    {
+        unsigned uNumThreads = std::thread::hardware_concurrency();
+        return ( uNumThreads == 0 ) ? 1 : uNumThreads;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Calls Func( uItem, uThreadIdx ) for every uItem in [0,uNumItems), spread across
+    // uNumThreads threads (the calling thread is one of them). Items are handed out in
+    // chunks of uChunkSize from a shared atomic counter, so uneven per-item cost
+    // (e.g. tiles that overlap many lights) still balances well. uThreadIdx is in
+    // [0,uNumThreads) and is stable for the duration of a call, so it can be used to
+    // index per-thread scratch memory.
+    //--------------------------------------------------------------------------------------
+    template<typename FUNC>
+    void ParallelFor( unsigned uNumItems, unsigned uNumThreads, unsigned uChunkSize, FUNC& Func )
+    {
+        if( uNumThreads == 0 )
+        {
+            uNumThreads = GetDefaultNumThreads();
+        }
+
+        if( uChunkSize == 0 )
+        {
+            uChunkSize = 1;
+        }
+
+        // don't spin up more threads than there are chunks of work
+        unsigned uNumChunks = ( uNumItems + uChunkSize - 1 ) / uChunkSize;
+        if( uNumThreads > uNumChunks )
+        {
+            uNumThreads = ( uNumChunks == 0 ) ? 1 : uNumChunks;
+        }
+
+        std::atomic<unsigned> NextItem( 0 );
+
+        struct Worker
+        {
+            static void Run( std::atomic<unsigned>* pNextItem, unsigned uNumItems, unsigned uChunkSize, unsigned uThreadIdx, FUNC* pFunc )
+            {
+                for( ;; )
+                {
+                    unsigned uBegin = pNextItem->fetch_add( uChunkSize );
+                    if( uBegin >= uNumItems )
+                    {
+                        break;
+                    }
+
+                    unsigned uEnd = ( uNumItems - uBegin < uChunkSize ) ? uNumItems : uBegin + uChunkSize;
+                    for( unsigned uItem = uBegin; uItem < uEnd; uItem++ )
+                    {
+                        (*pFunc)( uItem, uThreadIdx );
+                    }
+                }
+            }
+        };
+
+        std::vector<std::thread> Threads;
+        Threads.reserve( uNumThreads );
+        for( unsigned i = 1; i < uNumThreads; i++ )
+        {
+            Threads.push_back( std::thread( &Worker::Run, &NextItem, uNumItems, uChunkSize, i, &Func ) );
+        }
+
+        // the calling thread does its share too
+        Worker::Run( &NextItem, uNumItems, uChunkSize, 0, &Func );
+
+        for( size_t i = 0; i < Threads.size(); i++ )
+        {
+            Threads[i].join();
+        }
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusSpotCones.cpp
+//
+// Spot light cones, for culling spot lights by their cone.
+//--------------------------------------------------------------------------------------
+
+#include "ForwardPlusSpotCones.h"
+#include "ForwardPlusHalf.h"
+
+#include <assert.h>
+#include <math.h>
+
+using namespace DirectX;
+
+namespace ForwardPlus11
+{
+
+    //--------------------------------------------------------------------------------------
+    // Pack the parameters of one spot light
+    //--------------------------------------------------------------------------------------
+    SpotParams PackSpotParams( const XMFLOAT3& vLightDir, float fCosineOfConeAngle, float fFalloffRadius )
+    {
+        assert( fCosineOfConeAngle > 0.0f );
+        assert( fFalloffRadius > 0.0f );
+
+        // round toward zero, as the light data always was: rounding x and y up could 
+        // push their length past 1, and RenderScenePS takes sqrt(1 - x*x - y*y)
+        SpotParams PackedParams;
+        PackedParams.fLightDirX = ConvertF32ToF16( vLightDir.x, HALF_ROUND_TOWARD_ZERO );
+        PackedParams.fLightDirY = ConvertF32ToF16( vLightDir.y, HALF_ROUND_TOWARD_ZERO );
+        PackedParams.fCosineOfConeAngleAndLightDirZSign = ConvertF32ToF16( fCosineOfConeAngle, HALF_ROUND_TOWARD_ZERO );
+        PackedParams.fFalloffRadius = ConvertF32ToF16( fFalloffRadius, HALF_ROUND_TOWARD_ZERO );
+
+        // put the sign bit for light dir z in the sign bit for the cone angle
+        // (we can do this because we know the cone angle is always positive)
+        if( vLightDir.z < 0.0f )
+        {
+            PackedParams.fCosineOfConeAngleAndLightDirZSign |= 0x8000;
+        }
+        else
+        {
+            PackedParams.fCosineOfConeAngleAndLightDirZSign &= 0x7FFF;
+        }
+
+        return PackedParams;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Unpack the parameters of one spot light, like RenderScenePS
+    //--------------------------------------------------------------------------------------
+    void UnpackSpotParams( const SpotParams& Params, SpotLightCone* pCone )
+    {
+        float fCosineOfConeAngleAndLightDirZSign = ConvertF16ToF32( Params.fCosineOfConeAngleAndLightDirZSign );
+
+        // reconstruct z component of the light dir from x and y (clamped, since 
+        // rounding x and y to half precision can push their length past 1)
+        pCone->vLightDir.x = ConvertF16ToF32( Params.fLightDirX );
+        pCone->vLightDir.y = ConvertF16ToF32( Params.fLightDirY );
+        float fZSquared = 1.f - pCone->vLightDir.x*pCone->vLightDir.x - pCone->vLightDir.y*pCone->vLightDir.y;
+        pCone->vLightDir.z = ( fZSquared > 0.f ) ? sqrtf( fZSquared ) : 0.f;
+        pCone->vLightDir.z = ( fCosineOfConeAngleAndLightDirZSign > 0.f ) ? pCone->vLightDir.z : -pCone->vLightDir.z;
+
+        pCone->fCosineOfConeAngle = ( fCosineOfConeAngleAndLightDirZSign > 0.f ) ? fCosineOfConeAngleAndLightDirZSign : -fCosineOfConeAngleAndLightDirZSign;
+        pCone->fFalloffRadius = ConvertF16ToF32( Params.fFalloffRadius );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Place the cone of a spot light, like TestSpotCone
+    //--------------------------------------------------------------------------------------
+    void CalculateSpotCone( float fCenterX, float fCenterY, float fCenterZ, float fRadius, const SpotLightCone& ViewSpaceCone, CpuCullSpotCone* pCone )
+    {
+        // the top of the cone is r_bounding_sphere units away from the 
+        // bounding sphere center along the negated light direction
+        pCone->fDirX = ViewSpaceCone.vLightDir.x;
+        pCone->fDirY = ViewSpaceCone.vLightDir.y;
+        pCone->fDirZ = ViewSpaceCone.vLightDir.z;
+        pCone->fApexX = fCenterX - fRadius*pCone->fDirX;
+        pCone->fApexY = fCenterY - fRadius*pCone->fDirY;
+        pCone->fApexZ = fCenterZ - fRadius*pCone->fDirZ;
+
+        // tan(theta) = r_cone/h_cone
+        float fCosine = ViewSpaceCone.fCosineOfConeAngle;
+        pCone->fHeight = ViewSpaceCone.fFalloffRadius;
+        pCone->fBaseRadius = pCone->fHeight*sqrtf( 1.f - fCosine*fCosine ) / fCosine;
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -0,0 +1,141 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlusSpotCones.h
+//
+// Spot light cones, for culling spot lights by their cone instead of their bounding
+// sphere. A spot light only lights the points closer to its apex than its falloff
+// radius and inside its cone angle (see RenderScenePS in ForwardPlus11.hlsl). That
+// volume is inside the cone with the same apex and angle and the falloff radius for
+// height, which is much smaller than the bounding sphere the cone was fitted into
+// (see ForwardPlusUtil::InitLights), so culling against the cone puts a spot light
+// into fewer tiles.
+//
+// The cone tests must match TestSpotCone in ForwardPlus11Tiling.hlsl.
+//
+// Has no dependencies on D3D or DXUT, so that it can be used headless.
+//--------------------------------------------------------------------------------------
+
+#pragma once
+
+#include "ForwardPlusCpuCullKernels.h"
+
+#include <DirectXMath.h>
+#include <math.h>
+
+namespace ForwardPlus11
+{
+    //--------------------------------------------------------------------------------------
+    // The spot light parameters, as stored in g_SpotLightBufferSpotParams. These are 
+    // half-precision (i.e. 16-bit) float values, stored as unsigned shorts. The cone 
+    // angle is always positive, so its sign bit holds the sign of light dir z.
+    //--------------------------------------------------------------------------------------
+    struct SpotParams
+    {
+        unsigned short fLightDirX;
+        unsigned short fLightDirY;
+        unsigned short fCosineOfConeAngleAndLightDirZSign;
+        unsigned short fFalloffRadius;
+    };
+
+    // Pack the parameters of one spot light (vLightDir must be normalized)
+    SpotParams PackSpotParams( const DirectX::XMFLOAT3& vLightDir, float fCosineOfConeAngle, float fFalloffRadius );
+
+    //--------------------------------------------------------------------------------------
+    // The parameters of one spot light, unpacked the way the shaders do it (z of the 
+    // light dir is reconstructed from x and y)
+    //--------------------------------------------------------------------------------------
+    struct SpotLightCone
+    {
+        DirectX::XMFLOAT3   vLightDir;
+        float               fCosineOfConeAngle;
+        float               fFalloffRadius;
+    };
+
+    void UnpackSpotParams( const SpotParams& Params, SpotLightCone* pCone );
+
+    //--------------------------------------------------------------------------------------
+    // The cone of a spot light in view space: its apex (the top of the bounding sphere, 
+    // opposite the light direction), its unit axis, its height (the falloff radius), 
+    // and the radius of its base
+    //--------------------------------------------------------------------------------------
+    struct CpuCullSpotCone
+    {
+        float fApexX, fApexY, fApexZ;
+        float fDirX, fDirY, fDirZ;
+        float fHeight;
+        float fBaseRadius;
+    };
+
+    // Place the cone of a spot light, given its bounding sphere center (in view space), 
+    // the bounding sphere radius, and its unpacked parameters with the light direction 
+    // already rotated into view space
+    void CalculateSpotCone( float fCenterX, float fCenterY, float fCenterZ, float fRadius, const SpotLightCone& ViewSpaceCone, CpuCullSpotCone* pCone );
+
+    //--------------------------------------------------------------------------------------
+    // Whether any part of the cone is inside a tile: on the inner side of each of the 
+    // four side planes, and in the depth slab. The point of a cone furthest along a 
+    // direction is either the apex or on the rim of the base, so a plane is passed if 
+    // either of those is on its inner side. Like the sphere tests, this is done one 
+    // plane at a time, so cones near a corner of the tile can pass without touching it.
+    //--------------------------------------------------------------------------------------
+    inline bool TestSpotConeAgainstPlane( const CpuCullSpotCone& Cone, float fPlaneX, float fPlaneY, float fPlaneZ )
+    {
+        float fBaseX = Cone.fApexX + Cone.fHeight*Cone.fDirX;
+        float fBaseY = Cone.fApexY + Cone.fHeight*Cone.fDirY;
+        float fBaseZ = Cone.fApexZ + Cone.fHeight*Cone.fDirZ;
+        float fPlaneDotDir = fPlaneX*Cone.fDirX + fPlaneY*Cone.fDirY + fPlaneZ*Cone.fDirZ;
+        float fRimScale = 1.f - fPlaneDotDir*fPlaneDotDir;
+        fRimScale = ( fRimScale > 0.f ) ? sqrtf( fRimScale ) : 0.f;
+
+        bool bApexInside = fPlaneX*Cone.fApexX + fPlaneY*Cone.fApexY + fPlaneZ*Cone.fApexZ < 0.f;
+        bool bRimInside = fPlaneX*fBaseX + fPlaneY*fBaseY + fPlaneZ*fBaseZ - Cone.fBaseRadius*fRimScale < 0.f;
+        return bApexInside || bRimInside;
+    }
+
+    inline bool TestSpotConeAgainstDepth( const CpuCullSpotCone& Cone, float fMinZ, float fMaxZ )
+    {
+        float fBaseZ = Cone.fApexZ + Cone.fHeight*Cone.fDirZ;
+        float fRimScale = 1.f - Cone.fDirZ*Cone.fDirZ;
+        fRimScale = ( fRimScale > 0.f ) ? sqrtf( fRimScale ) : 0.f;
+        float fRimZ = Cone.fBaseRadius*fRimScale;
+
+        float fConeMinZ = ( Cone.fApexZ < fBaseZ - fRimZ ) ? Cone.fApexZ : fBaseZ - fRimZ;
+        float fConeMaxZ = ( Cone.fApexZ > fBaseZ + fRimZ ) ? Cone.fApexZ : fBaseZ + fRimZ;
+        return fConeMaxZ > fMinZ && fConeMinZ < fMaxZ;
+    }
+
+    inline bool TestSpotCone( const CpuCullSpotCone& Cone, const CpuCullTileFrustum& Frustum )
+    {
+        return TestSpotConeAgainstPlane( Cone, Frustum.fPlaneX[0], Frustum.fPlaneY[0], Frustum.fPlaneZ[0] ) &&
+               TestSpotConeAgainstPlane( Cone, Frustum.fPlaneX[1], Frustum.fPlaneY[1], Frustum.fPlaneZ[1] ) &&
+               TestSpotConeAgainstPlane( Cone, Frustum.fPlaneX[2], Frustum.fPlaneY[2], Frustum.fPlaneZ[2] ) &&
+               TestSpotConeAgainstPlane( Cone, Frustum.fPlaneX[3], Frustum.fPlaneY[3], Frustum.fPlaneZ[3] ) &&
+               TestSpotConeAgainstDepth( Cone, Frustum.fMinZ, Frustum.fMaxZ );
+    }
+
+} // namespace ForwardPlus11
+
+//--------------------------------------------------------------------------------------
+// EOF
+//--------------------------------------------------------------------------------------
@@ -32,6 +32,10 @@
 #include "..\\..\\AMD_SDK\\inc\\AMD_SDK.h"
 
 #include "ForwardPlusUtil.h"
+#include "ForwardPlusLightFrustumCull.h"
+#include "ForwardPlusLightSort.h"
+
+#include <vector>
 
 #pragma warning( disable : 4100 ) // disable unreference formal parameter warnings for /W4 builds
 
@@ -61,27 +65,29 @@ static const int            g_nConeNumIndices = 3*g_nConeNumTris;
 static ConeVertex           g_ConeForSpotLightsVertexData[g_nConeNumVertices];
 static unsigned short       g_ConeForSpotLightsIndexData[g_nConeNumIndices];
 
-// these are half-precision (i.e. 16-bit) float values, 
-// stored as unsigned shorts
-struct SpotParams
-{
-    unsigned short fLightDirX;
-    unsigned short fLightDirY;
-    unsigned short fCosineOfConeAngleAndLightDirZSign;
-    unsigned short fFalloffRadius;
-};
+// the light capacity, set by InitLights
+static unsigned                     g_uMaxNumLights = ForwardPlus11::DEFAULT_MAX_NUM_LIGHTS;
 
-// static arrays for the point light data
-static XMFLOAT4             g_PointLightDataArrayCenterAndRadius[ForwardPlus11::MAX_NUM_LIGHTS];
-static DWORD                g_PointLightDataArrayColor[ForwardPlus11::MAX_NUM_LIGHTS];
+// arrays for the point light data (g_uMaxNumLights each)
+static std::vector<XMFLOAT4>        g_PointLightDataArrayCenterAndRadius;
+static std::vector<DWORD>           g_PointLightDataArrayColor;
 
-// static arrays for the spot light data
-static XMFLOAT4             g_SpotLightDataArrayCenterAndRadius[ForwardPlus11::MAX_NUM_LIGHTS];
-static DWORD                g_SpotLightDataArrayColor[ForwardPlus11::MAX_NUM_LIGHTS];
-static SpotParams           g_SpotLightDataArraySpotParams[ForwardPlus11::MAX_NUM_LIGHTS];
+// arrays for the spot light data (g_uMaxNumLights each)
+static std::vector<XMFLOAT4>        g_SpotLightDataArrayCenterAndRadius;
+static std::vector<DWORD>           g_SpotLightDataArrayColor;
+static std::vector<ForwardPlus11::SpotParams> g_SpotLightDataArraySpotParams;
 
-// rotation matrices used when visualizing the spot lights
-static XMMATRIX             g_SpotLightDataArraySpotMatrices[ForwardPlus11::MAX_NUM_LIGHTS];
+// rotation matrices used when visualizing the spot lights (already transposed for HLSL, 
+// stored as XMFLOAT4X4 since std::vector does not guarantee XMMATRIX alignment)
+static std::vector<XMFLOAT4X4>      g_SpotLightDataArraySpotMatrices;
+
+// the order of the lights in the light buffers: buffer element i holds 
+// light g_PointLightOrder[i] of the arrays above (see UpdateLightOrder)
+static std::vector<unsigned>        g_PointLightOrder;
+static std::vector<unsigned>        g_SpotLightOrder;
+
+// what the positions in the packed light buffers are relative to, set by InitLights
+static ForwardPlus11::PackedLightBounds g_PackedLightBounds;
 
 // constants for the legend for the lights-per-tile visualization
 static const int g_nLegendNumLines = 17;
@@ -150,29 +156,67 @@ static XMFLOAT3 GetRandLightDirection()
     return vResult;
 }
 
-static SpotParams PackSpotParams(const XMFLOAT3& vLightDir, float fCosineOfConeAngle, float fFalloffRadius)
+// Sorts the first uNumLightsToSort lights by Morton code, and puts the lights after 
+// them back in their original order, up to uNumLights
+static void UpdateLightOrderArray( const std::vector<XMFLOAT4>& CenterAndRadius, unsigned uNumLightsToSort, unsigned uNumLights, std::vector<unsigned>& Order )
 {
-    assert( fCosineOfConeAngle > 0.0f );
-    assert( fFalloffRadius > 0.0f );
+    std::vector<unsigned> SortedToLight;
+    ForwardPlus11::SortLightsByMortonCode( &CenterAndRadius[0], uNumLightsToSort, SortedToLight );
+
+    for( unsigned i = 0; i < uNumLightsToSort; i++ )
+    {
+        Order[i] = SortedToLight[i];
+    }
+    for( unsigned i = uNumLightsToSort; i < uNumLights; i++ )
+    {
+        Order[i] = i;
+    }
+}
 
-    SpotParams PackedParams;
-    PackedParams.fLightDirX = AMD::ConvertF32ToF16( vLightDir.x );
-    PackedParams.fLightDirY = AMD::ConvertF32ToF16( vLightDir.y );
-    PackedParams.fCosineOfConeAngleAndLightDirZSign = AMD::ConvertF32ToF16( fCosineOfConeAngle );
-    PackedParams.fFalloffRadius = AMD::ConvertF32ToF16( fFalloffRadius );
+// Uploads the first uNumLights elements of a light buffer, in the given order
+template<typename T>
+static void UploadLightArray( ID3D11DeviceContext* pd3dImmediateContext, ID3D11Buffer* pBuffer, const std::vector<T>& Data, const std::vector<unsigned>& Order, unsigned uNumLights )
+{
+    std::vector<T> ReorderedData( uNumLights );
+    ForwardPlus11::ReorderLightArray( &Order[0], uNumLights, &Data[0], &ReorderedData[0] );
 
-    // put the sign bit for light dir z in the sign bit for the cone angle
-    // (we can do this because we know the cone angle is always positive)
-    if( vLightDir.z < 0.0f )
+    D3D11_BOX Box = { 0, 0, 0, (UINT)( sizeof(T)*uNumLights ), 1, 1 };
+    pd3dImmediateContext->UpdateSubresource( pBuffer, 0, &Box, &ReorderedData[0], 0, 0 );
+}
+
+// Writes the given ranges of a light array into a mapped staging buffer, at uByteOffset
+template<typename T>
+static void WriteLightRanges( BYTE* pMappedData, unsigned uByteOffset, const T* pSrc, const std::vector<ForwardPlus11::LightRange>& Ranges )
+{
+    T* pDst = (T*)( pMappedData + uByteOffset );
+    for( size_t i = 0; i < Ranges.size(); i++ )
     {
-        PackedParams.fCosineOfConeAngleAndLightDirZSign |= 0x8000;
+        memcpy( &pDst[Ranges[i].uBegin], &pSrc[Ranges[i].uBegin], sizeof(T)*( Ranges[i].uEnd - Ranges[i].uBegin ) );
     }
-    else
+}
+
+// Writes the elements of a light array that pIndices picks into a dynamic buffer
+template<typename T>
+static void UploadVisibleLights( ID3D11DeviceContext* pd3dImmediateContext, ID3D11Buffer* pBuffer, const T* pSrc, const unsigned* pIndices, unsigned uNumLights )
+{
+    D3D11_MAPPED_SUBRESOURCE MappedResource;
+    if( SUCCEEDED( pd3dImmediateContext->Map( pBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource ) ) )
     {
-        PackedParams.fCosineOfConeAngleAndLightDirZSign &= 0x7FFF;
+        ForwardPlus11::ReorderLightArray( pIndices, uNumLights, pSrc, (T*)MappedResource.pData );
+        pd3dImmediateContext->Unmap( pBuffer, 0 );
     }
+}
 
-    return PackedParams;
+// Copies the given ranges of a light array from a staging buffer (at uByteOffset) into a light buffer
+static void CopyLightRanges( ID3D11DeviceContext* pd3dImmediateContext, ID3D11Buffer* pDstBuffer, ID3D11Buffer* pStagingBuffer, unsigned uByteOffset, unsigned uElementSize, const std::vector<ForwardPlus11::LightRange>& Ranges )
+{
+    for( size_t i = 0; i < Ranges.size(); i++ )
+    {
+        UINT uBegin = Ranges[i].uBegin*uElementSize;
+        UINT uEnd = Ranges[i].uEnd*uElementSize;
+        D3D11_BOX Box = { uByteOffset + uBegin, 0, 0, uByteOffset + uEnd, 1, 1 };
+        pd3dImmediateContext->CopySubresourceRegion( pDstBuffer, 0, uBegin, 0, 0, pStagingBuffer, 0, &Box );
+    }
 }
 
 namespace ForwardPlus11
@@ -184,6 +228,10 @@ namespace ForwardPlus11
     ForwardPlusUtil::ForwardPlusUtil()
         :m_uWidth(0)
         ,m_uHeight(0)
+        ,m_uTileRes(DEFAULT_TILE_RES)
+        ,m_uMaxNumLightsPerTile(MAX_NUM_LIGHTS_PER_TILE)
+        ,m_uNumPointLightsSorted(0)
+        ,m_uNumSpotLightsSorted(0)
         ,m_pPointLightBufferCenterAndRadius(NULL)
         ,m_pPointLightBufferCenterAndRadiusSRV(NULL)
         ,m_pPointLightBufferColor(NULL)
@@ -196,9 +244,52 @@ namespace ForwardPlus11
         ,m_pSpotLightBufferSpotParamsSRV(NULL)
         ,m_pSpotLightBufferSpotMatrices(NULL)
         ,m_pSpotLightBufferSpotMatricesSRV(NULL)
+        ,m_bFrustumPreCull(false)
+        ,m_uNumVisiblePointLights(0)
+        ,m_uNumVisibleSpotLights(0)
+        ,m_uVisibleLightsGeneration(0)
+        ,m_uVisibleLightsNumPointLights(0)
+        ,m_uVisibleLightsNumSpotLights(0)
+        ,m_pVisiblePointLightBufferCenterAndRadius(NULL)
+        ,m_pVisiblePointLightBufferCenterAndRadiusSRV(NULL)
+        ,m_pVisiblePointLightBufferColor(NULL)
+        ,m_pVisiblePointLightBufferColorSRV(NULL)
+        ,m_pVisibleSpotLightBufferCenterAndRadius(NULL)
+        ,m_pVisibleSpotLightBufferCenterAndRadiusSRV(NULL)
+        ,m_pVisibleSpotLightBufferColor(NULL)
+        ,m_pVisibleSpotLightBufferColorSRV(NULL)
+        ,m_pVisibleSpotLightBufferSpotParams(NULL)
+        ,m_pVisibleSpotLightBufferSpotParamsSRV(NULL)
+        ,m_bPackedLights(false)
+        ,m_uPackedLightsGeneration(0)
+        ,m_uNumPackedPointLights(0)
+        ,m_uNumPackedSpotLights(0)
+        ,m_pPackedPointLightBuffer(NULL)
+        ,m_pPackedPointLightBufferSRV(NULL)
+        ,m_pPackedSpotLightBuffer(NULL)
+        ,m_pPackedSpotLightBufferSRV(NULL)
+        ,m_uLightUploadRingIndex(0)
+        ,m_uNumLightUploadStalls(0)
+        ,m_uLightGeneration(0)
+        ,m_uLightIndexBufferGeneration(0)
         ,m_pLightIndexBuffer(NULL)
         ,m_pLightIndexBufferSRV(NULL)
         ,m_pLightIndexBufferUAV(NULL)
+        ,m_pCompactLightIndexBuffer(NULL)
+        ,m_pCompactLightIndexBufferSRV(NULL)
+        ,m_pCompactLightIndexBufferUAV(NULL)
+        ,m_pCompactLightIndexCounterUAV(NULL)
+        ,m_pClusterLightIndexBuffer(NULL)
+        ,m_pClusterLightIndexBufferSRV(NULL)
+        ,m_pClusterLightIndexBufferUAV(NULL)
+        ,m_pCoarseLightIndexBuffer(NULL)
+        ,m_pCoarseLightIndexBufferSRV(NULL)
+        ,m_pCoarseLightIndexBufferUAV(NULL)
+        ,m_pLightCullStatsBuffer(NULL)
+        ,m_pLightCullStatsUAV(NULL)
+        ,m_uLightCullStatsReadbackRingIndex(0)
+        ,m_pBuildHiZCS(NULL)
+        ,m_pBuildHiZCSMSAA(NULL)
         ,m_pQuadForLightsVB(NULL)
         ,m_pQuadForLegendVB(NULL)
         ,m_pConeForSpotLightsVB(NULL)
@@ -218,6 +309,27 @@ namespace ForwardPlus11
         ,m_pDisableDepthTest(NULL)
         ,m_pDisableCullingRS(NULL)
     {
+        // placeholder, until the app knows its far plane distance and calls SetClusterConfig
+        m_ClusterConfig = GetDefaultClusterConfig( 1000.0f );
+
+        for( unsigned i = 0; i < LIGHT_UPLOAD_RING_SIZE; i++ )
+        {
+            m_pLightUploadRing[i] = NULL;
+        }
+
+        for( unsigned i = 0; i < LIGHT_CULL_STATS_READBACK_RING_SIZE; i++ )
+        {
+            m_pLightCullStatsReadbackRing[i] = NULL;
+            m_bLightCullStatsReadbackPending[i] = false;
+            m_bLightCullStatsPerTile[i] = false;
+        }
+
+        for( unsigned i = 0; i < HIZ_NUM_LEVELS; i++ )
+        {
+            m_pHiZTexture[i] = NULL;
+            m_pHiZSRV[i] = NULL;
+            m_pHiZUAV[i] = NULL;
+        }
     }
 
 
@@ -238,9 +350,37 @@ namespace ForwardPlus11
         SAFE_RELEASE(m_pSpotLightBufferSpotParamsSRV);
         SAFE_RELEASE(m_pSpotLightBufferSpotMatrices);
         SAFE_RELEASE(m_pSpotLightBufferSpotMatricesSRV);
+        for( unsigned i = 0; i < LIGHT_UPLOAD_RING_SIZE; i++ )
+        {
+            SAFE_RELEASE(m_pLightUploadRing[i]);
+        }
+        SAFE_RELEASE(m_pLightCullStatsBuffer);
+        SAFE_RELEASE(m_pLightCullStatsUAV);
+        for( unsigned i = 0; i < LIGHT_CULL_STATS_READBACK_RING_SIZE; i++ )
+        {
+            SAFE_RELEASE(m_pLightCullStatsReadbackRing[i]);
+        }
+        for( unsigned i = 0; i < HIZ_NUM_LEVELS; i++ )
+        {
+            SAFE_RELEASE(m_pHiZTexture[i]);
+            SAFE_RELEASE(m_pHiZSRV[i]);
+            SAFE_RELEASE(m_pHiZUAV[i]);
+        }
+        SAFE_RELEASE(m_pBuildHiZCS);
+        SAFE_RELEASE(m_pBuildHiZCSMSAA);
         SAFE_RELEASE(m_pLightIndexBuffer);
         SAFE_RELEASE(m_pLightIndexBufferSRV);
         SAFE_RELEASE(m_pLightIndexBufferUAV);
+        SAFE_RELEASE(m_pCompactLightIndexBuffer);
+        SAFE_RELEASE(m_pCompactLightIndexBufferSRV);
+        SAFE_RELEASE(m_pCompactLightIndexBufferUAV);
+        SAFE_RELEASE(m_pCompactLightIndexCounterUAV);
+        SAFE_RELEASE(m_pClusterLightIndexBuffer);
+        SAFE_RELEASE(m_pClusterLightIndexBufferSRV);
+        SAFE_RELEASE(m_pClusterLightIndexBufferUAV);
+        SAFE_RELEASE(m_pCoarseLightIndexBuffer);
+        SAFE_RELEASE(m_pCoarseLightIndexBufferSRV);
+        SAFE_RELEASE(m_pCoarseLightIndexBufferUAV);
         SAFE_RELEASE(m_pQuadForLightsVB);
         SAFE_RELEASE(m_pQuadForLegendVB);
         SAFE_RELEASE(m_pConeForSpotLightsVB);
@@ -270,13 +410,28 @@ namespace ForwardPlus11
 
         D3D11_SUBRESOURCE_DATA InitData;
 
+        // the buffers start out with the lights in the order InitLights created them in
+        for( unsigned i = 0; i < g_uMaxNumLights; i++ )
+        {
+            g_PointLightOrder[i] = i;
+            g_SpotLightOrder[i] = i;
+        }
+        m_uNumPointLightsSorted = 0;
+        m_uNumSpotLightsSorted = 0;
+
+        // the animation starts from the lights' rest state, which is what goes into the buffers below
+        m_PointLightAnimator.Resize( g_uMaxNumLights );
+        m_SpotLightAnimator.Resize( g_uMaxNumLights );
+        ResetLightAnimation( m_PointLightAnimator, 0, g_uMaxNumLights, false );
+        ResetLightAnimation( m_SpotLightAnimator, 0, g_uMaxNumLights, true );
+
         // Create the point light buffer (center and radius)
         D3D11_BUFFER_DESC LightBufferDesc;
         ZeroMemory( &LightBufferDesc, sizeof(LightBufferDesc) );
-        LightBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-        LightBufferDesc.ByteWidth = sizeof( g_PointLightDataArrayCenterAndRadius );
+        LightBufferDesc.Usage = D3D11_USAGE_DEFAULT;  // not immutable, see UpdateLightOrder
+        LightBufferDesc.ByteWidth = (UINT)( sizeof( g_PointLightDataArrayCenterAndRadius[0] ) * g_PointLightDataArrayCenterAndRadius.size() );
         LightBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-        InitData.pSysMem = g_PointLightDataArrayCenterAndRadius;
+        InitData.pSysMem = &g_PointLightDataArrayCenterAndRadius[0];
         V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, &InitData, &m_pPointLightBufferCenterAndRadius ) );
         DXUT_SetDebugName( m_pPointLightBufferCenterAndRadius, "PointLightBufferCenterAndRadius" );
 
@@ -285,12 +440,12 @@ namespace ForwardPlus11
         SRVDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
         SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
         SRVDesc.Buffer.ElementOffset = 0;
-        SRVDesc.Buffer.ElementWidth = MAX_NUM_LIGHTS;
+        SRVDesc.Buffer.ElementWidth = g_uMaxNumLights;
         V_RETURN( pd3dDevice->CreateShaderResourceView( m_pPointLightBufferCenterAndRadius, &SRVDesc, &m_pPointLightBufferCenterAndRadiusSRV ) );
 
         // Create the point light buffer (color)
-        LightBufferDesc.ByteWidth = sizeof( g_PointLightDataArrayColor );
-        InitData.pSysMem = g_PointLightDataArrayColor;
+        LightBufferDesc.ByteWidth = (UINT)( sizeof( g_PointLightDataArrayColor[0] ) * g_PointLightDataArrayColor.size() );
+        InitData.pSysMem = &g_PointLightDataArrayColor[0];
         V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, &InitData, &m_pPointLightBufferColor ) );
         DXUT_SetDebugName( m_pPointLightBufferColor, "PointLightBufferColor" );
 
@@ -299,10 +454,10 @@ namespace ForwardPlus11
 
         // Create the spot light buffer (center and radius)
         ZeroMemory( &LightBufferDesc, sizeof(LightBufferDesc) );
-        LightBufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-        LightBufferDesc.ByteWidth = sizeof( g_SpotLightDataArrayCenterAndRadius );
+        LightBufferDesc.Usage = D3D11_USAGE_DEFAULT;  // not immutable, see UpdateLightOrder
+        LightBufferDesc.ByteWidth = (UINT)( sizeof( g_SpotLightDataArrayCenterAndRadius[0] ) * g_SpotLightDataArrayCenterAndRadius.size() );
         LightBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-        InitData.pSysMem = g_SpotLightDataArrayCenterAndRadius;
+        InitData.pSysMem = &g_SpotLightDataArrayCenterAndRadius[0];
         V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, &InitData, &m_pSpotLightBufferCenterAndRadius ) );
         DXUT_SetDebugName( m_pSpotLightBufferCenterAndRadius, "SpotLightBufferCenterAndRadius" );
 
@@ -310,12 +465,12 @@ namespace ForwardPlus11
         SRVDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
         SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
         SRVDesc.Buffer.ElementOffset = 0;
-        SRVDesc.Buffer.ElementWidth = MAX_NUM_LIGHTS;
+        SRVDesc.Buffer.ElementWidth = g_uMaxNumLights;
         V_RETURN( pd3dDevice->CreateShaderResourceView( m_pSpotLightBufferCenterAndRadius, &SRVDesc, &m_pSpotLightBufferCenterAndRadiusSRV ) );
 
         // Create the spot light buffer (color)
-        LightBufferDesc.ByteWidth = sizeof( g_SpotLightDataArrayColor );
-        InitData.pSysMem = g_SpotLightDataArrayColor;
+        LightBufferDesc.ByteWidth = (UINT)( sizeof( g_SpotLightDataArrayColor[0] ) * g_SpotLightDataArrayColor.size() );
+        InitData.pSysMem = &g_SpotLightDataArrayColor[0];
         V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, &InitData, &m_pSpotLightBufferColor ) );
         DXUT_SetDebugName( m_pSpotLightBufferColor, "SpotLightBufferColor" );
 
@@ -323,8 +478,8 @@ namespace ForwardPlus11
         V_RETURN( pd3dDevice->CreateShaderResourceView( m_pSpotLightBufferColor, &SRVDesc, &m_pSpotLightBufferColorSRV ) );
 
         // Create the spot light buffer (spot light parameters)
-        LightBufferDesc.ByteWidth = sizeof( g_SpotLightDataArraySpotParams );
-        InitData.pSysMem = g_SpotLightDataArraySpotParams;
+        LightBufferDesc.ByteWidth = (UINT)( sizeof( g_SpotLightDataArraySpotParams[0] ) * g_SpotLightDataArraySpotParams.size() );
+        InitData.pSysMem = &g_SpotLightDataArraySpotParams[0];
         V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, &InitData, &m_pSpotLightBufferSpotParams ) );
         DXUT_SetDebugName( m_pSpotLightBufferSpotParams, "SpotLightBufferSpotParams" );
 
@@ -332,14 +487,103 @@ namespace ForwardPlus11
         V_RETURN( pd3dDevice->CreateShaderResourceView( m_pSpotLightBufferSpotParams, &SRVDesc, &m_pSpotLightBufferSpotParamsSRV ) );
 
         // Create the light buffer (spot light matrices, only used for debug drawing the spot lights)
-        LightBufferDesc.ByteWidth = sizeof( g_SpotLightDataArraySpotMatrices );
-        InitData.pSysMem = g_SpotLightDataArraySpotMatrices;
+        LightBufferDesc.ByteWidth = (UINT)( sizeof( g_SpotLightDataArraySpotMatrices[0] ) * g_SpotLightDataArraySpotMatrices.size() );
+        InitData.pSysMem = &g_SpotLightDataArraySpotMatrices[0];
         V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, &InitData, &m_pSpotLightBufferSpotMatrices ) );
         DXUT_SetDebugName( m_pSpotLightBufferSpotMatrices, "SpotLightBufferSpotMatrices" );
 
         SRVDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
         V_RETURN( pd3dDevice->CreateShaderResourceView( m_pSpotLightBufferSpotMatrices, &SRVDesc, &m_pSpotLightBufferSpotMatricesSRV ) );
 
+        // Create the visible light buffers (see UpdateVisibleLights), rewritten whenever the visible lights change
+        ZeroMemory( &LightBufferDesc, sizeof(LightBufferDesc) );
+        LightBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+        LightBufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        LightBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        SRVDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+
+        LightBufferDesc.ByteWidth = (UINT)( sizeof( XMFLOAT4 ) * g_uMaxNumLights );
+        V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, NULL, &m_pVisiblePointLightBufferCenterAndRadius ) );
+        DXUT_SetDebugName( m_pVisiblePointLightBufferCenterAndRadius, "VisiblePointLightBufferCenterAndRadius" );
+        V_RETURN( pd3dDevice->CreateShaderResourceView( m_pVisiblePointLightBufferCenterAndRadius, &SRVDesc, &m_pVisiblePointLightBufferCenterAndRadiusSRV ) );
+        V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, NULL, &m_pVisibleSpotLightBufferCenterAndRadius ) );
+        DXUT_SetDebugName( m_pVisibleSpotLightBufferCenterAndRadius, "VisibleSpotLightBufferCenterAndRadius" );
+        V_RETURN( pd3dDevice->CreateShaderResourceView( m_pVisibleSpotLightBufferCenterAndRadius, &SRVDesc, &m_pVisibleSpotLightBufferCenterAndRadiusSRV ) );
+
+        LightBufferDesc.ByteWidth = (UINT)( sizeof( DWORD ) * g_uMaxNumLights );
+        SRVDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, NULL, &m_pVisiblePointLightBufferColor ) );
+        DXUT_SetDebugName( m_pVisiblePointLightBufferColor, "VisiblePointLightBufferColor" );
+        V_RETURN( pd3dDevice->CreateShaderResourceView( m_pVisiblePointLightBufferColor, &SRVDesc, &m_pVisiblePointLightBufferColorSRV ) );
+        V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, NULL, &m_pVisibleSpotLightBufferColor ) );
+        DXUT_SetDebugName( m_pVisibleSpotLightBufferColor, "VisibleSpotLightBufferColor" );
+        V_RETURN( pd3dDevice->CreateShaderResourceView( m_pVisibleSpotLightBufferColor, &SRVDesc, &m_pVisibleSpotLightBufferColorSRV ) );
+
+        LightBufferDesc.ByteWidth = (UINT)( sizeof( g_SpotLightDataArraySpotParams[0] ) * g_uMaxNumLights );
+        SRVDesc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+        V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, NULL, &m_pVisibleSpotLightBufferSpotParams ) );
+        DXUT_SetDebugName( m_pVisibleSpotLightBufferSpotParams, "VisibleSpotLightBufferSpotParams" );
+        V_RETURN( pd3dDevice->CreateShaderResourceView( m_pVisibleSpotLightBufferSpotParams, &SRVDesc, &m_pVisibleSpotLightBufferSpotParamsSRV ) );
+
+        m_VisiblePointLights.resize( g_uMaxNumLights );
+        m_VisibleSpotLights.resize( g_uMaxNumLights );
+        m_bFrustumPreCull = false;
+
+        // Create the packed light buffers (see UpdatePackedLights), rewritten whenever the lights change
+        LightBufferDesc.ByteWidth = (UINT)( sizeof( PackedLight ) * g_uMaxNumLights );
+        SRVDesc.Format = DXGI_FORMAT_R32G32B32_UINT;
+        V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, NULL, &m_pPackedPointLightBuffer ) );
+        DXUT_SetDebugName( m_pPackedPointLightBuffer, "PackedPointLightBuffer" );
+        V_RETURN( pd3dDevice->CreateShaderResourceView( m_pPackedPointLightBuffer, &SRVDesc, &m_pPackedPointLightBufferSRV ) );
+        V_RETURN( pd3dDevice->CreateBuffer( &LightBufferDesc, NULL, &m_pPackedSpotLightBuffer ) );
+        DXUT_SetDebugName( m_pPackedSpotLightBuffer, "PackedSpotLightBuffer" );
+        V_RETURN( pd3dDevice->CreateShaderResourceView( m_pPackedSpotLightBuffer, &SRVDesc, &m_pPackedSpotLightBufferSRV ) );
+        m_bPackedLights = false;
+
+        // Create the staging buffers for uploading the animated lights
+        D3D11_BUFFER_DESC StagingBufferDesc;
+        ZeroMemory( &StagingBufferDesc, sizeof(StagingBufferDesc) );
+        StagingBufferDesc.Usage = D3D11_USAGE_STAGING;
+        StagingBufferDesc.ByteWidth = 2 * g_uMaxNumLights * (UINT)( sizeof( XMFLOAT4 ) + sizeof( DWORD ) );
+        StagingBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        for( unsigned i = 0; i < LIGHT_UPLOAD_RING_SIZE; i++ )
+        {
+            V_RETURN( pd3dDevice->CreateBuffer( &StagingBufferDesc, NULL, &m_pLightUploadRing[i] ) );
+            DXUT_SetDebugName( m_pLightUploadRing[i], "LightUploadRing" );
+        }
+        m_uLightUploadRingIndex = 0;
+        m_uNumLightUploadStalls = 0;
+        m_uLightGeneration++;
+
+        // Create the light list statistics buffer, and the staging buffers for reading it back
+        D3D11_BUFFER_DESC StatsBufferDesc;
+        ZeroMemory( &StatsBufferDesc, sizeof(StatsBufferDesc) );
+        StatsBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+        StatsBufferDesc.ByteWidth = 4 * LIGHT_CULL_STATS_BUFFER_SIZE;
+        StatsBufferDesc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+        V_RETURN( pd3dDevice->CreateBuffer( &StatsBufferDesc, NULL, &m_pLightCullStatsBuffer ) );
+        DXUT_SetDebugName( m_pLightCullStatsBuffer, "LightCullStatsBuffer" );
+
+        D3D11_UNORDERED_ACCESS_VIEW_DESC StatsUAVDesc;
+        ZeroMemory( &StatsUAVDesc, sizeof( D3D11_UNORDERED_ACCESS_VIEW_DESC ) );
+        StatsUAVDesc.Format = DXGI_FORMAT_R32_UINT;
+        StatsUAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+        StatsUAVDesc.Buffer.FirstElement = 0;
+        StatsUAVDesc.Buffer.NumElements = LIGHT_CULL_STATS_BUFFER_SIZE;
+        V_RETURN( pd3dDevice->CreateUnorderedAccessView( m_pLightCullStatsBuffer, &StatsUAVDesc, &m_pLightCullStatsUAV ) );
+
+        StatsBufferDesc.Usage = D3D11_USAGE_STAGING;
+        StatsBufferDesc.BindFlags = 0;
+        StatsBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+        for( unsigned i = 0; i < LIGHT_CULL_STATS_READBACK_RING_SIZE; i++ )
+        {
+            V_RETURN( pd3dDevice->CreateBuffer( &StatsBufferDesc, NULL, &m_pLightCullStatsReadbackRing[i] ) );
+            DXUT_SetDebugName( m_pLightCullStatsReadbackRing[i], "LightCullStatsReadbackRing" );
+            m_bLightCullStatsReadbackPending[i] = false;
+        }
+        m_uLightCullStatsReadbackRingIndex = 0;
+        m_LightCullStats = LightCullStats();
+
         // Create the vertex buffer for the sprites (a single quad)
         D3D11_BUFFER_DESC VBDesc;
         ZeroMemory( &VBDesc, sizeof(VBDesc) );
@@ -429,6 +673,33 @@ namespace ForwardPlus11
         SAFE_RELEASE( m_pSpotLightBufferSpotParamsSRV );
         SAFE_RELEASE( m_pSpotLightBufferSpotMatrices );
         SAFE_RELEASE( m_pSpotLightBufferSpotMatricesSRV );
+        SAFE_RELEASE( m_pVisiblePointLightBufferCenterAndRadius );
+        SAFE_RELEASE( m_pVisiblePointLightBufferCenterAndRadiusSRV );
+        SAFE_RELEASE( m_pVisiblePointLightBufferColor );
+        SAFE_RELEASE( m_pVisiblePointLightBufferColorSRV );
+        SAFE_RELEASE( m_pVisibleSpotLightBufferCenterAndRadius );
+        SAFE_RELEASE( m_pVisibleSpotLightBufferCenterAndRadiusSRV );
+        SAFE_RELEASE( m_pVisibleSpotLightBufferColor );
+        SAFE_RELEASE( m_pVisibleSpotLightBufferColorSRV );
+        SAFE_RELEASE( m_pVisibleSpotLightBufferSpotParams );
+        SAFE_RELEASE( m_pVisibleSpotLightBufferSpotParamsSRV );
+        SAFE_RELEASE( m_pPackedPointLightBuffer );
+        SAFE_RELEASE( m_pPackedPointLightBufferSRV );
+        SAFE_RELEASE( m_pPackedSpotLightBuffer );
+        SAFE_RELEASE( m_pPackedSpotLightBufferSRV );
+        for( unsigned i = 0; i < LIGHT_UPLOAD_RING_SIZE; i++ )
+        {
+            SAFE_RELEASE( m_pLightUploadRing[i] );
+        }
+        SAFE_RELEASE( m_pLightCullStatsBuffer );
+        SAFE_RELEASE( m_pLightCullStatsUAV );
+        for( unsigned i = 0; i < LIGHT_CULL_STATS_READBACK_RING_SIZE; i++ )
+        {
+            SAFE_RELEASE( m_pLightCullStatsReadbackRing[i] );
+        }
+
+        SAFE_RELEASE( m_pBuildHiZCS );
+        SAFE_RELEASE( m_pBuildHiZCSMSAA );
 
         SAFE_RELEASE( m_pQuadForLightsVB );
         SAFE_RELEASE( m_pQuadForLegendVB );
@@ -465,34 +736,14 @@ namespace ForwardPlus11
         m_uWidth = pBackBufferSurfaceDesc->Width;
         m_uHeight = pBackBufferSurfaceDesc->Height;
 
-        // depends on m_uWidth and m_uHeight, so don't do this 
+        // these depend on m_uWidth and m_uHeight, so don't do this 
         // until you have updated them (see above)
-        unsigned uNumTiles = GetNumTilesX()*GetNumTilesY();
-        unsigned uMaxNumLightsPerTile = GetMaxNumLightsPerTile();
-
-        D3D11_BUFFER_DESC BufferDesc;
-        ZeroMemory( &BufferDesc, sizeof(BufferDesc) );
-        BufferDesc.Usage = D3D11_USAGE_DEFAULT;
-        BufferDesc.ByteWidth = 4 * uMaxNumLightsPerTile * uNumTiles;
-        BufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
-        V_RETURN( pd3dDevice->CreateBuffer( &BufferDesc, NULL, &m_pLightIndexBuffer ) );
-        DXUT_SetDebugName( m_pLightIndexBuffer, "LightIndexBuffer" );
-
-        D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc;
-        ZeroMemory( &SRVDesc, sizeof( D3D11_SHADER_RESOURCE_VIEW_DESC ) );
-        SRVDesc.Format = DXGI_FORMAT_R32_UINT;
-        SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-        SRVDesc.Buffer.ElementOffset = 0;
-        SRVDesc.Buffer.ElementWidth = uMaxNumLightsPerTile * uNumTiles;
-        V_RETURN( pd3dDevice->CreateShaderResourceView( m_pLightIndexBuffer, &SRVDesc, &m_pLightIndexBufferSRV ) );
-
-        D3D11_UNORDERED_ACCESS_VIEW_DESC UAVDesc;
-        ZeroMemory( &UAVDesc, sizeof( D3D11_UNORDERED_ACCESS_VIEW_DESC ) );
-        UAVDesc.Format = DXGI_FORMAT_R32_UINT;
-        UAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
-        UAVDesc.Buffer.FirstElement = 0;
-        UAVDesc.Buffer.NumElements = uMaxNumLightsPerTile * uNumTiles;
-        V_RETURN( pd3dDevice->CreateUnorderedAccessView( m_pLightIndexBuffer, &UAVDesc, &m_pLightIndexBufferUAV ) );
+        ResetMaxNumLightsPerTile();
+        V_RETURN( CreateLightIndexBuffer( pd3dDevice ) );
+        V_RETURN( CreateCompactLightIndexBuffer( pd3dDevice ) );
+        V_RETURN( CreateClusterLightIndexBuffer( pd3dDevice ) );
+        V_RETURN( CreateCoarseLightIndexBuffer( pd3dDevice ) );
+        V_RETURN( CreateHiZTextures( pd3dDevice ) );
 
         // initialize the vertex buffer data for a quad (for drawing the lights-per-tile legend)
         const float kTextureHeight = (float)g_nLegendNumLines * (float)nLineHeight;
@@ -538,9 +789,328 @@ namespace ForwardPlus11
         SAFE_RELEASE(m_pLightIndexBuffer);
         SAFE_RELEASE(m_pLightIndexBufferSRV);
         SAFE_RELEASE(m_pLightIndexBufferUAV);
+        SAFE_RELEASE(m_pCompactLightIndexBuffer);
+        SAFE_RELEASE(m_pCompactLightIndexBufferSRV);
+        SAFE_RELEASE(m_pCompactLightIndexBufferUAV);
+        SAFE_RELEASE(m_pCompactLightIndexCounterUAV);
+        SAFE_RELEASE(m_pClusterLightIndexBuffer);
+        SAFE_RELEASE(m_pClusterLightIndexBufferSRV);
+        SAFE_RELEASE(m_pClusterLightIndexBufferUAV);
+        SAFE_RELEASE(m_pCoarseLightIndexBuffer);
+        SAFE_RELEASE(m_pCoarseLightIndexBufferSRV);
+        SAFE_RELEASE(m_pCoarseLightIndexBufferUAV);
+        for( unsigned i = 0; i < HIZ_NUM_LEVELS; i++ )
+        {
+            SAFE_RELEASE(m_pHiZTexture[i]);
+            SAFE_RELEASE(m_pHiZSRV[i]);
+            SAFE_RELEASE(m_pHiZUAV[i]);
+        }
         SAFE_RELEASE(m_pQuadForLegendVB);
     }
 
+    //--------------------------------------------------------------------------------------
+    // Change the cluster layout used for clustered light culling
+    //--------------------------------------------------------------------------------------
+    HRESULT ForwardPlusUtil::SetClusterConfig( ID3D11Device* pd3dDevice, const ClusterConfig& Config )
+    {
+        assert( Config.uNumSlices >= 1 && Config.uNumSlices <= MAX_NUM_CLUSTER_SLICES );
+        assert( Config.uMaxNumLightsPerCluster >= 2 && Config.uMaxNumLightsPerCluster <= MAX_NUM_LIGHTS_PER_CLUSTER );
+
+        bool bResize = ( Config.uNumSlices != m_ClusterConfig.uNumSlices ) || 
+            ( Config.uMaxNumLightsPerCluster != m_ClusterConfig.uMaxNumLightsPerCluster );
+
+        m_ClusterConfig = Config;
+
+        // the buffer only exists between OnResizedSwapChain and OnReleasingSwapChain
+        if( bResize && pd3dDevice && m_pClusterLightIndexBuffer )
+        {
+            SAFE_RELEASE(m_pClusterLightIndexBuffer);
+            SAFE_RELEASE(m_pClusterLightIndexBufferSRV);
+            SAFE_RELEASE(m_pClusterLightIndexBufferUAV);
+            return CreateClusterLightIndexBuffer( pd3dDevice );
+        }
+
+        return S_OK;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Change the light culling tile size
+    //--------------------------------------------------------------------------------------
+    HRESULT ForwardPlusUtil::SetTileRes( ID3D11Device* pd3dDevice, unsigned uTileRes )
+    {
+        HRESULT hr;
+
+        assert( GetTileResIndex( uTileRes ) < NUM_TILE_RES );
+
+        bool bResize = ( uTileRes != m_uTileRes );
+
+        m_uTileRes = uTileRes;
+
+        // the buffers only exist between OnResizedSwapChain and OnReleasingSwapChain
+        if( bResize && pd3dDevice && m_pLightIndexBuffer )
+        {
+            ResetMaxNumLightsPerTile();
+            SAFE_RELEASE(m_pLightIndexBuffer);
+            SAFE_RELEASE(m_pLightIndexBufferSRV);
+            SAFE_RELEASE(m_pLightIndexBufferUAV);
+            SAFE_RELEASE(m_pCompactLightIndexBuffer);
+            SAFE_RELEASE(m_pCompactLightIndexBufferSRV);
+            SAFE_RELEASE(m_pCompactLightIndexBufferUAV);
+            SAFE_RELEASE(m_pCompactLightIndexCounterUAV);
+            SAFE_RELEASE(m_pClusterLightIndexBuffer);
+            SAFE_RELEASE(m_pClusterLightIndexBufferSRV);
+            SAFE_RELEASE(m_pClusterLightIndexBufferUAV);
+            V_RETURN( CreateLightIndexBuffer( pd3dDevice ) );
+            V_RETURN( CreateCompactLightIndexBuffer( pd3dDevice ) );
+            V_RETURN( CreateClusterLightIndexBuffer( pd3dDevice ) );
+        }
+
+        return S_OK;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Start sizing the light index buffer over, for a new screen or tile size
+    //--------------------------------------------------------------------------------------
+    void ForwardPlusUtil::ResetMaxNumLightsPerTile()
+    {
+        m_LightListCapacitySizer.Reset( GetInitialMaxNumLightsPerTile( m_uTileRes, m_uHeight ), GetMaxNumLightsPerTileForTileRes( m_uTileRes ) );
+        m_uMaxNumLightsPerTile = m_LightListCapacitySizer.GetCapacity();
+
+        // the statistics on their way back were measured for the old tiles
+        for( unsigned i = 0; i < LIGHT_CULL_STATS_READBACK_RING_SIZE; i++ )
+        {
+            m_bLightCullStatsPerTile[i] = false;
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Resize the light index buffer to what the measurements asked for
+    //--------------------------------------------------------------------------------------
+    HRESULT ForwardPlusUtil::UpdateMaxNumLightsPerTile( ID3D11Device* pd3dDevice )
+    {
+        HRESULT hr;
+
+        // the buffer only exists between OnResizedSwapChain and OnReleasingSwapChain
+        if( m_LightListCapacitySizer.GetCapacity() != m_uMaxNumLightsPerTile && m_pLightIndexBuffer )
+        {
+            m_uMaxNumLightsPerTile = m_LightListCapacitySizer.GetCapacity();
+            SAFE_RELEASE(m_pLightIndexBuffer);
+            SAFE_RELEASE(m_pLightIndexBufferSRV);
+            SAFE_RELEASE(m_pLightIndexBufferUAV);
+            V_RETURN( CreateLightIndexBuffer( pd3dDevice ) );
+        }
+
+        return S_OK;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Create the light index buffer for tiled light culling, 
+    // with GetMaxNumLightsPerTile entries for every tile
+    //--------------------------------------------------------------------------------------
+    HRESULT ForwardPlusUtil::CreateLightIndexBuffer( ID3D11Device* pd3dDevice )
+    {
+        HRESULT hr;
+
+        unsigned uNumTiles = GetNumTilesX()*GetNumTilesY();
+        unsigned uMaxNumLightsPerTile = GetMaxNumLightsPerTile();
+
+        D3D11_BUFFER_DESC BufferDesc;
+        ZeroMemory( &BufferDesc, sizeof(BufferDesc) );
+        BufferDesc.Usage = D3D11_USAGE_DEFAULT;
+        BufferDesc.ByteWidth = 4 * uMaxNumLightsPerTile * uNumTiles;
+        BufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+        V_RETURN( pd3dDevice->CreateBuffer( &BufferDesc, NULL, &m_pLightIndexBuffer ) );
+        DXUT_SetDebugName( m_pLightIndexBuffer, "LightIndexBuffer" );
+        m_uLightIndexBufferGeneration++;
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc;
+        ZeroMemory( &SRVDesc, sizeof( D3D11_SHADER_RESOURCE_VIEW_DESC ) );
+        SRVDesc.Format = DXGI_FORMAT_R32_UINT;
+        SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+        SRVDesc.Buffer.ElementOffset = 0;
+        SRVDesc.Buffer.ElementWidth = uMaxNumLightsPerTile * uNumTiles;
+        V_RETURN( pd3dDevice->CreateShaderResourceView( m_pLightIndexBuffer, &SRVDesc, &m_pLightIndexBufferSRV ) );
+
+        D3D11_UNORDERED_ACCESS_VIEW_DESC UAVDesc;
+        ZeroMemory( &UAVDesc, sizeof( D3D11_UNORDERED_ACCESS_VIEW_DESC ) );
+        UAVDesc.Format = DXGI_FORMAT_R32_UINT;
+        UAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+        UAVDesc.Buffer.FirstElement = 0;
+        UAVDesc.Buffer.NumElements = uMaxNumLightsPerTile * uNumTiles;
+        V_RETURN( pd3dDevice->CreateUnorderedAccessView( m_pLightIndexBuffer, &UAVDesc, &m_pLightIndexBufferUAV ) );
+
+        return S_OK;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Create the light index buffer for compact light lists, with room for
+    // COMPACT_LIST_AVERAGE_NUM_ENTRIES_PER_TILE entries per tile on average 
+    // (scaled with the tile size, like the max number of lights per tile)
+    //--------------------------------------------------------------------------------------
+    HRESULT ForwardPlusUtil::CreateCompactLightIndexBuffer( ID3D11Device* pd3dDevice )
+    {
+        HRESULT hr;
+
+        unsigned uAverageNumEntriesPerTile = COMPACT_LIST_AVERAGE_NUM_ENTRIES_PER_TILE * m_uTileRes / DEFAULT_TILE_RES;
+        unsigned uNumElements = GetCompactLightIndexBufferNumElements( GetNumTilesX()*GetNumTilesY(), uAverageNumEntriesPerTile );
+
+        D3D11_BUFFER_DESC BufferDesc;
+        ZeroMemory( &BufferDesc, sizeof(BufferDesc) );
+        BufferDesc.Usage = D3D11_USAGE_DEFAULT;
+        BufferDesc.ByteWidth = 4 * uNumElements;
+        BufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+        V_RETURN( pd3dDevice->CreateBuffer( &BufferDesc, NULL, &m_pCompactLightIndexBuffer ) );
+        DXUT_SetDebugName( m_pCompactLightIndexBuffer, "CompactLightIndexBuffer" );
+        m_uLightIndexBufferGeneration++;
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc;
+        ZeroMemory( &SRVDesc, sizeof( D3D11_SHADER_RESOURCE_VIEW_DESC ) );
+        SRVDesc.Format = DXGI_FORMAT_R32_UINT;
+        SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+        SRVDesc.Buffer.ElementOffset = 0;
+        SRVDesc.Buffer.ElementWidth = uNumElements;
+        V_RETURN( pd3dDevice->CreateShaderResourceView( m_pCompactLightIndexBuffer, &SRVDesc, &m_pCompactLightIndexBufferSRV ) );
+
+        D3D11_UNORDERED_ACCESS_VIEW_DESC UAVDesc;
+        ZeroMemory( &UAVDesc, sizeof( D3D11_UNORDERED_ACCESS_VIEW_DESC ) );
+        UAVDesc.Format = DXGI_FORMAT_R32_UINT;
+        UAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+        UAVDesc.Buffer.FirstElement = 0;
+        UAVDesc.Buffer.NumElements = uNumElements;
+        V_RETURN( pd3dDevice->CreateUnorderedAccessView( m_pCompactLightIndexBuffer, &UAVDesc, &m_pCompactLightIndexBufferUAV ) );
+
+        UAVDesc.Buffer.FirstElement = COMPACT_LIST_COUNTER_OFFSET;
+        UAVDesc.Buffer.NumElements = 1;
+        V_RETURN( pd3dDevice->CreateUnorderedAccessView( m_pCompactLightIndexBuffer, &UAVDesc, &m_pCompactLightIndexCounterUAV ) );
+
+        return S_OK;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Create the light index buffer for clustered light culling, 
+    // with uMaxNumLightsPerCluster entries for every cluster
+    //--------------------------------------------------------------------------------------
+    HRESULT ForwardPlusUtil::CreateClusterLightIndexBuffer( ID3D11Device* pd3dDevice )
+    {
+        HRESULT hr;
+
+        unsigned uNumClusters = GetNumTilesX()*GetNumTilesY()*m_ClusterConfig.uNumSlices;
+        unsigned uNumElements = m_ClusterConfig.uMaxNumLightsPerCluster * uNumClusters;
+
+        D3D11_BUFFER_DESC BufferDesc;
+        ZeroMemory( &BufferDesc, sizeof(BufferDesc) );
+        BufferDesc.Usage = D3D11_USAGE_DEFAULT;
+        BufferDesc.ByteWidth = 4 * uNumElements;
+        BufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+        V_RETURN( pd3dDevice->CreateBuffer( &BufferDesc, NULL, &m_pClusterLightIndexBuffer ) );
+        DXUT_SetDebugName( m_pClusterLightIndexBuffer, "ClusterLightIndexBuffer" );
+        m_uLightIndexBufferGeneration++;
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc;
+        ZeroMemory( &SRVDesc, sizeof( D3D11_SHADER_RESOURCE_VIEW_DESC ) );
+        SRVDesc.Format = DXGI_FORMAT_R32_UINT;
+        SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+        SRVDesc.Buffer.ElementOffset = 0;
+        SRVDesc.Buffer.ElementWidth = uNumElements;
+        V_RETURN( pd3dDevice->CreateShaderResourceView( m_pClusterLightIndexBuffer, &SRVDesc, &m_pClusterLightIndexBufferSRV ) );
+
+        D3D11_UNORDERED_ACCESS_VIEW_DESC UAVDesc;
+        ZeroMemory( &UAVDesc, sizeof( D3D11_UNORDERED_ACCESS_VIEW_DESC ) );
+        UAVDesc.Format = DXGI_FORMAT_R32_UINT;
+        UAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+        UAVDesc.Buffer.FirstElement = 0;
+        UAVDesc.Buffer.NumElements = uNumElements;
+        V_RETURN( pd3dDevice->CreateUnorderedAccessView( m_pClusterLightIndexBuffer, &UAVDesc, &m_pClusterLightIndexBufferUAV ) );
+
+        return S_OK;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Create the light index buffer for the coarse tiles of two-level culling
+    //--------------------------------------------------------------------------------------
+    HRESULT ForwardPlusUtil::CreateCoarseLightIndexBuffer( ID3D11Device* pd3dDevice )
+    {
+        HRESULT hr;
+
+        unsigned uNumElements = MAX_NUM_LIGHTS_PER_COARSE_TILE * GetNumCoarseTilesX() * GetNumCoarseTilesY();
+
+        D3D11_BUFFER_DESC BufferDesc;
+        ZeroMemory( &BufferDesc, sizeof(BufferDesc) );
+        BufferDesc.Usage = D3D11_USAGE_DEFAULT;
+        BufferDesc.ByteWidth = 4 * uNumElements;
+        BufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+        V_RETURN( pd3dDevice->CreateBuffer( &BufferDesc, NULL, &m_pCoarseLightIndexBuffer ) );
+        DXUT_SetDebugName( m_pCoarseLightIndexBuffer, "CoarseLightIndexBuffer" );
+        m_uLightIndexBufferGeneration++;
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc;
+        ZeroMemory( &SRVDesc, sizeof( D3D11_SHADER_RESOURCE_VIEW_DESC ) );
+        SRVDesc.Format = DXGI_FORMAT_R32_UINT;
+        SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+        SRVDesc.Buffer.ElementOffset = 0;
+        SRVDesc.Buffer.ElementWidth = uNumElements;
+        V_RETURN( pd3dDevice->CreateShaderResourceView( m_pCoarseLightIndexBuffer, &SRVDesc, &m_pCoarseLightIndexBufferSRV ) );
+
+        D3D11_UNORDERED_ACCESS_VIEW_DESC UAVDesc;
+        ZeroMemory( &UAVDesc, sizeof( D3D11_UNORDERED_ACCESS_VIEW_DESC ) );
+        UAVDesc.Format = DXGI_FORMAT_R32_UINT;
+        UAVDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+        UAVDesc.Buffer.FirstElement = 0;
+        UAVDesc.Buffer.NumElements = uNumElements;
+        V_RETURN( pd3dDevice->CreateUnorderedAccessView( m_pCoarseLightIndexBuffer, &UAVDesc, &m_pCoarseLightIndexBufferUAV ) );
+
+        return S_OK;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Create the levels of the Hi-Z depth pyramid, each rounded up on its own 
+    // (like CpuDepthPyramid::GetLevelWidth), so that each has a texel per tile
+    //--------------------------------------------------------------------------------------
+    HRESULT ForwardPlusUtil::CreateHiZTextures( ID3D11Device* pd3dDevice )
+    {
+        HRESULT hr;
+
+        for( unsigned uLevel = HIZ_FIRST_LEVEL; uLevel <= HIZ_LAST_LEVEL; uLevel++ )
+        {
+            unsigned i = uLevel - HIZ_FIRST_LEVEL;
+
+            D3D11_TEXTURE2D_DESC TextureDesc;
+            ZeroMemory( &TextureDesc, sizeof(TextureDesc) );
+            TextureDesc.Width = ( m_uWidth + ( 1u << uLevel ) - 1 ) >> uLevel;
+            TextureDesc.Height = ( m_uHeight + ( 1u << uLevel ) - 1 ) >> uLevel;
+            TextureDesc.MipLevels = 1;
+            TextureDesc.ArraySize = 1;
+            TextureDesc.Format = DXGI_FORMAT_R32G32_FLOAT;
+            TextureDesc.SampleDesc.Count = 1;
+            TextureDesc.Usage = D3D11_USAGE_DEFAULT;
+            TextureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+            V_RETURN( pd3dDevice->CreateTexture2D( &TextureDesc, NULL, &m_pHiZTexture[i] ) );
+            DXUT_SetDebugName( m_pHiZTexture[i], "HiZTexture" );
+
+            V_RETURN( pd3dDevice->CreateShaderResourceView( m_pHiZTexture[i], NULL, &m_pHiZSRV[i] ) );
+            V_RETURN( pd3dDevice->CreateUnorderedAccessView( m_pHiZTexture[i], NULL, &m_pHiZUAV[i] ) );
+        }
+
+        return S_OK;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Build all levels of the Hi-Z depth pyramid from the depth buffer
+    //--------------------------------------------------------------------------------------
+    void ForwardPlusUtil::BuildHiZ( ID3D11DeviceContext* pd3dImmediateContext, ID3D11ShaderResourceView* pDepthSRV, bool bMSAA )
+    {
+        ID3D11ShaderResourceView* pNULLSRV = NULL;
+        ID3D11UnorderedAccessView* pNULLUAVs[HIZ_NUM_LEVELS] = { NULL };
+
+        pd3dImmediateContext->CSSetShader( bMSAA ? m_pBuildHiZCSMSAA : m_pBuildHiZCS, NULL, 0 );
+        pd3dImmediateContext->CSSetShaderResources( 0, 1, &pDepthSRV );
+        pd3dImmediateContext->CSSetUnorderedAccessViews( 0, HIZ_NUM_LEVELS, m_pHiZUAV, NULL );
+        pd3dImmediateContext->Dispatch( ( m_uWidth + HIZ_BLOCK_RES - 1 ) / HIZ_BLOCK_RES, ( m_uHeight + HIZ_BLOCK_RES - 1 ) / HIZ_BLOCK_RES, 1 );
+        pd3dImmediateContext->CSSetShader( NULL, NULL, 0 );
+        pd3dImmediateContext->CSSetShaderResources( 0, 1, &pNULLSRV );
+        pd3dImmediateContext->CSSetUnorderedAccessViews( 0, HIZ_NUM_LEVELS, pNULLUAVs, NULL );
+    }
+
     //--------------------------------------------------------------------------------------
     // Render hook function, to draw the lights (as instanced quads)
     //--------------------------------------------------------------------------------------
@@ -663,8 +1233,19 @@ namespace ForwardPlus11
     // Fill in the data for the lights (center, radius, and color).
     // Also fill in the vertex data for the sprite quad.
     //--------------------------------------------------------------------------------------
-    void ForwardPlusUtil::InitLights( const XMVECTOR &BBoxMin, const XMVECTOR &BBoxMax )
+    void ForwardPlusUtil::InitLights( const XMVECTOR &BBoxMin, const XMVECTOR &BBoxMax, unsigned uMaxNumLights )
     {
+        assert( uMaxNumLights > 0 && uMaxNumLights <= MAX_NUM_LIGHTS_LIMIT );
+        g_uMaxNumLights = uMaxNumLights;
+        g_PointLightDataArrayCenterAndRadius.resize( uMaxNumLights );
+        g_PointLightDataArrayColor.resize( uMaxNumLights );
+        g_SpotLightDataArrayCenterAndRadius.resize( uMaxNumLights );
+        g_SpotLightDataArrayColor.resize( uMaxNumLights );
+        g_SpotLightDataArraySpotParams.resize( uMaxNumLights );
+        g_SpotLightDataArraySpotMatrices.resize( uMaxNumLights );
+        g_PointLightOrder.resize( uMaxNumLights );
+        g_SpotLightOrder.resize( uMaxNumLights );
+
         // init the random seed to 1, so that results are deterministic 
         // across different runs of the sample
         srand(1);
@@ -673,6 +1254,13 @@ namespace ForwardPlus11
         XMVECTOR BBoxExtents = 0.5f * (BBoxMax - BBoxMin);
         float fRadius = 0.075f * XMVectorGetX(XMVector3Length(BBoxExtents));
 
+        // with more lights than the default, shrink them so that about as many 
+        // overlap any given point (which goes with the cube root of the count)
+        if( uMaxNumLights > DEFAULT_MAX_NUM_LIGHTS )
+        {
+            fRadius *= powf( (float)DEFAULT_MAX_NUM_LIGHTS / (float)uMaxNumLights, 1.0f/3.0f );
+        }
+
         // For point lights, the radius of the bounding sphere for the light (used for culling) 
         // and the falloff distance of the light (used for lighting) are the same. Not so for 
         // spot lights. A spot light is a right circular cone. The height of the cone is the 
@@ -685,15 +1273,20 @@ namespace ForwardPlus11
         XMStoreFloat3( &vBBoxMin, BBoxMin );
         XMStoreFloat3( &vBBoxMax, BBoxMax );
 
+        // the lights start inside the scene AABB, and the animation moves them 
+        // less than a radius away from there (see ResetLightAnimation)
+        g_PackedLightBounds = ForwardPlus11::GetPackedLightBounds( XMFLOAT3( vBBoxMin.x - fRadius, vBBoxMin.y - fRadius, vBBoxMin.z - fRadius ), 
+                                                                   XMFLOAT3( vBBoxMax.x + fRadius, vBBoxMax.y + fRadius, vBBoxMax.z + fRadius ) );
+
         // initialize the point light data
-        for (int i = 0; i < MAX_NUM_LIGHTS; i++)
+        for (unsigned i = 0; i < uMaxNumLights; i++)
         {
             g_PointLightDataArrayCenterAndRadius[i] = XMFLOAT4(GetRandFloat(vBBoxMin.x,vBBoxMax.x), GetRandFloat(vBBoxMin.y,vBBoxMax.y), GetRandFloat(vBBoxMin.z,vBBoxMax.z), fRadius);
             g_PointLightDataArrayColor[i] = GetRandColor();
         }
 
         // initialize the spot light data
-        for (int i = 0; i < MAX_NUM_LIGHTS; i++)
+        for (unsigned i = 0; i < uMaxNumLights; i++)
         {
             g_SpotLightDataArrayCenterAndRadius[i] = XMFLOAT4(GetRandFloat(vBBoxMin.x,vBBoxMax.x), GetRandFloat(vBBoxMin.y,vBBoxMax.y), GetRandFloat(vBBoxMin.z,vBBoxMax.z), fRadius);
             g_SpotLightDataArrayColor[i] = GetRandColor();
@@ -734,7 +1327,7 @@ namespace ForwardPlus11
             f4x4Rotation._33 = e + h*v.z*v.z;
             XMMATRIX mRotation = XMLoadFloat4x4( &f4x4Rotation );
 
-            g_SpotLightDataArraySpotMatrices[i] = XMMatrixTranspose(mRotation);
+            XMStoreFloat4x4( &g_SpotLightDataArraySpotMatrices[i], XMMatrixTranspose(mRotation) );
         }
 
         // initialize the vertex buffer data for a quad (for drawing the lights)
@@ -822,6 +1415,8 @@ namespace ForwardPlus11
         SAFE_RELEASE( m_pDebugDrawLegendForNumLightsPerTileGrayscalePS );
         SAFE_RELEASE( m_pDebugDrawLegendForNumLightsPerTileRadarColorsPS );
         SAFE_RELEASE( m_pDebugDrawLegendForNumLightsLayout11 );
+        SAFE_RELEASE( m_pBuildHiZCS );
+        SAFE_RELEASE( m_pBuildHiZCSMSAA );
 
         const D3D11_INPUT_ELEMENT_DESC LayoutForSprites[] =
         {
@@ -856,12 +1451,23 @@ namespace ForwardPlus11
 
         pShaderCache->AddShader( (ID3D11DeviceChild**)&m_pDebugDrawLegendForNumLightsPerTileRadarColorsPS, AMD::ShaderCache::SHADER_TYPE_PIXEL, L"ps_5_0", L"DebugDrawLegendForNumLightsPerTileRadarColorsPS",
             L"ForwardPlus11DebugDraw.hlsl", 0, NULL, NULL, NULL, 0 );
+
+        AMD::ShaderCache::Macro ShaderMacroUseMSAA;
+        wcscpy_s( ShaderMacroUseMSAA.m_wsName, AMD::ShaderCache::m_uMACRO_MAX_LENGTH, L"USE_MSAA" );
+
+        ShaderMacroUseMSAA.m_iValue = 0;
+        pShaderCache->AddShader( (ID3D11DeviceChild**)&m_pBuildHiZCS, AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"BuildHiZCS",
+            L"ForwardPlus11HiZ.hlsl", 1, &ShaderMacroUseMSAA, NULL, NULL, 0 );
+
+        ShaderMacroUseMSAA.m_iValue = 1;
+        pShaderCache->AddShader( (ID3D11DeviceChild**)&m_pBuildHiZCSMSAA, AMD::ShaderCache::SHADER_TYPE_COMPUTE, L"cs_5_0", L"BuildHiZCS",
+            L"ForwardPlus11HiZ.hlsl", 1, &ShaderMacroUseMSAA, NULL, NULL, 0 );
     }
 
     //--------------------------------------------------------------------------------------
     // Draw the legend for the lights-per-tile visualization
     //--------------------------------------------------------------------------------------
-    void ForwardPlusUtil::RenderLegend( CDXUTTextHelper *pTxtHelper, int nLineHeight, XMFLOAT4 Color, bool bGrayscaleMode )
+    void ForwardPlusUtil::RenderLegend( CDXUTTextHelper *pTxtHelper, int nLineHeight, XMFLOAT4 Color, bool bGrayscaleMode, bool bClusteredMode )
     {
         // draw the legend texture for the lights-per-tile visualization
         {
@@ -913,7 +1519,8 @@ namespace ForwardPlus11
             // 17 lines times line height
             int nTextureHeight = g_nLegendNumLines*nLineHeight;
 
-            int nMaxNumLightsPerTile = (int)GetMaxNumLightsPerTile();
+            // in clustered mode, the visualization shows the busiest cluster in each tile
+            int nMaxNumLightsPerTile = bClusteredMode ? (int)m_ClusterConfig.uMaxNumLightsPerCluster : (int)GetMaxNumLightsPerTile();
             WCHAR szBuf[16];
 
             pTxtHelper->Begin();
@@ -978,42 +1585,277 @@ namespace ForwardPlus11
     }
 
     //--------------------------------------------------------------------------------------
-    // Calculate the number of tiles in the horizontal direction
+    // Morton sort the active lights, if the number of them changed
     //--------------------------------------------------------------------------------------
-    unsigned ForwardPlusUtil::GetNumTilesX()
+    void ForwardPlusUtil::UpdateLightOrder( ID3D11DeviceContext* pd3dImmediateContext, unsigned uNumPointLights, unsigned uNumSpotLights, bool bSortLights )
     {
-        return (unsigned)( ( m_uWidth + TILE_RES - 1 ) / (float)TILE_RES );
+        unsigned uNumPointLightsToSort = bSortLights ? uNumPointLights : 0;
+        if( uNumPointLightsToSort != m_uNumPointLightsSorted )
+        {
+            // the lights that are no longer sorted need to go back to their original place too
+            unsigned uNumLightsToUpload = ( uNumPointLightsToSort > m_uNumPointLightsSorted ) ? uNumPointLightsToSort : m_uNumPointLightsSorted;
+            UpdateLightOrderArray( g_PointLightDataArrayCenterAndRadius, uNumPointLightsToSort, uNumLightsToUpload, g_PointLightOrder );
+
+            UploadLightArray( pd3dImmediateContext, m_pPointLightBufferCenterAndRadius, g_PointLightDataArrayCenterAndRadius, g_PointLightOrder, uNumLightsToUpload );
+            UploadLightArray( pd3dImmediateContext, m_pPointLightBufferColor, g_PointLightDataArrayColor, g_PointLightOrder, uNumLightsToUpload );
+            m_uNumPointLightsSorted = uNumPointLightsToSort;
+
+            // what was just uploaded is the rest state of the lights in their new slots
+            ResetLightAnimation( m_PointLightAnimator, 0, uNumLightsToUpload, false );
+            m_uLightGeneration++;
+        }
+
+        unsigned uNumSpotLightsToSort = bSortLights ? uNumSpotLights : 0;
+        if( uNumSpotLightsToSort != m_uNumSpotLightsSorted )
+        {
+            unsigned uNumLightsToUpload = ( uNumSpotLightsToSort > m_uNumSpotLightsSorted ) ? uNumSpotLightsToSort : m_uNumSpotLightsSorted;
+            UpdateLightOrderArray( g_SpotLightDataArrayCenterAndRadius, uNumSpotLightsToSort, uNumLightsToUpload, g_SpotLightOrder );
+
+            UploadLightArray( pd3dImmediateContext, m_pSpotLightBufferCenterAndRadius, g_SpotLightDataArrayCenterAndRadius, g_SpotLightOrder, uNumLightsToUpload );
+            UploadLightArray( pd3dImmediateContext, m_pSpotLightBufferColor, g_SpotLightDataArrayColor, g_SpotLightOrder, uNumLightsToUpload );
+            UploadLightArray( pd3dImmediateContext, m_pSpotLightBufferSpotParams, g_SpotLightDataArraySpotParams, g_SpotLightOrder, uNumLightsToUpload );
+            UploadLightArray( pd3dImmediateContext, m_pSpotLightBufferSpotMatrices, g_SpotLightDataArraySpotMatrices, g_SpotLightOrder, uNumLightsToUpload );
+            m_uNumSpotLightsSorted = uNumSpotLightsToSort;
+
+            ResetLightAnimation( m_SpotLightAnimator, 0, uNumLightsToUpload, true );
+            m_uLightGeneration++;
+        }
     }
 
     //--------------------------------------------------------------------------------------
-    // Calculate the number of tiles in the vertical direction
+    // Animate the active lights, and upload the ones that changed
     //--------------------------------------------------------------------------------------
-    unsigned ForwardPlusUtil::GetNumTilesY()
+    void ForwardPlusUtil::UpdateLights( ID3D11DeviceContext* pd3dImmediateContext, float fTime, unsigned uNumPointLights, unsigned uNumSpotLights, bool bAnimateLights )
+    {
+        if( !bAnimateLights )
+        {
+            return;
+        }
+
+        m_PointLightAnimator.Update( fTime, uNumPointLights, 0 );
+        m_SpotLightAnimator.Update( fTime, uNumSpotLights, 0 );
+
+        const std::vector<LightRange>& PointLightRanges = m_PointLightAnimator.GetDirtyRanges();
+        const std::vector<LightRange>& SpotLightRanges = m_SpotLightAnimator.GetDirtyRanges();
+        if( PointLightRanges.empty() && SpotLightRanges.empty() )
+        {
+            return;
+        }
+
+        // the staging buffer used LIGHT_UPLOAD_RING_SIZE-1 frames ago, which the GPU 
+        // should be done copying from by now
+        ID3D11Buffer* pStagingBuffer = m_pLightUploadRing[m_uLightUploadRingIndex];
+        m_uLightUploadRingIndex = ( m_uLightUploadRingIndex + 1 ) % LIGHT_UPLOAD_RING_SIZE;
+
+        D3D11_MAPPED_SUBRESOURCE MappedResource;
+        HRESULT hr = pd3dImmediateContext->Map( pStagingBuffer, 0, D3D11_MAP_WRITE, D3D11_MAP_FLAG_DO_NOT_WAIT, &MappedResource );
+        if( hr == DXGI_ERROR_WAS_STILL_DRAWING )
+        {
+            // it isn't, so wait for it (if this happens a lot, the ring is too small)
+            m_uNumLightUploadStalls++;
+            hr = pd3dImmediateContext->Map( pStagingBuffer, 0, D3D11_MAP_WRITE, 0, &MappedResource );
+        }
+        if( FAILED( hr ) )
+        {
+            return;
+        }
+
+        const unsigned uPointLightCenterOffset = 0;
+        const unsigned uPointLightColorOffset = uPointLightCenterOffset + g_uMaxNumLights*(unsigned)sizeof(XMFLOAT4);
+        const unsigned uSpotLightCenterOffset = uPointLightColorOffset + g_uMaxNumLights*(unsigned)sizeof(DWORD);
+        const unsigned uSpotLightColorOffset = uSpotLightCenterOffset + g_uMaxNumLights*(unsigned)sizeof(XMFLOAT4);
+
+        BYTE* pMappedData = (BYTE*)MappedResource.pData;
+        WriteLightRanges( pMappedData, uPointLightCenterOffset, m_PointLightAnimator.GetCenterAndRadius(), PointLightRanges );
+        WriteLightRanges( pMappedData, uPointLightColorOffset, m_PointLightAnimator.GetColors(), PointLightRanges );
+        WriteLightRanges( pMappedData, uSpotLightCenterOffset, m_SpotLightAnimator.GetCenterAndRadius(), SpotLightRanges );
+        WriteLightRanges( pMappedData, uSpotLightColorOffset, m_SpotLightAnimator.GetColors(), SpotLightRanges );
+        pd3dImmediateContext->Unmap( pStagingBuffer, 0 );
+
+        CopyLightRanges( pd3dImmediateContext, m_pPointLightBufferCenterAndRadius, pStagingBuffer, uPointLightCenterOffset, (unsigned)sizeof(XMFLOAT4), PointLightRanges );
+        CopyLightRanges( pd3dImmediateContext, m_pPointLightBufferColor, pStagingBuffer, uPointLightColorOffset, (unsigned)sizeof(DWORD), PointLightRanges );
+        CopyLightRanges( pd3dImmediateContext, m_pSpotLightBufferCenterAndRadius, pStagingBuffer, uSpotLightCenterOffset, (unsigned)sizeof(XMFLOAT4), SpotLightRanges );
+        CopyLightRanges( pd3dImmediateContext, m_pSpotLightBufferColor, pStagingBuffer, uSpotLightColorOffset, (unsigned)sizeof(DWORD), SpotLightRanges );
+        m_uLightGeneration++;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Cull the active lights against the camera frustum, and upload the visible ones
+    //--------------------------------------------------------------------------------------
+    void ForwardPlusUtil::UpdateVisibleLights( ID3D11DeviceContext* pd3dImmediateContext, const XMMATRIX& mWorldViewProjection, 
+                                               unsigned uNumPointLights, unsigned uNumSpotLights, bool bFrustumPreCull )
     {
-        return (unsigned)( ( m_uHeight + TILE_RES - 1 ) / (float)TILE_RES );
+        if( !bFrustumPreCull )
+        {
+            // the lists that were built from the visible lights are no good for the others
+            if( m_bFrustumPreCull )
+            {
+                m_uLightGeneration++;
+            }
+            m_bFrustumPreCull = false;
+            m_uNumVisiblePointLights = uNumPointLights;
+            m_uNumVisibleSpotLights = uNumSpotLights;
+            return;
+        }
+
+        XMFLOAT4X4 f4x4WorldViewProjection;
+        XMStoreFloat4x4( &f4x4WorldViewProjection, mWorldViewProjection );
+        if( m_bFrustumPreCull && m_uVisibleLightsGeneration == m_uLightGeneration && 
+            m_uVisibleLightsNumPointLights == uNumPointLights && m_uVisibleLightsNumSpotLights == uNumSpotLights &&
+            memcmp( &m_mVisibleLightsWorldViewProjection, &f4x4WorldViewProjection, sizeof(XMFLOAT4X4) ) == 0 )
+        {
+            return;
+        }
+
+        // the lights are in world space, and the animators hold what is in the light buffers
+        XMFLOAT4 Planes[NUM_FRUSTUM_PLANES];
+        AMD::ExtractPlanesFromFrustum( Planes, &mWorldViewProjection );
+        m_uNumVisiblePointLights = CullLightsToFrustum( Planes, m_PointLightAnimator.GetCenterAndRadius(), uNumPointLights, &m_VisiblePointLights[0] );
+        m_uNumVisibleSpotLights = CullLightsToFrustum( Planes, m_SpotLightAnimator.GetCenterAndRadius(), uNumSpotLights, &m_VisibleSpotLights[0] );
+
+        UploadVisibleLights( pd3dImmediateContext, m_pVisiblePointLightBufferCenterAndRadius, m_PointLightAnimator.GetCenterAndRadius(), &m_VisiblePointLights[0], m_uNumVisiblePointLights );
+        UploadVisibleLights( pd3dImmediateContext, m_pVisiblePointLightBufferColor, m_PointLightAnimator.GetColors(), &m_VisiblePointLights[0], m_uNumVisiblePointLights );
+        UploadVisibleLights( pd3dImmediateContext, m_pVisibleSpotLightBufferCenterAndRadius, m_SpotLightAnimator.GetCenterAndRadius(), &m_VisibleSpotLights[0], m_uNumVisibleSpotLights );
+        UploadVisibleLights( pd3dImmediateContext, m_pVisibleSpotLightBufferColor, m_SpotLightAnimator.GetColors(), &m_VisibleSpotLights[0], m_uNumVisibleSpotLights );
+
+        // the spot parameters are not animated, so they come from the arrays InitLights created
+        std::vector<unsigned> VisibleSpotLightsInitOrder( m_uNumVisibleSpotLights + 1 );
+        for( unsigned i = 0; i < m_uNumVisibleSpotLights; i++ )
+        {
+            VisibleSpotLightsInitOrder[i] = g_SpotLightOrder[m_VisibleSpotLights[i]];
+        }
+        UploadVisibleLights( pd3dImmediateContext, m_pVisibleSpotLightBufferSpotParams, &g_SpotLightDataArraySpotParams[0], &VisibleSpotLightsInitOrder[0], m_uNumVisibleSpotLights );
+
+        m_bFrustumPreCull = true;
+        m_uLightGeneration++;
+        m_uVisibleLightsGeneration = m_uLightGeneration;
+        m_uVisibleLightsNumPointLights = uNumPointLights;
+        m_uVisibleLightsNumSpotLights = uNumSpotLights;
+        m_mVisibleLightsWorldViewProjection = f4x4WorldViewProjection;
     }
 
     //--------------------------------------------------------------------------------------
-    // Adjust max number of lights per tile based on screen height.
-    // This assumes that the demo has a constant vertical field of view (fovy).
-    //
-    // Note that the light culling tile size stays fixed as screen size changes.
-    // With a constant fovy, reducing the screen height shrinks the projected 
-    // view of the scene, and so more lights can fall into our fixed tile size.
-    //
-    // This function reduces the max lights per tile as screen height increases, 
-    // to save memory. It was tuned for this particular demo and is not intended 
-    // as a general solution for all scenes.
+    // Pack the lights the shading reads into the packed light buffers
     //--------------------------------------------------------------------------------------
-    unsigned ForwardPlusUtil::GetMaxNumLightsPerTile()
+    void ForwardPlusUtil::UpdatePackedLights( ID3D11DeviceContext* pd3dImmediateContext, bool bPackedLights )
     {
-        const unsigned kAdjustmentMultipier = 32;
+        if( !bPackedLights )
+        {
+            m_bPackedLights = false;
+            return;
+        }
 
-        // I haven't tested at greater than 1080p, so cap it
-        unsigned uHeight = (m_uHeight > 1080) ? 1080 : m_uHeight;
+        if( m_bPackedLights && m_uPackedLightsGeneration == m_uLightGeneration && 
+            m_uNumPackedPointLights == m_uNumVisiblePointLights && m_uNumPackedSpotLights == m_uNumVisibleSpotLights )
+        {
+            return;
+        }
 
-        // adjust max lights per tile down as height increases
-        return ( MAX_NUM_LIGHTS_PER_TILE - ( kAdjustmentMultipier * ( uHeight / 120 ) ) );
+        // the animators hold what is in the light buffers, and the remap tables 
+        // pick the visible lights out of them
+        const unsigned* pVisiblePointLights = m_bFrustumPreCull ? &m_VisiblePointLights[0] : NULL;
+        const unsigned* pVisibleSpotLights = m_bFrustumPreCull ? &m_VisibleSpotLights[0] : NULL;
+        D3D11_MAPPED_SUBRESOURCE MappedResource;
+        if( SUCCEEDED( pd3dImmediateContext->Map( m_pPackedPointLightBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource ) ) )
+        {
+            PackLights( g_PackedLightBounds, m_PointLightAnimator.GetCenterAndRadius(), m_PointLightAnimator.GetColors(), 
+                        pVisiblePointLights, m_uNumVisiblePointLights, (PackedLight*)MappedResource.pData );
+            pd3dImmediateContext->Unmap( m_pPackedPointLightBuffer, 0 );
+        }
+        if( SUCCEEDED( pd3dImmediateContext->Map( m_pPackedSpotLightBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource ) ) )
+        {
+            PackLights( g_PackedLightBounds, m_SpotLightAnimator.GetCenterAndRadius(), m_SpotLightAnimator.GetColors(), 
+                        pVisibleSpotLights, m_uNumVisibleSpotLights, (PackedLight*)MappedResource.pData );
+            pd3dImmediateContext->Unmap( m_pPackedSpotLightBuffer, 0 );
+        }
+
+        m_bPackedLights = true;
+        m_uPackedLightsGeneration = m_uLightGeneration;
+        m_uNumPackedPointLights = m_uNumVisiblePointLights;
+        m_uNumPackedSpotLights = m_uNumVisibleSpotLights;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Queue this frame's light list statistics for reading back, 
+    // and pick up the ones from LIGHT_CULL_STATS_READBACK_RING_SIZE frames ago
+    //--------------------------------------------------------------------------------------
+    void ForwardPlusUtil::ReadBackLightCullStats( ID3D11DeviceContext* pd3dImmediateContext, bool bPerTileLists )
+    {
+        ID3D11Buffer* pStagingBuffer = m_pLightCullStatsReadbackRing[m_uLightCullStatsReadbackRingIndex];
+        bool& bPending = m_bLightCullStatsReadbackPending[m_uLightCullStatsReadbackRingIndex];
+        bool& bPerTile = m_bLightCullStatsPerTile[m_uLightCullStatsReadbackRingIndex];
+        m_uLightCullStatsReadbackRingIndex = ( m_uLightCullStatsReadbackRingIndex + 1 ) % LIGHT_CULL_STATS_READBACK_RING_SIZE;
+
+        // the oldest staging buffer, which the GPU should be done copying to by now 
+        // (if it isn't, those statistics are dropped rather than waited for)
+        if( bPending )
+        {
+            D3D11_MAPPED_SUBRESOURCE MappedResource;
+            if( SUCCEEDED( pd3dImmediateContext->Map( pStagingBuffer, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &MappedResource ) ) )
+            {
+                CalculateLightCullStats( (const unsigned*)MappedResource.pData, &m_LightCullStats );
+                pd3dImmediateContext->Unmap( pStagingBuffer, 0 );
+
+                // the light index buffer gets resized in UpdateMaxNumLightsPerTile
+                if( bPerTile )
+                {
+                    m_LightListCapacitySizer.Update( m_LightCullStats );
+                }
+            }
+        }
+
+        pd3dImmediateContext->CopyResource( pStagingBuffer, m_pLightCullStatsBuffer );
+        bPending = true;
+        bPerTile = bPerTileLists;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Set light buffer elements [uBegin,uEnd) of an animator to the rest state of the 
+    // lights in them, with each light keeping its animation wherever it is in the buffer
+    //--------------------------------------------------------------------------------------
+    void ForwardPlusUtil::ResetLightAnimation( LightAnimator& Animator, unsigned uBegin, unsigned uEnd, bool bSpotLights )
+    {
+        const std::vector<XMFLOAT4>& CenterAndRadius = bSpotLights ? g_SpotLightDataArrayCenterAndRadius : g_PointLightDataArrayCenterAndRadius;
+        const std::vector<DWORD>& Color = bSpotLights ? g_SpotLightDataArrayColor : g_PointLightDataArrayColor;
+        const std::vector<unsigned>& Order = bSpotLights ? g_SpotLightOrder : g_PointLightOrder;
+
+        // spot lights get different animations than the point lights with the same index
+        unsigned uSeedOffset = bSpotLights ? g_uMaxNumLights : 0;
+
+        for( unsigned i = uBegin; i < uEnd; i++ )
+        {
+            unsigned uLightIdx = Order[i];
+            Animator.SetLight( i, CenterAndRadius[uLightIdx], Color[uLightIdx], uSeedOffset + uLightIdx, 0.5f*CenterAndRadius[uLightIdx].w );
+        }
+    }
+
+    //--------------------------------------------------------------------------------------
+    // The light capacity (of the point lights and of the spot lights, each)
+    //--------------------------------------------------------------------------------------
+    unsigned ForwardPlusUtil::GetMaxNumLights()
+    {
+        return g_uMaxNumLights;
+    }
+
+    const PackedLightBounds& ForwardPlusUtil::GetPackedLightBounds()
+    {
+        return g_PackedLightBounds;
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Calculate the number of tiles in the horizontal direction
+    //--------------------------------------------------------------------------------------
+    unsigned ForwardPlusUtil::GetNumTilesX()
+    {
+        return (unsigned)( ( m_uWidth + m_uTileRes - 1 ) / (float)m_uTileRes );
+    }
+
+    //--------------------------------------------------------------------------------------
+    // Calculate the number of tiles in the vertical direction
+    //--------------------------------------------------------------------------------------
+    unsigned ForwardPlusUtil::GetNumTilesY()
+    {
+        return (unsigned)( ( m_uHeight + m_uTileRes - 1 ) / (float)m_uTileRes );
     }
 
 } // namespace ForwardPlus11
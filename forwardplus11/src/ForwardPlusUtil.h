@@ -30,6 +30,10 @@
 
 #include "..\\..\\DXUT\\Core\\DXUT.h"
 
+#include "ForwardPlusCpuCuller.h"
+#include "ForwardPlusLightAnimation.h"
+#include "ForwardPlusLightPacking.h"
+
 // Forward declarations
 namespace AMD
 {
@@ -40,7 +44,17 @@ class CDXUTTextHelper;
 
 namespace ForwardPlus11
 {
-    static const int MAX_NUM_LIGHTS = 2*1024;
+    // Light capacity (the number of point lights, and separately the number of spot lights,
+    // the light buffers have room for). It is a runtime parameter, see InitLights.
+    static const unsigned DEFAULT_MAX_NUM_LIGHTS = 2*1024;
+    static const unsigned MAX_NUM_LIGHTS_LIMIT = 1024*1024;
+
+    // Number of staging buffers the animated lights cycle through on their way to the GPU
+    static const unsigned LIGHT_UPLOAD_RING_SIZE = 3;
+
+    // Number of staging buffers the light list statistics cycle through on their way back 
+    // (so they are read LIGHT_CULL_STATS_READBACK_RING_SIZE frames after the culling)
+    static const unsigned LIGHT_CULL_STATS_READBACK_RING_SIZE = 3;
 
     class ForwardPlusUtil
     {
@@ -50,11 +64,12 @@ namespace ForwardPlus11
         ~ForwardPlusUtil();
 
         static void CalculateSceneMinMax( CDXUTSDKMesh &Mesh, DirectX::XMVECTOR *pBBoxMinOut, DirectX::XMVECTOR *pBBoxMaxOut );
-        static void InitLights( const DirectX::XMVECTOR &BBoxMin, const DirectX::XMVECTOR &BBoxMax );
+        static void InitLights( const DirectX::XMVECTOR &BBoxMin, const DirectX::XMVECTOR &BBoxMax, unsigned uMaxNumLights );
+        static unsigned GetMaxNumLights();
 
         void AddShadersToCache( AMD::ShaderCache *pShaderCache );
 
-        void RenderLegend( CDXUTTextHelper *pTxtHelper, int nLineHeight, DirectX::XMFLOAT4 Color, bool bGrayscaleMode );
+        void RenderLegend( CDXUTTextHelper *pTxtHelper, int nLineHeight, DirectX::XMFLOAT4 Color, bool bGrayscaleMode, bool bClusteredMode );
 
         // Various hook functions
         HRESULT OnCreateDevice( ID3D11Device* pd3dDevice );
@@ -63,31 +78,151 @@ namespace ForwardPlus11
         void OnReleasingSwapChain();
         void OnRender( float fElapsedTime, unsigned uNumPointLights, unsigned uNumSpotLights );
 
+        // With bSortLights, the active lights (the first uNumPointLights point lights and the
+        // first uNumSpotLights spot lights) are ordered along a Morton curve in the light 
+        // buffers (see ForwardPlusLightSort.h), so that the indices in each list are close 
+        // together. The inactive lights stay in the order InitLights created them in, so that 
+        // changing the counts still adds or removes lights all over the scene. Lights are only 
+        // re-sorted and re-uploaded when the counts (or bSortLights) change.
+        void UpdateLightOrder( ID3D11DeviceContext* pd3dImmediateContext, unsigned uNumPointLights, unsigned uNumSpotLights, bool bSortLights );
+
+        // With bAnimateLights, the active lights are animated to time fTime (see 
+        // ForwardPlusLightAnimation.h), and the lights that changed are written to the next 
+        // staging buffer of a ring of LIGHT_UPLOAD_RING_SIZE, and copied from there into the 
+        // light buffers. Without it, the lights stay where they are. Call after UpdateLightOrder.
+        void UpdateLights( ID3D11DeviceContext* pd3dImmediateContext, float fTime, unsigned uNumPointLights, unsigned uNumSpotLights, bool bAnimateLights );
+
+        // Number of UpdateLights calls that had to wait for the GPU to be done with a staging buffer
+        unsigned GetNumLightUploadStalls() const { return m_uNumLightUploadStalls; }
+
+        // Change counters, for skipping light culling when its inputs are the same as last time.
+        // The light generation changes whenever lights are written to the light buffers (by 
+        // OnCreateDevice, UpdateLightOrder and UpdateLights), and the light index buffer 
+        // generation whenever the light index buffers are recreated (which loses the lists).
+        unsigned GetLightGeneration() const { return m_uLightGeneration; }
+        unsigned GetLightIndexBufferGeneration() const { return m_uLightIndexBufferGeneration; }
+
+        // Frustum pre-cull (see ForwardPlusLightFrustumCull.h). With bFrustumPreCull, the active 
+        // lights the camera can see (with mWorldViewProjection) are compacted into the visible 
+        // light buffers, which the light buffer SRV getters below then return, so that light 
+        // culling and shading only loop over GetNumVisiblePointLights and GetNumVisibleSpotLights 
+        // lights (without it, those are all the active lights). They are only culled again when 
+        // the matrix or the lights changed. The debug drawing of the lights still draws all of 
+        // them. Call after UpdateLights.
+        void UpdateVisibleLights( ID3D11DeviceContext* pd3dImmediateContext, const DirectX::XMMATRIX& mWorldViewProjection, 
+                                  unsigned uNumPointLights, unsigned uNumSpotLights, bool bFrustumPreCull );
+        unsigned GetNumVisiblePointLights() const { return m_uNumVisiblePointLights; }
+        unsigned GetNumVisibleSpotLights() const { return m_uNumVisibleSpotLights; }
+
+        // Packed light buffers (see ForwardPlusLightPacking.h). With bPackedLights, the lights 
+        // the light buffer SRV getters return (the visible ones with the frustum pre-cull) are 
+        // packed into the packed light buffers, for the USE_PACKED_LIGHTS permutations of 
+        // RenderScenePS, whenever they changed. Culling still uses the full-precision buffers. 
+        // The packed positions are relative to GetPackedLightBounds, which InitLights derives 
+        // from the scene AABB. Call after UpdateVisibleLights.
+        void UpdatePackedLights( ID3D11DeviceContext* pd3dImmediateContext, bool bPackedLights );
+        static const PackedLightBounds& GetPackedLightBounds();
+        ID3D11ShaderResourceView * const * GetPackedPointLightBufferSRVParam() { return &m_pPackedPointLightBufferSRV; }
+        ID3D11ShaderResourceView * const * GetPackedSpotLightBufferSRVParam() { return &m_pPackedSpotLightBufferSRV; }
+
         unsigned GetNumTilesX();
         unsigned GetNumTilesY();
-        unsigned GetMaxNumLightsPerTile();
+        // Capacity of the fixed list slots of the light index buffer, picked from the 
+        // measured list lengths (see LightListCapacitySizer), starting from a guess 
+        // (GetInitialMaxNumLightsPerTile) whenever the screen or tile size changes
+        unsigned GetMaxNumLightsPerTile() const { return m_uMaxNumLightsPerTile; }
+        const LightListCapacitySizer& GetLightListCapacitySizer() const { return m_LightListCapacitySizer; }
+
+        // Recreate the light index buffer if the measurements asked for a different 
+        // GetMaxNumLightsPerTile. Call at the start of the frame, before it goes into 
+        // the constant buffer.
+        HRESULT UpdateMaxNumLightsPerTile( ID3D11Device* pd3dDevice );
+
+        // Light culling tile size, one of the GetTileRes sizes (see ForwardPlusCpuCuller.h). 
+        // The light index buffers are recreated for the new size right away if the swap 
+        // chain exists already, otherwise in OnResizedSwapChain (pass NULL for pd3dDevice 
+        // in that case). The app needs to switch to the matching shader permutations.
+        HRESULT SetTileRes( ID3D11Device* pd3dDevice, unsigned uTileRes );
+        unsigned GetTileRes() const { return m_uTileRes; }
+
+        // Clustered light culling. The cluster light index buffer is (re)created 
+        // for the new config right away if the swap chain exists already, otherwise 
+        // in OnResizedSwapChain (pass NULL for pd3dDevice in that case)
+        HRESULT SetClusterConfig( ID3D11Device* pd3dDevice, const ClusterConfig& Config );
+        const ClusterConfig& GetClusterConfig() const { return m_ClusterConfig; }
 
-        ID3D11ShaderResourceView * const * GetPointLightBufferCenterAndRadiusSRVParam() { return &m_pPointLightBufferCenterAndRadiusSRV; }
-        ID3D11ShaderResourceView * const * GetPointLightBufferColorSRVParam()  { return &m_pPointLightBufferColorSRV; }
-        ID3D11ShaderResourceView * const * GetSpotLightBufferCenterAndRadiusSRVParam() { return &m_pSpotLightBufferCenterAndRadiusSRV; }
-        ID3D11ShaderResourceView * const * GetSpotLightBufferColorSRVParam()  { return &m_pSpotLightBufferColorSRV; }
-        ID3D11ShaderResourceView * const * GetSpotLightBufferSpotParamsSRVParam()  { return &m_pSpotLightBufferSpotParamsSRV; }
+        ID3D11ShaderResourceView * const * GetPointLightBufferCenterAndRadiusSRVParam() { return m_bFrustumPreCull ? &m_pVisiblePointLightBufferCenterAndRadiusSRV : &m_pPointLightBufferCenterAndRadiusSRV; }
+        ID3D11ShaderResourceView * const * GetPointLightBufferColorSRVParam()  { return m_bFrustumPreCull ? &m_pVisiblePointLightBufferColorSRV : &m_pPointLightBufferColorSRV; }
+        ID3D11ShaderResourceView * const * GetSpotLightBufferCenterAndRadiusSRVParam() { return m_bFrustumPreCull ? &m_pVisibleSpotLightBufferCenterAndRadiusSRV : &m_pSpotLightBufferCenterAndRadiusSRV; }
+        ID3D11ShaderResourceView * const * GetSpotLightBufferColorSRVParam()  { return m_bFrustumPreCull ? &m_pVisibleSpotLightBufferColorSRV : &m_pSpotLightBufferColorSRV; }
+        ID3D11ShaderResourceView * const * GetSpotLightBufferSpotParamsSRVParam()  { return m_bFrustumPreCull ? &m_pVisibleSpotLightBufferSpotParamsSRV : &m_pSpotLightBufferSpotParamsSRV; }
         ID3D11ShaderResourceView * const * GetSpotLightBufferSpotMatricesSRVParam()  { return &m_pSpotLightBufferSpotMatricesSRV; }
 
         ID3D11ShaderResourceView * const * GetLightIndexBufferSRVParam() { return &m_pLightIndexBufferSRV; }
         ID3D11UnorderedAccessView * const * GetLightIndexBufferUAVParam() { return &m_pLightIndexBufferUAV; }
 
+        // Compact light lists (see ForwardPlusCompactLists.h). The counter UAV only covers 
+        // the allocation counter, so that it can be cleared without touching the rest.
+        ID3D11ShaderResourceView * const * GetCompactLightIndexBufferSRVParam() { return &m_pCompactLightIndexBufferSRV; }
+        ID3D11UnorderedAccessView * const * GetCompactLightIndexBufferUAVParam() { return &m_pCompactLightIndexBufferUAV; }
+        ID3D11UnorderedAccessView * GetCompactLightIndexCounterUAV() { return m_pCompactLightIndexCounterUAV; }
+
+        ID3D11ShaderResourceView * const * GetClusterLightIndexBufferSRVParam() { return &m_pClusterLightIndexBufferSRV; }
+        ID3D11UnorderedAccessView * const * GetClusterLightIndexBufferUAVParam() { return &m_pClusterLightIndexBufferUAV; }
+
+        // Two-level culling: the lists of the coarse tiles (COARSE_TILE_RES pixels square, 
+        // MAX_NUM_LIGHTS_PER_COARSE_TILE entries each), written by CullLightsCoarseCS and 
+        // read by the USE_COARSE_TILES permutations of CullLightsCS. A coarse tile is always
+        // the same pixels, whatever the tile size, so there are the same number of them.
+        unsigned GetNumCoarseTilesX() const { return ( m_uWidth + COARSE_TILE_RES - 1 ) / COARSE_TILE_RES; }
+        unsigned GetNumCoarseTilesY() const { return ( m_uHeight + COARSE_TILE_RES - 1 ) / COARSE_TILE_RES; }
+        ID3D11ShaderResourceView * const * GetCoarseLightIndexBufferSRVParam() { return &m_pCoarseLightIndexBufferSRV; }
+        ID3D11UnorderedAccessView * const * GetCoarseLightIndexBufferUAVParam() { return &m_pCoarseLightIndexBufferUAV; }
+
+        // Light list statistics (see ForwardPlusLightCullStats.h). Clear the UAV to 0 and bind 
+        // it next to the light index buffer for culling, then call ReadBackLightCullStats. 
+        // That copies them to the next staging buffer of a ring of LIGHT_CULL_STATS_READBACK_RING_SIZE, 
+        // and GetLightCullStats returns the ones that came back from the oldest staging buffer 
+        // (without waiting for the GPU, so a frame's statistics are skipped if they are not ready).
+        // Statistics of per-tile lists (bPerTileLists, i.e. not clustered) also size the light 
+        // index buffer (see GetMaxNumLightsPerTile).
+        ID3D11UnorderedAccessView * const * GetLightCullStatsUAVParam() { return &m_pLightCullStatsUAV; }
+        void ReadBackLightCullStats( ID3D11DeviceContext* pd3dImmediateContext, bool bPerTileLists );
+        const LightCullStats& GetLightCullStats() const { return m_LightCullStats; }
+
+        // Hi-Z depth pyramid (see ForwardPlusHiZ.h), a texture per level, with the min and 
+        // max stored depth of each texel in R and G. BuildHiZ builds all levels from the 
+        // depth buffer in one dispatch (so the depth buffer must not be bound for output), 
+        // and GetHiZSRVParam returns the level with a texel per tile of the given size, 
+        // for the Hi-Z permutations of the light culling shaders.
+        void BuildHiZ( ID3D11DeviceContext* pd3dImmediateContext, ID3D11ShaderResourceView* pDepthSRV, bool bMSAA );
+        ID3D11ShaderResourceView * const * GetHiZSRVParam( unsigned uTileRes ) { return &m_pHiZSRV[GetHiZLevel( uTileRes ) - HIZ_FIRST_LEVEL]; }
+
     private:
 
-        // Light culling constants.
-        // These must match their counterparts in ForwardPlus11Common.hlsl
-        static const unsigned TILE_RES = 16;
-        static const unsigned MAX_NUM_LIGHTS_PER_TILE = 544;
+        void ResetMaxNumLightsPerTile();
+        HRESULT CreateLightIndexBuffer( ID3D11Device* pd3dDevice );
+        HRESULT CreateCompactLightIndexBuffer( ID3D11Device* pd3dDevice );
+        HRESULT CreateClusterLightIndexBuffer( ID3D11Device* pd3dDevice );
+        HRESULT CreateCoarseLightIndexBuffer( ID3D11Device* pd3dDevice );
+        HRESULT CreateHiZTextures( ID3D11Device* pd3dDevice );
+        void ResetLightAnimation( LightAnimator& Animator, unsigned uBegin, unsigned uEnd, bool bSpotLights );
 
         // forward rendering render target width and height
         unsigned                    m_uWidth;
         unsigned                    m_uHeight;
 
+        // light culling tile size (in pixels)
+        unsigned                    m_uTileRes;
+
+        // capacity of the lists in the light index buffer, and what picks it
+        unsigned                    m_uMaxNumLightsPerTile;
+        LightListCapacitySizer      m_LightListCapacitySizer;
+
+        // how many lights at the start of the light buffers are in Morton order
+        unsigned                    m_uNumPointLightsSorted;
+        unsigned                    m_uNumSpotLightsSorted;
+
         // point lights
         ID3D11Buffer*               m_pPointLightBufferCenterAndRadius;
         ID3D11ShaderResourceView*   m_pPointLightBufferCenterAndRadiusSRV;
@@ -106,11 +241,90 @@ namespace ForwardPlus11
         ID3D11Buffer*               m_pSpotLightBufferSpotMatrices;
         ID3D11ShaderResourceView*   m_pSpotLightBufferSpotMatricesSRV;
 
+        // light animation, in light buffer order (element i animates light buffer element i)
+        LightAnimator               m_PointLightAnimator;
+        LightAnimator               m_SpotLightAnimator;
+
+        // staging buffers for uploading the animated lights, each laid out as point light 
+        // centers, point light colors, spot light centers, spot light colors (g_uMaxNumLights each)
+        ID3D11Buffer*               m_pLightUploadRing[LIGHT_UPLOAD_RING_SIZE];
+        unsigned                    m_uLightUploadRingIndex;
+        unsigned                    m_uNumLightUploadStalls;
+
+        // frustum pre-cull: the remap tables (visible light i is light buffer element 
+        // m_VisiblePointLights[i]), what they were built from, and the compacted lights
+        bool                        m_bFrustumPreCull;
+        unsigned                    m_uNumVisiblePointLights;
+        unsigned                    m_uNumVisibleSpotLights;
+        std::vector<unsigned>       m_VisiblePointLights;
+        std::vector<unsigned>       m_VisibleSpotLights;
+        DirectX::XMFLOAT4X4         m_mVisibleLightsWorldViewProjection;
+        unsigned                    m_uVisibleLightsGeneration;
+        unsigned                    m_uVisibleLightsNumPointLights;
+        unsigned                    m_uVisibleLightsNumSpotLights;
+        ID3D11Buffer*               m_pVisiblePointLightBufferCenterAndRadius;
+        ID3D11ShaderResourceView*   m_pVisiblePointLightBufferCenterAndRadiusSRV;
+        ID3D11Buffer*               m_pVisiblePointLightBufferColor;
+        ID3D11ShaderResourceView*   m_pVisiblePointLightBufferColorSRV;
+        ID3D11Buffer*               m_pVisibleSpotLightBufferCenterAndRadius;
+        ID3D11ShaderResourceView*   m_pVisibleSpotLightBufferCenterAndRadiusSRV;
+        ID3D11Buffer*               m_pVisibleSpotLightBufferColor;
+        ID3D11ShaderResourceView*   m_pVisibleSpotLightBufferColorSRV;
+        ID3D11Buffer*               m_pVisibleSpotLightBufferSpotParams;
+        ID3D11ShaderResourceView*   m_pVisibleSpotLightBufferSpotParamsSRV;
+
+        // packed light buffers, and what they were packed from
+        bool                        m_bPackedLights;
+        unsigned                    m_uPackedLightsGeneration;
+        unsigned                    m_uNumPackedPointLights;
+        unsigned                    m_uNumPackedSpotLights;
+        ID3D11Buffer*               m_pPackedPointLightBuffer;
+        ID3D11ShaderResourceView*   m_pPackedPointLightBufferSRV;
+        ID3D11Buffer*               m_pPackedSpotLightBuffer;
+        ID3D11ShaderResourceView*   m_pPackedSpotLightBufferSRV;
+
+        // change counters (see GetLightGeneration)
+        unsigned                    m_uLightGeneration;
+        unsigned                    m_uLightIndexBufferGeneration;
+
         // buffers for light culling
         ID3D11Buffer*               m_pLightIndexBuffer;
         ID3D11ShaderResourceView*   m_pLightIndexBufferSRV;
         ID3D11UnorderedAccessView*  m_pLightIndexBufferUAV;
 
+        // buffers for light culling with compact lists (headers plus one dense array)
+        ID3D11Buffer*               m_pCompactLightIndexBuffer;
+        ID3D11ShaderResourceView*   m_pCompactLightIndexBufferSRV;
+        ID3D11UnorderedAccessView*  m_pCompactLightIndexBufferUAV;
+        ID3D11UnorderedAccessView*  m_pCompactLightIndexCounterUAV;
+
+        // buffers for clustered light culling (one list per tile per depth slice)
+        ClusterConfig               m_ClusterConfig;
+        ID3D11Buffer*               m_pClusterLightIndexBuffer;
+        ID3D11ShaderResourceView*   m_pClusterLightIndexBufferSRV;
+        ID3D11UnorderedAccessView*  m_pClusterLightIndexBufferUAV;
+
+        // buffer for the lists of the coarse tiles (two-level culling)
+        ID3D11Buffer*               m_pCoarseLightIndexBuffer;
+        ID3D11ShaderResourceView*   m_pCoarseLightIndexBufferSRV;
+        ID3D11UnorderedAccessView*  m_pCoarseLightIndexBufferUAV;
+
+        // light list statistics, and the staging buffers for reading them back
+        ID3D11Buffer*               m_pLightCullStatsBuffer;
+        ID3D11UnorderedAccessView*  m_pLightCullStatsUAV;
+        ID3D11Buffer*               m_pLightCullStatsReadbackRing[LIGHT_CULL_STATS_READBACK_RING_SIZE];
+        bool                        m_bLightCullStatsReadbackPending[LIGHT_CULL_STATS_READBACK_RING_SIZE];
+        bool                        m_bLightCullStatsPerTile[LIGHT_CULL_STATS_READBACK_RING_SIZE];
+        unsigned                    m_uLightCullStatsReadbackRingIndex;
+        LightCullStats              m_LightCullStats;
+
+        // Hi-Z depth pyramid (a texture per level), and the shaders that build it
+        ID3D11Texture2D*            m_pHiZTexture[HIZ_NUM_LEVELS];
+        ID3D11ShaderResourceView*   m_pHiZSRV[HIZ_NUM_LEVELS];
+        ID3D11UnorderedAccessView*  m_pHiZUAV[HIZ_NUM_LEVELS];
+        ID3D11ComputeShader*        m_pBuildHiZCS;
+        ID3D11ComputeShader*        m_pBuildHiZCSMSAA;
+
         // sprite quad VB (for debug drawing the lights)
         ID3D11Buffer*               m_pQuadForLightsVB;
 
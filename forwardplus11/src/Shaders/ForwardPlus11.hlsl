@@ -39,10 +39,16 @@ SamplerState g_Sampler   : register( s0 );
 
 // Save two slots for CDXUTSDKMesh diffuse and normal, 
 // so start with the third slot, t2
+#if ( USE_PACKED_LIGHTS == 1 )
+// center, radius and color in one buffer (see ForwardPlusLightPacking.h)
+Buffer<uint3>  g_PointLightBufferPacked          : register( t2 );
+Buffer<uint3>  g_SpotLightBufferPacked           : register( t4 );
+#else
 Buffer<float4> g_PointLightBufferCenterAndRadius : register( t2 );
 Buffer<float4> g_PointLightBufferColor           : register( t3 );
 Buffer<float4> g_SpotLightBufferCenterAndRadius  : register( t4 );
 Buffer<float4> g_SpotLightBufferColor            : register( t5 );
+#endif
 Buffer<float4> g_SpotLightBufferSpotParams       : register( t6 );
 Buffer<uint>   g_PerTileLightIndexBuffer         : register( t7 );
 
@@ -77,6 +83,22 @@ struct VS_OUTPUT_POSITION_AND_TEX
     float2 TextureUV    : TEXCOORD0;   // vertex texture coords
 };
 
+//--------------------------------------------------------------------------------------
+// Packed lights (see ForwardPlusLightPacking.h): the center is 16-bit unorm across 
+// the bounds, the radius a half, and the color RGB9E5
+//--------------------------------------------------------------------------------------
+float4 UnpackLightCenterAndRadius( uint3 PackedLight )
+{
+    float3 vSteps = float3( PackedLight.x & 0xFFFF, PackedLight.x >> 16, PackedLight.y & 0xFFFF );
+    return float4( g_vPackedLightOrigin + vSteps*g_vPackedLightScale, f16tof32( PackedLight.y >> 16 ) );
+}
+
+float3 UnpackLightColor( uint3 PackedLight )
+{
+    float fStep = exp2( (float)( PackedLight.z >> 27 ) - 15 - 9 );
+    return float3( PackedLight.z & 0x1FF, ( PackedLight.z >> 9 ) & 0x1FF, ( PackedLight.z >> 18 ) & 0x1FF ) * fStep;
+}
+
 //--------------------------------------------------------------------------------------
 // This shader just transforms position (e.g. for depth pre-pass)
 //--------------------------------------------------------------------------------------
@@ -173,12 +195,20 @@ float4 RenderScenePS( VS_OUTPUT_SCENE Input ) : SV_TARGET
     float3 vViewDir = normalize( g_vCameraPos - vPositionWS );
 
 #if ( USE_LIGHT_CULLING == 1 )
+#if ( USE_CLUSTERED_LIGHTING == 1 )
+    uint nClusterIndex = GetClusterIndex(Input.Position.xy, ConvertProjDepthToView(Input.Position.z));
+    uint nIndex = g_uMaxNumLightsPerCluster*nClusterIndex;
+#elif ( USE_COMPACT_LIGHT_LISTS == 1 )
+    uint nTileIndex = GetTileIndex(Input.Position.xy);
+    uint nIndex = g_PerTileLightIndexBuffer[GetCompactListHeaderIndex(nTileIndex)];
+#else
     uint nTileIndex = GetTileIndex(Input.Position.xy);
     uint nIndex = g_uMaxNumLightsPerTile*nTileIndex;
+#endif
     uint nNextLightIndex = g_PerTileLightIndexBuffer[nIndex];
 #else
     uint nIndex;
-    uint nNumPointLights = g_uNumLights & 0xFFFFu;
+    uint nNumPointLights = g_uNumPointLights;
 #endif
 
     // loop over the point lights
@@ -197,7 +227,14 @@ float4 RenderScenePS( VS_OUTPUT_SCENE Input ) : SV_TARGET
 #else
         uint nLightIndex = nIndex;
 #endif
+#if ( USE_PACKED_LIGHTS == 1 )
+        uint3 PackedLight = g_PointLightBufferPacked[nLightIndex];
+        float4 CenterAndRadius = UnpackLightCenterAndRadius( PackedLight );
+        float3 LightColor = UnpackLightColor( PackedLight );
+#else
         float4 CenterAndRadius = g_PointLightBufferCenterAndRadius[nLightIndex];
+        float3 LightColor = g_PointLightBufferColor[nLightIndex].rgb;
+#endif
 
         float3 vToLight = CenterAndRadius.xyz - vPositionWS.xyz;
         float3 vLightDir = normalize(vToLight);
@@ -214,10 +251,10 @@ float4 RenderScenePS( VS_OUTPUT_SCENE Input ) : SV_TARGET
             // -(1/k)*(1-(k+1)/(1+k*x^2))
             // k=20: -(1/20)*(1 - 21/(1+20*x^2))
             float fFalloff = -0.05 + 1.05/(1+20*x*x);
-            LightColorDiffuse = g_PointLightBufferColor[nLightIndex].rgb * saturate(dot(vLightDir,vNorm)) * fFalloff;
+            LightColorDiffuse = LightColor * saturate(dot(vLightDir,vNorm)) * fFalloff;
 
             float3 vHalfAngle = normalize( vViewDir + vLightDir );
-            LightColorSpecular = g_PointLightBufferColor[nLightIndex].rgb * pow( saturate(dot( vHalfAngle, vNorm )), 8 ) * fFalloff;
+            LightColorSpecular = LightColor * pow( saturate(dot( vHalfAngle, vNorm )), 8 ) * fFalloff;
         }
 
         AccumDiffuse += LightColorDiffuse;
@@ -229,7 +266,7 @@ float4 RenderScenePS( VS_OUTPUT_SCENE Input ) : SV_TARGET
     nIndex++;
     nNextLightIndex = g_PerTileLightIndexBuffer[nIndex];
 #else
-    uint nNumSpotLights = (g_uNumLights & 0xFFFF0000u) >> 16;
+    uint nNumSpotLights = g_uNumSpotLights;
 #endif
 
     // loop over the spot lights
@@ -248,7 +285,14 @@ float4 RenderScenePS( VS_OUTPUT_SCENE Input ) : SV_TARGET
 #else
         uint nLightIndex = nIndex;
 #endif
+#if ( USE_PACKED_LIGHTS == 1 )
+        uint3 PackedLight = g_SpotLightBufferPacked[nLightIndex];
+        float4 BoundingSphereCenterAndRadius = UnpackLightCenterAndRadius( PackedLight );
+        float3 LightColor = UnpackLightColor( PackedLight );
+#else
         float4 BoundingSphereCenterAndRadius = g_SpotLightBufferCenterAndRadius[nLightIndex];
+        float3 LightColor = g_SpotLightBufferColor[nLightIndex].rgb;
+#endif
         float4 SpotParams = g_SpotLightBufferSpotParams[nLightIndex];
 
         // reconstruct z component of the light dir from x and y
@@ -283,10 +327,10 @@ float4 RenderScenePS( VS_OUTPUT_SCENE Input ) : SV_TARGET
             // -(1/k)*(1-(k+1)/(1+k*x^2))
             // k=20: -(1/20)*(1 - 21/(1+20*x^2))
             float fFalloff = -0.05 + 1.05/(1+20*x*x);
-            LightColorDiffuse = g_SpotLightBufferColor[nLightIndex].rgb * saturate(dot(vToLightNormalized,vNorm)) * fFalloff * fRadialAttenuation;
+            LightColorDiffuse = LightColor * saturate(dot(vToLightNormalized,vNorm)) * fFalloff * fRadialAttenuation;
 
             float3 vHalfAngle = normalize( vViewDir + vToLightNormalized );
-            LightColorSpecular = g_SpotLightBufferColor[nLightIndex].rgb * pow( saturate(dot( vHalfAngle, vNorm )), 8 ) * fFalloff * fRadialAttenuation;
+            LightColorSpecular = LightColor * pow( saturate(dot( vHalfAngle, vNorm )), 8 ) * fFalloff * fRadialAttenuation;
         }
 
         AccumDiffuse += LightColorDiffuse;
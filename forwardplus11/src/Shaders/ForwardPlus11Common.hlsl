@@ -45,10 +45,20 @@ cbuffer cbPerFrame : register( b1 )
     matrix              g_mProjectionInv        : packoffset( c4 );
     float3              g_vCameraPos            : packoffset( c8 );
     float               g_fAlphaTest            : packoffset( c8.w );
-    uint                g_uNumLights            : packoffset( c9 );
+    uint                g_uNumPointLights       : packoffset( c9 );
     uint                g_uWindowWidth          : packoffset( c9.y );
     uint                g_uWindowHeight         : packoffset( c9.z );
     uint                g_uMaxNumLightsPerTile  : packoffset( c9.w );
+    uint                g_uNumClusterSlices     : packoffset( c10 );
+    uint                g_uMaxNumLightsPerCluster : packoffset( c10.y );
+    float               g_fClusterNearZ         : packoffset( c10.z );
+    float               g_fClusterFarZ          : packoffset( c10.w );
+    uint                g_uClusterSliceDistribution : packoffset( c11 );
+    uint                g_uNumSpotLights        : packoffset( c11.y );
+    uint                g_uCullSpotCones        : packoffset( c11.z );
+    float               g_fMinLightContribution : packoffset( c11.w );
+    float3              g_vPackedLightOrigin    : packoffset( c12 );
+    float3              g_vPackedLightScale     : packoffset( c13 );
 };
 
 //--------------------------------------------------------------------------------------
@@ -58,10 +68,54 @@ cbuffer cbPerFrame : register( b1 )
 
 //--------------------------------------------------------------------------------------
 // Light culling constants.
-// These must match their counterparts in ForwardPlusUtil.h
+// These must match their counterparts in ForwardPlusCpuCuller.h
+// (TILE_RES is set per shader permutation, to 8, 16, 32 or 64, see GetTileRes, 
+// and MAX_NUM_LIGHTS_PER_TILE is GetMaxNumLightsPerTileForTileRes)
 //--------------------------------------------------------------------------------------
+#ifndef TILE_RES
 #define TILE_RES 16
-#define MAX_NUM_LIGHTS_PER_TILE 544
+#endif
+#define MAX_NUM_LIGHTS_PER_TILE (34*TILE_RES)
+
+// two-level culling (see USE_COARSE_TILES)
+#define COARSE_TILE_RES 64
+#define MAX_NUM_LIGHTS_PER_COARSE_TILE (34*COARSE_TILE_RES)
+
+// tile classification (see ClassifyTile)
+#define TILE_CLASS_EMPTY 0
+#define TILE_CLASS_UNIFORM 1
+#define TILE_CLASS_COMPLEX 2
+#define TILE_UNIFORM_DEPTH_RANGE (1.f/64.f)
+
+//--------------------------------------------------------------------------------------
+// Clustered light culling constants.
+// These must match their counterparts in ForwardPlusClusters.h
+//--------------------------------------------------------------------------------------
+#define MAX_NUM_CLUSTER_SLICES 64
+#define MAX_NUM_LIGHTS_PER_CLUSTER 256
+#define CLUSTER_SLICE_DISTRIBUTION_EXPONENTIAL 0
+#define CLUSTER_SLICE_DISTRIBUTION_LINEAR 1
+
+//--------------------------------------------------------------------------------------
+// Compact light list layout (USE_COMPACT_LIGHT_LISTS).
+// These must match their counterparts in ForwardPlusCompactLists.h
+//--------------------------------------------------------------------------------------
+#define COMPACT_LIST_COUNTER_OFFSET 0
+#define COMPACT_LIST_EMPTY_LIST_OFFSET 1
+#define COMPACT_LIST_HEADER_OFFSET 4
+#define COMPACT_LIST_HEADER_SIZE 2
+
+//--------------------------------------------------------------------------------------
+// Light list statistics layout.
+// These must match their counterparts in ForwardPlusLightCullStats.h
+//--------------------------------------------------------------------------------------
+#define LIGHT_CULL_STATS_OVERFLOW_OFFSET 0
+#define LIGHT_CULL_STATS_MAX_OFFSET 1
+#define LIGHT_CULL_STATS_SUM_OFFSET 2
+#define LIGHT_CULL_STATS_SPOT_CONE_OFFSET 3
+#define LIGHT_CULL_STATS_TILE_CLASS_OFFSET 4
+#define LIGHT_CULL_STATS_HISTOGRAM_OFFSET 7
+#define LIGHT_CULL_STATS_NUM_BINS 4096
 
 //-----------------------------------------------------------------------------------------
 // Helper functions
@@ -74,3 +128,63 @@ uint GetTileIndex(float2 ScreenPos)
     return nTileIdx;
 }
 
+// convert a depth value from post-projection space into view space
+float ConvertProjDepthToView( float z )
+{
+    z = 1.f / (z*g_mProjectionInv._34 + g_mProjectionInv._44);
+    return z;
+}
+
+// which depth slice a view-space depth falls into (see ForwardPlusClusters.h)
+uint GetClusterSlice(float fViewZ)
+{
+    if( g_uNumClusterSlices <= 1 ) return 0;
+
+    float fSlice;
+    if( g_uClusterSliceDistribution == CLUSTER_SLICE_DISTRIBUTION_EXPONENTIAL )
+    {
+        if( fViewZ < g_fClusterNearZ ) return 0;
+        fSlice = 1.f + floor( log( fViewZ / g_fClusterNearZ ) * (float)( g_uNumClusterSlices - 1 ) / log( g_fClusterFarZ / g_fClusterNearZ ) );
+    }
+    else
+    {
+        fSlice = floor( fViewZ * (float)g_uNumClusterSlices / g_fClusterFarZ );
+    }
+
+    return (uint)clamp( fSlice, 0.f, (float)( g_uNumClusterSlices - 1 ) );
+}
+
+// the view-space depth range of a slice (see ForwardPlusClusters.h)
+void GetClusterSliceBounds(uint uSlice, out float fNearZ, out float fFarZ)
+{
+    if( g_uClusterSliceDistribution == CLUSTER_SLICE_DISTRIBUTION_EXPONENTIAL )
+    {
+        float fRatio = g_fClusterFarZ / g_fClusterNearZ;
+        float fNumExpSlices = (float)( g_uNumClusterSlices - 1 );
+        fNearZ = ( uSlice == 0 ) ? 0.f : g_fClusterNearZ * pow( fRatio, (float)( uSlice - 1 ) / fNumExpSlices );
+        fFarZ = g_fClusterNearZ * pow( fRatio, (float)uSlice / fNumExpSlices );
+    }
+    else
+    {
+        float fSliceThickness = g_fClusterFarZ / (float)g_uNumClusterSlices;
+        fNearZ = (float)uSlice * fSliceThickness;
+        fFarZ = (float)( uSlice + 1 ) * fSliceThickness;
+    }
+
+    // the last slice extends to infinity
+    if( uSlice + 1 >= g_uNumClusterSlices ) fFarZ = 3.402823466e+38F;
+}
+
+// where the header of a tile is in the compact light index buffer 
+// (the list offset, then the packed point and spot light counts)
+uint GetCompactListHeaderIndex(uint nTileIndex)
+{
+    return COMPACT_LIST_HEADER_OFFSET + COMPACT_LIST_HEADER_SIZE*nTileIndex;
+}
+
+// the clusters of a tile are consecutive in the cluster light index buffer
+uint GetClusterIndex(float2 ScreenPos, float fViewZ)
+{
+    return GetTileIndex(ScreenPos)*g_uNumClusterSlices + GetClusterSlice(fViewZ);
+}
+
@@ -71,16 +71,15 @@ Buffer<float4> g_SpotLightBufferSpotMatrices     : register( t8 );
 //-----------------------------------------------------------------------------------------
 // Helper functions
 //-----------------------------------------------------------------------------------------
-uint GetNumLightsInThisTile(uint nTileIndex)
+uint GetNumLightsInList(uint nIndex)
 {
-    uint nNumLightsInThisTile = 0;
-    uint nIndex = g_uMaxNumLightsPerTile*nTileIndex;
+    uint nNumLightsInList = 0;
     uint nNextLightIndex = g_PerTileLightIndexBuffer[nIndex];
 
     // count point lights
     while ( nNextLightIndex != LIGHT_INDEX_BUFFER_SENTINEL )
     {
-        nNumLightsInThisTile++;
+        nNumLightsInList++;
         nIndex++;
         nNextLightIndex = g_PerTileLightIndexBuffer[nIndex];
     }
@@ -92,14 +91,56 @@ uint GetNumLightsInThisTile(uint nTileIndex)
     // count spot lights
     while ( nNextLightIndex != LIGHT_INDEX_BUFFER_SENTINEL )
     {
-        nNumLightsInThisTile++;
+        nNumLightsInList++;
         nIndex++;
         nNextLightIndex = g_PerTileLightIndexBuffer[nIndex];
     }
 
+    return nNumLightsInList;
+}
+
+#if ( USE_CLUSTERED_LIGHTING == 1 )
+// The overlay has no depth to pick a cluster with, 
+// so show the busiest cluster of each tile instead
+uint GetNumLightsInThisTile(uint nTileIndex)
+{
+    uint nNumLightsInThisTile = 0;
+    for( uint uSlice = 0; uSlice < g_uNumClusterSlices; uSlice++ )
+    {
+        uint nIndex = g_uMaxNumLightsPerCluster*(nTileIndex*g_uNumClusterSlices + uSlice);
+        nNumLightsInThisTile = max( nNumLightsInThisTile, GetNumLightsInList(nIndex) );
+    }
     return nNumLightsInThisTile;
 }
 
+uint GetMaxNumLightsPerList()
+{
+    return g_uMaxNumLightsPerCluster;
+}
+#elif ( USE_COMPACT_LIGHT_LISTS == 1 )
+// the header has the counts, so there is no need to walk the list
+uint GetNumLightsInThisTile(uint nTileIndex)
+{
+    uint nCounts = g_PerTileLightIndexBuffer[GetCompactListHeaderIndex(nTileIndex) + 1];
+    return ( nCounts & 0xFFFF ) + ( nCounts >> 16 );
+}
+
+uint GetMaxNumLightsPerList()
+{
+    return g_uMaxNumLightsPerTile;
+}
+#else
+uint GetNumLightsInThisTile(uint nTileIndex)
+{
+    return GetNumLightsInList(g_uMaxNumLightsPerTile*nTileIndex);
+}
+
+uint GetMaxNumLightsPerList()
+{
+    return g_uMaxNumLightsPerTile;
+}
+#endif
+
 //--------------------------------------------------------------------------------------
 // shader input/output structure
 //--------------------------------------------------------------------------------------
@@ -254,7 +295,7 @@ float4 DebugDrawNumLightsPerTileGrayscalePS( VS_OUTPUT_POSITION_ONLY Input ) : S
 {
     uint nTileIndex = GetTileIndex(Input.Position.xy);
     uint nNumLightsInThisTile = GetNumLightsInThisTile(nTileIndex);
-    float fPercentOfMax = (float)nNumLightsInThisTile / (float)g_uMaxNumLightsPerTile;
+    float fPercentOfMax = (float)nNumLightsInThisTile / (float)GetMaxNumLightsPerList();
     return float4(fPercentOfMax, fPercentOfMax, fPercentOfMax, 1.0f);
 }
 
@@ -269,9 +310,9 @@ float4 DebugDrawNumLightsPerTileRadarColorsPS( VS_OUTPUT_POSITION_ONLY Input ) :
     // black for no lights
     if( nNumLightsInThisTile == 0 ) return float4(0,0,0,1);
     // light purple for reaching the max
-    else if( nNumLightsInThisTile == g_uMaxNumLightsPerTile ) return float4(0.847,0.745,0.921,1);
+    else if( nNumLightsInThisTile == GetMaxNumLightsPerList() ) return float4(0.847,0.745,0.921,1);
     // white for going over the max
-    else if ( nNumLightsInThisTile > g_uMaxNumLightsPerTile ) return float4(1,1,1,1);
+    else if ( nNumLightsInThisTile > GetMaxNumLightsPerList() ) return float4(1,1,1,1);
     // else use weather radar colors
     else
     {
@@ -279,7 +320,7 @@ float4 DebugDrawNumLightsPerTileRadarColorsPS( VS_OUTPUT_POSITION_ONLY Input ) :
 
         // want to find the base b such that the logb of g_uMaxNumLightsPerTile is 14
         // (because we have 14 radar colors)
-        float fLogBase = exp2(0.07142857f*log2((float)g_uMaxNumLightsPerTile));
+        float fLogBase = exp2(0.07142857f*log2((float)GetMaxNumLightsPerList()));
 
         // change of base
         // logb(x) = log2(x) / log2(b)
@@ -0,0 +1,170 @@
+//
+// Copyright (c) 2016 Advanced Micro Devices, Inc. All rights reserved.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+//--------------------------------------------------------------------------------------
+// File: ForwardPlus11HiZ.hlsl
+//
+// HLSL file for the ForwardPlus11 sample. Min/max depth pyramid (Hi-Z).
+//--------------------------------------------------------------------------------------
+
+
+#define FLT_MAX         3.402823466e+38F
+
+//-----------------------------------------------------------------------------------------
+// Parameters for the Hi-Z shader
+//-----------------------------------------------------------------------------------------
+// a thread group builds the texels of all levels (8x8 to 64x64 pixels per texel, 
+// like HIZ_FIRST_LEVEL to HIZ_LAST_LEVEL in ForwardPlusHiZ.h) for a 64x64 block of
+// pixels, with each thread reducing 4x4 of them first
+#define HIZ_BLOCK_RES 64
+#define NUM_THREADS_X 16
+#define NUM_THREADS_Y 16
+#define NUM_PIXELS_PER_THREAD_X (HIZ_BLOCK_RES/NUM_THREADS_X)
+#define NUM_PIXELS_PER_THREAD_Y (HIZ_BLOCK_RES/NUM_THREADS_Y)
+
+//-----------------------------------------------------------------------------------------
+// Textures
+//-----------------------------------------------------------------------------------------
+#if ( USE_MSAA == 1 )
+Texture2DMS<float> g_DepthTexture : register( t0 );
+#else
+Texture2D<float> g_DepthTexture : register( t0 );
+#endif
+
+// the min (x) and max (y) stored depth of each texel, a texture per level, since the
+// levels are rounded up separately (so that the last texel of each covers the partial
+// tile at the edge of the screen), which the mips of one texture would not be
+RWTexture2D<float2> g_HiZLevel3Out : register( u0 );
+RWTexture2D<float2> g_HiZLevel4Out : register( u1 );
+RWTexture2D<float2> g_HiZLevel5Out : register( u2 );
+RWTexture2D<float2> g_HiZLevel6Out : register( u3 );
+
+//-----------------------------------------------------------------------------------------
+// Group Shared Memory (aka local data share, or LDS)
+//-----------------------------------------------------------------------------------------
+groupshared float ldsMinDepth[NUM_THREADS_X*NUM_THREADS_Y];
+groupshared float ldsMaxDepth[NUM_THREADS_X*NUM_THREADS_Y];
+
+//-----------------------------------------------------------------------------------------
+// Helper functions
+//-----------------------------------------------------------------------------------------
+
+// the min (skipping the cleared depth, zero, since depth is inverted) and max 
+// of the pixels (or samples) this thread covers
+float2 CalculateMinMaxDepthForThread( uint2 groupIdx, uint2 localIdx )
+{
+    float minDepth = FLT_MAX;
+    float maxDepth = 0.f;
+
+#if ( USE_MSAA == 1 )
+    uint depthBufferWidth, depthBufferHeight, depthBufferNumSamples;
+    g_DepthTexture.GetDimensions( depthBufferWidth, depthBufferHeight, depthBufferNumSamples );
+#endif
+
+    // (pixels outside the depth buffer read as zero, so they are skipped too)
+    uint2 firstPixelCoords = groupIdx*HIZ_BLOCK_RES + localIdx*uint2( NUM_PIXELS_PER_THREAD_X, NUM_PIXELS_PER_THREAD_Y );
+
+    [unroll]
+    for( uint j=0; j<NUM_PIXELS_PER_THREAD_Y; j++ )
+    {
+        [unroll]
+        for( uint i=0; i<NUM_PIXELS_PER_THREAD_X; i++ )
+        {
+#if ( USE_MSAA == 1 )
+            for( uint sampleIdx=0; sampleIdx<depthBufferNumSamples; sampleIdx++ )
+            {
+                float depth = g_DepthTexture.Load( firstPixelCoords + uint2(i,j), sampleIdx ).x;
+                minDepth = ( depth != 0.f ) ? min( minDepth, depth ) : minDepth;
+                maxDepth = max( maxDepth, depth );
+            }
+#else
+            float depth = g_DepthTexture.Load( uint3(firstPixelCoords + uint2(i,j),0) ).x;
+            minDepth = ( depth != 0.f ) ? min( minDepth, depth ) : minDepth;
+            maxDepth = max( maxDepth, depth );
+#endif
+        }
+    }
+
+    return float2( minDepth, maxDepth );
+}
+
+// The threads at the top left of each 2*stride x 2*stride square of threads reduce the
+// 2x2 values stride apart in LDS into their own, returning true and the result. Only 
+// those threads write, and only to values no other thread reads in the same step.
+bool ReduceMinMaxDepthInLds( uint2 localIdx, uint stride, out float2 minMaxDepth )
+{
+    minMaxDepth = float2( FLT_MAX, 0.f );
+    if( any( localIdx % (2*stride) ) )
+    {
+        return false;
+    }
+
+    uint idx00 = localIdx.x + localIdx.y*NUM_THREADS_X;
+    uint idx01 = idx00 + stride*NUM_THREADS_X;
+    minMaxDepth.x = min( min( ldsMinDepth[idx00], ldsMinDepth[idx00 + stride] ), min( ldsMinDepth[idx01], ldsMinDepth[idx01 + stride] ) );
+    minMaxDepth.y = max( max( ldsMaxDepth[idx00], ldsMaxDepth[idx00 + stride] ), max( ldsMaxDepth[idx01], ldsMaxDepth[idx01 + stride] ) );
+    ldsMinDepth[idx00] = minMaxDepth.x;
+    ldsMaxDepth[idx00] = minMaxDepth.y;
+    return true;
+}
+
+//-----------------------------------------------------------------------------------------
+// Hi-Z shader. Dispatched with one thread group per 64x64 block of pixels, 
+// rounded up. Writes to texels outside a level (for partial blocks) are dropped.
+//-----------------------------------------------------------------------------------------
+[numthreads(NUM_THREADS_X, NUM_THREADS_Y, 1)]
+void BuildHiZCS( uint3 localIdx : SV_GroupThreadID, uint3 groupIdx : SV_GroupID )
+{
+    float2 minMaxDepth = CalculateMinMaxDepthForThread( groupIdx.xy, localIdx.xy );
+    uint localIdxFlattened = localIdx.x + localIdx.y*NUM_THREADS_X;
+    ldsMinDepth[localIdxFlattened] = minMaxDepth.x;
+    ldsMaxDepth[localIdxFlattened] = minMaxDepth.y;
+    GroupMemoryBarrierWithGroupSync();
+
+    // 8x8 pixels per texel (2x2 threads)
+    if( ReduceMinMaxDepthInLds( localIdx.xy, 1, minMaxDepth ) )
+    {
+        g_HiZLevel3Out[groupIdx.xy*8 + localIdx.xy/2] = minMaxDepth;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    // 16x16 pixels per texel
+    if( ReduceMinMaxDepthInLds( localIdx.xy, 2, minMaxDepth ) )
+    {
+        g_HiZLevel4Out[groupIdx.xy*4 + localIdx.xy/4] = minMaxDepth;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    // 32x32 pixels per texel
+    if( ReduceMinMaxDepthInLds( localIdx.xy, 4, minMaxDepth ) )
+    {
+        g_HiZLevel5Out[groupIdx.xy*2 + localIdx.xy/8] = minMaxDepth;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    // 64x64 pixels per texel (the whole block)
+    if( ReduceMinMaxDepthInLds( localIdx.xy, 8, minMaxDepth ) )
+    {
+        g_HiZLevel6Out[groupIdx.xy] = minMaxDepth;
+    }
+}
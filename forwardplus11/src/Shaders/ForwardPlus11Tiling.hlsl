@@ -31,6 +31,22 @@
 
 #define FLT_MAX         3.402823466e+38F
 
+//-----------------------------------------------------------------------------------------
+// Parameters for the light culling shader
+//-----------------------------------------------------------------------------------------
+// a thread group can have at most 1024 threads, so tiles bigger than 16x16 
+// have each thread cover several pixels, NUM_THREADS_X (or _Y) apart
+#if ( TILE_RES > 16 )
+#define NUM_THREADS_X 16
+#define NUM_THREADS_Y 16
+#else
+#define NUM_THREADS_X TILE_RES
+#define NUM_THREADS_Y TILE_RES
+#endif
+#define NUM_THREADS_PER_TILE (NUM_THREADS_X*NUM_THREADS_Y)
+#define NUM_PIXELS_PER_THREAD_X (TILE_RES/NUM_THREADS_X)
+#define NUM_PIXELS_PER_THREAD_Y (TILE_RES/NUM_THREADS_Y)
+
 //-----------------------------------------------------------------------------------------
 // Textures and Buffers
 //-----------------------------------------------------------------------------------------
@@ -41,10 +57,39 @@ Buffer<float4> g_SpotLightBufferCenterAndRadius : register( t1 );
 Texture2D<float> g_DepthTexture : register( t2 );
 #elif ( USE_DEPTH_BOUNDS == 2 ) // MSAA
 Texture2DMS<float> g_DepthTexture : register( t2 );
+#elif ( USE_DEPTH_BOUNDS == 3 ) // Hi-Z
+// the min (x) and max (y) stored depth of each tile, from the level of the
+// depth pyramid with a texel per tile (see ForwardPlus11HiZ.hlsl)
+Texture2D<float2> g_HiZTexture : register( t2 );
+#endif
+
+#if ( USE_DEPTH_BOUNDS == 3 && USE_DEPTH_MASK == 1 )
+#error the depth mask needs the pixels, not just their bounds
 #endif
 
+#if ( USE_COARSE_TILES == 1 )
+// the lists of the coarse tiles, as written by CullLightsCoarseCS
+Buffer<uint> g_CoarseLightIndexBuffer : register( t3 );
+#endif
+
+// the packed direction, cone angle and falloff radius of the spot lights 
+// (see ForwardPlusSpotCones.h), for when g_uCullSpotCones is set
+Buffer<float4> g_SpotLightBufferSpotParams : register( t4 );
+
+// the light colors, for the light LOD (when g_fMinLightContribution is above 0)
+Buffer<float4> g_PointLightBufferColor : register( t5 );
+Buffer<float4> g_SpotLightBufferColor : register( t6 );
+
 RWBuffer<uint> g_PerTileLightIndexBufferOut : register( u0 );
 
+// the lists of the coarse tiles, for CullLightsCoarseCS: the number of point lights,
+// the number of spot lights (both before clamping), the point light indices and the 
+// spot light indices, MAX_NUM_LIGHTS_PER_COARSE_TILE entries apart
+RWBuffer<uint> g_CoarseLightIndexBufferOut : register( u2 );
+
+// list length statistics (see ForwardPlusLightCullStats.h)
+RWBuffer<uint> g_LightCullStatsOut : register( u1 );
+
 //-----------------------------------------------------------------------------------------
 // Group Shared Memory (aka local data share, or LDS)
 //-----------------------------------------------------------------------------------------
@@ -53,9 +98,23 @@ groupshared uint ldsZMax;
 groupshared uint ldsZMin;
 #endif
 
+#if ( USE_DEPTH_MASK == 1 )
+// one bit per cell, for 32 cells evenly spaced from the tile's min to max depth, 
+// set if at least one pixel (or sample) falls into that cell
+groupshared uint ldsDepthMask;
+#endif
+
 groupshared uint ldsLightIdxCounter;
 groupshared uint ldsLightIdx[MAX_NUM_LIGHTS_PER_TILE];
 
+// the spot lights that passed with their bounding sphere, but not with their cone
+groupshared uint ldsNumSpotConeRejections;
+
+#if ( USE_COMPACT_LIGHT_LISTS == 1 )
+// where this tile's list goes in the compact light index buffer (0 if it did not fit)
+groupshared uint ldsListStartOffset;
+#endif
+
 //-----------------------------------------------------------------------------------------
 // Helper functions
 //-----------------------------------------------------------------------------------------
@@ -79,6 +138,29 @@ float GetSignedDistanceFromPlane( float3 p, float3 eqn )
     return dot(eqn,p);
 }
 
+// add one list to the statistics, numLights being its length before clamping
+void AccumulateLightCullStats( uint numLights, bool bOverflowed )
+{
+    if( bOverflowed )
+    {
+        InterlockedAdd( g_LightCullStatsOut[LIGHT_CULL_STATS_OVERFLOW_OFFSET], 1 );
+    }
+    InterlockedMax( g_LightCullStatsOut[LIGHT_CULL_STATS_MAX_OFFSET], numLights );
+    InterlockedAdd( g_LightCullStatsOut[LIGHT_CULL_STATS_SUM_OFFSET], numLights );
+    InterlockedAdd( g_LightCullStatsOut[LIGHT_CULL_STATS_HISTOGRAM_OFFSET + min( numLights, LIGHT_CULL_STATS_NUM_BINS - 1 )], 1 );
+}
+
+// sort a tile by its depth bounds (see ClassifyTile in ForwardPlusCpuCuller.h): empty 
+// (all cleared, minZ > maxZ), uniform (a narrow depth range) or complex
+uint ClassifyTile( float minZ, float maxZ )
+{
+    if( minZ > maxZ )
+    {
+        return TILE_CLASS_EMPTY;
+    }
+    return ( maxZ - minZ <= TILE_UNIFORM_DEPTH_RANGE*minZ ) ? TILE_CLASS_UNIFORM : TILE_CLASS_COMPLEX;
+}
+
 bool TestFrustumSides( float3 c, float r, float3 plane0, float3 plane1, float3 plane2, float3 plane3 )
 {
     bool intersectingOrInside0 = GetSignedDistanceFromPlane( c, plane0 ) < r;
@@ -90,6 +172,67 @@ bool TestFrustumSides( float3 c, float r, float3 plane0, float3 plane1, float3 p
             intersectingOrInside2 && intersectingOrInside3);
 }
 
+// A spot light only lights the points closer to its apex than its falloff radius and 
+// inside its cone angle (see RenderScenePS), which is all inside the cone with that 
+// height, a lot smaller than the bounding sphere. This tests that cone against the sides 
+// and the depth slab of a tile, a plane at a time: the point of a cone furthest along a 
+// direction is either the apex or on the rim of the base, so a plane is passed if either 
+// is on its inner side. center is the bounding sphere, already in view space. This must 
+// match TestSpotCone in ForwardPlusSpotCones.h.
+bool TestSpotConeAgainstPlane( float3 apex, float3 baseCenter, float3 dir, float baseRadius, float3 plane )
+{
+    float planeDotDir = dot( plane, dir );
+    float rimScale = sqrt( saturate( 1 - planeDotDir*planeDotDir ) );
+    return GetSignedDistanceFromPlane( apex, plane ) < 0 || GetSignedDistanceFromPlane( baseCenter, plane ) - baseRadius*rimScale < 0;
+}
+
+bool TestSpotCone( float4 center, float4 spotParams, float3 plane0, float3 plane1, float3 plane2, float3 plane3, float minZ, float maxZ )
+{
+    // reconstruct z component of the light dir from x and y, like RenderScenePS
+    // (the sign bit for cone angle is used to store the sign for the z component of the light dir)
+    float3 spotLightDir;
+    spotLightDir.xy = spotParams.xy;
+    spotLightDir.z = sqrt( saturate( 1 - spotLightDir.x*spotLightDir.x - spotLightDir.y*spotLightDir.y ) );
+    spotLightDir.z = (spotParams.z > 0) ? spotLightDir.z : -spotLightDir.z;
+    float cosineOfConeAngle = (spotParams.z > 0) ? spotParams.z : -spotParams.z;
+
+    // the top of the cone is r_bounding_sphere units away from the bounding sphere center 
+    // along the negated light direction, and tan(theta) = r_cone/h_cone
+    float3 dir = mul( float4(spotLightDir, 0), g_mWorldView ).xyz;
+    float3 apex = center.xyz - center.w*dir;
+    float height = spotParams.w;
+    float baseRadius = height*sqrt( 1 - cosineOfConeAngle*cosineOfConeAngle ) / cosineOfConeAngle;
+    float3 baseCenter = apex + height*dir;
+
+    float rimZ = baseRadius*sqrt( saturate( 1 - dir.z*dir.z ) );
+    float coneMinZ = min( apex.z, baseCenter.z - rimZ );
+    float coneMaxZ = max( apex.z, baseCenter.z + rimZ );
+
+    return TestSpotConeAgainstPlane( apex, baseCenter, dir, baseRadius, plane0 ) &&
+           TestSpotConeAgainstPlane( apex, baseCenter, dir, baseRadius, plane1 ) &&
+           TestSpotConeAgainstPlane( apex, baseCenter, dir, baseRadius, plane2 ) &&
+           TestSpotConeAgainstPlane( apex, baseCenter, dir, baseRadius, plane3 ) &&
+           coneMaxZ > minZ && coneMinZ < maxZ;
+}
+
+// The most RenderScenePS scales a light's color by (2 for diffuse plus 8 for specular)
+#define LIGHT_LOD_MAX_LIGHTING_SCALE 10.0
+
+// Whether a light can add g_fMinLightContribution to any channel of any pixel of the tile: 
+// its color, times LIGHT_LOD_MAX_LIGHTING_SCALE, times its falloff at a lower bound of the 
+// distance from c (where the falloff is centered, in view space) to the tile. This must 
+// match ApplyLightLod in ForwardPlusCpuCuller.cpp (see ForwardPlusLightLod.h).
+bool TestLightContribution( float3 c, float falloffRadius, float3 color, float3 plane0, float3 plane1, float3 plane2, float3 plane3, float minZ, float maxZ )
+{
+    float distance = max( max( max( GetSignedDistanceFromPlane( c, plane0 ), GetSignedDistanceFromPlane( c, plane1 ) ),
+                               max( GetSignedDistanceFromPlane( c, plane2 ), GetSignedDistanceFromPlane( c, plane3 ) ) ),
+                          max( max( minZ - c.z, c.z - maxZ ), 0 ) );
+    float x = min( distance / falloffRadius, 1 );
+    float falloff = max( -0.05 + 1.05/(1+20*x*x), 0 );
+    float maxColor = max( color.r, max( color.g, color.b ) );
+    return ( g_fMinLightContribution <= 0 ) || ( LIGHT_LOD_MAX_LIGHTING_SCALE*maxColor*falloff >= g_fMinLightContribution );
+}
+
 // calculate the number of tiles in the horizontal direction
 uint GetNumTilesX()
 {
@@ -102,6 +245,27 @@ uint GetNumTilesY()
     return (uint)( ( g_uWindowHeight + TILE_RES - 1 ) / (float)TILE_RES );
 }
 
+// the coarse tiles cover the window rounded up to whole tiles (COARSE_TILE_RES is a multiple of TILE_RES)
+uint GetNumCoarseTilesX()
+{
+    return ( TILE_RES*GetNumTilesX() + COARSE_TILE_RES - 1 ) / COARSE_TILE_RES;
+}
+
+uint GetCoarseTileIndex( uint2 groupIdx )
+{
+    uint2 coarseTileIdx = groupIdx / ( COARSE_TILE_RES / TILE_RES );
+    return coarseTileIdx.x + coarseTileIdx.y*GetNumCoarseTilesX();
+}
+
+// The radius a light is tested with against a coarse tile. The planes of the outer 
+// edges of a coarse tile are calculated from different corners than those of the tiles 
+// along them, so the radius is grown by a bound on the rounding error of the plane 
+// distance, so that a light that passes a tile always passes its coarse tile.
+float GetCoarseTileTestRadius( float3 c, float r )
+{
+    return r + 1e-4f*( abs(c.x) + abs(c.y) + abs(c.z) + r );
+}
+
 // convert a point from post-projection space into view space
 float4 ConvertProjToView( float4 p )
 {
@@ -110,65 +274,198 @@ float4 ConvertProjToView( float4 p )
     return p;
 }
 
-// convert a depth value from post-projection space into view space
-float ConvertProjDepthToView( float z )
+// construct the four side planes of the frustum for a rectangle of pixels on the tile grid
+void CalculateFrustum( uint pxm, uint pym, uint pxp, uint pyp, out float3 frustumEqn0, out float3 frustumEqn1, out float3 frustumEqn2, out float3 frustumEqn3 )
+{
+    uint uWindowWidthEvenlyDivisibleByTileRes = TILE_RES*GetNumTilesX();
+    uint uWindowHeightEvenlyDivisibleByTileRes = TILE_RES*GetNumTilesY();
+
+    // four corners of the tile, clockwise from top-left
+    float3 frustum0 = ConvertProjToView( float4( pxm/(float)uWindowWidthEvenlyDivisibleByTileRes*2.f-1.f, (uWindowHeightEvenlyDivisibleByTileRes-pym)/(float)uWindowHeightEvenlyDivisibleByTileRes*2.f-1.f,1.f,1.f) ).xyz;
+    float3 frustum1 = ConvertProjToView( float4( pxp/(float)uWindowWidthEvenlyDivisibleByTileRes*2.f-1.f, (uWindowHeightEvenlyDivisibleByTileRes-pym)/(float)uWindowHeightEvenlyDivisibleByTileRes*2.f-1.f,1.f,1.f) ).xyz;
+    float3 frustum2 = ConvertProjToView( float4( pxp/(float)uWindowWidthEvenlyDivisibleByTileRes*2.f-1.f, (uWindowHeightEvenlyDivisibleByTileRes-pyp)/(float)uWindowHeightEvenlyDivisibleByTileRes*2.f-1.f,1.f,1.f) ).xyz;
+    float3 frustum3 = ConvertProjToView( float4( pxm/(float)uWindowWidthEvenlyDivisibleByTileRes*2.f-1.f, (uWindowHeightEvenlyDivisibleByTileRes-pyp)/(float)uWindowHeightEvenlyDivisibleByTileRes*2.f-1.f,1.f,1.f) ).xyz;
+
+    // create plane equations for the four sides of the frustum, 
+    // with the positive half-space outside the frustum (and remember, 
+    // view space is left handed, so use the left-hand rule to determine 
+    // cross product direction)
+    frustumEqn0 = CreatePlaneEquation( frustum0, frustum1 );
+    frustumEqn1 = CreatePlaneEquation( frustum1, frustum2 );
+    frustumEqn2 = CreatePlaneEquation( frustum2, frustum3 );
+    frustumEqn3 = CreatePlaneEquation( frustum3, frustum0 );
+}
+
+// construct the four side planes of the frustum for a tile
+void CalculateTileFrustum( uint2 groupIdx, out float3 frustumEqn0, out float3 frustumEqn1, out float3 frustumEqn2, out float3 frustumEqn3 )
 {
-    z = 1.f / (z*g_mProjectionInv._34 + g_mProjectionInv._44);
-    return z;
+    CalculateFrustum( TILE_RES*groupIdx.x, TILE_RES*groupIdx.y, TILE_RES*(groupIdx.x+1), TILE_RES*(groupIdx.y+1),
+        frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3 );
+}
+
+// same, for a coarse tile, which is the union of its tiles (so it stops where the tile grid does)
+void CalculateCoarseTileFrustum( uint2 groupIdx, out float3 frustumEqn0, out float3 frustumEqn1, out float3 frustumEqn2, out float3 frustumEqn3 )
+{
+    uint2 gridSize = TILE_RES*uint2( GetNumTilesX(), GetNumTilesY() );
+    uint2 pm = COARSE_TILE_RES*groupIdx;
+    uint2 pp = min( COARSE_TILE_RES*(groupIdx+1), gridSize );
+    CalculateFrustum( pm.x, pm.y, pp.x, pp.y, frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3 );
+}
+
+// the pixel this thread covers, the (i,j)th one when the tile is bigger than the group
+uint2 GetPixelCoords( uint2 groupIdx, uint2 localIdx, uint i, uint j )
+{
+    return groupIdx*TILE_RES + localIdx + uint2( i*NUM_THREADS_X, j*NUM_THREADS_Y );
 }
 
 #if ( USE_DEPTH_BOUNDS == 1 )   // non-MSAA
-void CalculateMinMaxDepthInLds( uint3 globalThreadIdx )
+void CalculateMinMaxDepthInLds( uint2 groupIdx, uint2 localIdx )
 {
-    float depth = g_DepthTexture.Load( uint3(globalThreadIdx.x,globalThreadIdx.y,0) ).x;
-    float viewPosZ = ConvertProjDepthToView( depth );
-    uint z = asuint( viewPosZ );
-    if( depth != 0.f )
+    float minZForThisThread = FLT_MAX;
+    float maxZForThisThread = 0.f;
+
+    [unroll]
+    for( uint j=0; j<NUM_PIXELS_PER_THREAD_Y; j++ )
     {
-        InterlockedMax( ldsZMax, z );
-        InterlockedMin( ldsZMin, z );
+        [unroll]
+        for( uint i=0; i<NUM_PIXELS_PER_THREAD_X; i++ )
+        {
+            float depth = g_DepthTexture.Load( uint3(GetPixelCoords(groupIdx,localIdx,i,j),0) ).x;
+            float viewPosZ = ConvertProjDepthToView( depth );
+            if( depth != 0.f )
+            {
+                maxZForThisThread = max( maxZForThisThread, viewPosZ );
+                minZForThisThread = min( minZForThisThread, viewPosZ );
+            }
+        }
     }
+
+    // (the initial values leave ldsZMax and ldsZMin as they are)
+    InterlockedMax( ldsZMax, asuint( maxZForThisThread ) );
+    InterlockedMin( ldsZMin, asuint( minZForThisThread ) );
 }
 #endif
 
 #if ( USE_DEPTH_BOUNDS == 2 ) // MSAA
-void CalculateMinMaxDepthInLdsMSAA( uint3 globalThreadIdx, uint depthBufferNumSamples)
+void CalculateMinMaxDepthInLdsMSAA( uint2 groupIdx, uint2 localIdx, uint depthBufferNumSamples)
+{
+    float minZForThisThread = FLT_MAX;
+    float maxZForThisThread = 0.f;
+
+    [unroll]
+    for( uint j=0; j<NUM_PIXELS_PER_THREAD_Y; j++ )
+    {
+        [unroll]
+        for( uint i=0; i<NUM_PIXELS_PER_THREAD_X; i++ )
+        {
+            uint2 pixelCoords = GetPixelCoords( groupIdx, localIdx, i, j );
+            for( uint sampleIdx=0; sampleIdx<depthBufferNumSamples; sampleIdx++ )
+            {
+                float depth = g_DepthTexture.Load( pixelCoords, sampleIdx ).x;
+                float viewPosZ = ConvertProjDepthToView( depth );
+                if( depth != 0.f )
+                {
+                    maxZForThisThread = max( maxZForThisThread, viewPosZ );
+                    minZForThisThread = min( minZForThisThread, viewPosZ );
+                }
+            }
+        }
+    }
+
+    InterlockedMax( ldsZMax, asuint( maxZForThisThread ) );
+    InterlockedMin( ldsZMin, asuint( minZForThisThread ) );
+}
+#endif
+
+#if ( USE_DEPTH_BOUNDS == 3 ) // Hi-Z
+// Same as CalculateMinMaxDepthInLds, but looked up in the depth pyramid instead of 
+// reduced from the pixels. Depth is inverted, so the view-space min comes from the 
+// stored max and vice versa. A tile with nothing but cleared depth gets the same 
+// minZ = FLT_MAX and maxZ = 0 as from LDS.
+void GetMinMaxDepthFromHiZ( uint2 groupIdx, out float minZ, out float maxZ )
+{
+    float2 minMaxDepth = g_HiZTexture.Load( uint3(groupIdx,0) ).xy;
+    bool bEmpty = ( minMaxDepth.y == 0.f );
+    minZ = bEmpty ? FLT_MAX : ConvertProjDepthToView( minMaxDepth.y );
+    maxZ = bEmpty ? 0.f : ConvertProjDepthToView( minMaxDepth.x );
+}
+#endif
+
+// which of the 32 depth mask cells a view-space depth falls into
+uint GetDepthMaskCell( float viewPosZ, float minZ, float invCellSize )
+{
+    return (uint)clamp( ( viewPosZ - minZ )*invCellSize, 0.f, 31.f );
+}
+
+#if ( USE_DEPTH_MASK == 1 )
+#if ( USE_DEPTH_BOUNDS == 1 )   // non-MSAA
+void CalculateDepthMaskInLds( uint2 groupIdx, uint2 localIdx, float minZ, float invCellSize )
 {
-    float minZForThisPixel = FLT_MAX;
-    float maxZForThisPixel = 0.f;
+    uint depthMaskForThisThread = 0;
 
-    float depth0 = g_DepthTexture.Load( uint2(globalThreadIdx.x,globalThreadIdx.y), 0 ).x;
-    float viewPosZ0 = ConvertProjDepthToView( depth0 );
-    if( depth0 != 0.f )
+    [unroll]
+    for( uint j=0; j<NUM_PIXELS_PER_THREAD_Y; j++ )
     {
-        maxZForThisPixel = max( maxZForThisPixel, viewPosZ0 );
-        minZForThisPixel = min( minZForThisPixel, viewPosZ0 );
+        [unroll]
+        for( uint i=0; i<NUM_PIXELS_PER_THREAD_X; i++ )
+        {
+            float depth = g_DepthTexture.Load( uint3(GetPixelCoords(groupIdx,localIdx,i,j),0) ).x;
+            float viewPosZ = ConvertProjDepthToView( depth );
+            if( depth != 0.f )
+            {
+                depthMaskForThisThread |= 1u << GetDepthMaskCell( viewPosZ, minZ, invCellSize );
+            }
+        }
     }
 
-    for( uint sampleIdx=1; sampleIdx<depthBufferNumSamples; sampleIdx++ )
+    InterlockedOr( ldsDepthMask, depthMaskForThisThread );
+}
+#endif
+
+#if ( USE_DEPTH_BOUNDS == 2 ) // MSAA
+void CalculateDepthMaskInLdsMSAA( uint2 groupIdx, uint2 localIdx, uint depthBufferNumSamples, float minZ, float invCellSize )
+{
+    uint depthMaskForThisThread = 0;
+
+    [unroll]
+    for( uint j=0; j<NUM_PIXELS_PER_THREAD_Y; j++ )
     {
-        float depth = g_DepthTexture.Load( uint2(globalThreadIdx.x,globalThreadIdx.y), sampleIdx ).x;
-        float viewPosZ = ConvertProjDepthToView( depth );
-        if( depth != 0.f )
+        [unroll]
+        for( uint i=0; i<NUM_PIXELS_PER_THREAD_X; i++ )
         {
-            maxZForThisPixel = max( maxZForThisPixel, viewPosZ );
-            minZForThisPixel = min( minZForThisPixel, viewPosZ );
+            uint2 pixelCoords = GetPixelCoords( groupIdx, localIdx, i, j );
+            for( uint sampleIdx=0; sampleIdx<depthBufferNumSamples; sampleIdx++ )
+            {
+                float depth = g_DepthTexture.Load( pixelCoords, sampleIdx ).x;
+                float viewPosZ = ConvertProjDepthToView( depth );
+                if( depth != 0.f )
+                {
+                    depthMaskForThisThread |= 1u << GetDepthMaskCell( viewPosZ, minZ, invCellSize );
+                }
+            }
         }
     }
 
-    uint zMaxForThisPixel = asuint( maxZForThisPixel );
-    uint zMinForThisPixel = asuint( minZForThisPixel );
-    InterlockedMax( ldsZMax, zMaxForThisPixel );
-    InterlockedMin( ldsZMin, zMinForThisPixel );
+    InterlockedOr( ldsDepthMask, depthMaskForThisThread );
 }
 #endif
 
-//-----------------------------------------------------------------------------------------
-// Parameters for the light culling shader
-//-----------------------------------------------------------------------------------------
-#define NUM_THREADS_X TILE_RES
-#define NUM_THREADS_Y TILE_RES
-#define NUM_THREADS_PER_TILE (NUM_THREADS_X*NUM_THREADS_Y)
+// test the depth extent of a bounding sphere against the depth mask, to reject 
+// lights that fall into a gap between surfaces (e.g. a tile containing both a 
+// foreground object and the background far behind it)
+bool TestDepthMask( float z, float r, float minZ, float invCellSize )
+{
+    uint firstCell = GetDepthMaskCell( z - r, minZ, invCellSize );
+    uint lastCell = GetDepthMaskCell( z + r, minZ, invCellSize );
+    uint lightMask = ( 0xFFFFFFFFu >> ( 31 - lastCell ) ) & ( 0xFFFFFFFFu << firstCell );
+    return ( lightMask & ldsDepthMask ) != 0;
+}
+#else
+bool TestDepthMask( float z, float r, float minZ, float invCellSize )
+{
+    return true;
+}
+#endif
 
 //-----------------------------------------------------------------------------------------
 // Light culling shader
@@ -183,35 +480,16 @@ void CullLightsCS( uint3 globalIdx : SV_DispatchThreadID, uint3 localIdx : SV_Gr
 #if ( USE_DEPTH_BOUNDS == 1 || USE_DEPTH_BOUNDS == 2 )
         ldsZMin = 0x7f7fffff;  // FLT_MAX as a uint
         ldsZMax = 0;
+#endif
+#if ( USE_DEPTH_MASK == 1 )
+        ldsDepthMask = 0;
 #endif
         ldsLightIdxCounter = 0;
+        ldsNumSpotConeRejections = 0;
     }
 
     float3 frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3;
-    {   // construct frustum for this tile
-        uint pxm = TILE_RES*groupIdx.x;
-        uint pym = TILE_RES*groupIdx.y;
-        uint pxp = TILE_RES*(groupIdx.x+1);
-        uint pyp = TILE_RES*(groupIdx.y+1);
-
-        uint uWindowWidthEvenlyDivisibleByTileRes = TILE_RES*GetNumTilesX();
-        uint uWindowHeightEvenlyDivisibleByTileRes = TILE_RES*GetNumTilesY();
-
-        // four corners of the tile, clockwise from top-left
-        float3 frustum0 = ConvertProjToView( float4( pxm/(float)uWindowWidthEvenlyDivisibleByTileRes*2.f-1.f, (uWindowHeightEvenlyDivisibleByTileRes-pym)/(float)uWindowHeightEvenlyDivisibleByTileRes*2.f-1.f,1.f,1.f) ).xyz;
-        float3 frustum1 = ConvertProjToView( float4( pxp/(float)uWindowWidthEvenlyDivisibleByTileRes*2.f-1.f, (uWindowHeightEvenlyDivisibleByTileRes-pym)/(float)uWindowHeightEvenlyDivisibleByTileRes*2.f-1.f,1.f,1.f) ).xyz;
-        float3 frustum2 = ConvertProjToView( float4( pxp/(float)uWindowWidthEvenlyDivisibleByTileRes*2.f-1.f, (uWindowHeightEvenlyDivisibleByTileRes-pyp)/(float)uWindowHeightEvenlyDivisibleByTileRes*2.f-1.f,1.f,1.f) ).xyz;
-        float3 frustum3 = ConvertProjToView( float4( pxm/(float)uWindowWidthEvenlyDivisibleByTileRes*2.f-1.f, (uWindowHeightEvenlyDivisibleByTileRes-pyp)/(float)uWindowHeightEvenlyDivisibleByTileRes*2.f-1.f,1.f,1.f) ).xyz;
-
-        // create plane equations for the four sides of the frustum, 
-        // with the positive half-space outside the frustum (and remember, 
-        // view space is left handed, so use the left-hand rule to determine 
-        // cross product direction)
-        frustumEqn0 = CreatePlaneEquation( frustum0, frustum1 );
-        frustumEqn1 = CreatePlaneEquation( frustum1, frustum2 );
-        frustumEqn2 = CreatePlaneEquation( frustum2, frustum3 );
-        frustumEqn3 = CreatePlaneEquation( frustum3, frustum0 );
-    }
+    CalculateTileFrustum( groupIdx.xy, frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3 );
 
     GroupMemoryBarrierWithGroupSync();
 
@@ -223,22 +501,69 @@ void CullLightsCS( uint3 globalIdx : SV_DispatchThreadID, uint3 localIdx : SV_Gr
     float maxZ = 0.f;
 
 #if ( USE_DEPTH_BOUNDS == 1 )   // non-MSAA
-    CalculateMinMaxDepthInLds( globalIdx );
+    CalculateMinMaxDepthInLds( groupIdx.xy, localIdx.xy );
 #elif ( USE_DEPTH_BOUNDS == 2 ) // MSAA
     uint depthBufferWidth, depthBufferHeight, depthBufferNumSamples;
     g_DepthTexture.GetDimensions( depthBufferWidth, depthBufferHeight, depthBufferNumSamples );
-    CalculateMinMaxDepthInLdsMSAA( globalIdx, depthBufferNumSamples );
+    CalculateMinMaxDepthInLdsMSAA( groupIdx.xy, localIdx.xy, depthBufferNumSamples );
 #endif
 
     GroupMemoryBarrierWithGroupSync();
     maxZ = asfloat( ldsZMax );
     minZ = asfloat( ldsZMin );
+    uint tileClass = ClassifyTile( minZ, maxZ );
+
+    // split the min/max range into 32 cells, and mark the ones that contain pixels
+    // (only in complex tiles, the others pass every light through the mask)
+    float invCellSize = 32.f / max( maxZ - minZ, 1e-6f );
+#if ( USE_DEPTH_MASK == 1 )
+    if( tileClass == TILE_CLASS_COMPLEX )
+    {
+#if ( USE_DEPTH_BOUNDS == 1 )   // non-MSAA
+        CalculateDepthMaskInLds( groupIdx.xy, localIdx.xy, minZ, invCellSize );
+#elif ( USE_DEPTH_BOUNDS == 2 ) // MSAA
+        CalculateDepthMaskInLdsMSAA( groupIdx.xy, localIdx.xy, depthBufferNumSamples, minZ, invCellSize );
+#endif
+    }
+    else if( localIdxFlattened == 0 )
+    {
+        ldsDepthMask = 0xFFFFFFFFu;
+    }
+    GroupMemoryBarrierWithGroupSync();
+#endif
+#elif ( USE_DEPTH_BOUNDS == 3 ) // Hi-Z
+    float minZ, maxZ;
+    GetMinMaxDepthFromHiZ( groupIdx.xy, minZ, maxZ );
+    uint tileClass = ClassifyTile( minZ, maxZ );
+    float invCellSize = 32.f / max( maxZ - minZ, 1e-6f );
+#else
+    // without depth bounds, nothing is known about the depth
+    uint tileClass = TILE_CLASS_COMPLEX;
+#endif
+
+#if ( USE_COARSE_TILES == 1 )
+    // only test the lights of the coarse tile, unless they did not fit its list
+    uint coarseListStart = GetCoarseTileIndex( groupIdx.xy )*MAX_NUM_LIGHTS_PER_COARSE_TILE;
+    uint uNumCoarsePointLights = g_CoarseLightIndexBuffer[coarseListStart];
+    uint uNumCoarseSpotLights = g_CoarseLightIndexBuffer[coarseListStart+1];
+    bool bUseCoarseList = ( uNumCoarsePointLights + uNumCoarseSpotLights + 2 <= MAX_NUM_LIGHTS_PER_COARSE_TILE );
 #endif
 
     // loop over the lights and do a sphere vs. frustum intersection test
-    uint uNumPointLights = g_uNumLights & 0xFFFFu;
-    for(uint i=localIdxFlattened; i<uNumPointLights; i+=NUM_THREADS_PER_TILE)
+    // (the whole group skips the loops for empty tiles, e.g. sky, which get empty lists)
+#if ( USE_COARSE_TILES == 1 )
+    uint uNumPointLights = bUseCoarseList ? uNumCoarsePointLights : g_uNumPointLights;
+#else
+    uint uNumPointLights = g_uNumPointLights;
+#endif
+    uNumPointLights = ( tileClass != TILE_CLASS_EMPTY ) ? uNumPointLights : 0;
+    for(uint k=localIdxFlattened; k<uNumPointLights; k+=NUM_THREADS_PER_TILE)
     {
+#if ( USE_COARSE_TILES == 1 )
+        uint i = bUseCoarseList ? g_CoarseLightIndexBuffer[coarseListStart+2+k] : k;
+#else
+        uint i = k;
+#endif
         float4 center = g_PointLightBufferCenterAndRadius[i];
         float r = center.w;
         center.xyz = mul( float4(center.xyz, 1), g_mWorldView ).xyz;
@@ -247,16 +572,19 @@ void CullLightsCS( uint3 globalIdx : SV_DispatchThreadID, uint3 localIdx : SV_Gr
         if( TestFrustumSides(center.xyz, r, frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3) )
         {
 #if ( USE_DEPTH_BOUNDS != 0 )
-            if( -center.z + minZ < r && center.z - maxZ < r )
+            if( -center.z + minZ < r && center.z - maxZ < r && TestDepthMask( center.z, r, minZ, invCellSize ) &&
+                TestLightContribution( center.xyz, r, g_PointLightBufferColor[i].rgb, frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3, minZ, maxZ ) )
 #else
-            if( -center.z < r )
+            if( -center.z < r &&
+                TestLightContribution( center.xyz, r, g_PointLightBufferColor[i].rgb, frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3, 0.f, FLT_MAX ) )
 #endif
             {
                 // do a thread-safe increment of the list counter 
                 // and put the index of this light into the list
+                // (if it fits, see the write back below)
                 uint dstIdx = 0;
                 InterlockedAdd( ldsLightIdxCounter, 1, dstIdx );
-                ldsLightIdx[dstIdx] = i;
+                if( dstIdx < MAX_NUM_LIGHTS_PER_TILE ) ldsLightIdx[dstIdx] = i;
             }
         }
     }
@@ -265,9 +593,19 @@ void CullLightsCS( uint3 globalIdx : SV_DispatchThreadID, uint3 localIdx : SV_Gr
 
     // and again for spot lights
     uint uNumPointLightsInThisTile = ldsLightIdxCounter;
-    uint uNumSpotLights = (g_uNumLights & 0xFFFF0000u) >> 16;
-    for(uint j=localIdxFlattened; j<uNumSpotLights; j+=NUM_THREADS_PER_TILE)
+#if ( USE_COARSE_TILES == 1 )
+    uint uNumSpotLights = bUseCoarseList ? uNumCoarseSpotLights : g_uNumSpotLights;
+#else
+    uint uNumSpotLights = g_uNumSpotLights;
+#endif
+    uNumSpotLights = ( tileClass != TILE_CLASS_EMPTY ) ? uNumSpotLights : 0;
+    for(uint l=localIdxFlattened; l<uNumSpotLights; l+=NUM_THREADS_PER_TILE)
     {
+#if ( USE_COARSE_TILES == 1 )
+        uint j = bUseCoarseList ? g_CoarseLightIndexBuffer[coarseListStart+2+uNumCoarsePointLights+l] : l;
+#else
+        uint j = l;
+#endif
         float4 center = g_SpotLightBufferCenterAndRadius[j];
         float r = center.w;
         center.xyz = mul( float4(center.xyz, 1), g_mWorldView ).xyz;
@@ -276,16 +614,46 @@ void CullLightsCS( uint3 globalIdx : SV_DispatchThreadID, uint3 localIdx : SV_Gr
         if( TestFrustumSides(center.xyz, r, frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3) )
         {
 #if ( USE_DEPTH_BOUNDS != 0 )
-            if( -center.z + minZ < r && center.z - maxZ < r )
+            if( -center.z + minZ < r && center.z - maxZ < r && TestDepthMask( center.z, r, minZ, invCellSize ) )
 #else
             if( -center.z < r )
 #endif
             {
-                // do a thread-safe increment of the list counter 
-                // and put the index of this light into the list
-                uint dstIdx = 0;
-                InterlockedAdd( ldsLightIdxCounter, 1, dstIdx );
-                ldsLightIdx[dstIdx] = j;
+                // then the cone, which is a lot smaller than the sphere
+#if ( USE_DEPTH_BOUNDS != 0 )
+                bool bConePasses = ( g_uCullSpotCones == 0 ) || TestSpotCone( center, g_SpotLightBufferSpotParams[j], frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3, minZ, maxZ );
+#else
+                bool bConePasses = ( g_uCullSpotCones == 0 ) || TestSpotCone( center, g_SpotLightBufferSpotParams[j], frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3, 0.f, FLT_MAX );
+#endif
+                // and the light LOD, which needs the cone for where the falloff starts
+                bool bContributes = true;
+                if( bConePasses && g_uCullSpotCones != 0 )
+                {
+                    float4 spotParams = g_SpotLightBufferSpotParams[j];
+                    float3 spotLightDir;
+                    spotLightDir.xy = spotParams.xy;
+                    spotLightDir.z = sqrt( saturate( 1 - spotLightDir.x*spotLightDir.x - spotLightDir.y*spotLightDir.y ) );
+                    spotLightDir.z = (spotParams.z > 0) ? spotLightDir.z : -spotLightDir.z;
+                    float3 apex = center.xyz - r*mul( float4(spotLightDir, 0), g_mWorldView ).xyz;
+#if ( USE_DEPTH_BOUNDS != 0 )
+                    bContributes = TestLightContribution( apex, spotParams.w, g_SpotLightBufferColor[j].rgb, frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3, minZ, maxZ );
+#else
+                    bContributes = TestLightContribution( apex, spotParams.w, g_SpotLightBufferColor[j].rgb, frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3, 0.f, FLT_MAX );
+#endif
+                }
+                if( bConePasses && bContributes )
+                {
+                    // do a thread-safe increment of the list counter 
+                    // and put the index of this light into the list
+                    // (if it fits, see the write back below)
+                    uint dstIdx = 0;
+                    InterlockedAdd( ldsLightIdxCounter, 1, dstIdx );
+                    if( dstIdx < MAX_NUM_LIGHTS_PER_TILE ) ldsLightIdx[dstIdx] = j;
+                }
+                else if( !bConePasses )
+                {
+                    InterlockedAdd( ldsNumSpotConeRejections, 1 );
+                }
             }
         }
     }
@@ -294,29 +662,341 @@ void CullLightsCS( uint3 globalIdx : SV_DispatchThreadID, uint3 localIdx : SV_Gr
 
     {   // write back
         uint tileIdxFlattened = groupIdx.x + groupIdx.y*GetNumTilesX();
+
+        // drop whatever does not fit (rather than overwriting the next tile's list,
+        // or reading past the end of ldsLightIdx), keeping both sentinels
+#if ( USE_COMPACT_LIGHT_LISTS == 1 )
+        uint uCapacity = MAX_NUM_LIGHTS_PER_TILE - 2;
+#else
+        uint uCapacity = min( g_uMaxNumLightsPerTile, MAX_NUM_LIGHTS_PER_TILE ) - 2;
+#endif
+        uint uNumSpotLightsInThisTile = ldsLightIdxCounter - uNumPointLightsInThisTile;
+        uint uNumPointLightsToWrite = min( uNumPointLightsInThisTile, uCapacity );
+        uint uNumSpotLightsToWrite = min( uNumSpotLightsInThisTile, uCapacity - uNumPointLightsToWrite );
+        bool bOverflowed = ( ldsLightIdxCounter > uCapacity );
+
+        // the false positives of the sphere test (see TestSpotCone)
+        if( localIdxFlattened == 0 && ldsNumSpotConeRejections > 0 )
+        {
+            InterlockedAdd( g_LightCullStatsOut[LIGHT_CULL_STATS_SPOT_CONE_OFFSET], ldsNumSpotConeRejections );
+        }
+
+        // the number of tiles of each class
+        if( localIdxFlattened == 0 )
+        {
+            InterlockedAdd( g_LightCullStatsOut[LIGHT_CULL_STATS_TILE_CLASS_OFFSET + tileClass], 1 );
+        }
+
+#if ( USE_COMPACT_LIGHT_LISTS == 1 )
+        // allocate room for the list (including both sentinels) in the 
+        // dense part of the buffer, and write the header for this tile
+        if( localIdxFlattened == 0 )
+        {
+            uint numEntries = uNumPointLightsToWrite + uNumSpotLightsToWrite + 2;
+            uint allocatedOffset = 0;
+            InterlockedAdd( g_PerTileLightIndexBufferOut[COMPACT_LIST_COUNTER_OFFSET], numEntries, allocatedOffset );
+
+            uint bufferSize;
+            g_PerTileLightIndexBufferOut.GetDimensions( bufferSize );
+            uint listStartOffset = COMPACT_LIST_HEADER_OFFSET + COMPACT_LIST_HEADER_SIZE*GetNumTilesX()*GetNumTilesY() + allocatedOffset;
+            bool bListFits = ( listStartOffset + numEntries <= bufferSize );
+
+            // tiles that do not fit get the empty list
+            uint headerIdx = GetCompactListHeaderIndex( tileIdxFlattened );
+            g_PerTileLightIndexBufferOut[headerIdx] = bListFits ? listStartOffset : COMPACT_LIST_EMPTY_LIST_OFFSET;
+            g_PerTileLightIndexBufferOut[headerIdx+1] = bListFits ? ( ( uNumSpotLightsToWrite << 16 ) | uNumPointLightsToWrite ) : 0;
+            ldsListStartOffset = bListFits ? listStartOffset : 0;
+
+            // a list that did not fit the buffer lost all its lights
+            AccumulateLightCullStats( ldsLightIdxCounter, bOverflowed || !bListFits );
+
+            if( tileIdxFlattened == 0 )
+            {
+                g_PerTileLightIndexBufferOut[COMPACT_LIST_EMPTY_LIST_OFFSET] = LIGHT_INDEX_BUFFER_SENTINEL;
+                g_PerTileLightIndexBufferOut[COMPACT_LIST_EMPTY_LIST_OFFSET+1] = LIGHT_INDEX_BUFFER_SENTINEL;
+            }
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+
+        uint startOffset = ldsListStartOffset;
+        if( startOffset == 0 )
+        {
+            return;
+        }
+#else
         uint startOffset = g_uMaxNumLightsPerTile*tileIdxFlattened;
 
-        for(uint i=localIdxFlattened; i<uNumPointLightsInThisTile; i+=NUM_THREADS_PER_TILE)
+        if( localIdxFlattened == 0 )
+        {
+            AccumulateLightCullStats( ldsLightIdxCounter, bOverflowed );
+        }
+#endif
+
+        for(uint i=localIdxFlattened; i<uNumPointLightsToWrite; i+=NUM_THREADS_PER_TILE)
         {
             // per-tile list of light indices
             g_PerTileLightIndexBufferOut[startOffset+i] = ldsLightIdx[i];
         }
 
-        for(uint j=(localIdxFlattened+uNumPointLightsInThisTile); j<ldsLightIdxCounter; j+=NUM_THREADS_PER_TILE)
+        for(uint j=localIdxFlattened; j<uNumSpotLightsToWrite; j+=NUM_THREADS_PER_TILE)
         {
             // per-tile list of light indices
-            g_PerTileLightIndexBufferOut[startOffset+j+1] = ldsLightIdx[j];
+            g_PerTileLightIndexBufferOut[startOffset+uNumPointLightsToWrite+1+j] = ldsLightIdx[uNumPointLightsInThisTile+j];
         }
 
         if( localIdxFlattened == 0 )
         {
             // mark the end of each per-tile list with a sentinel (point lights)
-            g_PerTileLightIndexBufferOut[startOffset+uNumPointLightsInThisTile] = LIGHT_INDEX_BUFFER_SENTINEL;
+            g_PerTileLightIndexBufferOut[startOffset+uNumPointLightsToWrite] = LIGHT_INDEX_BUFFER_SENTINEL;
 
             // mark the end of each per-tile list with a sentinel (spot lights)
-            g_PerTileLightIndexBufferOut[startOffset+ldsLightIdxCounter+1] = LIGHT_INDEX_BUFFER_SENTINEL;
+            g_PerTileLightIndexBufferOut[startOffset+uNumPointLightsToWrite+uNumSpotLightsToWrite+1] = LIGHT_INDEX_BUFFER_SENTINEL;
+        }
+    }
+}
+
+
+
+//-----------------------------------------------------------------------------------------
+// Clustered light culling shader. Dispatched with one thread group per cluster 
+// (numTilesX, numTilesY, g_uNumClusterSlices). Same as CullLightsCS, except the 
+// front and back of the frustum come from the depth slice (clipped to the depth 
+// bounds of the tile, if used), and the per-cluster lists are g_uMaxNumLightsPerCluster 
+// entries apart in g_PerTileLightIndexBufferOut, with the clusters of a tile next 
+// to each other (see GetClusterIndex).
+//-----------------------------------------------------------------------------------------
+[numthreads(NUM_THREADS_X, NUM_THREADS_Y, 1)]
+void CullLightsClusteredCS( uint3 globalIdx : SV_DispatchThreadID, uint3 localIdx : SV_GroupThreadID, uint3 groupIdx : SV_GroupID )
+{
+    uint localIdxFlattened = localIdx.x + localIdx.y*NUM_THREADS_X;
+
+    if( localIdxFlattened == 0 )
+    {
+#if ( USE_DEPTH_BOUNDS == 1 || USE_DEPTH_BOUNDS == 2 )
+        ldsZMin = 0x7f7fffff;  // FLT_MAX as a uint
+        ldsZMax = 0;
+#endif
+        ldsLightIdxCounter = 0;
+    }
+
+    float3 frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3;
+    CalculateTileFrustum( groupIdx.xy, frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3 );
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // the front and back of the frustum are the near and far of this depth slice
+    float minZ, maxZ;
+    GetClusterSliceBounds( groupIdx.z, minZ, maxZ );
+
+#if ( USE_DEPTH_BOUNDS == 1 || USE_DEPTH_BOUNDS == 2 )
+    // clip the slice to the min and max depth for this tile 
+    // (clusters outside of it contain no pixels, so they stay empty)
+#if ( USE_DEPTH_BOUNDS == 1 )   // non-MSAA
+    CalculateMinMaxDepthInLds( groupIdx.xy, localIdx.xy );
+#elif ( USE_DEPTH_BOUNDS == 2 ) // MSAA
+    uint depthBufferWidth, depthBufferHeight, depthBufferNumSamples;
+    g_DepthTexture.GetDimensions( depthBufferWidth, depthBufferHeight, depthBufferNumSamples );
+    CalculateMinMaxDepthInLdsMSAA( groupIdx.xy, localIdx.xy, depthBufferNumSamples );
+#endif
+
+    GroupMemoryBarrierWithGroupSync();
+    uint tileClass = ClassifyTile( asfloat( ldsZMin ), asfloat( ldsZMax ) );
+    maxZ = min( maxZ, asfloat( ldsZMax ) );
+    minZ = max( minZ, asfloat( ldsZMin ) );
+#elif ( USE_DEPTH_BOUNDS == 3 ) // Hi-Z
+    float tileMinZ, tileMaxZ;
+    GetMinMaxDepthFromHiZ( groupIdx.xy, tileMinZ, tileMaxZ );
+    uint tileClass = ClassifyTile( tileMinZ, tileMaxZ );
+    maxZ = min( maxZ, tileMaxZ );
+    minZ = max( minZ, tileMinZ );
+#else
+    uint tileClass = TILE_CLASS_COMPLEX;
+#endif
+
+    // the number of tiles of each class (counted by the first slice of each tile)
+    if( localIdxFlattened == 0 && groupIdx.z == 0 )
+    {
+        InterlockedAdd( g_LightCullStatsOut[LIGHT_CULL_STATS_TILE_CLASS_OFFSET + tileClass], 1 );
+    }
+
+    // loop over the lights and do a sphere vs. frustum intersection test
+    // (the whole group skips the loops for empty clusters)
+    uint uNumPointLights = ( minZ <= maxZ ) ? g_uNumPointLights : 0;
+    for(uint i=localIdxFlattened; i<uNumPointLights; i+=NUM_THREADS_PER_TILE)
+    {
+        float4 center = g_PointLightBufferCenterAndRadius[i];
+        float r = center.w;
+        center.xyz = mul( float4(center.xyz, 1), g_mWorldView ).xyz;
+
+        // test if sphere is intersecting or inside frustum
+        if( TestFrustumSides(center.xyz, r, frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3) )
+        {
+            if( -center.z + minZ < r && center.z - maxZ < r )
+            {
+                // do a thread-safe increment of the list counter 
+                // and put the index of this light into the list
+                // (if it fits, see the write back below)
+                uint dstIdx = 0;
+                InterlockedAdd( ldsLightIdxCounter, 1, dstIdx );
+                if( dstIdx < MAX_NUM_LIGHTS_PER_CLUSTER ) ldsLightIdx[dstIdx] = i;
+            }
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // and again for spot lights
+    uint uNumPointLightsInThisCluster = ldsLightIdxCounter;
+    uint uNumSpotLights = ( minZ <= maxZ ) ? g_uNumSpotLights : 0;
+    for(uint j=localIdxFlattened; j<uNumSpotLights; j+=NUM_THREADS_PER_TILE)
+    {
+        float4 center = g_SpotLightBufferCenterAndRadius[j];
+        float r = center.w;
+        center.xyz = mul( float4(center.xyz, 1), g_mWorldView ).xyz;
+
+        // test if sphere is intersecting or inside frustum
+        if( TestFrustumSides(center.xyz, r, frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3) )
+        {
+            if( -center.z + minZ < r && center.z - maxZ < r )
+            {
+                // do a thread-safe increment of the list counter 
+                // and put the index of this light into the list
+                // (if it fits, see the write back below)
+                uint dstIdx = 0;
+                InterlockedAdd( ldsLightIdxCounter, 1, dstIdx );
+                if( dstIdx < MAX_NUM_LIGHTS_PER_CLUSTER ) ldsLightIdx[dstIdx] = j;
+            }
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    {   // write back
+        uint clusterIdxFlattened = ( groupIdx.x + groupIdx.y*GetNumTilesX() )*g_uNumClusterSlices + groupIdx.z;
+        uint startOffset = g_uMaxNumLightsPerCluster*clusterIdxFlattened;
+
+        // the cluster capacity is configurable, so drop whatever does not fit
+        // (rather than overwriting the next cluster), keeping both sentinels
+        uint uCapacity = g_uMaxNumLightsPerCluster - 2;
+        uint uNumSpotLightsInThisCluster = ldsLightIdxCounter - uNumPointLightsInThisCluster;
+        uint uNumPointLightsToWrite = min( uNumPointLightsInThisCluster, uCapacity );
+        uint uNumSpotLightsToWrite = min( uNumSpotLightsInThisCluster, uCapacity - uNumPointLightsToWrite );
+
+        for(uint i=localIdxFlattened; i<uNumPointLightsToWrite; i+=NUM_THREADS_PER_TILE)
+        {
+            // per-cluster list of light indices
+            g_PerTileLightIndexBufferOut[startOffset+i] = ldsLightIdx[i];
+        }
+
+        for(uint j=localIdxFlattened; j<uNumSpotLightsToWrite; j+=NUM_THREADS_PER_TILE)
+        {
+            // per-cluster list of light indices
+            g_PerTileLightIndexBufferOut[startOffset+uNumPointLightsToWrite+1+j] = ldsLightIdx[uNumPointLightsInThisCluster+j];
+        }
+
+        if( localIdxFlattened == 0 )
+        {
+            AccumulateLightCullStats( ldsLightIdxCounter, ldsLightIdxCounter > uCapacity );
+
+            // mark the end of each per-cluster list with a sentinel (point lights)
+            g_PerTileLightIndexBufferOut[startOffset+uNumPointLightsToWrite] = LIGHT_INDEX_BUFFER_SENTINEL;
+
+            // mark the end of each per-cluster list with a sentinel (spot lights)
+            g_PerTileLightIndexBufferOut[startOffset+uNumPointLightsToWrite+uNumSpotLightsToWrite+1] = LIGHT_INDEX_BUFFER_SENTINEL;
         }
     }
 }
 
 
+
+//-----------------------------------------------------------------------------------------
+// Coarse light culling shader, the first pass of two-level culling. Dispatched with one 
+// thread group per coarse tile of COARSE_TILE_RES pixels, on the grid of the TILE_RES 
+// tiles. Culls all lights against the coarse tile (with the radius grown a little, see 
+// GetCoarseTileTestRadius), and writes the ones that pass to g_CoarseLightIndexBufferOut, 
+// for the USE_COARSE_TILES permutations of CullLightsCS. With USE_DEPTH_BOUNDS == 3, the 
+// depth bounds come from the level of the Hi-Z pyramid with a texel per coarse tile, 
+// otherwise only the near plane is used.
+//-----------------------------------------------------------------------------------------
+[numthreads(NUM_THREADS_X, NUM_THREADS_Y, 1)]
+void CullLightsCoarseCS( uint3 globalIdx : SV_DispatchThreadID, uint3 localIdx : SV_GroupThreadID, uint3 groupIdx : SV_GroupID )
+{
+    uint localIdxFlattened = localIdx.x + localIdx.y*NUM_THREADS_X;
+
+    if( localIdxFlattened == 0 )
+    {
+        ldsLightIdxCounter = 0;
+    }
+
+    float3 frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3;
+    CalculateCoarseTileFrustum( groupIdx.xy, frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3 );
+
+#if ( USE_DEPTH_BOUNDS == 3 ) // Hi-Z
+    float minZ, maxZ;
+    GetMinMaxDepthFromHiZ( groupIdx.xy, minZ, maxZ );
+#endif
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // the lists are appended to in place, dropping whatever does not fit
+    // (the counts are kept, so that CullLightsCS can tell that happened)
+    uint startOffset = ( groupIdx.x + groupIdx.y*GetNumCoarseTilesX() )*MAX_NUM_LIGHTS_PER_COARSE_TILE + 2;
+    uint uCapacity = MAX_NUM_LIGHTS_PER_COARSE_TILE - 2;
+
+    uint uNumPointLights = g_uNumPointLights;
+    for(uint i=localIdxFlattened; i<uNumPointLights; i+=NUM_THREADS_PER_TILE)
+    {
+        float4 center = g_PointLightBufferCenterAndRadius[i];
+        center.xyz = mul( float4(center.xyz, 1), g_mWorldView ).xyz;
+        float r = GetCoarseTileTestRadius( center.xyz, center.w );
+
+        if( TestFrustumSides(center.xyz, r, frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3) )
+        {
+#if ( USE_DEPTH_BOUNDS == 3 )
+            if( -center.z + minZ < r && center.z - maxZ < r )
+#else
+            if( -center.z < r )
+#endif
+            {
+                uint dstIdx = 0;
+                InterlockedAdd( ldsLightIdxCounter, 1, dstIdx );
+                if( dstIdx < uCapacity ) g_CoarseLightIndexBufferOut[startOffset+dstIdx] = i;
+            }
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // and again for spot lights, right after the point lights
+    uint uNumPointLightsInThisTile = ldsLightIdxCounter;
+    uint uNumSpotLights = g_uNumSpotLights;
+    for(uint j=localIdxFlattened; j<uNumSpotLights; j+=NUM_THREADS_PER_TILE)
+    {
+        float4 center = g_SpotLightBufferCenterAndRadius[j];
+        center.xyz = mul( float4(center.xyz, 1), g_mWorldView ).xyz;
+        float r = GetCoarseTileTestRadius( center.xyz, center.w );
+
+        if( TestFrustumSides(center.xyz, r, frustumEqn0, frustumEqn1, frustumEqn2, frustumEqn3) )
+        {
+#if ( USE_DEPTH_BOUNDS == 3 )
+            if( -center.z + minZ < r && center.z - maxZ < r )
+#else
+            if( -center.z < r )
+#endif
+            {
+                uint dstIdx = 0;
+                InterlockedAdd( ldsLightIdxCounter, 1, dstIdx );
+                if( dstIdx < uCapacity ) g_CoarseLightIndexBufferOut[startOffset+dstIdx] = j;
+            }
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if( localIdxFlattened == 0 )
+    {
+        g_CoarseLightIndexBufferOut[startOffset-2] = uNumPointLightsInThisTile;
+        g_CoarseLightIndexBufferOut[startOffset-1] = ldsLightIdxCounter - uNumPointLightsInThisTile;
+    }
+}